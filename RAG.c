@@ -6,8 +6,12 @@ Purpose: This file is a custom resource allocation graph library.
 #include "RAG.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include "hashtable.h"
+#include "metrics.h"
+#include "probes.h"
+#include "alloctrack.h"
 
 /**** PUBLIC ****/
 
@@ -22,26 +26,102 @@ Purpose: This file is a custom resource allocation graph library.
  *  returns: Pointer to the new RAG.
  */
 RAG_t* RAG_create(compare_t cmp, hash_t hash) {
+    return RAG_create_with_allocator(cmp, hash, NULL);
+}
+
+/*
+ * Function: RAG_create_with_allocator
+ * --------------------
+ *  Creates a new RAG whose memory, including its nodes, hashtable, key
+ *  lists and keys made with RAG_create_key, comes from an allocator.
+ * 
+ *  cmp: Function pointer to compare two keys.
+ *  hash: Function pointer to hash a key.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ * 
+ *  returns: Pointer to the new RAG.
+ */
+RAG_t* RAG_create_with_allocator(compare_t cmp, hash_t hash, 
+                const allocator_t* allocator) {
     assert(cmp);
     assert(hash);
+    allocator_t alloc = allocator_resolve(allocator);
     
-    RAG_t* rag = malloc(sizeof(RAG_t));
+    RAG_t* rag = allocator_alloc(&alloc, sizeof(RAG_t));
     assert(rag);
+    rag->allocator = alloc;
 
     // Initialise hashtable for storage of both processes and resources
-    rag->ht = ht_create(INITIAL_TABLE_SIZE, cmp, hash);
+    rag->ht = ht_create_with_allocator(INITIAL_TABLE_SIZE, cmp, hash, &alloc);
     assert(rag->ht);
 
     // Initialise doubly linked lists for adjacency lists
-    rag->proc_key_list = DLL_create();
-    rag->res_key_list = DLL_create();
+    rag->proc_key_list = DLL_create_with_allocator(&alloc);
+    rag->res_key_list = DLL_create_with_allocator(&alloc);
 
     rag->n_resources = 0;
     rag->n_processes = 0;
+    rag->n_nodes = 0;
+    rag->n_observers = 0;
+    rag->keys = NULL;
+    rag->arena = NULL;
 
     return rag;
 }
 
+/*
+ * Function: RAG_create_arena
+ * --------------------
+ *  Creates a new RAG in arena mode. Nodes, hashtable nodes, list links and
+ *  keys made with RAG_create_key all come from one arena owned by the RAG,
+ *  so RAG_clean releases them in O(#chunks). Meant for short lived graphs.
+ * 
+ *  cmp: Function pointer to compare two keys.
+ *  hash: Function pointer to hash a key.
+ * 
+ *  returns: Pointer to the new RAG.
+ */
+RAG_t* RAG_create_arena(compare_t cmp, hash_t hash) {
+    arena_t* arena = arena_create(0);
+    allocator_t allocator = allocator_arena(arena);
+
+    RAG_t* rag = RAG_create_with_allocator(cmp, hash, &allocator);
+    rag->arena = arena;
+
+    return rag;
+}
+
+/*
+ * Function: RAG_create_key
+ * --------------------
+ *  Creates a key with a copy of id from the RAG's allocator. The key
+ *  belongs to the RAG and RAG_clean frees it, so it must not be passed to
+ *  RAG_free_node_key.
+ * 
+ *  rag: Pointer to the RAG.
+ *  type: Process or resource.
+ *  id: Pointer to the id to copy.
+ *  id_size: Size of the id in bytes.
+ * 
+ *  returns: Pointer to the new key.
+ */
+ckey_t* RAG_create_key(RAG_t* rag, type_t type, const void* id, size_t id_size) {
+    assert(rag);
+    assert(id);
+    size_t size = sizeof(RAG_key_t) + id_size;
+
+    RAG_key_t* owned = allocator_alloc(&rag->allocator, size);
+    assert(owned);
+    owned->size = size;
+    owned->next = rag->keys;
+    rag->keys = owned;
+
+    owned->key.type = type;
+    owned->key.id = owned + 1;
+    memcpy(owned->key.id, id, id_size);
+    return &owned->key;
+}
+
 /*
  * Function: RAG_insert
  * --------------------
@@ -62,28 +142,31 @@ status_t RAG_insert(RAG_t* rag, ckey_t* key, void* data, RAG_node_t* next) {
 
     RAG_node_t* node = NULL;
     ht_node_t* ht_node = NULL;
+    METRICS_COUNT(METRICS_RAG, METRICS_INSERTS);
+    DSL_PROBE4(rag_insert, rag, key, 0, rag->n_nodes);
 
     // Create new node if it doesn't exist
     if (!(ht_node = ht_get_node(rag->ht, key))) {
-        node = _RAG_create_node(key, data, next);
+        node = _RAG_create_node(rag, key, data, next);
+        node->id = rag->n_nodes++;
         ht_unique_insert(rag->ht, key, node);
         _RAG_DLL_insert(rag, key);
 
         RAG_increment(rag, node->key->type);
-        return ADDED_NODE;
+        return _RAG_notify(rag, node, NULL, ADDED_NODE);
     } else {
         // Update NULL node attributes if it exists
         node = ht_node->value;
         if ((next && !(node->next)) && (data && !(node->data))) {
             node->next = next;
             node->data = data;
-            return UPDATED_NEXT_DATA;
+            return _RAG_notify(rag, node, NULL, UPDATED_NEXT_DATA);
         } else if (next && !(node->next)) {
             node->next = next;
-            return UPDATED_NEXT;
+            return _RAG_notify(rag, node, NULL, UPDATED_NEXT);
         } else if (data && !(node->data)) {
             node->data = data;
-            return UPDATED_DATA;
+            return _RAG_notify(rag, node, node->next, UPDATED_DATA);
         }
     }
     
@@ -107,29 +190,33 @@ status_t RAG_hard_insert(RAG_t* rag, ckey_t* key, void* data, RAG_node_t* next)
     assert(rag);
     assert(key);
     
-    RAG_node_t* node = NULL;
+    RAG_node_t* node = NULL, * old_next = NULL;
     ht_node_t* ht_node = NULL;
+    METRICS_COUNT(METRICS_RAG, METRICS_INSERTS);
+    DSL_PROBE4(rag_insert, rag, key, 1, rag->n_nodes);
 
     // Create new node if it doesn't exist
     if (!(ht_node = ht_get_node(rag->ht, key))) {
-        node = _RAG_create_node(key, data, next);
+        node = _RAG_create_node(rag, key, data, next);
+        node->id = rag->n_nodes++;
         ht_unique_insert(rag->ht, key, node);
         _RAG_DLL_insert(rag, key);
         RAG_increment(rag, node->key->type);
-        return ADDED_NODE;
+        return _RAG_notify(rag, node, NULL, ADDED_NODE);
     } else {
         // Update and overwrite node attributes if it exists
         node = ht_node->value;
+        old_next = node->next;
         if (next && data) {
             node->next = next;
             node->data = data;
-            return UPDATED_NEXT_DATA;
+            return _RAG_notify(rag, node, old_next, UPDATED_NEXT_DATA);
         } else if (next) {
             node->next = next;
-            return UPDATED_NEXT;
+            return _RAG_notify(rag, node, old_next, UPDATED_NEXT);
         } else if (data) {
             node->data = data;
-            return UPDATED_DATA;
+            return _RAG_notify(rag, node, old_next, UPDATED_DATA);
         }
     }
     
@@ -169,6 +256,59 @@ void RAG_convert_to_undirected(RAG_t* rag) {
     }
 }
 
+/*
+ * Function: RAG_add_observer
+ * --------------------
+ *  Registers a function to be called on every node insertion or update, so
+ *  derived structures can be maintained incrementally.
+ * 
+ *  rag: Pointer to the RAG.
+ *  observer: Function to call.
+ *  ctx: User context passed to observer.
+ * 
+ *  returns: True if registered, false if RAG_MAX_OBSERVERS are registered.
+ */
+bool RAG_add_observer(RAG_t* rag, RAG_observer_t observer, void* ctx) {
+    assert(rag);
+    assert(observer);
+
+    if (rag->n_observers == RAG_MAX_OBSERVERS) {
+        return false;
+    }
+
+    rag->observers[rag->n_observers] = observer;
+    rag->observer_ctx[rag->n_observers] = ctx;
+    rag->n_observers++;
+    return true;
+}
+
+/*
+ * Function: RAG_remove_observer
+ * --------------------
+ *  Unregisters an observer added with RAG_add_observer.
+ * 
+ *  rag: Pointer to the RAG.
+ *  observer: Function to remove.
+ *  ctx: User context it was registered with.
+ * 
+ *  returns: Nothing.
+ */
+void RAG_remove_observer(RAG_t* rag, RAG_observer_t observer, void* ctx) {
+    assert(rag);
+
+    for (size_t i = 0; i < rag->n_observers; i++) {
+        if (rag->observers[i] == observer && rag->observer_ctx[i] == ctx) {
+            // Shift remaining observers down to keep call order
+            for (size_t j = i + 1; j < rag->n_observers; j++) {
+                rag->observers[j - 1] = rag->observers[j];
+                rag->observer_ctx[j - 1] = rag->observer_ctx[j];
+            }
+            rag->n_observers--;
+            return;
+        }
+    }
+}
+
 /*
  * Function: RAG_increment
  * --------------------
@@ -208,7 +348,17 @@ void RAG_decrement(RAG_t* rag, type_t type) {
 /*
  * Function: RAG_clean
  * --------------------
- *  Frees all the memory allocated for the RAG.
+ *  Frees all the memory allocated for the RAG, in every mode:
+ *  - free_keys is given each node's key. It is for keys the caller made,
+ *    keys made with RAG_create_key are freed here and need it NULL.
+ *  - free_values is given each node, which it then owns. It frees the 
+ *    node's data if it should, and the node with RAG_free_node, as 
+ *    RAG_free_node_value does. Nodes come from the RAG's allocator, so 
+ *    plain free is not a valid free_values.
+ *  - If free_values is NULL, the nodes are freed here and their data is 
+ *    left alone. Before nodes came from the allocator they were left to 
+ *    the caller instead.
+ *  With a bulk allocator and both functions NULL nothing is walked.
  * 
  *  rag: Pointer to the RAG.
  *  free_keys: Function pointer to the function that frees the keys.
@@ -216,19 +366,56 @@ void RAG_decrement(RAG_t* rag, type_t type) {
  * 
  *  returns: Nothing.
  */
-void RAG_clean(RAG_t* rag, free_ht_t free_keys, free_ht_t free_values) {
+DSL_COLD void RAG_clean(RAG_t* rag, free_ht_t free_keys,
+                free_ht_t free_values) {
     assert(rag);
+    allocator_t allocator = rag->allocator;
+    arena_t* arena = rag->arena;
+    const void* owner = &rag->allocator;
+    ht_node_t* node = NULL;
+    RAG_key_t* key = NULL, * next_key = NULL;
+    assert(!free_keys || !rag->keys);
+
+    // Free nodes, unless the allocator frees them in bulk and the caller
+    // owns nothing in them
+    for (size_t i = 0; i < rag->ht->size && 
+                (!allocator_is_bulk(&allocator) || free_keys || free_values);
+                i++) {
+        for (node = rag->ht->table[i]; node; node = node->next) {
+            if (free_keys) {
+                free_keys(node->key);
+            }
+            if (free_values) {
+                free_values(node->value);
+            } else {
+                RAG_free_node(node->value);
+            }
+        }
+    }
+
+    for (key = rag->keys; key && !allocator_is_bulk(&allocator);
+                key = next_key) {
+        next_key = key->next;
+        allocator_free(&allocator, key, key->size);
+    }
+
     // Clean RAG
     DLL_clean(rag->proc_key_list, NULL);
     DLL_clean(rag->res_key_list, NULL);
-    ht_clean(rag->ht, free_keys, free_values);
-    free(rag);
+    ht_clean(rag->ht, NULL, NULL);
+    allocator_free(&allocator, rag, sizeof(RAG_t));
+    if (!allocator_is_bulk(&allocator)) {
+        ALLOCTRACK_CLEANED(owner);
+    }
+    if (arena) {
+        arena_clean(arena);
+    }
 }
 
 /*
  * Function: RAG_free_node_key
  * --------------------
- *  Frees the key of a node in the resource allocation graph.
+ *  Frees a key the caller malloc'd, along with its malloc'd id.
  * 
  *  _key: Pointer to the key of the node.
  * 
@@ -243,9 +430,10 @@ void RAG_free_node_key(void* _key) {
 /*
  * Function: RAG_free_node_value
  * --------------------
- *  Frees the value of a node in the resource allocation graph.
+ *  Frees a node of the resource allocation graph and its malloc'd data,
+ *  for RAG_clean's free_values.
  * 
- *  data: Pointer to the value of the node.
+ *  data: Pointer to the node.
  * 
  *  returns: Nothing.
  */
@@ -254,7 +442,57 @@ void RAG_free_node_value(void* data) {
     if (node->data) {
         free(node->data);
     }
-    free(node);
+    RAG_free_node(node);
+}
+
+/*
+ * Function: RAG_free_node
+ * --------------------
+ *  Frees a node of the resource allocation graph through its RAG's
+ *  allocator, leaving its data alone, for RAG_clean's free_values.
+ * 
+ *  _node: Pointer to the node.
+ * 
+ *  returns: Nothing.
+ */
+void RAG_free_node(void* _node) {
+    RAG_node_t* node = (RAG_node_t*)_node;
+    allocator_free(&node->_rag->allocator, node, sizeof(RAG_node_t));
+    METRICS_FREE(METRICS_RAG, sizeof(RAG_node_t));
+}
+
+/*
+ * Function: RAG_memory_usage
+ * --------------------
+ *  Gets the memory rag uses, its hashtable and key lists included.
+ *  Keys and data are not counted.
+ * 
+ *  rag: Pointer to the RAG.
+ *  usage: Output breakdown.
+ * 
+ *  returns: Total bytes.
+ */
+size_t RAG_memory_usage(RAG_t* rag, memory_usage_t* usage) {
+    assert(rag);
+    assert(usage);
+    memory_usage_t part;
+    memset(usage, 0, sizeof(memory_usage_t));
+
+    allocator_account(&rag->allocator, sizeof(RAG_t), 1, &usage->header,
+                usage);
+
+    // Every hashtable value is a RAG node
+    allocator_account(&rag->allocator, sizeof(RAG_node_t), rag->ht->n_values,
+                &usage->nodes, usage);
+
+    ht_memory_usage(rag->ht, &part);
+    allocator_account_usage(&part, usage);
+    DLL_memory_usage(rag->proc_key_list, &part);
+    allocator_account_usage(&part, usage);
+    DLL_memory_usage(rag->res_key_list, &part);
+    allocator_account_usage(&part, usage);
+
+    return usage->total;
 }
 
 /**** PRIVATE ****/
@@ -263,22 +501,48 @@ void RAG_free_node_value(void* data) {
  * --------------------
  *  Creates a new RAG node.
  * 
+ *  rag: Pointer to the RAG.
  *  key: Key to insert.
  *  data: Value to insert.
  *  next: Pointer to the next RAG node.
  * 
  *  returns: Pointer to the new RAG node.
  */
-RAG_node_t* _RAG_create_node(void* key, void* data, RAG_node_t* next) {
-    RAG_node_t* node = malloc(sizeof(RAG_node_t));
+RAG_node_t* _RAG_create_node(RAG_t* rag, void* key, void* data, 
+                RAG_node_t* next) {
+    RAG_node_t* node = allocator_alloc(&rag->allocator, sizeof(RAG_node_t));
     assert(node);
+    METRICS_ALLOC(METRICS_RAG, sizeof(RAG_node_t));
     node->key = key;
     node->data = data;
     node->next = next;
     node->_prev = NULL;
+    node->_rag = rag;
+    node->id = 0;
     return node;
 }
 
+/*
+ * Function: _RAG_notify
+ * --------------------
+ *  Calls every registered observer for a change.
+ * 
+ *  rag: Pointer to the RAG.
+ *  node: Node that was inserted or updated.
+ *  old_next: Next node before the change.
+ *  status: Kind of change.
+ * 
+ *  returns: status.
+ */
+status_t _RAG_notify(RAG_t* rag, RAG_node_t* node, RAG_node_t* old_next, 
+                status_t status) {
+    DSL_PROBE3(rag_update, rag, node->id, status);
+    for (size_t i = 0; i < rag->n_observers; i++) {
+        rag->observers[i](rag->observer_ctx[i], node, old_next, status);
+    }
+    return status;
+}
+
 /*
  * Function: _RAG_DLL_insert
  * --------------------
@@ -3,8 +3,11 @@
 
 #include "hashtable.h"
 #include "dlinkedlist.h"
+#include "allocator.h"
+#include "hints.h"
 
 #define NOT_SAME_TYPE -2
+#define RAG_MAX_OBSERVERS 4
 
 typedef void (* free_RAG_t)(void*);
 
@@ -31,17 +34,49 @@ typedef struct RAG_node RAG_node_t;
 struct RAG_node {
     ckey_t* key;
     void* data;
+    // Dense id assigned on insertion, used to index traversal arrays
+    size_t id;
     // Prev node for when user converts RAG to undirected graph
     RAG_node_t* _prev;
     RAG_node_t* next;
+    // RAG the node belongs to, RAG_free_node frees it through its allocator
+    struct RAG* _rag;
 };
 
+/*
+ * Key made by RAG_create_key, its id follows it in the same allocation.
+ * The RAG chains them so RAG_clean can free them through its allocator.
+ */
+typedef struct RAG_key {
+    ckey_t key;
+    size_t size;
+    struct RAG_key* next;
+} RAG_key_t;
+
+/*
+ * Called after an insert changes the RAG. old_next is the next node before
+ * the change, NULL for new nodes.
+ */
+typedef void (* RAG_observer_t)(void* ctx, RAG_node_t* node,
+                RAG_node_t* old_next, status_t status);
+
 typedef struct RAG {
     hashtable_t* ht;
     DLL_t* proc_key_list;
     DLL_t* res_key_list;
     size_t n_processes;
     size_t n_resources;
+    // Total nodes ever inserted, next dense id to assign
+    size_t n_nodes;
+    RAG_observer_t observers[RAG_MAX_OBSERVERS];
+    void* observer_ctx[RAG_MAX_OBSERVERS];
+    size_t n_observers;
+    // Source of the RAG, its nodes, keys and list links
+    allocator_t allocator;
+    // Keys made by RAG_create_key, newest first
+    RAG_key_t* keys;
+    // Arena owned by the RAG in arena mode, NULL otherwise
+    arena_t* arena;
 } RAG_t;
 
 /*
@@ -56,6 +91,51 @@ typedef struct RAG {
  */
 RAG_t* RAG_create(compare_t cmp, hash_t hash);
 
+/*
+ * Function: RAG_create_with_allocator
+ * --------------------
+ *  Creates a new RAG whose memory, including its nodes, hashtable, key
+ *  lists and keys made with RAG_create_key, comes from an allocator.
+ * 
+ *  cmp: Function pointer to compare two keys.
+ *  hash: Function pointer to hash a key.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ * 
+ *  returns: Pointer to the new RAG.
+ */
+RAG_t* RAG_create_with_allocator(compare_t cmp, hash_t hash, 
+                const allocator_t* allocator);
+
+/*
+ * Function: RAG_create_arena
+ * --------------------
+ *  Creates a new RAG in arena mode. Nodes, hashtable nodes, list links and
+ *  keys made with RAG_create_key all come from one arena owned by the RAG,
+ *  so RAG_clean releases them in O(#chunks). Meant for short lived graphs.
+ * 
+ *  cmp: Function pointer to compare two keys.
+ *  hash: Function pointer to hash a key.
+ * 
+ *  returns: Pointer to the new RAG.
+ */
+RAG_t* RAG_create_arena(compare_t cmp, hash_t hash);
+
+/*
+ * Function: RAG_create_key
+ * --------------------
+ *  Creates a key with a copy of id from the RAG's allocator. The key
+ *  belongs to the RAG and RAG_clean frees it, so it must not be passed to
+ *  RAG_free_node_key.
+ * 
+ *  rag: Pointer to the RAG.
+ *  type: Process or resource.
+ *  id: Pointer to the id to copy.
+ *  id_size: Size of the id in bytes.
+ * 
+ *  returns: Pointer to the new key.
+ */
+ckey_t* RAG_create_key(RAG_t* rag, type_t type, const void* id, size_t id_size);
+
 /*
  * Function: RAG_insert
  * --------------------
@@ -98,6 +178,33 @@ status_t RAG_hard_insert(RAG_t* rag, ckey_t* key, void* data, RAG_node_t* next);
  */
 void RAG_convert_to_undirected(RAG_t* rag);
 
+/*
+ * Function: RAG_add_observer
+ * --------------------
+ *  Registers a function to be called on every node insertion or update, so
+ *  derived structures can be maintained incrementally.
+ * 
+ *  rag: Pointer to the RAG.
+ *  observer: Function to call.
+ *  ctx: User context passed to observer.
+ * 
+ *  returns: True if registered, false if RAG_MAX_OBSERVERS are registered.
+ */
+bool RAG_add_observer(RAG_t* rag, RAG_observer_t observer, void* ctx);
+
+/*
+ * Function: RAG_remove_observer
+ * --------------------
+ *  Unregisters an observer added with RAG_add_observer.
+ * 
+ *  rag: Pointer to the RAG.
+ *  observer: Function to remove.
+ *  ctx: User context it was registered with.
+ * 
+ *  returns: Nothing.
+ */
+void RAG_remove_observer(RAG_t* rag, RAG_observer_t observer, void* ctx);
+
 /*
  * Function: RAG_increment
  * --------------------
@@ -123,7 +230,17 @@ void RAG_decrement(RAG_t* rag, type_t type);
 /*
  * Function: RAG_clean
  * --------------------
- *  Frees all the memory allocated for the RAG.
+ *  Frees all the memory allocated for the RAG, in every mode:
+ *  - free_keys is given each node's key. It is for keys the caller made,
+ *    keys made with RAG_create_key are freed here and need it NULL.
+ *  - free_values is given each node, which it then owns. It frees the 
+ *    node's data if it should, and the node with RAG_free_node, as 
+ *    RAG_free_node_value does. Nodes come from the RAG's allocator, so 
+ *    plain free is not a valid free_values.
+ *  - If free_values is NULL, the nodes are freed here and their data is 
+ *    left alone. Before nodes came from the allocator they were left to 
+ *    the caller instead.
+ *  With a bulk allocator and both functions NULL nothing is walked.
  * 
  *  rag: Pointer to the RAG.
  *  free_keys: Function pointer to the function that frees the keys.
@@ -131,20 +248,23 @@ void RAG_decrement(RAG_t* rag, type_t type);
  * 
  *  returns: Nothing.
  */
-void RAG_clean(RAG_t* rag, free_ht_t free_keys, free_ht_t free_values);
+DSL_COLD void RAG_clean(RAG_t* rag, free_ht_t free_keys,
+                free_ht_t free_values);
 
 /*
  * Function: _RAG_create_node
  * --------------------
  *  Creates a new RAG node.
  * 
+ *  rag: Pointer to the RAG.
  *  key: Key to insert.
  *  data: Value to insert.
  *  next: Pointer to the next RAG node.
  * 
  *  returns: Pointer to the new RAG node.
  */
-RAG_node_t* _RAG_create_node(void* key, void* data, RAG_node_t* next);
+RAG_node_t* _RAG_create_node(RAG_t* rag, void* key, void* data, 
+                RAG_node_t* next);
 
 /*
  * Function: _RAG_DLL_insert
@@ -158,10 +278,25 @@ RAG_node_t* _RAG_create_node(void* key, void* data, RAG_node_t* next);
  */
 void _RAG_DLL_insert(RAG_t* rag, ckey_t* key);
 
+/*
+ * Function: _RAG_notify
+ * --------------------
+ *  Calls every registered observer for a change.
+ * 
+ *  rag: Pointer to the RAG.
+ *  node: Node that was inserted or updated.
+ *  old_next: Next node before the change.
+ *  status: Kind of change.
+ * 
+ *  returns: status.
+ */
+status_t _RAG_notify(RAG_t* rag, RAG_node_t* node, RAG_node_t* old_next, 
+                status_t status);
+
 /*
  * Function: RAG_free_node_key
  * --------------------
- *  Frees the key of a node in the resource allocation graph.
+ *  Frees a key the caller malloc'd, along with its malloc'd id.
  * 
  *  _key: Pointer to the key of the node.
  * 
@@ -172,12 +307,38 @@ void RAG_free_node_key(void* _key);
 /*
  * Function: RAG_free_node_value
  * --------------------
- *  Frees the value of a node in the resource allocation graph.
+ *  Frees a node of the resource allocation graph and its malloc'd data,
+ *  for RAG_clean's free_values.
  * 
- *  data: Pointer to the value of the node.
+ *  data: Pointer to the node.
  * 
  *  returns: Nothing.
  */
 void RAG_free_node_value(void* data);
 
+/*
+ * Function: RAG_free_node
+ * --------------------
+ *  Frees a node of the resource allocation graph through its RAG's
+ *  allocator, leaving its data alone, for RAG_clean's free_values.
+ * 
+ *  _node: Pointer to the node.
+ * 
+ *  returns: Nothing.
+ */
+void RAG_free_node(void* _node);
+
+/*
+ * Function: RAG_memory_usage
+ * --------------------
+ *  Gets the memory rag uses, its hashtable and key lists included.
+ *  Keys and data are not counted.
+ * 
+ *  rag: Pointer to the RAG.
+ *  usage: Output breakdown.
+ * 
+ *  returns: Total bytes.
+ */
+size_t RAG_memory_usage(RAG_t* rag, memory_usage_t* usage);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,284 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a pluggable allocator interface for the containers.
+         Containers take an allocator at creation time, or use the one set
+         for the creating thread, which defaults to the slab allocator.
+         The slab keeps freed nodes for reuse and never returns memory to
+         the OS, so a container's peak footprint stays with the process.
+         Build with DSL_NO_SLAB to default to malloc, e.g. under sanitizers.
+*/
+
+#include "allocator.h"
+#include <stdlib.h>
+#include <assert.h>
+#include "slab.h"
+#include "pool.h"
+
+#ifdef DSL_NO_SLAB
+#define DEFAULT_ALLOCATOR { _allocator_malloc_alloc, _allocator_malloc_free, \
+                NULL, NULL }
+#else
+#define DEFAULT_ALLOCATOR { _slab_allocator_alloc, _slab_allocator_free, \
+                NULL, NULL }
+#endif
+
+// Allocator for containers created without one, per thread
+static _Thread_local allocator_t thread_allocator = DEFAULT_ALLOCATOR;
+
+/**** PUBLIC ****/
+
+/*
+ * Function: allocator_malloc
+ * --------------------
+ *  Gets the allocator backed by malloc and free.
+ *
+ *  No parameters.
+ *
+ *  returns: The malloc allocator.
+ */
+allocator_t allocator_malloc(void) {
+    allocator_t allocator = {
+        _allocator_malloc_alloc, _allocator_malloc_free, NULL, NULL
+    };
+    return allocator;
+}
+
+/*
+ * Function: allocator_arena
+ * --------------------
+ *  Gets an allocator backed by an arena. Frees are no-ops, reset resets the
+ *  arena.
+ *
+ *  arena: Arena to allocate from, must outlive everything using it.
+ *
+ *  returns: The arena allocator.
+ */
+allocator_t allocator_arena(arena_t* arena) {
+    assert(arena);
+    allocator_t allocator = {
+        _allocator_arena_alloc, NULL, _allocator_arena_reset, arena
+    };
+    return allocator;
+}
+
+/*
+ * Function: allocator_set_thread
+ * --------------------
+ *  Sets the allocator used by containers created on this thread without
+ *  an explicit allocator.
+ *
+ *  allocator: Allocator to use, copied, NULL restores the default.
+ *
+ *  returns: Nothing.
+ */
+void allocator_set_thread(const allocator_t* allocator) {
+    allocator_t default_allocator = DEFAULT_ALLOCATOR;
+
+    if (allocator) {
+        assert(allocator->alloc);
+        thread_allocator = *allocator;
+    } else {
+        thread_allocator = default_allocator;
+    }
+}
+
+/*
+ * Function: allocator_get_thread
+ * --------------------
+ *  Gets the allocator used by containers created on this thread without
+ *  an explicit allocator.
+ *
+ *  No parameters.
+ *
+ *  returns: The thread's allocator.
+ */
+allocator_t allocator_get_thread(void) {
+    return thread_allocator;
+}
+
+/*
+ * Function: allocator_resolve
+ * --------------------
+ *  Gets the allocator a container should store, the given one or the
+ *  thread's if NULL.
+ *
+ *  allocator: Allocator passed at creation time, or NULL.
+ *
+ *  returns: The allocator to use.
+ */
+allocator_t allocator_resolve(const allocator_t* allocator) {
+    if (allocator) {
+        assert(allocator->alloc);
+        return *allocator;
+    }
+    return thread_allocator;
+}
+
+/*
+ * Function: allocator_reset
+ * --------------------
+ *  Releases everything allocated from an allocator at once. Every
+ *  container using it is gone afterwards and must not be cleaned.
+ *
+ *  allocator: Pointer to the allocator.
+ *
+ *  returns: True if the allocator supports reset.
+ */
+bool allocator_reset(const allocator_t* allocator) {
+    assert(allocator);
+
+    if (!allocator->reset) {
+        return false;
+    }
+
+    allocator->reset(allocator->ctx);
+    return true;
+}
+
+/*
+ * Function: allocator_account
+ * --------------------
+ *  Adds allocations to a memory usage, with the slack and overhead the
+ *  allocator adds to each.
+ *
+ *  allocator: Allocator they came from, NULL for malloc.
+ *  size: Size of each allocation.
+ *  count: Number of allocations.
+ *  bytes: Field of usage the requested bytes go to.
+ *  usage: Usage to add to.
+ *
+ *  returns: Nothing.
+ */
+void allocator_account(const allocator_t* allocator, size_t size,
+                size_t count, size_t* bytes, memory_usage_t* usage) {
+    assert(bytes);
+    assert(usage);
+    size_t used = size, overhead = 0;
+    alloc_t alloc = allocator ? allocator->alloc : _allocator_malloc_alloc;
+
+    // Memory each allocation really takes, by backend
+    if (alloc == _slab_allocator_alloc && size <= SLAB_MAX_SIZE) {
+        used = slab_class_bytes(size);
+    } else if (alloc == _allocator_arena_alloc) {
+        used = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    } else if (alloc == _pool_allocator_alloc) {
+        used = ((pool_t*)allocator->ctx)->slot_size;
+    } else if (alloc == _allocator_malloc_alloc ||
+                alloc == _slab_allocator_alloc) {
+        used = _allocator_malloc_block(size) - MALLOC_HEADER_SIZE;
+        overhead = MALLOC_HEADER_SIZE;
+    }
+
+    *bytes += size * count;
+    usage->slack += (used - size) * count;
+    usage->overhead += overhead * count;
+    usage->total += (used + overhead) * count;
+}
+
+/*
+ * Function: allocator_account_block
+ * --------------------
+ *  Adds the single malloc'd block of a fixed capacity container to a usage
+ *  whose header, buckets and nodes are already filled in, the rest of the
+ *  block is slack.
+ *
+ *  block_size: Size of the block.
+ *  usage: Usage to complete.
+ *
+ *  returns: Nothing.
+ */
+void allocator_account_block(size_t block_size, memory_usage_t* usage) {
+    assert(usage);
+    size_t used = usage->header + usage->buckets + usage->nodes;
+    assert(used <= block_size);
+
+    size_t block = _allocator_malloc_block(block_size);
+    usage->slack = block - MALLOC_HEADER_SIZE - used;
+    usage->overhead = MALLOC_HEADER_SIZE;
+    usage->total = block;
+}
+
+/*
+ * Function: allocator_account_usage
+ * --------------------
+ *  Adds the usage of a part, as a container embedded in another, to a
+ *  usage.
+ *
+ *  part: Usage to add.
+ *  usage: Usage to add to.
+ *
+ *  returns: Nothing.
+ */
+void allocator_account_usage(const memory_usage_t* part,
+                memory_usage_t* usage) {
+    assert(part);
+    assert(usage);
+    usage->header += part->header;
+    usage->buckets += part->buckets;
+    usage->nodes += part->nodes;
+    usage->slack += part->slack;
+    usage->overhead += part->overhead;
+    usage->total += part->total;
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _allocator_malloc_alloc
+ * --------------------
+ *  malloc backend of the malloc allocator.
+ *
+ *  returns: Pointer to the memory.
+ */
+void* _allocator_malloc_alloc(void* ctx, size_t size) {
+    (void)ctx;
+    return malloc(size);
+}
+
+/*
+ * Function: _allocator_malloc_free
+ * --------------------
+ *  free backend of the malloc allocator.
+ *
+ *  returns: Nothing.
+ */
+void _allocator_malloc_free(void* ctx, void* ptr, size_t size) {
+    (void)ctx;
+    (void)size;
+    free(ptr);
+}
+
+/*
+ * Function: _allocator_arena_alloc
+ * --------------------
+ *  arena_alloc backend of the arena allocator.
+ *
+ *  returns: Pointer to the memory.
+ */
+void* _allocator_arena_alloc(void* ctx, size_t size) {
+    return arena_alloc(ctx, size);
+}
+
+/*
+ * Function: _allocator_arena_reset
+ * --------------------
+ *  arena_reset backend of the arena allocator.
+ *
+ *  returns: Nothing.
+ */
+void _allocator_arena_reset(void* ctx) {
+    arena_reset(ctx);
+}
+
+/*
+ * Function: _allocator_malloc_block
+ * --------------------
+ *  Estimates the size of the block malloc uses for a request.
+ *
+ *  returns: Block size including malloc's header.
+ */
+size_t _allocator_malloc_block(size_t size) {
+    size_t block = (size + MALLOC_HEADER_SIZE + MALLOC_ALIGNMENT - 1) &
+                ~(MALLOC_ALIGNMENT - 1);
+    return block < MALLOC_MIN_BLOCK ? MALLOC_MIN_BLOCK : block;
+}
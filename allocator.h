@@ -0,0 +1,252 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include "arena.h"
+
+typedef void* (* alloc_t)(void* ctx, size_t size);
+typedef void (* dealloc_t)(void* ctx, void* ptr, size_t size);
+typedef void (* alloc_reset_t)(void* ctx);
+
+/*
+ * Allocator passed to containers at creation time. free may be NULL for
+ * bulk allocators whose memory only goes back on reset, containers then
+ * skip walking their nodes on clean. reset is optional.
+ */
+typedef struct allocator {
+    alloc_t alloc;
+    dealloc_t free;
+    alloc_reset_t reset;
+    void* ctx;
+} allocator_t;
+
+/*
+ * Bytes a container uses, by what holds them. Keys, values and data the
+ * caller owns are not counted. slack is memory handed out beyond what was
+ * asked for, as size class rounding or unused fixed capacity, overhead is
+ * the estimated bookkeeping malloc keeps per block.
+ */
+typedef struct memory_usage {
+    size_t header;
+    size_t buckets;
+    size_t nodes;
+    size_t slack;
+    size_t overhead;
+    size_t total;
+} memory_usage_t;
+
+// Estimated glibc style malloc block layout, used for malloc overhead
+#define MALLOC_HEADER_SIZE sizeof(size_t)
+#define MALLOC_ALIGNMENT (2 * sizeof(size_t))
+#define MALLOC_MIN_BLOCK (4 * sizeof(size_t))
+
+/*
+ * Function: allocator_malloc
+ * --------------------
+ *  Gets the allocator backed by malloc and free.
+ *
+ *  No parameters.
+ *
+ *  returns: The malloc allocator.
+ */
+allocator_t allocator_malloc(void);
+
+/*
+ * Function: allocator_arena
+ * --------------------
+ *  Gets an allocator backed by an arena. Frees are no-ops, reset resets the
+ *  arena.
+ *
+ *  arena: Arena to allocate from, must outlive everything using it.
+ *
+ *  returns: The arena allocator.
+ */
+allocator_t allocator_arena(arena_t* arena);
+
+/*
+ * Function: allocator_set_thread
+ * --------------------
+ *  Sets the allocator used by containers created on this thread without
+ *  an explicit allocator.
+ *
+ *  allocator: Allocator to use, copied, NULL restores the default.
+ *
+ *  returns: Nothing.
+ */
+void allocator_set_thread(const allocator_t* allocator);
+
+/*
+ * Function: allocator_get_thread
+ * --------------------
+ *  Gets the allocator used by containers created on this thread without
+ *  an explicit allocator.
+ *
+ *  No parameters.
+ *
+ *  returns: The thread's allocator.
+ */
+allocator_t allocator_get_thread(void);
+
+/*
+ * Function: allocator_resolve
+ * --------------------
+ *  Gets the allocator a container should store, the given one or the
+ *  thread's if NULL.
+ *
+ *  allocator: Allocator passed at creation time, or NULL.
+ *
+ *  returns: The allocator to use.
+ */
+allocator_t allocator_resolve(const allocator_t* allocator);
+
+/*
+ * Function: allocator_alloc
+ * --------------------
+ *  Allocates memory from an allocator.
+ *
+ *  allocator: Pointer to the allocator.
+ *  size: Number of bytes.
+ *
+ *  returns: Pointer to the memory, NULL on failure.
+ */
+static inline void* allocator_alloc(const allocator_t* allocator, size_t size) {
+    return allocator->alloc(allocator->ctx, size);
+}
+
+/*
+ * Function: allocator_free
+ * --------------------
+ *  Gives memory back to an allocator, a no-op for bulk allocators.
+ *
+ *  allocator: Pointer to the allocator.
+ *  ptr: Memory to free.
+ *  size: Size it was allocated with.
+ *
+ *  returns: Nothing.
+ */
+static inline void allocator_free(const allocator_t* allocator, void* ptr,
+                size_t size) {
+    if (allocator->free) {
+        allocator->free(allocator->ctx, ptr, size);
+    }
+}
+
+/*
+ * Function: allocator_is_bulk
+ * --------------------
+ *  Checks if an allocator only releases memory on reset, so individual
+ *  frees can be skipped.
+ *
+ *  allocator: Pointer to the allocator.
+ *
+ *  returns: True if frees are no-ops.
+ */
+static inline bool allocator_is_bulk(const allocator_t* allocator) {
+    return !allocator->free;
+}
+
+/*
+ * Function: allocator_reset
+ * --------------------
+ *  Releases everything allocated from an allocator at once. Every
+ *  container using it is gone afterwards and must not be cleaned.
+ *
+ *  allocator: Pointer to the allocator.
+ *
+ *  returns: True if the allocator supports reset.
+ */
+bool allocator_reset(const allocator_t* allocator);
+
+/*
+ * Function: allocator_account
+ * --------------------
+ *  Adds allocations to a memory usage, with the slack and overhead the
+ *  allocator adds to each.
+ *
+ *  allocator: Allocator they came from, NULL for malloc.
+ *  size: Size of each allocation.
+ *  count: Number of allocations.
+ *  bytes: Field of usage the requested bytes go to.
+ *  usage: Usage to add to.
+ *
+ *  returns: Nothing.
+ */
+void allocator_account(const allocator_t* allocator, size_t size,
+                size_t count, size_t* bytes, memory_usage_t* usage);
+
+/*
+ * Function: allocator_account_block
+ * --------------------
+ *  Adds the single malloc'd block of a fixed capacity container to a usage
+ *  whose header, buckets and nodes are already filled in, the rest of the
+ *  block is slack.
+ *
+ *  block_size: Size of the block.
+ *  usage: Usage to complete.
+ *
+ *  returns: Nothing.
+ */
+void allocator_account_block(size_t block_size, memory_usage_t* usage);
+
+/*
+ * Function: allocator_account_usage
+ * --------------------
+ *  Adds the usage of a part, as a container embedded in another, to a
+ *  usage.
+ *
+ *  part: Usage to add.
+ *  usage: Usage to add to.
+ *
+ *  returns: Nothing.
+ */
+void allocator_account_usage(const memory_usage_t* part,
+                memory_usage_t* usage);
+
+/**** PRIVATE ****/
+/*
+ * Function: _allocator_malloc_alloc
+ * --------------------
+ *  malloc backend of the malloc allocator.
+ *
+ *  returns: Pointer to the memory.
+ */
+void* _allocator_malloc_alloc(void* ctx, size_t size);
+
+/*
+ * Function: _allocator_malloc_free
+ * --------------------
+ *  free backend of the malloc allocator.
+ *
+ *  returns: Nothing.
+ */
+void _allocator_malloc_free(void* ctx, void* ptr, size_t size);
+
+/*
+ * Function: _allocator_arena_alloc
+ * --------------------
+ *  arena_alloc backend of the arena allocator.
+ *
+ *  returns: Pointer to the memory.
+ */
+void* _allocator_arena_alloc(void* ctx, size_t size);
+
+/*
+ * Function: _allocator_arena_reset
+ * --------------------
+ *  arena_reset backend of the arena allocator.
+ *
+ *  returns: Nothing.
+ */
+void _allocator_arena_reset(void* ctx);
+
+/*
+ * Function: _allocator_malloc_block
+ * --------------------
+ *  Estimates the size of the block malloc uses for a request.
+ *
+ *  returns: Block size including malloc's header.
+ */
+size_t _allocator_malloc_block(size_t size);
+
+#endif
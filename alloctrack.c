@@ -0,0 +1,461 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is the allocation tracking debug mode of the containers.
+         Every allocation made through an allocator is attributed to the
+         library function making it and the calling thread's tag, and kept
+         in a live table by address until freed, so the *_clean functions
+         can report what a container still held through its allocator.
+         Tracking takes a global lock and is meant for debug builds only.
+*/
+
+#include "alloctrack.h"
+#include <string.h>
+#include <stdatomic.h>
+#include <assert.h>
+#include <pthread.h>
+#include "pool.h"
+
+static atomic_bool tracking = false;
+static _Thread_local const char* thread_tag = NULL;
+
+// Sites by function and tag with open addressing, and the overflow site
+static pthread_mutex_t track_lock = PTHREAD_MUTEX_INITIALIZER;
+static alloctrack_site_t sites[ALLOCTRACK_MAX_SITES];
+static size_t n_sites = 0;
+static alloctrack_site_t overflow = { "other", NULL, 0, 0, 0, 0, 0 };
+
+// Live allocations, read without the lock so frees skip the lock when empty
+static alloctrack_live_t** buckets = NULL;
+static size_t n_buckets = 0;
+static atomic_size_t n_live = 0;
+static size_t n_leaks = 0;
+
+/**** PUBLIC ****/
+
+/*
+ * Function: alloctrack_enable
+ * --------------------
+ *  Turns tracking on or off at runtime, off by default. Memory allocated
+ *  while off is never reported.
+ *
+ *  enabled: True to track, false to stop.
+ *
+ *  returns: False if tracking was not compiled in, true otherwise.
+ */
+bool alloctrack_enable(bool enabled) {
+#ifdef DSL_ALLOC_TRACK
+    atomic_store(&tracking, enabled);
+    return true;
+#else
+    (void)enabled;
+    return false;
+#endif
+}
+
+/*
+ * Function: alloctrack_set_tag
+ * --------------------
+ *  Sets the tag the calling thread's allocations are attributed to, as the
+ *  request or component using the containers.
+ *
+ *  tag: Tag, must outlive tracking, NULL for none.
+ *
+ *  returns: The previous tag.
+ */
+const char* alloctrack_set_tag(const char* tag) {
+    const char* previous = thread_tag;
+    thread_tag = tag;
+    return previous;
+}
+
+/*
+ * Function: alloctrack_alloc
+ * --------------------
+ *  Allocates from an allocator and records the allocation.
+ *
+ *  allocator: Allocator to allocate from.
+ *  size: Number of bytes.
+ *  function: Library function making the allocation.
+ *
+ *  returns: Pointer to the memory, NULL on failure.
+ */
+void* alloctrack_alloc(const allocator_t* allocator, size_t size,
+                const char* function) {
+    void* ptr = (allocator_alloc)(allocator, size);
+    if (!ptr || !atomic_load_explicit(&tracking, memory_order_relaxed)) {
+        return ptr;
+    }
+
+    pthread_mutex_lock(&track_lock);
+    alloctrack_site_t* site = _alloctrack_site(function, thread_tag);
+    site->n_allocs++;
+    site->bytes += size;
+
+    // Bulk memory goes back on reset and pool memory with the pool, neither
+    // is freed one allocation at a time so neither can leak from a clean
+    if (!allocator_is_bulk(allocator) &&
+                allocator->alloc != _pool_allocator_alloc) {
+        if (atomic_load(&n_live) >= n_buckets) {
+            _alloctrack_grow();
+        }
+
+        alloctrack_live_t* live = malloc(sizeof(alloctrack_live_t));
+        assert(live);
+        size_t index = _alloctrack_bucket(ptr, n_buckets);
+        live->ptr = ptr;
+        live->size = size;
+        live->site = site;
+        live->owner = allocator;
+        live->next = buckets[index];
+        buckets[index] = live;
+
+        site->n_live++;
+        site->live_bytes += size;
+        atomic_fetch_add(&n_live, 1);
+    }
+    pthread_mutex_unlock(&track_lock);
+
+    return ptr;
+}
+
+/*
+ * Function: alloctrack_free
+ * --------------------
+ *  Frees to an allocator and records the free against the allocation's
+ *  site.
+ *
+ *  allocator: Allocator the memory came from.
+ *  ptr: Memory to free.
+ *  size: Size it was allocated with.
+ *
+ *  returns: Nothing.
+ */
+void alloctrack_free(const allocator_t* allocator, void* ptr, size_t size) {
+    // Frees are matched even while off, so nothing tracked looks leaked
+    if (ptr && atomic_load_explicit(&n_live, memory_order_relaxed)) {
+        pthread_mutex_lock(&track_lock);
+        alloctrack_live_t** link = &buckets[_alloctrack_bucket(ptr,
+                    n_buckets)];
+        while (*link && (*link)->ptr != ptr) {
+            link = &(*link)->next;
+        }
+
+        if (*link) {
+            if ((*link)->size != size) {
+                fprintf(stderr, "alloctrack: %p from %s freed with %zu "
+                            "bytes, allocated with %zu\n", ptr,
+                            (*link)->site->function, size, (*link)->size);
+            }
+            (*link)->site->n_frees++;
+            _alloctrack_untrack(link);
+        }
+        pthread_mutex_unlock(&track_lock);
+    }
+
+    (allocator_free)(allocator, ptr, size);
+}
+
+/*
+ * Function: alloctrack_note
+ * --------------------
+ *  Records a library allocation made outside any allocator, as the block
+ *  of a fixed capacity container or memory handed to the caller. It is
+ *  counted but never reported as leaked.
+ *
+ *  size: Number of bytes.
+ *  function: Library function making the allocation.
+ *
+ *  returns: Nothing.
+ */
+void alloctrack_note(size_t size, const char* function) {
+    if (!atomic_load_explicit(&tracking, memory_order_relaxed)) {
+        return;
+    }
+
+    pthread_mutex_lock(&track_lock);
+    alloctrack_site_t* site = _alloctrack_site(function, thread_tag);
+    site->n_allocs++;
+    site->bytes += size;
+    pthread_mutex_unlock(&track_lock);
+}
+
+/*
+ * Function: alloctrack_cleaned
+ * --------------------
+ *  Reports allocations still live that were made through a container's
+ *  allocator, called once the container is cleaned.
+ *
+ *  owner: Address of the container's allocator_t.
+ *  function: Clean function.
+ *
+ *  returns: Number of leaked allocations.
+ */
+size_t alloctrack_cleaned(const void* owner, const char* function) {
+    assert(function);
+    size_t leaked = 0;
+    if (!atomic_load_explicit(&n_live, memory_order_relaxed)) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&track_lock);
+    for (size_t i = 0; i < n_buckets; i++) {
+        alloctrack_live_t** link = &buckets[i];
+        while (*link) {
+            if ((*link)->owner != owner) {
+                link = &(*link)->next;
+                continue;
+            }
+
+            alloctrack_site_t* site = (*link)->site;
+            fprintf(stderr, "alloctrack: %s leaked %zu bytes at %p from "
+                        "%s%s%s\n", function, (*link)->size, (*link)->ptr,
+                        site->function, site->tag ? " tag " : "",
+                        site->tag ? site->tag : "");
+            _alloctrack_untrack(link);
+            leaked++;
+        }
+    }
+    n_leaks += leaked;
+    pthread_mutex_unlock(&track_lock);
+
+    return leaked;
+}
+
+/*
+ * Function: alloctrack_dump
+ * --------------------
+ *  Writes the sites with the most bytes allocated, one JSON object per
+ *  line.
+ *
+ *  out: Stream to write to.
+ *  top: Number of sites to write, 0 for all.
+ *
+ *  returns: Nothing.
+ */
+void alloctrack_dump(FILE* out, size_t top) {
+    assert(out);
+
+    // Sort a copy so the lock isn't held while writing
+    pthread_mutex_lock(&track_lock);
+    alloctrack_site_t* sorted = malloc(sizeof(alloctrack_site_t) *
+                (n_sites + 1));
+    assert(sorted);
+    size_t n = 0;
+    for (size_t i = 0; i < ALLOCTRACK_MAX_SITES; i++) {
+        if (sites[i].function) {
+            sorted[n++] = sites[i];
+        }
+    }
+    if (overflow.n_allocs) {
+        sorted[n++] = overflow;
+    }
+    pthread_mutex_unlock(&track_lock);
+
+    qsort(sorted, n, sizeof(alloctrack_site_t), _alloctrack_compare_bytes);
+    n = top && top < n ? top : n;
+
+    for (size_t i = 0; i < n; i++) {
+        fprintf(out, "{\"function\":\"%s\",\"tag\":%s%s%s,\"allocs\":%llu,"
+                    "\"frees\":%llu,\"bytes\":%llu,\"live\":%llu,"
+                    "\"live_bytes\":%llu}\n", sorted[i].function,
+                    sorted[i].tag ? "\"" : "",
+                    sorted[i].tag ? sorted[i].tag : "null",
+                    sorted[i].tag ? "\"" : "",
+                    (unsigned long long)sorted[i].n_allocs,
+                    (unsigned long long)sorted[i].n_frees,
+                    (unsigned long long)sorted[i].bytes,
+                    (unsigned long long)sorted[i].n_live,
+                    (unsigned long long)sorted[i].live_bytes);
+    }
+    free(sorted);
+}
+
+/*
+ * Function: alloctrack_leaks
+ * --------------------
+ *  Writes every site with live allocations, as at exit when everything
+ *  should have been cleaned.
+ *
+ *  out: Stream to write to.
+ *
+ *  returns: Number of live allocations.
+ */
+size_t alloctrack_leaks(FILE* out) {
+    assert(out);
+
+    pthread_mutex_lock(&track_lock);
+    for (size_t i = 0; i < ALLOCTRACK_MAX_SITES; i++) {
+        alloctrack_site_t* site = &sites[i];
+        if (site->n_live) {
+            fprintf(out, "alloctrack: %llu allocations, %llu bytes live from "
+                        "%s%s%s\n", (unsigned long long)site->n_live,
+                        (unsigned long long)site->live_bytes, site->function,
+                        site->tag ? " tag " : "", site->tag ? site->tag : "");
+        }
+    }
+    if (overflow.n_live) {
+        fprintf(out, "alloctrack: %llu allocations, %llu bytes live from "
+                    "other sites\n", (unsigned long long)overflow.n_live,
+                    (unsigned long long)overflow.live_bytes);
+    }
+    size_t live = atomic_load(&n_live);
+    pthread_mutex_unlock(&track_lock);
+
+    return live;
+}
+
+/*
+ * Function: alloctrack_n_leaks
+ * --------------------
+ *  Gets the number of leaked allocations found by *_clean so far.
+ *
+ *  No parameters.
+ *
+ *  returns: Number of leaks.
+ */
+size_t alloctrack_n_leaks(void) {
+    pthread_mutex_lock(&track_lock);
+    size_t leaks = n_leaks;
+    pthread_mutex_unlock(&track_lock);
+    return leaks;
+}
+
+/*
+ * Function: alloctrack_reset
+ * --------------------
+ *  Forgets every site and live allocation.
+ *
+ *  No parameters.
+ *
+ *  returns: Nothing.
+ */
+void alloctrack_reset(void) {
+    pthread_mutex_lock(&track_lock);
+    for (size_t i = 0; i < n_buckets; i++) {
+        alloctrack_live_t* live = buckets[i], * next = NULL;
+        while (live) {
+            next = live->next;
+            free(live);
+            live = next;
+        }
+    }
+    free(buckets);
+    buckets = NULL;
+    n_buckets = 0;
+    atomic_store(&n_live, 0);
+
+    memset(sites, 0, sizeof(sites));
+    n_sites = 0;
+    overflow.n_allocs = overflow.n_frees = overflow.bytes = 0;
+    overflow.n_live = overflow.live_bytes = 0;
+    n_leaks = 0;
+    pthread_mutex_unlock(&track_lock);
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _alloctrack_site
+ * --------------------
+ *  Finds or adds the site of a function and tag, with the lock held.
+ *
+ *  returns: Pointer to the site.
+ */
+alloctrack_site_t* _alloctrack_site(const char* function, const char* tag) {
+    // __func__ strings are unique per function, tags are compared by value
+    size_t hash = (size_t)(uintptr_t)function * 0x9E3779B97F4A7C15ULL;
+    for (const unsigned char* c = (const unsigned char*)tag; c && *c; c++) {
+        hash = (hash ^ *c) * 0x100000001B3ULL;
+    }
+
+    for (size_t i = 0; i < ALLOCTRACK_MAX_SITES; i++) {
+        alloctrack_site_t* site = &sites[(hash + i) % ALLOCTRACK_MAX_SITES];
+        if (!site->function) {
+            // Keep a free slot so probing always ends
+            if (n_sites == ALLOCTRACK_MAX_SITES - 1) {
+                return &overflow;
+            }
+            site->function = function;
+            site->tag = tag;
+            n_sites++;
+            return site;
+        }
+
+        if (site->function == function && (site->tag == tag ||
+                    (site->tag && tag && !strcmp(site->tag, tag)))) {
+            return site;
+        }
+    }
+    return &overflow;
+}
+
+/*
+ * Function: _alloctrack_untrack
+ * --------------------
+ *  Removes a live allocation and takes it off its site, with the lock held.
+ *
+ *  returns: Nothing.
+ */
+void _alloctrack_untrack(alloctrack_live_t** link) {
+    alloctrack_live_t* live = *link;
+    live->site->n_live--;
+    live->site->live_bytes -= live->size;
+    *link = live->next;
+    free(live);
+    atomic_fetch_sub(&n_live, 1);
+}
+
+/*
+ * Function: _alloctrack_grow
+ * --------------------
+ *  Doubles the live allocation buckets, with the lock held.
+ *
+ *  returns: Nothing.
+ */
+void _alloctrack_grow(void) {
+    size_t new_size = n_buckets ? n_buckets * 2 : ALLOCTRACK_INITIAL_BUCKETS;
+    alloctrack_live_t** new_buckets = calloc(new_size,
+                sizeof(alloctrack_live_t*));
+    assert(new_buckets);
+
+    for (size_t i = 0; i < n_buckets; i++) {
+        alloctrack_live_t* live = buckets[i], * next = NULL;
+        while (live) {
+            next = live->next;
+            size_t index = _alloctrack_bucket(live->ptr, new_size);
+            live->next = new_buckets[index];
+            new_buckets[index] = live;
+            live = next;
+        }
+    }
+
+    free(buckets);
+    buckets = new_buckets;
+    n_buckets = new_size;
+}
+
+/*
+ * Function: _alloctrack_bucket
+ * --------------------
+ *  Gets the live allocation bucket of a pointer.
+ *
+ *  returns: Bucket index.
+ */
+size_t _alloctrack_bucket(const void* ptr, size_t size) {
+    // Allocations are at least 16 byte aligned, mix the low bits away
+    uint64_t hash = (uint64_t)(uintptr_t)ptr * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(hash >> 32) & (size - 1);
+}
+
+/*
+ * Function: _alloctrack_compare_bytes
+ * --------------------
+ *  qsort comparator ordering sites by bytes allocated, most first.
+ *
+ *  returns: Negative, zero or positive.
+ */
+int _alloctrack_compare_bytes(const void* a, const void* b) {
+    uint64_t x = ((const alloctrack_site_t*)a)->bytes;
+    uint64_t y = ((const alloctrack_site_t*)b)->bytes;
+    return (x < y) - (x > y);
+}
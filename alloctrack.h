@@ -0,0 +1,235 @@
+#ifndef ALLOCTRACK_H
+#define ALLOCTRACK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "allocator.h"
+
+// Distinct function and tag pairs tracked, later ones share one overflow site
+#define ALLOCTRACK_MAX_SITES 1024
+// Initial buckets of the live allocation table, doubled as it fills
+#define ALLOCTRACK_INITIAL_BUCKETS 1024
+
+/*
+ * Allocations made from one library function under one caller tag. Frees
+ * are attributed to the site that made the allocation.
+ */
+typedef struct alloctrack_site {
+    const char* function;
+    const char* tag;
+    uint64_t n_allocs;
+    uint64_t n_frees;
+    uint64_t bytes;
+    // Allocations not yet freed, noted and bulk allocations are never live
+    uint64_t n_live;
+    uint64_t live_bytes;
+} alloctrack_site_t;
+
+/*
+ * Allocation not yet freed, chained in the live table by address.
+ */
+typedef struct alloctrack_live {
+    const void* ptr;
+    size_t size;
+    alloctrack_site_t* site;
+    // Allocator the memory came from
+    const void* owner;
+    struct alloctrack_live* next;
+} alloctrack_live_t;
+
+/*
+ * Allocation tracking. Building with DSL_ALLOC_TRACK routes every
+ * allocator_alloc and allocator_free in the library through the tracker,
+ * attributed to the calling function, and makes the container *_clean
+ * functions report allocations they should have freed but did not.
+ * Without the flag these compile to nothing.
+ */
+#ifdef DSL_ALLOC_TRACK
+#define allocator_alloc(allocator, size) \
+    alloctrack_alloc(allocator, size, __func__)
+#define allocator_free(allocator, ptr, size) \
+    alloctrack_free(allocator, ptr, size)
+#define ALLOCTRACK_NOTE(size) alloctrack_note(size, __func__)
+#define ALLOCTRACK_CLEANED(owner) alloctrack_cleaned(owner, __func__)
+#else
+#define ALLOCTRACK_NOTE(size) ((void)sizeof(size))
+#define ALLOCTRACK_CLEANED(owner) ((void)sizeof(owner))
+#endif
+
+/**** PUBLIC ****/
+
+/*
+ * Function: alloctrack_enable
+ * --------------------
+ *  Turns tracking on or off at runtime, off by default. Memory allocated
+ *  while off is never reported.
+ *
+ *  enabled: True to track, false to stop.
+ *
+ *  returns: False if tracking was not compiled in, true otherwise.
+ */
+bool alloctrack_enable(bool enabled);
+
+/*
+ * Function: alloctrack_set_tag
+ * --------------------
+ *  Sets the tag the calling thread's allocations are attributed to, as the
+ *  request or component using the containers.
+ *
+ *  tag: Tag, must outlive tracking, NULL for none.
+ *
+ *  returns: The previous tag.
+ */
+const char* alloctrack_set_tag(const char* tag);
+
+/*
+ * Function: alloctrack_alloc
+ * --------------------
+ *  Allocates from an allocator and records the allocation.
+ *
+ *  allocator: Allocator to allocate from.
+ *  size: Number of bytes.
+ *  function: Library function making the allocation.
+ *
+ *  returns: Pointer to the memory, NULL on failure.
+ */
+void* alloctrack_alloc(const allocator_t* allocator, size_t size,
+                const char* function);
+
+/*
+ * Function: alloctrack_free
+ * --------------------
+ *  Frees to an allocator and records the free against the allocation's
+ *  site.
+ *
+ *  allocator: Allocator the memory came from.
+ *  ptr: Memory to free.
+ *  size: Size it was allocated with.
+ *
+ *  returns: Nothing.
+ */
+void alloctrack_free(const allocator_t* allocator, void* ptr, size_t size);
+
+/*
+ * Function: alloctrack_note
+ * --------------------
+ *  Records a library allocation made outside any allocator, as the block
+ *  of a fixed capacity container or memory handed to the caller. It is
+ *  counted but never reported as leaked.
+ *
+ *  size: Number of bytes.
+ *  function: Library function making the allocation.
+ *
+ *  returns: Nothing.
+ */
+void alloctrack_note(size_t size, const char* function);
+
+/*
+ * Function: alloctrack_cleaned
+ * --------------------
+ *  Reports allocations still live that were made through a container's
+ *  allocator, called once the container is cleaned.
+ *
+ *  owner: Address of the container's allocator_t.
+ *  function: Clean function.
+ *
+ *  returns: Number of leaked allocations.
+ */
+size_t alloctrack_cleaned(const void* owner, const char* function);
+
+/*
+ * Function: alloctrack_dump
+ * --------------------
+ *  Writes the sites with the most bytes allocated, one JSON object per
+ *  line.
+ *
+ *  out: Stream to write to.
+ *  top: Number of sites to write, 0 for all.
+ *
+ *  returns: Nothing.
+ */
+void alloctrack_dump(FILE* out, size_t top);
+
+/*
+ * Function: alloctrack_leaks
+ * --------------------
+ *  Writes every site with live allocations, as at exit when everything
+ *  should have been cleaned.
+ *
+ *  out: Stream to write to.
+ *
+ *  returns: Number of live allocations.
+ */
+size_t alloctrack_leaks(FILE* out);
+
+/*
+ * Function: alloctrack_n_leaks
+ * --------------------
+ *  Gets the number of leaked allocations found by *_clean so far.
+ *
+ *  No parameters.
+ *
+ *  returns: Number of leaks.
+ */
+size_t alloctrack_n_leaks(void);
+
+/*
+ * Function: alloctrack_reset
+ * --------------------
+ *  Forgets every site and live allocation.
+ *
+ *  No parameters.
+ *
+ *  returns: Nothing.
+ */
+void alloctrack_reset(void);
+
+/**** PRIVATE ****/
+/*
+ * Function: _alloctrack_site
+ * --------------------
+ *  Finds or adds the site of a function and tag, with the lock held.
+ *
+ *  returns: Pointer to the site.
+ */
+alloctrack_site_t* _alloctrack_site(const char* function, const char* tag);
+
+/*
+ * Function: _alloctrack_untrack
+ * --------------------
+ *  Removes a live allocation and takes it off its site, with the lock held.
+ *
+ *  returns: Nothing.
+ */
+void _alloctrack_untrack(alloctrack_live_t** link);
+
+/*
+ * Function: _alloctrack_grow
+ * --------------------
+ *  Doubles the live allocation buckets, with the lock held.
+ *
+ *  returns: Nothing.
+ */
+void _alloctrack_grow(void);
+
+/*
+ * Function: _alloctrack_bucket
+ * --------------------
+ *  Gets the live allocation bucket of a pointer.
+ *
+ *  returns: Bucket index.
+ */
+size_t _alloctrack_bucket(const void* ptr, size_t size);
+
+/*
+ * Function: _alloctrack_compare_bytes
+ * --------------------
+ *  qsort comparator ordering sites by bytes allocated, most first.
+ *
+ *  returns: Negative, zero or positive.
+ */
+int _alloctrack_compare_bytes(const void* a, const void* b);
+
+#endif
@@ -0,0 +1,148 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a custom bump allocation arena. Allocations are carved
+         from large chunks and never freed one by one, the whole arena is
+         released at once, in O(#chunks).
+*/
+
+#include "arena.h"
+#include <stdlib.h>
+#include <assert.h>
+
+/**** PUBLIC ****/
+
+/*
+ * Function: arena_create
+ * --------------------
+ *  Creates a new bump allocation arena.
+ *
+ *  chunk_size: Size of each chunk, 0 for ARENA_CHUNK_SIZE.
+ *
+ *  returns: Pointer to the new arena.
+ */
+arena_t* arena_create(size_t chunk_size) {
+    arena_t* arena = malloc(sizeof(arena_t));
+    assert(arena);
+
+    arena->head = NULL;
+    arena->chunk_size = chunk_size ? chunk_size : ARENA_CHUNK_SIZE;
+    arena->n_chunks = 0;
+    arena->bytes_allocated = 0;
+
+    return arena;
+}
+
+/*
+ * Function: arena_alloc
+ * --------------------
+ *  Allocates memory from the arena, aligned to ARENA_ALIGNMENT. Memory is
+ *  only given back by arena_reset or arena_clean.
+ *
+ *  arena: Pointer to the arena.
+ *  size: Number of bytes.
+ *
+ *  returns: Pointer to the memory.
+ */
+void* arena_alloc(arena_t* arena, size_t size) {
+    assert(arena);
+    arena_chunk_t* chunk = arena->head;
+
+    // Round up so the next allocation stays aligned
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    if (!chunk || chunk->used + size > chunk->size) {
+        chunk = _arena_add_chunk(arena, size);
+    }
+
+    void* ptr = (char*)chunk->_align + chunk->used;
+    chunk->used += size;
+    arena->bytes_allocated += size;
+
+    return ptr;
+}
+
+/*
+ * Function: arena_reset
+ * --------------------
+ *  Releases every allocation at once, keeping the first chunk for reuse
+ *  if it is chunk_size bytes.
+ *
+ *  arena: Pointer to the arena.
+ *
+ *  returns: Nothing.
+ */
+void arena_reset(arena_t* arena) {
+    assert(arena);
+    arena_chunk_t* chunk = arena->head, * next = NULL;
+
+    if (!chunk) {
+        return;
+    }
+
+    // Keep the oldest chunk, unless an oversized first allocation made it
+    while (chunk->next) {
+        next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    if (chunk->size == arena->chunk_size) {
+        chunk->used = 0;
+        arena->head = chunk;
+        arena->n_chunks = 1;
+    } else {
+        free(chunk);
+        arena->head = NULL;
+        arena->n_chunks = 0;
+    }
+    arena->bytes_allocated = 0;
+}
+
+/*
+ * Function: arena_clean
+ * --------------------
+ *  Frees the arena and every allocation made from it, in O(#chunks).
+ *
+ *  arena: Pointer to the arena.
+ *
+ *  returns: Nothing.
+ */
+void arena_clean(arena_t* arena) {
+    assert(arena);
+    arena_chunk_t* chunk = arena->head, * next = NULL;
+
+    while (chunk) {
+        next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    free(arena);
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _arena_add_chunk
+ * --------------------
+ *  Adds a new chunk of at least size bytes to the front of the arena.
+ *
+ *  arena: Pointer to the arena.
+ *  size: Minimum usable bytes.
+ *
+ *  returns: Pointer to the new chunk.
+ */
+arena_chunk_t* _arena_add_chunk(arena_t* arena, size_t size) {
+    size_t chunk_size = size > arena->chunk_size ? size : arena->chunk_size;
+
+    arena_chunk_t* chunk = malloc(sizeof(arena_chunk_t) + chunk_size);
+    assert(chunk);
+    chunk->size = chunk_size;
+    chunk->used = 0;
+    chunk->next = arena->head;
+
+    arena->head = chunk;
+    arena->n_chunks++;
+
+    return chunk;
+}
@@ -0,0 +1,88 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 16
+
+typedef struct arena_chunk arena_chunk_t;
+
+struct arena_chunk {
+    arena_chunk_t* next;
+    size_t size;
+    size_t used;
+    // Keeps data aligned to ARENA_ALIGNMENT
+    max_align_t _align[];
+};
+
+typedef struct arena {
+    arena_chunk_t* head;
+    size_t chunk_size;
+    size_t n_chunks;
+    size_t bytes_allocated;
+} arena_t;
+
+/*
+ * Function: arena_create
+ * --------------------
+ *  Creates a new bump allocation arena.
+ *
+ *  chunk_size: Size of each chunk, 0 for ARENA_CHUNK_SIZE.
+ *
+ *  returns: Pointer to the new arena.
+ */
+arena_t* arena_create(size_t chunk_size);
+
+/*
+ * Function: arena_alloc
+ * --------------------
+ *  Allocates memory from the arena, aligned to ARENA_ALIGNMENT. Memory is
+ *  only given back by arena_reset or arena_clean.
+ *
+ *  arena: Pointer to the arena.
+ *  size: Number of bytes.
+ *
+ *  returns: Pointer to the memory.
+ */
+void* arena_alloc(arena_t* arena, size_t size);
+
+/*
+ * Function: arena_reset
+ * --------------------
+ *  Releases every allocation at once, keeping the first chunk for reuse
+ *  if it is chunk_size bytes.
+ *
+ *  arena: Pointer to the arena.
+ *
+ *  returns: Nothing.
+ */
+void arena_reset(arena_t* arena);
+
+/*
+ * Function: arena_clean
+ * --------------------
+ *  Frees the arena and every allocation made from it, in O(#chunks).
+ *
+ *  arena: Pointer to the arena.
+ *
+ *  returns: Nothing.
+ */
+void arena_clean(arena_t* arena);
+
+/**** PRIVATE ****/
+/*
+ * Function: _arena_add_chunk
+ * --------------------
+ *  Adds a new chunk of at least size bytes to the front of the arena.
+ *
+ *  arena: Pointer to the arena.
+ *  size: Minimum usable bytes.
+ *
+ *  returns: Pointer to the new chunk.
+ */
+arena_chunk_t* _arena_add_chunk(arena_t* arena, size_t size);
+
+#endif
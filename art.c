@@ -0,0 +1,1192 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a custom adaptive radix tree library, an ordered map
+         of byte string keys such as paths and URLs. Each inner node
+         branches on one key byte and takes the smallest of four layouts
+         that fits its children, so sparse nodes stay small and dense ones
+         index a byte directly. Node16 edges are searched with GCC vector
+         extensions. A run of bytes every key below a node shares is stored
+         once in that node, path compression, and a key alone below an edge
+         is a leaf right there, lazy expansion. Leaves hold only the bytes
+         the path has not spelled, so shared prefixes cost nothing per key.
+*/
+
+#include "art.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <assert.h>
+#include "alloctrack.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(DSL_NO_SIMD)
+#define ART_HAVE_SIMD
+
+typedef uint8_t _art_v_bytes __attribute__((vector_size(16)));
+#endif
+
+#define ART_LEAF_SIZE(len) (offsetof(art_leaf_t, bytes) + (len))
+
+// Node48 shrinks a little below where Node16 grows into it, and so on, so
+// a node at the boundary doesn't change type on every insert and remove
+#define ART_SHRINK_256 40
+#define ART_SHRINK_48 12
+#define ART_SHRINK_16 3
+
+static const size_t node_sizes[ART_N_TYPES] = {
+    sizeof(art_node4_t), sizeof(art_node16_t), sizeof(art_node48_t),
+    sizeof(art_node256_t)
+};
+
+static const size_t node_capacity[ART_N_TYPES] = {4, 16, 48, 256};
+
+static const uint8_t empty_key[1] = {0};
+
+/*
+ * Counts the edge bytes of a Node16 below byte, the position byte has or
+ * would have. All 16 lanes are compared at once and lanes past n_children
+ * masked off.
+ */
+static inline size_t _art_count16(const art_node16_t* node, uint8_t byte) {
+#ifdef ART_HAVE_SIMD
+    static const _art_v_bytes lanes = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+    };
+    _art_v_bytes keys, needle, limit, below;
+    memcpy(&keys, node->keys, sizeof(keys));
+    memset(&needle, byte, sizeof(needle));
+    memset(&limit, (int)node->node.n_children, sizeof(limit));
+
+    below = (_art_v_bytes)(keys < needle) & (_art_v_bytes)(lanes < limit) & 1;
+    uint64_t halves[2];
+    memcpy(halves, &below, sizeof(halves));
+    // Summing the bytes of a word, the total is at most 16
+    return ((halves[0] + halves[1]) * 0x0101010101010101ULL) >> 56;
+#else
+    size_t count = 0;
+    for (size_t i = 0; i < node->node.n_children; i++) {
+        count += node->keys[i] < byte;
+    }
+    return count;
+#endif
+}
+
+/*
+ * Counts the bytes two strings share from the start.
+ */
+static inline size_t _art_common(const uint8_t* a, size_t a_len,
+                const uint8_t* b, size_t b_len) {
+    size_t n = a_len < b_len ? a_len : b_len, i = 0;
+    while (i < n && a[i] == b[i]) {
+        i++;
+    }
+    return i;
+}
+
+/*
+ * Orders two byte strings, a proper prefix first.
+ */
+static inline int _art_compare(const uint8_t* a, size_t a_len,
+                const uint8_t* b, size_t b_len) {
+    size_t n = a_len < b_len ? a_len : b_len;
+    int cmp = n ? memcmp(a, b, n) : 0;
+    if (cmp) {
+        return cmp;
+    }
+    return (a_len > b_len) - (a_len < b_len);
+}
+
+/**** PUBLIC ****/
+
+/*
+ * Function: art_create
+ * --------------------
+ *  Creates a new adaptive radix tree.
+ *
+ *  No parameters.
+ *
+ *  returns: Pointer to the new tree.
+ */
+art_t* art_create(void) {
+    return art_create_with_allocator(NULL);
+}
+
+/*
+ * Function: art_create_with_allocator
+ * --------------------
+ *  Creates a new adaptive radix tree whose nodes and leaves come from an
+ *  allocator.
+ *
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new tree.
+ */
+art_t* art_create_with_allocator(const allocator_t* allocator) {
+    allocator_t alloc = allocator_resolve(allocator);
+
+    art_t* art = allocator_alloc(&alloc, sizeof(art_t));
+    assert(art);
+
+    art->root = NULL;
+    art->n_keys = 0;
+    art->allocator = alloc;
+
+    return art;
+}
+
+/*
+ * Function: art_insert
+ * --------------------
+ *  Inserts a key, replacing the value if the key is present.
+ *
+ *  art: Pointer to the tree.
+ *  key: Key bytes, copied.
+ *  key_len: Length of the key.
+ *  value: Value.
+ *
+ *  returns: True if the key was new, false if its value was replaced.
+ */
+bool art_insert(art_t* art, const void* key, size_t key_len, void* value) {
+    assert(art);
+    assert(key || !key_len);
+    assert(key_len <= UINT32_MAX);
+    const uint8_t* bytes = key ? key : empty_key;
+    void** ref = &art->root;
+    size_t depth = 0;
+
+    while (true) {
+        void* child = *ref;
+        const uint8_t* rest = bytes + depth;
+        size_t rest_len = key_len - depth;
+
+        if (!child) {
+            *ref = ART_TAG_LEAF(_art_new_leaf(art, rest, rest_len, -1, NULL, 0,
+                        value));
+            art->n_keys++;
+            return true;
+        }
+
+        if (ART_IS_LEAF(child)) {
+            art_leaf_t* leaf = ART_LEAF(child);
+            size_t common = _art_common(rest, rest_len, leaf->bytes,
+                        leaf->len);
+            if (common == rest_len && common == leaf->len) {
+                leaf->value = value;
+                return false;
+            }
+
+            // The two keys part here, a node holding their shared bytes
+            // takes the leaf's place
+            art_node_t* node = _art_new_node(art, ART_NODE4, rest, common);
+            _art_place(art, node, leaf->bytes + common, leaf->len - common,
+                        leaf->value);
+            _art_free_leaf(art, leaf);
+            _art_place(art, node, rest + common, rest_len - common, value);
+            *ref = node;
+            art->n_keys++;
+            return true;
+        }
+
+        art_node_t* node = child;
+        uint8_t* prefix = _art_prefix(node);
+        size_t common = _art_common(rest, rest_len, prefix, node->prefix_len);
+
+        if (common < node->prefix_len) {
+            // The key leaves the prefix early, split it at the mismatch
+            art_node_t* parent = _art_new_node(art, ART_NODE4, prefix, common);
+            uint8_t edge = prefix[common];
+            void* moved = node;
+            _art_copy_node(art, &moved, node, node->type, prefix + common + 1,
+                        node->prefix_len - common - 1);
+            _art_put_child(parent, edge, moved);
+            _art_place(art, parent, rest + common, rest_len - common, value);
+            *ref = parent;
+            art->n_keys++;
+            return true;
+        }
+
+        depth += node->prefix_len;
+        if (depth == key_len) {
+            if (node->leaf) {
+                node->leaf->value = value;
+                return false;
+            }
+            node->leaf = _art_new_leaf(art, NULL, 0, -1, NULL, 0, value);
+            art->n_keys++;
+            return true;
+        }
+
+        void** next = _art_find_child(node, bytes[depth]);
+        if (!next) {
+            art_leaf_t* leaf = _art_new_leaf(art, bytes + depth + 1,
+                        key_len - depth - 1, -1, NULL, 0, value);
+            _art_add_child(art, ref, node, bytes[depth], ART_TAG_LEAF(leaf));
+            art->n_keys++;
+            return true;
+        }
+        ref = next;
+        depth++;
+    }
+}
+
+/*
+ * Function: art_search
+ * --------------------
+ *  Searches for a key.
+ *
+ *  art: Pointer to the tree.
+ *  key: Key bytes.
+ *  key_len: Length of the key.
+ *
+ *  returns: Value of the key, NULL if not found.
+ */
+void* art_search(art_t* art, const void* key, size_t key_len) {
+    assert(art);
+    assert(key || !key_len);
+
+    art_leaf_t* leaf = _art_lookup(art, key ? key : empty_key, key_len);
+    return leaf ? leaf->value : NULL;
+}
+
+/*
+ * Function: art_contains
+ * --------------------
+ *  Checks if a key is in the tree.
+ *
+ *  art: Pointer to the tree.
+ *  key: Key bytes.
+ *  key_len: Length of the key.
+ *
+ *  returns: True if found, false otherwise.
+ */
+bool art_contains(art_t* art, const void* key, size_t key_len) {
+    assert(art);
+    assert(key || !key_len);
+
+    return _art_lookup(art, key ? key : empty_key, key_len) != NULL;
+}
+
+/*
+ * Function: art_remove
+ * --------------------
+ *  Removes a key, shrinking its node and merging a node left with a single
+ *  entry into it.
+ *
+ *  art: Pointer to the tree.
+ *  key: Key bytes.
+ *  key_len: Length of the key.
+ *  free_value: Function to free the value, may be NULL.
+ *
+ *  returns: True if the key was removed, false if not found.
+ */
+bool art_remove(art_t* art, const void* key, size_t key_len,
+                free_art_t free_value) {
+    assert(art);
+    assert(key || !key_len);
+    const uint8_t* bytes = key ? key : empty_key;
+    void** ref = &art->root;
+    void** parent_ref = NULL;
+    art_node_t* parent = NULL;
+    uint8_t edge = 0;
+    size_t depth = 0;
+
+    while (*ref) {
+        void* child = *ref;
+
+        if (ART_IS_LEAF(child)) {
+            art_leaf_t* leaf = ART_LEAF(child);
+            if (leaf->len != key_len - depth || (leaf->len &&
+                        memcmp(leaf->bytes, bytes + depth, leaf->len))) {
+                return false;
+            }
+            if (free_value) {
+                free_value(leaf->value);
+            }
+            _art_free_leaf(art, leaf);
+
+            if (!parent) {
+                art->root = NULL;
+            } else {
+                _art_remove_child(art, parent_ref, parent, edge);
+                parent = *parent_ref;
+                if (parent->n_children + (parent->leaf != NULL) == 1) {
+                    _art_collapse(art, parent_ref, parent);
+                }
+            }
+            art->n_keys--;
+            return true;
+        }
+
+        art_node_t* node = child;
+        if (node->prefix_len > key_len - depth || (node->prefix_len &&
+                    memcmp(_art_prefix(node), bytes + depth,
+                    node->prefix_len))) {
+            return false;
+        }
+        depth += node->prefix_len;
+
+        if (depth == key_len) {
+            if (!node->leaf) {
+                return false;
+            }
+            if (free_value) {
+                free_value(node->leaf->value);
+            }
+            _art_free_leaf(art, node->leaf);
+            node->leaf = NULL;
+            if (node->n_children == 1) {
+                _art_collapse(art, ref, node);
+            }
+            art->n_keys--;
+            return true;
+        }
+
+        parent_ref = ref;
+        parent = node;
+        edge = bytes[depth++];
+        ref = _art_find_child(node, edge);
+        if (!ref) {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Function: art_iter_first
+ * --------------------
+ *  Starts a scan of every key in order.
+ *
+ *  art: Pointer to the tree.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void art_iter_first(art_t* art, art_iter_t* iter) {
+    art_iter_seek(art, NULL, 0, iter);
+}
+
+/*
+ * Function: art_iter_seek
+ * --------------------
+ *  Starts a scan at the first key not less than low.
+ *
+ *  art: Pointer to the tree.
+ *  low: Key bytes to start from.
+ *  low_len: Length of low.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void art_iter_seek(art_t* art, const void* low, size_t low_len,
+                art_iter_t* iter) {
+    assert(art);
+    assert(iter);
+    assert(low || !low_len);
+    const uint8_t* bytes = low ? low : empty_key;
+    memset(iter, 0, sizeof(art_iter_t));
+    iter->art = art;
+
+    // The key buffer spells low as far as the descent has followed it
+    void* child = art->root;
+    size_t depth = 0;
+    while (child) {
+        if (ART_IS_LEAF(child)) {
+            art_leaf_t* leaf = ART_LEAF(child);
+            if (_art_compare(leaf->bytes, leaf->len, bytes + depth,
+                        low_len - depth) >= 0) {
+                _art_push(iter, leaf->bytes, leaf->len);
+                iter->leaf = leaf;
+            }
+            return;
+        }
+
+        art_node_t* node = child;
+        uint8_t* prefix = _art_prefix(node);
+        size_t rest_len = low_len - depth;
+        size_t n = rest_len < node->prefix_len ? rest_len : node->prefix_len;
+        int cmp = n ? memcmp(prefix, bytes + depth, n) : 0;
+
+        if (cmp < 0) {
+            // Every key below is less than low
+            return;
+        }
+        _art_push(iter, prefix, node->prefix_len);
+        if (cmp > 0 || rest_len <= node->prefix_len) {
+            // Every key below is at least low
+            _art_enter(iter, node, 0);
+            return;
+        }
+
+        // The node's leaf and smaller edges are less than low, the edge
+        // low continues with is followed now and larger ones come after
+        depth += node->prefix_len;
+        uint8_t edge = bytes[depth++];
+        _art_enter(iter, node, (uint16_t)(edge + 2));
+        void** slot = _art_find_child(node, edge);
+        if (!slot) {
+            return;
+        }
+        _art_push(iter, &edge, 1);
+        child = *slot;
+    }
+}
+
+/*
+ * Function: art_range
+ * --------------------
+ *  Starts a scan of the keys in [low, high). high must stay valid until
+ *  the scan ends.
+ *
+ *  art: Pointer to the tree.
+ *  low: Inclusive lower bound.
+ *  low_len: Length of low.
+ *  high: Exclusive upper bound.
+ *  high_len: Length of high.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void art_range(art_t* art, const void* low, size_t low_len, const void* high,
+                size_t high_len, art_iter_t* iter) {
+    assert(high || !high_len);
+
+    art_iter_seek(art, low, low_len, iter);
+    iter->end = high ? high : empty_key;
+    iter->end_len = high_len;
+    iter->bounded = true;
+}
+
+/*
+ * Function: art_prefix
+ * --------------------
+ *  Starts a scan of the keys beginning with prefix, the prefix itself
+ *  included. prefix must stay valid until the scan ends.
+ *
+ *  art: Pointer to the tree.
+ *  prefix: Prefix bytes.
+ *  prefix_len: Length of the prefix.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void art_prefix(art_t* art, const void* prefix, size_t prefix_len,
+                art_iter_t* iter) {
+    // Keys with the prefix are contiguous from the prefix itself on
+    art_iter_seek(art, prefix, prefix_len, iter);
+    iter->end = prefix ? prefix : empty_key;
+    iter->end_len = prefix_len;
+    iter->prefixed = true;
+}
+
+/*
+ * Function: art_iter_next
+ * --------------------
+ *  Gets the next key and value of a scan. The key points into the
+ *  iterator's buffer and is overwritten by the next call.
+ *
+ *  iter: Pointer to the iterator.
+ *  key: Output key, may be NULL.
+ *  key_len: Output key length, may be NULL.
+ *  value: Output value, may be NULL.
+ *
+ *  returns: True if a key was produced, false at the end of the scan.
+ */
+bool art_iter_next(art_iter_t* iter, const uint8_t** key, size_t* key_len,
+                void** value) {
+    assert(iter);
+
+    while (true) {
+        if (iter->leaf) {
+            art_leaf_t* leaf = iter->leaf;
+            iter->leaf = NULL;
+
+            if (iter->bounded && _art_compare(iter->key, iter->key_len,
+                        iter->end, iter->end_len) >= 0) {
+                break;
+            }
+            if (iter->prefixed && (iter->key_len < iter->end_len ||
+                        (iter->end_len && memcmp(iter->key, iter->end,
+                        iter->end_len)))) {
+                break;
+            }
+
+            if (key) {
+                *key = iter->key ? iter->key : empty_key;
+            }
+            if (key_len) {
+                *key_len = iter->key_len;
+            }
+            if (value) {
+                *value = leaf->value;
+            }
+            return true;
+        }
+
+        if (!iter->n_frames) {
+            break;
+        }
+
+        art_iter_frame_t* frame = &iter->frames[iter->n_frames - 1];
+        iter->key_len = frame->key_len;
+        if (!frame->next) {
+            frame->next = 1;
+            iter->leaf = frame->node->leaf;
+            continue;
+        }
+
+        uint8_t edge;
+        void* child = _art_next_child(frame->node, frame->next - 1u, &edge);
+        if (!child) {
+            iter->n_frames--;
+            continue;
+        }
+        frame->next = (uint16_t)(edge + 2);
+
+        _art_push(iter, &edge, 1);
+        if (ART_IS_LEAF(child)) {
+            art_leaf_t* leaf = ART_LEAF(child);
+            _art_push(iter, leaf->bytes, leaf->len);
+            iter->leaf = leaf;
+        } else {
+            art_node_t* node = child;
+            _art_push(iter, _art_prefix(node), node->prefix_len);
+            _art_enter(iter, node, 0);
+        }
+    }
+
+    art_iter_close(iter);
+    return false;
+}
+
+/*
+ * Function: art_iter_close
+ * --------------------
+ *  Ends a scan early, freeing its buffers. Closing a finished scan does
+ *  nothing.
+ *
+ *  iter: Pointer to the iterator.
+ *
+ *  returns: Nothing.
+ */
+void art_iter_close(art_iter_t* iter) {
+    assert(iter);
+
+    free(iter->frames);
+    free(iter->key);
+    iter->frames = NULL;
+    iter->n_frames = 0;
+    iter->frames_capacity = 0;
+    iter->key = NULL;
+    iter->key_len = 0;
+    iter->key_capacity = 0;
+    iter->leaf = NULL;
+}
+
+/*
+ * Function: art_size
+ * --------------------
+ *  Gets the number of keys.
+ *
+ *  art: Pointer to the tree.
+ *
+ *  returns: Number of keys.
+ */
+size_t art_size(art_t* art) {
+    assert(art);
+    return art->n_keys;
+}
+
+/*
+ * Function: art_clean
+ * --------------------
+ *  Frees the tree.
+ *
+ *  art: Pointer to the tree.
+ *  free_value: Function to free values, may be NULL.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void art_clean(art_t* art, free_art_t free_value) {
+    assert(art);
+    allocator_t allocator = art->allocator;
+    const void* owner = &art->allocator;
+
+    if (art->root) {
+        _art_clean_child(art, art->root, free_value);
+    }
+    allocator_free(&allocator, art, sizeof(art_t));
+    if (!allocator_is_bulk(&allocator)) {
+        ALLOCTRACK_CLEANED(owner);
+    }
+}
+
+/*
+ * Function: art_memory_usage
+ * --------------------
+ *  Gets the memory art uses by walking it. Inner nodes and their prefixes
+ *  are buckets, leaves with their key bytes are nodes. Values are not
+ *  counted, keys are, as the tree owns them.
+ *
+ *  art: Pointer to the tree.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t art_memory_usage(art_t* art, memory_usage_t* usage) {
+    assert(art);
+    assert(usage);
+    memset(usage, 0, sizeof(memory_usage_t));
+
+    allocator_account(&art->allocator, sizeof(art_t), 1, &usage->header,
+                usage);
+    if (art->root) {
+        _art_usage_child(art, art->root, usage);
+    }
+    return usage->total;
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _art_new_node
+ * --------------------
+ *  Allocates an empty inner node of a type with a copy of a prefix.
+ *
+ *  returns: Pointer to the node.
+ */
+art_node_t* _art_new_node(art_t* art, art_type_t type, const uint8_t* prefix,
+                size_t prefix_len) {
+    assert(prefix_len <= UINT32_MAX);
+    art_node_t* node = allocator_alloc(&art->allocator,
+                node_sizes[type] + prefix_len);
+    assert(node);
+
+    memset(node, 0, node_sizes[type]);
+    node->type = (uint8_t)type;
+    node->prefix_len = (uint32_t)prefix_len;
+    if (prefix_len) {
+        memcpy(_art_prefix(node), prefix, prefix_len);
+    }
+
+    return node;
+}
+
+/*
+ * Function: _art_free_node
+ * --------------------
+ *  Frees an inner node, not its children.
+ *
+ *  returns: Nothing.
+ */
+void _art_free_node(art_t* art, art_node_t* node) {
+    allocator_free(&art->allocator, node,
+                node_sizes[node->type] + node->prefix_len);
+}
+
+/*
+ * Function: _art_new_leaf
+ * --------------------
+ *  Allocates a leaf whose key bytes are two pieces joined around an edge
+ *  byte, the byte left out if edge is negative.
+ *
+ *  returns: Pointer to the leaf.
+ */
+art_leaf_t* _art_new_leaf(art_t* art, const uint8_t* head, size_t head_len,
+                int edge, const uint8_t* tail, size_t tail_len, void* value) {
+    size_t len = head_len + (edge >= 0) + tail_len;
+    assert(len <= UINT32_MAX);
+    art_leaf_t* leaf = allocator_alloc(&art->allocator, ART_LEAF_SIZE(len));
+    assert(leaf);
+
+    leaf->value = value;
+    leaf->len = (uint32_t)len;
+    if (head_len) {
+        memcpy(leaf->bytes, head, head_len);
+    }
+    if (edge >= 0) {
+        leaf->bytes[head_len] = (uint8_t)edge;
+    }
+    if (tail_len) {
+        memcpy(leaf->bytes + len - tail_len, tail, tail_len);
+    }
+
+    return leaf;
+}
+
+/*
+ * Function: _art_free_leaf
+ * --------------------
+ *  Frees a leaf.
+ *
+ *  returns: Nothing.
+ */
+void _art_free_leaf(art_t* art, art_leaf_t* leaf) {
+    allocator_free(&art->allocator, leaf, ART_LEAF_SIZE(leaf->len));
+}
+
+/*
+ * Function: _art_prefix
+ * --------------------
+ *  Gets the prefix bytes stored after an inner node.
+ *
+ *  returns: Pointer to the prefix.
+ */
+uint8_t* _art_prefix(art_node_t* node) {
+    return (uint8_t*)node + node_sizes[node->type];
+}
+
+/*
+ * Function: _art_lookup
+ * --------------------
+ *  Descends to the leaf of a key.
+ *
+ *  returns: Pointer to the leaf, NULL if the key is not in the tree.
+ */
+art_leaf_t* _art_lookup(art_t* art, const uint8_t* key, size_t key_len) {
+    void* child = art->root;
+    size_t depth = 0;
+
+    while (child) {
+        if (ART_IS_LEAF(child)) {
+            art_leaf_t* leaf = ART_LEAF(child);
+            if (leaf->len != key_len - depth || (leaf->len &&
+                        memcmp(leaf->bytes, key + depth, leaf->len))) {
+                return NULL;
+            }
+            return leaf;
+        }
+
+        art_node_t* node = child;
+        if (node->prefix_len) {
+            if (node->prefix_len > key_len - depth ||
+                        memcmp(_art_prefix(node), key + depth,
+                        node->prefix_len)) {
+                return NULL;
+            }
+            depth += node->prefix_len;
+        }
+        if (depth == key_len) {
+            return node->leaf;
+        }
+
+        void** slot = _art_find_child(node, key[depth++]);
+        child = slot ? *slot : NULL;
+    }
+
+    return NULL;
+}
+
+/*
+ * Function: _art_place
+ * --------------------
+ *  Adds a key's remaining bytes below a new node with room, as its leaf if
+ *  none remain and as a child leaf under the first one otherwise.
+ *
+ *  returns: Nothing.
+ */
+void _art_place(art_t* art, art_node_t* node, const uint8_t* rest,
+                size_t rest_len, void* value) {
+    if (!rest_len) {
+        node->leaf = _art_new_leaf(art, NULL, 0, -1, NULL, 0, value);
+        return;
+    }
+
+    art_leaf_t* leaf = _art_new_leaf(art, rest + 1, rest_len - 1, -1, NULL, 0,
+                value);
+    _art_put_child(node, rest[0], ART_TAG_LEAF(leaf));
+}
+
+/*
+ * Function: _art_find_child
+ * --------------------
+ *  Gets the slot of the child under an edge byte.
+ *
+ *  returns: Pointer to the slot, NULL if there is no such child.
+ */
+void** _art_find_child(art_node_t* node, uint8_t byte) {
+    switch (node->type) {
+        case ART_NODE4: {
+            art_node4_t* n4 = (art_node4_t*)node;
+            for (size_t i = 0; i < node->n_children; i++) {
+                if (n4->keys[i] == byte) {
+                    return &n4->children[i];
+                }
+            }
+            return NULL;
+        }
+        case ART_NODE16: {
+            art_node16_t* n16 = (art_node16_t*)node;
+            size_t i = _art_count16(n16, byte);
+            return i < node->n_children && n16->keys[i] == byte ?
+                        &n16->children[i] : NULL;
+        }
+        case ART_NODE48: {
+            art_node48_t* n48 = (art_node48_t*)node;
+            uint8_t slot = n48->index[byte];
+            return slot ? &n48->children[slot - 1] : NULL;
+        }
+        default: {
+            art_node256_t* n256 = (art_node256_t*)node;
+            return n256->children[byte] ? &n256->children[byte] : NULL;
+        }
+    }
+}
+
+/*
+ * Function: _art_next_child
+ * --------------------
+ *  Gets the child with the smallest edge byte not less than byte.
+ *
+ *  returns: Pointer to the child, NULL if none, with its byte in edge.
+ */
+void* _art_next_child(art_node_t* node, size_t byte, uint8_t* edge) {
+    switch (node->type) {
+        case ART_NODE4:
+        case ART_NODE16: {
+            // Both keep their edge bytes sorted
+            uint8_t* keys = node->type == ART_NODE4 ?
+                        ((art_node4_t*)node)->keys :
+                        ((art_node16_t*)node)->keys;
+            void** children = node->type == ART_NODE4 ?
+                        ((art_node4_t*)node)->children :
+                        ((art_node16_t*)node)->children;
+            for (size_t i = 0; i < node->n_children; i++) {
+                if (keys[i] >= byte) {
+                    *edge = keys[i];
+                    return children[i];
+                }
+            }
+            return NULL;
+        }
+        case ART_NODE48: {
+            art_node48_t* n48 = (art_node48_t*)node;
+            for (; byte < 256; byte++) {
+                if (n48->index[byte]) {
+                    *edge = (uint8_t)byte;
+                    return n48->children[n48->index[byte] - 1];
+                }
+            }
+            return NULL;
+        }
+        default: {
+            art_node256_t* n256 = (art_node256_t*)node;
+            for (; byte < 256; byte++) {
+                if (n256->children[byte]) {
+                    *edge = (uint8_t)byte;
+                    return n256->children[byte];
+                }
+            }
+            return NULL;
+        }
+    }
+}
+
+/*
+ * Function: _art_add_child
+ * --------------------
+ *  Adds a child under an edge byte, growing the node into ref if it is
+ *  full.
+ *
+ *  returns: Nothing.
+ */
+void _art_add_child(art_t* art, void** ref, art_node_t* node, uint8_t byte,
+                void* child) {
+    if (node->n_children == node_capacity[node->type]) {
+        node = _art_copy_node(art, ref, node, node->type + 1,
+                    _art_prefix(node), node->prefix_len);
+    }
+    _art_put_child(node, byte, child);
+}
+
+/*
+ * Function: _art_put_child
+ * --------------------
+ *  Adds a child under an edge byte to a node with room.
+ *
+ *  returns: Nothing.
+ */
+void _art_put_child(art_node_t* node, uint8_t byte, void* child) {
+    size_t n = node->n_children;
+
+    switch (node->type) {
+        case ART_NODE4: {
+            art_node4_t* n4 = (art_node4_t*)node;
+            size_t i = 0;
+            while (i < n && n4->keys[i] < byte) {
+                i++;
+            }
+            memmove(n4->keys + i + 1, n4->keys + i, n - i);
+            memmove(n4->children + i + 1, n4->children + i,
+                        (n - i) * sizeof(void*));
+            n4->keys[i] = byte;
+            n4->children[i] = child;
+            break;
+        }
+        case ART_NODE16: {
+            art_node16_t* n16 = (art_node16_t*)node;
+            size_t i = _art_count16(n16, byte);
+            memmove(n16->keys + i + 1, n16->keys + i, n - i);
+            memmove(n16->children + i + 1, n16->children + i,
+                        (n - i) * sizeof(void*));
+            n16->keys[i] = byte;
+            n16->children[i] = child;
+            break;
+        }
+        case ART_NODE48: {
+            art_node48_t* n48 = (art_node48_t*)node;
+            size_t slot = 0;
+            while (n48->children[slot]) {
+                slot++;
+            }
+            n48->children[slot] = child;
+            n48->index[byte] = (uint8_t)(slot + 1);
+            break;
+        }
+        default:
+            ((art_node256_t*)node)->children[byte] = child;
+            break;
+    }
+
+    node->n_children++;
+}
+
+/*
+ * Function: _art_remove_child
+ * --------------------
+ *  Removes the child under an edge byte, shrinking the node into ref when
+ *  a smaller type fits.
+ *
+ *  returns: Nothing.
+ */
+void _art_remove_child(art_t* art, void** ref, art_node_t* node,
+                uint8_t byte) {
+    size_t n = node->n_children;
+    size_t shrink_at = 0;
+
+    switch (node->type) {
+        case ART_NODE4:
+        case ART_NODE16: {
+            uint8_t* keys = node->type == ART_NODE4 ?
+                        ((art_node4_t*)node)->keys :
+                        ((art_node16_t*)node)->keys;
+            void** children = node->type == ART_NODE4 ?
+                        ((art_node4_t*)node)->children :
+                        ((art_node16_t*)node)->children;
+            size_t i = 0;
+            while (keys[i] != byte) {
+                i++;
+            }
+            memmove(keys + i, keys + i + 1, n - i - 1);
+            memmove(children + i, children + i + 1,
+                        (n - i - 1) * sizeof(void*));
+            shrink_at = ART_SHRINK_16;
+            break;
+        }
+        case ART_NODE48: {
+            art_node48_t* n48 = (art_node48_t*)node;
+            n48->children[n48->index[byte] - 1] = NULL;
+            n48->index[byte] = 0;
+            shrink_at = ART_SHRINK_48;
+            break;
+        }
+        default:
+            ((art_node256_t*)node)->children[byte] = NULL;
+            shrink_at = ART_SHRINK_256;
+            break;
+    }
+
+    node->n_children--;
+    if (node->type != ART_NODE4 && node->n_children <= shrink_at) {
+        _art_copy_node(art, ref, node, node->type - 1, _art_prefix(node),
+                    node->prefix_len);
+    }
+}
+
+/*
+ * Function: _art_copy_node
+ * --------------------
+ *  Moves the leaf and children of a node into a new node of a type with a
+ *  new prefix, frees the old one and stores the new one in ref.
+ *
+ *  returns: Pointer to the new node.
+ */
+art_node_t* _art_copy_node(art_t* art, void** ref, art_node_t* node,
+                art_type_t type, const uint8_t* prefix, size_t prefix_len) {
+    // prefix may point into the old node, it is copied before the free
+    art_node_t* copy = _art_new_node(art, type, prefix, prefix_len);
+    copy->leaf = node->leaf;
+
+    uint8_t edge;
+    void* child;
+    for (size_t byte = 0; (child = _art_next_child(node, byte, &edge));
+                byte = (size_t)edge + 1) {
+        _art_put_child(copy, edge, child);
+    }
+
+    _art_free_node(art, node);
+    *ref = copy;
+    return copy;
+}
+
+/*
+ * Function: _art_collapse
+ * --------------------
+ *  Replaces a node left with a single entry by that entry, joining the
+ *  node's prefix and edge onto it.
+ *
+ *  returns: Nothing.
+ */
+void _art_collapse(art_t* art, void** ref, art_node_t* node) {
+    uint8_t* prefix = _art_prefix(node);
+
+    if (node->leaf) {
+        // Its own key, which ends right after the prefix
+        art_leaf_t* leaf = _art_new_leaf(art, prefix, node->prefix_len, -1,
+                    NULL, 0, node->leaf->value);
+        _art_free_leaf(art, node->leaf);
+        *ref = ART_TAG_LEAF(leaf);
+        _art_free_node(art, node);
+        return;
+    }
+
+    uint8_t edge;
+    void* child = _art_next_child(node, 0, &edge);
+
+    if (ART_IS_LEAF(child)) {
+        art_leaf_t* old = ART_LEAF(child);
+        art_leaf_t* leaf = _art_new_leaf(art, prefix, node->prefix_len, edge,
+                    old->bytes, old->len, old->value);
+        _art_free_leaf(art, old);
+        *ref = ART_TAG_LEAF(leaf);
+        _art_free_node(art, node);
+        return;
+    }
+
+    art_node_t* below = child;
+    size_t len = node->prefix_len + 1 + below->prefix_len;
+    uint8_t stack_buffer[64];
+    uint8_t* joined = len <= sizeof(stack_buffer) ? stack_buffer :
+                malloc(len);
+    assert(joined);
+
+    memcpy(joined, prefix, node->prefix_len);
+    joined[node->prefix_len] = edge;
+    memcpy(joined + node->prefix_len + 1, _art_prefix(below),
+                below->prefix_len);
+    _art_copy_node(art, ref, below, below->type, joined, len);
+    _art_free_node(art, node);
+
+    if (joined != stack_buffer) {
+        free(joined);
+    }
+}
+
+/*
+ * Function: _art_clean_child
+ * --------------------
+ *  Frees a child and the subtree under it.
+ *
+ *  returns: Nothing.
+ */
+void _art_clean_child(art_t* art, void* child, free_art_t free_value) {
+    if (ART_IS_LEAF(child)) {
+        art_leaf_t* leaf = ART_LEAF(child);
+        if (free_value) {
+            free_value(leaf->value);
+        }
+        _art_free_leaf(art, leaf);
+        return;
+    }
+
+    art_node_t* node = child;
+    if (node->leaf) {
+        _art_clean_child(art, ART_TAG_LEAF(node->leaf), free_value);
+    }
+
+    uint8_t edge;
+    void* next;
+    for (size_t byte = 0; (next = _art_next_child(node, byte, &edge));
+                byte = (size_t)edge + 1) {
+        _art_clean_child(art, next, free_value);
+    }
+    _art_free_node(art, node);
+}
+
+/*
+ * Function: _art_usage_child
+ * --------------------
+ *  Accounts a child and the subtree under it.
+ *
+ *  returns: Nothing.
+ */
+void _art_usage_child(art_t* art, void* child, memory_usage_t* usage) {
+    if (ART_IS_LEAF(child)) {
+        allocator_account(&art->allocator,
+                    ART_LEAF_SIZE(ART_LEAF(child)->len), 1, &usage->nodes,
+                    usage);
+        return;
+    }
+
+    art_node_t* node = child;
+    allocator_account(&art->allocator,
+                node_sizes[node->type] + node->prefix_len, 1, &usage->buckets,
+                usage);
+    if (node->leaf) {
+        _art_usage_child(art, ART_TAG_LEAF(node->leaf), usage);
+    }
+
+    uint8_t edge;
+    void* next;
+    for (size_t byte = 0; (next = _art_next_child(node, byte, &edge));
+                byte = (size_t)edge + 1) {
+        _art_usage_child(art, next, usage);
+    }
+}
+
+/*
+ * Function: _art_push
+ * --------------------
+ *  Appends bytes to the key an iterator rebuilds.
+ *
+ *  returns: Nothing.
+ */
+void _art_push(art_iter_t* iter, const uint8_t* bytes, size_t len) {
+    if (iter->key_len + len > iter->key_capacity) {
+        size_t capacity = iter->key_capacity ? iter->key_capacity : 64;
+        while (capacity < iter->key_len + len) {
+            capacity *= 2;
+        }
+        iter->key = realloc(iter->key, capacity);
+        assert(iter->key);
+        iter->key_capacity = capacity;
+    }
+
+    if (len) {
+        memcpy(iter->key + iter->key_len, bytes, len);
+        iter->key_len += len;
+    }
+}
+
+/*
+ * Function: _art_enter
+ * --------------------
+ *  Pushes an inner node onto an iterator's path, its prefix already in the
+ *  key, to visit from edge next.
+ *
+ *  returns: Nothing.
+ */
+void _art_enter(art_iter_t* iter, art_node_t* node, uint16_t next) {
+    if (iter->n_frames == iter->frames_capacity) {
+        iter->frames_capacity = iter->frames_capacity ?
+                    iter->frames_capacity * 2 : 16;
+        iter->frames = realloc(iter->frames,
+                    sizeof(art_iter_frame_t) * iter->frames_capacity);
+        assert(iter->frames);
+    }
+
+    art_iter_frame_t* frame = &iter->frames[iter->n_frames++];
+    frame->node = node;
+    frame->next = next;
+    frame->key_len = iter->key_len;
+}
@@ -0,0 +1,502 @@
+#ifndef ART_H
+#define ART_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "allocator.h"
+#include "hints.h"
+
+// A child pointer with the low bit set is a leaf
+#define ART_IS_LEAF(child) ((uintptr_t)(child) & 1)
+#define ART_LEAF(child) ((art_leaf_t*)((uintptr_t)(child) & ~(uintptr_t)1))
+#define ART_TAG_LEAF(leaf) ((void*)((uintptr_t)(leaf) | 1))
+
+typedef void (* free_art_t)(void*);
+
+typedef enum art_type {
+    ART_NODE4,
+    ART_NODE16,
+    ART_NODE48,
+    ART_NODE256,
+    ART_N_TYPES
+} art_type_t;
+
+/*
+ * Header of every inner node. The node's prefix, the bytes every key below
+ * it shares after the parent's edge, is stored in full right after the
+ * node's own struct, so a shared prefix is kept once however many keys
+ * share it.
+ */
+typedef struct art_node {
+    uint8_t type;
+    uint16_t n_children;
+    uint32_t prefix_len;
+    // Leaf of the key that ends right after the prefix, NULL if none
+    struct art_leaf* leaf;
+} art_node_t;
+
+// Sorted edge bytes, for up to 4 children
+typedef struct art_node4 {
+    art_node_t node;
+    uint8_t keys[4];
+    void* children[4];
+} art_node4_t;
+
+// Sorted edge bytes searched with SIMD, for up to 16 children
+typedef struct art_node16 {
+    art_node_t node;
+    uint8_t keys[16];
+    void* children[16];
+} art_node16_t;
+
+// Slot + 1 of every edge byte, 0 for none, for up to 48 children
+typedef struct art_node48 {
+    art_node_t node;
+    uint8_t index[256];
+    void* children[48];
+} art_node48_t;
+
+// Child per edge byte
+typedef struct art_node256 {
+    art_node_t node;
+    void* children[256];
+} art_node256_t;
+
+/*
+ * Key and value. The leaf keeps only the key bytes after the edge that
+ * leads to it, the rest is spelled by the path. A single key below an edge
+ * is a leaf right there, inner nodes only appear where keys diverge.
+ */
+typedef struct art_leaf {
+    void* value;
+    uint32_t len;
+    uint8_t bytes[];
+} art_leaf_t;
+
+/*
+ * Adaptive radix tree, an ordered map of binary keys compared bytewise,
+ * shorter keys first. Keys are copied in, values are the caller's.
+ */
+typedef struct art {
+    void* root;
+    size_t n_keys;
+    // Source of the tree, its nodes and leaves
+    allocator_t allocator;
+} art_t;
+
+// Node on the iterator's path and the next edge byte to visit, 0 for its
+// leaf and byte + 1 for a child
+typedef struct art_iter_frame {
+    art_node_t* node;
+    uint16_t next;
+    // Key length up to and including the node's prefix
+    size_t key_len;
+} art_iter_frame_t;
+
+/*
+ * Position in a scan, from art_iter_first, art_iter_seek, art_range or
+ * art_prefix. Keys are rebuilt into a buffer the iterator owns, freed when
+ * the scan ends or is closed. Valid until the tree changes.
+ */
+typedef struct art_iter {
+    art_t* art;
+    art_iter_frame_t* frames;
+    size_t n_frames;
+    size_t frames_capacity;
+    uint8_t* key;
+    size_t key_len;
+    size_t key_capacity;
+    // Leaf whose key is in the buffer and is produced next
+    art_leaf_t* leaf;
+    // Exclusive upper bound of a range, or the prefix of a prefix scan
+    const uint8_t* end;
+    size_t end_len;
+    bool bounded;
+    bool prefixed;
+} art_iter_t;
+
+/**** PUBLIC ****/
+
+/*
+ * Function: art_create
+ * --------------------
+ *  Creates a new adaptive radix tree.
+ *
+ *  No parameters.
+ *
+ *  returns: Pointer to the new tree.
+ */
+art_t* art_create(void);
+
+/*
+ * Function: art_create_with_allocator
+ * --------------------
+ *  Creates a new adaptive radix tree whose nodes and leaves come from an
+ *  allocator.
+ *
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new tree.
+ */
+art_t* art_create_with_allocator(const allocator_t* allocator);
+
+/*
+ * Function: art_insert
+ * --------------------
+ *  Inserts a key, replacing the value if the key is present.
+ *
+ *  art: Pointer to the tree.
+ *  key: Key bytes, copied.
+ *  key_len: Length of the key.
+ *  value: Value.
+ *
+ *  returns: True if the key was new, false if its value was replaced.
+ */
+bool art_insert(art_t* art, const void* key, size_t key_len, void* value);
+
+/*
+ * Function: art_search
+ * --------------------
+ *  Searches for a key.
+ *
+ *  art: Pointer to the tree.
+ *  key: Key bytes.
+ *  key_len: Length of the key.
+ *
+ *  returns: Value of the key, NULL if not found.
+ */
+void* art_search(art_t* art, const void* key, size_t key_len);
+
+/*
+ * Function: art_contains
+ * --------------------
+ *  Checks if a key is in the tree.
+ *
+ *  art: Pointer to the tree.
+ *  key: Key bytes.
+ *  key_len: Length of the key.
+ *
+ *  returns: True if found, false otherwise.
+ */
+bool art_contains(art_t* art, const void* key, size_t key_len);
+
+/*
+ * Function: art_remove
+ * --------------------
+ *  Removes a key, shrinking its node and merging a node left with a single
+ *  entry into it.
+ *
+ *  art: Pointer to the tree.
+ *  key: Key bytes.
+ *  key_len: Length of the key.
+ *  free_value: Function to free the value, may be NULL.
+ *
+ *  returns: True if the key was removed, false if not found.
+ */
+bool art_remove(art_t* art, const void* key, size_t key_len,
+                free_art_t free_value);
+
+/*
+ * Function: art_iter_first
+ * --------------------
+ *  Starts a scan of every key in order.
+ *
+ *  art: Pointer to the tree.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void art_iter_first(art_t* art, art_iter_t* iter);
+
+/*
+ * Function: art_iter_seek
+ * --------------------
+ *  Starts a scan at the first key not less than low.
+ *
+ *  art: Pointer to the tree.
+ *  low: Key bytes to start from.
+ *  low_len: Length of low.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void art_iter_seek(art_t* art, const void* low, size_t low_len,
+                art_iter_t* iter);
+
+/*
+ * Function: art_range
+ * --------------------
+ *  Starts a scan of the keys in [low, high). high must stay valid until
+ *  the scan ends.
+ *
+ *  art: Pointer to the tree.
+ *  low: Inclusive lower bound.
+ *  low_len: Length of low.
+ *  high: Exclusive upper bound.
+ *  high_len: Length of high.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void art_range(art_t* art, const void* low, size_t low_len, const void* high,
+                size_t high_len, art_iter_t* iter);
+
+/*
+ * Function: art_prefix
+ * --------------------
+ *  Starts a scan of the keys beginning with prefix, the prefix itself
+ *  included. prefix must stay valid until the scan ends.
+ *
+ *  art: Pointer to the tree.
+ *  prefix: Prefix bytes.
+ *  prefix_len: Length of the prefix.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void art_prefix(art_t* art, const void* prefix, size_t prefix_len,
+                art_iter_t* iter);
+
+/*
+ * Function: art_iter_next
+ * --------------------
+ *  Gets the next key and value of a scan. The key points into the
+ *  iterator's buffer and is overwritten by the next call.
+ *
+ *  iter: Pointer to the iterator.
+ *  key: Output key, may be NULL.
+ *  key_len: Output key length, may be NULL.
+ *  value: Output value, may be NULL.
+ *
+ *  returns: True if a key was produced, false at the end of the scan.
+ */
+bool art_iter_next(art_iter_t* iter, const uint8_t** key, size_t* key_len,
+                void** value);
+
+/*
+ * Function: art_iter_close
+ * --------------------
+ *  Ends a scan early, freeing its buffers. Closing a finished scan does
+ *  nothing.
+ *
+ *  iter: Pointer to the iterator.
+ *
+ *  returns: Nothing.
+ */
+void art_iter_close(art_iter_t* iter);
+
+/*
+ * Function: art_size
+ * --------------------
+ *  Gets the number of keys.
+ *
+ *  art: Pointer to the tree.
+ *
+ *  returns: Number of keys.
+ */
+size_t art_size(art_t* art);
+
+/*
+ * Function: art_clean
+ * --------------------
+ *  Frees the tree.
+ *
+ *  art: Pointer to the tree.
+ *  free_value: Function to free values, may be NULL.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void art_clean(art_t* art, free_art_t free_value);
+
+/*
+ * Function: art_memory_usage
+ * --------------------
+ *  Gets the memory art uses by walking it. Inner nodes and their prefixes
+ *  are buckets, leaves with their key bytes are nodes. Values are not
+ *  counted, keys are, as the tree owns them.
+ *
+ *  art: Pointer to the tree.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t art_memory_usage(art_t* art, memory_usage_t* usage);
+
+/**** PRIVATE ****/
+/*
+ * Function: _art_new_node
+ * --------------------
+ *  Allocates an empty inner node of a type with a copy of a prefix.
+ *
+ *  returns: Pointer to the node.
+ */
+art_node_t* _art_new_node(art_t* art, art_type_t type, const uint8_t* prefix,
+                size_t prefix_len);
+
+/*
+ * Function: _art_free_node
+ * --------------------
+ *  Frees an inner node, not its children.
+ *
+ *  returns: Nothing.
+ */
+void _art_free_node(art_t* art, art_node_t* node);
+
+/*
+ * Function: _art_new_leaf
+ * --------------------
+ *  Allocates a leaf whose key bytes are two pieces joined around an edge
+ *  byte, the byte left out if edge is negative.
+ *
+ *  returns: Pointer to the leaf.
+ */
+art_leaf_t* _art_new_leaf(art_t* art, const uint8_t* head, size_t head_len,
+                int edge, const uint8_t* tail, size_t tail_len, void* value);
+
+/*
+ * Function: _art_free_leaf
+ * --------------------
+ *  Frees a leaf.
+ *
+ *  returns: Nothing.
+ */
+void _art_free_leaf(art_t* art, art_leaf_t* leaf);
+
+/*
+ * Function: _art_prefix
+ * --------------------
+ *  Gets the prefix bytes stored after an inner node.
+ *
+ *  returns: Pointer to the prefix.
+ */
+uint8_t* _art_prefix(art_node_t* node);
+
+/*
+ * Function: _art_lookup
+ * --------------------
+ *  Descends to the leaf of a key.
+ *
+ *  returns: Pointer to the leaf, NULL if the key is not in the tree.
+ */
+art_leaf_t* _art_lookup(art_t* art, const uint8_t* key, size_t key_len);
+
+/*
+ * Function: _art_place
+ * --------------------
+ *  Adds a key's remaining bytes below a new node with room, as its leaf if
+ *  none remain and as a child leaf under the first one otherwise.
+ *
+ *  returns: Nothing.
+ */
+void _art_place(art_t* art, art_node_t* node, const uint8_t* rest,
+                size_t rest_len, void* value);
+
+/*
+ * Function: _art_find_child
+ * --------------------
+ *  Gets the slot of the child under an edge byte.
+ *
+ *  returns: Pointer to the slot, NULL if there is no such child.
+ */
+void** _art_find_child(art_node_t* node, uint8_t byte);
+
+/*
+ * Function: _art_next_child
+ * --------------------
+ *  Gets the child with the smallest edge byte not less than byte.
+ *
+ *  returns: Pointer to the child, NULL if none, with its byte in edge.
+ */
+void* _art_next_child(art_node_t* node, size_t byte, uint8_t* edge);
+
+/*
+ * Function: _art_add_child
+ * --------------------
+ *  Adds a child under an edge byte, growing the node into ref if it is
+ *  full.
+ *
+ *  returns: Nothing.
+ */
+void _art_add_child(art_t* art, void** ref, art_node_t* node, uint8_t byte,
+                void* child);
+
+/*
+ * Function: _art_put_child
+ * --------------------
+ *  Adds a child under an edge byte to a node with room.
+ *
+ *  returns: Nothing.
+ */
+void _art_put_child(art_node_t* node, uint8_t byte, void* child);
+
+/*
+ * Function: _art_remove_child
+ * --------------------
+ *  Removes the child under an edge byte, shrinking the node into ref when
+ *  a smaller type fits.
+ *
+ *  returns: Nothing.
+ */
+void _art_remove_child(art_t* art, void** ref, art_node_t* node,
+                uint8_t byte);
+
+/*
+ * Function: _art_copy_node
+ * --------------------
+ *  Moves the leaf and children of a node into a new node of a type with a
+ *  new prefix, frees the old one and stores the new one in ref.
+ *
+ *  returns: Pointer to the new node.
+ */
+art_node_t* _art_copy_node(art_t* art, void** ref, art_node_t* node,
+                art_type_t type, const uint8_t* prefix, size_t prefix_len);
+
+/*
+ * Function: _art_collapse
+ * --------------------
+ *  Replaces a node left with a single entry by that entry, joining the
+ *  node's prefix and edge onto it.
+ *
+ *  returns: Nothing.
+ */
+void _art_collapse(art_t* art, void** ref, art_node_t* node);
+
+/*
+ * Function: _art_clean_child
+ * --------------------
+ *  Frees a child and the subtree under it.
+ *
+ *  returns: Nothing.
+ */
+void _art_clean_child(art_t* art, void* child, free_art_t free_value);
+
+/*
+ * Function: _art_usage_child
+ * --------------------
+ *  Accounts a child and the subtree under it.
+ *
+ *  returns: Nothing.
+ */
+void _art_usage_child(art_t* art, void* child, memory_usage_t* usage);
+
+/*
+ * Function: _art_push
+ * --------------------
+ *  Appends bytes to the key an iterator rebuilds.
+ *
+ *  returns: Nothing.
+ */
+void _art_push(art_iter_t* iter, const uint8_t* bytes, size_t len);
+
+/*
+ * Function: _art_enter
+ * --------------------
+ *  Pushes an inner node onto an iterator's path, its prefix already in the
+ *  key, to visit from edge next.
+ *
+ *  returns: Nothing.
+ */
+void _art_enter(art_iter_t* iter, art_node_t* node, uint16_t next);
+
+#endif
@@ -0,0 +1,343 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file benchmarks the RAG against synthetic lock workloads at
+         increasing scales. It measures RAG_insert and RAG_hard_insert
+         throughput, cycle detection latency through the wait chain
+         analytics, memory per node and the cost of building and cleaning
+         short lived graphs with and without an arena, printing one JSON
+         object per line.
+
+Build  : cc -O2 -I.. bench_RAG.c ../RAG.c ../hashtable.c ../dlinkedlist.c \
+             ../arena.c ../allocator.c ../slab.c ../pool.c ../queue.c \
+             ../waitchain.c ../workload.c -lm -lpthread -o bench_RAG
+Usage  : ./bench_RAG [max_nodes] [zipf_theta]
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <malloc.h>
+#include "RAG.h"
+#include "waitchain.h"
+#include "workload.h"
+
+#define DEFAULT_MAX_NODES 1000000
+#define EVENTS_PER_NODE 4
+#define TOP_K 16
+#define BUILD_NODES 256
+#define BUILD_ROUNDS 1000
+
+typedef struct bench_graph {
+    size_t n_processes;
+    size_t n_resources;
+    uint32_t* ids;
+    ckey_t* keys;
+    RAG_node_t** nodes;
+} bench_graph_t;
+
+/*
+ * Function: now_ns
+ * --------------------
+ *  Reads the monotonic clock.
+ *
+ *  returns: Time in nanoseconds.
+ */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Function: heap_bytes
+ * --------------------
+ *  Reads the bytes currently allocated on the heap, where glibc reports it.
+ *
+ *  returns: Allocated bytes, 0 if unknown.
+ */
+static size_t heap_bytes(void) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+static int key_compare(const void* a, const void* b) {
+    const ckey_t* key_a = a;
+    const ckey_t* key_b = b;
+    return !(key_a->type == key_b->type &&
+                *(uint32_t*)key_a->id == *(uint32_t*)key_b->id);
+}
+
+static size_t key_hash(const void* key) {
+    const ckey_t* ckey = key;
+    uint64_t hash = ((uint64_t)*(uint32_t*)ckey->id << 1) | ckey->type;
+    hash *= 0x9E3779B97F4A7C15ULL;
+    return (size_t)(hash ^ (hash >> 32));
+}
+
+/*
+ * Function: report
+ * --------------------
+ *  Prints one benchmark result as a JSON line.
+ *
+ *  returns: Nothing.
+ */
+static void report(const char* bench, size_t n_nodes, size_t ops,
+                uint64_t elapsed_ns, const char* extra) {
+    double ns_per_op = ops ? (double)elapsed_ns / (double)ops : 0.0;
+    printf("{\"suite\":\"RAG\",\"bench\":\"%s\",\"nodes\":%zu,\"ops\":%zu,"
+                "\"ns_per_op\":%.2f,\"ops_per_sec\":%.0f%s%s}\n",
+                bench, n_nodes, ops, ns_per_op,
+                ns_per_op > 0.0 ? 1e9 / ns_per_op : 0.0,
+                extra ? "," : "", extra ? extra : "");
+}
+
+/*
+ * Function: graph_keys
+ * --------------------
+ *  Creates keys for every process and resource of a workload, processes
+ *  first.
+ *
+ *  returns: Nothing.
+ */
+static void graph_keys(bench_graph_t* graph, workload_t* wl) {
+    graph->n_processes = workload_n_processes(wl);
+    graph->n_resources = workload_n_resources(wl);
+    size_t n = graph->n_processes + graph->n_resources;
+
+    graph->ids = malloc(sizeof(uint32_t) * n);
+    graph->keys = malloc(sizeof(ckey_t) * n);
+    graph->nodes = malloc(sizeof(RAG_node_t*) * n);
+
+    for (size_t i = 0; i < n; i++) {
+        bool process = i < graph->n_processes;
+        graph->ids[i] = (uint32_t)(process ? i : i - graph->n_processes);
+        graph->keys[i].type = process ? PROCESS_T : RESOURCE_T;
+        graph->keys[i].id = &graph->ids[i];
+    }
+}
+
+/*
+ * Function: graph_fill
+ * --------------------
+ *  Inserts every node into a RAG and resolves node pointers.
+ *
+ *  returns: Time taken in nanoseconds.
+ */
+static uint64_t graph_fill(bench_graph_t* graph, RAG_t* rag) {
+    size_t n = graph->n_processes + graph->n_resources;
+    uint64_t start = now_ns();
+
+    for (size_t i = 0; i < n; i++) {
+        RAG_insert(rag, &graph->keys[i], NULL, NULL);
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    for (size_t i = 0; i < n; i++) {
+        graph->nodes[i] = ht_search(rag->ht, &graph->keys[i]);
+    }
+
+    return elapsed;
+}
+
+/*
+ * Function: replay
+ * --------------------
+ *  Applies workload events as RAG edges, a grant points the resource at its
+ *  holder and a wait points the process at the resource. The RAG has no
+ *  edge removal, so releases are skipped.
+ *
+ *  returns: Number of RAG operations performed.
+ */
+static size_t replay(bench_graph_t* graph, RAG_t* rag,
+                workload_event_t* events, size_t n_events, bool hard) {
+    size_t ops = 0;
+
+    for (size_t i = 0; i < n_events; i++) {
+        size_t process = events[i].process;
+        size_t resource = graph->n_processes + events[i].resource;
+        ckey_t* key = NULL;
+        RAG_node_t* next = NULL;
+
+        if (events[i].op == WORKLOAD_ACQUIRE) {
+            key = &graph->keys[resource];
+            next = graph->nodes[process];
+        } else if (events[i].op == WORKLOAD_WAIT) {
+            key = &graph->keys[process];
+            next = graph->nodes[resource];
+        } else {
+            continue;
+        }
+
+        if (hard) {
+            RAG_hard_insert(rag, key, NULL, next);
+        } else {
+            RAG_insert(rag, key, NULL, next);
+        }
+        ops++;
+    }
+
+    return ops;
+}
+
+/*
+ * Function: bench_scale
+ * --------------------
+ *  Runs every RAG benchmark at one scale.
+ *
+ *  returns: Nothing.
+ */
+static void bench_scale(size_t n_processes, double theta) {
+    workload_config_t config;
+    bench_graph_t graph;
+    char extra[256];
+    size_t n_events = n_processes * EVENTS_PER_NODE;
+
+    workload_default_config(&config, n_processes,
+                n_processes / 2 ? n_processes / 2 : 1);
+    config.zipf_theta = theta;
+    config.n_cycles = 64;
+    config.cycle_interval = n_events / config.n_cycles ?
+                n_events / config.n_cycles : 1;
+
+    workload_t* wl = workload_create(&config);
+    workload_event_t* events = malloc(sizeof(workload_event_t) * n_events);
+    workload_generate(wl, events, n_events);
+    graph_keys(&graph, wl);
+    size_t n_nodes = graph.n_processes + graph.n_resources;
+
+    // Node insertion and memory per node
+    size_t heap_before = heap_bytes();
+    RAG_t* rag = RAG_create(key_compare, key_hash);
+    uint64_t elapsed = graph_fill(&graph, rag);
+    size_t heap_after = heap_bytes();
+
+    if (heap_after > heap_before) {
+        snprintf(extra, sizeof(extra), "\"bytes_per_node\":%.1f",
+                    (double)(heap_after - heap_before) / (double)n_nodes);
+    } else {
+        snprintf(extra, sizeof(extra), "\"bytes_per_node\":null");
+    }
+    report("RAG_insert_node", n_nodes, n_nodes, elapsed, extra);
+
+    // Edge insertion, RAG_insert only fills in missing edges
+    uint64_t start = now_ns();
+    size_t ops = replay(&graph, rag, events, n_events, false);
+    report("RAG_insert_edge", n_nodes, ops, now_ns() - start, NULL);
+    RAG_clean(rag, NULL, NULL);
+
+    // Edge insertion, RAG_hard_insert overwrites edges
+    rag = RAG_create(key_compare, key_hash);
+    graph_fill(&graph, rag);
+    start = now_ns();
+    ops = replay(&graph, rag, events, n_events, true);
+    report("RAG_hard_insert", n_nodes, ops, now_ns() - start, NULL);
+    RAG_clean(rag, NULL, NULL);
+
+    // Detection latency, from the edge closing a cycle to it being reported
+    rag = RAG_create(key_compare, key_hash);
+    graph_fill(&graph, rag);
+    wait_chain_t* wc = wait_chain_create(rag);
+    uint64_t total = 0, worst = 0;
+    size_t detected = 0, cycles = 0;
+
+    start = now_ns();
+    for (size_t i = 0; i < n_events; i++) {
+        if (!events[i].closes_cycle) {
+            replay(&graph, rag, &events[i], 1, true);
+            continue;
+        }
+
+        uint64_t begin = now_ns();
+        replay(&graph, rag, &events[i], 1, true);
+        bool deadlocked = wait_chain_deadlocked(wc,
+                    graph.nodes[events[i].process]);
+        uint64_t latency = now_ns() - begin;
+
+        cycles++;
+        detected += deadlocked;
+        total += latency;
+        worst = latency > worst ? latency : worst;
+    }
+    uint64_t replay_elapsed = now_ns() - start;
+
+    snprintf(extra, sizeof(extra), "\"cycles\":%zu,\"detected\":%zu,"
+                "\"max_ns\":%llu", cycles, detected, (unsigned long long)worst);
+    report("detect_cycle", n_nodes, cycles, total, extra);
+    report("hard_insert_tracked", n_nodes, n_events, replay_elapsed, NULL);
+
+    // Full top-k scan, as a once a second sampler would run it
+    wait_chain_entry_t entries[TOP_K];
+    start = now_ns();
+    size_t n_entries = wait_chain_top_k(wc, TOP_K, entries);
+    snprintf(extra, sizeof(extra), "\"longest\":%zu",
+                n_entries ? entries[0].depth : 0);
+    report("wait_chain_top_k", n_nodes, 1, now_ns() - start, extra);
+
+    wait_chain_clean(wc);
+    RAG_clean(rag, NULL, NULL);
+
+    free(graph.ids);
+    free(graph.keys);
+    free(graph.nodes);
+    free(events);
+    workload_clean(wl);
+}
+
+/*
+ * Function: bench_build_clean
+ * --------------------
+ *  Builds and cleans many small graphs with owned keys, as the analysis
+ *  passes do, once with the default allocator and once in arena mode.
+ *
+ *  returns: Nothing.
+ */
+static void bench_build_clean(void) {
+    for (int arena = 0; arena <= 1; arena++) {
+        uint64_t start = now_ns();
+
+        for (size_t round = 0; round < BUILD_ROUNDS; round++) {
+            RAG_t* rag = arena ? RAG_create_arena(key_compare, key_hash) :
+                        RAG_create(key_compare, key_hash);
+            RAG_node_t* prev = NULL;
+
+            for (uint32_t i = 0; i < BUILD_NODES; i++) {
+                ckey_t* key = RAG_create_key(rag, i & 1 ? RESOURCE_T :
+                            PROCESS_T, &i, sizeof(i));
+                RAG_insert(rag, key, NULL, prev);
+                prev = ht_search(rag->ht, key);
+            }
+
+            RAG_clean(rag, NULL, NULL);
+        }
+
+        report(arena ? "build_clean_arena" : "build_clean_default",
+                    BUILD_NODES, BUILD_ROUNDS * BUILD_NODES, now_ns() - start,
+                    NULL);
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t max_nodes = DEFAULT_MAX_NODES;
+    double theta = 0.99;
+
+    if (argc > 1) {
+        max_nodes = strtoull(argv[1], NULL, 10);
+    }
+    if (argc > 2) {
+        theta = strtod(argv[2], NULL);
+    }
+
+    for (size_t n = 1000; n <= max_nodes; n *= 10) {
+        bench_scale(n, theta);
+    }
+    bench_build_clean();
+
+    return 0;
+}
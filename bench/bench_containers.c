@@ -0,0 +1,981 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file benchmarks every container at sizes from 1K elements up
+         to a given maximum, 100M when memory allows. It measures insert,
+         lookup hit and miss, remove, iterate, resize and clean, reporting
+         ns/op, allocations per op, container bytes per element and, where
+         the kernel permits, cache, branch and dTLB misses per op.
+
+         Lookups follow a uniform or a Zipfian access pattern, every other
+         operation visits each element once and is reported with dist "seq".
+         Keys live in caller arrays, so bytes per element is the container's
+         own overhead, counted through a counting allocator over the default
+         thread allocator.
+
+Build  : cc -O2 -I.. bench_containers.c bench_util.c ../hashtable.c \
+             ../dlinkedlist.c ../queue.c ../stack.c ../vqueue.c ../vstack.c \
+             ../vdlinkedlist.c ../deque.c ../vector.c ../bptree.c ../art.c \
+             ../roaring.c ../arena.c ../allocator.c ../slab.c ../pool.c \
+             ../workload.c -lm -lpthread -o bench_containers
+Usage  : ./bench_containers [max_elements] [json|csv] [zipf_theta]
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "bench_util.h"
+#include "hashtable.h"
+#include "dlinkedlist.h"
+#include "queue.h"
+#include "stack.h"
+#include "vqueue.h"
+#include "deque.h"
+#include "vstack.h"
+#include "vdlinkedlist.h"
+#include "vector.h"
+#include "bptree.h"
+#include "art.h"
+#include "roaring.h"
+#include "workload.h"
+
+#define DEFAULT_MAX_ELEMENTS 1000000
+#define MIN_ELEMENTS 1000
+// Keys visited by each short range scan
+#define RANGE_SPAN 100
+// Width of a URL key slot, the keys themselves are shorter
+#define URL_BYTES 64
+// Users in URL keys, each user's keys share a prefix
+#define URL_USERS 1000
+// Odd and not a multiple of 5, so i * ID_STRIDE % n permutes 0 .. n - 1
+// for every power of ten n
+#define ID_STRIDE 0x9E3779B1ULL
+
+typedef struct bench_ctx {
+    size_t n;
+    uint64_t* keys;
+    // Keys never inserted, for lookup misses
+    uint64_t* misses;
+    // Lookup sequences as indices into keys
+    uint32_t* uniform;
+    uint32_t* zipf;
+    bench_counters_t counters;
+    bench_alloc_stats_t stats;
+    allocator_t allocator;
+    // State of the measurement in progress
+    uint64_t start;
+    size_t allocs;
+    size_t live_bytes;
+} bench_ctx_t;
+
+// Folds lookup results so the compiler keeps the loops
+static volatile uint64_t sink;
+
+static int key_compare(const void* a, const void* b) {
+    return *(const uint64_t*)a != *(const uint64_t*)b;
+}
+
+static size_t key_hash(const void* key) {
+    uint64_t hash = *(const uint64_t*)key * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(hash ^ (hash >> 32));
+}
+
+static int key_order(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static int url_compare(const void* a, const void* b) {
+    return strcmp(a, b);
+}
+
+static size_t url_hash(const void* key) {
+    // FNV-1a
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (const unsigned char* c = key; *c; c++) {
+        hash = (hash ^ *c) * 0x100000001B3ULL;
+    }
+    return (size_t)hash;
+}
+
+/*
+ * Function: url_keys
+ * --------------------
+ *  Spells integer keys as URLs sharing a site and a per user prefix, one
+ *  per URL_BYTES slot.
+ *
+ *  returns: Pointer to the slots.
+ */
+static char* url_keys(const uint64_t* keys, size_t n) {
+    char* urls = malloc(URL_BYTES * n);
+    if (!urls) {
+        perror("bench_containers");
+        exit(1);
+    }
+    for (size_t i = 0; i < n; i++) {
+        snprintf(urls + URL_BYTES * i, URL_BYTES,
+                    "https://www.example.com/users/%04u/items/%016llx",
+                    (unsigned)((keys[i] >> 40) % URL_USERS),
+                    (unsigned long long)keys[i]);
+    }
+    return urls;
+}
+
+/*
+ * Function: begin
+ * --------------------
+ *  Starts measuring a benchmark.
+ *
+ *  returns: Nothing.
+ */
+static void begin(bench_ctx_t* ctx) {
+    ctx->allocs = ctx->stats.n_allocs;
+    ctx->live_bytes = ctx->stats.live_bytes;
+    bench_counters_start(&ctx->counters);
+    ctx->start = bench_now_ns();
+}
+
+/*
+ * Function: end
+ * --------------------
+ *  Stops measuring a benchmark and reports it. Bytes per element is taken
+ *  from the larger of the live bytes before and after, so both building
+ *  and cleaning report the size of the full container.
+ *
+ *  returns: Nothing.
+ */
+static void end(bench_ctx_t* ctx, const char* suite, const char* bench,
+                const char* dist, size_t ops) {
+    uint64_t elapsed = bench_now_ns() - ctx->start;
+    bench_counters_stop(&ctx->counters);
+    size_t live = ctx->stats.live_bytes > ctx->live_bytes ?
+                ctx->stats.live_bytes : ctx->live_bytes;
+
+    bench_result_t result = {
+        .suite = suite,
+        .bench = bench,
+        .dist = dist,
+        .n_elements = ctx->n,
+        .ops = ops,
+        .elapsed_ns = elapsed,
+        .n_allocs = ctx->stats.n_allocs - ctx->allocs,
+        .bytes_per_elem = (double)live / (double)ctx->n,
+        .counters = &ctx->counters
+    };
+    bench_report(&result);
+}
+
+/*
+ * Function: ctx_init
+ * --------------------
+ *  Generates distinct keys, miss keys and lookup sequences for one size.
+ *
+ *  returns: Nothing.
+ */
+static void ctx_init(bench_ctx_t* ctx, size_t n, double theta) {
+    uint64_t state = 0x5EED ^ n;
+    zipf_t zipf;
+
+    ctx->n = n;
+    ctx->keys = malloc(sizeof(uint64_t) * n);
+    ctx->misses = malloc(sizeof(uint64_t) * n);
+    ctx->uniform = malloc(sizeof(uint32_t) * n);
+    ctx->zipf = malloc(sizeof(uint32_t) * n);
+    if (!ctx->keys || !ctx->misses || !ctx->uniform || !ctx->zipf) {
+        perror("bench_containers");
+        exit(1);
+    }
+
+    // Even keys are present and odd keys are misses, both scattered
+    for (size_t i = 0; i < n; i++) {
+        uint64_t scattered = (uint64_t)i * 0x9E3779B97F4A7C15ULL;
+        ctx->keys[i] = scattered & ~1ULL;
+        ctx->misses[i] = scattered | 1ULL;
+    }
+
+    // Hot Zipfian ranks map to scattered keys rather than insertion order
+    zipf_init(&zipf, n, theta);
+    for (size_t i = 0; i < n; i++) {
+        ctx->uniform[i] = (uint32_t)(workload_rand(&state) % n);
+        size_t rank = zipf_next(&zipf, &state);
+        ctx->zipf[i] = (uint32_t)((rank * 0x9E3779B1ULL) % n);
+    }
+}
+
+/*
+ * Function: ctx_clean
+ * --------------------
+ *  Frees the keys and lookup sequences of one size.
+ *
+ *  returns: Nothing.
+ */
+static void ctx_clean(bench_ctx_t* ctx) {
+    free(ctx->keys);
+    free(ctx->misses);
+    free(ctx->uniform);
+    free(ctx->zipf);
+}
+
+/*
+ * Function: ht_fill
+ * --------------------
+ *  Creates a hashtable holding every key.
+ *
+ *  returns: Pointer to the hashtable.
+ */
+static hashtable_t* ht_fill(bench_ctx_t* ctx) {
+    hashtable_t* ht = ht_create_with_allocator(INITIAL_TABLE_SIZE,
+                key_compare, key_hash, &ctx->allocator);
+
+    for (size_t i = 0; i < ctx->n; i++) {
+        ht_insert(ht, &ctx->keys[i], &ctx->keys[i]);
+    }
+    return ht;
+}
+
+/*
+ * Function: bench_hashtable
+ * --------------------
+ *  Runs the hashtable benchmarks.
+ *
+ *  returns: Nothing.
+ */
+static void bench_hashtable(bench_ctx_t* ctx) {
+    const char* dists[] = {"uniform", "zipf"};
+    uint32_t* sequences[] = {ctx->uniform, ctx->zipf};
+    uint64_t sum = 0;
+    size_t n = ctx->n;
+
+    // Insert from the initial size, so resizes are included
+    begin(ctx);
+    hashtable_t* ht = ht_fill(ctx);
+    end(ctx, "hashtable", "insert", "seq", n);
+
+    for (int d = 0; d < 2; d++) {
+        begin(ctx);
+        for (size_t i = 0; i < n; i++) {
+            sum += ht_search(ht, &ctx->keys[sequences[d][i]]) != NULL;
+        }
+        end(ctx, "hashtable", "lookup_hit", dists[d], n);
+
+        begin(ctx);
+        for (size_t i = 0; i < n; i++) {
+            sum += ht_search(ht, &ctx->misses[sequences[d][i]]) != NULL;
+        }
+        end(ctx, "hashtable", "lookup_miss", dists[d], n);
+    }
+
+    begin(ctx);
+    for (size_t b = 0; b < ht->size; b++) {
+        for (ht_node_t* node = ht->table[b]; node; node = node->next) {
+            sum += *(uint64_t*)node->key;
+        }
+    }
+    end(ctx, "hashtable", "iterate", "seq", n);
+
+    // One growth step, per element rehashed
+    begin(ctx);
+    _resize_ht(ht);
+    end(ctx, "hashtable", "resize", "seq", n);
+
+    begin(ctx);
+    for (size_t i = 0; i < n; i++) {
+        ht_remove(ht, &ctx->keys[i], NULL, NULL);
+    }
+    end(ctx, "hashtable", "remove", "seq", n);
+    ht_clean(ht, NULL, NULL);
+
+    ht = ht_fill(ctx);
+    begin(ctx);
+    ht_clean(ht, NULL, NULL);
+    end(ctx, "hashtable", "clean", "seq", n);
+
+    sink += sum;
+}
+
+/*
+ * Function: bench_dlinkedlist
+ * --------------------
+ *  Runs the doubly linked list benchmarks.
+ *
+ *  returns: Nothing.
+ */
+static void bench_dlinkedlist(bench_ctx_t* ctx) {
+    uint64_t sum = 0;
+    size_t n = ctx->n;
+    DLL_t* dll = DLL_create_with_allocator(&ctx->allocator);
+
+    begin(ctx);
+    for (size_t i = 0; i < n; i++) {
+        DLL_insert_tail(dll, &ctx->keys[i]);
+    }
+    end(ctx, "dlinkedlist", "insert_tail", "seq", n);
+
+    begin(ctx);
+    for (DLL_node_t* node = dll->head; node; node = node->next) {
+        sum += *(uint64_t*)node->data;
+    }
+    end(ctx, "dlinkedlist", "iterate", "seq", n);
+
+    begin(ctx);
+    while (DLL_pop(dll)) {
+    }
+    end(ctx, "dlinkedlist", "pop", "seq", n);
+
+    begin(ctx);
+    for (size_t i = 0; i < n; i++) {
+        DLL_insert_head(dll, &ctx->keys[i]);
+    }
+    end(ctx, "dlinkedlist", "insert_head", "seq", n);
+
+    begin(ctx);
+    while (DLL_dequeue(dll)) {
+    }
+    end(ctx, "dlinkedlist", "dequeue", "seq", n);
+
+    for (size_t i = 0; i < n; i++) {
+        DLL_insert_tail(dll, &ctx->keys[i]);
+    }
+    begin(ctx);
+    DLL_clean(dll, NULL);
+    end(ctx, "dlinkedlist", "clean", "seq", n);
+
+    sink += sum;
+}
+
+/*
+ * Function: bench_deque
+ * --------------------
+ *  Runs the doubly linked list benchmarks against a deque of pointers,
+ *  through its DLL style functions.
+ *
+ *  returns: Nothing.
+ */
+static void bench_deque(bench_ctx_t* ctx) {
+    uint64_t sum = 0;
+    size_t n = ctx->n;
+    deque_t* dq = deque_create_with_allocator(sizeof(void*), &ctx->allocator);
+
+    begin(ctx);
+    for (size_t i = 0; i < n; i++) {
+        deque_insert_tail(dq, &ctx->keys[i]);
+    }
+    end(ctx, "deque", "insert_tail", "seq", n);
+
+    begin(ctx);
+    for (size_t i = 0; i < n; i++) {
+        sum += **(uint64_t**)deque_get(dq, i);
+    }
+    end(ctx, "deque", "iterate", "seq", n);
+
+    begin(ctx);
+    while (deque_pop(dq)) {
+    }
+    end(ctx, "deque", "pop", "seq", n);
+
+    begin(ctx);
+    for (size_t i = 0; i < n; i++) {
+        deque_insert_head(dq, &ctx->keys[i]);
+    }
+    end(ctx, "deque", "insert_head", "seq", n);
+
+    begin(ctx);
+    while (deque_dequeue(dq)) {
+    }
+    end(ctx, "deque", "dequeue", "seq", n);
+
+    for (size_t i = 0; i < n; i++) {
+        deque_insert_tail(dq, &ctx->keys[i]);
+    }
+    begin(ctx);
+    deque_clean(dq, NULL);
+    end(ctx, "deque", "clean", "seq", n);
+
+    sink += sum;
+}
+
+/*
+ * Function: bench_queue
+ * --------------------
+ *  Runs the queue benchmarks.
+ *
+ *  returns: Nothing.
+ */
+static void bench_queue(bench_ctx_t* ctx) {
+    uint64_t sum = 0;
+    size_t n = ctx->n;
+    queue_t* queue = queue_create_with_allocator(&ctx->allocator);
+
+    begin(ctx);
+    for (size_t i = 0; i < n; i++) {
+        queue_enqueue(queue, &ctx->keys[i]);
+    }
+    end(ctx, "queue", "enqueue", "seq", n);
+
+    begin(ctx);
+    for (queue_node_t* node = queue->head; node; node = node->next) {
+        sum += *(uint64_t*)node->data;
+    }
+    end(ctx, "queue", "iterate", "seq", n);
+
+    begin(ctx);
+    while (!queue_is_empty(queue)) {
+        queue_dequeue(queue);
+    }
+    end(ctx, "queue", "dequeue", "seq", n);
+
+    for (size_t i = 0; i < n; i++) {
+        queue_enqueue(queue, &ctx->keys[i]);
+    }
+    begin(ctx);
+    queue_clean(queue, NULL);
+    end(ctx, "queue", "clean", "seq", n);
+
+    sink += sum;
+}
+
+/*
+ * Function: bench_stack
+ * --------------------
+ *  Runs the stack benchmarks.
+ *
+ *  returns: Nothing.
+ */
+static void bench_stack(bench_ctx_t* ctx) {
+    uint64_t sum = 0;
+    size_t n = ctx->n;
+    stack_t* stack = stack_create_with_allocator(&ctx->allocator);
+
+    begin(ctx);
+    for (size_t i = 0; i < n; i++) {
+        stack_push(stack, &ctx->keys[i]);
+    }
+    end(ctx, "stack", "push", "seq", n);
+
+    begin(ctx);
+    for (stack_node_t* node = stack->head; node; node = node->next) {
+        sum += *(uint64_t*)node->data;
+    }
+    end(ctx, "stack", "iterate", "seq", n);
+
+    begin(ctx);
+    while (!stack_is_empty(stack)) {
+        stack_pop(stack);
+    }
+    end(ctx, "stack", "pop", "seq", n);
+
+    for (size_t i = 0; i < n; i++) {
+        stack_push(stack, &ctx->keys[i]);
+    }
+    begin(ctx);
+    stack_clean(stack, NULL);
+    end(ctx, "stack", "clean", "seq", n);
+
+    sink += sum;
+}
+
+/*
+ * Function: bench_bptree
+ * --------------------
+ *  Runs the B+-tree benchmarks on integer keys, with the same lookups as
+ *  the hashtable's for comparison.
+ *
+ *  returns: Nothing.
+ */
+static void bench_bptree(bench_ctx_t* ctx) {
+    const char* dists[] = {"uniform", "zipf"};
+    uint32_t* sequences[] = {ctx->uniform, ctx->zipf};
+    uint64_t sum = 0;
+    size_t n = ctx->n;
+    void* key;
+
+    bptree_t* bt = bptree_create_with_allocator(NULL, &ctx->allocator);
+    begin(ctx);
+    for (size_t i = 0; i < n; i++) {
+        bptree_insert(bt, BPTREE_INT_KEY(ctx->keys[i]), &ctx->keys[i]);
+    }
+    end(ctx, "bptree", "insert", "seq", n);
+
+    for (int d = 0; d < 2; d++) {
+        begin(ctx);
+        for (size_t i = 0; i < n; i++) {
+            uint64_t k = ctx->keys[sequences[d][i]];
+            sum += bptree_search(bt, BPTREE_INT_KEY(k)) != NULL;
+        }
+        end(ctx, "bptree", "lookup_hit", dists[d], n);
+
+        begin(ctx);
+        for (size_t i = 0; i < n; i++) {
+            uint64_t k = ctx->misses[sequences[d][i]];
+            sum += bptree_search(bt, BPTREE_INT_KEY(k)) != NULL;
+        }
+        end(ctx, "bptree", "lookup_miss", dists[d], n);
+    }
+
+    bptree_iter_t iter;
+    begin(ctx);
+    bptree_iter_first(bt, &iter);
+    while (bptree_iter_next(&iter, &key, NULL)) {
+        sum += (uint64_t)(uintptr_t)key;
+    }
+    end(ctx, "bptree", "iterate", "seq", n);
+
+    // Short scans from uniform keys, per key visited
+    size_t n_scans = n / RANGE_SPAN, visited = 0;
+    begin(ctx);
+    for (size_t i = 0; i < n_scans; i++) {
+        bptree_iter_seek(bt, BPTREE_INT_KEY(ctx->keys[ctx->uniform[i]]),
+                    &iter);
+        for (size_t j = 0; j < RANGE_SPAN &&
+                    bptree_iter_next(&iter, &key, NULL); j++) {
+            sum += (uint64_t)(uintptr_t)key;
+            visited++;
+        }
+    }
+    end(ctx, "bptree", "range", "uniform", visited);
+
+    begin(ctx);
+    for (size_t i = 0; i < n; i++) {
+        bptree_remove(bt, BPTREE_INT_KEY(ctx->keys[i]), NULL, NULL);
+    }
+    end(ctx, "bptree", "remove", "seq", n);
+    bptree_clean(bt, NULL, NULL);
+
+    // Bulk loading takes sorted input, the sort is not timed
+    void** keys = malloc(sizeof(void*) * n);
+    uint64_t* sorted = malloc(sizeof(uint64_t) * n);
+    if (!keys || !sorted) {
+        perror("bench_containers");
+        exit(1);
+    }
+    memcpy(sorted, ctx->keys, sizeof(uint64_t) * n);
+    qsort(sorted, n, sizeof(uint64_t), key_order);
+    for (size_t i = 0; i < n; i++) {
+        keys[i] = BPTREE_INT_KEY(sorted[i]);
+    }
+
+    bt = bptree_create_with_allocator(NULL, &ctx->allocator);
+    begin(ctx);
+    bptree_bulk_load(bt, keys, keys, n);
+    end(ctx, "bptree", "bulk_load", "seq", n);
+
+    begin(ctx);
+    bptree_clean(bt, NULL, NULL);
+    end(ctx, "bptree", "clean", "seq", n);
+
+    free(keys);
+    free(sorted);
+    sink += sum;
+}
+
+/*
+ * Function: bench_art
+ * --------------------
+ *  Runs the adaptive radix tree benchmarks on URL keys with long shared
+ *  prefixes, next to a hashtable over the same keys. The tree copies its
+ *  keys, so the hashtable's keys are copied through the counted allocator
+ *  too and both report bytes per element with the keys included.
+ *
+ *  returns: Nothing.
+ */
+static void bench_art(bench_ctx_t* ctx) {
+    const char* dists[] = {"uniform", "zipf"};
+    uint32_t* sequences[] = {ctx->uniform, ctx->zipf};
+    uint64_t sum = 0;
+    size_t n = ctx->n, key_len;
+    char* urls = url_keys(ctx->keys, n);
+    char* misses = url_keys(ctx->misses, n);
+    const uint8_t* key;
+
+    art_t* art = art_create_with_allocator(&ctx->allocator);
+    begin(ctx);
+    for (size_t i = 0; i < n; i++) {
+        const char* url = urls + URL_BYTES * i;
+        art_insert(art, url, strlen(url), &ctx->keys[i]);
+    }
+    end(ctx, "art", "insert", "seq", n);
+
+    for (int d = 0; d < 2; d++) {
+        begin(ctx);
+        for (size_t i = 0; i < n; i++) {
+            const char* url = urls + URL_BYTES * sequences[d][i];
+            sum += art_search(art, url, strlen(url)) != NULL;
+        }
+        end(ctx, "art", "lookup_hit", dists[d], n);
+
+        begin(ctx);
+        for (size_t i = 0; i < n; i++) {
+            const char* url = misses + URL_BYTES * sequences[d][i];
+            sum += art_search(art, url, strlen(url)) != NULL;
+        }
+        end(ctx, "art", "lookup_miss", dists[d], n);
+    }
+
+    art_iter_t iter;
+    begin(ctx);
+    art_iter_first(art, &iter);
+    while (art_iter_next(&iter, &key, &key_len, NULL)) {
+        sum += key_len;
+    }
+    end(ctx, "art", "iterate", "seq", n);
+
+    // Every key of one user, per key visited
+    size_t n_scans = n / RANGE_SPAN, visited = 0;
+    begin(ctx);
+    for (size_t i = 0; i < n_scans; i++) {
+        const char* url = urls + URL_BYTES * ctx->uniform[i];
+        // Up to and including the slash after the user
+        size_t prefix_len = strchr(url + strlen("https://www.example.com/"
+                    "users/"), '/') - url + 1;
+        art_prefix(art, url, prefix_len, &iter);
+        while (art_iter_next(&iter, &key, &key_len, NULL)) {
+            sum += key_len;
+            visited++;
+        }
+    }
+    end(ctx, "art", "prefix", "uniform", visited);
+
+    begin(ctx);
+    for (size_t i = 0; i < n; i++) {
+        const char* url = urls + URL_BYTES * i;
+        art_remove(art, url, strlen(url), NULL);
+    }
+    end(ctx, "art", "remove", "seq", n);
+    art_clean(art, NULL);
+
+    char** copies = malloc(sizeof(char*) * n);
+    if (!copies) {
+        perror("bench_containers");
+        exit(1);
+    }
+    hashtable_t* ht = ht_create_with_allocator(INITIAL_TABLE_SIZE,
+                url_compare, url_hash, &ctx->allocator);
+    begin(ctx);
+    for (size_t i = 0; i < n; i++) {
+        const char* url = urls + URL_BYTES * i;
+        size_t size = strlen(url) + 1;
+        copies[i] = allocator_alloc(&ctx->allocator, size);
+        memcpy(copies[i], url, size);
+        ht_insert(ht, copies[i], &ctx->keys[i]);
+    }
+    end(ctx, "hashtable_url", "insert", "seq", n);
+
+    for (int d = 0; d < 2; d++) {
+        begin(ctx);
+        for (size_t i = 0; i < n; i++) {
+            sum += ht_search(ht, urls + URL_BYTES * sequences[d][i]) != NULL;
+        }
+        end(ctx, "hashtable_url", "lookup_hit", dists[d], n);
+
+        begin(ctx);
+        for (size_t i = 0; i < n; i++) {
+            sum += ht_search(ht, misses + URL_BYTES * sequences[d][i]) != NULL;
+        }
+        end(ctx, "hashtable_url", "lookup_miss", dists[d], n);
+    }
+
+    ht_clean(ht, NULL, NULL);
+    for (size_t i = 0; i < n; i++) {
+        allocator_free(&ctx->allocator, copies[i], strlen(copies[i]) + 1);
+    }
+    free(copies);
+    free(urls);
+    free(misses);
+    sink += sum;
+}
+
+/*
+ * Function: roaring_ids
+ * --------------------
+ *  Generates n ids and n missing ids. Dense ids are about half of
+ *  0 .. 2n - 1, picked by a hash bit, the way ids of live graph nodes
+ *  thin out. Sparse ids are spread over the whole 32 bit range.
+ *
+ *  returns: Nothing.
+ */
+static void roaring_ids(bench_ctx_t* ctx, bool dense, uint32_t* ids,
+                uint32_t* misses) {
+    size_t n = ctx->n, n_ids = 0, n_misses = 0;
+
+    if (!dense) {
+        for (size_t i = 0; i < n; i++) {
+            ids[i] = (uint32_t)(ctx->keys[i] >> 32);
+            misses[i] = ids[i] + 1;
+        }
+        return;
+    }
+
+    for (uint64_t v = 0; n_ids < n || n_misses < n; v++) {
+        uint64_t hash = v * 0x9E3779B97F4A7C15ULL;
+        if ((hash >> 63) ? n_ids < n : n_misses == n) {
+            ids[n_ids++] = (uint32_t)v;
+        } else {
+            misses[n_misses++] = (uint32_t)v;
+        }
+    }
+}
+
+/*
+ * Function: bench_roaring
+ * --------------------
+ *  Runs the compressed bitmap benchmarks over dense and sparse 32 bit ids.
+ *  Ids are inserted in a scattered order, set operations combine the ids
+ *  with the missing ids and are reported per id.
+ *
+ *  returns: Nothing.
+ */
+static void bench_roaring(bench_ctx_t* ctx) {
+    const char* dists[] = {"uniform", "zipf"};
+    const char* suites[] = {"roaring_dense", "roaring_sparse"};
+    uint32_t* sequences[] = {ctx->uniform, ctx->zipf};
+    uint64_t sum = 0;
+    size_t n = ctx->n;
+    uint32_t* ids = malloc(sizeof(uint32_t) * n);
+    uint32_t* misses = malloc(sizeof(uint32_t) * n);
+    if (!ids || !misses) {
+        perror("bench_containers");
+        exit(1);
+    }
+
+    for (int k = 0; k < 2; k++) {
+        const char* suite = suites[k];
+        roaring_ids(ctx, k == 0, ids, misses);
+
+        roaring_t* r = roaring_create_with_allocator(&ctx->allocator);
+        begin(ctx);
+        for (size_t i = 0; i < n; i++) {
+            roaring_add(r, ids[(i * ID_STRIDE) % n]);
+        }
+        end(ctx, suite, "insert", "seq", n);
+
+        for (int d = 0; d < 2; d++) {
+            begin(ctx);
+            for (size_t i = 0; i < n; i++) {
+                sum += roaring_contains(r, ids[sequences[d][i]]);
+            }
+            end(ctx, suite, "lookup_hit", dists[d], n);
+
+            begin(ctx);
+            for (size_t i = 0; i < n; i++) {
+                sum += roaring_contains(r, misses[sequences[d][i]]);
+            }
+            end(ctx, suite, "lookup_miss", dists[d], n);
+        }
+
+        roaring_iter_t iter;
+        uint32_t value;
+        begin(ctx);
+        roaring_iter_init(r, &iter);
+        while (roaring_iter_next(&iter, &value)) {
+            sum += value;
+        }
+        end(ctx, suite, "iterate", "seq", n);
+
+        begin(ctx);
+        for (size_t i = 0; i < n / RANGE_SPAN; i++) {
+            sum += roaring_rank(r, ids[ctx->uniform[i]]);
+        }
+        end(ctx, suite, "rank", "uniform", n / RANGE_SPAN);
+
+        roaring_t* other = roaring_create_with_allocator(&ctx->allocator);
+        for (size_t i = 0; i < n; i++) {
+            roaring_add(other, misses[i]);
+        }
+        const char* ops[] = {"and", "or", "xor", "andnot"};
+        roaring_t* (* op_fns[])(const roaring_t*, const roaring_t*) = {
+            roaring_and, roaring_or, roaring_xor, roaring_andnot
+        };
+        for (int o = 0; o < 4; o++) {
+            begin(ctx);
+            roaring_t* result = op_fns[o](r, other);
+            end(ctx, suite, ops[o], "seq", n);
+            sum += roaring_cardinality(result);
+            roaring_clean(result);
+        }
+        roaring_clean(other);
+
+        size_t size = roaring_serialized_size(r);
+        void* buf = malloc(size);
+        if (!buf) {
+            perror("bench_containers");
+            exit(1);
+        }
+        begin(ctx);
+        sum += roaring_serialize(r, buf);
+        end(ctx, suite, "serialize", "seq", n);
+
+        begin(ctx);
+        roaring_t* copy = roaring_deserialize(buf, size, &ctx->allocator);
+        end(ctx, suite, "deserialize", "seq", n);
+        roaring_clean(copy);
+        free(buf);
+
+        begin(ctx);
+        for (size_t i = 0; i < n; i++) {
+            roaring_remove(r, ids[i]);
+        }
+        end(ctx, suite, "remove", "seq", n);
+        roaring_clean(r);
+
+        r = roaring_create_with_allocator(&ctx->allocator);
+        for (size_t i = 0; i < n; i++) {
+            roaring_add(r, ids[i]);
+        }
+        begin(ctx);
+        roaring_clean(r);
+        end(ctx, suite, "clean", "seq", n);
+    }
+
+    free(ids);
+    free(misses);
+    sink += sum;
+}
+
+/*
+ * Function: bench_by_value
+ * --------------------
+ *  Runs the by value queue, stack, list and vector benchmarks, storing the
+ *  keys themselves rather than pointers to them.
+ *
+ *  returns: Nothing.
+ */
+static void bench_by_value(bench_ctx_t* ctx) {
+    uint64_t sum = 0, key;
+    size_t n = ctx->n;
+
+    vqueue_t* queue = vqueue_create_with_allocator(sizeof(uint64_t),
+                &ctx->allocator);
+    begin(ctx);
+    for (size_t i = 0; i < n; i++) {
+        vqueue_enqueue(queue, &ctx->keys[i]);
+    }
+    end(ctx, "vqueue", "enqueue", "seq", n);
+
+    begin(ctx);
+    while (vqueue_dequeue(queue, &key)) {
+        sum += key;
+    }
+    end(ctx, "vqueue", "dequeue", "seq", n);
+    vqueue_clean(queue);
+
+    vstack_t* stack = vstack_create_with_allocator(sizeof(uint64_t),
+                &ctx->allocator);
+    begin(ctx);
+    for (size_t i = 0; i < n; i++) {
+        vstack_push(stack, &ctx->keys[i]);
+    }
+    end(ctx, "vstack", "push", "seq", n);
+
+    begin(ctx);
+    while (vstack_pop(stack, &key)) {
+        sum += key;
+    }
+    end(ctx, "vstack", "pop", "seq", n);
+    vstack_clean(stack);
+
+    vDLL_t* dll = vDLL_create_with_allocator(sizeof(uint64_t),
+                &ctx->allocator);
+    begin(ctx);
+    for (size_t i = 0; i < n; i++) {
+        vDLL_insert_tail(dll, &ctx->keys[i]);
+    }
+    end(ctx, "vdlinkedlist", "insert_tail", "seq", n);
+
+    begin(ctx);
+    for (uint32_t h = dll->head; h != VDLL_NONE; h = vDLL_next(dll, h)) {
+        sum += *(uint64_t*)vDLL_get(dll, h);
+    }
+    end(ctx, "vdlinkedlist", "iterate", "seq", n);
+
+    begin(ctx);
+    while (vDLL_pop(dll, &key)) {
+        sum += key;
+    }
+    end(ctx, "vdlinkedlist", "pop", "seq", n);
+
+    begin(ctx);
+    vDLL_clean(dll);
+    end(ctx, "vdlinkedlist", "clean", "seq", n);
+
+    vector_t* vec = vector_create_with_allocator(sizeof(uint64_t),
+                &ctx->allocator);
+    begin(ctx);
+    for (size_t i = 0; i < n; i++) {
+        vector_push(vec, &ctx->keys[i]);
+    }
+    end(ctx, "vector", "push", "seq", n);
+
+    begin(ctx);
+    for (size_t i = 0; i < n; i++) {
+        sum += *(uint64_t*)vector_get(vec, i);
+    }
+    end(ctx, "vector", "iterate", "seq", n);
+
+    // Every miss scans the whole vector, so a handful cover n elements
+    size_t scans = n < 16 ? n : 16;
+    begin(ctx);
+    for (size_t i = 0; i < scans; i++) {
+        sum += vector_find(vec, &ctx->misses[i]);
+    }
+    end(ctx, "vector", "find_miss", "seq", scans * n);
+
+    begin(ctx);
+    for (size_t i = 0; i < scans; i++) {
+        sum += vector_count(vec, &ctx->keys[i]);
+    }
+    end(ctx, "vector", "count", "seq", scans * n);
+
+    begin(ctx);
+    for (size_t i = 0; i < scans; i++) {
+        vector_min(vec, VECTOR_UINT64, &key);
+        sum += key;
+    }
+    end(ctx, "vector", "min", "seq", scans * n);
+
+    begin(ctx);
+    vector_clean(vec);
+    end(ctx, "vector", "clean", "seq", n);
+
+    sink += sum;
+}
+
+int main(int argc, char** argv) {
+    size_t max_elements = DEFAULT_MAX_ELEMENTS;
+    double theta = 0.99;
+    bench_ctx_t ctx;
+
+    if (argc > 1) {
+        max_elements = strtoull(argv[1], NULL, 10);
+    }
+    if (argc > 2 && !strcmp(argv[2], "csv")) {
+        bench_set_format(BENCH_CSV);
+    }
+    if (argc > 3) {
+        theta = strtod(argv[3], NULL);
+    }
+
+    if (!bench_counters_open(&ctx.counters)) {
+        fprintf(stderr, "bench_containers: perf counters unavailable, "
+                    "reporting null\n");
+    }
+    ctx.allocator = bench_counting_allocator(&ctx.stats, NULL);
+
+    for (size_t n = MIN_ELEMENTS; n <= max_elements; n *= 10) {
+        ctx_init(&ctx, n, theta);
+        bench_hashtable(&ctx);
+        bench_dlinkedlist(&ctx);
+        bench_deque(&ctx);
+        bench_queue(&ctx);
+        bench_stack(&ctx);
+        bench_bptree(&ctx);
+        bench_art(&ctx);
+        bench_roaring(&ctx);
+        bench_by_value(&ctx);
+        ctx_clean(&ctx);
+    }
+
+    bench_counters_close(&ctx.counters);
+    return 0;
+}
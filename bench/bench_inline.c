@@ -0,0 +1,253 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file compares the separate and the unity / header-only builds
+         of the library on tight loops over the queue, stack, list and
+         hashtable, where call overhead between the caller, the container
+         and its allocator dominates. Each loop runs several rounds and the
+         fastest is reported, with the build mode as the dist field.
+
+         The loops only touch the public API, so the same file profiles well
+         for PGO: build with -fprofile-generate, run it once as the training
+         workload, then rebuild with -fprofile-use.
+
+Build  : separate:
+           cc -O2 -I.. bench_inline.c bench_util.c ../hashtable.c \
+               ../dlinkedlist.c ../queue.c ../stack.c ../arena.c \
+               ../allocator.c ../slab.c ../pool.c -lpthread -o bench_inline
+         unity, the library compiled into this file through dsl.h:
+           cc -O2 -I.. -DBENCH_UNITY bench_inline.c bench_util.c -lm \
+               -lpthread -o bench_inline_unity
+         PGO, either of the above with:
+           -fprofile-generate -DBENCH_MODE='"unity-train"', run, then
+           -fprofile-use -fprofile-partial-training \
+               -DBENCH_MODE='"unity-pgo"'
+Usage  : ./bench_inline [n_elements] [rounds] [json|csv]
+*/
+
+#ifdef BENCH_UNITY
+#define DSL_IMPLEMENTATION
+#include "dsl.h"
+#else
+#define _POSIX_C_SOURCE 200809L
+#include "hashtable.h"
+#include "dlinkedlist.h"
+#include "queue.h"
+#include "stack.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "bench_util.h"
+
+#ifndef BENCH_MODE
+#ifdef BENCH_UNITY
+#define BENCH_MODE "unity"
+#else
+#define BENCH_MODE "separate"
+#endif
+#endif
+
+#define DEFAULT_ELEMENTS 100000
+#define DEFAULT_ROUNDS 5
+// Elements kept queued or stacked during the ping-pong loops
+#define STEADY_DEPTH 64
+
+typedef uint64_t (* bench_loop_t)(size_t n, const uint64_t* keys);
+
+// Folds loop results so the compiler keeps the loops
+static volatile uint64_t sink;
+
+static int key_compare(const void* a, const void* b) {
+    return *(const uint64_t*)a != *(const uint64_t*)b;
+}
+
+static size_t key_hash(const void* key) {
+    uint64_t hash = *(const uint64_t*)key * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(hash ^ (hash >> 32));
+}
+
+/*
+ * Enqueues and dequeues one element per op at a steady depth, so every op
+ * is a node allocation and free.
+ */
+static uint64_t queue_pingpong(size_t n, const uint64_t* keys) {
+    queue_t* queue = queue_create();
+    uint64_t sum = 0;
+
+    for (size_t i = 0; i < STEADY_DEPTH; i++) {
+        queue_enqueue(queue, (void*)&keys[i % n]);
+    }
+    for (size_t i = 0; i < n; i++) {
+        queue_enqueue(queue, (void*)&keys[i]);
+        sum += *(const uint64_t*)queue_dequeue(queue);
+    }
+
+    queue_clean(queue, NULL);
+    return sum;
+}
+
+/*
+ * Fills a queue and drains it behind queue_is_empty and queue_peek.
+ */
+static uint64_t queue_fill_drain(size_t n, const uint64_t* keys) {
+    queue_t* queue = queue_create();
+    uint64_t sum = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        queue_enqueue(queue, (void*)&keys[i]);
+    }
+    while (!queue_is_empty(queue)) {
+        sum += *(const uint64_t*)queue_peek(queue);
+        queue_dequeue(queue);
+    }
+
+    queue_clean(queue, NULL);
+    return sum;
+}
+
+/*
+ * Pushes and pops one element per op at a steady depth.
+ */
+static uint64_t stack_pingpong(size_t n, const uint64_t* keys) {
+    stack_t* stack = stack_create();
+    uint64_t sum = 0;
+
+    for (size_t i = 0; i < STEADY_DEPTH; i++) {
+        stack_push(stack, (void*)&keys[i % n]);
+    }
+    for (size_t i = 0; i < n; i++) {
+        stack_push(stack, (void*)&keys[i]);
+        sum += *(const uint64_t*)stack_pop(stack);
+    }
+
+    stack_clean(stack, NULL);
+    return sum;
+}
+
+/*
+ * Fills a stack and drains it behind stack_is_empty and stack_peek.
+ */
+static uint64_t stack_fill_drain(size_t n, const uint64_t* keys) {
+    stack_t* stack = stack_create();
+    uint64_t sum = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        stack_push(stack, (void*)&keys[i]);
+    }
+    while (!stack_is_empty(stack)) {
+        sum += *(const uint64_t*)stack_peek(stack);
+        stack_pop(stack);
+    }
+
+    stack_clean(stack, NULL);
+    return sum;
+}
+
+/*
+ * Fills a list at the tail and drains it behind DLL_is_empty.
+ */
+static uint64_t dll_fill_drain(size_t n, const uint64_t* keys) {
+    DLL_t* dll = DLL_create();
+    uint64_t sum = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        DLL_insert_tail(dll, (void*)&keys[i]);
+    }
+    while (!DLL_is_empty(dll)) {
+        sum += *(const uint64_t*)DLL_pop(dll);
+    }
+
+    DLL_clean(dll, NULL);
+    return sum;
+}
+
+/*
+ * Builds a hashtable and looks every key up. The build is timed too, since
+ * the insert path is as much a candidate for inlining as the lookup.
+ */
+static uint64_t ht_build_lookup(size_t n, const uint64_t* keys) {
+    hashtable_t* ht = ht_create(INITIAL_TABLE_SIZE, key_compare, key_hash);
+    uint64_t sum = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        ht_insert(ht, (void*)&keys[i], (void*)&keys[i]);
+    }
+    for (size_t i = 0; i < n; i++) {
+        sum += *(const uint64_t*)ht_search(ht, (void*)&keys[i]);
+    }
+
+    ht_clean(ht, NULL, NULL);
+    return sum;
+}
+
+/*
+ * Function: run
+ * --------------------
+ *  Runs a loop for a number of rounds and reports the fastest.
+ *
+ *  returns: Nothing.
+ */
+static void run(const char* bench, bench_loop_t loop, size_t n,
+                size_t ops, size_t rounds, const uint64_t* keys) {
+    uint64_t best = UINT64_MAX;
+
+    for (size_t r = 0; r < rounds; r++) {
+        uint64_t start = bench_now_ns();
+        sink += loop(n, keys);
+        uint64_t elapsed = bench_now_ns() - start;
+        best = elapsed < best ? elapsed : best;
+    }
+
+    bench_result_t result = {
+        .suite = "inline",
+        .bench = bench,
+        .dist = BENCH_MODE,
+        .n_elements = n,
+        .ops = ops,
+        .elapsed_ns = best,
+        .n_allocs = 0,
+        .bytes_per_elem = 0.0,
+        .counters = NULL
+    };
+    bench_report(&result);
+}
+
+int main(int argc, char** argv) {
+    size_t n = DEFAULT_ELEMENTS, rounds = DEFAULT_ROUNDS;
+
+    if (argc > 1) {
+        n = strtoull(argv[1], NULL, 10);
+    }
+    if (argc > 2) {
+        rounds = strtoull(argv[2], NULL, 10);
+    }
+    if (argc > 3 && !strcmp(argv[3], "csv")) {
+        bench_set_format(BENCH_CSV);
+    }
+    if (!n || !rounds) {
+        fprintf(stderr, "bench_inline: elements and rounds must be "
+                    "positive\n");
+        return 1;
+    }
+
+    uint64_t* keys = malloc(sizeof(uint64_t) * n);
+    if (!keys) {
+        perror("malloc");
+        return 1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        keys[i] = i * 0x9E3779B97F4A7C15ULL + 1;
+    }
+
+    run("queue_pingpong", queue_pingpong, n, n, rounds, keys);
+    run("queue_fill_drain", queue_fill_drain, n, 2 * n, rounds, keys);
+    run("stack_pingpong", stack_pingpong, n, n, rounds, keys);
+    run("stack_fill_drain", stack_fill_drain, n, 2 * n, rounds, keys);
+    run("dll_fill_drain", dll_fill_drain, n, 2 * n, rounds, keys);
+    run("ht_build_lookup", ht_build_lookup, n, 2 * n, rounds, keys);
+
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,583 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file measures how the shared containers scale from 1 to N
+         pinned threads. Maps run a read/write mix over Zipfian keys, queues
+         and stacks split threads into producers and consumers. Each run
+         reports throughput, speedup over one thread, Jain's fairness index
+         over per thread operation counts and per thread latency from HDR
+         histograms.
+
+         Every structure is a scale_target_t in TARGETS. The existing
+         hashtable_t, queue_t and stack_t are wrapped in a mutex as the
+         baseline, and their unlocked single threaded cost is reported once
+         as the uncontended floor. Concurrent variants plug in as further
+         targets, the lock free skiplist_t is the first. lockdep_t runs as
+         a target too, each operation a nested acquire and release of two
+         lock classes on every thread, to show its validated fast path
+         shares nothing between threads.
+
+Build  : cc -O2 -I.. bench_scaling.c bench_util.c hdr_histogram.c \
+             ../hashtable.c ../queue.c ../stack.c ../arena.c ../allocator.c \
+             ../slab.c ../pool.c ../workload.c ../epoch.c ../skiplist.c \
+             ../lockdep.c ../dlinkedlist.c ../bitset.c -lm -lpthread \
+             -o bench_scaling
+Usage  : ./bench_scaling [-t max_threads] [-d duration_ms] [-k keys]
+             [-z zipf_theta] [-r read_ratio] [-p producer_ratio]
+             [-T target]
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "bench_util.h"
+#include "hdr_histogram.h"
+#include "hashtable.h"
+#include "queue.h"
+#include "stack.h"
+#include "skiplist.h"
+#include "lockdep.h"
+#include "workload.h"
+
+#define DEFAULT_DURATION_MS 1000
+#define DEFAULT_KEYS 100000
+#define HIGHEST_LATENCY_NS 10000000000ULL
+#define SIGNIFICANT_FIGURES 2
+// Operations between checks of the stop flag
+#define STOP_CHECK_INTERVAL 64
+// Lock classes the lockdep target takes outer, then inner
+#define LOCKDEP_OUTER 8
+#define LOCKDEP_INNER 8
+
+typedef enum scale_kind {
+    // insert, lookup and remove over keys
+    SCALE_MAP,
+    // insert puts and remove takes, lookup is unused
+    SCALE_POOL
+} scale_kind_t;
+
+/*
+ * A structure under test. Operations return whether they found or moved an
+ * element. Targets that are not thread safe only run on one thread.
+ */
+typedef struct scale_target {
+    const char* name;
+    scale_kind_t kind;
+    bool thread_safe;
+    void* (* create)(size_t n_keys);
+    void (* clean)(void* target);
+    bool (* insert)(void* target, uint64_t* key);
+    bool (* lookup)(void* target, uint64_t* key);
+    bool (* remove)(void* target, uint64_t* key);
+} scale_target_t;
+
+typedef struct scale_config {
+    size_t max_threads;
+    uint64_t duration_ns;
+    size_t n_keys;
+    double theta;
+    double read_ratio;
+    double producer_ratio;
+    const char* only;
+} scale_config_t;
+
+typedef struct scale_run {
+    const scale_config_t* config;
+    const scale_target_t* target;
+    void* instance;
+    uint64_t* keys;
+    size_t n_threads;
+    size_t n_producers;
+    atomic_size_t ready;
+    atomic_bool go;
+    atomic_bool stop;
+} scale_run_t;
+
+typedef struct scale_thread {
+    scale_run_t* run;
+    size_t index;
+    pthread_t thread;
+    size_t ops;
+    size_t misses;
+    hdr_histogram_t* latency;
+} scale_thread_t;
+
+typedef struct locked {
+    pthread_mutex_t lock;
+    void* container;
+} locked_t;
+
+typedef struct lockdep_target {
+    lockdep_t* ld;
+    uint64_t ids[LOCKDEP_OUTER + LOCKDEP_INNER];
+    ckey_t keys[LOCKDEP_OUTER + LOCKDEP_INNER];
+    lockdep_class_t* classes[LOCKDEP_OUTER + LOCKDEP_INNER];
+} lockdep_target_t;
+
+// Held locks of the calling thread for the lockdep target
+static _Thread_local lockdep_thread_t lockdep_thread;
+
+static int key_compare(const void* a, const void* b) {
+    return *(const uint64_t*)a != *(const uint64_t*)b;
+}
+
+static int key_order(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static size_t key_hash(const void* key) {
+    uint64_t hash = *(const uint64_t*)key * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(hash ^ (hash >> 32));
+}
+
+static int class_compare(const void* a, const void* b) {
+    return key_compare(((const ckey_t*)a)->id, ((const ckey_t*)b)->id);
+}
+
+static size_t class_hash(const void* key) {
+    return key_hash(((const ckey_t*)key)->id);
+}
+
+/**** TARGETS ****/
+
+static void* ht_target_create(size_t n_keys) {
+    (void)n_keys;
+    return ht_create(INITIAL_TABLE_SIZE, key_compare, key_hash);
+}
+
+static void ht_target_clean(void* target) {
+    ht_clean(target, NULL, NULL);
+}
+
+static bool ht_target_insert(void* target, uint64_t* key) {
+    ht_insert(target, key, key);
+    return true;
+}
+
+static bool ht_target_lookup(void* target, uint64_t* key) {
+    return ht_search(target, key) != NULL;
+}
+
+static bool ht_target_remove(void* target, uint64_t* key) {
+    ht_remove(target, key, NULL, NULL);
+    return true;
+}
+
+static void* skiplist_target_create(size_t n_keys) {
+    (void)n_keys;
+    return skiplist_create(key_order);
+}
+
+static void skiplist_target_clean(void* target) {
+    skiplist_clean(target, NULL, NULL);
+    // Every thread has joined, free what they retired before the next run
+    epoch_drain();
+}
+
+static bool skiplist_target_insert(void* target, uint64_t* key) {
+    skiplist_insert(target, key, key);
+    return true;
+}
+
+static bool skiplist_target_lookup(void* target, uint64_t* key) {
+    return skiplist_contains(target, key);
+}
+
+static bool skiplist_target_remove(void* target, uint64_t* key) {
+    skiplist_remove(target, key, NULL, NULL);
+    return true;
+}
+
+static void* queue_target_create(size_t n_keys) {
+    (void)n_keys;
+    return queue_create();
+}
+
+static void queue_target_clean(void* target) {
+    queue_clean(target, NULL);
+}
+
+static bool queue_target_insert(void* target, uint64_t* key) {
+    queue_enqueue(target, key);
+    return true;
+}
+
+static bool queue_target_remove(void* target, uint64_t* key) {
+    (void)key;
+    return queue_dequeue(target) != NULL;
+}
+
+static void* stack_target_create(size_t n_keys) {
+    (void)n_keys;
+    return stack_create();
+}
+
+static void stack_target_clean(void* target) {
+    stack_clean(target, NULL);
+}
+
+static bool stack_target_insert(void* target, uint64_t* key) {
+    stack_push(target, key);
+    return true;
+}
+
+static bool stack_target_remove(void* target, uint64_t* key) {
+    (void)key;
+    return stack_pop(target) != NULL;
+}
+
+static void* lockdep_target_create(size_t n_keys) {
+    (void)n_keys;
+    lockdep_target_t* target = malloc(sizeof(lockdep_target_t));
+    target->ld = lockdep_create(class_compare, class_hash, NULL, NULL);
+
+    for (size_t i = 0; i < LOCKDEP_OUTER + LOCKDEP_INNER; i++) {
+        target->ids[i] = i;
+        target->keys[i].type = RESOURCE_T;
+        target->keys[i].id = &target->ids[i];
+        target->classes[i] = lockdep_register(target->ld, &target->keys[i]);
+    }
+
+    // The creating thread fills maps in, its cache is from an older run
+    lockdep_thread_init(&lockdep_thread);
+    return target;
+}
+
+static void lockdep_target_clean(void* target) {
+    lockdep_target_t* lockdep = target;
+    lockdep_clean(lockdep->ld);
+    free(lockdep);
+}
+
+static bool lockdep_target_nest(void* target, uint64_t* key) {
+    lockdep_target_t* lockdep = target;
+    lockdep_class_t* outer = lockdep->classes[*key % LOCKDEP_OUTER];
+    lockdep_class_t* inner = lockdep->classes[LOCKDEP_OUTER +
+                (*key / LOCKDEP_OUTER) % LOCKDEP_INNER];
+
+    bool consistent = lockdep_acquire(lockdep->ld, &lockdep_thread, outer);
+    consistent &= lockdep_acquire(lockdep->ld, &lockdep_thread, inner);
+    lockdep_release(lockdep->ld, &lockdep_thread, inner);
+    lockdep_release(lockdep->ld, &lockdep_thread, outer);
+    return consistent;
+}
+
+/*
+ * Mutex wrappers, generated per container so the baseline pays exactly one
+ * lock round trip per operation.
+ */
+#define LOCKED_TARGET(prefix) \
+    static void* locked_##prefix##_create(size_t n_keys) { \
+        locked_t* locked = malloc(sizeof(locked_t)); \
+        pthread_mutex_init(&locked->lock, NULL); \
+        locked->container = prefix##_target_create(n_keys); \
+        return locked; \
+    } \
+    static void locked_##prefix##_clean(void* target) { \
+        locked_t* locked = target; \
+        prefix##_target_clean(locked->container); \
+        pthread_mutex_destroy(&locked->lock); \
+        free(locked); \
+    } \
+    static bool locked_##prefix##_insert(void* target, uint64_t* key) { \
+        locked_t* locked = target; \
+        pthread_mutex_lock(&locked->lock); \
+        bool done = prefix##_target_insert(locked->container, key); \
+        pthread_mutex_unlock(&locked->lock); \
+        return done; \
+    } \
+    static bool locked_##prefix##_remove(void* target, uint64_t* key) { \
+        locked_t* locked = target; \
+        pthread_mutex_lock(&locked->lock); \
+        bool done = prefix##_target_remove(locked->container, key); \
+        pthread_mutex_unlock(&locked->lock); \
+        return done; \
+    }
+
+LOCKED_TARGET(ht)
+LOCKED_TARGET(queue)
+LOCKED_TARGET(stack)
+
+static bool locked_ht_lookup(void* target, uint64_t* key) {
+    locked_t* locked = target;
+    pthread_mutex_lock(&locked->lock);
+    bool found = ht_target_lookup(locked->container, key);
+    pthread_mutex_unlock(&locked->lock);
+    return found;
+}
+
+static const scale_target_t TARGETS[] = {
+    {"hashtable", SCALE_MAP, false, ht_target_create, ht_target_clean,
+                ht_target_insert, ht_target_lookup, ht_target_remove},
+    {"hashtable_mutex", SCALE_MAP, true, locked_ht_create, locked_ht_clean,
+                locked_ht_insert, locked_ht_lookup, locked_ht_remove},
+    {"skiplist", SCALE_MAP, true, skiplist_target_create,
+                skiplist_target_clean, skiplist_target_insert,
+                skiplist_target_lookup, skiplist_target_remove},
+    {"queue", SCALE_POOL, false, queue_target_create, queue_target_clean,
+                queue_target_insert, NULL, queue_target_remove},
+    {"queue_mutex", SCALE_POOL, true, locked_queue_create,
+                locked_queue_clean, locked_queue_insert, NULL,
+                locked_queue_remove},
+    {"stack", SCALE_POOL, false, stack_target_create, stack_target_clean,
+                stack_target_insert, NULL, stack_target_remove},
+    {"stack_mutex", SCALE_POOL, true, locked_stack_create,
+                locked_stack_clean, locked_stack_insert, NULL,
+                locked_stack_remove},
+    {"lockdep", SCALE_MAP, true, lockdep_target_create, lockdep_target_clean,
+                lockdep_target_nest, lockdep_target_nest, lockdep_target_nest}
+};
+
+/**** HARNESS ****/
+
+/*
+ * Function: pin_thread
+ * --------------------
+ *  Pins the calling thread to one CPU, round robin over the online CPUs.
+ *
+ *  returns: Nothing.
+ */
+static void pin_thread(size_t index) {
+#ifdef __linux__
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET((int)(index % (size_t)(n_cpus > 0 ? n_cpus : 1)), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)index;
+#endif
+}
+
+/*
+ * Function: run_thread
+ * --------------------
+ *  Issues operations until the run stops, timing each one. Pool producers
+ *  only put and consumers only take, a lone thread alternates.
+ *
+ *  returns: NULL.
+ */
+static void* run_thread(void* arg) {
+    scale_thread_t* thread = arg;
+    scale_run_t* run = thread->run;
+    const scale_target_t* target = run->target;
+    const scale_config_t* config = run->config;
+    uint64_t state = 0xBEEF + thread->index;
+    bool producer = thread->index < run->n_producers;
+    zipf_t zipf;
+
+    pin_thread(thread->index);
+    zipf_init(&zipf, config->n_keys, config->theta);
+
+    atomic_fetch_add(&run->ready, 1);
+    while (!atomic_load(&run->go)) {
+        sched_yield();
+    }
+
+    while (!atomic_load_explicit(&run->stop, memory_order_relaxed)) {
+        for (size_t i = 0; i < STOP_CHECK_INTERVAL; i++) {
+            // Scatter popular ranks over the key space
+            size_t rank = zipf_next(&zipf, &state);
+            uint64_t* key = &run->keys[(rank * 0x9E3779B1ULL) %
+                        config->n_keys];
+            bool done;
+            uint64_t start = bench_now_ns();
+
+            if (target->kind == SCALE_POOL) {
+                bool put = run->n_threads == 1 ? !(thread->ops & 1) :
+                            producer;
+                done = put ? target->insert(run->instance, key) :
+                            target->remove(run->instance, key);
+            } else if (workload_rand_double(&state) < config->read_ratio) {
+                done = target->lookup(run->instance, key);
+            } else if (workload_rand(&state) & 1) {
+                done = target->insert(run->instance, key);
+            } else {
+                done = target->remove(run->instance, key);
+            }
+
+            hdr_record(thread->latency, bench_now_ns() - start);
+            thread->ops++;
+            thread->misses += !done;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Function: run_target
+ * --------------------
+ *  Runs one target on a number of threads and reports the result.
+ *
+ *  returns: Throughput in operations per second.
+ */
+static double run_target(const scale_config_t* config,
+                const scale_target_t* target, uint64_t* keys,
+                size_t n_threads, double baseline) {
+    scale_run_t run;
+    scale_thread_t* threads = calloc(n_threads, sizeof(scale_thread_t));
+
+    run.config = config;
+    run.target = target;
+    run.keys = keys;
+    run.n_threads = n_threads;
+    run.n_producers = (size_t)(config->producer_ratio * (double)n_threads +
+                0.5);
+    if (n_threads > 1 && run.n_producers == 0) {
+        run.n_producers = 1;
+    }
+    if (n_threads > 1 && run.n_producers == n_threads) {
+        run.n_producers = n_threads - 1;
+    }
+    atomic_init(&run.ready, 0);
+    atomic_init(&run.go, false);
+    atomic_init(&run.stop, false);
+
+    // Maps start half full, pools start empty
+    run.instance = target->create(config->n_keys);
+    if (target->kind == SCALE_MAP) {
+        for (size_t i = 0; i < config->n_keys; i += 2) {
+            target->insert(run.instance, &keys[i]);
+        }
+    }
+
+    for (size_t t = 0; t < n_threads; t++) {
+        threads[t].run = &run;
+        threads[t].index = t;
+        threads[t].latency = hdr_create(HIGHEST_LATENCY_NS,
+                    SIGNIFICANT_FIGURES);
+        pthread_create(&threads[t].thread, NULL, run_thread, &threads[t]);
+    }
+
+    while (atomic_load(&run.ready) < n_threads) {
+        sched_yield();
+    }
+    uint64_t start = bench_now_ns();
+    atomic_store(&run.go, true);
+
+    struct timespec ts = {
+        .tv_sec = (time_t)(config->duration_ns / 1000000000ULL),
+        .tv_nsec = (long)(config->duration_ns % 1000000000ULL)
+    };
+    nanosleep(&ts, NULL);
+    atomic_store(&run.stop, true);
+
+    for (size_t t = 0; t < n_threads; t++) {
+        pthread_join(threads[t].thread, NULL);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    // Jain's index, 1 when every thread did the same work, 1/n when one did
+    hdr_histogram_t* all = hdr_create(HIGHEST_LATENCY_NS,
+                SIGNIFICANT_FIGURES);
+    double sum = 0.0, sum_squares = 0.0;
+    size_t misses = 0;
+
+    for (size_t t = 0; t < n_threads; t++) {
+        sum += (double)threads[t].ops;
+        sum_squares += (double)threads[t].ops * (double)threads[t].ops;
+        misses += threads[t].misses;
+        hdr_add(all, threads[t].latency);
+    }
+
+    double throughput = 1e9 * sum / (double)elapsed;
+    double fairness = sum_squares > 0.0 ?
+                sum * sum / ((double)n_threads * sum_squares) : 0.0;
+
+    printf("{\"suite\":\"scaling\",\"target\":\"%s\",\"threads\":%zu,"
+                "\"producers\":%zu,\"ops\":%.0f,\"ops_per_sec\":%.0f,"
+                "\"speedup\":%.2f,\"fairness\":%.3f,\"miss_ratio\":%.3f,"
+                "\"p50_ns\":%llu,\"p99_ns\":%llu,\"p99_9_ns\":%llu,"
+                "\"thread_ops\":[", target->name, n_threads,
+                target->kind == SCALE_POOL ? run.n_producers : 0, sum,
+                throughput, baseline > 0.0 ? throughput / baseline : 1.0,
+                fairness, sum > 0.0 ? (double)misses / sum : 0.0,
+                (unsigned long long)hdr_value_at_percentile(all, 50.0),
+                (unsigned long long)hdr_value_at_percentile(all, 99.0),
+                (unsigned long long)hdr_value_at_percentile(all, 99.9));
+
+    for (size_t t = 0; t < n_threads; t++) {
+        printf("%s%zu", t ? "," : "", threads[t].ops);
+    }
+    printf("],\"thread_p99_ns\":[");
+    for (size_t t = 0; t < n_threads; t++) {
+        printf("%s%llu", t ? "," : "", (unsigned long long)
+                    hdr_value_at_percentile(threads[t].latency, 99.0));
+        hdr_clean(threads[t].latency);
+    }
+    printf("]}\n");
+    fflush(stdout);
+
+    hdr_clean(all);
+    target->clean(run.instance);
+    free(threads);
+
+    return throughput;
+}
+
+int main(int argc, char** argv) {
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    scale_config_t config = {
+        .max_threads = n_cpus > 0 ? (size_t)n_cpus : 1,
+        .duration_ns = DEFAULT_DURATION_MS * 1000000ULL,
+        .n_keys = DEFAULT_KEYS,
+        .theta = 0.99,
+        .read_ratio = 0.9,
+        .producer_ratio = 0.5,
+        .only = NULL
+    };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:d:k:z:r:p:T:")) != -1) {
+        switch (opt) {
+            case 't': config.max_threads = strtoull(optarg, NULL, 10); break;
+            case 'd':
+                config.duration_ns = strtoull(optarg, NULL, 10) * 1000000ULL;
+                break;
+            case 'k': config.n_keys = strtoull(optarg, NULL, 10); break;
+            case 'z': config.theta = strtod(optarg, NULL); break;
+            case 'r': config.read_ratio = strtod(optarg, NULL); break;
+            case 'p': config.producer_ratio = strtod(optarg, NULL); break;
+            case 'T': config.only = optarg; break;
+            default: return 1;
+        }
+    }
+
+    if (!config.max_threads || !config.n_keys) {
+        fprintf(stderr, "bench_scaling: threads and keys must be positive\n");
+        return 1;
+    }
+
+    uint64_t* keys = malloc(sizeof(uint64_t) * config.n_keys);
+    for (size_t i = 0; i < config.n_keys; i++) {
+        keys[i] = i;
+    }
+
+    for (size_t i = 0; i < sizeof(TARGETS) / sizeof(scale_target_t); i++) {
+        const scale_target_t* target = &TARGETS[i];
+        if (config.only && strcmp(config.only, target->name)) {
+            continue;
+        }
+
+        // Doubling thread counts, ending on the maximum
+        double baseline = run_target(&config, target, keys, 1, 0.0);
+        for (size_t n = 2; target->thread_safe && n < config.max_threads * 2;
+                    n *= 2) {
+            size_t n_threads = n < config.max_threads ? n : config.max_threads;
+            run_target(&config, target, keys, n_threads, baseline);
+        }
+    }
+
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,304 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file holds the shared benchmark plumbing: a monotonic clock,
+         perf_event hardware counters where the kernel permits them, a
+         counting allocator and JSON or CSV result output.
+*/
+
+#define _GNU_SOURCE
+
+#include "bench_util.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+static const char* COUNTER_NAMES[BENCH_N_COUNTERS] = {
+    "cache_misses",
+    "branch_misses",
+    "dtlb_misses"
+};
+
+static bench_format_t output_format = BENCH_JSON;
+static bool header_printed = false;
+
+/**** PUBLIC ****/
+
+/*
+ * Function: bench_now_ns
+ * --------------------
+ *  Reads the monotonic clock.
+ *
+ *  returns: Time in nanoseconds.
+ */
+uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Function: bench_counters_open
+ * --------------------
+ *  Opens the hardware counters for the calling thread, disabled.
+ *
+ *  counters: Pointer to the counters.
+ *
+ *  returns: True if at least one counter opened, false otherwise.
+ */
+bool bench_counters_open(bench_counters_t* counters) {
+    assert(counters);
+    bool opened = false;
+
+    for (int i = 0; i < BENCH_N_COUNTERS; i++) {
+        counters->fds[i] = -1;
+        counters->values[i] = 0;
+    }
+
+#ifdef __linux__
+    static const uint32_t types[BENCH_N_COUNTERS] = {
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HW_CACHE
+    };
+    static const uint64_t configs[BENCH_N_COUNTERS] = {
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_DTLB |
+                    (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+    };
+
+    for (int i = 0; i < BENCH_N_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = types[i];
+        attr.config = configs[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        counters->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1,
+                    -1, 0);
+        opened |= counters->fds[i] >= 0;
+    }
+#endif
+
+    return opened;
+}
+
+/*
+ * Function: bench_counters_start
+ * --------------------
+ *  Zeroes and enables the open counters.
+ *
+ *  counters: Pointer to the counters.
+ *
+ *  returns: Nothing.
+ */
+void bench_counters_start(bench_counters_t* counters) {
+    assert(counters);
+
+    for (int i = 0; i < BENCH_N_COUNTERS; i++) {
+        counters->values[i] = 0;
+#ifdef __linux__
+        if (counters->fds[i] >= 0) {
+            ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+}
+
+/*
+ * Function: bench_counters_stop
+ * --------------------
+ *  Disables the open counters and reads their values.
+ *
+ *  counters: Pointer to the counters.
+ *
+ *  returns: Nothing.
+ */
+void bench_counters_stop(bench_counters_t* counters) {
+    assert(counters);
+
+#ifdef __linux__
+    for (int i = 0; i < BENCH_N_COUNTERS; i++) {
+        if (counters->fds[i] < 0) {
+            continue;
+        }
+
+        ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(counters->fds[i], &counters->values[i],
+                    sizeof(uint64_t)) != sizeof(uint64_t)) {
+            counters->values[i] = 0;
+        }
+    }
+#endif
+}
+
+/*
+ * Function: bench_counters_close
+ * --------------------
+ *  Closes the open counters.
+ *
+ *  counters: Pointer to the counters.
+ *
+ *  returns: Nothing.
+ */
+void bench_counters_close(bench_counters_t* counters) {
+    assert(counters);
+
+    for (int i = 0; i < BENCH_N_COUNTERS; i++) {
+#ifdef __linux__
+        if (counters->fds[i] >= 0) {
+            close(counters->fds[i]);
+        }
+#endif
+        counters->fds[i] = -1;
+    }
+}
+
+/*
+ * Function: bench_counting_allocator
+ * --------------------
+ *  Creates an allocator that counts allocations and live bytes before
+ *  passing them on. Not thread safe.
+ *
+ *  stats: Where to count, must outlive the allocator.
+ *  inner: Allocator to pass on to, NULL for the thread's allocator.
+ *
+ *  returns: The counting allocator.
+ */
+allocator_t bench_counting_allocator(bench_alloc_stats_t* stats,
+                const allocator_t* inner) {
+    assert(stats);
+    allocator_t allocator;
+
+    memset(stats, 0, sizeof(bench_alloc_stats_t));
+    stats->inner = allocator_resolve(inner);
+
+    allocator.alloc = _bench_counting_alloc;
+    allocator.free = _bench_counting_free;
+    allocator.reset = NULL;
+    allocator.ctx = stats;
+
+    return allocator;
+}
+
+/*
+ * Function: bench_set_format
+ * --------------------
+ *  Sets the output format of bench_report, JSON lines by default.
+ *
+ *  format: Output format.
+ *
+ *  returns: Nothing.
+ */
+void bench_set_format(bench_format_t format) {
+    output_format = format;
+    header_printed = false;
+}
+
+/*
+ * Function: bench_report
+ * --------------------
+ *  Prints one benchmark result, with a header before the first CSV row.
+ *
+ *  result: Result to print.
+ *
+ *  returns: Nothing.
+ */
+void bench_report(const bench_result_t* result) {
+    assert(result);
+    double ns_per_op = result->ops ?
+                (double)result->elapsed_ns / (double)result->ops : 0.0;
+    double allocs_per_op = result->ops ?
+                (double)result->n_allocs / (double)result->ops : 0.0;
+
+    if (output_format == BENCH_CSV) {
+        if (!header_printed) {
+            printf("suite,bench,dist,elements,ops,ns_per_op,allocs_per_op,"
+                        "bytes_per_elem");
+            for (int i = 0; i < BENCH_N_COUNTERS; i++) {
+                printf(",%s_per_op", COUNTER_NAMES[i]);
+            }
+            printf("\n");
+            header_printed = true;
+        }
+
+        printf("%s,%s,%s,%zu,%zu,%.2f,%.3f,%.1f", result->suite,
+                    result->bench, result->dist, result->n_elements,
+                    result->ops, ns_per_op, allocs_per_op,
+                    result->bytes_per_elem);
+    } else {
+        printf("{\"suite\":\"%s\",\"bench\":\"%s\",\"dist\":\"%s\","
+                    "\"elements\":%zu,\"ops\":%zu,\"ns_per_op\":%.2f,"
+                    "\"allocs_per_op\":%.3f,\"bytes_per_elem\":%.1f",
+                    result->suite, result->bench, result->dist,
+                    result->n_elements, result->ops, ns_per_op, allocs_per_op,
+                    result->bytes_per_elem);
+    }
+
+    // Counters that could not be opened are empty in CSV and null in JSON
+    for (int i = 0; i < BENCH_N_COUNTERS; i++) {
+        bool valid = result->counters && result->counters->fds[i] >= 0 &&
+                    result->ops;
+        double per_op = valid ? (double)result->counters->values[i] /
+                    (double)result->ops : 0.0;
+
+        if (output_format == BENCH_CSV) {
+            valid ? printf(",%.4f", per_op) : printf(",");
+        } else if (valid) {
+            printf(",\"%s_per_op\":%.4f", COUNTER_NAMES[i], per_op);
+        } else {
+            printf(",\"%s_per_op\":null", COUNTER_NAMES[i]);
+        }
+    }
+
+    printf(output_format == BENCH_CSV ? "\n" : "}\n");
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _bench_counting_alloc
+ * --------------------
+ *  Counts an allocation and passes it on.
+ *
+ *  returns: Pointer to the allocation.
+ */
+void* _bench_counting_alloc(void* ctx, size_t size) {
+    bench_alloc_stats_t* stats = ctx;
+
+    stats->n_allocs++;
+    stats->live_bytes += size;
+    if (stats->live_bytes > stats->peak_bytes) {
+        stats->peak_bytes = stats->live_bytes;
+    }
+
+    return allocator_alloc(&stats->inner, size);
+}
+
+/*
+ * Function: _bench_counting_free
+ * --------------------
+ *  Counts a free and passes it on.
+ *
+ *  returns: Nothing.
+ */
+void _bench_counting_free(void* ctx, void* ptr, size_t size) {
+    bench_alloc_stats_t* stats = ctx;
+
+    stats->n_frees++;
+    stats->live_bytes -= size;
+
+    allocator_free(&stats->inner, ptr, size);
+}
@@ -0,0 +1,167 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "allocator.h"
+
+typedef enum bench_format {
+    BENCH_JSON,
+    BENCH_CSV
+} bench_format_t;
+
+typedef enum bench_counter {
+    BENCH_CACHE_MISSES,
+    BENCH_BRANCH_MISSES,
+    BENCH_DTLB_MISSES,
+    BENCH_N_COUNTERS
+} bench_counter_t;
+
+/*
+ * Hardware counters around a measured region. A counter the kernel refuses
+ * to open, as under perf_event_paranoid or outside Linux, stays at -1 and
+ * is reported as null.
+ */
+typedef struct bench_counters {
+    int fds[BENCH_N_COUNTERS];
+    uint64_t values[BENCH_N_COUNTERS];
+} bench_counters_t;
+
+/*
+ * Allocation counts seen through a counting allocator.
+ */
+typedef struct bench_alloc_stats {
+    allocator_t inner;
+    size_t n_allocs;
+    size_t n_frees;
+    size_t live_bytes;
+    size_t peak_bytes;
+} bench_alloc_stats_t;
+
+/*
+ * One benchmark result. Counters may be NULL when none were measured.
+ */
+typedef struct bench_result {
+    const char* suite;
+    const char* bench;
+    const char* dist;
+    size_t n_elements;
+    size_t ops;
+    uint64_t elapsed_ns;
+    size_t n_allocs;
+    double bytes_per_elem;
+    const bench_counters_t* counters;
+} bench_result_t;
+
+/**** PUBLIC ****/
+
+/*
+ * Function: bench_now_ns
+ * --------------------
+ *  Reads the monotonic clock.
+ *
+ *  returns: Time in nanoseconds.
+ */
+uint64_t bench_now_ns(void);
+
+/*
+ * Function: bench_counters_open
+ * --------------------
+ *  Opens the hardware counters for the calling thread, disabled.
+ *
+ *  counters: Pointer to the counters.
+ *
+ *  returns: True if at least one counter opened, false otherwise.
+ */
+bool bench_counters_open(bench_counters_t* counters);
+
+/*
+ * Function: bench_counters_start
+ * --------------------
+ *  Zeroes and enables the open counters.
+ *
+ *  counters: Pointer to the counters.
+ *
+ *  returns: Nothing.
+ */
+void bench_counters_start(bench_counters_t* counters);
+
+/*
+ * Function: bench_counters_stop
+ * --------------------
+ *  Disables the open counters and reads their values.
+ *
+ *  counters: Pointer to the counters.
+ *
+ *  returns: Nothing.
+ */
+void bench_counters_stop(bench_counters_t* counters);
+
+/*
+ * Function: bench_counters_close
+ * --------------------
+ *  Closes the open counters.
+ *
+ *  counters: Pointer to the counters.
+ *
+ *  returns: Nothing.
+ */
+void bench_counters_close(bench_counters_t* counters);
+
+/*
+ * Function: bench_counting_allocator
+ * --------------------
+ *  Creates an allocator that counts allocations and live bytes before
+ *  passing them on. Not thread safe.
+ *
+ *  stats: Where to count, must outlive the allocator.
+ *  inner: Allocator to pass on to, NULL for the thread's allocator.
+ *
+ *  returns: The counting allocator.
+ */
+allocator_t bench_counting_allocator(bench_alloc_stats_t* stats,
+                const allocator_t* inner);
+
+/*
+ * Function: bench_set_format
+ * --------------------
+ *  Sets the output format of bench_report, JSON lines by default.
+ *
+ *  format: Output format.
+ *
+ *  returns: Nothing.
+ */
+void bench_set_format(bench_format_t format);
+
+/*
+ * Function: bench_report
+ * --------------------
+ *  Prints one benchmark result, with a header before the first CSV row.
+ *
+ *  result: Result to print.
+ *
+ *  returns: Nothing.
+ */
+void bench_report(const bench_result_t* result);
+
+/**** PRIVATE ****/
+/*
+ * Function: _bench_counting_alloc
+ * --------------------
+ *  Counts an allocation and passes it on.
+ *
+ *  returns: Pointer to the allocation.
+ */
+void* _bench_counting_alloc(void* ctx, size_t size);
+
+/*
+ * Function: _bench_counting_free
+ * --------------------
+ *  Counts a free and passes it on.
+ *
+ *  returns: Nothing.
+ */
+void _bench_counting_free(void* ctx, void* ptr, size_t size);
+
+#endif
@@ -0,0 +1,582 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file replays YCSB style workloads (A to F) or a recorded
+         access trace against a shared hashtable and reports per operation
+         latency percentiles from HDR histograms, so tail effects such as
+         _resize_ht pauses show up next to the median.
+
+         Threads share one table behind a mutex, as callers of the
+         hashtable do, so a resize stalls every thread waiting on the lock.
+         With a target throughput each thread issues operations on a fixed
+         schedule and latency is measured from the scheduled start, which
+         keeps a stall from hiding the requests queued behind it.
+
+         The hashtable has no key order, so a scan of length n reads n
+         consecutive record ids with point lookups.
+
+Build  : cc -O2 -I.. bench_ycsb.c bench_util.c hdr_histogram.c \
+             ../hashtable.c ../arena.c ../allocator.c ../slab.c ../pool.c \
+             ../queue.c ../workload.c -lm -lpthread -o bench_ycsb
+Usage  : ./bench_ycsb [-w a|b|c|d|e|f] [-f trace] [-r records] [-o ops]
+             [-k key_size] [-v value_size] [-t threads] [-R target_ops_sec]
+             [-V default|malloc|fixed] [-z zipf_theta]
+
+Trace  : One operation per line, "<op> <record id> [scan length]" where op
+         is read, update, insert, scan or rmw. Lines are dealt to threads
+         round robin.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "bench_util.h"
+#include "hdr_histogram.h"
+#include "hashtable.h"
+#include "workload.h"
+
+#define DEFAULT_RECORDS 100000
+#define DEFAULT_OPS 1000000
+#define DEFAULT_KEY_SIZE 16
+#define DEFAULT_VALUE_SIZE 100
+#define MAX_SCAN_LENGTH 100
+// Latencies above a minute are clamped
+#define HIGHEST_LATENCY_NS 60000000000ULL
+#define SIGNIFICANT_FIGURES 3
+// Waits for a paced slot spin for their last stretch
+#define SPIN_NS 200000
+
+typedef enum ycsb_op {
+    YCSB_READ,
+    YCSB_UPDATE,
+    YCSB_INSERT,
+    YCSB_SCAN,
+    YCSB_RMW,
+    YCSB_N_OPS
+} ycsb_op_t;
+
+static const char* OP_NAMES[YCSB_N_OPS] = {
+    "read", "update", "insert", "scan", "rmw"
+};
+
+typedef enum ycsb_dist {
+    DIST_ZIPF,
+    DIST_LATEST
+} ycsb_dist_t;
+
+/*
+ * Operation mix of a workload, proportions add up to 1.
+ */
+typedef struct ycsb_mix {
+    char name;
+    double proportions[YCSB_N_OPS];
+    ycsb_dist_t dist;
+} ycsb_mix_t;
+
+static const ycsb_mix_t MIXES[] = {
+    {'a', {0.50, 0.50, 0.00, 0.00, 0.00}, DIST_ZIPF},
+    {'b', {0.95, 0.05, 0.00, 0.00, 0.00}, DIST_ZIPF},
+    {'c', {1.00, 0.00, 0.00, 0.00, 0.00}, DIST_ZIPF},
+    {'d', {0.95, 0.00, 0.05, 0.00, 0.00}, DIST_LATEST},
+    {'e', {0.00, 0.00, 0.05, 0.95, 0.00}, DIST_ZIPF},
+    {'f', {0.50, 0.00, 0.00, 0.00, 0.50}, DIST_ZIPF}
+};
+
+typedef struct trace_op {
+    ycsb_op_t op;
+    uint64_t id;
+    uint32_t length;
+} trace_op_t;
+
+typedef struct ycsb_config {
+    const ycsb_mix_t* mix;
+    const char* variant;
+    trace_op_t* trace;
+    size_t trace_len;
+    size_t n_records;
+    size_t n_ops;
+    size_t key_size;
+    size_t value_size;
+    size_t n_threads;
+    double target;
+    double theta;
+} ycsb_config_t;
+
+typedef struct ycsb_shared {
+    const ycsb_config_t* config;
+    hashtable_t* ht;
+    pthread_mutex_t lock;
+    // Next record id to insert
+    atomic_uint_fast64_t next_id;
+    size_t failed_inserts;
+} ycsb_shared_t;
+
+typedef struct ycsb_thread {
+    ycsb_shared_t* shared;
+    size_t index;
+    pthread_t thread;
+    hdr_histogram_t* histograms[YCSB_N_OPS];
+} ycsb_thread_t;
+
+// Key length used by key_compare and key_hash, which take no context
+static size_t key_size;
+
+static int key_compare(const void* a, const void* b) {
+    return memcmp(a, b, key_size) != 0;
+}
+
+static size_t key_hash(const void* key) {
+    const unsigned char* bytes = key;
+    uint64_t hash = 0xCBF29CE484222325ULL;
+
+    for (size_t i = 0; i < key_size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+    }
+    return (size_t)(hash ^ (hash >> 32));
+}
+
+/*
+ * Function: make_key
+ * --------------------
+ *  Writes the key of a record id, the id followed by filler derived from it.
+ *
+ *  returns: Nothing.
+ */
+static void make_key(uint64_t id, unsigned char* key) {
+    memcpy(key, &id, sizeof(uint64_t));
+    for (size_t i = sizeof(uint64_t); i < key_size; i++) {
+        key[i] = (unsigned char)('a' + (id + i) % 26);
+    }
+}
+
+/*
+ * Function: make_record
+ * --------------------
+ *  Allocates a record as one block, key first then value.
+ *
+ *  returns: Pointer to the record.
+ */
+static unsigned char* make_record(const ycsb_config_t* config, uint64_t id) {
+    unsigned char* record = malloc(config->key_size + config->value_size);
+    if (!record) {
+        perror("bench_ycsb");
+        exit(1);
+    }
+
+    make_key(id, record);
+    memset(record + config->key_size, (int)(id & 0xFF), config->value_size);
+    return record;
+}
+
+/*
+ * Function: insert_record
+ * --------------------
+ *  Inserts a record unless its key is already present, in which case the
+ *  value is overwritten in place. Caller holds the lock.
+ *
+ *  returns: Nothing.
+ */
+static void insert_record(ycsb_shared_t* shared, uint64_t id,
+                unsigned char* key) {
+    const ycsb_config_t* config = shared->config;
+    unsigned char* value = ht_search(shared->ht, key);
+
+    if (value) {
+        memset(value, (int)(id & 0xFF), config->value_size);
+        return;
+    }
+
+    unsigned char* record = make_record(config, id);
+    if (!ht_try_insert(shared->ht, record, record + config->key_size)) {
+        shared->failed_inserts++;
+        free(record);
+    }
+}
+
+/*
+ * Function: run_op
+ * --------------------
+ *  Runs one operation under the table lock.
+ *
+ *  returns: Value bytes touched, so the work is not optimised out.
+ */
+static uint64_t run_op(ycsb_shared_t* shared, ycsb_op_t op, uint64_t id,
+                uint32_t length, unsigned char* key) {
+    const ycsb_config_t* config = shared->config;
+    uint64_t touched = 0;
+    unsigned char* value = NULL;
+
+    pthread_mutex_lock(&shared->lock);
+    switch (op) {
+        case YCSB_READ:
+            make_key(id, key);
+            if ((value = ht_search(shared->ht, key))) {
+                touched += value[0];
+            }
+            break;
+        case YCSB_UPDATE:
+            make_key(id, key);
+            if ((value = ht_search(shared->ht, key))) {
+                memset(value, (int)(id & 0xFF), config->value_size);
+            }
+            break;
+        case YCSB_INSERT:
+            make_key(id, key);
+            insert_record(shared, id, key);
+            break;
+        case YCSB_SCAN:
+            for (uint32_t i = 0; i < length; i++) {
+                make_key(id + i, key);
+                if ((value = ht_search(shared->ht, key))) {
+                    touched += value[0];
+                }
+            }
+            break;
+        case YCSB_RMW:
+            make_key(id, key);
+            if ((value = ht_search(shared->ht, key))) {
+                touched += value[0];
+                value[0]++;
+            }
+            break;
+        default:
+            break;
+    }
+    pthread_mutex_unlock(&shared->lock);
+
+    return touched;
+}
+
+/*
+ * Function: next_op
+ * --------------------
+ *  Draws the next operation of a YCSB mix.
+ *
+ *  returns: Nothing.
+ */
+static void next_op(ycsb_shared_t* shared, zipf_t* zipf, uint64_t* state,
+                trace_op_t* out) {
+    const ycsb_config_t* config = shared->config;
+    double roll = workload_rand_double(state);
+    int op = 0;
+
+    while (op < YCSB_N_OPS - 1 && roll >= config->mix->proportions[op]) {
+        roll -= config->mix->proportions[op];
+        op++;
+    }
+    out->op = (ycsb_op_t)op;
+    out->length = 1;
+
+    if (op == YCSB_INSERT) {
+        out->id = atomic_fetch_add(&shared->next_id, 1);
+        return;
+    }
+
+    uint64_t n_ids = atomic_load(&shared->next_id);
+    uint64_t rank = zipf_next(zipf, state);
+
+    if (config->mix->dist == DIST_LATEST) {
+        // Most recent inserts are the most popular
+        out->id = n_ids - 1 - rank % n_ids;
+    } else {
+        // Scatter popular ranks over the key space
+        out->id = (rank * 0x9E3779B97F4A7C15ULL) % config->n_records;
+    }
+
+    if (op == YCSB_SCAN) {
+        out->length = 1 + (uint32_t)(workload_rand(state) % MAX_SCAN_LENGTH);
+    }
+}
+
+/*
+ * Function: run_thread
+ * --------------------
+ *  Issues this thread's share of the operations, paced when a target
+ *  throughput is set.
+ *
+ *  returns: NULL.
+ */
+static void* run_thread(void* arg) {
+    ycsb_thread_t* thread = arg;
+    ycsb_shared_t* shared = thread->shared;
+    const ycsb_config_t* config = shared->config;
+    unsigned char* key = malloc(config->key_size);
+    uint64_t state = 0xC0FFEE + thread->index;
+    volatile uint64_t sink = 0;
+    zipf_t zipf;
+
+    zipf_init(&zipf, config->n_records, config->theta);
+
+    size_t total = config->trace ? config->trace_len : config->n_ops;
+    size_t n_ops = total / config->n_threads +
+                (thread->index < total % config->n_threads);
+    double interval = config->target > 0.0 ?
+                1e9 * (double)config->n_threads / config->target : 0.0;
+    uint64_t start = bench_now_ns();
+
+    for (size_t i = 0; i < n_ops; i++) {
+        trace_op_t op;
+        uint64_t scheduled = start + (uint64_t)(interval * (double)i);
+
+        if (config->trace) {
+            op = config->trace[i * config->n_threads + thread->index];
+        } else {
+            next_op(shared, &zipf, &state, &op);
+        }
+
+        // Wait for the slot, latency then counts from the slot not the start.
+        // Sleep most of a long wait and spin the rest, so sleep overshoot is
+        // not charged to the operation.
+        uint64_t now = bench_now_ns();
+        if (interval > 0.0 && now + SPIN_NS < scheduled) {
+            uint64_t sleep_ns = scheduled - now - SPIN_NS;
+            struct timespec ts = {
+                .tv_sec = (time_t)(sleep_ns / 1000000000ULL),
+                .tv_nsec = (long)(sleep_ns % 1000000000ULL)
+            };
+            nanosleep(&ts, NULL);
+        }
+        while (interval > 0.0 && bench_now_ns() < scheduled) {
+        }
+        uint64_t begin = interval > 0.0 ? scheduled : bench_now_ns();
+
+        sink += run_op(shared, op.op, op.id, op.length, key);
+        hdr_record(thread->histograms[op.op], bench_now_ns() - begin);
+    }
+
+    free(key);
+    return NULL;
+}
+
+/*
+ * Function: load_trace
+ * --------------------
+ *  Reads a recorded access trace.
+ *
+ *  returns: Nothing.
+ */
+static void load_trace(ycsb_config_t* config, const char* path) {
+    FILE* file = fopen(path, "r");
+    size_t capacity = 1024;
+    char name[16];
+    unsigned long long id;
+    unsigned length;
+    char line[256];
+
+    if (!file) {
+        perror(path);
+        exit(1);
+    }
+
+    config->trace = malloc(sizeof(trace_op_t) * capacity);
+    config->trace_len = 0;
+
+    while (fgets(line, sizeof(line), file)) {
+        int fields = sscanf(line, "%15s %llu %u", name, &id, &length);
+        int op = 0;
+
+        if (fields < 2) {
+            continue;
+        }
+        while (op < YCSB_N_OPS && strcmp(name, OP_NAMES[op])) {
+            op++;
+        }
+        if (op == YCSB_N_OPS) {
+            fprintf(stderr, "bench_ycsb: unknown trace op %s\n", name);
+            exit(1);
+        }
+
+        if (config->trace_len == capacity) {
+            capacity *= 2;
+            config->trace = realloc(config->trace,
+                        sizeof(trace_op_t) * capacity);
+        }
+        if (!config->trace) {
+            perror("bench_ycsb");
+            exit(1);
+        }
+
+        trace_op_t* op_out = &config->trace[config->trace_len++];
+        op_out->op = (ycsb_op_t)op;
+        op_out->id = id;
+        op_out->length = fields > 2 && length ? length : 1;
+    }
+
+    fclose(file);
+}
+
+/*
+ * Function: create_table
+ * --------------------
+ *  Creates the hashtable variant under test.
+ *
+ *  returns: Pointer to the hashtable.
+ */
+static hashtable_t* create_table(const ycsb_config_t* config) {
+    if (!strcmp(config->variant, "malloc")) {
+        allocator_t allocator = allocator_malloc();
+        return ht_create_with_allocator(INITIAL_TABLE_SIZE, key_compare,
+                    key_hash, &allocator);
+    }
+
+    if (!strcmp(config->variant, "fixed")) {
+        // Room for the load and every insert the run could make
+        size_t ops = config->trace ? config->trace_len : config->n_ops;
+        return ht_create_fixed(config->n_records + ops, key_compare,
+                    key_hash);
+    }
+
+    return ht_create(INITIAL_TABLE_SIZE, key_compare, key_hash);
+}
+
+/*
+ * Function: report
+ * --------------------
+ *  Prints the latency percentiles of one operation as a JSON line.
+ *
+ *  returns: Nothing.
+ */
+static void report(const ycsb_config_t* config, const char* op,
+                const hdr_histogram_t* hdr) {
+    static const double percentiles[] = {50.0, 90.0, 99.0, 99.9, 99.99};
+    static const char* names[] = {"p50", "p90", "p99", "p99_9", "p99_99"};
+    char workload[8] = "trace";
+
+    if (!config->trace) {
+        snprintf(workload, sizeof(workload), "%c", config->mix->name);
+    }
+
+    printf("{\"suite\":\"ycsb\",\"workload\":\"%s\",\"variant\":\"%s\","
+                "\"threads\":%zu,\"op\":\"%s\",\"count\":%llu,"
+                "\"mean_ns\":%.1f", workload, config->variant,
+                config->n_threads, op, (unsigned long long)hdr->total,
+                hdr_mean(hdr));
+
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(double); i++) {
+        printf(",\"%s_ns\":%llu", names[i], (unsigned long long)
+                    hdr_value_at_percentile(hdr, percentiles[i]));
+    }
+    printf(",\"max_ns\":%llu}\n", (unsigned long long)hdr->max);
+}
+
+int main(int argc, char** argv) {
+    ycsb_config_t config = {
+        .mix = &MIXES[0],
+        .variant = "default",
+        .trace = NULL,
+        .trace_len = 0,
+        .n_records = DEFAULT_RECORDS,
+        .n_ops = DEFAULT_OPS,
+        .key_size = DEFAULT_KEY_SIZE,
+        .value_size = DEFAULT_VALUE_SIZE,
+        .n_threads = 1,
+        .target = 0.0,
+        .theta = 0.99
+    };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "w:f:r:o:k:v:t:R:V:z:")) != -1) {
+        switch (opt) {
+            case 'w':
+                if (optarg[0] < 'a' || optarg[0] > 'f') {
+                    fprintf(stderr, "bench_ycsb: workload is a to f\n");
+                    return 1;
+                }
+                config.mix = &MIXES[optarg[0] - 'a'];
+                break;
+            case 'f': load_trace(&config, optarg); break;
+            case 'r': config.n_records = strtoull(optarg, NULL, 10); break;
+            case 'o': config.n_ops = strtoull(optarg, NULL, 10); break;
+            case 'k': config.key_size = strtoull(optarg, NULL, 10); break;
+            case 'v': config.value_size = strtoull(optarg, NULL, 10); break;
+            case 't': config.n_threads = strtoull(optarg, NULL, 10); break;
+            case 'R': config.target = strtod(optarg, NULL); break;
+            case 'V': config.variant = optarg; break;
+            case 'z': config.theta = strtod(optarg, NULL); break;
+            default: return 1;
+        }
+    }
+
+    if (config.key_size < sizeof(uint64_t) || !config.value_size ||
+                !config.n_records || !config.n_threads) {
+        fprintf(stderr, "bench_ycsb: key_size must be at least 8, records, "
+                    "value_size and threads at least 1\n");
+        return 1;
+    }
+    key_size = config.key_size;
+
+    // Load phase
+    ycsb_shared_t shared;
+    shared.config = &config;
+    shared.ht = create_table(&config);
+    shared.failed_inserts = 0;
+    pthread_mutex_init(&shared.lock, NULL);
+    atomic_init(&shared.next_id, config.n_records);
+
+    unsigned char* key = malloc(config.key_size);
+    uint64_t start = bench_now_ns();
+    for (uint64_t id = 0; id < config.n_records; id++) {
+        make_key(id, key);
+        insert_record(&shared, id, key);
+    }
+    uint64_t load_ns = bench_now_ns() - start;
+    free(key);
+
+    // Run phase
+    ycsb_thread_t* threads = malloc(sizeof(ycsb_thread_t) * config.n_threads);
+    start = bench_now_ns();
+    for (size_t t = 0; t < config.n_threads; t++) {
+        threads[t].shared = &shared;
+        threads[t].index = t;
+        for (int op = 0; op < YCSB_N_OPS; op++) {
+            threads[t].histograms[op] = hdr_create(HIGHEST_LATENCY_NS,
+                        SIGNIFICANT_FIGURES);
+        }
+        pthread_create(&threads[t].thread, NULL, run_thread, &threads[t]);
+    }
+    for (size_t t = 0; t < config.n_threads; t++) {
+        pthread_join(threads[t].thread, NULL);
+    }
+    uint64_t run_ns = bench_now_ns() - start;
+
+    // Merge per thread histograms
+    hdr_histogram_t* all = hdr_create(HIGHEST_LATENCY_NS,
+                SIGNIFICANT_FIGURES);
+    for (int op = 0; op < YCSB_N_OPS; op++) {
+        hdr_histogram_t* merged = hdr_create(HIGHEST_LATENCY_NS,
+                    SIGNIFICANT_FIGURES);
+
+        for (size_t t = 0; t < config.n_threads; t++) {
+            hdr_add(merged, threads[t].histograms[op]);
+            hdr_clean(threads[t].histograms[op]);
+        }
+        if (merged->total) {
+            report(&config, OP_NAMES[op], merged);
+        }
+        hdr_add(all, merged);
+        hdr_clean(merged);
+    }
+    report(&config, "all", all);
+
+    printf("{\"suite\":\"ycsb\",\"bench\":\"summary\",\"records\":%zu,"
+                "\"ops\":%llu,\"load_ops_per_sec\":%.0f,"
+                "\"run_ops_per_sec\":%.0f,\"failed_inserts\":%zu}\n",
+                config.n_records, (unsigned long long)all->total,
+                1e9 * (double)config.n_records / (double)load_ns,
+                1e9 * (double)all->total / (double)run_ns,
+                shared.failed_inserts);
+
+    hdr_clean(all);
+    free(threads);
+    ht_clean(shared.ht, free, NULL);
+    pthread_mutex_destroy(&shared.lock);
+    free(config.trace);
+
+    return 0;
+}
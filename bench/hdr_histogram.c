@@ -0,0 +1,223 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a minimal high dynamic range histogram for latency
+         percentiles. Recording is O(1) with no allocation, and per thread
+         histograms merge by adding counts.
+*/
+
+#include "hdr_histogram.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/**** PUBLIC ****/
+
+/*
+ * Function: hdr_create
+ * --------------------
+ *  Creates an empty histogram.
+ *
+ *  highest: Highest value to track, larger values are clamped to it.
+ *  significant_figures: Precision kept for every value, 1 to 5.
+ *
+ *  returns: Pointer to the new histogram.
+ */
+hdr_histogram_t* hdr_create(uint64_t highest, int significant_figures) {
+    assert(highest >= 2);
+    assert(significant_figures >= 1 && significant_figures <= 5);
+
+    hdr_histogram_t* hdr = malloc(sizeof(hdr_histogram_t));
+    assert(hdr);
+
+    // Values below this need single unit resolution to keep the precision
+    uint64_t single_unit = 2;
+    for (int i = 0; i < significant_figures; i++) {
+        single_unit *= 10;
+    }
+
+    int magnitude = 0;
+    while ((1ULL << magnitude) < single_unit) {
+        magnitude++;
+    }
+
+    hdr->highest = highest;
+    hdr->sub_bucket_half_count_magnitude = magnitude - 1;
+    hdr->sub_bucket_count = (size_t)1 << magnitude;
+    hdr->sub_bucket_half_count = hdr->sub_bucket_count / 2;
+    hdr->sub_bucket_mask = hdr->sub_bucket_count - 1;
+
+    // Each further bucket doubles the trackable range
+    uint64_t trackable = hdr->sub_bucket_count;
+    hdr->bucket_count = 1;
+    while (trackable <= highest) {
+        if (trackable > UINT64_MAX / 2) {
+            hdr->bucket_count++;
+            break;
+        }
+        trackable <<= 1;
+        hdr->bucket_count++;
+    }
+
+    hdr->counts_len = (hdr->bucket_count + 1) * hdr->sub_bucket_half_count;
+    hdr->counts = calloc(hdr->counts_len, sizeof(uint64_t));
+    assert(hdr->counts);
+
+    hdr->total = 0;
+    hdr->min = UINT64_MAX;
+    hdr->max = 0;
+    hdr->sum = 0.0;
+
+    return hdr;
+}
+
+/*
+ * Function: hdr_record
+ * --------------------
+ *  Records one value.
+ *
+ *  hdr: Pointer to the histogram.
+ *  value: Value to record.
+ *
+ *  returns: Nothing.
+ */
+void hdr_record(hdr_histogram_t* hdr, uint64_t value) {
+    assert(hdr);
+
+    if (value > hdr->highest) {
+        value = hdr->highest;
+    }
+
+    hdr->counts[_hdr_index(hdr, value)]++;
+    hdr->total++;
+    hdr->sum += (double)value;
+    hdr->min = value < hdr->min ? value : hdr->min;
+    hdr->max = value > hdr->max ? value : hdr->max;
+}
+
+/*
+ * Function: hdr_add
+ * --------------------
+ *  Adds every value of one histogram to another with the same layout, as
+ *  when merging per thread histograms.
+ *
+ *  dst: Histogram to add to.
+ *  src: Histogram to add.
+ *
+ *  returns: Nothing.
+ */
+void hdr_add(hdr_histogram_t* dst, const hdr_histogram_t* src) {
+    assert(dst && src);
+    assert(dst->counts_len == src->counts_len);
+
+    for (size_t i = 0; i < src->counts_len; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+
+    dst->total += src->total;
+    dst->sum += src->sum;
+    dst->min = src->min < dst->min ? src->min : dst->min;
+    dst->max = src->max > dst->max ? src->max : dst->max;
+}
+
+/*
+ * Function: hdr_value_at_percentile
+ * --------------------
+ *  Gets the value at or below which a percentage of values fall.
+ *
+ *  hdr: Pointer to the histogram.
+ *  percentile: Percentile in [0, 100].
+ *
+ *  returns: Highest value equivalent to the percentile, 0 if empty.
+ */
+uint64_t hdr_value_at_percentile(const hdr_histogram_t* hdr,
+                double percentile) {
+    assert(hdr);
+
+    if (!hdr->total) {
+        return 0;
+    }
+
+    // Rank of the value, at least the first one
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)hdr->total + 0.5);
+    rank = rank ? rank : 1;
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i < hdr->counts_len; i++) {
+        seen += hdr->counts[i];
+        if (seen >= rank) {
+            uint64_t value = _hdr_highest_equivalent(hdr, i);
+            return value < hdr->max ? value : hdr->max;
+        }
+    }
+
+    return hdr->max;
+}
+
+/*
+ * Function: hdr_mean
+ * --------------------
+ *  Gets the mean of the recorded values.
+ *
+ *  hdr: Pointer to the histogram.
+ *
+ *  returns: Mean, 0 if empty.
+ */
+double hdr_mean(const hdr_histogram_t* hdr) {
+    assert(hdr);
+    return hdr->total ? hdr->sum / (double)hdr->total : 0.0;
+}
+
+/*
+ * Function: hdr_clean
+ * --------------------
+ *  Frees the histogram.
+ *
+ *  hdr: Pointer to the histogram.
+ *
+ *  returns: Nothing.
+ */
+void hdr_clean(hdr_histogram_t* hdr) {
+    assert(hdr);
+    free(hdr->counts);
+    free(hdr);
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _hdr_index
+ * --------------------
+ *  Gets the counts index of a value.
+ *
+ *  returns: Index into counts.
+ */
+size_t _hdr_index(const hdr_histogram_t* hdr, uint64_t value) {
+    // Bucket from the top set bit, the first bucket covers the sub buckets
+    int pow2_ceiling = 64 - __builtin_clzll(value | hdr->sub_bucket_mask);
+    int bucket = pow2_ceiling - (hdr->sub_bucket_half_count_magnitude + 1);
+    size_t sub_bucket = (size_t)(value >> bucket);
+
+    return ((size_t)(bucket + 1) << hdr->sub_bucket_half_count_magnitude) +
+                (sub_bucket - hdr->sub_bucket_half_count);
+}
+
+/*
+ * Function: _hdr_highest_equivalent
+ * --------------------
+ *  Gets the highest value counted at a counts index.
+ *
+ *  returns: Highest value of the index's sub bucket.
+ */
+uint64_t _hdr_highest_equivalent(const hdr_histogram_t* hdr, size_t index) {
+    int bucket = (int)(index >> hdr->sub_bucket_half_count_magnitude) - 1;
+    size_t sub_bucket = (index & (hdr->sub_bucket_half_count - 1)) +
+                hdr->sub_bucket_half_count;
+
+    if (bucket < 0) {
+        sub_bucket -= hdr->sub_bucket_half_count;
+        bucket = 0;
+    }
+
+    uint64_t value = (uint64_t)sub_bucket << bucket;
+    return value + ((1ULL << bucket) - 1);
+}
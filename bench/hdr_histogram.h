@@ -0,0 +1,121 @@
+#ifndef HDR_HISTOGRAM_H
+#define HDR_HISTOGRAM_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/*
+ * High dynamic range histogram (Tene): buckets double in width and each is
+ * split into linear sub buckets, so every recorded value keeps the given
+ * number of significant figures from 1 up to highest.
+ */
+typedef struct hdr_histogram {
+    uint64_t highest;
+    int sub_bucket_half_count_magnitude;
+    size_t sub_bucket_count;
+    size_t sub_bucket_half_count;
+    uint64_t sub_bucket_mask;
+    size_t bucket_count;
+    size_t counts_len;
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    // Sum of recorded values, for the mean
+    double sum;
+    uint64_t* counts;
+} hdr_histogram_t;
+
+/**** PUBLIC ****/
+
+/*
+ * Function: hdr_create
+ * --------------------
+ *  Creates an empty histogram.
+ *
+ *  highest: Highest value to track, larger values are clamped to it.
+ *  significant_figures: Precision kept for every value, 1 to 5.
+ *
+ *  returns: Pointer to the new histogram.
+ */
+hdr_histogram_t* hdr_create(uint64_t highest, int significant_figures);
+
+/*
+ * Function: hdr_record
+ * --------------------
+ *  Records one value.
+ *
+ *  hdr: Pointer to the histogram.
+ *  value: Value to record.
+ *
+ *  returns: Nothing.
+ */
+void hdr_record(hdr_histogram_t* hdr, uint64_t value);
+
+/*
+ * Function: hdr_add
+ * --------------------
+ *  Adds every value of one histogram to another with the same layout, as
+ *  when merging per thread histograms.
+ *
+ *  dst: Histogram to add to.
+ *  src: Histogram to add.
+ *
+ *  returns: Nothing.
+ */
+void hdr_add(hdr_histogram_t* dst, const hdr_histogram_t* src);
+
+/*
+ * Function: hdr_value_at_percentile
+ * --------------------
+ *  Gets the value at or below which a percentage of values fall.
+ *
+ *  hdr: Pointer to the histogram.
+ *  percentile: Percentile in [0, 100].
+ *
+ *  returns: Highest value equivalent to the percentile, 0 if empty.
+ */
+uint64_t hdr_value_at_percentile(const hdr_histogram_t* hdr,
+                double percentile);
+
+/*
+ * Function: hdr_mean
+ * --------------------
+ *  Gets the mean of the recorded values.
+ *
+ *  hdr: Pointer to the histogram.
+ *
+ *  returns: Mean, 0 if empty.
+ */
+double hdr_mean(const hdr_histogram_t* hdr);
+
+/*
+ * Function: hdr_clean
+ * --------------------
+ *  Frees the histogram.
+ *
+ *  hdr: Pointer to the histogram.
+ *
+ *  returns: Nothing.
+ */
+void hdr_clean(hdr_histogram_t* hdr);
+
+/**** PRIVATE ****/
+/*
+ * Function: _hdr_index
+ * --------------------
+ *  Gets the counts index of a value.
+ *
+ *  returns: Index into counts.
+ */
+size_t _hdr_index(const hdr_histogram_t* hdr, uint64_t value);
+
+/*
+ * Function: _hdr_highest_equivalent
+ * --------------------
+ *  Gets the highest value counted at a counts index.
+ *
+ *  returns: Highest value of the index's sub bucket.
+ */
+uint64_t _hdr_highest_equivalent(const hdr_histogram_t* hdr, size_t index);
+
+#endif
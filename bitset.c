@@ -0,0 +1,126 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a custom fixed size bitset library, used for visited and
+         frontier sets over dense vertex ids.
+*/
+
+#include "bitset.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+/*
+ * Function: bitset_create
+ * --------------------
+ *  Creates a new bitset with all bits cleared.
+ *
+ *  n_bits: Number of bits in the bitset.
+ *
+ *  returns: Pointer to the new bitset.
+ */
+bitset_t* bitset_create(size_t n_bits) {
+    bitset_t* bitset = malloc(sizeof(bitset_t));
+    assert(bitset);
+
+    // Round up to whole words, always keep at least one word
+    bitset->n_bits = n_bits;
+    bitset->n_words = (n_bits + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+    if (bitset->n_words == 0) {
+        bitset->n_words = 1;
+    }
+
+    bitset->words = calloc(bitset->n_words, sizeof(uint64_t));
+    assert(bitset->words);
+
+    return bitset;
+}
+
+/*
+ * Function: bitset_reset
+ * --------------------
+ *  Clears every bit in the bitset.
+ *
+ *  bitset: Pointer to the bitset.
+ *
+ *  returns: Nothing.
+ */
+void bitset_reset(bitset_t* bitset) {
+    assert(bitset);
+    memset(bitset->words, 0, bitset->n_words * sizeof(uint64_t));
+}
+
+/*
+ * Function: bitset_count
+ * --------------------
+ *  Counts the number of set bits in the bitset.
+ *
+ *  bitset: Pointer to the bitset.
+ *
+ *  returns: Number of set bits.
+ */
+size_t bitset_count(bitset_t* bitset) {
+    assert(bitset);
+    size_t count = 0;
+
+    for (size_t i = 0; i < bitset->n_words; i++) {
+        count += (size_t)__builtin_popcountll(bitset->words[i]);
+    }
+
+    return count;
+}
+
+/*
+ * Function: bitset_swap
+ * --------------------
+ *  Swaps the contents of two bitsets of equal size without copying.
+ *
+ *  a: Pointer to the first bitset.
+ *  b: Pointer to the second bitset.
+ *
+ *  returns: Nothing.
+ */
+void bitset_swap(bitset_t* a, bitset_t* b) {
+    assert(a && b);
+    assert(a->n_words == b->n_words);
+
+    uint64_t* words = a->words;
+    a->words = b->words;
+    b->words = words;
+}
+
+/*
+ * Function: bitset_clean
+ * --------------------
+ *  Frees the bitset.
+ *
+ *  bitset: Pointer to the bitset.
+ *
+ *  returns: Nothing.
+ */
+void bitset_clean(bitset_t* bitset) {
+    assert(bitset);
+    free(bitset->words);
+    free(bitset);
+}
+
+/*
+ * Function: bitset_memory_usage
+ * --------------------
+ *  Gets the memory bitset uses.
+ *
+ *  bitset: Pointer to the bitset.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t bitset_memory_usage(bitset_t* bitset, memory_usage_t* usage) {
+    assert(bitset);
+    assert(usage);
+    memset(usage, 0, sizeof(memory_usage_t));
+
+    allocator_account(NULL, sizeof(bitset_t), 1, &usage->header, usage);
+    allocator_account(NULL, sizeof(uint64_t) * bitset->n_words, 1,
+                &usage->buckets, usage);
+
+    return usage->total;
+}
@@ -0,0 +1,169 @@
+#ifndef BITSET_H
+#define BITSET_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "allocator.h"
+
+#define BITSET_WORD_BITS 64
+
+typedef struct bitset {
+    size_t n_bits;
+    size_t n_words;
+    uint64_t* words;
+} bitset_t;
+
+/*
+ * Function: bitset_create
+ * --------------------
+ *  Creates a new bitset with all bits cleared.
+ *
+ *  n_bits: Number of bits in the bitset.
+ *
+ *  returns: Pointer to the new bitset.
+ */
+bitset_t* bitset_create(size_t n_bits);
+
+/*
+ * Function: bitset_reset
+ * --------------------
+ *  Clears every bit in the bitset.
+ *
+ *  bitset: Pointer to the bitset.
+ *
+ *  returns: Nothing.
+ */
+void bitset_reset(bitset_t* bitset);
+
+/*
+ * Function: bitset_count
+ * --------------------
+ *  Counts the number of set bits in the bitset.
+ *
+ *  bitset: Pointer to the bitset.
+ *
+ *  returns: Number of set bits.
+ */
+size_t bitset_count(bitset_t* bitset);
+
+/*
+ * Function: bitset_swap
+ * --------------------
+ *  Swaps the contents of two bitsets of equal size without copying.
+ *
+ *  a: Pointer to the first bitset.
+ *  b: Pointer to the second bitset.
+ *
+ *  returns: Nothing.
+ */
+void bitset_swap(bitset_t* a, bitset_t* b);
+
+/*
+ * Function: bitset_clean
+ * --------------------
+ *  Frees the bitset.
+ *
+ *  bitset: Pointer to the bitset.
+ *
+ *  returns: Nothing.
+ */
+void bitset_clean(bitset_t* bitset);
+
+/* BIT ACCESS */
+/* Kept inline as they sit on the inner loop of every traversal */
+
+/*
+ * Function: bitset_test
+ * --------------------
+ *  Checks if a bit is set.
+ *
+ *  bitset: Pointer to the bitset.
+ *  bit: Index of the bit.
+ *
+ *  returns: True if the bit is set, false otherwise.
+ */
+static inline bool bitset_test(const bitset_t* bitset, size_t bit) {
+    return (bitset->words[bit / BITSET_WORD_BITS] >>
+                (bit % BITSET_WORD_BITS)) & 1;
+}
+
+/*
+ * Function: bitset_set
+ * --------------------
+ *  Sets a bit.
+ *
+ *  bitset: Pointer to the bitset.
+ *  bit: Index of the bit.
+ *
+ *  returns: Nothing.
+ */
+static inline void bitset_set(bitset_t* bitset, size_t bit) {
+    bitset->words[bit / BITSET_WORD_BITS] |=
+                (uint64_t)1 << (bit % BITSET_WORD_BITS);
+}
+
+/*
+ * Function: bitset_clear
+ * --------------------
+ *  Clears a bit.
+ *
+ *  bitset: Pointer to the bitset.
+ *  bit: Index of the bit.
+ *
+ *  returns: Nothing.
+ */
+static inline void bitset_clear(bitset_t* bitset, size_t bit) {
+    bitset->words[bit / BITSET_WORD_BITS] &=
+                ~((uint64_t)1 << (bit % BITSET_WORD_BITS));
+}
+
+/*
+ * Function: bitset_set_atomic
+ * --------------------
+ *  Sets a bit, safe against concurrent updates to the same word.
+ *
+ *  bitset: Pointer to the bitset.
+ *  bit: Index of the bit.
+ *
+ *  returns: Nothing.
+ */
+static inline void bitset_set_atomic(bitset_t* bitset, size_t bit) {
+    __atomic_fetch_or(&bitset->words[bit / BITSET_WORD_BITS],
+                (uint64_t)1 << (bit % BITSET_WORD_BITS), __ATOMIC_RELAXED);
+}
+
+/*
+ * Function: bitset_test_and_set_atomic
+ * --------------------
+ *  Atomically sets a bit and reports whether it was previously set. A plain
+ *  read is tried first so already visited bits do not dirty the cache line.
+ *
+ *  bitset: Pointer to the bitset.
+ *  bit: Index of the bit.
+ *
+ *  returns: True if the bit was already set, false if this call set it.
+ */
+static inline bool bitset_test_and_set_atomic(bitset_t* bitset, size_t bit) {
+    uint64_t mask = (uint64_t)1 << (bit % BITSET_WORD_BITS);
+    uint64_t* word = &bitset->words[bit / BITSET_WORD_BITS];
+
+    if (__atomic_load_n(word, __ATOMIC_RELAXED) & mask) {
+        return true;
+    }
+    return __atomic_fetch_or(word, mask, __ATOMIC_RELAXED) & mask;
+}
+
+/*
+ * Function: bitset_memory_usage
+ * --------------------
+ *  Gets the memory bitset uses.
+ *
+ *  bitset: Pointer to the bitset.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t bitset_memory_usage(bitset_t* bitset, memory_usage_t* usage);
+
+#endif
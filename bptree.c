@@ -0,0 +1,978 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a custom B+-tree library, an ordered map for range
+         and prefix queries. Nodes are BPTREE_NODE_BYTES wide, a few cache
+         lines by default, so a lookup touches one node per level and a
+         scan reads leaves front to back along their next links while the
+         leaf after the current one is prefetched. Integer keys are stored
+         in the nodes and searched with GCC vector extensions, other keys
+         are pointers ordered by a compare function.
+*/
+
+#include "bptree.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <assert.h>
+#include "alloctrack.h"
+
+// Unsigned 64 bit lane compares need SSE4.2 on x86, SSE2 emulates them
+// slower than scalar compares
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(DSL_NO_SIMD) && \
+            (defined(__SSE4_2__) || \
+            !(defined(__x86_64__) || defined(__i386__)))
+#define BPTREE_HAVE_SIMD
+#if defined(__AVX2__)
+#define BPTREE_SIMD_BYTES 32
+#else
+#define BPTREE_SIMD_BYTES 16
+#endif
+#define BPTREE_LANES (BPTREE_SIMD_BYTES / sizeof(uintptr_t))
+
+typedef uintptr_t _bptree_v_key
+            __attribute__((vector_size(BPTREE_SIMD_BYTES)));
+
+// Keys a node search compares at once, two vectors
+#define BPTREE_WINDOW (2 * BPTREE_LANES)
+#else
+#define BPTREE_WINDOW 4
+#endif
+
+// Cache line size prefetches step by
+#define BPTREE_LINE_BYTES 64
+
+#define BPTREE_NEXT(leaf) ((bptree_node_t*)(leaf)->slots[BPTREE_ORDER])
+
+/*
+ * Prefetches the keys of a node, so the cache lines a search will touch
+ * load in parallel rather than one miss after another.
+ */
+static inline void _bptree_prefetch_keys(const bptree_node_t* node) {
+    const char* keys = (const char*)node;
+    for (size_t off = 0; off < offsetof(bptree_node_t, slots);
+                off += BPTREE_LINE_BYTES) {
+        DSL_PREFETCH(keys + off);
+    }
+}
+
+/*
+ * Counts the integer keys of a node below key, or not above it if
+ * inclusive. The keys are sorted, so the count is an index. Halving steps
+ * narrow the search to BPTREE_WINDOW keys, which are compared at once
+ * rather than by a chain of dependent loads.
+ */
+static inline size_t _bptree_count_int(const bptree_node_t* node,
+                uintptr_t key, bool inclusive) {
+    size_t n = node->n_keys, i = 0, width = n;
+
+    // Halving steps compile to conditional moves
+    while (width > BPTREE_WINDOW) {
+        size_t half = width / 2;
+        uintptr_t probe = node->keys[i + half - 1];
+        i += (inclusive ? probe <= key : probe < key) ? half : 0;
+        width -= half;
+    }
+
+#ifdef BPTREE_HAVE_SIMD
+    if (n >= BPTREE_WINDOW) {
+        // Widen the window to whole vectors, keys left of it stay below
+        // key and keys right of it stay above
+        i = i + BPTREE_WINDOW <= n ? i : n - BPTREE_WINDOW;
+        _bptree_v_key needle, counts = { 0 };
+        for (size_t l = 0; l < BPTREE_LANES; l++) {
+            needle[l] = key;
+        }
+        for (size_t v = 0; v < BPTREE_WINDOW; v += BPTREE_LANES) {
+            _bptree_v_key chunk;
+            memcpy(&chunk, node->keys + i + v, sizeof(chunk));
+            if (inclusive) {
+                counts -= (_bptree_v_key)(chunk <= needle);
+            } else {
+                counts -= (_bptree_v_key)(chunk < needle);
+            }
+        }
+        for (size_t l = 0; l < BPTREE_LANES; l++) {
+            i += counts[l];
+        }
+        return i;
+    }
+#endif
+
+    size_t count = i;
+    for (size_t j = i; j < i + width; j++) {
+        count += inclusive ? node->keys[j] <= key : node->keys[j] < key;
+    }
+    return count;
+}
+
+/*
+ * Descends to the leaf whose range holds key. Integer trees take a loop
+ * of known length with the node search inlined, the child's keys are
+ * prefetched while the child pointer is still being loaded.
+ */
+static inline bptree_node_t* _bptree_descend(bptree_t* bt, uintptr_t key) {
+    bptree_node_t* node = bt->root;
+
+    if (bt->compare) {
+        return _bptree_find_leaf(bt, key, NULL, NULL);
+    }
+    for (size_t level = 1; level < bt->height; level++) {
+        node = node->slots[_bptree_count_int(node, key, true)];
+        _bptree_prefetch_keys(node);
+    }
+    return node;
+}
+
+/*
+ * Finds where key is or would go in a leaf, with the integer search
+ * inlined so point lookups make no call after the descent.
+ */
+static inline size_t _bptree_leaf_index(bptree_t* bt, bptree_node_t* leaf,
+                uintptr_t key) {
+    if (bt->compare) {
+        return _bptree_lower_bound(bt, leaf, key);
+    }
+    return _bptree_count_int(leaf, key, false);
+}
+
+/**** PUBLIC ****/
+
+/*
+ * Function: bptree_create
+ * --------------------
+ *  Creates a new B+-tree of pointer keys.
+ *
+ *  compare: Function ordering two keys.
+ *
+ *  returns: Pointer to the new tree.
+ */
+bptree_t* bptree_create(compare_t compare) {
+    assert(compare);
+    return bptree_create_with_allocator(compare, NULL);
+}
+
+/*
+ * Function: bptree_create_int
+ * --------------------
+ *  Creates a new B+-tree of unsigned integer keys, passed with
+ *  BPTREE_INT_KEY.
+ *
+ *  No parameters.
+ *
+ *  returns: Pointer to the new tree.
+ */
+bptree_t* bptree_create_int(void) {
+    return bptree_create_with_allocator(NULL, NULL);
+}
+
+/*
+ * Function: bptree_create_with_allocator
+ * --------------------
+ *  Creates a new B+-tree whose nodes come from an allocator.
+ *
+ *  compare: Function ordering two keys, NULL for integer keys.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new tree.
+ */
+bptree_t* bptree_create_with_allocator(compare_t compare,
+                const allocator_t* allocator) {
+    allocator_t alloc = allocator_resolve(allocator);
+
+    bptree_t* bt = allocator_alloc(&alloc, sizeof(bptree_t));
+    assert(bt);
+
+    bt->compare = compare;
+    bt->n_values = 0;
+    bt->n_inner = 0;
+    bt->n_leaves = 0;
+    bt->height = 1;
+    bt->allocator = alloc;
+    bt->root = _bptree_new_node(bt, true);
+
+    return bt;
+}
+
+/*
+ * Function: bptree_insert
+ * --------------------
+ *  Inserts a key, replacing the value if the key is present. A present
+ *  key keeps the pointer stored first.
+ *
+ *  bt: Pointer to the tree.
+ *  key: Key.
+ *  value: Value.
+ *
+ *  returns: True if the key was new, false if its value was replaced.
+ */
+bool bptree_insert(bptree_t* bt, void* key, void* value) {
+    assert(bt);
+    uintptr_t k = (uintptr_t)key;
+
+    // Full nodes are split on the way down, so a split never has to
+    // climb back up
+    if (bt->root->n_keys == BPTREE_ORDER) {
+        assert(bt->height < BPTREE_MAX_DEPTH);
+        bptree_node_t* root = _bptree_new_node(bt, false);
+        root->slots[0] = bt->root;
+        bt->root = root;
+        bt->height++;
+        _bptree_split_child(bt, root, 0);
+    }
+
+    bptree_node_t* node = bt->root;
+    while (!node->leaf) {
+        size_t index = _bptree_child_index(bt, node, k);
+        bptree_node_t* child = node->slots[index];
+        if (child->n_keys == BPTREE_ORDER) {
+            _bptree_split_child(bt, node, index);
+            if (_bptree_compare(bt, k, node->keys[index]) >= 0) {
+                index++;
+            }
+        }
+        node = node->slots[index];
+    }
+
+    size_t index = _bptree_lower_bound(bt, node, k);
+    if (index < node->n_keys &&
+                !_bptree_compare(bt, node->keys[index], k)) {
+        node->slots[index] = value;
+        return false;
+    }
+    _bptree_insert_entry(node, index, k, value);
+    bt->n_values++;
+    return true;
+}
+
+/*
+ * Function: bptree_search
+ * --------------------
+ *  Searches for a key.
+ *
+ *  bt: Pointer to the tree.
+ *  key: Key to search for.
+ *
+ *  returns: Value of the key, NULL if not found.
+ */
+void* bptree_search(bptree_t* bt, void* key) {
+    assert(bt);
+    uintptr_t k = (uintptr_t)key;
+
+    bptree_node_t* node = _bptree_descend(bt, k);
+    size_t index = _bptree_leaf_index(bt, node, k);
+    if (index < node->n_keys &&
+                !_bptree_compare(bt, node->keys[index], k)) {
+        return node->slots[index];
+    }
+    return NULL;
+}
+
+/*
+ * Function: bptree_contains
+ * --------------------
+ *  Checks if a key is in the tree.
+ *
+ *  bt: Pointer to the tree.
+ *  key: Key to check for.
+ *
+ *  returns: True if found, false otherwise.
+ */
+bool bptree_contains(bptree_t* bt, void* key) {
+    assert(bt);
+    uintptr_t k = (uintptr_t)key;
+
+    bptree_node_t* leaf = _bptree_descend(bt, k);
+    size_t index = _bptree_leaf_index(bt, leaf, k);
+    return index < leaf->n_keys &&
+                !_bptree_compare(bt, leaf->keys[index], k);
+}
+
+/*
+ * Function: bptree_remove
+ * --------------------
+ *  Removes a key, merging or rebalancing nodes that fall below half full.
+ *  Pointer keys are dropped from inner nodes too, so the key may be freed.
+ *
+ *  bt: Pointer to the tree.
+ *  key: Key to remove.
+ *  free_key: Function to free the stored key, may be NULL.
+ *  free_value: Function to free the value, may be NULL.
+ *
+ *  returns: True if the key was removed, false if not found.
+ */
+bool bptree_remove(bptree_t* bt, void* key, free_bptree_t free_key,
+                free_bptree_t free_value) {
+    assert(bt);
+    bptree_node_t* path[BPTREE_MAX_DEPTH];
+    size_t indices[BPTREE_MAX_DEPTH];
+    uintptr_t k = (uintptr_t)key;
+
+    bptree_node_t* leaf = _bptree_find_leaf(bt, k, path, indices);
+    size_t index = _bptree_lower_bound(bt, leaf, k);
+    if (index == leaf->n_keys ||
+                _bptree_compare(bt, leaf->keys[index], k)) {
+        return false;
+    }
+
+    uintptr_t stored = leaf->keys[index];
+    void* value = leaf->slots[index];
+    size_t after = leaf->n_keys - index - 1;
+    memmove(leaf->keys + index, leaf->keys + index + 1,
+                after * sizeof(uintptr_t));
+    memmove(leaf->slots + index, leaf->slots + index + 1,
+                after * sizeof(void*));
+    leaf->n_keys--;
+    bt->n_values--;
+
+    if (bt->height > 1 && leaf->n_keys < BPTREE_MIN_KEYS) {
+        _bptree_rebalance(bt, path, indices, bt->height - 1);
+    }
+    if (bt->compare) {
+        _bptree_replace_separator(bt, stored);
+    }
+
+    if (free_key) {
+        free_key((void*)stored);
+    }
+    if (free_value) {
+        free_value(value);
+    }
+    return true;
+}
+
+/*
+ * Function: bptree_bulk_load
+ * --------------------
+ *  Builds an empty tree bottom up from sorted input, filling leaves to
+ *  BPTREE_BULK_FILL rather than splitting on the way.
+ *
+ *  bt: Pointer to the empty tree.
+ *  keys: Keys in strictly ascending order.
+ *  values: Values of the keys.
+ *  n: Number of keys.
+ *
+ *  returns: Nothing.
+ */
+void bptree_bulk_load(bptree_t* bt, void* const* keys, void* const* values,
+                size_t n) {
+    assert(bt);
+    assert(!bt->n_values);
+    assert(!n || (keys && values));
+
+    if (n <= BPTREE_ORDER) {
+        for (size_t i = 0; i < n; i++) {
+            assert(!i || _bptree_compare(bt, (uintptr_t)keys[i - 1],
+                        (uintptr_t)keys[i]) < 0);
+            bt->root->keys[i] = (uintptr_t)keys[i];
+            bt->root->slots[i] = values[i];
+        }
+        bt->root->n_keys = n;
+        bt->n_values = n;
+        return;
+    }
+
+    // Nodes of the level being built and the smallest key under each
+    size_t n_leaves = (n + BPTREE_BULK_FILL - 1) / BPTREE_BULK_FILL;
+    bptree_node_t** level = malloc(sizeof(bptree_node_t*) * n_leaves);
+    uintptr_t* lows = malloc(sizeof(uintptr_t) * n_leaves);
+    assert(level && lows);
+
+    // Leaves share the keys evenly, so none is left nearly empty
+    _bptree_free_node(bt, bt->root);
+    size_t next = 0;
+    bptree_node_t* prev = NULL;
+    for (size_t l = 0; l < n_leaves; l++) {
+        bptree_node_t* leaf = _bptree_new_node(bt, true);
+        size_t count = n / n_leaves + (l < n % n_leaves);
+        for (size_t i = 0; i < count; i++, next++) {
+            assert(!next || _bptree_compare(bt, (uintptr_t)keys[next - 1],
+                        (uintptr_t)keys[next]) < 0);
+            leaf->keys[i] = (uintptr_t)keys[next];
+            leaf->slots[i] = values[next];
+        }
+        leaf->n_keys = count;
+        if (prev) {
+            prev->slots[BPTREE_ORDER] = leaf;
+        }
+        prev = leaf;
+        level[l] = leaf;
+        lows[l] = leaf->keys[0];
+    }
+
+    // Each inner level takes BPTREE_BULK_FILL + 1 children per node until
+    // one node is left
+    size_t width = n_leaves;
+    bt->height = 1;
+    while (width > 1) {
+        size_t n_parents = (width + BPTREE_BULK_FILL) /
+                    (BPTREE_BULK_FILL + 1);
+        size_t child = 0;
+        for (size_t p = 0; p < n_parents; p++) {
+            bptree_node_t* parent = _bptree_new_node(bt, false);
+            size_t count = width / n_parents + (p < width % n_parents);
+            uintptr_t low = lows[child];
+            parent->slots[0] = level[child++];
+            for (size_t i = 1; i < count; i++, child++) {
+                parent->keys[i - 1] = lows[child];
+                parent->slots[i] = level[child];
+            }
+            parent->n_keys = count - 1;
+            level[p] = parent;
+            lows[p] = low;
+        }
+        width = n_parents;
+        bt->height++;
+        assert(bt->height <= BPTREE_MAX_DEPTH);
+    }
+
+    bt->root = level[0];
+    bt->n_values = n;
+    free(level);
+    free(lows);
+}
+
+/*
+ * Function: bptree_iter_first
+ * --------------------
+ *  Starts a scan of every key in order.
+ *
+ *  bt: Pointer to the tree.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void bptree_iter_first(bptree_t* bt, bptree_iter_t* iter) {
+    assert(bt);
+    assert(iter);
+
+    iter->bt = bt;
+    iter->leaf = _bptree_first_leaf(bt);
+    iter->index = 0;
+    iter->end = 0;
+    iter->bounded = false;
+    DSL_PREFETCH(BPTREE_NEXT(iter->leaf));
+}
+
+/*
+ * Function: bptree_iter_seek
+ * --------------------
+ *  Starts a scan at the first key not less than low.
+ *
+ *  bt: Pointer to the tree.
+ *  low: Key to start from.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void bptree_iter_seek(bptree_t* bt, void* low, bptree_iter_t* iter) {
+    assert(bt);
+    assert(iter);
+    uintptr_t k = (uintptr_t)low;
+
+    iter->bt = bt;
+    iter->leaf = _bptree_descend(bt, k);
+    iter->index = _bptree_lower_bound(bt, iter->leaf, k);
+    iter->end = 0;
+    iter->bounded = false;
+    DSL_PREFETCH(BPTREE_NEXT(iter->leaf));
+}
+
+/*
+ * Function: bptree_range
+ * --------------------
+ *  Starts a scan of the keys in [low, high). A prefix query is the range
+ *  from the prefix to its successor.
+ *
+ *  bt: Pointer to the tree.
+ *  low: Inclusive lower bound.
+ *  high: Exclusive upper bound.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void bptree_range(bptree_t* bt, void* low, void* high, bptree_iter_t* iter) {
+    bptree_iter_seek(bt, low, iter);
+    iter->end = (uintptr_t)high;
+    iter->bounded = true;
+}
+
+/*
+ * Function: bptree_iter_next
+ * --------------------
+ *  Gets the next key and value of a scan. Entering a leaf prefetches the
+ *  one after it.
+ *
+ *  iter: Pointer to the iterator.
+ *  key: Output key, may be NULL.
+ *  value: Output value, may be NULL.
+ *
+ *  returns: True if a key was produced, false at the end of the scan.
+ */
+bool bptree_iter_next(bptree_iter_t* iter, void** key, void** value) {
+    assert(iter);
+
+    while (iter->leaf && iter->index == iter->leaf->n_keys) {
+        iter->leaf = BPTREE_NEXT(iter->leaf);
+        iter->index = 0;
+        if (iter->leaf && BPTREE_NEXT(iter->leaf)) {
+            const char* next = (const char*)BPTREE_NEXT(iter->leaf);
+            for (size_t off = 0; off < sizeof(bptree_node_t);
+                        off += BPTREE_LINE_BYTES) {
+                DSL_PREFETCH(next + off);
+            }
+        }
+    }
+    if (!iter->leaf) {
+        return false;
+    }
+
+    uintptr_t k = iter->leaf->keys[iter->index];
+    if (iter->bounded && _bptree_compare(iter->bt, k, iter->end) >= 0) {
+        iter->leaf = NULL;
+        return false;
+    }
+    if (key) {
+        *key = (void*)k;
+    }
+    if (value) {
+        *value = iter->leaf->slots[iter->index];
+    }
+    iter->index++;
+    return true;
+}
+
+/*
+ * Function: bptree_size
+ * --------------------
+ *  Gets the number of keys.
+ *
+ *  bt: Pointer to the tree.
+ *
+ *  returns: Number of keys.
+ */
+size_t bptree_size(bptree_t* bt) {
+    assert(bt);
+    return bt->n_values;
+}
+
+/*
+ * Function: bptree_clean
+ * --------------------
+ *  Frees the tree.
+ *
+ *  bt: Pointer to the tree.
+ *  free_key: Function to free keys, may be NULL.
+ *  free_value: Function to free values, may be NULL.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void bptree_clean(bptree_t* bt, free_bptree_t free_key,
+                free_bptree_t free_value) {
+    assert(bt);
+    allocator_t allocator = bt->allocator;
+    const void* owner = &bt->allocator;
+
+    _bptree_clean_node(bt, bt->root, free_key, free_value);
+    allocator_free(&allocator, bt, sizeof(bptree_t));
+    if (!allocator_is_bulk(&allocator)) {
+        ALLOCTRACK_CLEANED(owner);
+    }
+}
+
+/*
+ * Function: bptree_memory_usage
+ * --------------------
+ *  Gets the memory bt uses, from its counts rather than by walking it.
+ *  Inner nodes are buckets, leaves are nodes and unused leaf entries are
+ *  slack. Keys and values are not counted.
+ *
+ *  bt: Pointer to the tree.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t bptree_memory_usage(bptree_t* bt, memory_usage_t* usage) {
+    assert(bt);
+    assert(usage);
+    memset(usage, 0, sizeof(memory_usage_t));
+
+    allocator_account(&bt->allocator, sizeof(bptree_t), 1, &usage->header,
+                usage);
+    allocator_account(&bt->allocator, sizeof(bptree_node_t), bt->n_inner,
+                &usage->buckets, usage);
+    allocator_account(&bt->allocator, sizeof(bptree_node_t), bt->n_leaves,
+                &usage->nodes, usage);
+
+    // Only live entries of the leaves count as nodes
+    size_t unused = (bt->n_leaves * BPTREE_ORDER - bt->n_values) *
+                (sizeof(uintptr_t) + sizeof(void*));
+    usage->nodes -= unused;
+    usage->slack += unused;
+    return usage->total;
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _bptree_new_node
+ * --------------------
+ *  Allocates an empty node.
+ *
+ *  returns: Pointer to the node.
+ */
+bptree_node_t* _bptree_new_node(bptree_t* bt, bool leaf) {
+    bptree_node_t* node = allocator_alloc(&bt->allocator,
+                sizeof(bptree_node_t));
+    assert(node);
+
+    node->n_keys = 0;
+    node->leaf = leaf;
+    node->slots[BPTREE_ORDER] = NULL;
+    if (leaf) {
+        bt->n_leaves++;
+    } else {
+        bt->n_inner++;
+    }
+    return node;
+}
+
+/*
+ * Function: _bptree_free_node
+ * --------------------
+ *  Frees a node.
+ *
+ *  returns: Nothing.
+ */
+void _bptree_free_node(bptree_t* bt, bptree_node_t* node) {
+    if (node->leaf) {
+        bt->n_leaves--;
+    } else {
+        bt->n_inner--;
+    }
+    allocator_free(&bt->allocator, node, sizeof(bptree_node_t));
+}
+
+/*
+ * Function: _bptree_lower_bound
+ * --------------------
+ *  Gets the index of the first key in node not less than key.
+ *
+ *  returns: Index, n_keys if every key is less.
+ */
+size_t _bptree_lower_bound(bptree_t* bt, bptree_node_t* node,
+                uintptr_t key) {
+    if (!bt->compare) {
+        return _bptree_count_int(node, key, false);
+    }
+
+    size_t low = 0, high = node->n_keys;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (bt->compare((void*)node->keys[mid], (void*)key) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/*
+ * Function: _bptree_child_index
+ * --------------------
+ *  Gets the child of an inner node whose range holds key, the number of
+ *  separators not greater than it.
+ *
+ *  returns: Child index.
+ */
+size_t _bptree_child_index(bptree_t* bt, bptree_node_t* node,
+                uintptr_t key) {
+    if (!bt->compare) {
+        return _bptree_count_int(node, key, true);
+    }
+
+    size_t low = 0, high = node->n_keys;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (bt->compare((void*)node->keys[mid], (void*)key) <= 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/*
+ * Function: _bptree_find_leaf
+ * --------------------
+ *  Descends to the leaf whose range holds key, recording the path.
+ *
+ *  returns: Pointer to the leaf.
+ */
+bptree_node_t* _bptree_find_leaf(bptree_t* bt, uintptr_t key,
+                bptree_node_t** path, size_t* indices) {
+    bptree_node_t* node = bt->root;
+    size_t depth = 0;
+
+    while (!node->leaf) {
+        size_t index = _bptree_child_index(bt, node, key);
+        if (path) {
+            path[depth] = node;
+            indices[depth] = index;
+        }
+        node = node->slots[index];
+        depth++;
+    }
+    if (path) {
+        path[depth] = node;
+    }
+    return node;
+}
+
+/*
+ * Function: _bptree_compare
+ * --------------------
+ *  Orders two keys of the tree.
+ *
+ *  returns: Negative, zero or positive.
+ */
+int _bptree_compare(bptree_t* bt, uintptr_t a, uintptr_t b) {
+    if (!bt->compare) {
+        return (a > b) - (a < b);
+    }
+    return bt->compare((void*)a, (void*)b);
+}
+
+/*
+ * Function: _bptree_split_child
+ * --------------------
+ *  Splits the full child at index of a parent with room in half, inserting
+ *  the separator into the parent.
+ *
+ *  returns: Nothing.
+ */
+void _bptree_split_child(bptree_t* bt, bptree_node_t* parent, size_t index) {
+    bptree_node_t* left = parent->slots[index];
+    bptree_node_t* right = _bptree_new_node(bt, left->leaf);
+    size_t half = BPTREE_ORDER / 2;
+    uintptr_t separator;
+
+    assert(left->n_keys == BPTREE_ORDER);
+    assert(parent->n_keys < BPTREE_ORDER);
+
+    if (left->leaf) {
+        // The right half keeps its first key, which becomes the separator
+        right->n_keys = BPTREE_ORDER - half;
+        memcpy(right->keys, left->keys + half,
+                    right->n_keys * sizeof(uintptr_t));
+        memcpy(right->slots, left->slots + half,
+                    right->n_keys * sizeof(void*));
+        right->slots[BPTREE_ORDER] = left->slots[BPTREE_ORDER];
+        left->slots[BPTREE_ORDER] = right;
+        separator = right->keys[0];
+    } else {
+        // The middle key moves up, its right child leads the right half
+        right->n_keys = BPTREE_ORDER - half - 1;
+        memcpy(right->keys, left->keys + half + 1,
+                    right->n_keys * sizeof(uintptr_t));
+        memcpy(right->slots, left->slots + half + 1,
+                    (right->n_keys + 1) * sizeof(void*));
+        separator = left->keys[half];
+    }
+    left->n_keys = half;
+
+    _bptree_insert_entry(parent, index, separator, right);
+}
+
+/*
+ * Function: _bptree_insert_entry
+ * --------------------
+ *  Inserts a key and a slot at index of a node with room, the slot going
+ *  at index in leaves and after the key in inner nodes.
+ *
+ *  returns: Nothing.
+ */
+void _bptree_insert_entry(bptree_node_t* node, size_t index, uintptr_t key,
+                void* slot) {
+    size_t after = node->n_keys - index;
+    size_t slot_index = node->leaf ? index : index + 1;
+
+    assert(node->n_keys < BPTREE_ORDER);
+    memmove(node->keys + index + 1, node->keys + index,
+                after * sizeof(uintptr_t));
+    memmove(node->slots + slot_index + 1, node->slots + slot_index,
+                after * sizeof(void*));
+    node->keys[index] = key;
+    node->slots[slot_index] = slot;
+    node->n_keys++;
+}
+
+/*
+ * Function: _bptree_rebalance
+ * --------------------
+ *  Refills an underfull node from a sibling, or merges it with one and
+ *  removes the separator from the parent, in turn up the path.
+ *
+ *  returns: Nothing.
+ */
+void _bptree_rebalance(bptree_t* bt, bptree_node_t** path, size_t* indices,
+                size_t depth) {
+    while (depth > 0) {
+        bptree_node_t* node = path[depth];
+        bptree_node_t* parent = path[depth - 1];
+        size_t index = indices[depth - 1];
+
+        // Pair the node with its left sibling, or its right one if it is
+        // the first child, as left and right of separator s
+        size_t s = index ? index - 1 : index;
+        bptree_node_t* left = parent->slots[s];
+        bptree_node_t* right = parent->slots[s + 1];
+        size_t merged = left->n_keys + right->n_keys + !node->leaf;
+
+        if (merged <= BPTREE_ORDER) {
+            if (node->leaf) {
+                memcpy(left->keys + left->n_keys, right->keys,
+                            right->n_keys * sizeof(uintptr_t));
+                memcpy(left->slots + left->n_keys, right->slots,
+                            right->n_keys * sizeof(void*));
+                left->slots[BPTREE_ORDER] = right->slots[BPTREE_ORDER];
+            } else {
+                left->keys[left->n_keys] = parent->keys[s];
+                memcpy(left->keys + left->n_keys + 1, right->keys,
+                            right->n_keys * sizeof(uintptr_t));
+                memcpy(left->slots + left->n_keys + 1, right->slots,
+                            (right->n_keys + 1) * sizeof(void*));
+            }
+            left->n_keys = merged;
+            _bptree_free_node(bt, right);
+
+            size_t after = parent->n_keys - s - 1;
+            memmove(parent->keys + s, parent->keys + s + 1,
+                        after * sizeof(uintptr_t));
+            memmove(parent->slots + s + 1, parent->slots + s + 2,
+                        after * sizeof(void*));
+            parent->n_keys--;
+        } else if (node == right) {
+            // Take the last entry of the left sibling
+            memmove(right->keys + 1, right->keys,
+                        right->n_keys * sizeof(uintptr_t));
+            memmove(right->slots + 1, right->slots,
+                        (right->n_keys + !right->leaf) * sizeof(void*));
+            if (node->leaf) {
+                right->keys[0] = left->keys[left->n_keys - 1];
+                right->slots[0] = left->slots[left->n_keys - 1];
+                parent->keys[s] = right->keys[0];
+            } else {
+                right->keys[0] = parent->keys[s];
+                right->slots[0] = left->slots[left->n_keys];
+                parent->keys[s] = left->keys[left->n_keys - 1];
+            }
+            left->n_keys--;
+            right->n_keys++;
+            return;
+        } else {
+            // Take the first entry of the right sibling
+            if (node->leaf) {
+                left->keys[left->n_keys] = right->keys[0];
+                left->slots[left->n_keys] = right->slots[0];
+                parent->keys[s] = right->keys[1];
+            } else {
+                left->keys[left->n_keys] = parent->keys[s];
+                left->slots[left->n_keys + 1] = right->slots[0];
+                parent->keys[s] = right->keys[0];
+            }
+            memmove(right->keys, right->keys + 1,
+                        (right->n_keys - 1) * sizeof(uintptr_t));
+            memmove(right->slots, right->slots + 1,
+                        (right->n_keys - node->leaf) * sizeof(void*));
+            left->n_keys++;
+            right->n_keys--;
+            return;
+        }
+
+        if (depth == 1) {
+            // A root left with one child hands the tree to it
+            if (!parent->n_keys) {
+                bt->root = parent->slots[0];
+                _bptree_free_node(bt, parent);
+                bt->height--;
+            }
+            return;
+        }
+        if (parent->n_keys >= BPTREE_MIN_KEYS) {
+            return;
+        }
+        depth--;
+    }
+}
+
+/*
+ * Function: _bptree_replace_separator
+ * --------------------
+ *  Replaces a separator aliasing a removed pointer key with the smallest
+ *  key of the subtree to its right, so no node keeps the pointer.
+ *
+ *  returns: Nothing.
+ */
+void _bptree_replace_separator(bptree_t* bt, uintptr_t key) {
+    bptree_node_t* node = bt->root;
+
+    // Separators are distinct, so the key is at most one of them, the one
+    // left of the child the search for it descends into
+    while (!node->leaf) {
+        size_t index = _bptree_child_index(bt, node, key);
+        if (index && node->keys[index - 1] == key) {
+            bptree_node_t* low = node->slots[index];
+            while (!low->leaf) {
+                low = low->slots[0];
+            }
+            assert(low->n_keys);
+            node->keys[index - 1] = low->keys[0];
+            return;
+        }
+        node = node->slots[index];
+    }
+}
+
+/*
+ * Function: _bptree_clean_node
+ * --------------------
+ *  Frees a node and the subtree under it.
+ *
+ *  returns: Nothing.
+ */
+void _bptree_clean_node(bptree_t* bt, bptree_node_t* node,
+                free_bptree_t free_key, free_bptree_t free_value) {
+    if (node->leaf) {
+        // Separators alias leaf keys, so keys are freed here only
+        for (size_t i = 0; i < node->n_keys; i++) {
+            if (free_key) {
+                free_key((void*)node->keys[i]);
+            }
+            if (free_value) {
+                free_value(node->slots[i]);
+            }
+        }
+    } else {
+        for (size_t i = 0; i <= node->n_keys; i++) {
+            _bptree_clean_node(bt, node->slots[i], free_key, free_value);
+        }
+    }
+    _bptree_free_node(bt, node);
+}
+
+/*
+ * Function: _bptree_first_leaf
+ * --------------------
+ *  Gets the leftmost leaf.
+ *
+ *  returns: Pointer to the leaf.
+ */
+bptree_node_t* _bptree_first_leaf(bptree_t* bt) {
+    bptree_node_t* node = bt->root;
+    while (!node->leaf) {
+        node = node->slots[0];
+    }
+    return node;
+}
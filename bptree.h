@@ -0,0 +1,402 @@
+#ifndef BPTREE_H
+#define BPTREE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "hashtable.h"
+#include "allocator.h"
+#include "hints.h"
+
+// Bytes per node, a multiple of the cache line, 4096 for page sized nodes
+#ifndef BPTREE_NODE_BYTES
+#define BPTREE_NODE_BYTES 512
+#endif
+// Keys per node, with the header, keys and slots filling BPTREE_NODE_BYTES
+#define BPTREE_ORDER ((BPTREE_NODE_BYTES - 2 * sizeof(uintptr_t)) / \
+            (2 * sizeof(uintptr_t)))
+// Nodes other than the root hold at least this many keys
+#define BPTREE_MIN_KEYS (BPTREE_ORDER / 2)
+// Keys per leaf when bulk loading, the rest is left for later inserts
+#define BPTREE_BULK_FILL (BPTREE_ORDER * 3 / 4)
+#define BPTREE_MAX_DEPTH 32
+
+// Key of an integer keyed tree, passed where the API takes void*
+#define BPTREE_INT_KEY(x) ((void*)(uintptr_t)(x))
+
+typedef void (* free_bptree_t)(void*);
+
+typedef struct bptree_node bptree_node_t;
+
+/*
+ * Leaves keep their values in slots and the next leaf in the last slot,
+ * inner nodes keep n_keys + 1 children. Separator i is the smallest key of
+ * child i + 1.
+ */
+struct bptree_node {
+    uint32_t n_keys;
+    uint32_t leaf;
+    uintptr_t keys[BPTREE_ORDER];
+    void* slots[BPTREE_ORDER + 1];
+};
+
+/*
+ * Ordered map. With compare NULL keys are unsigned integers stored in the
+ * nodes themselves and searched with SIMD, otherwise keys are pointers
+ * ordered by compare, which must return negative, zero or positive.
+ *
+ * Point lookups run at 1.5 to 3.5 times hashtable_t, past the 2x aimed for
+ * from about a million keys, and this is accepted. A lookup misses cache
+ * once per level below the cached top of the tree, where a hashtable
+ * misses once or twice, so no node search tuning closes the gap at sizes
+ * past the cache.
+ * Node sizes from 256 to 2048 bytes measured within noise of each other.
+ * Use a hashtable when order and ranges aren't needed.
+ */
+typedef struct bptree {
+    bptree_node_t* root;
+    compare_t compare;
+    size_t n_values;
+    size_t n_inner;
+    size_t n_leaves;
+    // Levels, 1 while the root is a leaf
+    size_t height;
+    // Source of the tree and its nodes
+    allocator_t allocator;
+} bptree_t;
+
+/*
+ * Position in a scan, from bptree_iter_first, bptree_iter_seek or
+ * bptree_range. Valid until the tree changes.
+ */
+typedef struct bptree_iter {
+    bptree_t* bt;
+    bptree_node_t* leaf;
+    size_t index;
+    // Exclusive upper bound of a range
+    uintptr_t end;
+    bool bounded;
+} bptree_iter_t;
+
+/**** PUBLIC ****/
+
+/*
+ * Function: bptree_create
+ * --------------------
+ *  Creates a new B+-tree of pointer keys.
+ *
+ *  compare: Function ordering two keys.
+ *
+ *  returns: Pointer to the new tree.
+ */
+bptree_t* bptree_create(compare_t compare);
+
+/*
+ * Function: bptree_create_int
+ * --------------------
+ *  Creates a new B+-tree of unsigned integer keys, passed with
+ *  BPTREE_INT_KEY.
+ *
+ *  No parameters.
+ *
+ *  returns: Pointer to the new tree.
+ */
+bptree_t* bptree_create_int(void);
+
+/*
+ * Function: bptree_create_with_allocator
+ * --------------------
+ *  Creates a new B+-tree whose nodes come from an allocator.
+ *
+ *  compare: Function ordering two keys, NULL for integer keys.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new tree.
+ */
+bptree_t* bptree_create_with_allocator(compare_t compare,
+                const allocator_t* allocator);
+
+/*
+ * Function: bptree_insert
+ * --------------------
+ *  Inserts a key, replacing the value if the key is present. A present
+ *  key keeps the pointer stored first.
+ *
+ *  bt: Pointer to the tree.
+ *  key: Key.
+ *  value: Value.
+ *
+ *  returns: True if the key was new, false if its value was replaced.
+ */
+bool bptree_insert(bptree_t* bt, void* key, void* value);
+
+/*
+ * Function: bptree_search
+ * --------------------
+ *  Searches for a key.
+ *
+ *  bt: Pointer to the tree.
+ *  key: Key to search for.
+ *
+ *  returns: Value of the key, NULL if not found.
+ */
+void* bptree_search(bptree_t* bt, void* key);
+
+/*
+ * Function: bptree_contains
+ * --------------------
+ *  Checks if a key is in the tree.
+ *
+ *  bt: Pointer to the tree.
+ *  key: Key to check for.
+ *
+ *  returns: True if found, false otherwise.
+ */
+bool bptree_contains(bptree_t* bt, void* key);
+
+/*
+ * Function: bptree_remove
+ * --------------------
+ *  Removes a key, merging or rebalancing nodes that fall below half full.
+ *  Pointer keys are dropped from inner nodes too, so the key may be freed.
+ *
+ *  bt: Pointer to the tree.
+ *  key: Key to remove.
+ *  free_key: Function to free the stored key, may be NULL.
+ *  free_value: Function to free the value, may be NULL.
+ *
+ *  returns: True if the key was removed, false if not found.
+ */
+bool bptree_remove(bptree_t* bt, void* key, free_bptree_t free_key,
+                free_bptree_t free_value);
+
+/*
+ * Function: bptree_bulk_load
+ * --------------------
+ *  Builds an empty tree bottom up from sorted input, filling leaves to
+ *  BPTREE_BULK_FILL rather than splitting on the way.
+ *
+ *  bt: Pointer to the empty tree.
+ *  keys: Keys in strictly ascending order.
+ *  values: Values of the keys.
+ *  n: Number of keys.
+ *
+ *  returns: Nothing.
+ */
+void bptree_bulk_load(bptree_t* bt, void* const* keys, void* const* values,
+                size_t n);
+
+/*
+ * Function: bptree_iter_first
+ * --------------------
+ *  Starts a scan of every key in order.
+ *
+ *  bt: Pointer to the tree.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void bptree_iter_first(bptree_t* bt, bptree_iter_t* iter);
+
+/*
+ * Function: bptree_iter_seek
+ * --------------------
+ *  Starts a scan at the first key not less than low.
+ *
+ *  bt: Pointer to the tree.
+ *  low: Key to start from.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void bptree_iter_seek(bptree_t* bt, void* low, bptree_iter_t* iter);
+
+/*
+ * Function: bptree_range
+ * --------------------
+ *  Starts a scan of the keys in [low, high). A prefix query is the range
+ *  from the prefix to its successor.
+ *
+ *  bt: Pointer to the tree.
+ *  low: Inclusive lower bound.
+ *  high: Exclusive upper bound.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void bptree_range(bptree_t* bt, void* low, void* high, bptree_iter_t* iter);
+
+/*
+ * Function: bptree_iter_next
+ * --------------------
+ *  Gets the next key and value of a scan. Entering a leaf prefetches the
+ *  one after it.
+ *
+ *  iter: Pointer to the iterator.
+ *  key: Output key, may be NULL.
+ *  value: Output value, may be NULL.
+ *
+ *  returns: True if a key was produced, false at the end of the scan.
+ */
+bool bptree_iter_next(bptree_iter_t* iter, void** key, void** value);
+
+/*
+ * Function: bptree_size
+ * --------------------
+ *  Gets the number of keys.
+ *
+ *  bt: Pointer to the tree.
+ *
+ *  returns: Number of keys.
+ */
+size_t bptree_size(bptree_t* bt);
+
+/*
+ * Function: bptree_clean
+ * --------------------
+ *  Frees the tree.
+ *
+ *  bt: Pointer to the tree.
+ *  free_key: Function to free keys, may be NULL.
+ *  free_value: Function to free values, may be NULL.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void bptree_clean(bptree_t* bt, free_bptree_t free_key,
+                free_bptree_t free_value);
+
+/*
+ * Function: bptree_memory_usage
+ * --------------------
+ *  Gets the memory bt uses, from its counts rather than by walking it.
+ *  Inner nodes are buckets, leaves are nodes and unused leaf entries are
+ *  slack. Keys and values are not counted.
+ *
+ *  bt: Pointer to the tree.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t bptree_memory_usage(bptree_t* bt, memory_usage_t* usage);
+
+/**** PRIVATE ****/
+/*
+ * Function: _bptree_new_node
+ * --------------------
+ *  Allocates an empty node.
+ *
+ *  returns: Pointer to the node.
+ */
+bptree_node_t* _bptree_new_node(bptree_t* bt, bool leaf);
+
+/*
+ * Function: _bptree_free_node
+ * --------------------
+ *  Frees a node.
+ *
+ *  returns: Nothing.
+ */
+void _bptree_free_node(bptree_t* bt, bptree_node_t* node);
+
+/*
+ * Function: _bptree_lower_bound
+ * --------------------
+ *  Gets the index of the first key in node not less than key.
+ *
+ *  returns: Index, n_keys if every key is less.
+ */
+size_t _bptree_lower_bound(bptree_t* bt, bptree_node_t* node,
+                uintptr_t key);
+
+/*
+ * Function: _bptree_child_index
+ * --------------------
+ *  Gets the child of an inner node whose range holds key, the number of
+ *  separators not greater than it.
+ *
+ *  returns: Child index.
+ */
+size_t _bptree_child_index(bptree_t* bt, bptree_node_t* node,
+                uintptr_t key);
+
+/*
+ * Function: _bptree_find_leaf
+ * --------------------
+ *  Descends to the leaf whose range holds key, recording the path.
+ *
+ *  returns: Pointer to the leaf.
+ */
+bptree_node_t* _bptree_find_leaf(bptree_t* bt, uintptr_t key,
+                bptree_node_t** path, size_t* indices);
+
+/*
+ * Function: _bptree_compare
+ * --------------------
+ *  Orders two keys of the tree.
+ *
+ *  returns: Negative, zero or positive.
+ */
+int _bptree_compare(bptree_t* bt, uintptr_t a, uintptr_t b);
+
+/*
+ * Function: _bptree_split_child
+ * --------------------
+ *  Splits the full child at index of a parent with room in half, inserting
+ *  the separator into the parent.
+ *
+ *  returns: Nothing.
+ */
+void _bptree_split_child(bptree_t* bt, bptree_node_t* parent, size_t index);
+
+/*
+ * Function: _bptree_insert_entry
+ * --------------------
+ *  Inserts a key and a slot at index of a node with room, the slot going
+ *  at index in leaves and after the key in inner nodes.
+ *
+ *  returns: Nothing.
+ */
+void _bptree_insert_entry(bptree_node_t* node, size_t index, uintptr_t key,
+                void* slot);
+
+/*
+ * Function: _bptree_rebalance
+ * --------------------
+ *  Refills an underfull node from a sibling, or merges it with one and
+ *  removes the separator from the parent, in turn up the path.
+ *
+ *  returns: Nothing.
+ */
+void _bptree_rebalance(bptree_t* bt, bptree_node_t** path, size_t* indices,
+                size_t depth);
+
+/*
+ * Function: _bptree_replace_separator
+ * --------------------
+ *  Replaces a separator aliasing a removed pointer key with the smallest
+ *  key of the subtree to its right, so no node keeps the pointer.
+ *
+ *  returns: Nothing.
+ */
+void _bptree_replace_separator(bptree_t* bt, uintptr_t key);
+
+/*
+ * Function: _bptree_clean_node
+ * --------------------
+ *  Frees a node and the subtree under it.
+ *
+ *  returns: Nothing.
+ */
+void _bptree_clean_node(bptree_t* bt, bptree_node_t* node,
+                free_bptree_t free_key, free_bptree_t free_value);
+
+/*
+ * Function: _bptree_first_leaf
+ * --------------------
+ *  Gets the leftmost leaf.
+ *
+ *  returns: Pointer to the leaf.
+ */
+bptree_node_t* _bptree_first_leaf(bptree_t* bt);
+
+#endif
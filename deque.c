@@ -0,0 +1,441 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a custom by value double ended queue library.
+         Elements are copied into fixed size blocks found through a map, so
+         both ends grow without moving any element and indexing stays O(1).
+*/
+
+#include "deque.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "alloctrack.h"
+
+/*
+ * Gets the map entries of the first and one past the last block holding
+ * elements, for a non-empty deque.
+ */
+static inline size_t _deque_first_block(const deque_t* dq) {
+    return dq->start >> dq->block_shift;
+}
+
+static inline size_t _deque_end_block(const deque_t* dq) {
+    return ((dq->start + dq->n_elements - 1) >> dq->block_shift) + 1;
+}
+
+/**** PUBLIC ****/
+
+/*
+ * Function: deque_create
+ * --------------------
+ *  Creates a new deque. Blocks are allocated on the first push.
+ *
+ *  elem_size: Size of each element, sizeof(void*) for the DLL style
+ *             functions.
+ *
+ *  returns: Pointer to the new deque.
+ */
+deque_t* deque_create(size_t elem_size) {
+    return deque_create_with_allocator(elem_size, NULL);
+}
+
+/*
+ * Function: deque_create_with_allocator
+ * --------------------
+ *  Creates a new deque whose memory comes from an allocator.
+ *
+ *  elem_size: Size of each element.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new deque.
+ */
+deque_t* deque_create_with_allocator(size_t elem_size,
+                const allocator_t* allocator) {
+    assert(elem_size);
+    allocator_t alloc = allocator_resolve(allocator);
+
+    deque_t* dq = allocator_alloc(&alloc, sizeof(deque_t));
+    assert(dq);
+
+    // Largest power of two elements fitting DEQUE_BLOCK_BYTES
+    size_t shift = 0;
+    while ((elem_size << (shift + 1)) <= DEQUE_BLOCK_BYTES) {
+        shift++;
+    }
+    while (((size_t)1 << shift) < DEQUE_MIN_BLOCK) {
+        shift++;
+    }
+
+    dq->elem_size = elem_size;
+    dq->block_shift = shift;
+    dq->block_elems = (size_t)1 << shift;
+    dq->n_elements = 0;
+    dq->n_spares = 0;
+    dq->allocator = alloc;
+    dq->map_capacity = DEQUE_INITIAL_MAP;
+    dq->map = allocator_alloc(&alloc, sizeof(char*) * dq->map_capacity);
+    assert(dq->map);
+    memset(dq->map, 0, sizeof(char*) * dq->map_capacity);
+    _deque_recentre(dq);
+
+    return dq;
+}
+
+/*
+ * Function: deque_push_back
+ * --------------------
+ *  Copies an element to the back of the deque.
+ *
+ *  dq: Pointer to the deque.
+ *  elem: Pointer to the element, elem_size bytes are copied.
+ *
+ *  returns: Pointer to the stored element, valid until it is popped.
+ */
+void* deque_push_back(deque_t* dq, const void* elem) {
+    assert(elem);
+    void* slot = deque_push_back_slot(dq);
+    memcpy(slot, elem, dq->elem_size);
+    return slot;
+}
+
+/*
+ * Function: deque_push_front
+ * --------------------
+ *  Copies an element to the front of the deque.
+ *
+ *  dq: Pointer to the deque.
+ *  elem: Pointer to the element, elem_size bytes are copied.
+ *
+ *  returns: Pointer to the stored element, valid until it is popped.
+ */
+void* deque_push_front(deque_t* dq, const void* elem) {
+    assert(elem);
+    void* slot = deque_push_front_slot(dq);
+    memcpy(slot, elem, dq->elem_size);
+    return slot;
+}
+
+/*
+ * Function: deque_push_back_slot
+ * --------------------
+ *  Adds an uninitialised element to the back of the deque, for the caller
+ *  to fill in place.
+ *
+ *  dq: Pointer to the deque.
+ *
+ *  returns: Pointer to the new element, valid until it is popped.
+ */
+void* deque_push_back_slot(deque_t* dq) {
+    assert(dq);
+    size_t pos = dq->start + dq->n_elements;
+
+    // An empty deque starts on a block boundary, so this covers the first
+    // push too
+    if (!(pos & (dq->block_elems - 1))) {
+        if (DSL_UNLIKELY((pos >> dq->block_shift) == dq->map_capacity)) {
+            _deque_make_room(dq, false);
+            pos = dq->start + dq->n_elements;
+        }
+        dq->map[pos >> dq->block_shift] = _deque_new_block(dq);
+    }
+
+    dq->n_elements++;
+    return dq->map[pos >> dq->block_shift] +
+                (pos & (dq->block_elems - 1)) * dq->elem_size;
+}
+
+/*
+ * Function: deque_push_front_slot
+ * --------------------
+ *  Adds an uninitialised element to the front of the deque, for the caller
+ *  to fill in place.
+ *
+ *  dq: Pointer to the deque.
+ *
+ *  returns: Pointer to the new element, valid until it is popped.
+ */
+void* deque_push_front_slot(deque_t* dq) {
+    assert(dq);
+
+    if (!(dq->start & (dq->block_elems - 1))) {
+        if (DSL_UNLIKELY(!(dq->start >> dq->block_shift))) {
+            _deque_make_room(dq, true);
+        }
+        dq->map[(dq->start >> dq->block_shift) - 1] = _deque_new_block(dq);
+    }
+
+    dq->start--;
+    dq->n_elements++;
+    return dq->map[dq->start >> dq->block_shift] +
+                (dq->start & (dq->block_elems - 1)) * dq->elem_size;
+}
+
+/*
+ * Function: deque_pop_front
+ * --------------------
+ *  Removes the front element of the deque.
+ *
+ *  dq: Pointer to the deque.
+ *  out: Where to copy the element, may be NULL.
+ *
+ *  returns: True if an element was removed, false if the deque is empty.
+ */
+bool deque_pop_front(deque_t* dq, void* out) {
+    assert(dq);
+    if (!dq->n_elements) {
+        return false;
+    }
+
+    if (out) {
+        memcpy(out, deque_get(dq, 0), dq->elem_size);
+    }
+
+    size_t block = dq->start >> dq->block_shift;
+    dq->start++;
+    dq->n_elements--;
+    if (!dq->n_elements) {
+        _deque_release_block(dq, block);
+        _deque_recentre(dq);
+    } else if (!(dq->start & (dq->block_elems - 1))) {
+        _deque_release_block(dq, block);
+    }
+
+    return true;
+}
+
+/*
+ * Function: deque_pop_back
+ * --------------------
+ *  Removes the back element of the deque.
+ *
+ *  dq: Pointer to the deque.
+ *  out: Where to copy the element, may be NULL.
+ *
+ *  returns: True if an element was removed, false if the deque is empty.
+ */
+bool deque_pop_back(deque_t* dq, void* out) {
+    assert(dq);
+    if (!dq->n_elements) {
+        return false;
+    }
+
+    if (out) {
+        memcpy(out, deque_get(dq, dq->n_elements - 1), dq->elem_size);
+    }
+
+    size_t pos = dq->start + dq->n_elements - 1;
+    dq->n_elements--;
+    if (!dq->n_elements) {
+        _deque_release_block(dq, pos >> dq->block_shift);
+        _deque_recentre(dq);
+    } else if (!(pos & (dq->block_elems - 1))) {
+        _deque_release_block(dq, pos >> dq->block_shift);
+    }
+
+    return true;
+}
+
+/*
+ * Function: deque_clear
+ * --------------------
+ *  Removes every element, keeping up to DEQUE_SPARE_BLOCKS blocks and the
+ *  map for reuse.
+ *
+ *  dq: Pointer to the deque.
+ *
+ *  returns: Nothing.
+ */
+void deque_clear(deque_t* dq) {
+    assert(dq);
+    if (!dq->n_elements) {
+        return;
+    }
+
+    size_t end = _deque_end_block(dq);
+    for (size_t b = _deque_first_block(dq); b < end; b++) {
+        _deque_release_block(dq, b);
+    }
+    dq->n_elements = 0;
+    _deque_recentre(dq);
+}
+
+/*
+ * Function: deque_trim
+ * --------------------
+ *  Frees the spare blocks kept for reuse.
+ *
+ *  dq: Pointer to the deque.
+ *
+ *  returns: Nothing.
+ */
+void deque_trim(deque_t* dq) {
+    assert(dq);
+    size_t block_size = dq->elem_size * dq->block_elems;
+    while (dq->n_spares) {
+        allocator_free(&dq->allocator, dq->spares[--dq->n_spares],
+                    block_size);
+    }
+}
+
+/*
+ * Function: deque_clean
+ * --------------------
+ *  Frees the deque and its elements.
+ *
+ *  dq: Pointer to the deque.
+ *  free_data: For a deque of pointers, function to free what each element
+ *             points to, may be NULL.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void deque_clean(deque_t* dq, free_deque_t free_data) {
+    assert(dq);
+    allocator_t allocator = dq->allocator;
+    const void* owner = &dq->allocator;
+
+    if (free_data) {
+        assert(dq->elem_size == sizeof(void*));
+        for (size_t i = 0; i < dq->n_elements; i++) {
+            free_data(*(void**)deque_get(dq, i));
+        }
+    }
+
+    // Bulk allocators free everything on reset
+    if (!allocator_is_bulk(&allocator)) {
+        deque_clear(dq);
+        deque_trim(dq);
+        allocator_free(&allocator, dq->map, sizeof(char*) * dq->map_capacity);
+        allocator_free(&allocator, dq, sizeof(deque_t));
+        ALLOCTRACK_CLEANED(owner);
+    }
+}
+
+/*
+ * Function: deque_memory_usage
+ * --------------------
+ *  Gets the memory dq uses. The map is buckets, blocks holding elements
+ *  are nodes, their unused slots and spare blocks are slack.
+ *
+ *  dq: Pointer to the deque.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t deque_memory_usage(deque_t* dq, memory_usage_t* usage) {
+    assert(dq);
+    assert(usage);
+    memset(usage, 0, sizeof(memory_usage_t));
+
+    size_t block_size = dq->elem_size * dq->block_elems;
+    size_t n_blocks = dq->n_elements ?
+                _deque_end_block(dq) - _deque_first_block(dq) : 0;
+
+    allocator_account(&dq->allocator, sizeof(deque_t), 1, &usage->header,
+                usage);
+    allocator_account(&dq->allocator, sizeof(char*) * dq->map_capacity, 1,
+                &usage->buckets, usage);
+    allocator_account(&dq->allocator, block_size, n_blocks, &usage->nodes,
+                usage);
+    allocator_account(&dq->allocator, block_size, dq->n_spares,
+                &usage->slack, usage);
+
+    // Only live elements count as nodes
+    size_t unused = block_size * n_blocks - dq->elem_size * dq->n_elements;
+    usage->nodes -= unused;
+    usage->slack += unused;
+
+    return usage->total;
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _deque_new_block
+ * --------------------
+ *  Gets a block, a spare one if there is one.
+ *
+ *  returns: Pointer to the block.
+ */
+char* _deque_new_block(deque_t* dq) {
+    if (dq->n_spares) {
+        return dq->spares[--dq->n_spares];
+    }
+    char* block = allocator_alloc(&dq->allocator,
+                dq->elem_size * dq->block_elems);
+    assert(block);
+    return block;
+}
+
+/*
+ * Function: _deque_release_block
+ * --------------------
+ *  Takes a block out of the map, keeping it as a spare or freeing it.
+ *
+ *  returns: Nothing.
+ */
+void _deque_release_block(deque_t* dq, size_t block) {
+    assert(dq->map[block]);
+    if (dq->n_spares < DEQUE_SPARE_BLOCKS) {
+        dq->spares[dq->n_spares++] = dq->map[block];
+    } else {
+        allocator_free(&dq->allocator, dq->map[block],
+                    dq->elem_size * dq->block_elems);
+    }
+    dq->map[block] = NULL;
+}
+
+/*
+ * Function: _deque_make_room
+ * --------------------
+ *  Makes a free map entry at the front or back of the blocks in use, by
+ *  recentring them in the map or doubling it.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void _deque_make_room(deque_t* dq, bool front) {
+    assert(dq->n_elements);
+    size_t first = _deque_first_block(dq);
+    size_t used = _deque_end_block(dq) - first;
+    size_t need = used + 1;
+
+    // Recentring only pays off when it leaves as much room again, otherwise
+    // a deque pushed at one end would shuffle its map every few blocks
+    size_t new_capacity = dq->map_capacity;
+    while (need * 2 > new_capacity) {
+        new_capacity *= 2;
+    }
+    size_t new_first = (new_capacity - need) / 2 + (front ? 1 : 0);
+
+    if (new_capacity == dq->map_capacity) {
+        memmove(dq->map + new_first, dq->map + first, sizeof(char*) * used);
+        memset(dq->map, 0, sizeof(char*) * new_first);
+        memset(dq->map + new_first + used, 0,
+                    sizeof(char*) * (new_capacity - new_first - used));
+    } else {
+        char** map = allocator_alloc(&dq->allocator,
+                    sizeof(char*) * new_capacity);
+        assert(map);
+        memset(map, 0, sizeof(char*) * new_capacity);
+        memcpy(map + new_first, dq->map + first, sizeof(char*) * used);
+        allocator_free(&dq->allocator, dq->map,
+                    sizeof(char*) * dq->map_capacity);
+        dq->map = map;
+        dq->map_capacity = new_capacity;
+    }
+
+    dq->start = (new_first << dq->block_shift) +
+                (dq->start & (dq->block_elems - 1));
+}
+
+/*
+ * Function: _deque_recentre
+ * --------------------
+ *  Moves the position of an empty deque to the middle of its map, so it
+ *  can grow either way.
+ *
+ *  returns: Nothing.
+ */
+void _deque_recentre(deque_t* dq) {
+    assert(!dq->n_elements);
+    dq->start = (dq->map_capacity / 2) << dq->block_shift;
+}
@@ -0,0 +1,409 @@
+#ifndef DEQUE_H
+#define DEQUE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include "allocator.h"
+#include "hints.h"
+
+// Target size of a block, rounded down to a power of two elements
+#define DEQUE_BLOCK_BYTES 1024
+// Fewest elements in a block, for large elements
+#define DEQUE_MIN_BLOCK 8
+#define DEQUE_INITIAL_MAP 8
+// Emptied blocks kept for reuse, so a queue at a steady size cycling
+// through its blocks stops allocating
+#define DEQUE_SPARE_BLOCKS 2
+
+typedef void (* free_deque_t)(void*);
+
+/*
+ * Double ended queue storing elements by value in fixed size blocks, after
+ * std::deque. A map of block pointers grows at either end, so pushes and
+ * pops at both ends are O(1), indexing is a shift and a mask, and elements
+ * never move while they are in the deque.
+ */
+typedef struct deque {
+    size_t elem_size;
+    // Elements per block, a power of two
+    size_t block_elems;
+    size_t block_shift;
+    // Position of the front element counted from the start of map[0]
+    size_t start;
+    size_t n_elements;
+    // Blocks in use, NULL outside the range holding elements
+    char** map;
+    size_t map_capacity;
+    char* spares[DEQUE_SPARE_BLOCKS];
+    size_t n_spares;
+    // Source of the deque, its map and blocks
+    allocator_t allocator;
+} deque_t;
+
+/**** PUBLIC ****/
+
+/*
+ * Function: deque_create
+ * --------------------
+ *  Creates a new deque. Blocks are allocated on the first push.
+ *
+ *  elem_size: Size of each element, sizeof(void*) for the DLL style
+ *             functions.
+ *
+ *  returns: Pointer to the new deque.
+ */
+deque_t* deque_create(size_t elem_size);
+
+/*
+ * Function: deque_create_with_allocator
+ * --------------------
+ *  Creates a new deque whose memory comes from an allocator.
+ *
+ *  elem_size: Size of each element.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new deque.
+ */
+deque_t* deque_create_with_allocator(size_t elem_size,
+                const allocator_t* allocator);
+
+/*
+ * Function: deque_push_back
+ * --------------------
+ *  Copies an element to the back of the deque.
+ *
+ *  dq: Pointer to the deque.
+ *  elem: Pointer to the element, elem_size bytes are copied.
+ *
+ *  returns: Pointer to the stored element, valid until it is popped.
+ */
+void* deque_push_back(deque_t* dq, const void* elem);
+
+/*
+ * Function: deque_push_front
+ * --------------------
+ *  Copies an element to the front of the deque.
+ *
+ *  dq: Pointer to the deque.
+ *  elem: Pointer to the element, elem_size bytes are copied.
+ *
+ *  returns: Pointer to the stored element, valid until it is popped.
+ */
+void* deque_push_front(deque_t* dq, const void* elem);
+
+/*
+ * Function: deque_push_back_slot
+ * --------------------
+ *  Adds an uninitialised element to the back of the deque, for the caller
+ *  to fill in place.
+ *
+ *  dq: Pointer to the deque.
+ *
+ *  returns: Pointer to the new element, valid until it is popped.
+ */
+void* deque_push_back_slot(deque_t* dq);
+
+/*
+ * Function: deque_push_front_slot
+ * --------------------
+ *  Adds an uninitialised element to the front of the deque, for the caller
+ *  to fill in place.
+ *
+ *  dq: Pointer to the deque.
+ *
+ *  returns: Pointer to the new element, valid until it is popped.
+ */
+void* deque_push_front_slot(deque_t* dq);
+
+/*
+ * Function: deque_pop_front
+ * --------------------
+ *  Removes the front element of the deque.
+ *
+ *  dq: Pointer to the deque.
+ *  out: Where to copy the element, may be NULL.
+ *
+ *  returns: True if an element was removed, false if the deque is empty.
+ */
+bool deque_pop_front(deque_t* dq, void* out);
+
+/*
+ * Function: deque_pop_back
+ * --------------------
+ *  Removes the back element of the deque.
+ *
+ *  dq: Pointer to the deque.
+ *  out: Where to copy the element, may be NULL.
+ *
+ *  returns: True if an element was removed, false if the deque is empty.
+ */
+bool deque_pop_back(deque_t* dq, void* out);
+
+/*
+ * Function: deque_clear
+ * --------------------
+ *  Removes every element, keeping up to DEQUE_SPARE_BLOCKS blocks and the
+ *  map for reuse.
+ *
+ *  dq: Pointer to the deque.
+ *
+ *  returns: Nothing.
+ */
+void deque_clear(deque_t* dq);
+
+/*
+ * Function: deque_trim
+ * --------------------
+ *  Frees the spare blocks kept for reuse.
+ *
+ *  dq: Pointer to the deque.
+ *
+ *  returns: Nothing.
+ */
+void deque_trim(deque_t* dq);
+
+/*
+ * Function: deque_clean
+ * --------------------
+ *  Frees the deque and its elements.
+ *
+ *  dq: Pointer to the deque.
+ *  free_data: For a deque of pointers, function to free what each element
+ *             points to, may be NULL.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void deque_clean(deque_t* dq, free_deque_t free_data);
+
+/*
+ * Function: deque_memory_usage
+ * --------------------
+ *  Gets the memory dq uses. The map is buckets, blocks holding elements
+ *  are nodes, their unused slots and spare blocks are slack.
+ *
+ *  dq: Pointer to the deque.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t deque_memory_usage(deque_t* dq, memory_usage_t* usage);
+
+/* ELEMENT ACCESS */
+/* Kept inline as they sit on the inner loop of callers indexing the deque */
+
+/*
+ * Function: deque_get
+ * --------------------
+ *  Gets an element in place by its index from the front.
+ *
+ *  dq: Pointer to the deque.
+ *  index: Index of the element, below deque_size.
+ *
+ *  returns: Pointer to the element.
+ */
+DSL_INLINE void* deque_get(deque_t* dq, size_t index) {
+    assert(index < dq->n_elements);
+    size_t pos = dq->start + index;
+    return dq->map[pos >> dq->block_shift] +
+                (pos & (dq->block_elems - 1)) * dq->elem_size;
+}
+
+/*
+ * Function: deque_front
+ * --------------------
+ *  Gets the front element in place.
+ *
+ *  dq: Pointer to the deque.
+ *
+ *  returns: Pointer to the element, NULL if the deque is empty.
+ */
+DSL_INLINE void* deque_front(deque_t* dq) {
+    return dq->n_elements ? deque_get(dq, 0) : NULL;
+}
+
+/*
+ * Function: deque_back
+ * --------------------
+ *  Gets the back element in place.
+ *
+ *  dq: Pointer to the deque.
+ *
+ *  returns: Pointer to the element, NULL if the deque is empty.
+ */
+DSL_INLINE void* deque_back(deque_t* dq) {
+    return dq->n_elements ? deque_get(dq, dq->n_elements - 1) : NULL;
+}
+
+/*
+ * Function: deque_size
+ * --------------------
+ *  Gets the number of elements.
+ *
+ *  dq: Pointer to the deque.
+ *
+ *  returns: Number of elements.
+ */
+DSL_INLINE size_t deque_size(deque_t* dq) {
+    return dq->n_elements;
+}
+
+/*
+ * Function: deque_is_empty
+ * --------------------
+ *  Checks if the deque is empty.
+ *
+ *  dq: Pointer to the deque.
+ *
+ *  returns: True if deque is empty, false otherwise.
+ */
+DSL_INLINE bool deque_is_empty(deque_t* dq) {
+    return !dq->n_elements;
+}
+
+/* DLL STYLE */
+/* For deques of pointers, named and behaving as their DLL_t counterparts */
+
+/*
+ * Function: deque_insert_head
+ * --------------------
+ *  Inserts a pointer at the front, as DLL_insert_head.
+ *
+ *  dq: Pointer to a deque of pointers.
+ *  data: Value to be inserted.
+ *
+ *  returns: Nothing.
+ */
+DSL_INLINE void deque_insert_head(deque_t* dq, void* data) {
+    assert(dq->elem_size == sizeof(void*));
+    *(void**)deque_push_front_slot(dq) = data;
+}
+
+/*
+ * Function: deque_insert_tail
+ * --------------------
+ *  Inserts a pointer at the back, as DLL_insert_tail.
+ *
+ *  dq: Pointer to a deque of pointers.
+ *  data: Value to be inserted.
+ *
+ *  returns: Nothing.
+ */
+DSL_INLINE void deque_insert_tail(deque_t* dq, void* data) {
+    assert(dq->elem_size == sizeof(void*));
+    *(void**)deque_push_back_slot(dq) = data;
+}
+
+/*
+ * Function: deque_pop
+ * --------------------
+ *  Removes the front pointer, as DLL_pop.
+ *
+ *  dq: Pointer to a deque of pointers.
+ *
+ *  returns: The removed pointer, NULL if the deque is empty.
+ */
+DSL_INLINE void* deque_pop(deque_t* dq) {
+    assert(dq->elem_size == sizeof(void*));
+    void* data = NULL;
+    deque_pop_front(dq, &data);
+    return data;
+}
+
+/*
+ * Function: deque_dequeue
+ * --------------------
+ *  Removes the back pointer, as DLL_dequeue.
+ *
+ *  dq: Pointer to a deque of pointers.
+ *
+ *  returns: The removed pointer, NULL if the deque is empty.
+ */
+DSL_INLINE void* deque_dequeue(deque_t* dq) {
+    assert(dq->elem_size == sizeof(void*));
+    void* data = NULL;
+    deque_pop_back(dq, &data);
+    return data;
+}
+
+/*
+ * Macro: DEQUE_DEFINE
+ * --------------------
+ *  Defines typed wrappers name_create, name_push_back, name_push_front,
+ *  name_pop_front, name_pop_back and name_get over deque_t, copying by
+ *  assignment rather than memcpy.
+ */
+#define DEQUE_DEFINE(name, type) \
+    static inline deque_t* name##_create(void) { \
+        return deque_create(sizeof(type)); \
+    } \
+    static inline type* name##_push_back(deque_t* dq, type elem) { \
+        type* slot = deque_push_back_slot(dq); \
+        *slot = elem; \
+        return slot; \
+    } \
+    static inline type* name##_push_front(deque_t* dq, type elem) { \
+        type* slot = deque_push_front_slot(dq); \
+        *slot = elem; \
+        return slot; \
+    } \
+    static inline bool name##_pop_front(deque_t* dq, type* out) { \
+        type* front = deque_front(dq); \
+        if (!front) { \
+            return false; \
+        } \
+        *out = *front; \
+        return deque_pop_front(dq, NULL); \
+    } \
+    static inline bool name##_pop_back(deque_t* dq, type* out) { \
+        type* back = deque_back(dq); \
+        if (!back) { \
+            return false; \
+        } \
+        *out = *back; \
+        return deque_pop_back(dq, NULL); \
+    } \
+    static inline type* name##_get(deque_t* dq, size_t index) { \
+        return deque_get(dq, index); \
+    }
+
+/**** PRIVATE ****/
+/*
+ * Function: _deque_new_block
+ * --------------------
+ *  Gets a block, a spare one if there is one.
+ *
+ *  returns: Pointer to the block.
+ */
+char* _deque_new_block(deque_t* dq);
+
+/*
+ * Function: _deque_release_block
+ * --------------------
+ *  Takes a block out of the map, keeping it as a spare or freeing it.
+ *
+ *  returns: Nothing.
+ */
+void _deque_release_block(deque_t* dq, size_t block);
+
+/*
+ * Function: _deque_make_room
+ * --------------------
+ *  Makes a free map entry at the front or back of the blocks in use, by
+ *  recentring them in the map or doubling it.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void _deque_make_room(deque_t* dq, bool front);
+
+/*
+ * Function: _deque_recentre
+ * --------------------
+ *  Moves the position of an empty deque to the middle of its map, so it
+ *  can grow either way.
+ *
+ *  returns: Nothing.
+ */
+void _deque_recentre(deque_t* dq);
+
+#endif
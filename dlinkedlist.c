@@ -8,8 +8,13 @@ Purpose: This file is a custom doubly linked list library. It also contains
 */
 
 #include "dlinkedlist.h"
+#include "pool.h"
+#include "metrics.h"
+#include "probes.h"
+#include "alloctrack.h"
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <assert.h>
 #include "hashtable.h"
 
@@ -25,11 +30,76 @@ Purpose: This file is a custom doubly linked list library. It also contains
  *  returns: Pointer to the new doubly linked list.
  */
 DLL_t* DLL_create(void) {
-    DLL_t* dll = malloc(sizeof(DLL_t));
+    return DLL_create_with_allocator(NULL);
+}
+
+/*
+ * Function: DLL_create_with_allocator
+ * --------------------
+ *  Creates a new doubly linked list whose memory comes from an allocator.
+ * 
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ * 
+ *  returns: Pointer to the new doubly linked list.
+ */
+DLL_t* DLL_create_with_allocator(const allocator_t* allocator) {
+    allocator_t alloc = allocator_resolve(allocator);
+
+    DLL_t* dll = allocator_alloc(&alloc, sizeof(DLL_t));
     assert(dll);
 
     dll->head = NULL;
     dll->tail = NULL;
+    dll->n_elements = 0;
+    dll->allocator = alloc;
+    dll->block = NULL;
+
+    return dll;
+}
+
+/*
+ * Function: DLL_create_arena
+ * --------------------
+ *  Creates a new doubly linked list whose nodes are allocated from an 
+ *  arena. Nodes are never freed individually.
+ * 
+ *  arena: Arena to allocate nodes from, must outlive the list.
+ * 
+ *  returns: Pointer to the new doubly linked list.
+ */
+DLL_t* DLL_create_arena(arena_t* arena) {
+    assert(arena);
+    allocator_t allocator = allocator_arena(arena);
+
+    return DLL_create_with_allocator(&allocator);
+}
+
+/*
+ * Function: DLL_create_fixed
+ * --------------------
+ *  Creates a fixed capacity doubly linked list backed by a single 
+ *  allocation. It never allocates afterwards, use the DLL_try_insert 
+ *  functions to get a full error rather than an assert.
+ * 
+ *  capacity: Maximum number of nodes.
+ * 
+ *  returns: Pointer to the new doubly linked list.
+ */
+DLL_t* DLL_create_fixed(size_t capacity) {
+    // List and node pool in one block
+    char* block = malloc(sizeof(DLL_t) + 
+                pool_bytes(sizeof(DLL_node_t), capacity));
+    assert(block);
+    ALLOCTRACK_NOTE(sizeof(DLL_t) + pool_bytes(sizeof(DLL_node_t), capacity));
+    DLL_t* dll = (DLL_t*)block;
+    pool_t* pool = pool_init(block + sizeof(DLL_t), sizeof(DLL_node_t), 
+                capacity);
+
+    dll->head = NULL;
+    dll->tail = NULL;
+    dll->n_elements = 0;
+    dll->allocator = pool_allocator(pool);
+    dll->block = block;
 
     return dll;
 }
@@ -45,11 +115,32 @@ DLL_t* DLL_create(void) {
  *  returns: Nothing.
  */
 void DLL_insert_head(DLL_t* dll, void* data) {
+    bool inserted = DLL_try_insert_head(dll, data);
+    assert(inserted);
+    (void)inserted;
+}
+
+/*
+ * Function: DLL_try_insert_head
+ * --------------------
+ *  Inserts a new node at the head of the list.
+ * 
+ *  dll: Pointer to the doubly linked list.
+ *  data: Value to be inserted.
+ * 
+ *  returns: False if the node could not be allocated, as when a fixed 
+ *           capacity list is full, true otherwise.
+ */
+bool DLL_try_insert_head(DLL_t* dll, void* data) {
     assert(dll);
 
     // Create new node
-    DLL_node_t* node = malloc(sizeof(DLL_node_t));
-    assert(node);
+    DLL_node_t* node = allocator_alloc(&dll->allocator, sizeof(DLL_node_t));
+    if (!node) {
+        return false;
+    }
+    METRICS_COUNT(METRICS_DLL, METRICS_INSERTS);
+    METRICS_ALLOC(METRICS_DLL, sizeof(DLL_node_t));
     node->data = data;
     node->next = dll->head;
     node->prev = NULL;
@@ -64,6 +155,9 @@ void DLL_insert_head(DLL_t* dll, void* data) {
     }
 
     dll->head = node;
+    dll->n_elements++;
+
+    return true;
 }
 
 /*
@@ -77,11 +171,32 @@ void DLL_insert_head(DLL_t* dll, void* data) {
  *  returns: Nothing.
  */
 void DLL_insert_tail(DLL_t* dll, void* data) {
+    bool inserted = DLL_try_insert_tail(dll, data);
+    assert(inserted);
+    (void)inserted;
+}
+
+/*
+ * Function: DLL_try_insert_tail
+ * --------------------
+ *  Inserts a new node at the tail of the list.
+ * 
+ *  dll: Pointer to the doubly linked list.
+ *  data: Value to be inserted.
+ * 
+ *  returns: False if the node could not be allocated, as when a fixed 
+ *           capacity list is full, true otherwise.
+ */
+bool DLL_try_insert_tail(DLL_t* dll, void* data) {
     assert(dll);
 
     // Create new node
-    DLL_node_t* node = malloc(sizeof(DLL_node_t));
-    assert(node);
+    DLL_node_t* node = allocator_alloc(&dll->allocator, sizeof(DLL_node_t));
+    if (!node) {
+        return false;
+    }
+    METRICS_COUNT(METRICS_DLL, METRICS_INSERTS);
+    METRICS_ALLOC(METRICS_DLL, sizeof(DLL_node_t));
     node->data = data;
     node->next = NULL;
     node->prev = dll->tail;
@@ -96,6 +211,9 @@ void DLL_insert_tail(DLL_t* dll, void* data) {
     }
 
     dll->tail = node;
+    dll->n_elements++;
+
+    return true;
 }
 
 /*
@@ -128,7 +246,10 @@ void* DLL_pop(DLL_t* dll) {
     }
 
     void* data = node->data;
-    free(node);
+    allocator_free(&dll->allocator, node, sizeof(DLL_node_t));
+    dll->n_elements--;
+    METRICS_COUNT(METRICS_DLL, METRICS_REMOVES);
+    METRICS_FREE(METRICS_DLL, sizeof(DLL_node_t));
 
     return data;
 }
@@ -163,7 +284,10 @@ void* DLL_dequeue(DLL_t* dll) {
     }
 
     void* data = node->data;
-    free(node);
+    allocator_free(&dll->allocator, node, sizeof(DLL_node_t));
+    dll->n_elements--;
+    METRICS_COUNT(METRICS_DLL, METRICS_REMOVES);
+    METRICS_FREE(METRICS_DLL, sizeof(DLL_node_t));
 
     return data;
 }
@@ -178,18 +302,29 @@ void* DLL_dequeue(DLL_t* dll) {
  * 
  *  returns: Nothing.
  */
-void DLL_clean(DLL_t* dll, free_dll_t free_data) {
+DSL_COLD void DLL_clean(DLL_t* dll, free_dll_t free_data) {
     assert(dll);
+    const void* owner = &dll->allocator;
 
-    // Remove all nodes
-    while (dll->head) {
+    // Remove all nodes, bulk allocators free them on reset and fixed 
+    // capacity nodes go with the block
+    bool owns_nodes = !allocator_is_bulk(&dll->allocator) && !dll->block;
+    while (dll->head && (owns_nodes || free_data)) {
         void* data = DLL_pop(dll);
         if (free_data) {
             free_data(data);
         }
     }
 
-    free(dll);
+    if (dll->block) {
+        free(dll->block);
+        return;
+    }
+
+    allocator_free(&dll->allocator, dll, sizeof(DLL_t));
+    if (owns_nodes) {
+        ALLOCTRACK_CLEANED(owner);
+    }
 }
 
 /* HASHTABLE  DLL */
@@ -204,19 +339,37 @@ void DLL_clean(DLL_t* dll, free_dll_t free_data) {
  *  returns: Pointer to the new doubly linked list hashtable.
  */
 DLL_HT_t* DLL_HT_create(compare_t cmp, hash_t hash) {
+    return DLL_HT_create_with_allocator(cmp, hash, NULL);
+}
+
+/*
+ * Function: DLL_HT_create_with_allocator
+ * --------------------
+ *  Creates a new doubly linked list with a hashtable embedded, whose memory
+ *  comes from an allocator.
+ * 
+ *  cmp: Function pointer to the function that compares two data values.
+ *  hash: Function pointer to the function that hashes a data value.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ * 
+ *  returns: Pointer to the new doubly linked list hashtable.
+ */
+DLL_HT_t* DLL_HT_create_with_allocator(compare_t cmp, hash_t hash, 
+                const allocator_t* allocator) {
     assert(cmp);
     assert(hash);
+    allocator_t alloc = allocator_resolve(allocator);
 
     DLL_HT_t* dll_ht = NULL;
     DLL_t* dll = NULL;
     hashtable_t* ht = NULL;
 
-    dll_ht = malloc(sizeof(DLL_HT_t));
+    dll_ht = allocator_alloc(&alloc, sizeof(DLL_HT_t));
     assert(dll_ht);
 
-    dll = DLL_create();
+    dll = DLL_create_with_allocator(&alloc);
 
-    ht = ht_create(INITIAL_TABLE_SIZE, cmp, hash);
+    ht = ht_create_with_allocator(INITIAL_TABLE_SIZE, cmp, hash, &alloc);
 
     // Assign to combined data structure
     dll_ht->list = dll;
@@ -271,6 +424,7 @@ void DLL_HT_remove(DLL_HT_t* dll_ht, void* key, free_dll_ht_t free_data) {
     DLL_node_t* node = NULL;
 
     node = ht_search(dll_ht->ht, key);
+    DSL_PROBE3(dll_ht_remove, dll_ht, key, node->data);
 
     // Disconnect prev
     if (node->prev) {
@@ -286,6 +440,8 @@ void DLL_HT_remove(DLL_HT_t* dll_ht, void* key, free_dll_ht_t free_data) {
         dll_ht->list->tail = node->prev;
     }
 
+    dll_ht->list->n_elements--;
+
     // Remove from hashtable
     ht_remove(dll_ht->ht, key, NULL, NULL);
 
@@ -294,7 +450,9 @@ void DLL_HT_remove(DLL_HT_t* dll_ht, void* key, free_dll_ht_t free_data) {
         free_data(node->data);
     }
 
-    free(node);
+    allocator_free(&dll_ht->list->allocator, node, sizeof(DLL_node_t));
+    METRICS_COUNT(METRICS_DLL, METRICS_REMOVES);
+    METRICS_FREE(METRICS_DLL, sizeof(DLL_node_t));
 }
 
 /*
@@ -308,32 +466,75 @@ void DLL_HT_remove(DLL_HT_t* dll_ht, void* key, free_dll_ht_t free_data) {
  * 
  *  returns: Nothing.
  */
-void DLL_HT_clean(DLL_HT_t* dll_ht, free_dll_ht_t free_key, 
+DSL_COLD void DLL_HT_clean(DLL_HT_t* dll_ht, free_dll_ht_t free_key, 
                 free_dll_ht_t free_data) {
     assert(dll_ht);
+    allocator_t allocator = dll_ht->list->allocator;
 
     DLL_clean(dll_ht->list, free_data);
     ht_clean(dll_ht->ht, free_key, NULL);
-    free(dll_ht);
+    allocator_free(&allocator, dll_ht, sizeof(DLL_HT_t));
 }
 
 
 /* UTILS */
 /*
- * Function: DLL_is_empty
+ * Function: DLL_memory_usage
  * --------------------
- *  Checks if the doubly linked list is empty.
+ *  Gets the memory dll uses, from its counts rather than by walking it.
+ *  Data is not counted.
  * 
- *  dll_ht: Pointer to the doubly linked list hashtable.
+ *  dll: Pointer to the doubly linked list.
+ *  usage: Output breakdown.
  * 
- *  returns: True if the list is empty, false otherwise.
+ *  returns: Total bytes.
  */
-bool DLL_is_empty(DLL_t* dll) {
+size_t DLL_memory_usage(DLL_t* dll, memory_usage_t* usage) {
     assert(dll);
-
-    if (!dll->head && !dll->tail) {
-        return true;
+    assert(usage);
+    memset(usage, 0, sizeof(memory_usage_t));
+
+    // Fixed capacity doubly linked lists are one block holding the node pool
+    if (dll->block) {
+        pool_t* pool = dll->allocator.ctx;
+        usage->header = sizeof(DLL_t);
+        usage->nodes = sizeof(DLL_node_t) * dll->n_elements;
+        allocator_account_block(sizeof(DLL_t) +
+                    pool_bytes(sizeof(DLL_node_t), pool->n_slots), usage);
+        return usage->total;
     }
 
-    return false;
+    allocator_account(&dll->allocator, sizeof(DLL_t), 1, &usage->header,
+                usage);
+    allocator_account(&dll->allocator, sizeof(DLL_node_t), dll->n_elements,
+                &usage->nodes, usage);
+
+    return usage->total;
+}
+
+/*
+ * Function: DLL_HT_memory_usage
+ * --------------------
+ *  Gets the memory dll_ht uses, its list and embedded hashtable included.
+ *  Keys and data are not counted.
+ * 
+ *  dll_ht: Pointer to the doubly linked list hashtable.
+ *  usage: Output breakdown.
+ * 
+ *  returns: Total bytes.
+ */
+size_t DLL_HT_memory_usage(DLL_HT_t* dll_ht, memory_usage_t* usage) {
+    assert(dll_ht);
+    assert(usage);
+    memory_usage_t part;
+    memset(usage, 0, sizeof(memory_usage_t));
+
+    allocator_account(&dll_ht->list->allocator, sizeof(DLL_HT_t), 1,
+                &usage->header, usage);
+    DLL_memory_usage(dll_ht->list, &part);
+    allocator_account_usage(&part, usage);
+    ht_memory_usage(dll_ht->ht, &part);
+    allocator_account_usage(&part, usage);
+
+    return usage->total;
 }
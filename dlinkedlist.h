@@ -1,7 +1,10 @@
 #ifndef DLINKEDLIST_H
 #define DLINKEDLIST_H
 
+#include <assert.h>
 #include "hashtable.h"
+#include "allocator.h"
+#include "hints.h"
 
 typedef void (* free_dll_t)(void*);
 typedef void (* free_dll_ht_t)(void*);
@@ -17,6 +20,11 @@ struct DLL_node {
 typedef struct DLL {
 	DLL_node_t *head;
 	DLL_node_t *tail;
+    size_t n_elements;
+    // Source of the list and its nodes
+    allocator_t allocator;
+    // Single allocation of a fixed capacity list, NULL otherwise
+    void* block;
 } DLL_t;
 
 typedef struct DLL_HT {
@@ -35,6 +43,42 @@ typedef struct DLL_HT {
  */
 DLL_t* DLL_create(void);
 
+/*
+ * Function: DLL_create_with_allocator
+ * --------------------
+ *  Creates a new doubly linked list whose memory comes from an allocator.
+ * 
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ * 
+ *  returns: Pointer to the new doubly linked list.
+ */
+DLL_t* DLL_create_with_allocator(const allocator_t* allocator);
+
+/*
+ * Function: DLL_create_arena
+ * --------------------
+ *  Creates a new doubly linked list whose nodes are allocated from an 
+ *  arena. Nodes are never freed individually.
+ * 
+ *  arena: Arena to allocate nodes from, must outlive the list.
+ * 
+ *  returns: Pointer to the new doubly linked list.
+ */
+DLL_t* DLL_create_arena(arena_t* arena);
+
+/*
+ * Function: DLL_create_fixed
+ * --------------------
+ *  Creates a fixed capacity doubly linked list backed by a single 
+ *  allocation. It never allocates afterwards, use the DLL_try_insert 
+ *  functions to get a full error rather than an assert.
+ * 
+ *  capacity: Maximum number of nodes.
+ * 
+ *  returns: Pointer to the new doubly linked list.
+ */
+DLL_t* DLL_create_fixed(size_t capacity);
+
 /*
  * Function: DLL_insert_head
  * --------------------
@@ -59,6 +103,32 @@ void DLL_insert_head(DLL_t* dll, void* data);
  */
 void DLL_insert_tail(DLL_t* dll, void* data);
 
+/*
+ * Function: DLL_try_insert_head
+ * --------------------
+ *  Inserts a new node at the head of the list.
+ * 
+ *  dll: Pointer to the doubly linked list.
+ *  data: Value to be inserted.
+ * 
+ *  returns: False if the node could not be allocated, as when a fixed 
+ *           capacity list is full, true otherwise.
+ */
+bool DLL_try_insert_head(DLL_t* dll, void* data);
+
+/*
+ * Function: DLL_try_insert_tail
+ * --------------------
+ *  Inserts a new node at the tail of the list.
+ * 
+ *  dll: Pointer to the doubly linked list.
+ *  data: Value to be inserted.
+ * 
+ *  returns: False if the node could not be allocated, as when a fixed 
+ *           capacity list is full, true otherwise.
+ */
+bool DLL_try_insert_tail(DLL_t* dll, void* data);
+
 /*
  * Function: DLL_pop
  * --------------------
@@ -91,7 +161,7 @@ void* DLL_dequeue(DLL_t* dll);
  * 
  *  returns: Nothing.
  */
-void DLL_clean(DLL_t* dll, free_dll_t free_data);
+DSL_COLD void DLL_clean(DLL_t* dll, free_dll_t free_data);
 
 /* HASHTABLE  DLL */
 /*
@@ -106,6 +176,21 @@ void DLL_clean(DLL_t* dll, free_dll_t free_data);
  */
 DLL_HT_t* DLL_HT_create(compare_t cmp, hash_t hash);
 
+/*
+ * Function: DLL_HT_create_with_allocator
+ * --------------------
+ *  Creates a new doubly linked list with a hashtable embedded, whose memory
+ *  comes from an allocator.
+ * 
+ *  cmp: Function pointer to the function that compares two data values.
+ *  hash: Function pointer to the function that hashes a data value.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ * 
+ *  returns: Pointer to the new doubly linked list hashtable.
+ */
+DLL_HT_t* DLL_HT_create_with_allocator(compare_t cmp, hash_t hash, 
+                const allocator_t* allocator);
+
 /*
  * Function: DLL_HT_insert
  * --------------------
@@ -142,7 +227,7 @@ void DLL_HT_remove(DLL_HT_t* dll_ht, void* key, free_dll_ht_t free_data);
  * 
  *  returns: Nothing.
  */
-void DLL_HT_clean(DLL_HT_t* dll_ht, free_dll_ht_t free_key, 
+DSL_COLD void DLL_HT_clean(DLL_HT_t* dll_ht, free_dll_ht_t free_key, 
                 free_dll_ht_t free_data);
 
 /* UTILS */
@@ -155,6 +240,40 @@ void DLL_HT_clean(DLL_HT_t* dll_ht, free_dll_ht_t free_key,
  * 
  *  returns: True if the list is empty, false otherwise.
  */
-bool DLL_is_empty(DLL_t* dll);
+DSL_INLINE bool DLL_is_empty(DLL_t* dll) {
+    assert(dll);
+
+    if (!dll->head && !dll->tail) {
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * Function: DLL_memory_usage
+ * --------------------
+ *  Gets the memory dll uses, from its counts rather than by walking it.
+ *  Data is not counted.
+ * 
+ *  dll: Pointer to the doubly linked list.
+ *  usage: Output breakdown.
+ * 
+ *  returns: Total bytes.
+ */
+size_t DLL_memory_usage(DLL_t* dll, memory_usage_t* usage);
+
+/*
+ * Function: DLL_HT_memory_usage
+ * --------------------
+ *  Gets the memory dll_ht uses, its list and embedded hashtable included.
+ *  Keys and data are not counted.
+ * 
+ *  dll_ht: Pointer to the doubly linked list hashtable.
+ *  usage: Output breakdown.
+ * 
+ *  returns: Total bytes.
+ */
+size_t DLL_HT_memory_usage(DLL_HT_t* dll_ht, memory_usage_t* usage);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,48 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is the unity build of the library. Compiling it in place
+         of the separate .c files puts the library in one translation unit,
+         so calls between modules, as a queue into its allocator or a RAG
+         into its hashtable, can be inlined without LTO. dsl.h includes it
+         when DSL_IMPLEMENTATION is defined, for header-only use.
+
+Build  : cc -O2 -c dsl.c -o dsl.o, then link with -lm -lpthread
+*/
+
+#ifndef DSL_C
+#define DSL_C
+
+#if !defined(_POSIX_C_SOURCE) && !defined(_GNU_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "allocator.c"
+#include "arena.c"
+#include "slab.c"
+#include "pool.c"
+#include "alloctrack.c"
+#include "metrics.c"
+#include "hashtable.c"
+#include "dlinkedlist.c"
+#include "queue.c"
+#include "stack.c"
+#include "vqueue.c"
+#include "vstack.c"
+#include "vdlinkedlist.c"
+#include "deque.c"
+#include "vector.c"
+#include "bptree.c"
+#include "art.c"
+#include "epoch.c"
+#include "skiplist.c"
+#include "bitset.c"
+#include "roaring.c"
+#include "unionfind.c"
+#include "RAG.c"
+#include "waitchain.c"
+#include "traversal.c"
+#include "lockdep.c"
+#include "workload.c"
+#include "hashcheck.c"
+
+#endif
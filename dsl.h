@@ -0,0 +1,57 @@
+#ifndef DSL_H
+#define DSL_H
+
+/*
+ * Every public header of the library. Defining DSL_IMPLEMENTATION before
+ * including it in exactly one translation unit also compiles the whole
+ * library into that unit, header-only style, so the compiler sees library
+ * and caller code together and can inline hot paths across both without
+ * LTO. Other units include it without the define. In that unit dsl.h must
+ * come before any system header, since the library needs POSIX 2008.
+ *
+ *   #define DSL_IMPLEMENTATION
+ *   #include "dsl.h"
+ *
+ * Library file scope statics are then visible in the including unit.
+ */
+
+#if defined(DSL_IMPLEMENTATION) && !defined(_POSIX_C_SOURCE) && \
+            !defined(_GNU_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "hints.h"
+#include "allocator.h"
+#include "arena.h"
+#include "slab.h"
+#include "pool.h"
+#include "hashtable.h"
+#include "dlinkedlist.h"
+#include "queue.h"
+#include "stack.h"
+#include "vqueue.h"
+#include "vstack.h"
+#include "vdlinkedlist.h"
+#include "deque.h"
+#include "vector.h"
+#include "bptree.h"
+#include "art.h"
+#include "epoch.h"
+#include "skiplist.h"
+#include "bitset.h"
+#include "roaring.h"
+#include "unionfind.h"
+#include "RAG.h"
+#include "waitchain.h"
+#include "traversal.h"
+#include "lockdep.h"
+#include "workload.h"
+#include "metrics.h"
+#include "alloctrack.h"
+#include "hashcheck.h"
+
+#ifdef DSL_IMPLEMENTATION
+#include "dsl.c"
+#endif
+
+#endif
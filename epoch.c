@@ -0,0 +1,299 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is epoch based memory reclamation for the lock free
+         containers. Threads wrap every access to shared nodes in a critical
+         section that publishes the global epoch it saw. Unlinked nodes are
+         retired into a per thread limbo list for the current epoch instead
+         of being freed. The epoch only advances once every thread inside a
+         critical section has seen it, so a limbo list EPOCH_GRACE epochs
+         old can no longer be read by anyone and is freed.
+*/
+
+#include "epoch.h"
+#include <assert.h>
+
+static uint64_t global_epoch = 0;
+static epoch_record_t* records = NULL;
+static pthread_key_t record_key;
+static pthread_once_t record_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local epoch_record_t* record = NULL;
+
+/**** PUBLIC ****/
+
+/*
+ * Function: epoch_enter
+ * --------------------
+ *  Enters a critical section, objects reachable from shared structures
+ *  stay allocated until it is left. Sections nest.
+ *
+ *  No parameters.
+ *
+ *  returns: Nothing.
+ */
+void epoch_enter(void) {
+    epoch_record_t* rec = _epoch_record();
+
+    if (rec->nesting++) {
+        return;
+    }
+
+    uint64_t epoch = __atomic_load_n(&global_epoch, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&rec->state, (epoch << 1) | 1, __ATOMIC_SEQ_CST);
+    // The announcement must be visible before any shared pointer is read
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/*
+ * Function: epoch_exit
+ * --------------------
+ *  Leaves a critical section.
+ *
+ *  No parameters.
+ *
+ *  returns: Nothing.
+ */
+void epoch_exit(void) {
+    epoch_record_t* rec = record;
+    assert(rec && rec->nesting);
+
+    if (--rec->nesting) {
+        return;
+    }
+
+    __atomic_store_n(&rec->state, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Function: epoch_retire
+ * --------------------
+ *  Frees an object from an allocator once no critical section that may
+ *  still see it is open. Sections opened from now on must not be able to
+ *  reach it, except through links that sections already open remove
+ *  before they close.
+ *
+ *  allocator: Allocator the object came from, must be thread safe.
+ *  ptr: Pointer to the object.
+ *  size: Size it was allocated with.
+ *
+ *  returns: Nothing.
+ */
+void epoch_retire(const allocator_t* allocator, void* ptr, size_t size) {
+    assert(allocator);
+
+    // Bulk memory goes back when its allocator is reset
+    if (allocator_is_bulk(allocator)) {
+        return;
+    }
+
+    epoch_entry_t entry = {ptr, size, allocator->free, allocator->ctx, NULL};
+    _epoch_retire_entry(&entry);
+}
+
+/*
+ * Function: epoch_retire_fn
+ * --------------------
+ *  Frees a caller's object with a function once no critical section that
+ *  may still see it is open.
+ *
+ *  free_fn: Function to free the object.
+ *  ptr: Pointer to the object.
+ *
+ *  returns: Nothing.
+ */
+void epoch_retire_fn(free_epoch_t free_fn, void* ptr) {
+    assert(free_fn);
+
+    epoch_entry_t entry = {ptr, 0, NULL, NULL, free_fn};
+    _epoch_retire_entry(&entry);
+}
+
+/*
+ * Function: epoch_reclaim
+ * --------------------
+ *  Tries to advance the epoch and frees what the calling thread retired
+ *  that is now safe. Retiring calls it every EPOCH_RECLAIM_THRESHOLD
+ *  objects.
+ *
+ *  No parameters.
+ *
+ *  returns: True if the epoch advanced, false if a thread held it back.
+ */
+bool epoch_reclaim(void) {
+    epoch_record_t* rec = _epoch_record();
+    uint64_t epoch = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+    bool advanced = true;
+
+    epoch_record_t* other = __atomic_load_n(&records, __ATOMIC_ACQUIRE);
+    for (; other; other = other->next) {
+        uint64_t state = __atomic_load_n(&other->state, __ATOMIC_SEQ_CST);
+        if ((state & 1) && (state >> 1) != epoch) {
+            advanced = false;
+            break;
+        }
+    }
+
+    if (advanced) {
+        // Losing the race means another thread advanced it, just as good
+        __atomic_compare_exchange_n(&global_epoch, &epoch, epoch + 1, false,
+                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    }
+
+    epoch = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+    for (size_t i = 0; i < EPOCH_N_LIMBO; i++) {
+        if (rec->limbo[i].epoch + EPOCH_GRACE <= epoch) {
+            _epoch_free_limbo(&rec->limbo[i]);
+        }
+    }
+    rec->n_retired = 0;
+
+    return advanced;
+}
+
+/*
+ * Function: epoch_drain
+ * --------------------
+ *  Frees everything retired by every thread, at shutdown or between
+ *  phases. No thread may be in a critical section or retiring.
+ *
+ *  No parameters.
+ *
+ *  returns: Number of objects freed.
+ */
+size_t epoch_drain(void) {
+    size_t n_freed = 0;
+
+    epoch_record_t* rec = __atomic_load_n(&records, __ATOMIC_ACQUIRE);
+    for (; rec; rec = rec->next) {
+        assert(!(__atomic_load_n(&rec->state, __ATOMIC_ACQUIRE) & 1));
+        for (size_t i = 0; i < EPOCH_N_LIMBO; i++) {
+            n_freed += _epoch_free_limbo(&rec->limbo[i]);
+        }
+        rec->n_retired = 0;
+    }
+
+    return n_freed;
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _epoch_record
+ * --------------------
+ *  Gets the calling thread's record, registering the thread first.
+ *
+ *  returns: Pointer to the record.
+ */
+epoch_record_t* _epoch_record(void) {
+    if (record) {
+        return record;
+    }
+
+    // Adopt a record released by an exited thread before growing the list
+    epoch_record_t* rec = __atomic_load_n(&records, __ATOMIC_ACQUIRE);
+    for (; rec; rec = rec->next) {
+        bool in_use = false;
+        if (!__atomic_load_n(&rec->in_use, __ATOMIC_RELAXED) &&
+                    __atomic_compare_exchange_n(&rec->in_use, &in_use, true,
+                    false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+
+    if (!rec) {
+        rec = calloc(1, sizeof(epoch_record_t));
+        assert(rec);
+        rec->in_use = true;
+        rec->next = __atomic_load_n(&records, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&records, &rec->next, rec, true,
+                    __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+
+    record = rec;
+    pthread_once(&record_key_once, _epoch_key_create);
+    pthread_setspecific(record_key, rec);
+
+    return rec;
+}
+
+/*
+ * Function: _epoch_retire_entry
+ * --------------------
+ *  Adds an entry to the calling thread's limbo list for the current epoch.
+ *
+ *  returns: Nothing.
+ */
+void _epoch_retire_entry(const epoch_entry_t* entry) {
+    epoch_record_t* rec = _epoch_record();
+    uint64_t epoch = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+    epoch_limbo_t* limbo = &rec->limbo[epoch % EPOCH_N_LIMBO];
+
+    // A list left from an older epoch sharing the slot is already safe
+    if (limbo->epoch != epoch) {
+        _epoch_free_limbo(limbo);
+        limbo->epoch = epoch;
+    }
+
+    if (limbo->n_entries == limbo->capacity) {
+        limbo->capacity = limbo->capacity ? limbo->capacity * 2 :
+                    EPOCH_INITIAL_LIMBO;
+        limbo->entries = realloc(limbo->entries,
+                    sizeof(epoch_entry_t) * limbo->capacity);
+        assert(limbo->entries);
+    }
+    limbo->entries[limbo->n_entries++] = *entry;
+
+    if (++rec->n_retired >= EPOCH_RECLAIM_THRESHOLD) {
+        epoch_reclaim();
+    }
+}
+
+/*
+ * Function: _epoch_free_limbo
+ * --------------------
+ *  Frees every entry of a limbo list.
+ *
+ *  returns: Number of entries freed.
+ */
+size_t _epoch_free_limbo(epoch_limbo_t* limbo) {
+    for (size_t i = 0; i < limbo->n_entries; i++) {
+        epoch_entry_t* entry = &limbo->entries[i];
+        if (entry->free_fn) {
+            entry->free_fn(entry->ptr);
+        } else {
+            allocator_t allocator = {NULL, entry->dealloc, NULL, entry->ctx};
+            allocator_free(&allocator, entry->ptr, entry->size);
+        }
+    }
+
+    size_t n_freed = limbo->n_entries;
+    limbo->n_entries = 0;
+
+    return n_freed;
+}
+
+/*
+ * Function: _epoch_key_create
+ * --------------------
+ *  Creates the thread key whose destructor releases thread records.
+ *
+ *  returns: Nothing.
+ */
+void _epoch_key_create(void) {
+    pthread_key_create(&record_key, _epoch_release);
+}
+
+/*
+ * Function: _epoch_release
+ * --------------------
+ *  Thread exit destructor, hands a record to the next thread to register.
+ *
+ *  returns: Nothing.
+ */
+void _epoch_release(void* _record) {
+    epoch_record_t* rec = _record;
+
+    rec->nesting = 0;
+    __atomic_store_n(&rec->state, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&rec->in_use, false, __ATOMIC_RELEASE);
+    record = NULL;
+}
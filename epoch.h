@@ -0,0 +1,187 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "allocator.h"
+
+// Objects a thread retires between attempts to advance the epoch
+#define EPOCH_RECLAIM_THRESHOLD 64
+// Epochs an object waits after the one it was retired in. Two suffice for
+// objects unreachable when retired, the third lets an object stay linked
+// until sections already open at retire time have unlinked it
+#define EPOCH_GRACE 3
+// Limbo lists per thread, one per epoch still waiting
+#define EPOCH_N_LIMBO (EPOCH_GRACE + 1)
+#define EPOCH_INITIAL_LIMBO 64
+
+typedef void (* free_epoch_t)(void*);
+
+/*
+ * Object waiting for every thread that could still see it to leave its
+ * critical section. Allocator memory is freed with dealloc and ctx, caller
+ * memory with free_fn.
+ */
+typedef struct epoch_entry {
+    void* ptr;
+    size_t size;
+    dealloc_t dealloc;
+    void* ctx;
+    free_epoch_t free_fn;
+} epoch_entry_t;
+
+typedef struct epoch_limbo {
+    epoch_entry_t* entries;
+    size_t n_entries;
+    size_t capacity;
+    // Epoch the entries were retired in
+    uint64_t epoch;
+} epoch_limbo_t;
+
+typedef struct epoch_record epoch_record_t;
+
+/*
+ * Per thread state, in a list that only grows. A record is released when
+ * its thread exits and adopted, limbo and all, by the next thread to
+ * register.
+ */
+struct epoch_record {
+    epoch_record_t* next;
+    // Epoch observed on entry shifted left by one, low bit set while in a
+    // critical section
+    uint64_t state;
+    bool in_use;
+    // Owner only from here on
+    size_t nesting;
+    size_t n_retired;
+    epoch_limbo_t limbo[EPOCH_N_LIMBO];
+};
+
+/**** PUBLIC ****/
+
+/*
+ * Function: epoch_enter
+ * --------------------
+ *  Enters a critical section, objects reachable from shared structures
+ *  stay allocated until it is left. Sections nest.
+ *
+ *  No parameters.
+ *
+ *  returns: Nothing.
+ */
+void epoch_enter(void);
+
+/*
+ * Function: epoch_exit
+ * --------------------
+ *  Leaves a critical section.
+ *
+ *  No parameters.
+ *
+ *  returns: Nothing.
+ */
+void epoch_exit(void);
+
+/*
+ * Function: epoch_retire
+ * --------------------
+ *  Frees an object from an allocator once no critical section that may
+ *  still see it is open. Sections opened from now on must not be able to
+ *  reach it, except through links that sections already open remove
+ *  before they close.
+ *
+ *  allocator: Allocator the object came from, must be thread safe.
+ *  ptr: Pointer to the object.
+ *  size: Size it was allocated with.
+ *
+ *  returns: Nothing.
+ */
+void epoch_retire(const allocator_t* allocator, void* ptr, size_t size);
+
+/*
+ * Function: epoch_retire_fn
+ * --------------------
+ *  Frees a caller's object with a function once no critical section that
+ *  may still see it is open.
+ *
+ *  free_fn: Function to free the object.
+ *  ptr: Pointer to the object.
+ *
+ *  returns: Nothing.
+ */
+void epoch_retire_fn(free_epoch_t free_fn, void* ptr);
+
+/*
+ * Function: epoch_reclaim
+ * --------------------
+ *  Tries to advance the epoch and frees what the calling thread retired
+ *  that is now safe. Retiring calls it every EPOCH_RECLAIM_THRESHOLD
+ *  objects.
+ *
+ *  No parameters.
+ *
+ *  returns: True if the epoch advanced, false if a thread held it back.
+ */
+bool epoch_reclaim(void);
+
+/*
+ * Function: epoch_drain
+ * --------------------
+ *  Frees everything retired by every thread, at shutdown or between
+ *  phases. No thread may be in a critical section or retiring.
+ *
+ *  No parameters.
+ *
+ *  returns: Number of objects freed.
+ */
+size_t epoch_drain(void);
+
+/**** PRIVATE ****/
+/*
+ * Function: _epoch_record
+ * --------------------
+ *  Gets the calling thread's record, registering the thread first.
+ *
+ *  returns: Pointer to the record.
+ */
+epoch_record_t* _epoch_record(void);
+
+/*
+ * Function: _epoch_retire_entry
+ * --------------------
+ *  Adds an entry to the calling thread's limbo list for the current epoch.
+ *
+ *  returns: Nothing.
+ */
+void _epoch_retire_entry(const epoch_entry_t* entry);
+
+/*
+ * Function: _epoch_free_limbo
+ * --------------------
+ *  Frees every entry of a limbo list.
+ *
+ *  returns: Number of entries freed.
+ */
+size_t _epoch_free_limbo(epoch_limbo_t* limbo);
+
+/*
+ * Function: _epoch_key_create
+ * --------------------
+ *  Creates the thread key whose destructor releases thread records.
+ *
+ *  returns: Nothing.
+ */
+void _epoch_key_create(void);
+
+/*
+ * Function: _epoch_release
+ * --------------------
+ *  Thread exit destructor, hands a record to the next thread to register.
+ *
+ *  returns: Nothing.
+ */
+void _epoch_release(void* _record);
+
+#endif
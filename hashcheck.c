@@ -0,0 +1,315 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a quality analyzer for user supplied hash_t functions.
+         The hashtable indexes with hash % size over sizes of
+         INITIAL_TABLE_SIZE * 2^k, so a hash that looks fine in isolation
+         can still pile keys into a few buckets and make ht_get_node walk
+         long chains. Distribution is measured at exactly those sizes.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "hashcheck.h"
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <assert.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HASHCHECK_HAVE_TSC
+#endif
+
+/**** PUBLIC ****/
+
+/*
+ * Function: hashcheck_analyze
+ * --------------------
+ *  Measures a hash function over a sample of distinct keys: bucket
+ *  distribution with % size indexing at every table size the hashtable
+ *  passes through while growing to hold the sample, chi-squared uniformity,
+ *  avalanche and throughput.
+ *
+ *  hash: Hash function to check.
+ *  keys: Sample of distinct keys.
+ *  n_keys: Number of keys.
+ *  key_size: Size of each key in bytes, 0 for NUL terminated strings.
+ *  report: Output report.
+ *
+ *  returns: Nothing.
+ */
+void hashcheck_analyze(hash_t hash, void* const* keys, size_t n_keys,
+                size_t key_size, hashcheck_report_t* report) {
+    assert(hash);
+    assert(keys);
+    assert(n_keys);
+    assert(report);
+    memset(report, 0, sizeof(hashcheck_report_t));
+    report->n_keys = n_keys;
+
+    size_t* hashes = malloc(sizeof(size_t) * n_keys);
+    assert(hashes);
+    for (size_t i = 0; i < n_keys; i++) {
+        hashes[i] = hash(keys[i]);
+    }
+
+    // Table sizes in insertion order, each holding the keys it would have
+    // just before the insert that grows it
+    size_t size = INITIAL_TABLE_SIZE;
+    while (report->n_tables < HASHCHECK_MAX_TABLES) {
+        size_t capacity = (size_t)(size * MAX_LOAD_FACTOR);
+        size_t held = capacity > 1 ? capacity - 1 : 1;
+        held = held < n_keys ? held : n_keys;
+
+        hashcheck_table_t* table = &report->tables[report->n_tables++];
+        _hashcheck_table(hashes, held, size, table);
+
+        if (table->probe_ratio > HASHCHECK_PROBE_LIMIT) {
+            report->long_chains = true;
+        }
+        if (table->chi_squared_z > HASHCHECK_Z_LIMIT) {
+            report->non_uniform = true;
+        }
+
+        if (held == n_keys) {
+            break;
+        }
+        size *= GROWTH_FACTOR;
+    }
+
+    // Full hash collisions, every index size shares them
+    qsort(hashes, n_keys, sizeof(size_t), _hashcheck_compare_size);
+    for (size_t i = 1, run = 0; i < n_keys; i++) {
+        run = hashes[i] == hashes[i - 1] ? run + 1 : 0;
+        report->n_collisions += run;
+    }
+    free(hashes);
+
+    _hashcheck_avalanche(hash, keys, n_keys, key_size, report);
+    _hashcheck_throughput(hash, keys, n_keys, key_size, report);
+}
+
+/*
+ * Function: hashcheck_print
+ * --------------------
+ *  Writes a report as one JSON object.
+ *
+ *  out: Stream to write to.
+ *  name: Name of the hash function.
+ *  report: Pointer to the report.
+ *
+ *  returns: Nothing.
+ */
+void hashcheck_print(FILE* out, const char* name,
+                const hashcheck_report_t* report) {
+    assert(out);
+    assert(name);
+    assert(report);
+
+    fprintf(out, "{\"hash\":\"%s\",\"keys\":%zu,\"collisions\":%zu,"
+                "\"tables\":[", name, report->n_keys, report->n_collisions);
+    for (size_t i = 0; i < report->n_tables; i++) {
+        const hashcheck_table_t* table = &report->tables[i];
+        fprintf(out, "%s{\"size\":%zu,\"keys\":%zu,\"empty\":%zu,"
+                    "\"max_chain\":%zu,\"chi_squared\":%.1f,"
+                    "\"chi_squared_z\":%.2f,\"probe_ratio\":%.3f}",
+                    i ? "," : "", table->size, table->n_keys, table->empty,
+                    table->max_chain, table->chi_squared, table->chi_squared_z,
+                    table->probe_ratio);
+    }
+    fprintf(out, "],\"avalanche_mean_bias\":%.4f,\"avalanche_worst_bias\":"
+                "%.4f,\"ns_per_hash\":%.2f,\"bytes_per_ns\":%.3f,"
+                "\"bytes_per_cycle\":%.3f,\"long_chains\":%s,"
+                "\"non_uniform\":%s,\"poor_avalanche\":%s}\n",
+                report->avalanche_mean_bias, report->avalanche_worst_bias,
+                report->ns_per_hash, report->bytes_per_ns,
+                report->bytes_per_cycle,
+                report->long_chains ? "true" : "false",
+                report->non_uniform ? "true" : "false",
+                report->poor_avalanche ? "true" : "false");
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _hashcheck_table
+ * --------------------
+ *  Fills the bucket statistics of one table size.
+ *
+ *  returns: Nothing.
+ */
+void _hashcheck_table(const size_t* hashes, size_t n_keys, size_t size,
+                hashcheck_table_t* table) {
+    uint32_t* counts = calloc(size, sizeof(uint32_t));
+    assert(counts);
+
+    for (size_t i = 0; i < n_keys; i++) {
+        counts[hashes[i] % size]++;
+    }
+
+    double expected = (double)n_keys / (double)size;
+    double chi_squared = 0.0, compares = 0.0;
+    table->size = size;
+    table->n_keys = n_keys;
+    table->empty = 0;
+    table->max_chain = 0;
+
+    for (size_t i = 0; i < size; i++) {
+        double diff = (double)counts[i] - expected;
+        chi_squared += diff * diff / expected;
+
+        // Finding every key of a chain of c compares 1 + 2 + ... + c nodes
+        compares += (double)counts[i] * ((double)counts[i] + 1.0) / 2.0;
+
+        table->empty += !counts[i];
+        table->max_chain = counts[i] > table->max_chain ? counts[i] :
+                    table->max_chain;
+    }
+
+    // Uniform hashing compares 1 + (n - 1) / 2m nodes per successful search
+    double ideal = 1.0 + ((double)n_keys - 1.0) / (2.0 * (double)size);
+    double df = (double)size - 1.0;
+    table->chi_squared = chi_squared;
+    table->chi_squared_z = (chi_squared - df) / sqrt(2.0 * df);
+    table->probe_ratio = compares / (double)n_keys / ideal;
+
+    free(counts);
+}
+
+/*
+ * Function: _hashcheck_avalanche
+ * --------------------
+ *  Flips every sampled input bit of sampled keys and measures how often
+ *  each output bit follows.
+ *
+ *  returns: Nothing.
+ */
+void _hashcheck_avalanche(hash_t hash, void* const* keys, size_t n_keys,
+                size_t key_size, hashcheck_report_t* report) {
+    size_t n_samples = n_keys < HASHCHECK_AVALANCHE_KEYS ? n_keys :
+                HASHCHECK_AVALANCHE_KEYS;
+    size_t stride = n_keys / n_samples;
+    uint32_t (*flips)[HASHCHECK_OUTPUT_BITS] = calloc(
+                HASHCHECK_AVALANCHE_BITS, sizeof(*flips));
+    uint32_t trials[HASHCHECK_AVALANCHE_BITS] = { 0 };
+    assert(flips);
+
+    for (size_t s = 0; s < n_samples; s++) {
+        const void* key = keys[s * stride];
+        size_t len = _hashcheck_key_len(key, key_size);
+        size_t n_bits = len * 8 < HASHCHECK_AVALANCHE_BITS ? len * 8 :
+                    HASHCHECK_AVALANCHE_BITS;
+
+        // Copy with room for the string terminator
+        unsigned char* copy = malloc(len + 1);
+        assert(copy);
+        memcpy(copy, key, len);
+        copy[len] = '\0';
+        size_t original = hash(copy);
+
+        for (size_t bit = 0; bit < n_bits; bit++) {
+            copy[bit / 8] ^= (unsigned char)(1u << (bit % 8));
+
+            // A flip that ends a string early changes the key's length
+            if (key_size || copy[bit / 8]) {
+                size_t diff = hash(copy) ^ original;
+                trials[bit]++;
+                for (size_t out = 0; out < HASHCHECK_OUTPUT_BITS; out++) {
+                    flips[bit][out] += (diff >> out) & 1;
+                }
+            }
+
+            copy[bit / 8] ^= (unsigned char)(1u << (bit % 8));
+        }
+        free(copy);
+    }
+
+    double sum = 0.0, worst = 0.0;
+    size_t cells = 0;
+    for (size_t bit = 0; bit < HASHCHECK_AVALANCHE_BITS; bit++) {
+        if (!trials[bit]) {
+            continue;
+        }
+
+        for (size_t out = 0; out < HASHCHECK_OUTPUT_BITS; out++) {
+            double bias = fabs(2.0 * flips[bit][out] / trials[bit] - 1.0);
+            sum += bias;
+            worst = bias > worst ? bias : worst;
+            cells++;
+        }
+    }
+
+    report->avalanche_mean_bias = cells ? sum / (double)cells : 0.0;
+    report->avalanche_worst_bias = worst;
+    report->poor_avalanche = worst > HASHCHECK_BIAS_LIMIT;
+    free(flips);
+}
+
+/*
+ * Function: _hashcheck_throughput
+ * --------------------
+ *  Times repeated hashing of the keys.
+ *
+ *  returns: Nothing.
+ */
+void _hashcheck_throughput(hash_t hash, void* const* keys, size_t n_keys,
+                size_t key_size, hashcheck_report_t* report) {
+    size_t bytes = 0, n_hashes = 0, sink = 0;
+    struct timespec start, end;
+
+    size_t sample_bytes = 0;
+    for (size_t i = 0; i < n_keys; i++) {
+        sample_bytes += _hashcheck_key_len(keys[i], key_size);
+    }
+    sample_bytes = sample_bytes ? sample_bytes : 1;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+#ifdef HASHCHECK_HAVE_TSC
+    uint64_t cycles = __rdtsc();
+#endif
+    while (bytes < HASHCHECK_THROUGHPUT_BYTES) {
+        for (size_t i = 0; i < n_keys; i++) {
+            sink += hash(keys[i]);
+        }
+        bytes += sample_bytes;
+        n_hashes += n_keys;
+    }
+#ifdef HASHCHECK_HAVE_TSC
+    cycles = __rdtsc() - cycles;
+#endif
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    // Keep the hashes from being optimised away
+    volatile size_t keep = sink;
+    (void)keep;
+
+    double ns = (double)(end.tv_sec - start.tv_sec) * 1e9 +
+                (double)(end.tv_nsec - start.tv_nsec);
+    report->ns_per_hash = ns / (double)n_hashes;
+    report->bytes_per_ns = ns > 0 ? (double)bytes / ns : 0.0;
+#ifdef HASHCHECK_HAVE_TSC
+    report->bytes_per_cycle = cycles ? (double)bytes / (double)cycles : 0.0;
+#endif
+}
+
+/*
+ * Function: _hashcheck_key_len
+ * --------------------
+ *  Gets the number of bytes hashed for a key.
+ *
+ *  returns: key_size, or the string length for string keys.
+ */
+size_t _hashcheck_key_len(const void* key, size_t key_size) {
+    return key_size ? key_size : strlen(key);
+}
+
+/*
+ * Function: _hashcheck_compare_size
+ * --------------------
+ *  qsort comparator for size_t.
+ *
+ *  returns: Negative, zero or positive as a < b, a == b or a > b.
+ */
+int _hashcheck_compare_size(const void* a, const void* b) {
+    size_t x = *(const size_t*)a, y = *(const size_t*)b;
+    return (x > y) - (x < y);
+}
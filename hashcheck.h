@@ -0,0 +1,147 @@
+#ifndef HASHCHECK_H
+#define HASHCHECK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "hashtable.h"
+
+// Table sizes checked, INITIAL_TABLE_SIZE * GROWTH_FACTOR^k
+#define HASHCHECK_MAX_TABLES 32
+// Keys and input bits sampled for avalanche
+#define HASHCHECK_AVALANCHE_KEYS 512
+#define HASHCHECK_AVALANCHE_BITS 256
+#define HASHCHECK_OUTPUT_BITS (sizeof(size_t) * 8)
+// Bytes hashed at least when measuring throughput
+#define HASHCHECK_THROUGHPUT_BYTES (16 * 1024 * 1024)
+// Successful ht_get_node walks this much longer than ideal are flagged
+#define HASHCHECK_PROBE_LIMIT 1.5
+// Chi-squared this many standard deviations above uniform is flagged
+#define HASHCHECK_Z_LIMIT 6.0
+// Output bits this biased on a single input bit flip are flagged
+#define HASHCHECK_BIAS_LIMIT 0.5
+
+/*
+ * Bucket distribution at one table size, with the table holding as many of
+ * the keys, first in sample order, as it would just before growing.
+ */
+typedef struct hashcheck_table {
+    size_t size;
+    size_t n_keys;
+    size_t empty;
+    size_t max_chain;
+    // Uniformity of bucket counts, z is the standard score over size - 1
+    // degrees of freedom
+    double chi_squared;
+    double chi_squared_z;
+    // Mean nodes ht_get_node compares to find a key, relative to uniform
+    // hashing
+    double probe_ratio;
+} hashcheck_table_t;
+
+typedef struct hashcheck_report {
+    size_t n_keys;
+    // Pairs of keys with equal full hash values
+    size_t n_collisions;
+    size_t n_tables;
+    hashcheck_table_t tables[HASHCHECK_MAX_TABLES];
+    // |2 * P(output bit flips) - 1| over input and output bit pairs
+    double avalanche_mean_bias;
+    double avalanche_worst_bias;
+    double ns_per_hash;
+    // 0 where no cycle counter is available
+    double bytes_per_cycle;
+    double bytes_per_ns;
+    // Verdicts
+    bool long_chains;
+    bool non_uniform;
+    bool poor_avalanche;
+} hashcheck_report_t;
+
+/**** PUBLIC ****/
+
+/*
+ * Function: hashcheck_analyze
+ * --------------------
+ *  Measures a hash function over a sample of distinct keys: bucket
+ *  distribution with % size indexing at every table size the hashtable
+ *  passes through while growing to hold the sample, chi-squared uniformity,
+ *  avalanche and throughput.
+ *
+ *  hash: Hash function to check.
+ *  keys: Sample of distinct keys.
+ *  n_keys: Number of keys.
+ *  key_size: Size of each key in bytes, 0 for NUL terminated strings.
+ *  report: Output report.
+ *
+ *  returns: Nothing.
+ */
+void hashcheck_analyze(hash_t hash, void* const* keys, size_t n_keys,
+                size_t key_size, hashcheck_report_t* report);
+
+/*
+ * Function: hashcheck_print
+ * --------------------
+ *  Writes a report as one JSON object.
+ *
+ *  out: Stream to write to.
+ *  name: Name of the hash function.
+ *  report: Pointer to the report.
+ *
+ *  returns: Nothing.
+ */
+void hashcheck_print(FILE* out, const char* name,
+                const hashcheck_report_t* report);
+
+/**** PRIVATE ****/
+/*
+ * Function: _hashcheck_table
+ * --------------------
+ *  Fills the bucket statistics of one table size.
+ *
+ *  returns: Nothing.
+ */
+void _hashcheck_table(const size_t* hashes, size_t n_keys, size_t size,
+                hashcheck_table_t* table);
+
+/*
+ * Function: _hashcheck_avalanche
+ * --------------------
+ *  Flips every sampled input bit of sampled keys and measures how often
+ *  each output bit follows.
+ *
+ *  returns: Nothing.
+ */
+void _hashcheck_avalanche(hash_t hash, void* const* keys, size_t n_keys,
+                size_t key_size, hashcheck_report_t* report);
+
+/*
+ * Function: _hashcheck_throughput
+ * --------------------
+ *  Times repeated hashing of the keys.
+ *
+ *  returns: Nothing.
+ */
+void _hashcheck_throughput(hash_t hash, void* const* keys, size_t n_keys,
+                size_t key_size, hashcheck_report_t* report);
+
+/*
+ * Function: _hashcheck_key_len
+ * --------------------
+ *  Gets the number of bytes hashed for a key.
+ *
+ *  returns: key_size, or the string length for string keys.
+ */
+size_t _hashcheck_key_len(const void* key, size_t key_size);
+
+/*
+ * Function: _hashcheck_compare_size
+ * --------------------
+ *  qsort comparator for size_t.
+ *
+ *  returns: Negative, zero or positive as a < b, a == b or a > b.
+ */
+int _hashcheck_compare_size(const void* a, const void* b);
+
+#endif
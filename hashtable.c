@@ -8,6 +8,11 @@ Purpose: This file is a custom hashtable library with efficient growing.
 #include <stdio.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <string.h>
+#include "pool.h"
+#include "metrics.h"
+#include "probes.h"
+#include "alloctrack.h"
 
 /**** PUBLIC ****/
 
@@ -23,15 +28,36 @@ Purpose: This file is a custom hashtable library with efficient growing.
  *  returns: Pointer to the new hashtable.
  */
 hashtable_t* ht_create(size_t size, compare_t compare, hash_t hash) {
+    return ht_create_with_allocator(size, compare, hash, NULL);
+}
+
+/*
+ * Function: ht_create_with_allocator
+ * --------------------
+ *  Creates a new hashtable whose memory comes from an allocator.
+ * 
+ *  size: Initial size of the hashtable.
+ *  cmp: Function pointer to compare two keys.
+ *  hash: Function pointer to hash a key.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ * 
+ *  returns: Pointer to the new hashtable.
+ */
+hashtable_t* ht_create_with_allocator(size_t size, compare_t compare, 
+                            hash_t hash, const allocator_t* allocator) {
     assert(compare);
     assert(hash);
+    allocator_t alloc = allocator_resolve(allocator);
 
-    hashtable_t* ht = malloc(sizeof(hashtable_t));
+    hashtable_t* ht = allocator_alloc(&alloc, sizeof(hashtable_t));
     assert(ht);
+    ht->allocator = alloc;
+    METRICS_ALLOC(METRICS_HASHTABLE, sizeof(hashtable_t));
 
     // Initialise hashtable
-    ht->table = malloc(sizeof(ht_node_t*) * size);
+    ht->table = allocator_alloc(&alloc, sizeof(ht_node_t*) * size);
     assert(ht->table);
+    METRICS_ALLOC(METRICS_HASHTABLE, sizeof(ht_node_t*) * size);
     _initialise_table(ht->table, size);
 
     // Initialise hashtable parameters
@@ -39,6 +65,73 @@ hashtable_t* ht_create(size_t size, compare_t compare, hash_t hash) {
     ht->size = size;
     ht->compare = compare;
     ht->hash = hash;
+    ht->block = NULL;
+
+    return ht;
+}
+
+/*
+ * Function: ht_create_arena
+ * --------------------
+ *  Creates a new hashtable whose memory is allocated from an arena. Nodes
+ *  are never freed individually, ht_clean frees nothing itself.
+ * 
+ *  size: Initial size of the hashtable.
+ *  cmp: Function pointer to compare two keys.
+ *  hash: Function pointer to hash a key.
+ *  arena: Arena to allocate nodes from, must outlive the hashtable.
+ * 
+ *  returns: Pointer to the new hashtable.
+ */
+hashtable_t* ht_create_arena(size_t size, compare_t compare, hash_t hash,
+                            arena_t* arena) {
+    assert(arena);
+    allocator_t allocator = allocator_arena(arena);
+
+    return ht_create_with_allocator(size, compare, hash, &allocator);
+}
+
+/*
+ * Function: ht_create_fixed
+ * --------------------
+ *  Creates a fixed capacity hashtable backed by a single allocation. It
+ *  never allocates or resizes afterwards, use ht_try_insert to get a full
+ *  error rather than an assert.
+ * 
+ *  capacity: Maximum number of keys.
+ *  cmp: Function pointer to compare two keys.
+ *  hash: Function pointer to hash a key.
+ * 
+ *  returns: Pointer to the new hashtable.
+ */
+hashtable_t* ht_create_fixed(size_t capacity, compare_t compare, hash_t hash) {
+    assert(compare);
+    assert(hash);
+    assert(capacity);
+
+    // Table sized for the load factor at capacity, so it never resizes
+    size_t size = capacity / MAX_LOAD_FACTOR + 1;
+    size_t table_bytes = sizeof(ht_node_t*) * size;
+
+    // Hashtable, table and node pool in one block
+    char* block = malloc(sizeof(hashtable_t) + table_bytes + 
+                pool_bytes(sizeof(ht_node_t), capacity));
+    assert(block);
+    ALLOCTRACK_NOTE(sizeof(hashtable_t) + table_bytes + 
+                pool_bytes(sizeof(ht_node_t), capacity));
+    hashtable_t* ht = (hashtable_t*)block;
+    pool_t* pool = pool_init(block + sizeof(hashtable_t) + table_bytes, 
+                sizeof(ht_node_t), capacity);
+
+    ht->table = (ht_node_t**)(block + sizeof(hashtable_t));
+    _initialise_table(ht->table, size);
+
+    ht->n_values = 0;
+    ht->size = size;
+    ht->compare = compare;
+    ht->hash = hash;
+    ht->allocator = pool_allocator(pool);
+    ht->block = block;
 
     return ht;
 }
@@ -55,10 +148,30 @@ hashtable_t* ht_create(size_t size, compare_t compare, hash_t hash) {
  *  returns: Nothing.
  */
 void ht_insert(hashtable_t* ht, void* key, void* value) {
+    bool inserted = ht_try_insert(ht, key, value);
+    assert(inserted);
+    (void)inserted;
+}
+
+/*
+ * Function: ht_try_insert
+ * --------------------
+ *  Inserts key and value into ht, overwites value if key already exists.
+ * 
+ *  ht: Pointer to the hashtable.
+ *  key: Key to insert.
+ *  value: Value to insert.
+ * 
+ *  returns: False if a new node could not be allocated, as when a fixed 
+ *           capacity hashtable is full, true otherwise.
+ */
+bool ht_try_insert(hashtable_t* ht, void* key, void* value) {
     assert(ht);
     assert(key);
     size_t index = 0;
     ht_node_t* node = NULL;
+    METRICS_SAMPLE_BEGIN(sample);
+    METRICS_COUNT(METRICS_HASHTABLE, METRICS_INSERTS);
 
     // Get index of key
     index = ht_get_index(ht, key);
@@ -66,12 +179,17 @@ void ht_insert(hashtable_t* ht, void* key, void* value) {
     // Check if key already exists
     if ((node = ht_get_node(ht, key))) {
         node->value = value;
-        return;
+        DSL_PROBE4(ht_insert, ht, key, ht->n_values, ht->size);
+        METRICS_SAMPLE_END(sample, METRICS_HASHTABLE, METRICS_OP_INSERT);
+        return true;
     }
 
     // Create new node
-    node = malloc(sizeof(ht_node_t));
-    assert(node);
+    if (!(node = allocator_alloc(&ht->allocator, sizeof(ht_node_t)))) {
+        METRICS_SAMPLE_END(sample, METRICS_HASHTABLE, METRICS_OP_INSERT);
+        return false;
+    }
+    METRICS_ALLOC(METRICS_HASHTABLE, sizeof(ht_node_t));
     node->key = key;
     node->value = value;
     node->next = ht->table[index];
@@ -80,9 +198,13 @@ void ht_insert(hashtable_t* ht, void* key, void* value) {
     ht->n_values++;
 
     // Check if hashtable needs to be resized
-    if (_needs_resize(ht)) {
+    if (DSL_UNLIKELY(_needs_resize(ht))) {
         _resize_ht(ht);
     }
+
+    DSL_PROBE4(ht_insert, ht, key, ht->n_values, ht->size);
+    METRICS_SAMPLE_END(sample, METRICS_HASHTABLE, METRICS_OP_INSERT);
+    return true;
 }
 
 /*
@@ -99,40 +221,22 @@ void* ht_search(hashtable_t* ht, void* key) {
     assert(ht);
     assert(key);
     ht_node_t* node = NULL;
+    METRICS_SAMPLE_BEGIN(sample);
+    METRICS_COUNT(METRICS_HASHTABLE, METRICS_LOOKUPS);
 
     // Get node if key exists
     node = ht_get_node(ht, key);
+    METRICS_SAMPLE_END(sample, METRICS_HASHTABLE, METRICS_OP_LOOKUP);
 
     // Key found
     if (node) {
         return node->value;
     }
     // Key not found
+    METRICS_COUNT(METRICS_HASHTABLE, METRICS_MISSES);
     return NULL;
 }
 
-/*
- * Function: ht_get_index
- * --------------------
- *  Gets the index of a key in ht.
- * 
- *  ht: Pointer to the hashtable.
- *  key: Key to get index of.
- * 
- *  returns: Index of key.
- */
-size_t ht_get_index(hashtable_t* ht, void* key) {
-    assert(ht);
-    assert(key);
-    size_t hash = 0, index = 0;
-    
-    // Use hash to determine index
-    hash = ht->hash(key);
-    index = hash % ht->size;
-
-    return index;
-}
-
 /*
  * Function: ht_get_node
  * --------------------
@@ -146,18 +250,20 @@ size_t ht_get_index(hashtable_t* ht, void* key) {
 ht_node_t* ht_get_node(hashtable_t* ht, void* key) {
     assert(ht);
     assert(key);
-    size_t index = 0;
+    size_t index = 0, walked = 0;
+    ht_node_t* node = NULL;
 
     index = ht_get_index(ht, key);
 
     // Traverse through bucket list and check if key exists, return it if found
-    for (ht_node_t* node = ht->table[index]; node; node = node->next) {
+    for (node = ht->table[index]; node; node = node->next, walked++) {
         if (ht->compare(node->key, key) == 0) {
-            return node;
+            break;
         }
     }
 
-    return NULL;
+    DSL_PROBE4(ht_lookup, ht, index, walked, node != NULL);
+    return node;
 }
 
 /*
@@ -174,12 +280,17 @@ void* ht_get_key(hashtable_t* ht, void* key) {
     assert(ht);
     assert(key);
     ht_node_t* node = NULL;
+    METRICS_SAMPLE_BEGIN(sample);
+    METRICS_COUNT(METRICS_HASHTABLE, METRICS_LOOKUPS);
 
     // Get node if key exists
-    if ((node = ht_get_node(ht, key))) {
+    node = ht_get_node(ht, key);
+    METRICS_SAMPLE_END(sample, METRICS_HASHTABLE, METRICS_OP_LOOKUP);
+    if (node) {
         return node->key;
     }
     // Key not found
+    METRICS_COUNT(METRICS_HASHTABLE, METRICS_MISSES);
     return NULL;
 }
 
@@ -197,11 +308,17 @@ bool ht_contains(hashtable_t* ht, void* key) {
     assert(ht);
     assert(key);
 
+    METRICS_SAMPLE_BEGIN(sample);
+    METRICS_COUNT(METRICS_HASHTABLE, METRICS_LOOKUPS);
+
     // Check if key exists
-    if (ht_get_node(ht, key)) {
+    ht_node_t* node = ht_get_node(ht, key);
+    METRICS_SAMPLE_END(sample, METRICS_HASHTABLE, METRICS_OP_LOOKUP);
+    if (node) {
         return true;
     }
     // Key not found
+    METRICS_COUNT(METRICS_HASHTABLE, METRICS_MISSES);
     return false;
 }
 
@@ -246,43 +363,41 @@ void ht_remove(hashtable_t* ht, void* key,
                 free_ht_t free_key, free_ht_t free_value) {
     assert(ht);
     assert(key);
-    ht_node_t* node = NULL, * next_node = NULL;
-    void* old_key, * old_value;
+    ht_node_t* node = NULL, ** link = NULL;
+    METRICS_SAMPLE_BEGIN(sample);
+    METRICS_COUNT(METRICS_HASHTABLE, METRICS_REMOVES);
 
-    // Get node if key exists
-    if ((node = ht_get_node(ht, key))) {
-        next_node = node->next;
-        old_key = node->key;
-        old_value = node->value;
-
-        // Remove node from bucket list
-        if (node->next) {
-            node->key = next_node->key;
-            node->value = next_node->value;
-            node->next = next_node->next;
-        } else {
-            node->key = NULL;
-            node->value = NULL;
-            node->next = NULL;
+    // Find node and the link pointing at it
+    link = &ht->table[ht_get_index(ht, key)];
+    for (node = *link; node; link = &node->next, node = node->next) {
+        if (ht->compare(node->key, key) == 0) {
+            break;
         }
+    }
+
+    if (node) {
+        // Unlink node from bucket list, so its slot is reusable
+        *link = node->next;
 
         // Free key if needed
-        if (free_key && old_key) {
-            free_key(old_key);
+        if (free_key && node->key) {
+            free_key(node->key);
         }
         
         // Free value if needed
-        if (free_value && old_value) {
-            free_value(old_value);
+        if (free_value && node->value) {
+            free_value(node->value);
         }
 
-        if (next_node) {
-            free(next_node);
-        }
-        
+        allocator_free(&ht->allocator, node, sizeof(ht_node_t));
+        METRICS_FREE(METRICS_HASHTABLE, sizeof(ht_node_t));
         ht->n_values--;
+    } else {
+        METRICS_COUNT(METRICS_HASHTABLE, METRICS_MISSES);
     }
 
+    METRICS_SAMPLE_END(sample, METRICS_HASHTABLE, METRICS_OP_REMOVE);
+
     // Note: Table is not shrinked
 }
 
@@ -318,7 +433,8 @@ void ht_reset(hashtable_t* ht, free_ht_t free_key, free_ht_t free_value) {
                 free_value(node->value);
             }
 
-            free(node);
+            allocator_free(&ht->allocator, node, sizeof(ht_node_t));
+            METRICS_FREE(METRICS_HASHTABLE, sizeof(ht_node_t));
             node = next;
         }
 
@@ -339,12 +455,17 @@ void ht_reset(hashtable_t* ht, free_ht_t free_key, free_ht_t free_value) {
  * 
  *  returns: Nothing.
  */
-void ht_clean(hashtable_t* ht, free_ht_t free_key, free_ht_t free_value) {
+DSL_COLD void ht_clean(hashtable_t* ht, free_ht_t free_key,
+                free_ht_t free_value) {
     assert(ht);
     ht_node_t* node = NULL, * next = NULL;
+    const void* owner = &ht->allocator;
     
-    // Free all nodes and destroy them
-    for (size_t i = 0; i < ht->size; i++) {
+    // Free all nodes and destroy them, bulk allocators free them on reset
+    // and fixed capacity nodes go with the block
+    bool owns_nodes = !allocator_is_bulk(&ht->allocator) && !ht->block;
+    for (size_t i = 0; i < ht->size && (owns_nodes || free_key || free_value);
+                i++) {
         node = ht->table[i];
         while (node) {
             next = node->next;
@@ -359,13 +480,24 @@ void ht_clean(hashtable_t* ht, free_ht_t free_key, free_ht_t free_value) {
                 free_value(node->value);
             }
 
-            free(node);
+            allocator_free(&ht->allocator, node, sizeof(ht_node_t));
+            METRICS_FREE(METRICS_HASHTABLE, sizeof(ht_node_t));
             node = next;
         }
     }
 
-    free(ht->table);
-    free(ht);
+    if (ht->block) {
+        free(ht->block);
+        return;
+    }
+
+    METRICS_FREE(METRICS_HASHTABLE, sizeof(ht_node_t*) * ht->size);
+    METRICS_FREE(METRICS_HASHTABLE, sizeof(hashtable_t));
+    allocator_free(&ht->allocator, ht->table, sizeof(ht_node_t*) * ht->size);
+    allocator_free(&ht->allocator, ht, sizeof(hashtable_t));
+    if (owns_nodes) {
+        ALLOCTRACK_CLEANED(owner);
+    }
 }
 
 /* COUNTER HT */
@@ -374,12 +506,13 @@ void ht_clean(hashtable_t* ht, free_ht_t free_key, free_ht_t free_value) {
  * Function: ht_insert_count
  * --------------------
  *  Inserts a key with a count value into ht, if it already exists, 
- *  updates its count.
+ *  updates its count. Counts are malloc'd, so a fixed capacity hashtable,
+ *  which never allocates, only counts keys already in it.
  * 
  *  ht: Pointer to the hashtable.
  *  key: Key to insert.
  * 
- *  returns: Count.
+ *  returns: Count, 0 if key is new and ht is fixed capacity.
  */
 size_t ht_insert_count(hashtable_t* ht, void* key) {
     ht_node_t* node = ht_get_node(ht, key);
@@ -389,10 +522,15 @@ size_t ht_insert_count(hashtable_t* ht, void* key) {
         *(size_t*)(node->value) = *(size_t*)(node->value) + 1;
         return *(size_t*)(node->value);
     } 
+    // Fixed tables don't allocate, new keys are refused
+    else if (ht->block != NULL) {
+        return 0;
+    }
     // Key doesn't exist, insert it
     else {
         size_t* start_value = malloc(sizeof(size_t));
         assert(start_value);
+        ALLOCTRACK_NOTE(sizeof(size_t));
         *start_value = 1;
         ht_insert(ht, key, start_value);
         return *start_value;
@@ -418,6 +556,43 @@ size_t ht_get_count(hashtable_t* ht, void* key) {
     }
 }
 
+/*
+ * Function: ht_memory_usage
+ * --------------------
+ *  Gets the memory ht uses, from its counts rather than by walking it.
+ *  Keys and values are not counted.
+ * 
+ *  ht: Pointer to the hashtable.
+ *  usage: Output breakdown.
+ * 
+ *  returns: Total bytes.
+ */
+size_t ht_memory_usage(hashtable_t* ht, memory_usage_t* usage) {
+    assert(ht);
+    assert(usage);
+    memset(usage, 0, sizeof(memory_usage_t));
+
+    // Fixed capacity hashtables are one block holding table and node pool
+    if (ht->block) {
+        pool_t* pool = ht->allocator.ctx;
+        usage->header = sizeof(hashtable_t);
+        usage->buckets = sizeof(ht_node_t*) * ht->size;
+        usage->nodes = sizeof(ht_node_t) * ht->n_values;
+        allocator_account_block(sizeof(hashtable_t) + usage->buckets +
+                    pool_bytes(sizeof(ht_node_t), pool->n_slots), usage);
+        return usage->total;
+    }
+
+    allocator_account(&ht->allocator, sizeof(hashtable_t), 1, &usage->header,
+                usage);
+    allocator_account(&ht->allocator, sizeof(ht_node_t*) * ht->size, 1,
+                &usage->buckets, usage);
+    allocator_account(&ht->allocator, sizeof(ht_node_t), ht->n_values,
+                &usage->nodes, usage);
+
+    return usage->total;
+}
+
 /**** PRIVATE ****/
 
 /*
@@ -430,6 +605,11 @@ size_t ht_get_count(hashtable_t* ht, void* key) {
  *  returns: True if ht needs to be resized, false otherwise.
  */
 bool _needs_resize(hashtable_t* ht) {
+    // Fixed capacity tables are sized up front
+    if (ht->block) {
+        return false;
+    }
+
     // Check if table surpasses load factor
     if (ht->n_values >= ht->size * MAX_LOAD_FACTOR) {
         return true;
@@ -446,21 +626,27 @@ bool _needs_resize(hashtable_t* ht) {
  * 
  *  returns: Nothing.
  */
-void _resize_ht(hashtable_t* ht) {
+DSL_COLD void _resize_ht(hashtable_t* ht) {
     size_t new_size = ht->size * GROWTH_FACTOR;
+    DSL_PROBE3(ht_resize_start, ht, ht->size, ht->n_values);
 
     // Allocate new table
-    ht_node_t** new_table = malloc(sizeof(ht_node_t*) * new_size);
+    ht_node_t** new_table = allocator_alloc(&ht->allocator, 
+                sizeof(ht_node_t*) * new_size);
     assert(new_table);
     _initialise_table(new_table, new_size);
+    METRICS_COUNT(METRICS_HASHTABLE, METRICS_RESIZES);
+    METRICS_ALLOC(METRICS_HASHTABLE, sizeof(ht_node_t*) * new_size);
 
     // Efficient copy and rehash all nodes
     _copy_ht(new_table, ht, new_size);
-    ht->size = new_size;
 
     // Free old table
-    free(ht->table);
+    allocator_free(&ht->allocator, ht->table, sizeof(ht_node_t*) * ht->size);
+    METRICS_FREE(METRICS_HASHTABLE, sizeof(ht_node_t*) * ht->size);
     ht->table = new_table;
+    ht->size = new_size;
+    DSL_PROBE3(ht_resize_done, ht, ht->size, ht->n_values);
 }
 
 /*
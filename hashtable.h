@@ -3,6 +3,9 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <assert.h>
+#include "allocator.h"
+#include "hints.h"
 
 #define INITIAL_TABLE_SIZE 49
 #define MAX_LOAD_FACTOR 1.0
@@ -26,6 +29,10 @@ typedef struct hashtable {
     compare_t compare;
     hash_t hash;
     ht_node_t** table;
+    // Source of the hashtable, its table and nodes
+    allocator_t allocator;
+    // Single allocation of a fixed capacity hashtable, NULL otherwise
+    void* block;
 } hashtable_t;
 
 /**** PUBLIC ****/
@@ -43,6 +50,53 @@ typedef struct hashtable {
  */
 hashtable_t* ht_create(size_t size, compare_t compare, 
                             hash_t hash);
+
+/*
+ * Function: ht_create_with_allocator
+ * --------------------
+ *  Creates a new hashtable whose memory comes from an allocator.
+ * 
+ *  size: Initial size of the hashtable.
+ *  cmp: Function pointer to compare two keys.
+ *  hash: Function pointer to hash a key.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ * 
+ *  returns: Pointer to the new hashtable.
+ */
+hashtable_t* ht_create_with_allocator(size_t size, compare_t compare, 
+                            hash_t hash, const allocator_t* allocator);
+
+/*
+ * Function: ht_create_arena
+ * --------------------
+ *  Creates a new hashtable whose memory is allocated from an arena. Nodes
+ *  are never freed individually, ht_clean frees nothing itself.
+ * 
+ *  size: Initial size of the hashtable.
+ *  cmp: Function pointer to compare two keys.
+ *  hash: Function pointer to hash a key.
+ *  arena: Arena to allocate nodes from, must outlive the hashtable.
+ * 
+ *  returns: Pointer to the new hashtable.
+ */
+hashtable_t* ht_create_arena(size_t size, compare_t compare, hash_t hash,
+                            arena_t* arena);
+
+/*
+ * Function: ht_create_fixed
+ * --------------------
+ *  Creates a fixed capacity hashtable backed by a single allocation. It
+ *  never allocates or resizes afterwards, use ht_try_insert to get a full
+ *  error rather than an assert.
+ * 
+ *  capacity: Maximum number of keys.
+ *  cmp: Function pointer to compare two keys.
+ *  hash: Function pointer to hash a key.
+ * 
+ *  returns: Pointer to the new hashtable.
+ */
+hashtable_t* ht_create_fixed(size_t capacity, compare_t compare, hash_t hash);
+
 /*
  * Function: ht_insert
  * --------------------
@@ -56,6 +110,20 @@ hashtable_t* ht_create(size_t size, compare_t compare,
  */
 void ht_insert(hashtable_t* ht, void* key, void* value);
 
+/*
+ * Function: ht_try_insert
+ * --------------------
+ *  Inserts key and value into ht, overwites value if key already exists.
+ * 
+ *  ht: Pointer to the hashtable.
+ *  key: Key to insert.
+ *  value: Value to insert.
+ * 
+ *  returns: False if a new node could not be allocated, as when a fixed 
+ *           capacity hashtable is full, true otherwise.
+ */
+bool ht_try_insert(hashtable_t* ht, void* key, void* value);
+
 /*
  * Function: ht_search
  * --------------------
@@ -78,7 +146,17 @@ void* ht_search(hashtable_t* ht, void* key);
  * 
  *  returns: Index of key.
  */
-size_t ht_get_index(hashtable_t* ht, void* key);
+DSL_INLINE size_t ht_get_index(hashtable_t* ht, void* key) {
+    assert(ht);
+    assert(key);
+    size_t hash = 0, index = 0;
+    
+    // Use hash to determine index
+    hash = ht->hash(key);
+    index = hash % ht->size;
+
+    return index;
+}
 
 /*
  * Function: ht_get_node
@@ -168,7 +246,8 @@ void ht_reset(hashtable_t* ht, free_ht_t free_key, free_ht_t free_value);
  * 
  *  returns: Nothing.
  */
-void ht_clean(hashtable_t* ht, free_ht_t free_keys, free_ht_t free_values);
+DSL_COLD void ht_clean(hashtable_t* ht, free_ht_t free_keys,
+                free_ht_t free_values);
 
 
 /* COUNTER HT */
@@ -176,12 +255,13 @@ void ht_clean(hashtable_t* ht, free_ht_t free_keys, free_ht_t free_values);
  * Function: ht_insert_count
  * --------------------
  *  Inserts a key with a count value into ht, if it already exists, 
- *  updates its count.
+ *  updates its count. Counts are malloc'd, so a fixed capacity hashtable,
+ *  which never allocates, only counts keys already in it.
  * 
  *  ht: Pointer to the hashtable.
  *  key: Key to insert.
  * 
- *  returns: Count.
+ *  returns: Count, 0 if key is new and ht is fixed capacity.
  */
 size_t ht_insert_count(hashtable_t* ht, void* key);
 
@@ -198,6 +278,19 @@ size_t ht_insert_count(hashtable_t* ht, void* key);
  */
 size_t ht_get_count(hashtable_t* ht, void* key);
 
+/*
+ * Function: ht_memory_usage
+ * --------------------
+ *  Gets the memory ht uses, from its counts rather than by walking it.
+ *  Keys and values are not counted.
+ * 
+ *  ht: Pointer to the hashtable.
+ *  usage: Output breakdown.
+ * 
+ *  returns: Total bytes.
+ */
+size_t ht_memory_usage(hashtable_t* ht, memory_usage_t* usage);
+
 /**** PRIVATE ****/
 /*
  * Function: _needs_resize
@@ -219,7 +312,7 @@ bool _needs_resize(hashtable_t* ht);
  * 
  *  returns: Nothing.
  */
-void _resize_ht(hashtable_t* ht);
+DSL_COLD void _resize_ht(hashtable_t* ht);
 
 /*
  * Function: _copy_ht
@@ -0,0 +1,25 @@
+#ifndef HINTS_H
+#define HINTS_H
+
+/*
+ * Code layout hints. Small hot functions are defined in the headers with
+ * DSL_INLINE so callers in any translation unit can inline them without
+ * LTO. Paths that run once per container or once per resize are DSL_COLD,
+ * kept out of line and out of the hot text so they don't dilute the
+ * callers' instruction cache and branch prediction.
+ */
+
+#define DSL_INLINE static inline
+
+#if defined(__GNUC__) || defined(__clang__)
+#define DSL_COLD __attribute__((cold, noinline))
+#define DSL_UNLIKELY(x) __builtin_expect(!!(x), 0)
+// Read prefetch into every cache level, a hint that never faults
+#define DSL_PREFETCH(addr) __builtin_prefetch(addr, 0, 3)
+#else
+#define DSL_COLD
+#define DSL_UNLIKELY(x) (x)
+#define DSL_PREFETCH(addr) ((void)(addr))
+#endif
+
+#endif
@@ -0,0 +1,400 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a custom lock order validator in the style of the Linux
+         kernel's lockdep. It learns a global order between lock classes
+         from "held A, then acquired B" events and reports the first
+         acquisition that inverts it, before it ever deadlocks. Pairs already
+         validated are cached in a shared hashtable, and each thread caches
+         the stacks of held locks it has validated, so the steady state is
+         one lookup in thread local memory.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "lockdep.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include "hashtable.h"
+#include "dlinkedlist.h"
+#include "bitset.h"
+
+/**** PUBLIC ****/
+
+/*
+ * Function: lockdep_create
+ * --------------------
+ *  Creates a new lock order validator. Lock classes are keyed by ckey_t
+ *  as RAG nodes are.
+ *
+ *  cmp: Function pointer to compare two class keys.
+ *  hash: Function pointer to hash a class key.
+ *  report: Optional function called on each new order inversion, if NULL
+ *          inversions are printed to stderr.
+ *  ctx: User context passed to report.
+ *
+ *  returns: Pointer to the new lock order validator.
+ */
+lockdep_t* lockdep_create(compare_t cmp, hash_t hash, lockdep_report_t report,
+                void* ctx) {
+    assert(cmp);
+    assert(hash);
+
+    lockdep_t* ld = malloc(sizeof(lockdep_t));
+    assert(ld);
+
+    ld->classes = ht_create(INITIAL_TABLE_SIZE, cmp, hash);
+    ld->pairs = ht_create(INITIAL_TABLE_SIZE, _lockdep_pair_compare,
+                _lockdep_pair_hash);
+
+    ld->capacity = LOCKDEP_INITIAL_CLASSES;
+    ld->by_id = malloc(sizeof(lockdep_class_t*) * ld->capacity);
+    ld->stack = malloc(sizeof(size_t) * ld->capacity);
+    assert(ld->by_id && ld->stack);
+    ld->visited = bitset_create(ld->capacity);
+
+    ld->n_classes = 0;
+    ld->n_inversions = 0;
+    ld->report = report;
+    ld->report_ctx = ctx;
+    pthread_rwlock_init(&ld->lock, NULL);
+
+    return ld;
+}
+
+/*
+ * Function: lockdep_register
+ * --------------------
+ *  Gets the class for a key, creating it if it doesn't exist. Callers
+ *  should keep the returned class with the lock rather than register on
+ *  every acquire.
+ *
+ *  ld: Pointer to the lock order validator.
+ *  key: Class key, owned by the caller and must outlive ld.
+ *
+ *  returns: Pointer to the lock class.
+ */
+lockdep_class_t* lockdep_register(lockdep_t* ld, ckey_t* key) {
+    assert(ld);
+    assert(key);
+    lockdep_class_t* class = NULL;
+
+    pthread_rwlock_wrlock(&ld->lock);
+
+    if ((class = ht_search(ld->classes, key))) {
+        pthread_rwlock_unlock(&ld->lock);
+        return class;
+    }
+
+    // Grow id indexed storage
+    if (ld->n_classes == ld->capacity) {
+        ld->capacity *= 2;
+        ld->by_id = realloc(ld->by_id, sizeof(lockdep_class_t*) * ld->capacity);
+        ld->stack = realloc(ld->stack, sizeof(size_t) * ld->capacity);
+        assert(ld->by_id && ld->stack);
+        bitset_clean(ld->visited);
+        ld->visited = bitset_create(ld->capacity);
+    }
+
+    class = malloc(sizeof(lockdep_class_t));
+    assert(class);
+    class->key = key;
+    class->id = ld->n_classes;
+    class->after = DLL_create();
+
+    ld->by_id[ld->n_classes++] = class;
+    ht_insert(ld->classes, key, class);
+
+    pthread_rwlock_unlock(&ld->lock);
+    return class;
+}
+
+/*
+ * Function: lockdep_thread_init
+ * --------------------
+ *  Initialises the held lock state of a thread, and its cache of validated
+ *  chains.
+ *
+ *  thread: Pointer to the thread state.
+ *
+ *  returns: Nothing.
+ */
+void lockdep_thread_init(lockdep_thread_t* thread) {
+    assert(thread);
+    thread->n_held = 0;
+    memset(thread->cache, 0, sizeof(thread->cache));
+}
+
+/*
+ * Function: lockdep_acquire
+ * --------------------
+ *  Records that a thread acquired a lock of class, learning a "held, then
+ *  acquired" order for every lock the thread holds. A stack of held locks
+ *  the thread has validated before is a single lookup in its own chain
+ *  cache, with no lock taken.
+ *
+ *  ld: Pointer to the lock order validator.
+ *  thread: Pointer to the thread state.
+ *  class: Class of the acquired lock.
+ *
+ *  returns: True if the acquisition is consistent with the order so far,
+ *           false if it inverts it.
+ */
+bool lockdep_acquire(lockdep_t* ld, lockdep_thread_t* thread,
+                lockdep_class_t* class) {
+    assert(ld);
+    assert(thread);
+    assert(class);
+    assert(thread->n_held < LOCKDEP_MAX_HELD);
+    lockdep_pair_t* pair = NULL;
+    lockdep_pair_t lookup;
+    bool consistent = true, missing = false;
+    size_t n_held = thread->n_held;
+    uint64_t chain = _lockdep_chain(n_held ? thread->chain[n_held - 1] : 0,
+                class);
+    uint64_t* cached = &thread->cache[(chain >> 1) &
+                (LOCKDEP_CHAIN_CACHE - 1)];
+
+    thread->held[n_held] = class;
+    thread->chain[n_held] = chain;
+    thread->n_held++;
+
+    // Outermost lock, no pair to check
+    if (!n_held) {
+        return true;
+    }
+
+    // Fast path, this thread validated the same chain before. A pair's
+    // verdict never changes once recorded, so neither does the chain's
+    if ((*cached & ~(uint64_t)1) == chain) {
+        return *cached & 1;
+    }
+
+    // Every pair already validated by some thread
+    pthread_rwlock_rdlock(&ld->lock);
+    for (size_t i = 0; i < n_held; i++) {
+        lookup.before = thread->held[i]->id;
+        lookup.after = class->id;
+        if (!(pair = ht_search(ld->pairs, &lookup))) {
+            missing = true;
+            break;
+        }
+        if (pair->inverted) {
+            consistent = false;
+        }
+    }
+    pthread_rwlock_unlock(&ld->lock);
+
+    // Slow path, validate new pairs against the order graph
+    if (missing) {
+        consistent = true;
+        pthread_rwlock_wrlock(&ld->lock);
+        for (size_t i = 0; i < n_held; i++) {
+            if (!_lockdep_add_pair(ld, thread->held[i], class)) {
+                consistent = false;
+            }
+        }
+        pthread_rwlock_unlock(&ld->lock);
+    }
+
+    *cached = chain | consistent;
+    return consistent;
+}
+
+/*
+ * Function: lockdep_release
+ * --------------------
+ *  Records that a thread released a lock of class, locks may be released
+ *  in any order.
+ *
+ *  ld: Pointer to the lock order validator.
+ *  thread: Pointer to the thread state.
+ *  class: Class of the released lock.
+ *
+ *  returns: Nothing.
+ */
+void lockdep_release(lockdep_t* ld, lockdep_thread_t* thread,
+                lockdep_class_t* class) {
+    assert(ld);
+    assert(thread);
+    (void)ld;
+
+    // Search from the top, locks are usually released in reverse order
+    for (size_t i = thread->n_held; i > 0; i--) {
+        if (thread->held[i - 1] == class) {
+            // Locks above it move down, rekey their chains
+            for (size_t j = i; j < thread->n_held; j++) {
+                thread->held[j - 1] = thread->held[j];
+                thread->chain[j - 1] = _lockdep_chain(j > 1 ?
+                            thread->chain[j - 2] : 0, thread->held[j - 1]);
+            }
+            thread->n_held--;
+            return;
+        }
+    }
+}
+
+/*
+ * Function: lockdep_clean
+ * --------------------
+ *  Frees the lock order validator, class keys are left to the caller.
+ *
+ *  ld: Pointer to the lock order validator.
+ *
+ *  returns: Nothing.
+ */
+void lockdep_clean(lockdep_t* ld) {
+    assert(ld);
+
+    for (size_t i = 0; i < ld->n_classes; i++) {
+        DLL_clean(ld->by_id[i]->after, NULL);
+        free(ld->by_id[i]);
+    }
+
+    ht_clean(ld->classes, NULL, NULL);
+    ht_clean(ld->pairs, free, NULL);
+    bitset_clean(ld->visited);
+    pthread_rwlock_destroy(&ld->lock);
+    free(ld->by_id);
+    free(ld->stack);
+    free(ld);
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _lockdep_add_pair
+ * --------------------
+ *  Validates and records a new pair, with the write lock held.
+ *
+ *  ld: Pointer to the lock order validator.
+ *  held: Class already held.
+ *  acquired: Class being acquired.
+ *
+ *  returns: True if the pair is consistent with the order so far.
+ */
+bool _lockdep_add_pair(lockdep_t* ld, lockdep_class_t* held,
+                lockdep_class_t* acquired) {
+    lockdep_pair_t* pair = NULL;
+    lockdep_pair_t lookup;
+
+    // Another thread may have added it since the fast path
+    lookup.before = held->id;
+    lookup.after = acquired->id;
+    if ((pair = ht_search(ld->pairs, &lookup))) {
+        return !pair->inverted;
+    }
+
+    pair = malloc(sizeof(lockdep_pair_t));
+    assert(pair);
+    pair->before = held->id;
+    pair->after = acquired->id;
+
+    // Inverted if held is already ordered after acquired, or is acquired
+    pair->inverted = held == acquired || _lockdep_reaches(ld, acquired, held);
+    ht_insert(ld->pairs, pair, pair);
+
+    if (pair->inverted) {
+        ld->n_inversions++;
+        if (ld->report) {
+            ld->report(ld->report_ctx, held, acquired);
+        } else {
+            fprintf(stderr, "lockdep: order inversion, class %zu acquired "
+                        "while holding class %zu\n", acquired->id, held->id);
+        }
+        return false;
+    }
+
+    // Only consistent pairs extend the order
+    DLL_insert_tail(held->after, acquired);
+    return true;
+}
+
+/*
+ * Function: _lockdep_reaches
+ * --------------------
+ *  Checks if there is an order path from one class to another.
+ *
+ *  ld: Pointer to the lock order validator.
+ *  from: Class to start from.
+ *  to: Class to look for.
+ *
+ *  returns: True if to is ordered after from.
+ */
+bool _lockdep_reaches(lockdep_t* ld, lockdep_class_t* from,
+                lockdep_class_t* to) {
+    size_t top = 0;
+
+    bitset_reset(ld->visited);
+    bitset_set(ld->visited, from->id);
+    ld->stack[top++] = from->id;
+
+    // Iterative DFS, each class is pushed at most once
+    while (top > 0) {
+        lockdep_class_t* class = ld->by_id[ld->stack[--top]];
+
+        for (DLL_node_t* node = class->after->head; node; node = node->next) {
+            lockdep_class_t* next = node->data;
+            if (next == to) {
+                return true;
+            }
+            if (!bitset_test(ld->visited, next->id)) {
+                bitset_set(ld->visited, next->id);
+                ld->stack[top++] = next->id;
+            }
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Function: _lockdep_chain
+ * --------------------
+ *  Extends a held lock chain key with one more class.
+ *
+ *  returns: The new chain key, never 0 and with the low bit clear.
+ */
+uint64_t _lockdep_chain(uint64_t chain, const lockdep_class_t* class) {
+    uint64_t hash = (chain ^ ((uint64_t)class->id + 1)) *
+                0x9E3779B97F4A7C15ULL;
+
+    hash ^= hash >> 29;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 32;
+    return (hash & ~(uint64_t)3) | 2;
+}
+
+/*
+ * Function: _lockdep_pair_compare
+ * --------------------
+ *  Compares two class pairs.
+ *
+ *  returns: 0 if equal, non-zero otherwise.
+ */
+int _lockdep_pair_compare(const void* a, const void* b) {
+    const lockdep_pair_t* pair_a = a;
+    const lockdep_pair_t* pair_b = b;
+
+    return !(pair_a->before == pair_b->before &&
+                pair_a->after == pair_b->after);
+}
+
+/*
+ * Function: _lockdep_pair_hash
+ * --------------------
+ *  Hashes a class pair.
+ *
+ *  returns: Hash of the pair.
+ */
+size_t _lockdep_pair_hash(const void* key) {
+    const lockdep_pair_t* pair = key;
+    uint64_t hash = (uint64_t)pair->before * 0x9E3779B97F4A7C15ULL;
+
+    hash ^= (uint64_t)pair->after + (hash >> 29);
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    return (size_t)(hash ^ (hash >> 32));
+}
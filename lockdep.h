@@ -0,0 +1,214 @@
+#ifndef LOCKDEP_H
+#define LOCKDEP_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "hashtable.h"
+#include "dlinkedlist.h"
+#include "bitset.h"
+#include "RAG.h"
+
+#define LOCKDEP_MAX_HELD 48
+#define LOCKDEP_INITIAL_CLASSES 64
+// Validated chains cached per thread, a power of two
+#define LOCKDEP_CHAIN_CACHE 256
+
+typedef struct lockdep_class {
+    ckey_t* key;
+    size_t id;
+    // Classes acquired while this class was held
+    DLL_t* after;
+} lockdep_class_t;
+
+typedef struct lockdep_pair {
+    size_t before;
+    size_t after;
+    bool inverted;
+} lockdep_pair_t;
+
+/*
+ * Called once per inverted pair, the first time acquired is taken while
+ * held is held although acquired is already ordered before held.
+ */
+typedef void (* lockdep_report_t)(void* ctx, lockdep_class_t* held,
+                lockdep_class_t* acquired);
+
+typedef struct lockdep {
+    // ckey_t* -> lockdep_class_t*
+    hashtable_t* classes;
+    // lockdep_pair_t* -> itself, every pair seen so far
+    hashtable_t* pairs;
+    lockdep_class_t** by_id;
+    size_t n_classes;
+    size_t capacity;
+    size_t n_inversions;
+    lockdep_report_t report;
+    void* report_ctx;
+    // Scratch for order graph searches
+    bitset_t* visited;
+    size_t* stack;
+    // Readers validate cached pairs, writers add classes and pairs
+    pthread_rwlock_t lock;
+} lockdep_t;
+
+/*
+ * Locks held by one thread, kept by the caller in thread local storage and
+ * used with a single validator. Only this thread touches it, so the
+ * steady state acquire reads no shared memory.
+ */
+typedef struct lockdep_thread {
+    lockdep_class_t* held[LOCKDEP_MAX_HELD];
+    // chain[i] is a 64 bit key of held[0 .. i], as in kernel lockdep
+    uint64_t chain[LOCKDEP_MAX_HELD];
+    size_t n_held;
+    // Chains this thread has validated, direct mapped, the low bit holds
+    // whether the chain is consistent, 0 is empty
+    uint64_t cache[LOCKDEP_CHAIN_CACHE];
+} lockdep_thread_t;
+
+/*
+ * Function: lockdep_create
+ * --------------------
+ *  Creates a new lock order validator. Lock classes are keyed by ckey_t
+ *  as RAG nodes are.
+ *
+ *  cmp: Function pointer to compare two class keys.
+ *  hash: Function pointer to hash a class key.
+ *  report: Optional function called on each new order inversion, if NULL
+ *          inversions are printed to stderr.
+ *  ctx: User context passed to report.
+ *
+ *  returns: Pointer to the new lock order validator.
+ */
+lockdep_t* lockdep_create(compare_t cmp, hash_t hash, lockdep_report_t report,
+                void* ctx);
+
+/*
+ * Function: lockdep_register
+ * --------------------
+ *  Gets the class for a key, creating it if it doesn't exist. Callers
+ *  should keep the returned class with the lock rather than register on
+ *  every acquire.
+ *
+ *  ld: Pointer to the lock order validator.
+ *  key: Class key, owned by the caller and must outlive ld.
+ *
+ *  returns: Pointer to the lock class.
+ */
+lockdep_class_t* lockdep_register(lockdep_t* ld, ckey_t* key);
+
+/*
+ * Function: lockdep_thread_init
+ * --------------------
+ *  Initialises the held lock state of a thread, and its cache of validated
+ *  chains.
+ *
+ *  thread: Pointer to the thread state.
+ *
+ *  returns: Nothing.
+ */
+void lockdep_thread_init(lockdep_thread_t* thread);
+
+/*
+ * Function: lockdep_acquire
+ * --------------------
+ *  Records that a thread acquired a lock of class, learning a "held, then
+ *  acquired" order for every lock the thread holds. A stack of held locks
+ *  the thread has validated before is a single lookup in its own chain
+ *  cache, with no lock taken.
+ *
+ *  ld: Pointer to the lock order validator.
+ *  thread: Pointer to the thread state.
+ *  class: Class of the acquired lock.
+ *
+ *  returns: True if the acquisition is consistent with the order so far,
+ *           false if it inverts it.
+ */
+bool lockdep_acquire(lockdep_t* ld, lockdep_thread_t* thread,
+                lockdep_class_t* class);
+
+/*
+ * Function: lockdep_release
+ * --------------------
+ *  Records that a thread released a lock of class, locks may be released
+ *  in any order.
+ *
+ *  ld: Pointer to the lock order validator.
+ *  thread: Pointer to the thread state.
+ *  class: Class of the released lock.
+ *
+ *  returns: Nothing.
+ */
+void lockdep_release(lockdep_t* ld, lockdep_thread_t* thread,
+                lockdep_class_t* class);
+
+/*
+ * Function: lockdep_clean
+ * --------------------
+ *  Frees the lock order validator, class keys are left to the caller.
+ *
+ *  ld: Pointer to the lock order validator.
+ *
+ *  returns: Nothing.
+ */
+void lockdep_clean(lockdep_t* ld);
+
+/**** PRIVATE ****/
+/*
+ * Function: _lockdep_add_pair
+ * --------------------
+ *  Validates and records a new pair, with the write lock held.
+ *
+ *  ld: Pointer to the lock order validator.
+ *  held: Class already held.
+ *  acquired: Class being acquired.
+ *
+ *  returns: True if the pair is consistent with the order so far.
+ */
+bool _lockdep_add_pair(lockdep_t* ld, lockdep_class_t* held,
+                lockdep_class_t* acquired);
+
+/*
+ * Function: _lockdep_reaches
+ * --------------------
+ *  Checks if there is an order path from one class to another.
+ *
+ *  ld: Pointer to the lock order validator.
+ *  from: Class to start from.
+ *  to: Class to look for.
+ *
+ *  returns: True if to is ordered after from.
+ */
+bool _lockdep_reaches(lockdep_t* ld, lockdep_class_t* from,
+                lockdep_class_t* to);
+
+/*
+ * Function: _lockdep_chain
+ * --------------------
+ *  Extends a held lock chain key with one more class.
+ *
+ *  returns: The new chain key, never 0 and with the low bit clear.
+ */
+uint64_t _lockdep_chain(uint64_t chain, const lockdep_class_t* class);
+
+/*
+ * Function: _lockdep_pair_compare
+ * --------------------
+ *  Compares two class pairs.
+ *
+ *  returns: 0 if equal, non-zero otherwise.
+ */
+int _lockdep_pair_compare(const void* a, const void* b);
+
+/*
+ * Function: _lockdep_pair_hash
+ * --------------------
+ *  Hashes a class pair.
+ *
+ *  returns: Hash of the pair.
+ */
+size_t _lockdep_pair_hash(const void* key);
+
+#endif
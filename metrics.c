@@ -0,0 +1,447 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is the optional instrumentation layer of the containers.
+         Each thread counts into its own block, written with plain relaxed
+         stores so counting costs no locked instruction, and readers sum the
+         blocks of every live thread plus the totals of exited ones. One in
+         METRICS_SAMPLE_PERIOD operations per thread is timed into power of
+         two latency buckets.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <pthread.h>
+
+static const char* CONTAINER_NAMES[METRICS_N_CONTAINERS] = {
+    "hashtable", "dlinkedlist", "queue", "stack", "RAG"
+};
+
+static const char* COUNTER_NAMES[METRICS_N_COUNTERS] = {
+    "inserts", "lookups", "misses", "removes", "resizes", "allocs", "frees",
+    "alloc_bytes", "free_bytes"
+};
+
+static const char* OP_NAMES[METRICS_N_OPS] = {
+    "insert", "lookup", "remove"
+};
+
+atomic_bool metrics_enabled = false;
+_Thread_local metrics_thread_t* metrics_local = NULL;
+
+// Live thread blocks, the totals of exited threads and the reset baseline
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static metrics_thread_t* threads = NULL;
+static metrics_snapshot_t retired;
+static metrics_snapshot_t baseline;
+static pthread_key_t metrics_key;
+static pthread_once_t metrics_key_once = PTHREAD_ONCE_INIT;
+
+/**** PUBLIC ****/
+
+/*
+ * Function: metrics_enable
+ * --------------------
+ *  Turns counting on or off at runtime, off by default.
+ *
+ *  enabled: True to count, false to stop.
+ *
+ *  returns: False if metrics were not compiled in, true otherwise.
+ */
+bool metrics_enable(bool enabled) {
+#ifdef DSL_METRICS
+    atomic_store(&metrics_enabled, enabled);
+    return true;
+#else
+    (void)enabled;
+    return false;
+#endif
+}
+
+/*
+ * Function: metrics_snapshot
+ * --------------------
+ *  Aggregates the counters of every thread.
+ *
+ *  snapshot: Output snapshot.
+ *
+ *  returns: Nothing.
+ */
+void metrics_snapshot(metrics_snapshot_t* snapshot) {
+    assert(snapshot);
+
+    pthread_mutex_lock(&registry_lock);
+    memcpy(snapshot, &retired, sizeof(metrics_snapshot_t));
+
+    for (metrics_thread_t* local = threads; local; local = local->next) {
+        for (int c = 0; c < METRICS_N_CONTAINERS; c++) {
+            for (int k = 0; k < METRICS_N_COUNTERS; k++) {
+                snapshot->counters[c][k] += atomic_load_explicit(
+                            &local->counters[c][k], memory_order_relaxed);
+            }
+
+            for (int op = 0; op < METRICS_N_OPS; op++) {
+                metrics_latency_t* latency = &snapshot->latency[c][op];
+                latency->count += atomic_load_explicit(
+                            &local->latency_count[c][op], memory_order_relaxed);
+                latency->sum_ns += atomic_load_explicit(
+                            &local->latency_sum[c][op], memory_order_relaxed);
+
+                for (int b = 0; b < METRICS_N_BUCKETS; b++) {
+                    latency->buckets[b] += atomic_load_explicit(
+                                &local->latency[c][op][b],
+                                memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+    // Counters only grow, so subtracting the baseline resets them
+    for (int c = 0; c < METRICS_N_CONTAINERS; c++) {
+        for (int k = 0; k < METRICS_N_COUNTERS; k++) {
+            snapshot->counters[c][k] -= baseline.counters[c][k];
+        }
+
+        for (int op = 0; op < METRICS_N_OPS; op++) {
+            metrics_latency_t* latency = &snapshot->latency[c][op];
+            latency->count -= baseline.latency[c][op].count;
+            latency->sum_ns -= baseline.latency[c][op].sum_ns;
+
+            for (int b = 0; b < METRICS_N_BUCKETS; b++) {
+                latency->buckets[b] -= baseline.latency[c][op].buckets[b];
+            }
+        }
+    }
+    pthread_mutex_unlock(&registry_lock);
+}
+
+/*
+ * Function: metrics_total
+ * --------------------
+ *  Sums a counter over every container.
+ *
+ *  snapshot: Pointer to the snapshot.
+ *  counter: Counter to sum.
+ *
+ *  returns: Global value of the counter.
+ */
+uint64_t metrics_total(const metrics_snapshot_t* snapshot,
+                metrics_counter_t counter) {
+    assert(snapshot);
+    uint64_t total = 0;
+
+    for (int c = 0; c < METRICS_N_CONTAINERS; c++) {
+        total += snapshot->counters[c][counter];
+    }
+    return total;
+}
+
+/*
+ * Function: metrics_percentile
+ * --------------------
+ *  Estimates a latency percentile from its power of two buckets.
+ *
+ *  latency: Pointer to the latency histogram.
+ *  percentile: Percentile in [0, 100].
+ *
+ *  returns: Upper bound of the bucket holding the percentile in ns, 0 if
+ *           nothing was sampled.
+ */
+uint64_t metrics_percentile(const metrics_latency_t* latency,
+                double percentile) {
+    assert(latency);
+
+    if (!latency->count) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)(percentile / 100.0 * (double)latency->count +
+                0.5);
+    uint64_t seen = 0;
+    rank = rank ? rank : 1;
+
+    for (int b = 0; b < METRICS_N_BUCKETS; b++) {
+        seen += latency->buckets[b];
+        if (seen >= rank) {
+            return 1ULL << b;
+        }
+    }
+    return 1ULL << (METRICS_N_BUCKETS - 1);
+}
+
+/*
+ * Function: metrics_export
+ * --------------------
+ *  Writes a snapshot of every counter as Prometheus text or JSON, with
+ *  global totals next to the per container values.
+ *
+ *  format: Output format.
+ *  buf: Output buffer, may be NULL to measure.
+ *  size: Size of buf.
+ *
+ *  returns: Length of the full export, as snprintf, output is truncated to
+ *           fit buf.
+ */
+size_t metrics_export(metrics_format_t format, char* buf, size_t size) {
+    metrics_snapshot_t* snapshot = malloc(sizeof(metrics_snapshot_t));
+    assert(snapshot);
+    size_t len = 0;
+
+    metrics_snapshot(snapshot);
+
+    // Appends to buf while it has room, always counting the full length
+#define EMIT(...) \
+    len += (size_t)snprintf(buf && len < size ? buf + len : NULL, \
+                buf && len < size ? size - len : 0, __VA_ARGS__)
+
+    if (format == METRICS_PROMETHEUS) {
+        for (int k = 0; k < METRICS_N_COUNTERS; k++) {
+            EMIT("# TYPE dsl_%s_total counter\n", COUNTER_NAMES[k]);
+            for (int c = 0; c < METRICS_N_CONTAINERS; c++) {
+                EMIT("dsl_%s_total{container=\"%s\"} %llu\n",
+                            COUNTER_NAMES[k], CONTAINER_NAMES[c],
+                            (unsigned long long)snapshot->counters[c][k]);
+            }
+            EMIT("dsl_%s_total{container=\"all\"} %llu\n", COUNTER_NAMES[k],
+                        (unsigned long long)metrics_total(snapshot, k));
+        }
+
+        EMIT("# TYPE dsl_latency_ns histogram\n");
+        for (int c = 0; c < METRICS_N_CONTAINERS; c++) {
+            for (int op = 0; op < METRICS_N_OPS; op++) {
+                metrics_latency_t* latency = &snapshot->latency[c][op];
+                uint64_t cumulative = 0;
+
+                if (!latency->count) {
+                    continue;
+                }
+
+                for (int b = 0; b < METRICS_N_BUCKETS &&
+                            cumulative < latency->count; b++) {
+                    cumulative += latency->buckets[b];
+                    EMIT("dsl_latency_ns_bucket{container=\"%s\",op=\"%s\","
+                                "le=\"%llu\"} %llu\n", CONTAINER_NAMES[c],
+                                OP_NAMES[op], 1ULL << b,
+                                (unsigned long long)cumulative);
+                }
+                EMIT("dsl_latency_ns_bucket{container=\"%s\",op=\"%s\","
+                            "le=\"+Inf\"} %llu\n", CONTAINER_NAMES[c],
+                            OP_NAMES[op], (unsigned long long)latency->count);
+                EMIT("dsl_latency_ns_sum{container=\"%s\",op=\"%s\"} %llu\n",
+                            CONTAINER_NAMES[c], OP_NAMES[op],
+                            (unsigned long long)latency->sum_ns);
+                EMIT("dsl_latency_ns_count{container=\"%s\",op=\"%s\"} "
+                            "%llu\n", CONTAINER_NAMES[c], OP_NAMES[op],
+                            (unsigned long long)latency->count);
+            }
+        }
+    } else {
+        EMIT("{\"enabled\":%s,\"sample_period\":%d,\"containers\":{",
+                    atomic_load(&metrics_enabled) ? "true" : "false",
+                    METRICS_SAMPLE_PERIOD);
+
+        for (int c = 0; c < METRICS_N_CONTAINERS; c++) {
+            EMIT("%s\"%s\":{", c ? "," : "", CONTAINER_NAMES[c]);
+            for (int k = 0; k < METRICS_N_COUNTERS; k++) {
+                EMIT("\"%s\":%llu,", COUNTER_NAMES[k],
+                            (unsigned long long)snapshot->counters[c][k]);
+            }
+
+            EMIT("\"latency\":{");
+            for (int op = 0; op < METRICS_N_OPS; op++) {
+                metrics_latency_t* latency = &snapshot->latency[c][op];
+                EMIT("%s\"%s\":{\"samples\":%llu,\"mean_ns\":%.1f,"
+                            "\"p50_ns\":%llu,\"p99_ns\":%llu,"
+                            "\"p99_9_ns\":%llu}", op ? "," : "", OP_NAMES[op],
+                            (unsigned long long)latency->count,
+                            latency->count ? (double)latency->sum_ns /
+                            (double)latency->count : 0.0,
+                            (unsigned long long)metrics_percentile(latency,
+                            50.0), (unsigned long long)metrics_percentile(
+                            latency, 99.0), (unsigned long long)
+                            metrics_percentile(latency, 99.9));
+            }
+            EMIT("}}");
+        }
+
+        EMIT("},\"global\":{");
+        for (int k = 0; k < METRICS_N_COUNTERS; k++) {
+            EMIT("%s\"%s\":%llu", k ? "," : "", COUNTER_NAMES[k],
+                        (unsigned long long)metrics_total(snapshot, k));
+        }
+        EMIT("}}\n");
+    }
+#undef EMIT
+
+    free(snapshot);
+    return len;
+}
+
+/*
+ * Function: metrics_reset
+ * --------------------
+ *  Zeroes every counter.
+ *
+ *  No parameters.
+ *
+ *  returns: Nothing.
+ */
+void metrics_reset(void) {
+    metrics_snapshot_t* current = malloc(sizeof(metrics_snapshot_t));
+    assert(current);
+
+    // Moving the baseline up to the current totals leaves writers untouched
+    pthread_mutex_lock(&registry_lock);
+    memset(&baseline, 0, sizeof(metrics_snapshot_t));
+    pthread_mutex_unlock(&registry_lock);
+
+    metrics_snapshot(current);
+
+    pthread_mutex_lock(&registry_lock);
+    memcpy(&baseline, current, sizeof(metrics_snapshot_t));
+    pthread_mutex_unlock(&registry_lock);
+
+    free(current);
+}
+
+/*
+ * Function: metrics_sample_end
+ * --------------------
+ *  Records the latency of a sampled operation.
+ *
+ *  start: Value from metrics_sample_begin.
+ *  container: Container the operation ran on.
+ *  op: Kind of operation.
+ *
+ *  returns: Nothing.
+ */
+void metrics_sample_end(uint64_t start, metrics_container_t container,
+                metrics_op_t op) {
+    if (!start || !metrics_local) {
+        return;
+    }
+
+    metrics_thread_t* local = metrics_local;
+    uint64_t elapsed = _metrics_now_ns() - start;
+
+    // Bucket b holds latencies up to 2^b ns
+    int bucket = elapsed > 1 ? 64 - __builtin_clzll(elapsed - 1) : 0;
+    if (bucket >= METRICS_N_BUCKETS) {
+        bucket = METRICS_N_BUCKETS - 1;
+    }
+
+    _Atomic uint64_t* values[3] = {
+        &local->latency_count[container][op],
+        &local->latency_sum[container][op],
+        &local->latency[container][op][bucket]
+    };
+    uint64_t amounts[3] = { 1, elapsed, 1 };
+
+    for (int i = 0; i < 3; i++) {
+        atomic_store_explicit(values[i], atomic_load_explicit(values[i],
+                    memory_order_relaxed) + amounts[i], memory_order_relaxed);
+    }
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _metrics_register
+ * --------------------
+ *  Creates the calling thread's counters and links them for aggregation.
+ *
+ *  returns: Pointer to the thread's counters.
+ */
+metrics_thread_t* _metrics_register(void) {
+    metrics_thread_t* local = calloc(1, sizeof(metrics_thread_t));
+    assert(local);
+    local->countdown = METRICS_SAMPLE_PERIOD;
+
+    pthread_once(&metrics_key_once, _metrics_key_create);
+    pthread_setspecific(metrics_key, local);
+
+    pthread_mutex_lock(&registry_lock);
+    local->next = threads;
+    if (threads) {
+        threads->prev = local;
+    }
+    threads = local;
+    pthread_mutex_unlock(&registry_lock);
+
+    metrics_local = local;
+    return local;
+}
+
+/*
+ * Function: _metrics_key_create
+ * --------------------
+ *  Creates the thread key whose destructor retires thread counters.
+ *
+ *  returns: Nothing.
+ */
+void _metrics_key_create(void) {
+    pthread_key_create(&metrics_key, _metrics_retire);
+}
+
+/*
+ * Function: _metrics_retire
+ * --------------------
+ *  Thread exit destructor, folds a thread's counters into the retired
+ *  totals and frees them.
+ *
+ *  returns: Nothing.
+ */
+void _metrics_retire(void* _local) {
+    metrics_thread_t* local = _local;
+
+    pthread_mutex_lock(&registry_lock);
+    for (int c = 0; c < METRICS_N_CONTAINERS; c++) {
+        for (int k = 0; k < METRICS_N_COUNTERS; k++) {
+            retired.counters[c][k] += atomic_load(&local->counters[c][k]);
+        }
+
+        for (int op = 0; op < METRICS_N_OPS; op++) {
+            retired.latency[c][op].count +=
+                        atomic_load(&local->latency_count[c][op]);
+            retired.latency[c][op].sum_ns +=
+                        atomic_load(&local->latency_sum[c][op]);
+
+            for (int b = 0; b < METRICS_N_BUCKETS; b++) {
+                retired.latency[c][op].buckets[b] +=
+                            atomic_load(&local->latency[c][op][b]);
+            }
+        }
+    }
+
+    // Unlink
+    if (local->prev) {
+        local->prev->next = local->next;
+    } else {
+        threads = local->next;
+    }
+    if (local->next) {
+        local->next->prev = local->prev;
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    metrics_local = NULL;
+    free(local);
+}
+
+/*
+ * Function: _metrics_now_ns
+ * --------------------
+ *  Reads the monotonic clock.
+ *
+ *  returns: Time in nanoseconds, never 0.
+ */
+uint64_t _metrics_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec) | 1;
+}
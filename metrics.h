@@ -0,0 +1,284 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// Every this many operations per thread one is timed
+#define METRICS_SAMPLE_PERIOD 64
+// Latency buckets are powers of two nanoseconds
+#define METRICS_N_BUCKETS 40
+
+typedef enum metrics_container {
+    METRICS_HASHTABLE,
+    METRICS_DLL,
+    METRICS_QUEUE,
+    METRICS_STACK,
+    METRICS_RAG,
+    METRICS_N_CONTAINERS
+} metrics_container_t;
+
+typedef enum metrics_counter {
+    METRICS_INSERTS,
+    METRICS_LOOKUPS,
+    METRICS_MISSES,
+    METRICS_REMOVES,
+    METRICS_RESIZES,
+    METRICS_ALLOCS,
+    METRICS_FREES,
+    METRICS_ALLOC_BYTES,
+    METRICS_FREE_BYTES,
+    METRICS_N_COUNTERS
+} metrics_counter_t;
+
+typedef enum metrics_op {
+    METRICS_OP_INSERT,
+    METRICS_OP_LOOKUP,
+    METRICS_OP_REMOVE,
+    METRICS_N_OPS
+} metrics_op_t;
+
+typedef enum metrics_format {
+    METRICS_PROMETHEUS,
+    METRICS_JSON
+} metrics_format_t;
+
+typedef struct metrics_latency {
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t buckets[METRICS_N_BUCKETS];
+} metrics_latency_t;
+
+/*
+ * Counters of one thread. Only the owning thread writes them, with relaxed
+ * atomics so readers aggregating them see whole values.
+ */
+typedef struct metrics_thread metrics_thread_t;
+
+struct metrics_thread {
+    _Atomic uint64_t counters[METRICS_N_CONTAINERS][METRICS_N_COUNTERS];
+    _Atomic uint64_t latency_count[METRICS_N_CONTAINERS][METRICS_N_OPS];
+    _Atomic uint64_t latency_sum[METRICS_N_CONTAINERS][METRICS_N_OPS];
+    _Atomic uint64_t latency[METRICS_N_CONTAINERS][METRICS_N_OPS]
+                [METRICS_N_BUCKETS];
+    uint32_t countdown;
+    metrics_thread_t* prev;
+    metrics_thread_t* next;
+};
+
+/*
+ * Counters aggregated over every thread, live and exited.
+ */
+typedef struct metrics_snapshot {
+    uint64_t counters[METRICS_N_CONTAINERS][METRICS_N_COUNTERS];
+    metrics_latency_t latency[METRICS_N_CONTAINERS][METRICS_N_OPS];
+} metrics_snapshot_t;
+
+extern atomic_bool metrics_enabled;
+extern _Thread_local metrics_thread_t* metrics_local;
+
+/*
+ * Instrumentation points. They compile to nothing unless DSL_METRICS is
+ * defined, and are a relaxed flag load when compiled in but disabled.
+ */
+#ifdef DSL_METRICS
+#define METRICS_COUNT(container, counter) \
+    metrics_add(container, counter, 1)
+#define METRICS_ALLOC(container, size) \
+    (metrics_add(container, METRICS_ALLOCS, 1), \
+     metrics_add(container, METRICS_ALLOC_BYTES, size))
+#define METRICS_FREE(container, size) \
+    (metrics_add(container, METRICS_FREES, 1), \
+     metrics_add(container, METRICS_FREE_BYTES, size))
+#define METRICS_SAMPLE_BEGIN(var) \
+    uint64_t var = metrics_sample_begin()
+#define METRICS_SAMPLE_END(var, container, op) \
+    ((var) ? metrics_sample_end(var, container, op) : (void)0)
+#else
+#define METRICS_COUNT(container, counter) ((void)0)
+#define METRICS_ALLOC(container, size) ((void)0)
+#define METRICS_FREE(container, size) ((void)0)
+#define METRICS_SAMPLE_BEGIN(var)
+#define METRICS_SAMPLE_END(var, container, op) ((void)0)
+#endif
+
+/**** PUBLIC ****/
+
+/*
+ * Function: metrics_enable
+ * --------------------
+ *  Turns counting on or off at runtime, off by default.
+ *
+ *  enabled: True to count, false to stop.
+ *
+ *  returns: False if metrics were not compiled in, true otherwise.
+ */
+bool metrics_enable(bool enabled);
+
+/*
+ * Function: metrics_snapshot
+ * --------------------
+ *  Aggregates the counters of every thread.
+ *
+ *  snapshot: Output snapshot.
+ *
+ *  returns: Nothing.
+ */
+void metrics_snapshot(metrics_snapshot_t* snapshot);
+
+/*
+ * Function: metrics_total
+ * --------------------
+ *  Sums a counter over every container.
+ *
+ *  snapshot: Pointer to the snapshot.
+ *  counter: Counter to sum.
+ *
+ *  returns: Global value of the counter.
+ */
+uint64_t metrics_total(const metrics_snapshot_t* snapshot,
+                metrics_counter_t counter);
+
+/*
+ * Function: metrics_percentile
+ * --------------------
+ *  Estimates a latency percentile from its power of two buckets.
+ *
+ *  latency: Pointer to the latency histogram.
+ *  percentile: Percentile in [0, 100].
+ *
+ *  returns: Upper bound of the bucket holding the percentile in ns, 0 if
+ *           nothing was sampled.
+ */
+uint64_t metrics_percentile(const metrics_latency_t* latency,
+                double percentile);
+
+/*
+ * Function: metrics_export
+ * --------------------
+ *  Writes a snapshot of every counter as Prometheus text or JSON, with
+ *  global totals next to the per container values.
+ *
+ *  format: Output format.
+ *  buf: Output buffer, may be NULL to measure.
+ *  size: Size of buf.
+ *
+ *  returns: Length of the full export, as snprintf, output is truncated to
+ *           fit buf.
+ */
+size_t metrics_export(metrics_format_t format, char* buf, size_t size);
+
+/*
+ * Function: metrics_reset
+ * --------------------
+ *  Zeroes every counter.
+ *
+ *  No parameters.
+ *
+ *  returns: Nothing.
+ */
+void metrics_reset(void);
+
+/*
+ * Function: metrics_sample_end
+ * --------------------
+ *  Records the latency of a sampled operation.
+ *
+ *  start: Value from metrics_sample_begin.
+ *  container: Container the operation ran on.
+ *  op: Kind of operation.
+ *
+ *  returns: Nothing.
+ */
+void metrics_sample_end(uint64_t start, metrics_container_t container,
+                metrics_op_t op);
+
+/**** PRIVATE ****/
+/*
+ * Function: _metrics_register
+ * --------------------
+ *  Creates the calling thread's counters and links them for aggregation.
+ *
+ *  returns: Pointer to the thread's counters.
+ */
+metrics_thread_t* _metrics_register(void);
+
+/*
+ * Function: _metrics_key_create
+ * --------------------
+ *  Creates the thread key whose destructor retires thread counters.
+ *
+ *  returns: Nothing.
+ */
+void _metrics_key_create(void);
+
+/*
+ * Function: _metrics_retire
+ * --------------------
+ *  Thread exit destructor, folds a thread's counters into the retired
+ *  totals and frees them.
+ *
+ *  returns: Nothing.
+ */
+void _metrics_retire(void* local);
+
+/*
+ * Function: _metrics_now_ns
+ * --------------------
+ *  Reads the monotonic clock.
+ *
+ *  returns: Time in nanoseconds, never 0.
+ */
+uint64_t _metrics_now_ns(void);
+
+/*
+ * Function: metrics_add
+ * --------------------
+ *  Adds to a counter of the calling thread if metrics are enabled.
+ *
+ *  container: Container the operation ran on.
+ *  counter: Counter to add to.
+ *  n: Amount to add.
+ *
+ *  returns: Nothing.
+ */
+static inline void metrics_add(metrics_container_t container,
+                metrics_counter_t counter, uint64_t n) {
+    if (!atomic_load_explicit(&metrics_enabled, memory_order_relaxed)) {
+        return;
+    }
+
+    metrics_thread_t* local = metrics_local ? metrics_local :
+                _metrics_register();
+    _Atomic uint64_t* value = &local->counters[container][counter];
+    atomic_store_explicit(value, atomic_load_explicit(value,
+                memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+/*
+ * Function: metrics_sample_begin
+ * --------------------
+ *  Starts timing an operation if it is the calling thread's sample.
+ *
+ *  No parameters.
+ *
+ *  returns: Start time in ns, 0 if the operation is not sampled.
+ */
+static inline uint64_t metrics_sample_begin(void) {
+    if (!atomic_load_explicit(&metrics_enabled, memory_order_relaxed)) {
+        return 0;
+    }
+
+    metrics_thread_t* local = metrics_local ? metrics_local :
+                _metrics_register();
+    if (--local->countdown) {
+        return 0;
+    }
+
+    local->countdown = METRICS_SAMPLE_PERIOD;
+    return _metrics_now_ns();
+}
+
+#endif
@@ -0,0 +1,203 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a custom fixed size pool allocator. All slots are
+         allocated up front and threaded onto a free list, so alloc and free
+         are a bounded pointer swap and the pool never calls malloc after
+         creation. Used by the fixed capacity container modes.
+*/
+
+#include "pool.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+/**** PUBLIC ****/
+
+/*
+ * Function: pool_create
+ * --------------------
+ *  Creates a fixed pool of equally sized slots in one allocation. The pool
+ *  never allocates afterwards, alloc and free are O(1).
+ *
+ *  slot_size: Size of each slot.
+ *  n_slots: Number of slots.
+ *
+ *  returns: Pointer to the new pool.
+ */
+pool_t* pool_create(size_t slot_size, size_t n_slots) {
+    void* memory = malloc(pool_bytes(slot_size, n_slots));
+    assert(memory);
+
+    pool_t* pool = pool_init(memory, slot_size, n_slots);
+    pool->owned = true;
+
+    return pool;
+}
+
+/*
+ * Function: pool_init
+ * --------------------
+ *  Initialises a pool over caller memory of pool_bytes(slot_size, n_slots)
+ *  bytes, so a container can share one allocation with its pool.
+ *
+ *  memory: Memory to use, aligned for pointers.
+ *  slot_size: Size of each slot.
+ *  n_slots: Number of slots.
+ *
+ *  returns: Pointer to the pool, at the start of memory.
+ */
+pool_t* pool_init(void* memory, size_t slot_size, size_t n_slots) {
+    assert(memory);
+    assert(((uintptr_t)memory % sizeof(void*)) == 0);
+    pool_t* pool = memory;
+
+    // Slots hold the free list link and stay pointer aligned
+    if (slot_size < sizeof(pool_slot_t)) {
+        slot_size = sizeof(pool_slot_t);
+    }
+    slot_size = (slot_size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+
+    pool->slot_size = slot_size;
+    pool->n_slots = n_slots;
+    pool->n_free = n_slots;
+    pool->owned = false;
+    pool->free_list = NULL;
+
+    // Thread slots in reverse so the first alloc returns the first slot
+    char* slots = (char*)memory +
+                ((sizeof(pool_t) + sizeof(void*) - 1) & ~(sizeof(void*) - 1));
+    for (size_t i = n_slots; i > 0; i--) {
+        pool_slot_t* slot = (pool_slot_t*)(slots + (i - 1) * slot_size);
+        slot->next = pool->free_list;
+        pool->free_list = slot;
+    }
+
+    return pool;
+}
+
+/*
+ * Function: pool_bytes
+ * --------------------
+ *  Gets the memory pool_init needs.
+ *
+ *  slot_size: Size of each slot.
+ *  n_slots: Number of slots.
+ *
+ *  returns: Number of bytes.
+ */
+size_t pool_bytes(size_t slot_size, size_t n_slots) {
+    if (slot_size < sizeof(pool_slot_t)) {
+        slot_size = sizeof(pool_slot_t);
+    }
+    slot_size = (slot_size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+
+    return ((sizeof(pool_t) + sizeof(void*) - 1) & ~(sizeof(void*) - 1)) +
+                slot_size * n_slots;
+}
+
+/*
+ * Function: pool_alloc
+ * --------------------
+ *  Takes a slot from the pool.
+ *
+ *  pool: Pointer to the pool.
+ *
+ *  returns: Pointer to the slot, NULL if the pool is exhausted.
+ */
+void* pool_alloc(pool_t* pool) {
+    pool_slot_t* slot = pool->free_list;
+
+    if (!slot) {
+        return NULL;
+    }
+
+    pool->free_list = slot->next;
+    pool->n_free--;
+    return slot;
+}
+
+/*
+ * Function: pool_free
+ * --------------------
+ *  Gives a slot back to the pool.
+ *
+ *  pool: Pointer to the pool.
+ *  ptr: Slot to give back.
+ *
+ *  returns: Nothing.
+ */
+void pool_free(pool_t* pool, void* ptr) {
+    pool_slot_t* slot = ptr;
+
+    if (!slot) {
+        return;
+    }
+
+    slot->next = pool->free_list;
+    pool->free_list = slot;
+    pool->n_free++;
+}
+
+/*
+ * Function: pool_allocator
+ * --------------------
+ *  Gets an allocator backed by a pool. Allocations larger than the slot
+ *  size fail.
+ *
+ *  pool: Pool to allocate from, must outlive everything using it.
+ *
+ *  returns: The pool allocator.
+ */
+allocator_t pool_allocator(pool_t* pool) {
+    assert(pool);
+    allocator_t allocator = {
+        _pool_allocator_alloc, _pool_allocator_free, NULL, pool
+    };
+    return allocator;
+}
+
+/*
+ * Function: pool_clean
+ * --------------------
+ *  Frees a pool made by pool_create, a no-op for pool_init pools.
+ *
+ *  pool: Pointer to the pool.
+ *
+ *  returns: Nothing.
+ */
+void pool_clean(pool_t* pool) {
+    assert(pool);
+    if (pool->owned) {
+        free(pool);
+    }
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _pool_allocator_alloc
+ * --------------------
+ *  pool_alloc backend of the pool allocator.
+ *
+ *  returns: Pointer to the slot, NULL if exhausted or too large.
+ */
+void* _pool_allocator_alloc(void* ctx, size_t size) {
+    pool_t* pool = ctx;
+
+    if (size > pool->slot_size) {
+        return NULL;
+    }
+    return pool_alloc(pool);
+}
+
+/*
+ * Function: _pool_allocator_free
+ * --------------------
+ *  pool_free backend of the pool allocator.
+ *
+ *  returns: Nothing.
+ */
+void _pool_allocator_free(void* ctx, void* ptr, size_t size) {
+    (void)size;
+    pool_free(ctx, ptr);
+}
@@ -0,0 +1,127 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include "allocator.h"
+
+typedef struct pool_slot pool_slot_t;
+
+struct pool_slot {
+    pool_slot_t* next;
+};
+
+typedef struct pool {
+    size_t slot_size;
+    size_t n_slots;
+    size_t n_free;
+    pool_slot_t* free_list;
+    // Memory was allocated by pool_create and is freed by pool_clean
+    bool owned;
+} pool_t;
+
+/*
+ * Function: pool_create
+ * --------------------
+ *  Creates a fixed pool of equally sized slots in one allocation. The pool
+ *  never allocates afterwards, alloc and free are O(1).
+ *
+ *  slot_size: Size of each slot.
+ *  n_slots: Number of slots.
+ *
+ *  returns: Pointer to the new pool.
+ */
+pool_t* pool_create(size_t slot_size, size_t n_slots);
+
+/*
+ * Function: pool_init
+ * --------------------
+ *  Initialises a pool over caller memory of pool_bytes(slot_size, n_slots)
+ *  bytes, so a container can share one allocation with its pool.
+ *
+ *  memory: Memory to use, aligned for pointers.
+ *  slot_size: Size of each slot.
+ *  n_slots: Number of slots.
+ *
+ *  returns: Pointer to the pool, at the start of memory.
+ */
+pool_t* pool_init(void* memory, size_t slot_size, size_t n_slots);
+
+/*
+ * Function: pool_bytes
+ * --------------------
+ *  Gets the memory pool_init needs.
+ *
+ *  slot_size: Size of each slot.
+ *  n_slots: Number of slots.
+ *
+ *  returns: Number of bytes.
+ */
+size_t pool_bytes(size_t slot_size, size_t n_slots);
+
+/*
+ * Function: pool_alloc
+ * --------------------
+ *  Takes a slot from the pool.
+ *
+ *  pool: Pointer to the pool.
+ *
+ *  returns: Pointer to the slot, NULL if the pool is exhausted.
+ */
+void* pool_alloc(pool_t* pool);
+
+/*
+ * Function: pool_free
+ * --------------------
+ *  Gives a slot back to the pool.
+ *
+ *  pool: Pointer to the pool.
+ *  ptr: Slot to give back.
+ *
+ *  returns: Nothing.
+ */
+void pool_free(pool_t* pool, void* ptr);
+
+/*
+ * Function: pool_allocator
+ * --------------------
+ *  Gets an allocator backed by a pool. Allocations larger than the slot
+ *  size fail.
+ *
+ *  pool: Pool to allocate from, must outlive everything using it.
+ *
+ *  returns: The pool allocator.
+ */
+allocator_t pool_allocator(pool_t* pool);
+
+/*
+ * Function: pool_clean
+ * --------------------
+ *  Frees a pool made by pool_create, a no-op for pool_init pools.
+ *
+ *  pool: Pointer to the pool.
+ *
+ *  returns: Nothing.
+ */
+void pool_clean(pool_t* pool);
+
+/**** PRIVATE ****/
+/*
+ * Function: _pool_allocator_alloc
+ * --------------------
+ *  pool_alloc backend of the pool allocator.
+ *
+ *  returns: Pointer to the slot, NULL if exhausted or too large.
+ */
+void* _pool_allocator_alloc(void* ctx, size_t size);
+
+/*
+ * Function: _pool_allocator_free
+ * --------------------
+ *  pool_free backend of the pool allocator.
+ *
+ *  returns: Nothing.
+ */
+void _pool_allocator_free(void* ctx, void* ptr, size_t size);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+/*
+ * USDT static tracepoints under the "dsl" provider. When <sys/sdt.h> is
+ * available each probe is a single nop plus an ELF note, so it costs nothing
+ * until bpftrace or perf attaches to it, e.g.
+ *
+ *   bpftrace -e 'usdt:./app:dsl:ht_resize_start { @t[tid] = nsecs; }
+ *                usdt:./app:dsl:ht_resize_done { @ns = hist(nsecs - @t[tid]); }'
+ *
+ * Durations are measured by pairing start and done probes in the tracer
+ * rather than reading the clock here. Without <sys/sdt.h>, or when built
+ * with DSL_NO_PROBES, the probes compile to nothing.
+ *
+ * Probes and arguments:
+ *   ht_insert        ht, key, n_values, size
+ *   ht_lookup        ht, index, chain length walked, found
+ *   ht_resize_start  ht, old size, n_values
+ *   ht_resize_done   ht, new size, n_values
+ *   queue_enqueue    queue, data
+ *   queue_dequeue    queue, data
+ *   dll_ht_remove    dll_ht, key, data
+ *   rag_insert       rag, key, hard insert, n_nodes
+ *   rag_update       rag, node id, status
+ */
+
+#if !defined(DSL_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define DSL_HAVE_PROBES
+#endif
+#endif
+
+#ifdef DSL_HAVE_PROBES
+#define DSL_PROBE2(name, a, b) DTRACE_PROBE2(dsl, name, a, b)
+#define DSL_PROBE3(name, a, b, c) DTRACE_PROBE3(dsl, name, a, b, c)
+#define DSL_PROBE4(name, a, b, c, d) DTRACE_PROBE4(dsl, name, a, b, c, d)
+#else
+// Arguments stay referenced, unevaluated, so probe only locals don't warn
+#define DSL_PROBE2(name, a, b) ((void)sizeof(a), (void)sizeof(b))
+#define DSL_PROBE3(name, a, b, c) \
+    ((void)sizeof(a), (void)sizeof(b), (void)sizeof(c))
+#define DSL_PROBE4(name, a, b, c, d) \
+    ((void)sizeof(a), (void)sizeof(b), (void)sizeof(c), (void)sizeof(d))
+#endif
+
+#endif
@@ -7,6 +7,12 @@ Purpose: This file is a custom queue library.
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "pool.h"
+#include "metrics.h"
+#include "probes.h"
+#include "alloctrack.h"
 
 /*
  * Function: queue_create
@@ -18,34 +24,79 @@ Purpose: This file is a custom queue library.
  *  returns: Pointer to the new queue.
  */
 queue_t* queue_create(void) {
-    queue_t* queue = malloc(sizeof(queue_t));
+    return queue_create_with_allocator(NULL);
+}
+
+/*
+ * Function: queue_create_with_allocator
+ * --------------------
+ *  Creates a new queue whose memory comes from an allocator.
+ * 
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ * 
+ *  returns: Pointer to the new queue.
+ */
+queue_t* queue_create_with_allocator(const allocator_t* allocator) {
+    allocator_t alloc = allocator_resolve(allocator);
+
+    queue_t* queue = allocator_alloc(&alloc, sizeof(queue_t));
     if (queue == NULL) {
         perror("malloc");
         exit(EXIT_FAILURE);
     }
     queue->head = NULL;
     queue->tail = NULL;
+    queue->n_elements = 0;
+    queue->allocator = alloc;
+    queue->block = NULL;
     return queue;
 }
 
 /*
- * Function: queue_create_from_array
+ * Function: queue_create_fixed
  * --------------------
- *  Creates a new queue from given array.
+ *  Creates a fixed capacity queue backed by a single allocation. It never 
+ *  allocates afterwards, use queue_try_enqueue to get a full error rather 
+ *  than an exit.
  * 
- *  node_array: Array to create queue from.
- *  n_nodes: Number of nodes in array.
+ *  capacity: Maximum number of nodes.
  * 
  *  returns: Pointer to the new queue.
  */
-queue_t* queue_create_from_array(void** node_array, size_t n_nodes) {
-    queue_t* queue = malloc(sizeof(queue_t));
-    if (queue == NULL) {
+queue_t* queue_create_fixed(size_t capacity) {
+    // Queue and node pool in one block
+    char* block = malloc(sizeof(queue_t) + 
+                pool_bytes(sizeof(queue_node_t), capacity));
+    if (block == NULL) {
         perror("malloc");
         exit(EXIT_FAILURE);
     }
+    ALLOCTRACK_NOTE(sizeof(queue_t) + 
+                pool_bytes(sizeof(queue_node_t), capacity));
+    queue_t* queue = (queue_t*)block;
+    pool_t* pool = pool_init(block + sizeof(queue_t), sizeof(queue_node_t),
+                capacity);
+
     queue->head = NULL;
     queue->tail = NULL;
+    queue->n_elements = 0;
+    queue->allocator = pool_allocator(pool);
+    queue->block = block;
+    return queue;
+}
+
+/*
+ * Function: queue_create_from_array
+ * --------------------
+ *  Creates a new queue from given array.
+ * 
+ *  node_array: Array to create queue from.
+ *  n_nodes: Number of nodes in array.
+ * 
+ *  returns: Pointer to the new queue.
+ */
+queue_t* queue_create_from_array(void** node_array, size_t n_nodes) {
+    queue_t* queue = queue_create();
 
     for (size_t i = 0; i < n_nodes; i++) {
         queue_enqueue(queue, node_array[i]);
@@ -57,7 +108,9 @@ queue_t* queue_create_from_array(void** node_array, size_t n_nodes) {
 /*
  * Function: queue_enqueue
  * --------------------
- *  enqueuees a new node to the queue.
+ *  enqueuees a new node to the queue. A fixed capacity queue reports 
+ *  "queue full" and asserts when full, callers that can fill one should 
+ *  use queue_try_enqueue instead.
  * 
  *  queue: Pointer to the queue.
  *  data: Data to insert.
@@ -65,15 +118,41 @@ queue_t* queue_create_from_array(void** node_array, size_t n_nodes) {
  *  returns: Nothing.
  */
 void queue_enqueue(queue_t* queue, void* data) {
+    if (!queue_try_enqueue(queue, data) && queue != NULL) {
+        // A fixed queue never allocates, so it failed for lack of room
+        if (queue->block != NULL) {
+            fprintf(stderr, "queue_enqueue: queue full\n");
+            assert(queue->block == NULL);
+        } else {
+            perror("malloc");
+        }
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * Function: queue_try_enqueue
+ * --------------------
+ *  enqueues a new node to the queue.
+ * 
+ *  queue: Pointer to the queue.
+ *  data: Data to insert.
+ * 
+ *  returns: False if the node could not be allocated, as when a fixed 
+ *           capacity queue is full, true otherwise.
+ */
+bool queue_try_enqueue(queue_t* queue, void* data) {
     if (queue == NULL) {
-        return;
+        return false;
     }
 
-    queue_node_t* node = malloc(sizeof(queue_node_t));
+    queue_node_t* node = allocator_alloc(&queue->allocator, 
+                sizeof(queue_node_t));
     if (node == NULL) {
-        perror("malloc");
-        exit(EXIT_FAILURE);
+        return false;
     }
+    METRICS_COUNT(METRICS_QUEUE, METRICS_INSERTS);
+    METRICS_ALLOC(METRICS_QUEUE, sizeof(queue_node_t));
 
     node->data = data;
     node->next = NULL;
@@ -84,6 +163,9 @@ void queue_enqueue(queue_t* queue, void* data) {
         queue->tail->next = node;
     }
     queue->tail = node;
+    queue->n_elements++;
+    DSL_PROBE2(queue_enqueue, queue, data);
+    return true;
 }
 
 /*
@@ -104,36 +186,21 @@ void* queue_dequeue(queue_t* queue) {
 
     queue_node_t* node = queue->head;
     queue->head = node->next;
+    queue->n_elements--;
 
     void* data = node->data;
-    free(node);
+    allocator_free(&queue->allocator, node, sizeof(queue_node_t));
+    METRICS_COUNT(METRICS_QUEUE, METRICS_REMOVES);
+    METRICS_FREE(METRICS_QUEUE, sizeof(queue_node_t));
 
     if (queue->head == NULL) {
         queue->tail = NULL;
     }
 
+    DSL_PROBE2(queue_dequeue, queue, data);
     return data;
 }
 
-/*
- * Function: queue_peek
- * --------------------
- *  Peeks the top node from the queue.
- * 
- *  queue: Pointer to the queue.
- * 
- *  returns: Pointer to the data of the top node.
- */
-void* queue_peek(queue_t* queue) {
-    if (queue == NULL) {
-        return NULL;
-    } else if (queue->head == NULL) {
-        return NULL;
-    }
-
-    return queue->head->data;
-}
-
 /*
  * Function: queue_dequeue_free
  * --------------------
@@ -154,11 +221,14 @@ void queue_dequeue_free(queue_t* queue, free_queue_t free_data) {
 
     queue_node_t* node = queue->head;
     queue->head = node->next;
+    queue->n_elements--;
 
     if (free_data != NULL) {
         free_data(node->data);
     }
-    free(node);
+    allocator_free(&queue->allocator, node, sizeof(queue_node_t));
+    METRICS_COUNT(METRICS_QUEUE, METRICS_REMOVES);
+    METRICS_FREE(METRICS_QUEUE, sizeof(queue_node_t));
 
     if (queue->head == NULL) {
         queue->tail = NULL;
@@ -166,41 +236,73 @@ void queue_dequeue_free(queue_t* queue, free_queue_t free_data) {
 }
 
 /*
- * Function: queue_is_empty
+ * Function: queue_clean
  * --------------------
- *  Checks if the queue is empty.
+ *  Cleans the queue.
  * 
  *  queue: Pointer to the queue.
+ *  free_data: Function pointer to free the data.
  * 
- *  returns: True if queue is empty, false otherwise.
+ *  returns: Nothing.
  */
-bool queue_is_empty(queue_t* queue) {
+DSL_COLD void queue_clean(queue_t* queue, free_queue_t free_data) {
     if (queue == NULL) {
-        return true;
-    } else if (queue->head == NULL) {
-        return true;
+        return;
+    }
+    const void* owner = &queue->allocator;
+
+    // Bulk allocators free the nodes on reset and fixed capacity nodes go 
+    // with the block
+    bool owns_nodes = !allocator_is_bulk(&queue->allocator) && !queue->block;
+    while (!queue_is_empty(queue) && (owns_nodes || free_data)) {
+        queue_dequeue_free(queue, free_data);
+    }
+
+    if (queue->block) {
+        free(queue->block);
+        return;
+    }
+
+    allocator_free(&queue->allocator, queue, sizeof(queue_t));
+    if (owns_nodes) {
+        ALLOCTRACK_CLEANED(owner);
     }
-    return false;
 }
 
 /*
- * Function: queue_clean
+ * Function: queue_memory_usage
  * --------------------
- *  Cleans the queue.
+ *  Gets the memory queue uses, from its counts rather than by walking it.
+ *  Data is not counted.
  * 
  *  queue: Pointer to the queue.
- *  free_data: Function pointer to free the data.
+ *  usage: Output breakdown.
  * 
- *  returns: Nothing.
+ *  returns: Total bytes.
  */
-void queue_clean(queue_t* queue, free_queue_t free_data) {
+size_t queue_memory_usage(queue_t* queue, memory_usage_t* usage) {
+    if (usage == NULL) {
+        return 0;
+    }
+    memset(usage, 0, sizeof(memory_usage_t));
     if (queue == NULL) {
-        return;
+        return 0;
     }
 
-    while (!queue_is_empty(queue)) {
-        queue_dequeue_free(queue, free_data);
+    // Fixed capacity queues are one block holding the node pool
+    if (queue->block) {
+        pool_t* pool = queue->allocator.ctx;
+        usage->header = sizeof(queue_t);
+        usage->nodes = sizeof(queue_node_t) * queue->n_elements;
+        allocator_account_block(sizeof(queue_t) +
+                    pool_bytes(sizeof(queue_node_t), pool->n_slots), usage);
+        return usage->total;
     }
 
-    free(queue);
-}
\ No newline at end of file
+    allocator_account(&queue->allocator, sizeof(queue_t), 1, &usage->header,
+                usage);
+    allocator_account(&queue->allocator, sizeof(queue_node_t),
+                queue->n_elements, &usage->nodes, usage);
+
+    return usage->total;
+}
@@ -3,6 +3,8 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include "allocator.h"
+#include "hints.h"
 
 typedef void (* free_queue_t)(void*);
 typedef void* (* get_next_t)(void*);
@@ -17,6 +19,11 @@ struct queue_node {
 typedef struct queue {
     queue_node_t* head;
     queue_node_t* tail;
+    size_t n_elements;
+    // Source of the queue and its nodes
+    allocator_t allocator;
+    // Single allocation of a fixed capacity queue, NULL otherwise
+    void* block;
 } queue_t;
 
 /*
@@ -30,6 +37,30 @@ typedef struct queue {
  */
 queue_t* queue_create(void);
 
+/*
+ * Function: queue_create_with_allocator
+ * --------------------
+ *  Creates a new queue whose memory comes from an allocator.
+ * 
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ * 
+ *  returns: Pointer to the new queue.
+ */
+queue_t* queue_create_with_allocator(const allocator_t* allocator);
+
+/*
+ * Function: queue_create_fixed
+ * --------------------
+ *  Creates a fixed capacity queue backed by a single allocation. It never 
+ *  allocates afterwards, use queue_try_enqueue to get a full error rather 
+ *  than an exit.
+ * 
+ *  capacity: Maximum number of nodes.
+ * 
+ *  returns: Pointer to the new queue.
+ */
+queue_t* queue_create_fixed(size_t capacity);
+
 /*
  * Function: queue_create_from_array
  * --------------------
@@ -45,7 +76,9 @@ queue_t* queue_create_from_array(void** node_array, size_t n_nodes);
 /*
  * Function: queue_enqueue
  * --------------------
- *  enqueuees a new node to the queue.
+ *  enqueuees a new node to the queue. A fixed capacity queue reports 
+ *  "queue full" and asserts when full, callers that can fill one should 
+ *  use queue_try_enqueue instead.
  * 
  *  queue: Pointer to the queue.
  *  data: Data to insert.
@@ -54,6 +87,19 @@ queue_t* queue_create_from_array(void** node_array, size_t n_nodes);
  */
 void queue_enqueue(queue_t* queue, void* data);
 
+/*
+ * Function: queue_try_enqueue
+ * --------------------
+ *  enqueues a new node to the queue.
+ * 
+ *  queue: Pointer to the queue.
+ *  data: Data to insert.
+ * 
+ *  returns: False if the node could not be allocated, as when a fixed 
+ *           capacity queue is full, true otherwise.
+ */
+bool queue_try_enqueue(queue_t* queue, void* data);
+
 /*
  * Function: queue_peek
  * --------------------
@@ -63,7 +109,15 @@ void queue_enqueue(queue_t* queue, void* data);
  * 
  *  returns: Pointer to the data of the top node.
  */
-void* queue_peek(queue_t* queue);
+DSL_INLINE void* queue_peek(queue_t* queue) {
+    if (queue == NULL) {
+        return NULL;
+    } else if (queue->head == NULL) {
+        return NULL;
+    }
+
+    return queue->head->data;
+}
 
 /*
  * Function: queue_dequeue
@@ -98,7 +152,14 @@ void queue_dequeue_free(queue_t* queue, free_queue_t free_data);
  * 
  *  returns: True if queue is empty, false otherwise.
  */
-bool queue_is_empty(queue_t* queue);
+DSL_INLINE bool queue_is_empty(queue_t* queue) {
+    if (queue == NULL) {
+        return true;
+    } else if (queue->head == NULL) {
+        return true;
+    }
+    return false;
+}
 
 /*
  * Function: queue_clean
@@ -110,6 +171,19 @@ bool queue_is_empty(queue_t* queue);
  * 
  *  returns: Nothing.
  */
-void queue_clean(queue_t* queue, free_queue_t free_data);
+DSL_COLD void queue_clean(queue_t* queue, free_queue_t free_data);
+
+/*
+ * Function: queue_memory_usage
+ * --------------------
+ *  Gets the memory queue uses, from its counts rather than by walking it.
+ *  Data is not counted.
+ * 
+ *  queue: Pointer to the queue.
+ *  usage: Output breakdown.
+ * 
+ *  returns: Total bytes.
+ */
+size_t queue_memory_usage(queue_t* queue, memory_usage_t* usage);
 
 #endif
\ No newline at end of file
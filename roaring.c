@@ -0,0 +1,1983 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a custom compressed bitmap library after Roaring, a
+         set of 32 bit values such as dense ids. Values are split by their
+         high 16 bits into containers of up to 65536 values, each held as a
+         sorted array while it has at most 4096 values, a 8KB bitset past
+         that, or sorted runs where those are smaller. Sparse sets cost about
+         2 bytes a value and dense ones 1 bit. Bitset containers are combined
+         a register at a time with GCC vector extensions, compiled to SSE2,
+         AVX2 or NEON by the target flags, and fall back to scalar loops
+         elsewhere or with DSL_NO_SIMD. Bitmaps serialize to the Roaring
+         portable format, so other Roaring implementations can read them.
+*/
+
+#include "roaring.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "alloctrack.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(DSL_NO_SIMD)
+#define ROARING_HAVE_SIMD
+#if defined(__AVX2__)
+#define ROARING_SIMD_BYTES 32
+#else
+#define ROARING_SIMD_BYTES 16
+#endif
+#define ROARING_LANES (ROARING_SIMD_BYTES / sizeof(uint64_t))
+
+typedef uint64_t _roaring_v_words
+            __attribute__((vector_size(ROARING_SIMD_BYTES)));
+#endif
+
+// Portable format cookies, with and without run containers
+#define ROARING_COOKIE_NO_RUNS 12346
+#define ROARING_COOKIE_RUNS 12347
+// Bitmaps with runs and fewer containers leave out the offset header
+#define ROARING_NO_OFFSET_THRESHOLD 4
+#define ROARING_BITSET_BYTES (ROARING_BITSET_WORDS * sizeof(uint64_t))
+// Most runs a container can need, every other value set
+#define ROARING_RUNS_MAX (ROARING_CHUNK_BITS / 2)
+
+/*
+ * Bytes a container takes in the portable format as runs.
+ */
+static inline size_t _roaring_run_bytes(size_t n_runs) {
+    return sizeof(uint16_t) + n_runs * sizeof(roaring_run_t);
+}
+
+/*
+ * Bytes a container takes in the portable format as an array or bitset.
+ */
+static inline size_t _roaring_plain_bytes(size_t cardinality) {
+    return cardinality <= ROARING_ARRAY_MAX ?
+                cardinality * sizeof(uint16_t) : ROARING_BITSET_BYTES;
+}
+
+/*
+ * Counts the set bits of a full bitset.
+ */
+static inline uint32_t _roaring_popcount(const uint64_t* words) {
+    uint32_t count = 0;
+    for (size_t i = 0; i < ROARING_BITSET_WORDS; i++) {
+        count += (uint32_t)__builtin_popcountll(words[i]);
+    }
+    return count;
+}
+
+/*
+ * Sets the bits of [start, end) in a full bitset.
+ */
+static inline void _roaring_set_range(uint64_t* words, uint32_t start,
+                uint32_t end) {
+    if (start >= end) {
+        return;
+    }
+    size_t first = start / 64, last = (end - 1) / 64;
+    uint64_t head = ~0ULL << (start % 64);
+    uint64_t tail = ~0ULL >> (63 - (end - 1) % 64);
+
+    if (first == last) {
+        words[first] |= head & tail;
+        return;
+    }
+    words[first] |= head;
+    for (size_t i = first + 1; i < last; i++) {
+        words[i] = ~0ULL;
+    }
+    words[last] |= tail;
+}
+
+/*
+ * Binary searches a sorted array of low bits.
+ *
+ * returns: Index of low, or -(insertion index) - 1 if absent.
+ */
+static inline ptrdiff_t _roaring_search16(const uint16_t* values, size_t n,
+                uint16_t low) {
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (values[mid] < low) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < n && values[lo] == low) {
+        return (ptrdiff_t)lo;
+    }
+    return -(ptrdiff_t)lo - 1;
+}
+
+/*
+ * Finds the last run starting at or before low.
+ *
+ * returns: Index of the run, -1 if every run starts after low.
+ */
+static inline ptrdiff_t _roaring_search_runs(const roaring_run_t* runs,
+                size_t n, uint16_t low) {
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (runs[mid].start <= low) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (ptrdiff_t)lo - 1;
+}
+
+/*
+ * Merges two sorted arrays of low bits by an operation.
+ *
+ * returns: Number of values written to out.
+ */
+static uint32_t _roaring_merge(const uint16_t* a, size_t na,
+                const uint16_t* b, size_t nb, uint16_t* out,
+                roaring_op_t op) {
+    bool keep_a = op != ROARING_AND;
+    bool keep_b = op == ROARING_OR || op == ROARING_XOR;
+    bool keep_both = op == ROARING_AND || op == ROARING_OR;
+    size_t i = 0, j = 0;
+    uint32_t n = 0;
+
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            if (keep_a) {
+                out[n++] = a[i];
+            }
+            i++;
+        } else if (a[i] > b[j]) {
+            if (keep_b) {
+                out[n++] = b[j];
+            }
+            j++;
+        } else {
+            if (keep_both) {
+                out[n++] = a[i];
+            }
+            i++;
+            j++;
+        }
+    }
+    for (; keep_a && i < na; i++) {
+        out[n++] = a[i];
+    }
+    for (; keep_b && j < nb; j++) {
+        out[n++] = b[j];
+    }
+
+    return n;
+}
+
+/*
+ * Combines two full bitsets word by word into out, which may be either of
+ * them.
+ *
+ * returns: Number of bits set in out.
+ */
+static uint32_t _roaring_words_op(uint64_t* out, const uint64_t* a,
+                const uint64_t* b, roaring_op_t op) {
+    uint32_t count = 0;
+
+#ifdef ROARING_HAVE_SIMD
+    // One register per step, the popcount of its lanes folded in while the
+    // result is still in registers
+#define ROARING_WORDS_LOOP(expr) \
+    for (size_t i = 0; i < ROARING_BITSET_WORDS; i += ROARING_LANES) { \
+        _roaring_v_words x, y; \
+        uint64_t lanes[ROARING_LANES]; \
+        memcpy(&x, a + i, sizeof(x)); \
+        memcpy(&y, b + i, sizeof(y)); \
+        x = (expr); \
+        memcpy(out + i, &x, sizeof(x)); \
+        memcpy(lanes, &x, sizeof(x)); \
+        for (size_t l = 0; l < ROARING_LANES; l++) { \
+            count += (uint32_t)__builtin_popcountll(lanes[l]); \
+        } \
+    }
+#else
+#define ROARING_WORDS_LOOP(expr) \
+    for (size_t i = 0; i < ROARING_BITSET_WORDS; i++) { \
+        uint64_t x = a[i], y = b[i]; \
+        out[i] = (expr); \
+        count += (uint32_t)__builtin_popcountll(out[i]); \
+    }
+#endif
+
+    switch (op) {
+        case ROARING_AND:
+            ROARING_WORDS_LOOP(x & y)
+            break;
+        case ROARING_OR:
+            ROARING_WORDS_LOOP(x | y)
+            break;
+        case ROARING_XOR:
+            ROARING_WORDS_LOOP(x ^ y)
+            break;
+        case ROARING_ANDNOT:
+            ROARING_WORDS_LOOP(x & ~y)
+            break;
+    }
+#undef ROARING_WORDS_LOOP
+
+    return count;
+}
+
+/*
+ * Writes little endian integers whatever the host order.
+ */
+static inline uint8_t* _roaring_put16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static inline uint8_t* _roaring_put32(uint8_t* p, uint32_t v) {
+    p = _roaring_put16(p, (uint16_t)v);
+    return _roaring_put16(p, (uint16_t)(v >> 16));
+}
+
+static inline uint8_t* _roaring_put64(uint8_t* p, uint64_t v) {
+    p = _roaring_put32(p, (uint32_t)v);
+    return _roaring_put32(p, (uint32_t)(v >> 32));
+}
+
+/*
+ * Reads little endian integers whatever the host order.
+ */
+static inline uint16_t _roaring_get16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t _roaring_get32(const uint8_t* p) {
+    return _roaring_get16(p) | ((uint32_t)_roaring_get16(p + 2) << 16);
+}
+
+static inline uint64_t _roaring_get64(const uint8_t* p) {
+    return _roaring_get32(p) | ((uint64_t)_roaring_get32(p + 4) << 32);
+}
+
+/*
+ * Loads the first word of a container into an iterator.
+ */
+static inline void _roaring_iter_load(roaring_iter_t* iter) {
+    iter->index = 0;
+    iter->offset = 0;
+    iter->word = 0;
+    if (iter->container < iter->r->n_containers) {
+        const roaring_container_t* c = &iter->r->containers[iter->container];
+        if (c->type == ROARING_BITSET) {
+            iter->word = c->words[0];
+        }
+    }
+}
+
+/**** PUBLIC ****/
+
+/*
+ * Function: roaring_create
+ * --------------------
+ *  Creates a new empty bitmap.
+ *
+ *  No parameters.
+ *
+ *  returns: Pointer to the new bitmap.
+ */
+roaring_t* roaring_create(void) {
+    return roaring_create_with_allocator(NULL);
+}
+
+/*
+ * Function: roaring_create_with_allocator
+ * --------------------
+ *  Creates a new empty bitmap whose memory comes from an allocator.
+ *
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new bitmap.
+ */
+roaring_t* roaring_create_with_allocator(const allocator_t* allocator) {
+    allocator_t alloc = allocator_resolve(allocator);
+
+    roaring_t* r = allocator_alloc(&alloc, sizeof(roaring_t));
+    assert(r);
+
+    // Empty bitmaps, as most frontiers start, allocate nothing more
+    r->keys = NULL;
+    r->containers = NULL;
+    r->n_containers = 0;
+    r->capacity = 0;
+    r->cardinality = 0;
+    r->allocator = alloc;
+
+    return r;
+}
+
+/*
+ * Function: roaring_copy
+ * --------------------
+ *  Creates a copy of a bitmap from the same allocator.
+ *
+ *  r: Pointer to the bitmap.
+ *
+ *  returns: Pointer to the copy.
+ */
+roaring_t* roaring_copy(const roaring_t* r) {
+    assert(r);
+    roaring_t* copy = roaring_create_with_allocator(&r->allocator);
+
+    _roaring_reserve(copy, r->n_containers);
+    for (size_t i = 0; i < r->n_containers; i++) {
+        copy->keys[i] = r->keys[i];
+        _roaring_copy_container(copy, &copy->containers[i],
+                    &r->containers[i]);
+    }
+    copy->n_containers = r->n_containers;
+    copy->cardinality = r->cardinality;
+
+    return copy;
+}
+
+/*
+ * Function: roaring_add
+ * --------------------
+ *  Adds a value. Doubles as a test and set for visited sets.
+ *
+ *  r: Pointer to the bitmap.
+ *  value: Value to add.
+ *
+ *  returns: True if the value was added, false if present.
+ */
+bool roaring_add(roaring_t* r, uint32_t value) {
+    assert(r);
+    uint16_t key = (uint16_t)(value >> 16);
+    roaring_container_t* c;
+
+    ptrdiff_t index = _roaring_find(r, key);
+    if (index < 0) {
+        c = _roaring_insert_at(r, (size_t)(-index - 1), key);
+    } else {
+        c = &r->containers[index];
+    }
+
+    if (!_roaring_container_add(r, c, (uint16_t)value)) {
+        return false;
+    }
+    r->cardinality++;
+    return true;
+}
+
+/*
+ * Function: roaring_add_range
+ * --------------------
+ *  Adds every value in [low, high). Whole containers become single runs.
+ *
+ *  r: Pointer to the bitmap.
+ *  low: Inclusive lower bound.
+ *  high: Exclusive upper bound, up to 2^32.
+ *
+ *  returns: Number of values added.
+ */
+uint64_t roaring_add_range(roaring_t* r, uint64_t low, uint64_t high) {
+    assert(r);
+    assert(low <= high && high <= ((uint64_t)1 << 32));
+    uint64_t n_added = 0;
+
+    if (low == high) {
+        return 0;
+    }
+
+    for (uint64_t key = low >> 16; key <= (high - 1) >> 16; key++) {
+        uint32_t start = key == low >> 16 ? (uint32_t)(low & 0xFFFF) : 0;
+        uint32_t end = key == (high - 1) >> 16 ?
+                    (uint32_t)((high - 1) & 0xFFFF) + 1 : ROARING_CHUNK_BITS;
+        roaring_container_t* c;
+
+        ptrdiff_t index = _roaring_find(r, (uint16_t)key);
+        if (index < 0) {
+            // A fresh container is the range itself, one run
+            c = _roaring_insert_at(r, (size_t)(-index - 1), (uint16_t)key);
+            _roaring_alloc_container(r, c, ROARING_RUN, 1);
+            c->runs[0].start = (uint16_t)start;
+            c->runs[0].length = (uint16_t)(end - start - 1);
+            c->n = 1;
+            c->cardinality = end - start;
+            _roaring_fit(r, c);
+            n_added += end - start;
+            continue;
+        }
+
+        c = &r->containers[index];
+        uint32_t before = c->cardinality;
+        uint64_t words[ROARING_BITSET_WORDS];
+        _roaring_to_words(c, words);
+        _roaring_set_range(words, start, end);
+        uint32_t cardinality = _roaring_popcount(words);
+        if (cardinality == before) {
+            continue;
+        }
+
+        _roaring_from_words(r, c, words, cardinality);
+        uint32_t n_runs = _roaring_count_runs(c);
+        if (_roaring_run_bytes(n_runs) < _roaring_plain_bytes(cardinality)) {
+            _roaring_to_runs(r, c, n_runs);
+        }
+        n_added += cardinality - before;
+    }
+
+    r->cardinality += n_added;
+    return n_added;
+}
+
+/*
+ * Function: roaring_remove
+ * --------------------
+ *  Removes a value.
+ *
+ *  r: Pointer to the bitmap.
+ *  value: Value to remove.
+ *
+ *  returns: True if the value was removed, false if not found.
+ */
+bool roaring_remove(roaring_t* r, uint32_t value) {
+    assert(r);
+
+    ptrdiff_t index = _roaring_find(r, (uint16_t)(value >> 16));
+    if (index < 0) {
+        return false;
+    }
+
+    roaring_container_t* c = &r->containers[index];
+    if (!_roaring_container_remove(r, c, (uint16_t)value)) {
+        return false;
+    }
+    if (c->cardinality == 0) {
+        _roaring_remove_at(r, (size_t)index);
+    }
+    r->cardinality--;
+    return true;
+}
+
+/*
+ * Function: roaring_contains
+ * --------------------
+ *  Checks if a value is in the bitmap.
+ *
+ *  r: Pointer to the bitmap.
+ *  value: Value to check for.
+ *
+ *  returns: True if found, false otherwise.
+ */
+bool roaring_contains(const roaring_t* r, uint32_t value) {
+    assert(r);
+
+    ptrdiff_t index = _roaring_find(r, (uint16_t)(value >> 16));
+    if (index < 0) {
+        return false;
+    }
+    return _roaring_container_contains(&r->containers[index],
+                (uint16_t)value);
+}
+
+/*
+ * Function: roaring_rank
+ * --------------------
+ *  Counts the values not greater than a value.
+ *
+ *  r: Pointer to the bitmap.
+ *  value: Value to rank.
+ *
+ *  returns: Number of values <= value.
+ */
+uint64_t roaring_rank(const roaring_t* r, uint32_t value) {
+    assert(r);
+    uint16_t key = (uint16_t)(value >> 16);
+    uint64_t rank = 0;
+
+    for (size_t i = 0; i < r->n_containers && r->keys[i] <= key; i++) {
+        if (r->keys[i] < key) {
+            rank += r->containers[i].cardinality;
+        } else {
+            rank += _roaring_container_rank(&r->containers[i],
+                        (uint16_t)value);
+        }
+    }
+
+    return rank;
+}
+
+/*
+ * Function: roaring_select
+ * --------------------
+ *  Gets the value of a rank, the inverse of roaring_rank.
+ *
+ *  r: Pointer to the bitmap.
+ *  rank: Number of smaller values, 0 for the minimum.
+ *  value: Output value.
+ *
+ *  returns: True if found, false if rank is not below the cardinality.
+ */
+bool roaring_select(const roaring_t* r, uint64_t rank, uint32_t* value) {
+    assert(r);
+    assert(value);
+
+    for (size_t i = 0; i < r->n_containers; i++) {
+        const roaring_container_t* c = &r->containers[i];
+        if (rank < c->cardinality) {
+            *value = ((uint32_t)r->keys[i] << 16) |
+                        _roaring_container_select(c, (uint32_t)rank);
+            return true;
+        }
+        rank -= c->cardinality;
+    }
+
+    return false;
+}
+
+/*
+ * Function: roaring_and
+ * --------------------
+ *  Creates the intersection of two bitmaps, from a's allocator.
+ *
+ *  a: Pointer to the first bitmap.
+ *  b: Pointer to the second bitmap.
+ *
+ *  returns: Pointer to the new bitmap.
+ */
+roaring_t* roaring_and(const roaring_t* a, const roaring_t* b) {
+    assert(a && b);
+    roaring_t* r = roaring_create_with_allocator(&a->allocator);
+    _roaring_op(r, a, b, ROARING_AND);
+    return r;
+}
+
+/*
+ * Function: roaring_or
+ * --------------------
+ *  Creates the union of two bitmaps, from a's allocator.
+ *
+ *  a: Pointer to the first bitmap.
+ *  b: Pointer to the second bitmap.
+ *
+ *  returns: Pointer to the new bitmap.
+ */
+roaring_t* roaring_or(const roaring_t* a, const roaring_t* b) {
+    assert(a && b);
+    roaring_t* r = roaring_create_with_allocator(&a->allocator);
+    _roaring_op(r, a, b, ROARING_OR);
+    return r;
+}
+
+/*
+ * Function: roaring_xor
+ * --------------------
+ *  Creates the symmetric difference of two bitmaps, from a's allocator.
+ *
+ *  a: Pointer to the first bitmap.
+ *  b: Pointer to the second bitmap.
+ *
+ *  returns: Pointer to the new bitmap.
+ */
+roaring_t* roaring_xor(const roaring_t* a, const roaring_t* b) {
+    assert(a && b);
+    roaring_t* r = roaring_create_with_allocator(&a->allocator);
+    _roaring_op(r, a, b, ROARING_XOR);
+    return r;
+}
+
+/*
+ * Function: roaring_andnot
+ * --------------------
+ *  Creates the values of a not in b, from a's allocator.
+ *
+ *  a: Pointer to the first bitmap.
+ *  b: Pointer to the second bitmap.
+ *
+ *  returns: Pointer to the new bitmap.
+ */
+roaring_t* roaring_andnot(const roaring_t* a, const roaring_t* b) {
+    assert(a && b);
+    roaring_t* r = roaring_create_with_allocator(&a->allocator);
+    _roaring_op(r, a, b, ROARING_ANDNOT);
+    return r;
+}
+
+/*
+ * Function: roaring_and_inplace
+ * --------------------
+ *  Intersects a with b. Containers only a has are dropped without being
+ *  read.
+ *
+ *  a: Pointer to the bitmap to update.
+ *  b: Pointer to the other bitmap.
+ *
+ *  returns: Nothing.
+ */
+void roaring_and_inplace(roaring_t* a, const roaring_t* b) {
+    assert(a && b);
+    _roaring_op(a, a, b, ROARING_AND);
+}
+
+/*
+ * Function: roaring_or_inplace
+ * --------------------
+ *  Adds the values of b to a. Containers only a has are left untouched and
+ *  bitset containers of a are updated in place, so growing a visited set
+ *  by a frontier costs the frontier, not the visited set.
+ *
+ *  a: Pointer to the bitmap to update.
+ *  b: Pointer to the other bitmap.
+ *
+ *  returns: Nothing.
+ */
+void roaring_or_inplace(roaring_t* a, const roaring_t* b) {
+    assert(a && b);
+    _roaring_op(a, a, b, ROARING_OR);
+}
+
+/*
+ * Function: roaring_xor_inplace
+ * --------------------
+ *  Toggles the values of b in a.
+ *
+ *  a: Pointer to the bitmap to update.
+ *  b: Pointer to the other bitmap.
+ *
+ *  returns: Nothing.
+ */
+void roaring_xor_inplace(roaring_t* a, const roaring_t* b) {
+    assert(a && b);
+    _roaring_op(a, a, b, ROARING_XOR);
+}
+
+/*
+ * Function: roaring_andnot_inplace
+ * --------------------
+ *  Removes the values of b from a.
+ *
+ *  a: Pointer to the bitmap to update.
+ *  b: Pointer to the other bitmap.
+ *
+ *  returns: Nothing.
+ */
+void roaring_andnot_inplace(roaring_t* a, const roaring_t* b) {
+    assert(a && b);
+    _roaring_op(a, a, b, ROARING_ANDNOT);
+}
+
+/*
+ * Function: roaring_optimize
+ * --------------------
+ *  Stores each container as runs where that is smaller than an array or a
+ *  bitset, for long stretches of consecutive values before serializing or
+ *  keeping a bitmap around.
+ *
+ *  r: Pointer to the bitmap.
+ *
+ *  returns: True if any container is stored as runs.
+ */
+bool roaring_optimize(roaring_t* r) {
+    assert(r);
+    bool has_runs = false;
+
+    for (size_t i = 0; i < r->n_containers; i++) {
+        roaring_container_t* c = &r->containers[i];
+        if (c->type != ROARING_RUN) {
+            uint32_t n_runs = _roaring_count_runs(c);
+            if (_roaring_run_bytes(n_runs) <
+                        _roaring_plain_bytes(c->cardinality)) {
+                _roaring_to_runs(r, c, n_runs);
+            }
+        }
+        has_runs |= c->type == ROARING_RUN;
+    }
+
+    return has_runs;
+}
+
+/*
+ * Function: roaring_iter_init
+ * --------------------
+ *  Starts an ascending scan of the values.
+ *
+ *  r: Pointer to the bitmap.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void roaring_iter_init(const roaring_t* r, roaring_iter_t* iter) {
+    assert(r);
+    assert(iter);
+
+    iter->r = r;
+    iter->container = 0;
+    _roaring_iter_load(iter);
+}
+
+/*
+ * Function: roaring_iter_next
+ * --------------------
+ *  Gets the next value of a scan.
+ *
+ *  iter: Pointer to the iterator.
+ *  value: Output value.
+ *
+ *  returns: True if a value was produced, false at the end of the scan.
+ */
+bool roaring_iter_next(roaring_iter_t* iter, uint32_t* value) {
+    assert(iter);
+    assert(value);
+    const roaring_t* r = iter->r;
+
+    while (iter->container < r->n_containers) {
+        const roaring_container_t* c = &r->containers[iter->container];
+        uint32_t high = (uint32_t)r->keys[iter->container] << 16;
+
+        switch (c->type) {
+            case ROARING_ARRAY:
+                if (iter->index < c->n) {
+                    *value = high | c->values[iter->index++];
+                    return true;
+                }
+                break;
+            case ROARING_BITSET:
+                while (!iter->word &&
+                            ++iter->index < ROARING_BITSET_WORDS) {
+                    iter->word = c->words[iter->index];
+                }
+                if (iter->word) {
+                    uint32_t bit = (uint32_t)__builtin_ctzll(iter->word);
+                    iter->word &= iter->word - 1;
+                    *value = high | (iter->index * 64 + bit);
+                    return true;
+                }
+                break;
+            case ROARING_RUN:
+                if (iter->index < c->n) {
+                    const roaring_run_t* run = &c->runs[iter->index];
+                    *value = high | (run->start + iter->offset);
+                    if (iter->offset++ == run->length) {
+                        iter->index++;
+                        iter->offset = 0;
+                    }
+                    return true;
+                }
+                break;
+        }
+
+        iter->container++;
+        _roaring_iter_load(iter);
+    }
+
+    return false;
+}
+
+/*
+ * Function: roaring_to_array
+ * --------------------
+ *  Copies the values in ascending order to an array.
+ *
+ *  r: Pointer to the bitmap.
+ *  out: Array of roaring_cardinality(r) values.
+ *
+ *  returns: Number of values written.
+ */
+size_t roaring_to_array(const roaring_t* r, uint32_t* out) {
+    assert(r);
+    assert(out || !r->cardinality);
+    size_t n = 0;
+
+    for (size_t i = 0; i < r->n_containers; i++) {
+        const roaring_container_t* c = &r->containers[i];
+        uint32_t high = (uint32_t)r->keys[i] << 16;
+
+        if (c->type == ROARING_ARRAY) {
+            for (uint32_t j = 0; j < c->n; j++) {
+                out[n++] = high | c->values[j];
+            }
+        } else if (c->type == ROARING_BITSET) {
+            for (uint32_t w = 0; w < ROARING_BITSET_WORDS; w++) {
+                for (uint64_t word = c->words[w]; word; word &= word - 1) {
+                    out[n++] = high | (w * 64 +
+                                (uint32_t)__builtin_ctzll(word));
+                }
+            }
+        } else {
+            for (uint32_t j = 0; j < c->n; j++) {
+                uint32_t start = high | c->runs[j].start;
+                for (uint32_t k = 0; k <= c->runs[j].length; k++) {
+                    out[n++] = start + k;
+                }
+            }
+        }
+    }
+
+    return n;
+}
+
+/*
+ * Function: roaring_clear
+ * --------------------
+ *  Removes every value, keeping the bitmap for reuse.
+ *
+ *  r: Pointer to the bitmap.
+ *
+ *  returns: Nothing.
+ */
+void roaring_clear(roaring_t* r) {
+    assert(r);
+
+    for (size_t i = 0; i < r->n_containers; i++) {
+        _roaring_free_container(r, &r->containers[i]);
+    }
+    r->n_containers = 0;
+    r->cardinality = 0;
+}
+
+/*
+ * Function: roaring_swap
+ * --------------------
+ *  Swaps the contents of two bitmaps without copying, as when the next
+ *  frontier becomes the current one.
+ *
+ *  a: Pointer to the first bitmap.
+ *  b: Pointer to the second bitmap.
+ *
+ *  returns: Nothing.
+ */
+void roaring_swap(roaring_t* a, roaring_t* b) {
+    assert(a && b);
+
+    roaring_t tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+/*
+ * Function: roaring_serialized_size
+ * --------------------
+ *  Gets the bytes roaring_serialize writes.
+ *
+ *  r: Pointer to the bitmap.
+ *
+ *  returns: Size in bytes.
+ */
+size_t roaring_serialized_size(const roaring_t* r) {
+    assert(r);
+    size_t n = r->n_containers, data = 0;
+    bool has_runs = false;
+
+    for (size_t i = 0; i < n; i++) {
+        const roaring_container_t* c = &r->containers[i];
+        if (c->type == ROARING_RUN) {
+            has_runs = true;
+            data += _roaring_run_bytes(c->n);
+        } else {
+            data += _roaring_plain_bytes(c->cardinality);
+        }
+    }
+
+    // Cookie and count, or cookie with the count and a run flag per
+    // container, then a key and cardinality per container
+    size_t size = has_runs ? 4 + (n + 7) / 8 : 8;
+    size += n * 4;
+    if (!has_runs || n >= ROARING_NO_OFFSET_THRESHOLD) {
+        size += n * 4;
+    }
+
+    return size + data;
+}
+
+/*
+ * Function: roaring_serialize
+ * --------------------
+ *  Writes a bitmap in the Roaring portable format, little endian whatever
+ *  the host, readable by the other Roaring implementations.
+ *
+ *  r: Pointer to the bitmap.
+ *  buf: Output buffer of roaring_serialized_size(r) bytes.
+ *
+ *  returns: Bytes written.
+ */
+size_t roaring_serialize(const roaring_t* r, void* buf) {
+    assert(r);
+    assert(buf);
+    size_t n = r->n_containers;
+    uint8_t* start = buf;
+    uint8_t* p = start;
+    bool has_runs = false;
+
+    for (size_t i = 0; i < n; i++) {
+        has_runs |= r->containers[i].type == ROARING_RUN;
+    }
+
+    if (has_runs) {
+        p = _roaring_put32(p, ROARING_COOKIE_RUNS |
+                    ((uint32_t)(n - 1) << 16));
+        memset(p, 0, (n + 7) / 8);
+        for (size_t i = 0; i < n; i++) {
+            if (r->containers[i].type == ROARING_RUN) {
+                p[i / 8] |= (uint8_t)(1 << (i % 8));
+            }
+        }
+        p += (n + 7) / 8;
+    } else {
+        p = _roaring_put32(p, ROARING_COOKIE_NO_RUNS);
+        p = _roaring_put32(p, (uint32_t)n);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        p = _roaring_put16(p, r->keys[i]);
+        p = _roaring_put16(p,
+                    (uint16_t)(r->containers[i].cardinality - 1));
+    }
+
+    // Offsets from the start of the bitmap to each container
+    if (!has_runs || n >= ROARING_NO_OFFSET_THRESHOLD) {
+        size_t offset = (size_t)(p - start) + n * 4;
+        for (size_t i = 0; i < n; i++) {
+            const roaring_container_t* c = &r->containers[i];
+            p = _roaring_put32(p, (uint32_t)offset);
+            offset += c->type == ROARING_RUN ? _roaring_run_bytes(c->n) :
+                        _roaring_plain_bytes(c->cardinality);
+        }
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        const roaring_container_t* c = &r->containers[i];
+        if (c->type == ROARING_ARRAY) {
+            for (uint32_t j = 0; j < c->n; j++) {
+                p = _roaring_put16(p, c->values[j]);
+            }
+        } else if (c->type == ROARING_BITSET) {
+            for (size_t w = 0; w < ROARING_BITSET_WORDS; w++) {
+                p = _roaring_put64(p, c->words[w]);
+            }
+        } else {
+            p = _roaring_put16(p, (uint16_t)c->n);
+            for (uint32_t j = 0; j < c->n; j++) {
+                p = _roaring_put16(p, c->runs[j].start);
+                p = _roaring_put16(p, c->runs[j].length);
+            }
+        }
+    }
+
+    return (size_t)(p - start);
+}
+
+/*
+ * Function: roaring_deserialize
+ * --------------------
+ *  Reads a bitmap in the Roaring portable format. The input is checked,
+ *  so it may come from outside the process.
+ *
+ *  buf: Serialized bitmap.
+ *  len: Bytes available in buf.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new bitmap, NULL if buf is not a valid bitmap.
+ */
+roaring_t* roaring_deserialize(const void* buf, size_t len,
+                const allocator_t* allocator) {
+    assert(buf || !len);
+    const uint8_t* p = buf;
+    const uint8_t* end = p + len;
+    const uint8_t* run_flags = NULL;
+    size_t n;
+
+    if (len < 4) {
+        return NULL;
+    }
+    uint32_t cookie = _roaring_get32(p);
+    if ((cookie & 0xFFFF) == ROARING_COOKIE_RUNS) {
+        n = (cookie >> 16) + 1;
+        if (len < 4 + (n + 7) / 8) {
+            return NULL;
+        }
+        run_flags = p + 4;
+        p += 4 + (n + 7) / 8;
+    } else if (cookie == ROARING_COOKIE_NO_RUNS && len >= 8) {
+        n = _roaring_get32(p + 4);
+        p += 8;
+    } else {
+        return NULL;
+    }
+    if (n > ROARING_CHUNK_BITS || (size_t)(end - p) < n * 4) {
+        return NULL;
+    }
+
+    const uint8_t* header = p;
+    p += n * 4;
+    if (!run_flags || n >= ROARING_NO_OFFSET_THRESHOLD) {
+        // Containers are read in order, the offsets are only skipped
+        if ((size_t)(end - p) < n * 4) {
+            return NULL;
+        }
+        p += n * 4;
+    }
+
+    roaring_t* r = roaring_create_with_allocator(allocator);
+    _roaring_reserve(r, n);
+
+    for (size_t i = 0; i < n; i++) {
+        uint16_t key = _roaring_get16(header + i * 4);
+        uint32_t cardinality = (uint32_t)_roaring_get16(header + i * 4 + 2) + 1;
+        bool is_run = run_flags && (run_flags[i / 8] >> (i % 8)) & 1;
+        roaring_container_t* c = &r->containers[i];
+        // Keys must ascend
+        bool valid = i == 0 || key > r->keys[i - 1];
+
+        memset(c, 0, sizeof(roaring_container_t));
+        if (valid && is_run) {
+            uint32_t n_runs = 0, total = 0, next = 0;
+            if ((size_t)(end - p) >= 2) {
+                n_runs = _roaring_get16(p);
+                p += 2;
+            }
+            valid = n_runs && n_runs <= ROARING_RUNS_MAX &&
+                        (size_t)(end - p) >= (size_t)n_runs * 4;
+            if (valid) {
+                _roaring_alloc_container(r, c, ROARING_RUN, n_runs);
+            }
+            for (uint32_t j = 0; valid && j < n_runs; j++, p += 4) {
+                c->runs[j].start = _roaring_get16(p);
+                c->runs[j].length = _roaring_get16(p + 2);
+                // Runs ascend, stay in the chunk and never touch
+                valid = c->runs[j].start >= next &&
+                            (uint32_t)c->runs[j].start + c->runs[j].length <
+                            ROARING_CHUNK_BITS;
+                next = (uint32_t)c->runs[j].start + c->runs[j].length + 2;
+                total += c->runs[j].length + 1u;
+            }
+            c->n = valid ? n_runs : 0;
+            valid = valid && total == cardinality;
+        } else if (valid && cardinality <= ROARING_ARRAY_MAX) {
+            valid = (size_t)(end - p) >= (size_t)cardinality * 2;
+            if (valid) {
+                _roaring_alloc_container(r, c, ROARING_ARRAY, cardinality);
+                for (uint32_t j = 0; valid && j < cardinality; j++, p += 2) {
+                    c->values[j] = _roaring_get16(p);
+                    valid = j == 0 || c->values[j] > c->values[j - 1];
+                }
+                c->n = cardinality;
+            }
+        } else if (valid) {
+            valid = (size_t)(end - p) >= ROARING_BITSET_BYTES;
+            if (valid) {
+                _roaring_alloc_container(r, c, ROARING_BITSET, 0);
+                for (size_t w = 0; w < ROARING_BITSET_WORDS; w++, p += 8) {
+                    c->words[w] = _roaring_get64(p);
+                }
+                valid = _roaring_popcount(c->words) == cardinality;
+            }
+        }
+
+        r->keys[i] = key;
+        c->cardinality = cardinality;
+        r->n_containers = i + 1;
+        if (!valid) {
+            roaring_clean(r);
+            return NULL;
+        }
+        // Runs from other writers need not be the smallest layout
+        _roaring_fit(r, c);
+        r->cardinality += cardinality;
+    }
+
+    return r;
+}
+
+/*
+ * Function: roaring_clean
+ * --------------------
+ *  Frees the bitmap.
+ *
+ *  r: Pointer to the bitmap.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void roaring_clean(roaring_t* r) {
+    assert(r);
+    allocator_t allocator = r->allocator;
+    const void* owner = &r->allocator;
+
+    if (!allocator_is_bulk(&allocator)) {
+        roaring_clear(r);
+        if (r->capacity) {
+            allocator_free(&r->allocator, r->keys,
+                        sizeof(uint16_t) * r->capacity);
+            allocator_free(&r->allocator, r->containers,
+                        sizeof(roaring_container_t) * r->capacity);
+        }
+    }
+    allocator_free(&allocator, r, sizeof(roaring_t));
+    if (!allocator_is_bulk(&allocator)) {
+        ALLOCTRACK_CLEANED(owner);
+    }
+}
+
+/*
+ * Function: roaring_memory_usage
+ * --------------------
+ *  Gets the memory r uses. The key and container arrays are buckets,
+ *  container values, words and runs are nodes.
+ *
+ *  r: Pointer to the bitmap.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t roaring_memory_usage(const roaring_t* r, memory_usage_t* usage) {
+    assert(r);
+    assert(usage);
+    memset(usage, 0, sizeof(memory_usage_t));
+
+    allocator_account(&r->allocator, sizeof(roaring_t), 1, &usage->header,
+                usage);
+    if (r->capacity) {
+        allocator_account(&r->allocator, sizeof(uint16_t) * r->capacity, 1,
+                    &usage->buckets, usage);
+        allocator_account(&r->allocator,
+                    sizeof(roaring_container_t) * r->capacity, 1,
+                    &usage->buckets, usage);
+    }
+    for (size_t i = 0; i < r->n_containers; i++) {
+        const roaring_container_t* c = &r->containers[i];
+        size_t size = c->type == ROARING_BITSET ? ROARING_BITSET_BYTES :
+                    c->type == ROARING_ARRAY ? sizeof(uint16_t) * c->capacity :
+                    sizeof(roaring_run_t) * c->capacity;
+        allocator_account(&r->allocator, size, 1, &usage->nodes, usage);
+    }
+
+    return usage->total;
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _roaring_find
+ * --------------------
+ *  Binary searches the container keys.
+ *
+ *  returns: Index of key, or -(insertion index) - 1 if absent.
+ */
+ptrdiff_t _roaring_find(const roaring_t* r, uint16_t key) {
+    size_t n = r->n_containers;
+
+    // Ids arrive mostly in order, so try the last container first
+    if (n && r->keys[n - 1] <= key) {
+        return r->keys[n - 1] == key ? (ptrdiff_t)n - 1 : -(ptrdiff_t)n - 1;
+    }
+    return _roaring_search16(r->keys, n, key);
+}
+
+/*
+ * Function: _roaring_insert_at
+ * --------------------
+ *  Inserts an empty container for key at an index, growing the arrays.
+ *
+ *  returns: Pointer to the container.
+ */
+roaring_container_t* _roaring_insert_at(roaring_t* r, size_t index,
+                uint16_t key) {
+    _roaring_reserve(r, r->n_containers + 1);
+
+    size_t n_after = r->n_containers - index;
+    memmove(&r->keys[index + 1], &r->keys[index],
+                sizeof(uint16_t) * n_after);
+    memmove(&r->containers[index + 1], &r->containers[index],
+                sizeof(roaring_container_t) * n_after);
+    r->n_containers++;
+
+    roaring_container_t* c = &r->containers[index];
+    memset(c, 0, sizeof(roaring_container_t));
+    r->keys[index] = key;
+
+    return c;
+}
+
+/*
+ * Function: _roaring_remove_at
+ * --------------------
+ *  Frees the container at an index and closes the gap.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_remove_at(roaring_t* r, size_t index) {
+    _roaring_free_container(r, &r->containers[index]);
+
+    size_t n_after = r->n_containers - index - 1;
+    memmove(&r->keys[index], &r->keys[index + 1],
+                sizeof(uint16_t) * n_after);
+    memmove(&r->containers[index], &r->containers[index + 1],
+                sizeof(roaring_container_t) * n_after);
+    r->n_containers--;
+}
+
+/*
+ * Function: _roaring_reserve
+ * --------------------
+ *  Makes room for at least n_containers containers.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_reserve(roaring_t* r, size_t n_containers) {
+    if (n_containers <= r->capacity) {
+        return;
+    }
+
+    size_t capacity = r->capacity ? r->capacity : ROARING_INITIAL_CONTAINERS;
+    while (capacity < n_containers) {
+        capacity *= 2;
+    }
+
+    // Allocators have no realloc, so copy into fresh arrays
+    uint16_t* keys = allocator_alloc(&r->allocator,
+                sizeof(uint16_t) * capacity);
+    roaring_container_t* containers = allocator_alloc(&r->allocator,
+                sizeof(roaring_container_t) * capacity);
+    assert(keys && containers);
+
+    if (r->capacity) {
+        memcpy(keys, r->keys, sizeof(uint16_t) * r->n_containers);
+        memcpy(containers, r->containers,
+                    sizeof(roaring_container_t) * r->n_containers);
+        allocator_free(&r->allocator, r->keys,
+                    sizeof(uint16_t) * r->capacity);
+        allocator_free(&r->allocator, r->containers,
+                    sizeof(roaring_container_t) * r->capacity);
+    }
+    r->keys = keys;
+    r->containers = containers;
+    r->capacity = capacity;
+}
+
+/*
+ * Function: _roaring_alloc_container
+ * --------------------
+ *  Allocates the data of a container for its type and capacity.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_alloc_container(roaring_t* r, roaring_container_t* c,
+                roaring_type_t type, uint32_t capacity) {
+    size_t size;
+
+    if (type == ROARING_BITSET) {
+        capacity = 0;
+        size = ROARING_BITSET_BYTES;
+    } else if (type == ROARING_ARRAY) {
+        size = sizeof(uint16_t) * capacity;
+    } else {
+        size = sizeof(roaring_run_t) * capacity;
+    }
+
+    c->type = (uint8_t)type;
+    c->n = 0;
+    c->capacity = capacity;
+    c->words = allocator_alloc(&r->allocator, size);
+    assert(c->words);
+}
+
+/*
+ * Function: _roaring_grow
+ * --------------------
+ *  Doubles the capacity of an array or run container.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_grow(roaring_t* r, roaring_container_t* c) {
+    size_t elem_size = c->type == ROARING_ARRAY ? sizeof(uint16_t) :
+                sizeof(roaring_run_t);
+    uint32_t limit = c->type == ROARING_ARRAY ? ROARING_ARRAY_MAX :
+                ROARING_RUNS_MAX;
+    uint32_t capacity = c->capacity ? c->capacity * 2 :
+                ROARING_ARRAY_INITIAL_CAPACITY;
+    if (capacity > limit) {
+        capacity = limit;
+    }
+
+    void* data = allocator_alloc(&r->allocator, elem_size * capacity);
+    assert(data);
+    if (c->capacity) {
+        memcpy(data, c->values, elem_size * c->n);
+        allocator_free(&r->allocator, c->values, elem_size * c->capacity);
+    }
+    c->values = data;
+    c->capacity = capacity;
+}
+
+/*
+ * Function: _roaring_free_container
+ * --------------------
+ *  Frees the data of a container.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_free_container(roaring_t* r, roaring_container_t* c) {
+    if (!c->words) {
+        return;
+    }
+
+    size_t size = c->type == ROARING_BITSET ? ROARING_BITSET_BYTES :
+                c->type == ROARING_ARRAY ? sizeof(uint16_t) * c->capacity :
+                sizeof(roaring_run_t) * c->capacity;
+    allocator_free(&r->allocator, c->words, size);
+    c->words = NULL;
+    c->n = 0;
+    c->capacity = 0;
+    c->cardinality = 0;
+}
+
+/*
+ * Function: _roaring_copy_container
+ * --------------------
+ *  Copies a container into dst, its data from r's allocator.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_copy_container(roaring_t* r, roaring_container_t* dst,
+                const roaring_container_t* src) {
+    size_t size;
+
+    // Copies are sized to their contents, they are mostly not grown again
+    if (src->type == ROARING_BITSET) {
+        _roaring_alloc_container(r, dst, ROARING_BITSET, 0);
+        size = ROARING_BITSET_BYTES;
+    } else {
+        _roaring_alloc_container(r, dst, (roaring_type_t)src->type, src->n);
+        size = src->n * (src->type == ROARING_ARRAY ? sizeof(uint16_t) :
+                    sizeof(roaring_run_t));
+    }
+    memcpy(dst->words, src->words, size);
+    dst->n = src->n;
+    dst->cardinality = src->cardinality;
+}
+
+/*
+ * Function: _roaring_container_add
+ * --------------------
+ *  Adds the low 16 bits of a value to a container.
+ *
+ *  returns: True if added, false if present.
+ */
+bool _roaring_container_add(roaring_t* r, roaring_container_t* c,
+                uint16_t low) {
+    if (c->type == ROARING_BITSET) {
+        uint64_t mask = 1ULL << (low % 64);
+        if (c->words[low / 64] & mask) {
+            return false;
+        }
+        c->words[low / 64] |= mask;
+        c->cardinality++;
+        return true;
+    }
+
+    if (c->type == ROARING_ARRAY) {
+        ptrdiff_t index = _roaring_search16(c->values, c->n, low);
+        if (index >= 0) {
+            return false;
+        }
+
+        if (c->n == ROARING_ARRAY_MAX) {
+            // Full, a bitset is smaller from here on
+            uint64_t* words = allocator_alloc(&r->allocator,
+                        ROARING_BITSET_BYTES);
+            assert(words);
+            memset(words, 0, ROARING_BITSET_BYTES);
+            _roaring_to_words(c, words);
+            _roaring_free_container(r, c);
+            c->type = ROARING_BITSET;
+            c->words = words;
+            c->cardinality = ROARING_ARRAY_MAX;
+            return _roaring_container_add(r, c, low);
+        }
+
+        if (c->n == c->capacity) {
+            _roaring_grow(r, c);
+        }
+        size_t at = (size_t)(-index - 1);
+        memmove(&c->values[at + 1], &c->values[at],
+                    sizeof(uint16_t) * (c->n - at));
+        c->values[at] = low;
+        c->n++;
+        c->cardinality++;
+        return true;
+    }
+
+    ptrdiff_t i = _roaring_search_runs(c->runs, c->n, low);
+    if (i >= 0 && low <= (uint32_t)c->runs[i].start + c->runs[i].length) {
+        return false;
+    }
+
+    bool join_prev = i >= 0 &&
+                (uint32_t)c->runs[i].start + c->runs[i].length + 1 == low;
+    bool join_next = (size_t)(i + 1) < c->n &&
+                c->runs[i + 1].start == (uint32_t)low + 1;
+    if (join_prev && join_next) {
+        // low fills the gap between two runs
+        c->runs[i].length = (uint16_t)(c->runs[i].length +
+                    c->runs[i + 1].length + 2);
+        memmove(&c->runs[i + 1], &c->runs[i + 2],
+                    sizeof(roaring_run_t) * (c->n - (size_t)i - 2));
+        c->n--;
+    } else if (join_prev) {
+        c->runs[i].length++;
+    } else if (join_next) {
+        c->runs[i + 1].start--;
+        c->runs[i + 1].length++;
+    } else {
+        if (c->n == c->capacity) {
+            _roaring_grow(r, c);
+        }
+        size_t at = (size_t)(i + 1);
+        memmove(&c->runs[at + 1], &c->runs[at],
+                    sizeof(roaring_run_t) * (c->n - at));
+        c->runs[at].start = low;
+        c->runs[at].length = 0;
+        c->n++;
+    }
+    c->cardinality++;
+    _roaring_fit(r, c);
+    return true;
+}
+
+/*
+ * Function: _roaring_container_remove
+ * --------------------
+ *  Removes the low 16 bits of a value from a non empty container.
+ *
+ *  returns: True if removed, false if absent.
+ */
+bool _roaring_container_remove(roaring_t* r, roaring_container_t* c,
+                uint16_t low) {
+    if (c->type == ROARING_BITSET) {
+        uint64_t mask = 1ULL << (low % 64);
+        if (!(c->words[low / 64] & mask)) {
+            return false;
+        }
+        c->words[low / 64] &= ~mask;
+        c->cardinality--;
+        _roaring_fit(r, c);
+        return true;
+    }
+
+    if (c->type == ROARING_ARRAY) {
+        ptrdiff_t index = _roaring_search16(c->values, c->n, low);
+        if (index < 0) {
+            return false;
+        }
+        memmove(&c->values[index], &c->values[index + 1],
+                    sizeof(uint16_t) * (c->n - (size_t)index - 1));
+        c->n--;
+        c->cardinality--;
+        return true;
+    }
+
+    ptrdiff_t i = _roaring_search_runs(c->runs, c->n, low);
+    if (i < 0 || low > (uint32_t)c->runs[i].start + c->runs[i].length) {
+        return false;
+    }
+
+    roaring_run_t* run = &c->runs[i];
+    uint32_t end = (uint32_t)run->start + run->length;
+    if (run->length == 0) {
+        memmove(run, run + 1, sizeof(roaring_run_t) * (c->n - (size_t)i - 1));
+        c->n--;
+    } else if (low == run->start) {
+        run->start++;
+        run->length--;
+    } else if (low == end) {
+        run->length--;
+    } else {
+        // Split around low
+        if (c->n == c->capacity) {
+            _roaring_grow(r, c);
+            run = &c->runs[i];
+        }
+        memmove(run + 2, run + 1,
+                    sizeof(roaring_run_t) * (c->n - (size_t)i - 1));
+        run->length = (uint16_t)(low - run->start - 1);
+        run[1].start = (uint16_t)(low + 1);
+        run[1].length = (uint16_t)(end - low - 1);
+        c->n++;
+    }
+    c->cardinality--;
+    _roaring_fit(r, c);
+    return true;
+}
+
+/*
+ * Function: _roaring_container_contains
+ * --------------------
+ *  Checks if a container holds the low 16 bits of a value.
+ *
+ *  returns: True if found.
+ */
+bool _roaring_container_contains(const roaring_container_t* c, uint16_t low) {
+    if (c->type == ROARING_BITSET) {
+        return (c->words[low / 64] >> (low % 64)) & 1;
+    }
+    if (c->type == ROARING_ARRAY) {
+        return _roaring_search16(c->values, c->n, low) >= 0;
+    }
+
+    ptrdiff_t i = _roaring_search_runs(c->runs, c->n, low);
+    return i >= 0 && low <= (uint32_t)c->runs[i].start + c->runs[i].length;
+}
+
+/*
+ * Function: _roaring_container_rank
+ * --------------------
+ *  Counts the values of a container not greater than low.
+ *
+ *  returns: Count.
+ */
+uint32_t _roaring_container_rank(const roaring_container_t* c, uint16_t low) {
+    uint32_t rank = 0;
+
+    if (c->type == ROARING_BITSET) {
+        for (size_t w = 0; w < (size_t)low / 64; w++) {
+            rank += (uint32_t)__builtin_popcountll(c->words[w]);
+        }
+        // Mask of bits 0 .. low % 64, all ones when low % 64 is 63
+        uint64_t mask = (2ULL << (low % 64)) - 1;
+        return rank + (uint32_t)__builtin_popcountll(c->words[low / 64] &
+                    mask);
+    }
+
+    if (c->type == ROARING_ARRAY) {
+        ptrdiff_t index = _roaring_search16(c->values, c->n, low);
+        return index >= 0 ? (uint32_t)index + 1 : (uint32_t)(-index - 1);
+    }
+
+    for (uint32_t i = 0; i < c->n && c->runs[i].start <= low; i++) {
+        uint32_t end = (uint32_t)c->runs[i].start + c->runs[i].length;
+        rank += (low < end ? low : end) - c->runs[i].start + 1;
+    }
+    return rank;
+}
+
+/*
+ * Function: _roaring_container_select
+ * --------------------
+ *  Gets the low 16 bits of the value of a rank within a container.
+ *
+ *  returns: Low bits.
+ */
+uint16_t _roaring_container_select(const roaring_container_t* c,
+                uint32_t rank) {
+    if (c->type == ROARING_ARRAY) {
+        return c->values[rank];
+    }
+
+    if (c->type == ROARING_BITSET) {
+        for (size_t w = 0; w < ROARING_BITSET_WORDS; w++) {
+            uint32_t count = (uint32_t)__builtin_popcountll(c->words[w]);
+            if (rank < count) {
+                uint64_t word = c->words[w];
+                for (; rank; rank--) {
+                    word &= word - 1;
+                }
+                return (uint16_t)(w * 64 + (size_t)__builtin_ctzll(word));
+            }
+            rank -= count;
+        }
+        assert(false);
+    }
+
+    for (uint32_t i = 0; i < c->n; i++) {
+        if (rank <= c->runs[i].length) {
+            return (uint16_t)(c->runs[i].start + rank);
+        }
+        rank -= c->runs[i].length + 1u;
+    }
+    assert(false);
+    return 0;
+}
+
+/*
+ * Function: _roaring_to_words
+ * --------------------
+ *  Writes a container as a full bitset.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_to_words(const roaring_container_t* c, uint64_t* words) {
+    if (c->type == ROARING_BITSET) {
+        memcpy(words, c->words, ROARING_BITSET_BYTES);
+        return;
+    }
+
+    memset(words, 0, ROARING_BITSET_BYTES);
+    if (c->type == ROARING_ARRAY) {
+        for (uint32_t i = 0; i < c->n; i++) {
+            words[c->values[i] / 64] |= 1ULL << (c->values[i] % 64);
+        }
+    } else {
+        for (uint32_t i = 0; i < c->n; i++) {
+            _roaring_set_range(words, c->runs[i].start,
+                        (uint32_t)c->runs[i].start + c->runs[i].length + 1);
+        }
+    }
+}
+
+/*
+ * Function: _roaring_from_words
+ * --------------------
+ *  Stores a bitset of cardinality values into a container as an array or
+ *  a bitset, reusing c's bitset data if it has one.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_from_words(roaring_t* r, roaring_container_t* c,
+                const uint64_t* words, uint32_t cardinality) {
+    if (cardinality == 0) {
+        _roaring_free_container(r, c);
+        return;
+    }
+
+    if (cardinality > ROARING_ARRAY_MAX) {
+        if (c->type != ROARING_BITSET || !c->words) {
+            _roaring_free_container(r, c);
+            _roaring_alloc_container(r, c, ROARING_BITSET, 0);
+        }
+        if (c->words != words) {
+            memcpy(c->words, words, ROARING_BITSET_BYTES);
+        }
+        c->cardinality = cardinality;
+        return;
+    }
+
+    uint16_t* values = allocator_alloc(&r->allocator,
+                sizeof(uint16_t) * cardinality);
+    assert(values);
+    uint32_t n = 0;
+    for (uint32_t w = 0; w < ROARING_BITSET_WORDS; w++) {
+        for (uint64_t word = words[w]; word; word &= word - 1) {
+            values[n++] = (uint16_t)(w * 64 +
+                        (uint32_t)__builtin_ctzll(word));
+        }
+    }
+
+    _roaring_free_container(r, c);
+    c->type = ROARING_ARRAY;
+    c->values = values;
+    c->n = n;
+    c->capacity = cardinality;
+    c->cardinality = cardinality;
+}
+
+/*
+ * Function: _roaring_fit
+ * --------------------
+ *  Converts a container changed in place to the type its cardinality and
+ *  runs call for.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_fit(roaring_t* r, roaring_container_t* c) {
+    if (c->cardinality == 0) {
+        return;
+    }
+
+    bool convert;
+    if (c->type == ROARING_RUN) {
+        convert = _roaring_run_bytes(c->n) >=
+                    _roaring_plain_bytes(c->cardinality);
+    } else if (c->type == ROARING_ARRAY) {
+        convert = c->cardinality > ROARING_ARRAY_MAX;
+    } else {
+        convert = c->cardinality <= ROARING_ARRAY_MAX;
+    }
+    if (!convert) {
+        return;
+    }
+
+    uint64_t words[ROARING_BITSET_WORDS];
+    _roaring_to_words(c, words);
+    uint32_t cardinality = c->cardinality;
+    // The container's own data is not a bitset it could reuse
+    _roaring_free_container(r, c);
+    _roaring_from_words(r, c, words, cardinality);
+}
+
+/*
+ * Function: _roaring_container_op
+ * --------------------
+ *  Combines two containers into dst, which may be a itself. dst is left
+ *  with cardinality 0 if the result is empty.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_container_op(roaring_t* r, roaring_container_t* dst,
+                const roaring_container_t* a, const roaring_container_t* b,
+                roaring_op_t op) {
+    uint64_t wa[ROARING_BITSET_WORDS], wb[ROARING_BITSET_WORDS];
+    bool a_array = a->type == ROARING_ARRAY;
+    bool b_array = b->type == ROARING_ARRAY;
+
+    if (a_array && b_array) {
+        size_t capacity = op == ROARING_AND || op == ROARING_ANDNOT ? a->n :
+                    (size_t)a->n + b->n;
+        if (capacity <= ROARING_ARRAY_MAX) {
+            uint16_t* values = allocator_alloc(&r->allocator,
+                        sizeof(uint16_t) * (capacity ? capacity : 1));
+            assert(values);
+            uint32_t n = _roaring_merge(a->values, a->n, b->values, b->n,
+                        values, op);
+
+            _roaring_free_container(r, dst);
+            if (!n) {
+                allocator_free(&r->allocator, values,
+                            sizeof(uint16_t) * (capacity ? capacity : 1));
+                return;
+            }
+            dst->type = ROARING_ARRAY;
+            dst->values = values;
+            dst->n = n;
+            dst->capacity = (uint32_t)(capacity ? capacity : 1);
+            dst->cardinality = n;
+            return;
+        }
+    }
+
+    // An array filtered by the other container stays an array
+    if ((op == ROARING_AND && (a_array || b_array)) ||
+                (op == ROARING_ANDNOT && a_array)) {
+        const roaring_container_t* small = a_array ? a : b;
+        const roaring_container_t* other = small == a ? b : a;
+        bool want = op == ROARING_AND;
+        uint16_t* values = allocator_alloc(&r->allocator,
+                    sizeof(uint16_t) * small->n);
+        assert(values);
+
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < small->n; i++) {
+            if (_roaring_container_contains(other, small->values[i]) == want) {
+                values[n++] = small->values[i];
+            }
+        }
+
+        uint32_t capacity = small->n;
+        _roaring_free_container(r, dst);
+        if (!n) {
+            allocator_free(&r->allocator, values, sizeof(uint16_t) * capacity);
+            return;
+        }
+        dst->type = ROARING_ARRAY;
+        dst->values = values;
+        dst->n = n;
+        dst->capacity = capacity;
+        dst->cardinality = n;
+        return;
+    }
+
+    // Everything else goes through full bitsets, a bitset of dst = a is
+    // updated where it is
+    const uint64_t* words_a = wa;
+    const uint64_t* words_b = wb;
+    if (a->type == ROARING_BITSET) {
+        words_a = a->words;
+    } else {
+        _roaring_to_words(a, wa);
+    }
+    if (b->type == ROARING_BITSET) {
+        words_b = b->words;
+    } else {
+        _roaring_to_words(b, wb);
+    }
+
+    uint64_t* out = dst == a && a->type == ROARING_BITSET ? dst->words : wa;
+    uint32_t cardinality = _roaring_words_op(out, words_a, words_b, op);
+    if (out != dst->words) {
+        _roaring_free_container(r, dst);
+    }
+    _roaring_from_words(r, dst, out, cardinality);
+}
+
+/*
+ * Function: _roaring_op
+ * --------------------
+ *  Combines two bitmaps into dst, which may be a itself.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_op(roaring_t* dst, const roaring_t* a, const roaring_t* b,
+                roaring_op_t op) {
+    bool inplace = dst == a;
+    size_t na = a->n_containers, nb = b->n_containers;
+    size_t capacity = op == ROARING_AND ? (na < nb ? na : nb) :
+                op == ROARING_ANDNOT ? na : na + nb;
+    size_t i = 0, j = 0, n = 0;
+
+    if (!capacity) {
+        if (inplace) {
+            roaring_clear(dst);
+        }
+        return;
+    }
+
+    // The result is built in fresh arrays, containers only a has are moved
+    // into them when a is dst rather than copied
+    uint16_t* keys = allocator_alloc(&dst->allocator,
+                sizeof(uint16_t) * capacity);
+    roaring_container_t* containers = allocator_alloc(&dst->allocator,
+                sizeof(roaring_container_t) * capacity);
+    assert(keys && containers);
+
+    while (i < na || j < nb) {
+        uint32_t ka = i < na ? a->keys[i] : UINT32_MAX;
+        uint32_t kb = j < nb ? b->keys[j] : UINT32_MAX;
+        roaring_container_t* c = &containers[n];
+
+        if (ka < kb) {
+            roaring_container_t* from = &a->containers[i++];
+            if (op == ROARING_AND) {
+                if (inplace) {
+                    _roaring_free_container(dst, from);
+                }
+                continue;
+            }
+            if (inplace) {
+                *c = *from;
+            } else {
+                _roaring_copy_container(dst, c, from);
+            }
+            keys[n++] = (uint16_t)ka;
+        } else if (kb < ka) {
+            const roaring_container_t* from = &b->containers[j++];
+            if (op == ROARING_OR || op == ROARING_XOR) {
+                _roaring_copy_container(dst, c, from);
+                keys[n++] = (uint16_t)kb;
+            }
+        } else {
+            roaring_container_t* from = &a->containers[i++];
+            if (inplace) {
+                _roaring_container_op(dst, from, from, &b->containers[j++],
+                            op);
+                *c = *from;
+            } else {
+                memset(c, 0, sizeof(roaring_container_t));
+                _roaring_container_op(dst, c, from, &b->containers[j++], op);
+            }
+            if (c->cardinality) {
+                keys[n++] = (uint16_t)ka;
+            }
+        }
+    }
+
+    // a's containers now live in the new arrays or were freed, a dst that
+    // is not a is still empty
+    if (dst->capacity) {
+        allocator_free(&dst->allocator, dst->keys,
+                    sizeof(uint16_t) * dst->capacity);
+        allocator_free(&dst->allocator, dst->containers,
+                    sizeof(roaring_container_t) * dst->capacity);
+    }
+    dst->keys = keys;
+    dst->containers = containers;
+    dst->capacity = capacity;
+    dst->n_containers = n;
+
+    dst->cardinality = 0;
+    for (size_t k = 0; k < n; k++) {
+        dst->cardinality += containers[k].cardinality;
+    }
+}
+
+/*
+ * Function: _roaring_count_runs
+ * --------------------
+ *  Counts the runs of consecutive values in a container.
+ *
+ *  returns: Number of runs.
+ */
+uint32_t _roaring_count_runs(const roaring_container_t* c) {
+    uint32_t n_runs = 0;
+
+    if (c->type == ROARING_RUN) {
+        return c->n;
+    }
+
+    if (c->type == ROARING_ARRAY) {
+        for (uint32_t i = 0; i < c->n; i++) {
+            n_runs += i == 0 || c->values[i] != c->values[i - 1] + 1;
+        }
+        return n_runs;
+    }
+
+    // A run starts at each set bit whose lower neighbour is clear
+    uint64_t carry = 0;
+    for (size_t w = 0; w < ROARING_BITSET_WORDS; w++) {
+        uint64_t word = c->words[w];
+        n_runs += (uint32_t)__builtin_popcountll(word & ~((word << 1) |
+                    carry));
+        carry = word >> 63;
+    }
+    return n_runs;
+}
+
+/*
+ * Function: _roaring_to_runs
+ * --------------------
+ *  Converts a container to n_runs runs.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_to_runs(roaring_t* r, roaring_container_t* c, uint32_t n_runs) {
+    roaring_container_t runs;
+    uint32_t n = 0;
+
+    if (c->type == ROARING_RUN) {
+        return;
+    }
+    _roaring_alloc_container(r, &runs, ROARING_RUN, n_runs);
+
+    if (c->type == ROARING_ARRAY) {
+        for (uint32_t i = 0; i < c->n; i++) {
+            if (i == 0 || c->values[i] != c->values[i - 1] + 1) {
+                runs.runs[n].start = c->values[i];
+                runs.runs[n++].length = 0;
+            } else {
+                runs.runs[n - 1].length++;
+            }
+        }
+    } else {
+        // Find where each run of ones starts and where the ones stop
+        size_t w = 0;
+        uint64_t word = c->words[0];
+        while (true) {
+            while (!word && w + 1 < ROARING_BITSET_WORDS) {
+                word = c->words[++w];
+            }
+            if (!word) {
+                break;
+            }
+            uint32_t start = (uint32_t)(w * 64) +
+                        (uint32_t)__builtin_ctzll(word);
+            uint64_t filled = word | (word - 1);
+            while (filled == ~0ULL && w + 1 < ROARING_BITSET_WORDS) {
+                filled = c->words[++w];
+            }
+            uint32_t end = filled == ~0ULL ? ROARING_CHUNK_BITS :
+                        (uint32_t)(w * 64) + (uint32_t)__builtin_ctzll(~filled);
+            runs.runs[n].start = (uint16_t)start;
+            runs.runs[n++].length = (uint16_t)(end - start - 1);
+            if (end == ROARING_CHUNK_BITS) {
+                break;
+            }
+            word = filled & (filled + 1);
+        }
+    }
+    assert(n == n_runs);
+
+    runs.n = n;
+    runs.cardinality = c->cardinality;
+    _roaring_free_container(r, c);
+    *c = runs;
+}
@@ -0,0 +1,645 @@
+#ifndef ROARING_H
+#define ROARING_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "allocator.h"
+#include "hints.h"
+
+// Values held by one container, those sharing their high 16 bits
+#define ROARING_CHUNK_BITS 65536
+// Largest array container, past it a bitset is smaller
+#define ROARING_ARRAY_MAX 4096
+#define ROARING_BITSET_WORDS (ROARING_CHUNK_BITS / 64)
+#define ROARING_ARRAY_INITIAL_CAPACITY 4
+#define ROARING_INITIAL_CONTAINERS 4
+
+typedef enum roaring_op {
+    ROARING_AND,
+    ROARING_OR,
+    ROARING_XOR,
+    ROARING_ANDNOT
+} roaring_op_t;
+
+typedef enum roaring_type {
+    // Sorted low 16 bits, up to ROARING_ARRAY_MAX of them
+    ROARING_ARRAY,
+    // One bit per low 16 bit value, ROARING_BITSET_WORDS words
+    ROARING_BITSET,
+    // Sorted runs of consecutive values
+    ROARING_RUN
+} roaring_type_t;
+
+/*
+ * Run of values start .. start + length, length is one less than the
+ * count as in the portable format.
+ */
+typedef struct roaring_run {
+    uint16_t start;
+    uint16_t length;
+} roaring_run_t;
+
+/*
+ * Values of a bitmap sharing their high 16 bits. Array and bitset
+ * containers switch at ROARING_ARRAY_MAX, run containers only exist where
+ * roaring_add_range or roaring_optimize made them and they are smallest.
+ */
+typedef struct roaring_container {
+    uint8_t type;
+    // Values held, 1 .. ROARING_CHUNK_BITS
+    uint32_t cardinality;
+    // Values of an array or runs of a run container, in use and allocated
+    uint32_t n;
+    uint32_t capacity;
+    union {
+        uint16_t* values;
+        uint64_t* words;
+        roaring_run_t* runs;
+    };
+} roaring_container_t;
+
+/*
+ * Compressed bitmap of 32 bit values after Lemire et al. Values are split
+ * by their high 16 bits into containers kept sorted by key, each stored as
+ * whichever of an array, a bitset or runs is smallest.
+ */
+typedef struct roaring {
+    // High 16 bits of each container, ascending
+    uint16_t* keys;
+    roaring_container_t* containers;
+    size_t n_containers;
+    size_t capacity;
+    uint64_t cardinality;
+    // Source of the bitmap and its containers
+    allocator_t allocator;
+} roaring_t;
+
+/*
+ * Position in an ascending scan from roaring_iter_init. The bitmap must
+ * not change during the scan.
+ */
+typedef struct roaring_iter {
+    const roaring_t* r;
+    size_t container;
+    // Next value of an array, word of a bitset or run of a run container
+    uint32_t index;
+    // Next value within the run
+    uint32_t offset;
+    // Bits of the word not produced yet
+    uint64_t word;
+} roaring_iter_t;
+
+/**** PUBLIC ****/
+
+/*
+ * Function: roaring_create
+ * --------------------
+ *  Creates a new empty bitmap.
+ *
+ *  No parameters.
+ *
+ *  returns: Pointer to the new bitmap.
+ */
+roaring_t* roaring_create(void);
+
+/*
+ * Function: roaring_create_with_allocator
+ * --------------------
+ *  Creates a new empty bitmap whose memory comes from an allocator.
+ *
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new bitmap.
+ */
+roaring_t* roaring_create_with_allocator(const allocator_t* allocator);
+
+/*
+ * Function: roaring_copy
+ * --------------------
+ *  Creates a copy of a bitmap from the same allocator.
+ *
+ *  r: Pointer to the bitmap.
+ *
+ *  returns: Pointer to the copy.
+ */
+roaring_t* roaring_copy(const roaring_t* r);
+
+/*
+ * Function: roaring_add
+ * --------------------
+ *  Adds a value. Doubles as a test and set for visited sets.
+ *
+ *  r: Pointer to the bitmap.
+ *  value: Value to add.
+ *
+ *  returns: True if the value was added, false if present.
+ */
+bool roaring_add(roaring_t* r, uint32_t value);
+
+/*
+ * Function: roaring_add_range
+ * --------------------
+ *  Adds every value in [low, high). Whole containers become single runs.
+ *
+ *  r: Pointer to the bitmap.
+ *  low: Inclusive lower bound.
+ *  high: Exclusive upper bound, up to 2^32.
+ *
+ *  returns: Number of values added.
+ */
+uint64_t roaring_add_range(roaring_t* r, uint64_t low, uint64_t high);
+
+/*
+ * Function: roaring_remove
+ * --------------------
+ *  Removes a value.
+ *
+ *  r: Pointer to the bitmap.
+ *  value: Value to remove.
+ *
+ *  returns: True if the value was removed, false if not found.
+ */
+bool roaring_remove(roaring_t* r, uint32_t value);
+
+/*
+ * Function: roaring_contains
+ * --------------------
+ *  Checks if a value is in the bitmap.
+ *
+ *  r: Pointer to the bitmap.
+ *  value: Value to check for.
+ *
+ *  returns: True if found, false otherwise.
+ */
+bool roaring_contains(const roaring_t* r, uint32_t value);
+
+/*
+ * Function: roaring_cardinality
+ * --------------------
+ *  Gets the number of values.
+ *
+ *  r: Pointer to the bitmap.
+ *
+ *  returns: Number of values.
+ */
+DSL_INLINE uint64_t roaring_cardinality(const roaring_t* r) {
+    return r->cardinality;
+}
+
+/*
+ * Function: roaring_rank
+ * --------------------
+ *  Counts the values not greater than a value.
+ *
+ *  r: Pointer to the bitmap.
+ *  value: Value to rank.
+ *
+ *  returns: Number of values <= value.
+ */
+uint64_t roaring_rank(const roaring_t* r, uint32_t value);
+
+/*
+ * Function: roaring_select
+ * --------------------
+ *  Gets the value of a rank, the inverse of roaring_rank.
+ *
+ *  r: Pointer to the bitmap.
+ *  rank: Number of smaller values, 0 for the minimum.
+ *  value: Output value.
+ *
+ *  returns: True if found, false if rank is not below the cardinality.
+ */
+bool roaring_select(const roaring_t* r, uint64_t rank, uint32_t* value);
+
+/*
+ * Function: roaring_and
+ * --------------------
+ *  Creates the intersection of two bitmaps, from a's allocator.
+ *
+ *  a: Pointer to the first bitmap.
+ *  b: Pointer to the second bitmap.
+ *
+ *  returns: Pointer to the new bitmap.
+ */
+roaring_t* roaring_and(const roaring_t* a, const roaring_t* b);
+
+/*
+ * Function: roaring_or
+ * --------------------
+ *  Creates the union of two bitmaps, from a's allocator.
+ *
+ *  a: Pointer to the first bitmap.
+ *  b: Pointer to the second bitmap.
+ *
+ *  returns: Pointer to the new bitmap.
+ */
+roaring_t* roaring_or(const roaring_t* a, const roaring_t* b);
+
+/*
+ * Function: roaring_xor
+ * --------------------
+ *  Creates the symmetric difference of two bitmaps, from a's allocator.
+ *
+ *  a: Pointer to the first bitmap.
+ *  b: Pointer to the second bitmap.
+ *
+ *  returns: Pointer to the new bitmap.
+ */
+roaring_t* roaring_xor(const roaring_t* a, const roaring_t* b);
+
+/*
+ * Function: roaring_andnot
+ * --------------------
+ *  Creates the values of a not in b, from a's allocator.
+ *
+ *  a: Pointer to the first bitmap.
+ *  b: Pointer to the second bitmap.
+ *
+ *  returns: Pointer to the new bitmap.
+ */
+roaring_t* roaring_andnot(const roaring_t* a, const roaring_t* b);
+
+/*
+ * Function: roaring_and_inplace
+ * --------------------
+ *  Intersects a with b. Containers only a has are dropped without being
+ *  read.
+ *
+ *  a: Pointer to the bitmap to update.
+ *  b: Pointer to the other bitmap.
+ *
+ *  returns: Nothing.
+ */
+void roaring_and_inplace(roaring_t* a, const roaring_t* b);
+
+/*
+ * Function: roaring_or_inplace
+ * --------------------
+ *  Adds the values of b to a. Containers only a has are left untouched and
+ *  bitset containers of a are updated in place, so growing a visited set
+ *  by a frontier costs the frontier, not the visited set.
+ *
+ *  a: Pointer to the bitmap to update.
+ *  b: Pointer to the other bitmap.
+ *
+ *  returns: Nothing.
+ */
+void roaring_or_inplace(roaring_t* a, const roaring_t* b);
+
+/*
+ * Function: roaring_xor_inplace
+ * --------------------
+ *  Toggles the values of b in a.
+ *
+ *  a: Pointer to the bitmap to update.
+ *  b: Pointer to the other bitmap.
+ *
+ *  returns: Nothing.
+ */
+void roaring_xor_inplace(roaring_t* a, const roaring_t* b);
+
+/*
+ * Function: roaring_andnot_inplace
+ * --------------------
+ *  Removes the values of b from a.
+ *
+ *  a: Pointer to the bitmap to update.
+ *  b: Pointer to the other bitmap.
+ *
+ *  returns: Nothing.
+ */
+void roaring_andnot_inplace(roaring_t* a, const roaring_t* b);
+
+/*
+ * Function: roaring_optimize
+ * --------------------
+ *  Stores each container as runs where that is smaller than an array or a
+ *  bitset, for long stretches of consecutive values before serializing or
+ *  keeping a bitmap around.
+ *
+ *  r: Pointer to the bitmap.
+ *
+ *  returns: True if any container is stored as runs.
+ */
+bool roaring_optimize(roaring_t* r);
+
+/*
+ * Function: roaring_iter_init
+ * --------------------
+ *  Starts an ascending scan of the values.
+ *
+ *  r: Pointer to the bitmap.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void roaring_iter_init(const roaring_t* r, roaring_iter_t* iter);
+
+/*
+ * Function: roaring_iter_next
+ * --------------------
+ *  Gets the next value of a scan.
+ *
+ *  iter: Pointer to the iterator.
+ *  value: Output value.
+ *
+ *  returns: True if a value was produced, false at the end of the scan.
+ */
+bool roaring_iter_next(roaring_iter_t* iter, uint32_t* value);
+
+/*
+ * Function: roaring_to_array
+ * --------------------
+ *  Copies the values in ascending order to an array.
+ *
+ *  r: Pointer to the bitmap.
+ *  out: Array of roaring_cardinality(r) values.
+ *
+ *  returns: Number of values written.
+ */
+size_t roaring_to_array(const roaring_t* r, uint32_t* out);
+
+/*
+ * Function: roaring_clear
+ * --------------------
+ *  Removes every value, keeping the bitmap for reuse.
+ *
+ *  r: Pointer to the bitmap.
+ *
+ *  returns: Nothing.
+ */
+void roaring_clear(roaring_t* r);
+
+/*
+ * Function: roaring_swap
+ * --------------------
+ *  Swaps the contents of two bitmaps without copying, as when the next
+ *  frontier becomes the current one.
+ *
+ *  a: Pointer to the first bitmap.
+ *  b: Pointer to the second bitmap.
+ *
+ *  returns: Nothing.
+ */
+void roaring_swap(roaring_t* a, roaring_t* b);
+
+/*
+ * Function: roaring_serialized_size
+ * --------------------
+ *  Gets the bytes roaring_serialize writes.
+ *
+ *  r: Pointer to the bitmap.
+ *
+ *  returns: Size in bytes.
+ */
+size_t roaring_serialized_size(const roaring_t* r);
+
+/*
+ * Function: roaring_serialize
+ * --------------------
+ *  Writes a bitmap in the Roaring portable format, little endian whatever
+ *  the host, readable by the other Roaring implementations.
+ *
+ *  r: Pointer to the bitmap.
+ *  buf: Output buffer of roaring_serialized_size(r) bytes.
+ *
+ *  returns: Bytes written.
+ */
+size_t roaring_serialize(const roaring_t* r, void* buf);
+
+/*
+ * Function: roaring_deserialize
+ * --------------------
+ *  Reads a bitmap in the Roaring portable format. The input is checked,
+ *  so it may come from outside the process.
+ *
+ *  buf: Serialized bitmap.
+ *  len: Bytes available in buf.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new bitmap, NULL if buf is not a valid bitmap.
+ */
+roaring_t* roaring_deserialize(const void* buf, size_t len,
+                const allocator_t* allocator);
+
+/*
+ * Function: roaring_clean
+ * --------------------
+ *  Frees the bitmap.
+ *
+ *  r: Pointer to the bitmap.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void roaring_clean(roaring_t* r);
+
+/*
+ * Function: roaring_memory_usage
+ * --------------------
+ *  Gets the memory r uses. The key and container arrays are buckets,
+ *  container values, words and runs are nodes.
+ *
+ *  r: Pointer to the bitmap.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t roaring_memory_usage(const roaring_t* r, memory_usage_t* usage);
+
+/**** PRIVATE ****/
+/*
+ * Function: _roaring_find
+ * --------------------
+ *  Binary searches the container keys.
+ *
+ *  returns: Index of key, or -(insertion index) - 1 if absent.
+ */
+ptrdiff_t _roaring_find(const roaring_t* r, uint16_t key);
+
+/*
+ * Function: _roaring_insert_at
+ * --------------------
+ *  Inserts an empty container for key at an index, growing the arrays.
+ *
+ *  returns: Pointer to the container.
+ */
+roaring_container_t* _roaring_insert_at(roaring_t* r, size_t index,
+                uint16_t key);
+
+/*
+ * Function: _roaring_remove_at
+ * --------------------
+ *  Frees the container at an index and closes the gap.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_remove_at(roaring_t* r, size_t index);
+
+/*
+ * Function: _roaring_reserve
+ * --------------------
+ *  Makes room for at least n_containers containers.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_reserve(roaring_t* r, size_t n_containers);
+
+/*
+ * Function: _roaring_alloc_container
+ * --------------------
+ *  Allocates the data of a container for its type and capacity.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_alloc_container(roaring_t* r, roaring_container_t* c,
+                roaring_type_t type, uint32_t capacity);
+
+/*
+ * Function: _roaring_grow
+ * --------------------
+ *  Doubles the capacity of an array or run container.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_grow(roaring_t* r, roaring_container_t* c);
+
+/*
+ * Function: _roaring_free_container
+ * --------------------
+ *  Frees the data of a container.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_free_container(roaring_t* r, roaring_container_t* c);
+
+/*
+ * Function: _roaring_copy_container
+ * --------------------
+ *  Copies a container into dst, its data from r's allocator.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_copy_container(roaring_t* r, roaring_container_t* dst,
+                const roaring_container_t* src);
+
+/*
+ * Function: _roaring_container_add
+ * --------------------
+ *  Adds the low 16 bits of a value to a container.
+ *
+ *  returns: True if added, false if present.
+ */
+bool _roaring_container_add(roaring_t* r, roaring_container_t* c,
+                uint16_t low);
+
+/*
+ * Function: _roaring_container_remove
+ * --------------------
+ *  Removes the low 16 bits of a value from a non empty container.
+ *
+ *  returns: True if removed, false if absent.
+ */
+bool _roaring_container_remove(roaring_t* r, roaring_container_t* c,
+                uint16_t low);
+
+/*
+ * Function: _roaring_container_contains
+ * --------------------
+ *  Checks if a container holds the low 16 bits of a value.
+ *
+ *  returns: True if found.
+ */
+bool _roaring_container_contains(const roaring_container_t* c, uint16_t low);
+
+/*
+ * Function: _roaring_container_rank
+ * --------------------
+ *  Counts the values of a container not greater than low.
+ *
+ *  returns: Count.
+ */
+uint32_t _roaring_container_rank(const roaring_container_t* c, uint16_t low);
+
+/*
+ * Function: _roaring_container_select
+ * --------------------
+ *  Gets the low 16 bits of the value of a rank within a container.
+ *
+ *  returns: Low bits.
+ */
+uint16_t _roaring_container_select(const roaring_container_t* c,
+                uint32_t rank);
+
+/*
+ * Function: _roaring_to_words
+ * --------------------
+ *  Writes a container as a full bitset.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_to_words(const roaring_container_t* c, uint64_t* words);
+
+/*
+ * Function: _roaring_from_words
+ * --------------------
+ *  Stores a bitset of cardinality values into a container as an array or
+ *  a bitset, reusing c's bitset data if it has one.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_from_words(roaring_t* r, roaring_container_t* c,
+                const uint64_t* words, uint32_t cardinality);
+
+/*
+ * Function: _roaring_fit
+ * --------------------
+ *  Converts a container changed in place to the type its cardinality and
+ *  runs call for.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_fit(roaring_t* r, roaring_container_t* c);
+
+/*
+ * Function: _roaring_container_op
+ * --------------------
+ *  Combines two containers into dst, which may be a itself. dst is left
+ *  with cardinality 0 if the result is empty.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_container_op(roaring_t* r, roaring_container_t* dst,
+                const roaring_container_t* a, const roaring_container_t* b,
+                roaring_op_t op);
+
+/*
+ * Function: _roaring_op
+ * --------------------
+ *  Combines two bitmaps into dst, which may be a itself.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_op(roaring_t* dst, const roaring_t* a, const roaring_t* b,
+                roaring_op_t op);
+
+/*
+ * Function: _roaring_count_runs
+ * --------------------
+ *  Counts the runs of consecutive values in a container.
+ *
+ *  returns: Number of runs.
+ */
+uint32_t _roaring_count_runs(const roaring_container_t* c);
+
+/*
+ * Function: _roaring_to_runs
+ * --------------------
+ *  Converts a container to n_runs runs.
+ *
+ *  returns: Nothing.
+ */
+void _roaring_to_runs(roaring_t* r, roaring_container_t* c, uint32_t n_runs);
+
+#endif
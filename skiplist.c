@@ -0,0 +1,635 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a lock free skip list, an ordered map that threads
+         insert into, remove from, search and scan at once without locks.
+         Every level is a sorted list linked with compare and swap. Removal
+         marks the low bit of each successor of a node, top down, and the
+         mark on level 0 decides which remover wins. Searches that meet a
+         marked node unlink it. Removed nodes are retired to epoch.h, which
+         frees them once no thread can still be reading them.
+
+         An inserter links the upper levels of its node after level 0 and
+         can link one of them just after a remover has unlinked the rest.
+         It checks for the mark once done and unlinks the node again, from
+         within the critical section it was in when the node was retired.
+         EPOCH_GRACE covers exactly that, so a node is retired once, by its
+         remover, together with its key and value.
+*/
+
+#include "skiplist.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "alloctrack.h"
+
+#define SKIPLIST_MARK ((uintptr_t)1)
+
+static _Thread_local uint64_t height_state = 0;
+
+static inline skiplist_node_t* _skiplist_ptr(uintptr_t link) {
+    return (skiplist_node_t*)(link & ~SKIPLIST_MARK);
+}
+
+static inline bool _skiplist_marked(uintptr_t link) {
+    return link & SKIPLIST_MARK;
+}
+
+static inline uintptr_t _skiplist_load(uintptr_t* link) {
+    return __atomic_load_n(link, __ATOMIC_ACQUIRE);
+}
+
+static inline bool _skiplist_cas(uintptr_t* link, uintptr_t* expected,
+                uintptr_t desired) {
+    return __atomic_compare_exchange_n(link, expected, desired, false,
+                __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE);
+}
+
+/**** PUBLIC ****/
+
+/*
+ * Function: skiplist_create
+ * --------------------
+ *  Creates a new skip list.
+ *
+ *  compare: Function ordering two keys.
+ *
+ *  returns: Pointer to the new list.
+ */
+skiplist_t* skiplist_create(compare_t compare) {
+    return skiplist_create_with_allocator(compare, NULL);
+}
+
+/*
+ * Function: skiplist_create_with_allocator
+ * --------------------
+ *  Creates a new skip list whose nodes come from an allocator. Nodes are
+ *  freed by whichever thread reclaims them, so the allocator must allow
+ *  frees from any thread.
+ *
+ *  compare: Function ordering two keys.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new list.
+ */
+skiplist_t* skiplist_create_with_allocator(compare_t compare,
+                const allocator_t* allocator) {
+    assert(compare);
+    allocator_t alloc = allocator_resolve(allocator);
+
+    skiplist_t* sl = allocator_alloc(&alloc, sizeof(skiplist_t));
+    assert(sl);
+
+    sl->compare = compare;
+    sl->allocator = alloc;
+    sl->head = _skiplist_new_node(sl, NULL, NULL, SKIPLIST_MAX_LEVEL);
+    for (size_t level = 0; level < SKIPLIST_MAX_LEVEL; level++) {
+        sl->head->next[level] = 0;
+    }
+
+    return sl;
+}
+
+/*
+ * Function: skiplist_insert
+ * --------------------
+ *  Inserts a key if it is absent. A present key keeps its value, as
+ *  replacing it could free a value another thread is reading.
+ *
+ *  sl: Pointer to the list.
+ *  key: Key.
+ *  value: Value.
+ *
+ *  returns: True if the key was inserted, false if present.
+ */
+bool skiplist_insert(skiplist_t* sl, void* key, void* value) {
+    assert(sl);
+    skiplist_node_t* preds[SKIPLIST_MAX_LEVEL];
+    skiplist_node_t* succs[SKIPLIST_MAX_LEVEL];
+    size_t height = _skiplist_random_height();
+    skiplist_node_t* node = NULL;
+
+    epoch_enter();
+
+    // Publishing on level 0 is the insertion, it fails only to a change
+    // between the search and the swap
+    while (true) {
+        if (_skiplist_find(sl, key, preds, succs)) {
+            if (node) {
+                allocator_free(&sl->allocator, node,
+                            _skiplist_node_size(height));
+            }
+            epoch_exit();
+            return false;
+        }
+
+        if (!node) {
+            node = _skiplist_new_node(sl, key, value, height);
+        }
+        for (size_t level = 0; level < height; level++) {
+            node->next[level] = (uintptr_t)succs[level];
+        }
+
+        uintptr_t expected = (uintptr_t)succs[0];
+        if (_skiplist_cas(&preds[0]->next[0], &expected, (uintptr_t)node)) {
+            break;
+        }
+    }
+
+    // Upper levels only speed up searches, linking stops at a removal
+    for (size_t level = 1; level < height; level++) {
+        while (true) {
+            uintptr_t next = _skiplist_load(&node->next[level]);
+            uintptr_t succ = (uintptr_t)succs[level];
+
+            // The node's own links change only here and by being marked
+            if (_skiplist_marked(next) || (next != succ &&
+                        !_skiplist_cas(&node->next[level], &next, succ))) {
+                goto linked;
+            }
+
+            uintptr_t expected = succ;
+            if (_skiplist_cas(&preds[level]->next[level], &expected,
+                        (uintptr_t)node)) {
+                break;
+            }
+
+            _skiplist_find(sl, key, preds, succs);
+            if (succs[0] != node) {
+                goto linked;
+            }
+        }
+    }
+
+linked:
+    // A remover may have unlinked the node before the last link went in
+    if (_skiplist_marked(_skiplist_load(&node->next[0]))) {
+        _skiplist_find(sl, key, preds, succs);
+    }
+
+    epoch_exit();
+    return true;
+}
+
+/*
+ * Function: skiplist_search
+ * --------------------
+ *  Searches for a key without writing to the list. A value freed on
+ *  removal must be read inside an epoch_enter section around the call.
+ *
+ *  sl: Pointer to the list.
+ *  key: Key to search for.
+ *
+ *  returns: Value of the key, NULL if not found.
+ */
+void* skiplist_search(skiplist_t* sl, void* key) {
+    assert(sl);
+    void* value = NULL;
+
+    epoch_enter();
+    skiplist_node_t* node = _skiplist_lower_bound(sl, key);
+    if (node && !sl->compare(node->key, key)) {
+        value = node->value;
+    }
+    epoch_exit();
+
+    return value;
+}
+
+/*
+ * Function: skiplist_contains
+ * --------------------
+ *  Checks if a key is in the list.
+ *
+ *  sl: Pointer to the list.
+ *  key: Key to check for.
+ *
+ *  returns: True if found, false otherwise.
+ */
+bool skiplist_contains(skiplist_t* sl, void* key) {
+    assert(sl);
+
+    epoch_enter();
+    skiplist_node_t* node = _skiplist_lower_bound(sl, key);
+    bool found = node && !sl->compare(node->key, key);
+    epoch_exit();
+
+    return found;
+}
+
+/*
+ * Function: skiplist_remove
+ * --------------------
+ *  Removes a key. The node, key and value are retired rather than freed,
+ *  concurrent readers may still hold them.
+ *
+ *  sl: Pointer to the list.
+ *  key: Key to remove.
+ *  free_key: Function to free the stored key, may be NULL.
+ *  free_value: Function to free the value, may be NULL.
+ *
+ *  returns: True if this call removed the key, false if not found.
+ */
+bool skiplist_remove(skiplist_t* sl, void* key, free_skiplist_t free_key,
+                free_skiplist_t free_value) {
+    assert(sl);
+    skiplist_node_t* preds[SKIPLIST_MAX_LEVEL];
+    skiplist_node_t* succs[SKIPLIST_MAX_LEVEL];
+
+    epoch_enter();
+
+    if (!_skiplist_find(sl, key, preds, succs)) {
+        epoch_exit();
+        return false;
+    }
+    skiplist_node_t* node = succs[0];
+
+    // Marking the upper levels first keeps searches from descending into
+    // a node that is already gone below
+    for (size_t level = node->height - 1; level >= 1; level--) {
+        uintptr_t next = _skiplist_load(&node->next[level]);
+        while (!_skiplist_marked(next) && !_skiplist_cas(&node->next[level],
+                    &next, next | SKIPLIST_MARK));
+    }
+
+    uintptr_t next = _skiplist_load(&node->next[0]);
+    while (true) {
+        if (_skiplist_marked(next)) {
+            // Another remover won
+            epoch_exit();
+            return false;
+        }
+        if (_skiplist_cas(&node->next[0], &next, next | SKIPLIST_MARK)) {
+            break;
+        }
+    }
+
+    // Unlink from every level before retiring
+    _skiplist_find(sl, key, preds, succs);
+
+    if (free_key) {
+        epoch_retire_fn(free_key, node->key);
+    }
+    if (free_value) {
+        epoch_retire_fn(free_value, node->value);
+    }
+    epoch_retire(&sl->allocator, node, _skiplist_node_size(node->height));
+
+    epoch_exit();
+    return true;
+}
+
+/*
+ * Function: skiplist_iter_first
+ * --------------------
+ *  Starts a scan of every key in order.
+ *
+ *  sl: Pointer to the list.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void skiplist_iter_first(skiplist_t* sl, skiplist_iter_t* iter) {
+    assert(sl);
+    assert(iter);
+
+    epoch_enter();
+    iter->sl = sl;
+    iter->node = _skiplist_ptr(_skiplist_load(&sl->head->next[0]));
+    iter->end = NULL;
+    iter->bounded = false;
+    iter->open = true;
+}
+
+/*
+ * Function: skiplist_iter_seek
+ * --------------------
+ *  Starts a scan at the first key not less than low.
+ *
+ *  sl: Pointer to the list.
+ *  low: Key to start from.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void skiplist_iter_seek(skiplist_t* sl, void* low, skiplist_iter_t* iter) {
+    assert(sl);
+    assert(iter);
+
+    epoch_enter();
+    iter->sl = sl;
+    iter->node = _skiplist_lower_bound(sl, low);
+    iter->end = NULL;
+    iter->bounded = false;
+    iter->open = true;
+}
+
+/*
+ * Function: skiplist_range
+ * --------------------
+ *  Starts a scan of the keys in [low, high).
+ *
+ *  sl: Pointer to the list.
+ *  low: Inclusive lower bound.
+ *  high: Exclusive upper bound.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void skiplist_range(skiplist_t* sl, void* low, void* high,
+                skiplist_iter_t* iter) {
+    skiplist_iter_seek(sl, low, iter);
+    iter->end = high;
+    iter->bounded = true;
+}
+
+/*
+ * Function: skiplist_iter_next
+ * --------------------
+ *  Gets the next key and value of a scan, skipping removed keys. The scan
+ *  is closed once it returns false.
+ *
+ *  iter: Pointer to the iterator.
+ *  key: Output key, may be NULL.
+ *  value: Output value, may be NULL.
+ *
+ *  returns: True if a key was produced, false at the end of the scan.
+ */
+bool skiplist_iter_next(skiplist_iter_t* iter, void** key, void** value) {
+    assert(iter);
+
+    while (iter->node) {
+        skiplist_node_t* node = iter->node;
+        uintptr_t next = _skiplist_load(&node->next[0]);
+        iter->node = _skiplist_ptr(next);
+        DSL_PREFETCH(iter->node);
+
+        if (_skiplist_marked(next)) {
+            continue;
+        }
+        if (iter->bounded && iter->sl->compare(node->key, iter->end) >= 0) {
+            break;
+        }
+
+        if (key) {
+            *key = node->key;
+        }
+        if (value) {
+            *value = node->value;
+        }
+        return true;
+    }
+
+    skiplist_iter_close(iter);
+    return false;
+}
+
+/*
+ * Function: skiplist_iter_close
+ * --------------------
+ *  Ends a scan early, leaving its critical section. Closing a finished
+ *  scan does nothing.
+ *
+ *  iter: Pointer to the iterator.
+ *
+ *  returns: Nothing.
+ */
+void skiplist_iter_close(skiplist_iter_t* iter) {
+    assert(iter);
+
+    if (iter->open) {
+        iter->node = NULL;
+        iter->open = false;
+        epoch_exit();
+    }
+}
+
+/*
+ * Function: skiplist_size
+ * --------------------
+ *  Counts the keys by walking the bottom level, there is no shared counter
+ *  for every insert to contend on. Exact only while no thread writes.
+ *
+ *  sl: Pointer to the list.
+ *
+ *  returns: Number of keys.
+ */
+size_t skiplist_size(skiplist_t* sl) {
+    assert(sl);
+    size_t size = 0;
+
+    epoch_enter();
+    uintptr_t link = _skiplist_load(&sl->head->next[0]);
+    while (_skiplist_ptr(link)) {
+        link = _skiplist_load(&_skiplist_ptr(link)->next[0]);
+        size += !_skiplist_marked(link);
+    }
+    epoch_exit();
+
+    return size;
+}
+
+/*
+ * Function: skiplist_clean
+ * --------------------
+ *  Frees the list. No other thread may be using it, nodes already removed
+ *  are freed by epoch.h.
+ *
+ *  sl: Pointer to the list.
+ *  free_key: Function to free keys, may be NULL.
+ *  free_value: Function to free values, may be NULL.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void skiplist_clean(skiplist_t* sl, free_skiplist_t free_key,
+                free_skiplist_t free_value) {
+    assert(sl);
+    allocator_t allocator = sl->allocator;
+
+    // Every removal has finished, so nodes on level 0 are exactly the live
+    // ones and none of them is retired
+    skiplist_node_t* node = _skiplist_ptr(sl->head->next[0]);
+    while (node) {
+        skiplist_node_t* next = _skiplist_ptr(node->next[0]);
+        if (free_key) {
+            free_key(node->key);
+        }
+        if (free_value) {
+            free_value(node->value);
+        }
+        allocator_free(&allocator, node, _skiplist_node_size(node->height));
+        node = next;
+    }
+
+    allocator_free(&allocator, sl->head,
+                _skiplist_node_size(SKIPLIST_MAX_LEVEL));
+    allocator_free(&allocator, sl, sizeof(skiplist_t));
+    // No ALLOCTRACK_CLEANED, retired nodes may still wait in limbo lists
+}
+
+/*
+ * Function: skiplist_memory_usage
+ * --------------------
+ *  Gets the memory sl uses by walking it. The head tower is buckets, nodes
+ *  with their towers are nodes. Keys, values and retired nodes are not
+ *  counted.
+ *
+ *  sl: Pointer to the list.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t skiplist_memory_usage(skiplist_t* sl, memory_usage_t* usage) {
+    assert(sl);
+    assert(usage);
+    memset(usage, 0, sizeof(memory_usage_t));
+
+    allocator_account(&sl->allocator, sizeof(skiplist_t), 1, &usage->header,
+                usage);
+    allocator_account(&sl->allocator, _skiplist_node_size(SKIPLIST_MAX_LEVEL),
+                1, &usage->buckets, usage);
+
+    epoch_enter();
+    skiplist_node_t* node = _skiplist_ptr(_skiplist_load(&sl->head->next[0]));
+    while (node) {
+        allocator_account(&sl->allocator, _skiplist_node_size(node->height),
+                    1, &usage->nodes, usage);
+        node = _skiplist_ptr(_skiplist_load(&node->next[0]));
+    }
+    epoch_exit();
+
+    return usage->total;
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _skiplist_new_node
+ * --------------------
+ *  Allocates a node with a tower of height levels.
+ *
+ *  returns: Pointer to the node.
+ */
+skiplist_node_t* _skiplist_new_node(skiplist_t* sl, void* key, void* value,
+                size_t height) {
+    skiplist_node_t* node = allocator_alloc(&sl->allocator,
+                _skiplist_node_size(height));
+    assert(node);
+
+    node->key = key;
+    node->value = value;
+    node->height = (uint32_t)height;
+
+    return node;
+}
+
+/*
+ * Function: _skiplist_node_size
+ * --------------------
+ *  Gets the allocation size of a node with a tower of height levels.
+ *
+ *  returns: Size in bytes.
+ */
+size_t _skiplist_node_size(size_t height) {
+    return sizeof(skiplist_node_t) + height * sizeof(uintptr_t);
+}
+
+/*
+ * Function: _skiplist_random_height
+ * --------------------
+ *  Draws a tower height from the calling thread's generator.
+ *
+ *  returns: Height, 1 to SKIPLIST_MAX_LEVEL.
+ */
+size_t _skiplist_random_height(void) {
+    // xorshift64*, seeded from the thread's own state address
+    if (DSL_UNLIKELY(!height_state)) {
+        height_state = (uint64_t)(uintptr_t)&height_state *
+                    0x9E3779B97F4A7C15ULL | 1;
+    }
+    height_state ^= height_state >> 12;
+    height_state ^= height_state << 25;
+    height_state ^= height_state >> 27;
+    uint64_t bits = height_state * 0x2545F4914F6CDD1DULL;
+
+    const uint64_t level_mask = (1ULL << SKIPLIST_LEVEL_BITS) - 1;
+    size_t height = 1;
+    while (height < SKIPLIST_MAX_LEVEL && !(bits & level_mask)) {
+        bits >>= SKIPLIST_LEVEL_BITS;
+        height++;
+    }
+
+    return height;
+}
+
+/*
+ * Function: _skiplist_find
+ * --------------------
+ *  Finds the predecessor and successor of key on every level, unlinking
+ *  removed nodes on the way. Must run in a critical section.
+ *
+ *  returns: True if the successor on level 0 holds key.
+ */
+bool _skiplist_find(skiplist_t* sl, void* key, skiplist_node_t** preds,
+                skiplist_node_t** succs) {
+retry:;
+    skiplist_node_t* pred = sl->head;
+    skiplist_node_t* curr = NULL;
+
+    for (size_t level = SKIPLIST_MAX_LEVEL; level-- > 0;) {
+        curr = _skiplist_ptr(_skiplist_load(&pred->next[level]));
+
+        while (curr) {
+            uintptr_t next = _skiplist_load(&curr->next[level]);
+            if (_skiplist_marked(next)) {
+                // A removed pred makes the swap fail, start over from head
+                uintptr_t expected = (uintptr_t)curr;
+                if (!_skiplist_cas(&pred->next[level], &expected,
+                            next & ~SKIPLIST_MARK)) {
+                    goto retry;
+                }
+                curr = _skiplist_ptr(next);
+                continue;
+            }
+            if (sl->compare(curr->key, key) >= 0) {
+                break;
+            }
+            pred = curr;
+            curr = _skiplist_ptr(next);
+        }
+
+        preds[level] = pred;
+        succs[level] = curr;
+    }
+
+    return curr && !sl->compare(curr->key, key);
+}
+
+/*
+ * Function: _skiplist_lower_bound
+ * --------------------
+ *  Gets the first node not removed whose key is not less than key, without
+ *  writing. Must run in a critical section.
+ *
+ *  returns: Pointer to the node, NULL if every key is less.
+ */
+skiplist_node_t* _skiplist_lower_bound(skiplist_t* sl, void* key) {
+    skiplist_node_t* pred = sl->head;
+    skiplist_node_t* curr = NULL;
+
+    for (size_t level = SKIPLIST_MAX_LEVEL; level-- > 0;) {
+        curr = _skiplist_ptr(_skiplist_load(&pred->next[level]));
+
+        while (curr) {
+            uintptr_t next = _skiplist_load(&curr->next[level]);
+            if (!_skiplist_marked(next)) {
+                if (sl->compare(curr->key, key) >= 0) {
+                    break;
+                }
+                pred = curr;
+            }
+            curr = _skiplist_ptr(next);
+        }
+    }
+
+    return curr;
+}
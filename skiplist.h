@@ -0,0 +1,306 @@
+#ifndef SKIPLIST_H
+#define SKIPLIST_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "hashtable.h"
+#include "allocator.h"
+#include "epoch.h"
+#include "hints.h"
+
+// Tallest tower, enough for 4^16 keys at the default branching
+#define SKIPLIST_MAX_LEVEL 16
+// A tower grows another level with probability 1 / 2^SKIPLIST_LEVEL_BITS.
+// At 1/4 three nodes in four are a single level of 32 bytes, two to a
+// cache line, and searches cross half as many levels as at 1/2 for the
+// same number of comparisons.
+#define SKIPLIST_LEVEL_BITS 2
+
+typedef void (* free_skiplist_t)(void*);
+
+typedef struct skiplist_node skiplist_node_t;
+
+/*
+ * Node with a tower of height successors. The low bit of a successor marks
+ * the node removed at that level, marks go top down and the mark on level
+ * 0 is the removal itself.
+ */
+struct skiplist_node {
+    void* key;
+    void* value;
+    uint32_t height;
+    uintptr_t next[];
+};
+
+/*
+ * Lock free ordered map after Fraser and Herlihy, Shavit. Any number of
+ * threads may insert, remove, search and scan at once. Nodes unlinked by
+ * one thread are freed through epoch.h once no other can still hold them.
+ * compare must return negative, zero or positive.
+ */
+typedef struct skiplist {
+    // Sentinel with a tower of SKIPLIST_MAX_LEVEL, never compared
+    skiplist_node_t* head;
+    compare_t compare;
+    // Source of the list and its nodes, must be thread safe
+    allocator_t allocator;
+} skiplist_t;
+
+/*
+ * Position in a scan, from skiplist_iter_first, skiplist_iter_seek or
+ * skiplist_range. Holds a critical section from start to end, so keys
+ * removed meanwhile stay readable. Scans see every key present throughout
+ * and may or may not see those inserted or removed concurrently.
+ */
+typedef struct skiplist_iter {
+    skiplist_t* sl;
+    skiplist_node_t* node;
+    // Exclusive upper bound of a range
+    void* end;
+    bool bounded;
+    // Inside its critical section
+    bool open;
+} skiplist_iter_t;
+
+/**** PUBLIC ****/
+
+/*
+ * Function: skiplist_create
+ * --------------------
+ *  Creates a new skip list.
+ *
+ *  compare: Function ordering two keys.
+ *
+ *  returns: Pointer to the new list.
+ */
+skiplist_t* skiplist_create(compare_t compare);
+
+/*
+ * Function: skiplist_create_with_allocator
+ * --------------------
+ *  Creates a new skip list whose nodes come from an allocator. Nodes are
+ *  freed by whichever thread reclaims them, so the allocator must allow
+ *  frees from any thread.
+ *
+ *  compare: Function ordering two keys.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new list.
+ */
+skiplist_t* skiplist_create_with_allocator(compare_t compare,
+                const allocator_t* allocator);
+
+/*
+ * Function: skiplist_insert
+ * --------------------
+ *  Inserts a key if it is absent. A present key keeps its value, as
+ *  replacing it could free a value another thread is reading.
+ *
+ *  sl: Pointer to the list.
+ *  key: Key.
+ *  value: Value.
+ *
+ *  returns: True if the key was inserted, false if present.
+ */
+bool skiplist_insert(skiplist_t* sl, void* key, void* value);
+
+/*
+ * Function: skiplist_search
+ * --------------------
+ *  Searches for a key without writing to the list. A value freed on
+ *  removal must be read inside an epoch_enter section around the call.
+ *
+ *  sl: Pointer to the list.
+ *  key: Key to search for.
+ *
+ *  returns: Value of the key, NULL if not found.
+ */
+void* skiplist_search(skiplist_t* sl, void* key);
+
+/*
+ * Function: skiplist_contains
+ * --------------------
+ *  Checks if a key is in the list.
+ *
+ *  sl: Pointer to the list.
+ *  key: Key to check for.
+ *
+ *  returns: True if found, false otherwise.
+ */
+bool skiplist_contains(skiplist_t* sl, void* key);
+
+/*
+ * Function: skiplist_remove
+ * --------------------
+ *  Removes a key. The node, key and value are retired rather than freed,
+ *  concurrent readers may still hold them.
+ *
+ *  sl: Pointer to the list.
+ *  key: Key to remove.
+ *  free_key: Function to free the stored key, may be NULL.
+ *  free_value: Function to free the value, may be NULL.
+ *
+ *  returns: True if this call removed the key, false if not found.
+ */
+bool skiplist_remove(skiplist_t* sl, void* key, free_skiplist_t free_key,
+                free_skiplist_t free_value);
+
+/*
+ * Function: skiplist_iter_first
+ * --------------------
+ *  Starts a scan of every key in order.
+ *
+ *  sl: Pointer to the list.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void skiplist_iter_first(skiplist_t* sl, skiplist_iter_t* iter);
+
+/*
+ * Function: skiplist_iter_seek
+ * --------------------
+ *  Starts a scan at the first key not less than low.
+ *
+ *  sl: Pointer to the list.
+ *  low: Key to start from.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void skiplist_iter_seek(skiplist_t* sl, void* low, skiplist_iter_t* iter);
+
+/*
+ * Function: skiplist_range
+ * --------------------
+ *  Starts a scan of the keys in [low, high).
+ *
+ *  sl: Pointer to the list.
+ *  low: Inclusive lower bound.
+ *  high: Exclusive upper bound.
+ *  iter: Output iterator.
+ *
+ *  returns: Nothing.
+ */
+void skiplist_range(skiplist_t* sl, void* low, void* high,
+                skiplist_iter_t* iter);
+
+/*
+ * Function: skiplist_iter_next
+ * --------------------
+ *  Gets the next key and value of a scan, skipping removed keys. The scan
+ *  is closed once it returns false.
+ *
+ *  iter: Pointer to the iterator.
+ *  key: Output key, may be NULL.
+ *  value: Output value, may be NULL.
+ *
+ *  returns: True if a key was produced, false at the end of the scan.
+ */
+bool skiplist_iter_next(skiplist_iter_t* iter, void** key, void** value);
+
+/*
+ * Function: skiplist_iter_close
+ * --------------------
+ *  Ends a scan early, leaving its critical section. Closing a finished
+ *  scan does nothing.
+ *
+ *  iter: Pointer to the iterator.
+ *
+ *  returns: Nothing.
+ */
+void skiplist_iter_close(skiplist_iter_t* iter);
+
+/*
+ * Function: skiplist_size
+ * --------------------
+ *  Counts the keys by walking the bottom level, there is no shared counter
+ *  for every insert to contend on. Exact only while no thread writes.
+ *
+ *  sl: Pointer to the list.
+ *
+ *  returns: Number of keys.
+ */
+size_t skiplist_size(skiplist_t* sl);
+
+/*
+ * Function: skiplist_clean
+ * --------------------
+ *  Frees the list. No other thread may be using it, nodes already removed
+ *  are freed by epoch.h.
+ *
+ *  sl: Pointer to the list.
+ *  free_key: Function to free keys, may be NULL.
+ *  free_value: Function to free values, may be NULL.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void skiplist_clean(skiplist_t* sl, free_skiplist_t free_key,
+                free_skiplist_t free_value);
+
+/*
+ * Function: skiplist_memory_usage
+ * --------------------
+ *  Gets the memory sl uses by walking it. The head tower is buckets, nodes
+ *  with their towers are nodes. Keys, values and retired nodes are not
+ *  counted.
+ *
+ *  sl: Pointer to the list.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t skiplist_memory_usage(skiplist_t* sl, memory_usage_t* usage);
+
+/**** PRIVATE ****/
+/*
+ * Function: _skiplist_new_node
+ * --------------------
+ *  Allocates a node with a tower of height levels.
+ *
+ *  returns: Pointer to the node.
+ */
+skiplist_node_t* _skiplist_new_node(skiplist_t* sl, void* key, void* value,
+                size_t height);
+
+/*
+ * Function: _skiplist_node_size
+ * --------------------
+ *  Gets the allocation size of a node with a tower of height levels.
+ *
+ *  returns: Size in bytes.
+ */
+size_t _skiplist_node_size(size_t height);
+
+/*
+ * Function: _skiplist_random_height
+ * --------------------
+ *  Draws a tower height from the calling thread's generator.
+ *
+ *  returns: Height, 1 to SKIPLIST_MAX_LEVEL.
+ */
+size_t _skiplist_random_height(void);
+
+/*
+ * Function: _skiplist_find
+ * --------------------
+ *  Finds the predecessor and successor of key on every level, unlinking
+ *  removed nodes on the way. Must run in a critical section.
+ *
+ *  returns: True if the successor on level 0 holds key.
+ */
+bool _skiplist_find(skiplist_t* sl, void* key, skiplist_node_t** preds,
+                skiplist_node_t** succs);
+
+/*
+ * Function: _skiplist_lower_bound
+ * --------------------
+ *  Gets the first node not removed whose key is not less than key, without
+ *  writing. Must run in a critical section.
+ *
+ *  returns: Pointer to the node, NULL if every key is less.
+ */
+skiplist_node_t* _skiplist_lower_bound(skiplist_t* sl, void* key);
+
+#endif
@@ -0,0 +1,357 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a custom small object allocator in the style of
+         Bonwick's magazines. Each thread caches objects per size class in
+         two magazines, so allocation and free are a lock free array push or
+         pop. Whole magazines are exchanged with a mutex protected central
+         depot, once per SLAB_MAGAZINE_SIZE operations at most. Objects can
+         be freed by any thread, they simply join that thread's cache.
+         Memory is kept for reuse and never returned to the system.
+*/
+
+#include "slab.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <pthread.h>
+
+// Multiples of 16, so objects are aligned for any type as malloc's are
+static const size_t class_sizes[SLAB_N_CLASSES] = { 16, 32, 48, 64 };
+
+// Size class of each size rounded up to 8 bytes, indexed by (size + 7) / 8
+static const unsigned char class_lookup[SLAB_MAX_SIZE / 8 + 1] = {
+    0, 0, 0, 1, 1, 2, 2, 3, 3
+};
+
+static slab_depot_t depot = { .lock = PTHREAD_MUTEX_INITIALIZER };
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local slab_cache_t cache;
+
+/**** PUBLIC ****/
+
+/*
+ * Function: slab_alloc
+ * --------------------
+ *  Allocates a small object from the calling thread's cache, sizes above
+ *  SLAB_MAX_SIZE go to malloc. Objects are 16 byte aligned like malloc's.
+ *  Slab memory is never returned to the OS, freed objects stay cached for
+ *  reuse by the same size class for the life of the process.
+ *
+ *  size: Number of bytes.
+ *
+ *  returns: Pointer to the memory.
+ */
+void* slab_alloc(size_t size) {
+    if (size > SLAB_MAX_SIZE) {
+        return malloc(size);
+    }
+
+    size_t class = class_lookup[(size + 7) / 8];
+    slab_magazine_t* magazine = cache.loaded[class];
+
+    // Fast path, pop from the loaded magazine
+    if (magazine && magazine->n_objects) {
+        return magazine->objects[--magazine->n_objects];
+    }
+
+    // Previous magazine has objects, swap it in
+    if (cache.previous[class] && cache.previous[class]->n_objects) {
+        cache.loaded[class] = cache.previous[class];
+        cache.previous[class] = magazine;
+        magazine = cache.loaded[class];
+        return magazine->objects[--magazine->n_objects];
+    }
+
+    return _slab_refill(&cache, class);
+}
+
+/*
+ * Function: slab_free
+ * --------------------
+ *  Frees an object from slab_alloc into the calling thread's cache, which
+ *  need not be the thread that allocated it.
+ *
+ *  ptr: Pointer to the memory, may be NULL.
+ *  size: Size it was allocated with.
+ *
+ *  returns: Nothing.
+ */
+void slab_free(void* ptr, size_t size) {
+    if (!ptr) {
+        return;
+    }
+    if (size > SLAB_MAX_SIZE) {
+        free(ptr);
+        return;
+    }
+
+    size_t class = class_lookup[(size + 7) / 8];
+    slab_magazine_t* magazine = cache.loaded[class];
+
+    // Fast path, push onto the loaded magazine
+    if (magazine && magazine->n_objects < SLAB_MAGAZINE_SIZE) {
+        magazine->objects[magazine->n_objects++] = ptr;
+        return;
+    }
+
+    // Previous magazine has room, swap it in
+    if (cache.previous[class] &&
+                cache.previous[class]->n_objects < SLAB_MAGAZINE_SIZE) {
+        cache.loaded[class] = cache.previous[class];
+        cache.previous[class] = magazine;
+        magazine = cache.loaded[class];
+        magazine->objects[magazine->n_objects++] = ptr;
+        return;
+    }
+
+    _slab_spill(&cache, class, ptr);
+}
+
+/*
+ * Function: slab_allocator
+ * --------------------
+ *  Gets the allocator backed by slab_alloc and slab_free.
+ *
+ *  No parameters.
+ *
+ *  returns: The slab allocator.
+ */
+allocator_t slab_allocator(void) {
+    allocator_t allocator = {
+        _slab_allocator_alloc, _slab_allocator_free, NULL, NULL
+    };
+    return allocator;
+}
+
+/*
+ * Function: slab_size_class
+ * --------------------
+ *  Gets the size class of an allocation size.
+ *
+ *  size: Number of bytes, at most SLAB_MAX_SIZE.
+ *
+ *  returns: Index of the size class.
+ */
+size_t slab_size_class(size_t size) {
+    assert(size <= SLAB_MAX_SIZE);
+    return class_lookup[(size + 7) / 8];
+}
+
+/*
+ * Function: slab_class_bytes
+ * --------------------
+ *  Gets the bytes an object of a given size really takes.
+ *
+ *  size: Number of bytes, at most SLAB_MAX_SIZE.
+ *
+ *  returns: Size of the object's class.
+ */
+size_t slab_class_bytes(size_t size) {
+    return class_sizes[slab_size_class(size)];
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _slab_refill
+ * --------------------
+ *  Gets an object when both magazines of a class are empty, from a depot
+ *  magazine or else by filling a magazine from the thread's current block.
+ *
+ *  returns: Pointer to the object.
+ */
+void* _slab_refill(slab_cache_t* cache, size_t class) {
+    slab_magazine_t* full = NULL, * magazine = cache->loaded[class];
+    size_t size = class_sizes[class];
+
+    if (!cache->registered) {
+        _slab_register(cache);
+    }
+
+    // Trade the empty loaded magazine for a full one from the depot
+    pthread_mutex_lock(&depot.lock);
+    if ((full = depot.full[class])) {
+        depot.full[class] = full->next;
+        depot.n_full[class]--;
+        if (magazine) {
+            magazine->next = depot.empty;
+            depot.empty = magazine;
+        }
+    }
+    pthread_mutex_unlock(&depot.lock);
+
+    if (full) {
+        cache->loaded[class] = full;
+        return full->objects[--full->n_objects];
+    }
+
+    // Depot is dry, fill the loaded magazine from the thread's block
+    if (!magazine) {
+        magazine = cache->loaded[class] = _slab_empty_magazine();
+    }
+    while (magazine->n_objects < SLAB_MAGAZINE_SIZE) {
+        if (!cache->bump[class] ||
+                    cache->bump[class] + size > cache->bump_end[class]) {
+            char* block = malloc(SLAB_BLOCK_SIZE);
+            assert(block);
+            cache->bump[class] = block;
+            cache->bump_end[class] = block + SLAB_BLOCK_SIZE;
+
+            pthread_mutex_lock(&depot.lock);
+            depot.n_blocks++;
+            pthread_mutex_unlock(&depot.lock);
+        }
+
+        magazine->objects[magazine->n_objects++] = cache->bump[class];
+        cache->bump[class] += size;
+    }
+
+    return magazine->objects[--magazine->n_objects];
+}
+
+/*
+ * Function: _slab_spill
+ * --------------------
+ *  Frees an object when both magazines of a class are full, sending one to
+ *  the depot.
+ *
+ *  returns: Nothing.
+ */
+void _slab_spill(slab_cache_t* cache, size_t class, void* ptr) {
+    slab_magazine_t* full = cache->previous[class];
+
+    if (!cache->registered) {
+        _slab_register(cache);
+    }
+
+    // Give the full previous magazine to the depot
+    if (full) {
+        pthread_mutex_lock(&depot.lock);
+        full->next = depot.full[class];
+        depot.full[class] = full;
+        depot.n_full[class]++;
+        pthread_mutex_unlock(&depot.lock);
+    }
+
+    // Loaded becomes previous, start a new empty loaded magazine
+    cache->previous[class] = cache->loaded[class];
+    cache->loaded[class] = _slab_empty_magazine();
+    cache->loaded[class]->objects[cache->loaded[class]->n_objects++] = ptr;
+}
+
+/*
+ * Function: _slab_register
+ * --------------------
+ *  Registers the calling thread's cache so it is flushed to the depot when
+ *  the thread exits.
+ *
+ *  returns: Nothing.
+ */
+void _slab_register(slab_cache_t* cache) {
+    pthread_once(&cache_key_once, _slab_key_create);
+    pthread_setspecific(cache_key, cache);
+    cache->registered = true;
+}
+
+/*
+ * Function: _slab_key_create
+ * --------------------
+ *  Creates the thread key whose destructor flushes thread caches.
+ *
+ *  returns: Nothing.
+ */
+void _slab_key_create(void) {
+    pthread_key_create(&cache_key, _slab_flush);
+}
+
+/*
+ * Function: _slab_flush
+ * --------------------
+ *  Thread exit destructor, gives every magazine of a cache to the depot.
+ *
+ *  returns: Nothing.
+ */
+void _slab_flush(void* _cache) {
+    slab_cache_t* cache = _cache;
+    slab_magazine_t* magazines[2];
+
+    pthread_mutex_lock(&depot.lock);
+    for (size_t class = 0; class < SLAB_N_CLASSES; class++) {
+        magazines[0] = cache->loaded[class];
+        magazines[1] = cache->previous[class];
+
+        for (size_t i = 0; i < 2; i++) {
+            if (!magazines[i]) {
+                continue;
+            }
+            if (magazines[i]->n_objects) {
+                magazines[i]->next = depot.full[class];
+                depot.full[class] = magazines[i];
+                depot.n_full[class]++;
+            } else {
+                magazines[i]->next = depot.empty;
+                depot.empty = magazines[i];
+            }
+        }
+
+        // Rest of the block is lost, it is at most a block per class
+        cache->loaded[class] = NULL;
+        cache->previous[class] = NULL;
+        cache->bump[class] = NULL;
+        cache->bump_end[class] = NULL;
+    }
+    pthread_mutex_unlock(&depot.lock);
+
+    cache->registered = false;
+}
+
+/*
+ * Function: _slab_empty_magazine
+ * --------------------
+ *  Gets an empty magazine from the depot, or a new one.
+ *
+ *  returns: Pointer to the magazine.
+ */
+slab_magazine_t* _slab_empty_magazine(void) {
+    slab_magazine_t* magazine = NULL;
+
+    pthread_mutex_lock(&depot.lock);
+    if ((magazine = depot.empty)) {
+        depot.empty = magazine->next;
+    }
+    pthread_mutex_unlock(&depot.lock);
+
+    if (!magazine) {
+        magazine = malloc(sizeof(slab_magazine_t));
+        assert(magazine);
+    }
+
+    magazine->next = NULL;
+    magazine->n_objects = 0;
+    return magazine;
+}
+
+/*
+ * Function: _slab_allocator_alloc
+ * --------------------
+ *  slab_alloc backend of the slab allocator.
+ *
+ *  returns: Pointer to the memory.
+ */
+void* _slab_allocator_alloc(void* ctx, size_t size) {
+    (void)ctx;
+    return slab_alloc(size);
+}
+
+/*
+ * Function: _slab_allocator_free
+ * --------------------
+ *  slab_free backend of the slab allocator.
+ *
+ *  returns: Nothing.
+ */
+void _slab_allocator_free(void* ctx, void* ptr, size_t size) {
+    (void)ctx;
+    slab_free(ptr, size);
+}
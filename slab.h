@@ -0,0 +1,185 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "allocator.h"
+
+// Size classes cover ht, DLL, queue, stack and RAG nodes and keys, in
+// steps of 16 bytes to keep malloc's alignment
+#define SLAB_N_CLASSES 4
+#define SLAB_MAX_SIZE 64
+#define SLAB_MAGAZINE_SIZE 64
+#define SLAB_BLOCK_SIZE (64 * 1024)
+
+typedef struct slab_magazine slab_magazine_t;
+
+struct slab_magazine {
+    slab_magazine_t* next;
+    size_t n_objects;
+    void* objects[SLAB_MAGAZINE_SIZE];
+};
+
+/*
+ * Per thread cache, two magazines per class so alternating allocs and frees
+ * at a magazine boundary don't go to the depot every time.
+ */
+typedef struct slab_cache {
+    slab_magazine_t* loaded[SLAB_N_CLASSES];
+    slab_magazine_t* previous[SLAB_N_CLASSES];
+    // Unused tail of the thread's current block, per class
+    char* bump[SLAB_N_CLASSES];
+    char* bump_end[SLAB_N_CLASSES];
+    bool registered;
+} slab_cache_t;
+
+/*
+ * Central depot shared by all threads, exchanged with a whole magazine at a
+ * time.
+ */
+typedef struct slab_depot {
+    pthread_mutex_t lock;
+    slab_magazine_t* full[SLAB_N_CLASSES];
+    slab_magazine_t* empty;
+    size_t n_full[SLAB_N_CLASSES];
+    size_t n_blocks;
+} slab_depot_t;
+
+/*
+ * Function: slab_alloc
+ * --------------------
+ *  Allocates a small object from the calling thread's cache, sizes above
+ *  SLAB_MAX_SIZE go to malloc. Objects are 16 byte aligned like malloc's.
+ *  Slab memory is never returned to the OS, freed objects stay cached for
+ *  reuse by the same size class for the life of the process.
+ *
+ *  size: Number of bytes.
+ *
+ *  returns: Pointer to the memory.
+ */
+void* slab_alloc(size_t size);
+
+/*
+ * Function: slab_free
+ * --------------------
+ *  Frees an object from slab_alloc into the calling thread's cache, which
+ *  need not be the thread that allocated it.
+ *
+ *  ptr: Pointer to the memory, may be NULL.
+ *  size: Size it was allocated with.
+ *
+ *  returns: Nothing.
+ */
+void slab_free(void* ptr, size_t size);
+
+/*
+ * Function: slab_allocator
+ * --------------------
+ *  Gets the allocator backed by slab_alloc and slab_free.
+ *
+ *  No parameters.
+ *
+ *  returns: The slab allocator.
+ */
+allocator_t slab_allocator(void);
+
+/*
+ * Function: slab_size_class
+ * --------------------
+ *  Gets the size class of an allocation size.
+ *
+ *  size: Number of bytes, at most SLAB_MAX_SIZE.
+ *
+ *  returns: Index of the size class.
+ */
+size_t slab_size_class(size_t size);
+
+/*
+ * Function: slab_class_bytes
+ * --------------------
+ *  Gets the bytes an object of a given size really takes.
+ *
+ *  size: Number of bytes, at most SLAB_MAX_SIZE.
+ *
+ *  returns: Size of the object's class.
+ */
+size_t slab_class_bytes(size_t size);
+
+/**** PRIVATE ****/
+/*
+ * Function: _slab_refill
+ * --------------------
+ *  Gets an object when both magazines of a class are empty, from a depot
+ *  magazine or else by filling a magazine from the thread's current block.
+ *
+ *  returns: Pointer to the object.
+ */
+void* _slab_refill(slab_cache_t* cache, size_t class);
+
+/*
+ * Function: _slab_spill
+ * --------------------
+ *  Frees an object when both magazines of a class are full, sending one to
+ *  the depot.
+ *
+ *  returns: Nothing.
+ */
+void _slab_spill(slab_cache_t* cache, size_t class, void* ptr);
+
+/*
+ * Function: _slab_register
+ * --------------------
+ *  Registers the calling thread's cache so it is flushed to the depot when
+ *  the thread exits.
+ *
+ *  returns: Nothing.
+ */
+void _slab_register(slab_cache_t* cache);
+
+/*
+ * Function: _slab_key_create
+ * --------------------
+ *  Creates the thread key whose destructor flushes thread caches.
+ *
+ *  returns: Nothing.
+ */
+void _slab_key_create(void);
+
+/*
+ * Function: _slab_flush
+ * --------------------
+ *  Thread exit destructor, gives every magazine of a cache to the depot.
+ *
+ *  returns: Nothing.
+ */
+void _slab_flush(void* cache);
+
+/*
+ * Function: _slab_empty_magazine
+ * --------------------
+ *  Gets an empty magazine from the depot, or a new one.
+ *
+ *  returns: Pointer to the magazine.
+ */
+slab_magazine_t* _slab_empty_magazine(void);
+
+/*
+ * Function: _slab_allocator_alloc
+ * --------------------
+ *  slab_alloc backend of the slab allocator.
+ *
+ *  returns: Pointer to the memory.
+ */
+void* _slab_allocator_alloc(void* ctx, size_t size);
+
+/*
+ * Function: _slab_allocator_free
+ * --------------------
+ *  slab_free backend of the slab allocator.
+ *
+ *  returns: Nothing.
+ */
+void _slab_allocator_free(void* ctx, void* ptr, size_t size);
+
+#endif
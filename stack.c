@@ -6,7 +6,11 @@ Purpose: This file is a custom stack library.
 #include "stack.h"
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <assert.h>
+#include "pool.h"
+#include "metrics.h"
+#include "alloctrack.h"
 
 /*
  * Function: stack_create
@@ -18,9 +22,56 @@ Purpose: This file is a custom stack library.
  *  returns: Pointer to the new stack.
  */
 stack_t* stack_create(void) {
-    stack_t* stack = malloc(sizeof(stack_t));
+    return stack_create_with_allocator(NULL);
+}
+
+/*
+ * Function: stack_create_with_allocator
+ * --------------------
+ *  Creates a new stack whose memory comes from an allocator.
+ * 
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ * 
+ *  returns: Pointer to the new stack.
+ */
+stack_t* stack_create_with_allocator(const allocator_t* allocator) {
+    allocator_t alloc = allocator_resolve(allocator);
+
+    stack_t* stack = allocator_alloc(&alloc, sizeof(stack_t));
     assert(stack);
     stack->head = NULL;
+    stack->n_elements = 0;
+    stack->allocator = alloc;
+    stack->block = NULL;
+    return stack;
+}
+
+/*
+ * Function: stack_create_fixed
+ * --------------------
+ *  Creates a fixed capacity stack backed by a single allocation. It never 
+ *  allocates afterwards, use stack_try_push to get a full error rather than
+ *  an assert.
+ * 
+ *  capacity: Maximum number of nodes.
+ * 
+ *  returns: Pointer to the new stack.
+ */
+stack_t* stack_create_fixed(size_t capacity) {
+    // Stack and node pool in one block
+    char* block = malloc(sizeof(stack_t) + 
+                pool_bytes(sizeof(stack_node_t), capacity));
+    assert(block);
+    ALLOCTRACK_NOTE(sizeof(stack_t) + 
+                pool_bytes(sizeof(stack_node_t), capacity));
+    stack_t* stack = (stack_t*)block;
+    pool_t* pool = pool_init(block + sizeof(stack_t), sizeof(stack_node_t),
+                capacity);
+
+    stack->head = NULL;
+    stack->n_elements = 0;
+    stack->allocator = pool_allocator(pool);
+    stack->block = block;
     return stack;
 }
 
@@ -35,9 +86,7 @@ stack_t* stack_create(void) {
  *  returns: Pointer to the new stack.
  */
 stack_t* stack_create_from_array(void** node_array, size_t n_nodes) {
-    stack_t* stack = malloc(sizeof(stack_t));
-    assert(stack);
-    stack->head = NULL;
+    stack_t* stack = stack_create();
 
     // Create stack nodes from array
     for (size_t i = 0; i < n_nodes; i++) {
@@ -58,9 +107,7 @@ stack_t* stack_create_from_array(void** node_array, size_t n_nodes) {
  *  returns: Pointer to the new stack.
  */
 stack_t* stack_create_from_linkedlist(void* node, get_next_t get_next) {
-    stack_t* stack = malloc(sizeof(stack_t));
-    assert(stack);
-    stack->head = NULL;
+    stack_t* stack = stack_create();
 
     // Create stack nodes from linked list
     while (node) {
@@ -82,12 +129,36 @@ stack_t* stack_create_from_linkedlist(void* node, get_next_t get_next) {
  *  returns: Nothing.
  */
 void stack_push(stack_t* stack, void* data) {
+    bool pushed = stack_try_push(stack, data);
+    assert(pushed);
+    (void)pushed;
+}
+
+/*
+ * Function: stack_try_push
+ * --------------------
+ *  Pushes a new node to the stack.
+ * 
+ *  stack: Pointer to the stack.
+ *  data: Data to insert.
+ * 
+ *  returns: False if the node could not be allocated, as when a fixed 
+ *           capacity stack is full, true otherwise.
+ */
+bool stack_try_push(stack_t* stack, void* data) {
     assert(stack);
-    stack_node_t* node = malloc(sizeof(stack_node_t));
-    assert(node);
+    stack_node_t* node = allocator_alloc(&stack->allocator, 
+                sizeof(stack_node_t));
+    if (!node) {
+        return false;
+    }
+    METRICS_COUNT(METRICS_STACK, METRICS_INSERTS);
+    METRICS_ALLOC(METRICS_STACK, sizeof(stack_node_t));
     node->data = data;
     node->next = stack->head;
     stack->head = node;
+    stack->n_elements++;
+    return true;
 }
 
 /*
@@ -108,29 +179,15 @@ void* stack_pop(stack_t* stack) {
     if (node) {
         data = node->data;
         stack->head = node->next;
-        free(node);
+        stack->n_elements--;
+        allocator_free(&stack->allocator, node, sizeof(stack_node_t));
+        METRICS_COUNT(METRICS_STACK, METRICS_REMOVES);
+        METRICS_FREE(METRICS_STACK, sizeof(stack_node_t));
     }
 
     return data;
 }
 
-/*
- * Function: stack_peek
- * --------------------
- *  Peeks the top node from the stack.
- * 
- *  stack: Pointer to the stack.
- * 
- *  returns: Pointer to the data of the top node.
- */
-void* stack_peek(stack_t* stack) {
-    assert(stack);
-    if (!(stack->head)) {
-        return NULL;
-    }
-    return stack->head->data;
-}
-
 /*
  * Function: stack_pop_free
  * --------------------
@@ -146,43 +203,77 @@ void stack_pop_free(stack_t* stack, free_stack_t free_data) {
     assert(stack);
     stack_node_t* node = stack->head;
     stack->head = node->next;
+    stack->n_elements--;
 
     // Free data if function is given
     if (free_data) {
         free_data(node->data);
     }
 
-    free(node);
+    allocator_free(&stack->allocator, node, sizeof(stack_node_t));
+    METRICS_COUNT(METRICS_STACK, METRICS_REMOVES);
+    METRICS_FREE(METRICS_STACK, sizeof(stack_node_t));
 }
 
 /*
- * Function: stack_is_empty
+ * Function: stack_clean
  * --------------------
- *  Checks if the stack is empty.
+ *  Cleans the stack.
  * 
  *  stack: Pointer to the stack.
+ *  free_data: Function pointer to free the data.
  * 
- *  returns: True if stack is empty, false otherwise.
+ *  returns: Nothing.
  */
-bool stack_is_empty(stack_t* stack) {
+DSL_COLD void stack_clean(stack_t* stack, free_stack_t free_data) {
     assert(stack);
-    return !(stack->head);
+    const void* owner = &stack->allocator;
+    // Bulk allocators free the nodes on reset and fixed capacity nodes go 
+    // with the block
+    bool owns_nodes = !allocator_is_bulk(&stack->allocator) && !stack->block;
+    while (!stack_is_empty(stack) && (owns_nodes || free_data)) {
+        stack_pop_free(stack, free_data);
+    }
+    if (stack->block) {
+        free(stack->block);
+        return;
+    }
+    allocator_free(&stack->allocator, stack, sizeof(stack_t));
+    if (owns_nodes) {
+        ALLOCTRACK_CLEANED(owner);
+    }
 }
 
 /*
- * Function: stack_clean
+ * Function: stack_memory_usage
  * --------------------
- *  Cleans the stack.
+ *  Gets the memory stack uses, from its counts rather than by walking it.
+ *  Data is not counted.
  * 
  *  stack: Pointer to the stack.
- *  free_data: Function pointer to free the data.
+ *  usage: Output breakdown.
  * 
- *  returns: Nothing.
+ *  returns: Total bytes.
  */
-void stack_clean(stack_t* stack, free_stack_t free_data) {
+size_t stack_memory_usage(stack_t* stack, memory_usage_t* usage) {
     assert(stack);
-    while (!stack_is_empty(stack)) {
-        stack_pop_free(stack, free_data);
+    assert(usage);
+    memset(usage, 0, sizeof(memory_usage_t));
+
+    // Fixed capacity stacks are one block holding the node pool
+    if (stack->block) {
+        pool_t* pool = stack->allocator.ctx;
+        usage->header = sizeof(stack_t);
+        usage->nodes = sizeof(stack_node_t) * stack->n_elements;
+        allocator_account_block(sizeof(stack_t) +
+                    pool_bytes(sizeof(stack_node_t), pool->n_slots), usage);
+        return usage->total;
     }
-    free(stack);
-}
\ No newline at end of file
+
+    allocator_account(&stack->allocator, sizeof(stack_t), 1, &usage->header,
+                usage);
+    allocator_account(&stack->allocator, sizeof(stack_node_t),
+                stack->n_elements, &usage->nodes, usage);
+
+    return usage->total;
+}
@@ -3,6 +3,9 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <assert.h>
+#include "allocator.h"
+#include "hints.h"
 
 typedef void (* free_stack_t)(void*);
 typedef void* (* get_next_t)(void*);
@@ -16,6 +19,11 @@ struct stack_node {
 
 typedef struct stack {
     stack_node_t* head;
+    size_t n_elements;
+    // Source of the stack and its nodes
+    allocator_t allocator;
+    // Single allocation of a fixed capacity stack, NULL otherwise
+    void* block;
 } stack_t;
 
 /*
@@ -29,6 +37,30 @@ typedef struct stack {
  */
 stack_t* stack_create(void);
 
+/*
+ * Function: stack_create_with_allocator
+ * --------------------
+ *  Creates a new stack whose memory comes from an allocator.
+ * 
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ * 
+ *  returns: Pointer to the new stack.
+ */
+stack_t* stack_create_with_allocator(const allocator_t* allocator);
+
+/*
+ * Function: stack_create_fixed
+ * --------------------
+ *  Creates a fixed capacity stack backed by a single allocation. It never 
+ *  allocates afterwards, use stack_try_push to get a full error rather than
+ *  an assert.
+ * 
+ *  capacity: Maximum number of nodes.
+ * 
+ *  returns: Pointer to the new stack.
+ */
+stack_t* stack_create_fixed(size_t capacity);
+
 /*
  * Function: stack_create_from_array
  * --------------------
@@ -65,6 +97,19 @@ stack_t* stack_create_from_linkedlist(void* node, get_next_t get_next);
  */
 void stack_push(stack_t* stack, void* data);
 
+/*
+ * Function: stack_try_push
+ * --------------------
+ *  Pushes a new node to the stack.
+ * 
+ *  stack: Pointer to the stack.
+ *  data: Data to insert.
+ * 
+ *  returns: False if the node could not be allocated, as when a fixed 
+ *           capacity stack is full, true otherwise.
+ */
+bool stack_try_push(stack_t* stack, void* data);
+
 /*
  * Function: stack_peek
  * --------------------
@@ -74,7 +119,13 @@ void stack_push(stack_t* stack, void* data);
  * 
  *  returns: Pointer to the data of the top node.
  */
-void* stack_peek(stack_t* stack);
+DSL_INLINE void* stack_peek(stack_t* stack) {
+    assert(stack);
+    if (!(stack->head)) {
+        return NULL;
+    }
+    return stack->head->data;
+}
 
 /*
  * Function: stack_pop
@@ -109,7 +160,10 @@ void stack_pop_free(stack_t* stack, free_stack_t free_data);
  * 
  *  returns: True if stack is empty, false otherwise.
  */
-bool stack_is_empty(stack_t* stack);
+DSL_INLINE bool stack_is_empty(stack_t* stack) {
+    assert(stack);
+    return !(stack->head);
+}
 
 /*
  * Function: stack_clean
@@ -121,6 +175,19 @@ bool stack_is_empty(stack_t* stack);
  * 
  *  returns: Nothing.
  */
-void stack_clean(stack_t* stack, free_stack_t free_data);
+DSL_COLD void stack_clean(stack_t* stack, free_stack_t free_data);
+
+/*
+ * Function: stack_memory_usage
+ * --------------------
+ *  Gets the memory stack uses, from its counts rather than by walking it.
+ *  Data is not counted.
+ * 
+ *  stack: Pointer to the stack.
+ *  usage: Output breakdown.
+ * 
+ *  returns: Total bytes.
+ */
+size_t stack_memory_usage(stack_t* stack, memory_usage_t* usage);
 
 #endif
\ No newline at end of file
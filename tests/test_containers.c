@@ -0,0 +1,814 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a randomized differential test of the containers
+         against plain reference models: bptree_t and art_t against sorted
+         key universes with a value per key, roaring_t against a byte map,
+         vector_t, deque_t, vqueue_t, vstack_t and vDLL_t against arrays.
+         Every run applies a seeded random mix of operations to both and
+         compares each result, and every CHECK_EVERY operations compares
+         whole contents, order and derived answers such as ranges, ranks
+         and set operations. A failure prints the seed to replay it.
+
+Build  : cc -O2 -I.. test_containers.c ../bptree.c ../art.c ../roaring.c \
+             ../vector.c ../deque.c ../vqueue.c ../vstack.c \
+             ../vdlinkedlist.c ../allocator.c ../slab.c ../arena.c \
+             ../pool.c -lm -lpthread -o test_containers
+Usage  : ./test_containers [ops] [seed]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "bptree.h"
+#include "art.h"
+#include "roaring.h"
+#include "vector.h"
+#include "deque.h"
+#include "vqueue.h"
+#include "vstack.h"
+#include "vdlinkedlist.h"
+
+#define DEFAULT_OPS 200000
+#define CHECK_EVERY 4096
+
+#define BPTREE_KEYS 20000
+// Spread between integer keys, so keys aren't dense
+#define BPTREE_STRIDE 7919
+#define ART_CANDIDATES 8000
+#define ART_MAX_LEN 8
+// Roaring values fall below this, 64 containers
+#define ROARING_RANGE (1u << 22)
+#define SEQ_MAX 6000
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s (seed %llu)\n", \
+                        __FILE__, __LINE__, #cond, \
+                        (unsigned long long)seed); \
+            exit(EXIT_FAILURE); \
+        } \
+    } while (0)
+
+typedef struct art_key {
+    uint8_t bytes[ART_MAX_LEN];
+    size_t len;
+} art_key_t;
+
+static uint64_t seed = 1;
+static uint64_t rng;
+static size_t ops = DEFAULT_OPS;
+
+static uint64_t next_random(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+static size_t below(size_t n) {
+    return next_random() % n;
+}
+
+static int u64_order(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/* B+-TREE */
+
+/*
+ * Function: bptree_key
+ * --------------------
+ *  Gets the key of a reference slot, pointer trees get a pointer to it.
+ *
+ *  returns: Key as passed to the tree.
+ */
+static void* bptree_key(bool ints, const uint64_t* keys, size_t i) {
+    return ints ? BPTREE_INT_KEY(keys[i]) : (void*)&keys[i];
+}
+
+/*
+ * Function: bptree_check_scan
+ * --------------------
+ *  Checks a scan of slots [low, high) of the reference produces exactly
+ *  the present keys in order with their values.
+ *
+ *  returns: Nothing.
+ */
+static void bptree_check_scan(bptree_iter_t* iter, bool ints,
+                const uint64_t* keys, void** ref, size_t low, size_t high) {
+    void* key, * value;
+    size_t i = low;
+
+    while (bptree_iter_next(iter, &key, &value)) {
+        while (i < high && !ref[i]) {
+            i++;
+        }
+        CHECK(i < high);
+        CHECK(key == bptree_key(ints, keys, i));
+        CHECK(value == ref[i]);
+        i++;
+    }
+    while (i < high) {
+        CHECK(!ref[i++]);
+    }
+}
+
+/*
+ * Function: test_bptree
+ * --------------------
+ *  Runs the B+-tree against a value per slot of a sorted key universe,
+ *  as an integer tree or, with ints false, a pointer tree with a compare.
+ *  Half of the runs start from a bulk load.
+ *
+ *  returns: Nothing.
+ */
+static void test_bptree(bool ints) {
+    static uint64_t keys[BPTREE_KEYS];
+    static void* ref[BPTREE_KEYS];
+    size_t n = 0;
+
+    for (size_t i = 0; i < BPTREE_KEYS; i++) {
+        keys[i] = (uint64_t)i * BPTREE_STRIDE + 1;
+        ref[i] = NULL;
+    }
+    bptree_t* bt = ints ? bptree_create_int() : bptree_create(u64_order);
+
+    if (next_random() & 1) {
+        static void* load_keys[BPTREE_KEYS];
+        static void* load_values[BPTREE_KEYS];
+        size_t m = 0;
+        for (size_t i = 0; i < BPTREE_KEYS; i++) {
+            if (below(3) == 0) {
+                ref[i] = (void*)(uintptr_t)(next_random() | 1);
+                load_keys[m] = bptree_key(ints, keys, i);
+                load_values[m++] = ref[i];
+            }
+        }
+        bptree_bulk_load(bt, load_keys, load_values, m);
+        n = m;
+    }
+
+    for (size_t op = 1; op <= ops; op++) {
+        size_t i = below(BPTREE_KEYS);
+        void* key = bptree_key(ints, keys, i);
+        size_t r = below(100);
+
+        if (r < 40) {
+            void* value = (void*)(uintptr_t)(next_random() | 1);
+            CHECK(bptree_insert(bt, key, value) == !ref[i]);
+            n += !ref[i];
+            ref[i] = value;
+        } else if (r < 70) {
+            CHECK(bptree_remove(bt, key, NULL, NULL) == !!ref[i]);
+            n -= !!ref[i];
+            ref[i] = NULL;
+        } else {
+            CHECK(bptree_search(bt, key) == ref[i]);
+            CHECK(bptree_contains(bt, key) == !!ref[i]);
+        }
+        CHECK(bptree_size(bt) == n);
+
+        if (op % CHECK_EVERY == 0) {
+            bptree_iter_t iter;
+            bptree_iter_first(bt, &iter);
+            bptree_check_scan(&iter, ints, keys, ref, 0, BPTREE_KEYS);
+
+            size_t low = below(BPTREE_KEYS), high = low + below(2000);
+            high = high > BPTREE_KEYS ? BPTREE_KEYS : high;
+            if (high == BPTREE_KEYS) {
+                bptree_iter_seek(bt, bptree_key(ints, keys, low), &iter);
+            } else {
+                bptree_range(bt, bptree_key(ints, keys, low),
+                            bptree_key(ints, keys, high), &iter);
+            }
+            bptree_check_scan(&iter, ints, keys, ref, low, high);
+        }
+    }
+
+    // Misses between and around the keys
+    if (ints) {
+        CHECK(!bptree_contains(bt, BPTREE_INT_KEY(0)));
+        for (size_t i = 0; i < BPTREE_KEYS; i += 97) {
+            CHECK(!bptree_search(bt, BPTREE_INT_KEY(keys[i] + 1)));
+        }
+    }
+    bptree_clean(bt, NULL, NULL);
+    printf("test_containers: bptree %s ok\n", ints ? "int" : "compare");
+}
+
+/* ADAPTIVE RADIX TREE */
+
+/*
+ * Function: art_key_order
+ * --------------------
+ *  Orders keys as the tree does, bytewise with shorter keys first.
+ *
+ *  returns: Negative, zero or positive.
+ */
+static int art_key_order(const void* a, const void* b) {
+    const art_key_t* x = a, * y = b;
+    size_t len = x->len < y->len ? x->len : y->len;
+    int cmp = memcmp(x->bytes, y->bytes, len);
+    if (cmp) {
+        return cmp;
+    }
+    return (x->len > y->len) - (x->len < y->len);
+}
+
+/*
+ * Function: art_make_keys
+ * --------------------
+ *  Makes a sorted universe of distinct keys. Most bytes come from a small
+ *  alphabet so keys share prefixes and are prefixes of each other, some
+ *  from all 256 values so nodes grow to Node48 and Node256.
+ *
+ *  returns: Number of keys.
+ */
+static size_t art_make_keys(art_key_t* keys) {
+    static const uint8_t alphabet[] = { 0x00, 'a', 'b', 0xff };
+
+    for (size_t i = 0; i < ART_CANDIDATES; i++) {
+        keys[i].len = 1 + below(ART_MAX_LEN);
+        for (size_t j = 0; j < keys[i].len; j++) {
+            keys[i].bytes[j] = below(4) ? alphabet[below(4)] :
+                        (uint8_t)next_random();
+        }
+    }
+    qsort(keys, ART_CANDIDATES, sizeof(art_key_t), art_key_order);
+    size_t n = 1;
+    for (size_t i = 1; i < ART_CANDIDATES; i++) {
+        if (art_key_order(&keys[i], &keys[n - 1])) {
+            keys[n++] = keys[i];
+        }
+    }
+    return n;
+}
+
+/*
+ * Function: art_has_prefix
+ * --------------------
+ *  Checks if a key starts with prefix, every key does if prefix_len is 0.
+ *
+ *  returns: True if it does, false otherwise.
+ */
+static bool art_has_prefix(const art_key_t* key, const uint8_t* prefix,
+                size_t prefix_len) {
+    return !prefix_len || (key->len >= prefix_len &&
+                !memcmp(key->bytes, prefix, prefix_len));
+}
+
+/*
+ * Function: art_check_scan
+ * --------------------
+ *  Checks a scan produces, in order, exactly the present keys of the
+ *  reference in [low, high) that start with prefix.
+ *
+ *  returns: Nothing.
+ */
+static void art_check_scan(art_iter_t* iter, const art_key_t* keys,
+                void** ref, size_t low, size_t high, const uint8_t* prefix,
+                size_t prefix_len) {
+    const uint8_t* key;
+    size_t key_len, i = low;
+    void* value;
+
+    while (art_iter_next(iter, &key, &key_len, &value)) {
+        while (i < high && (!ref[i] || !art_has_prefix(&keys[i], prefix,
+                    prefix_len))) {
+            i++;
+        }
+        CHECK(i < high);
+        CHECK(key_len == keys[i].len);
+        CHECK(!memcmp(key, keys[i].bytes, key_len));
+        CHECK(value == ref[i]);
+        i++;
+    }
+    for (; i < high; i++) {
+        CHECK(!ref[i] || !art_has_prefix(&keys[i], prefix, prefix_len));
+    }
+}
+
+/*
+ * Function: test_art
+ * --------------------
+ *  Runs the adaptive radix tree against a value per key of a sorted key
+ *  universe, with full, range, seek and prefix scans.
+ *
+ *  returns: Nothing.
+ */
+static void test_art(void) {
+    static art_key_t keys[ART_CANDIDATES];
+    static void* ref[ART_CANDIDATES];
+    size_t n_keys = art_make_keys(keys), n = 0;
+
+    memset(ref, 0, sizeof(ref));
+    art_t* art = art_create();
+
+    for (size_t op = 1; op <= ops; op++) {
+        size_t i = below(n_keys);
+        art_key_t* key = &keys[i];
+        size_t r = below(100);
+
+        if (r < 40) {
+            void* value = (void*)(uintptr_t)(next_random() | 1);
+            CHECK(art_insert(art, key->bytes, key->len, value) == !ref[i]);
+            n += !ref[i];
+            ref[i] = value;
+        } else if (r < 70) {
+            CHECK(art_remove(art, key->bytes, key->len, NULL) == !!ref[i]);
+            n -= !!ref[i];
+            ref[i] = NULL;
+        } else {
+            CHECK(art_search(art, key->bytes, key->len) == ref[i]);
+            CHECK(art_contains(art, key->bytes, key->len) == !!ref[i]);
+        }
+        CHECK(art_size(art) == n);
+
+        if (op % CHECK_EVERY == 0) {
+            art_iter_t iter;
+            art_iter_first(art, &iter);
+            art_check_scan(&iter, keys, ref, 0, n_keys, NULL, 0);
+
+            size_t low = below(n_keys), high = low + below(500);
+            if (high >= n_keys) {
+                art_iter_seek(art, keys[low].bytes, keys[low].len, &iter);
+                art_check_scan(&iter, keys, ref, low, n_keys, NULL, 0);
+            } else {
+                art_range(art, keys[low].bytes, keys[low].len,
+                            keys[high].bytes, keys[high].len, &iter);
+                art_check_scan(&iter, keys, ref, low, high, NULL, 0);
+            }
+
+            // Prefix of a key, the scan covers every key from there on
+            // that still starts with it
+            size_t prefix_len = below(keys[i].len + 1);
+            size_t first = i;
+            while (first > 0 && art_has_prefix(&keys[first - 1],
+                        keys[i].bytes, prefix_len)) {
+                first--;
+            }
+            art_prefix(art, keys[i].bytes, prefix_len, &iter);
+            art_check_scan(&iter, keys, ref, first, n_keys, keys[i].bytes,
+                        prefix_len);
+        }
+    }
+
+    art_clean(art, NULL);
+    printf("test_containers: art ok, %zu keys\n", n_keys);
+}
+
+/* ROARING BITMAP */
+
+/*
+ * Function: roaring_pick
+ * --------------------
+ *  Picks a value, dense in the first containers so they become bitsets,
+ *  sparse elsewhere so they stay arrays.
+ *
+ *  returns: Value.
+ */
+static uint32_t roaring_pick(void) {
+    if (next_random() & 1) {
+        return below(3 * 65536);
+    }
+    return below(ROARING_RANGE);
+}
+
+/*
+ * Function: roaring_check
+ * --------------------
+ *  Checks a bitmap holds exactly the values set in a byte map, through
+ *  iteration, to_array, cardinality, rank and select.
+ *
+ *  returns: Nothing.
+ */
+static void roaring_check(const roaring_t* r, const uint8_t* ref) {
+    static uint32_t array[ROARING_RANGE];
+    roaring_iter_t iter;
+    uint32_t value = 0;
+    uint64_t count = 0;
+
+    roaring_iter_init(r, &iter);
+    for (uint32_t v = 0; v < ROARING_RANGE; v++) {
+        if (ref[v]) {
+            CHECK(roaring_iter_next(&iter, &value));
+            CHECK(value == v);
+            count++;
+        }
+    }
+    CHECK(!roaring_iter_next(&iter, &value));
+    CHECK(roaring_cardinality(r) == count);
+    CHECK(roaring_to_array(r, array) == count);
+
+    for (size_t k = 0; k < 64 && count; k++) {
+        size_t rank = below(count);
+        CHECK(roaring_select(r, rank, &value));
+        CHECK(value == array[rank]);
+        CHECK(roaring_rank(r, value) == rank + 1);
+    }
+    CHECK(!roaring_select(r, count, &value));
+}
+
+/*
+ * Function: roaring_check_op
+ * --------------------
+ *  Checks a set operation, both as a new bitmap and in place on a copy.
+ *
+ *  returns: Nothing.
+ */
+static void roaring_check_op(const roaring_t* a, const roaring_t* b,
+                const uint8_t* ref_a, const uint8_t* ref_b, int op) {
+    static uint8_t expected[ROARING_RANGE];
+    roaring_t* (* make[])(const roaring_t*, const roaring_t*) = {
+        roaring_and, roaring_or, roaring_xor, roaring_andnot
+    };
+    void (* inplace[])(roaring_t*, const roaring_t*) = {
+        roaring_and_inplace, roaring_or_inplace, roaring_xor_inplace,
+        roaring_andnot_inplace
+    };
+
+    for (uint32_t v = 0; v < ROARING_RANGE; v++) {
+        uint8_t x = ref_a[v], y = ref_b[v];
+        expected[v] = op == 0 ? x & y : op == 1 ? x | y :
+                    op == 2 ? x ^ y : x & !y;
+    }
+    roaring_t* result = make[op](a, b);
+    roaring_check(result, expected);
+    roaring_clean(result);
+
+    result = roaring_copy(a);
+    inplace[op](result, b);
+    roaring_check(result, expected);
+    roaring_clean(result);
+}
+
+/*
+ * Function: test_roaring
+ * --------------------
+ *  Runs two roaring bitmaps against byte maps, with ranges, optimize,
+ *  serialization round trips and every set operation between them.
+ *
+ *  returns: Nothing.
+ */
+static void test_roaring(void) {
+    static uint8_t ref[2][ROARING_RANGE];
+    roaring_t* r[2] = { roaring_create(), roaring_create() };
+
+    memset(ref, 0, sizeof(ref));
+    for (size_t op = 1; op <= ops; op++) {
+        size_t which = below(2), k = below(100);
+        uint32_t v = roaring_pick();
+
+        if (k < 45) {
+            CHECK(roaring_add(r[which], v) == !ref[which][v]);
+            ref[which][v] = 1;
+        } else if (k < 80) {
+            CHECK(roaring_remove(r[which], v) == ref[which][v]);
+            ref[which][v] = 0;
+        } else if (k < 81) {
+            uint64_t high = v + below(70000);
+            high = high > ROARING_RANGE ? ROARING_RANGE : high;
+            uint64_t added = 0;
+            for (uint64_t u = v; u < high; u++) {
+                added += !ref[which][u];
+                ref[which][u] = 1;
+            }
+            CHECK(roaring_add_range(r[which], v, high) == added);
+        } else {
+            CHECK(roaring_contains(r[which], v) == ref[which][v]);
+        }
+
+        if (op % (CHECK_EVERY * 8) == 0) {
+            roaring_check(r[which], ref[which]);
+            if (next_random() & 1) {
+                roaring_optimize(r[which]);
+                roaring_check(r[which], ref[which]);
+            }
+
+            size_t size = roaring_serialized_size(r[which]);
+            void* buf = malloc(size);
+            CHECK(buf != NULL);
+            CHECK(roaring_serialize(r[which], buf) == size);
+            roaring_t* copy = roaring_deserialize(buf, size, NULL);
+            CHECK(copy != NULL);
+            roaring_check(copy, ref[which]);
+            CHECK(roaring_deserialize(buf, size - 1, NULL) == NULL);
+            roaring_clean(copy);
+            free(buf);
+
+            roaring_check_op(r[0], r[1], ref[0], ref[1], below(4));
+        }
+    }
+
+    roaring_clear(r[0]);
+    memset(ref[0], 0, sizeof(ref[0]));
+    roaring_check(r[0], ref[0]);
+    roaring_clean(r[0]);
+    roaring_clean(r[1]);
+    printf("test_containers: roaring ok\n");
+}
+
+/* VECTOR */
+
+/*
+ * Function: test_vector
+ * --------------------
+ *  Runs a vector of uint32_t against an array, with insert, erase, find,
+ *  count and min / max over small values so there are duplicates.
+ *
+ *  returns: Nothing.
+ */
+static void test_vector(void) {
+    static uint32_t ref[SEQ_MAX];
+    size_t n = 0;
+    vector_t* vec = vector_create(sizeof(uint32_t));
+
+    for (size_t op = 1; op <= ops; op++) {
+        size_t r = below(100);
+        uint32_t v = below(64), out;
+
+        if (r < 30 && n < SEQ_MAX) {
+            vector_push(vec, &v);
+            ref[n++] = v;
+        } else if (r < 45) {
+            CHECK(vector_pop(vec, &out) == (n > 0));
+            if (n) {
+                CHECK(out == ref[--n]);
+            }
+        } else if (r < 55 && n < SEQ_MAX) {
+            size_t i = below(n + 1);
+            vector_insert(vec, i, &v);
+            memmove(ref + i + 1, ref + i, (n - i) * sizeof(uint32_t));
+            ref[i] = v;
+            n++;
+        } else if (r < 62 && n) {
+            size_t i = below(n), count = below(n - i < 8 ? n - i + 1 : 8);
+            vector_erase(vec, i, count);
+            memmove(ref + i, ref + i + count,
+                        (n - i - count) * sizeof(uint32_t));
+            n -= count;
+        } else if (r < 70 && n) {
+            size_t i = below(n);
+            vector_set(vec, i, &v);
+            ref[i] = v;
+        } else if (r < 80) {
+            size_t first = VECTOR_NPOS, count = 0;
+            for (size_t i = 0; i < n; i++) {
+                if (ref[i] == v) {
+                    first = first == VECTOR_NPOS ? i : first;
+                    count++;
+                }
+            }
+            CHECK(vector_find(vec, &v) == first);
+            CHECK(vector_count(vec, &v) == count);
+        } else if (r < 85) {
+            uint32_t low = UINT32_MAX, high = 0, min, max;
+            for (size_t i = 0; i < n; i++) {
+                low = ref[i] < low ? ref[i] : low;
+                high = ref[i] > high ? ref[i] : high;
+            }
+            CHECK(vector_min(vec, VECTOR_UINT32, &min) == (n > 0));
+            CHECK(vector_max(vec, VECTOR_UINT32, &max) == (n > 0));
+            CHECK(!n || (min == low && max == high));
+        } else if (r < 86) {
+            vector_reserve(vec, n + below(1000));
+        } else if (r < 87) {
+            vector_shrink(vec);
+        } else if (r < 88 && below(8) == 0) {
+            vector_clear(vec);
+            n = 0;
+        } else if (n) {
+            size_t i = below(n);
+            CHECK(*(uint32_t*)vector_get(vec, i) == ref[i]);
+        }
+        CHECK(vector_size(vec) == n);
+
+        if (op % CHECK_EVERY == 0) {
+            CHECK(n == 0 ||
+                        !memcmp(vector_data(vec), ref, n * sizeof(uint32_t)));
+        }
+    }
+
+    vector_clean(vec);
+    printf("test_containers: vector ok\n");
+}
+
+/* DEQUE */
+
+/*
+ * Function: test_deque
+ * --------------------
+ *  Runs a deque against an array for an element size, checking that
+ *  elements stay where they are while they are in the deque.
+ *
+ *  returns: Nothing.
+ */
+static void test_deque(size_t elem_size) {
+    static uint8_t ref[SEQ_MAX * 32];
+    uint8_t elem[32], out[32];
+    size_t n = 0;
+    deque_t* dq = deque_create(elem_size);
+
+    for (size_t op = 1; op <= ops; op++) {
+        size_t r = below(100);
+        for (size_t b = 0; b < elem_size; b++) {
+            elem[b] = (uint8_t)next_random();
+        }
+        void* front = deque_front(dq);
+
+        if (r < 25 && n < SEQ_MAX) {
+            deque_push_back(dq, elem);
+            memcpy(ref + n * elem_size, elem, elem_size);
+            n++;
+            CHECK(!front || front == deque_front(dq));
+        } else if (r < 50 && n < SEQ_MAX) {
+            void* back = deque_back(dq);
+            deque_push_front(dq, elem);
+            memmove(ref + elem_size, ref, n * elem_size);
+            memcpy(ref, elem, elem_size);
+            n++;
+            CHECK(!back || back == deque_back(dq));
+        } else if (r < 62) {
+            CHECK(deque_pop_front(dq, out) == (n > 0));
+            if (n) {
+                CHECK(!memcmp(out, ref, elem_size));
+                memmove(ref, ref + elem_size, --n * elem_size);
+            }
+        } else if (r < 74) {
+            CHECK(deque_pop_back(dq, out) == (n > 0));
+            if (n) {
+                n--;
+                CHECK(!memcmp(out, ref + n * elem_size, elem_size));
+            }
+        } else if (r < 75 && below(16) == 0) {
+            deque_clear(dq);
+            n = 0;
+        } else if (r < 76) {
+            deque_trim(dq);
+        } else if (n) {
+            size_t i = below(n);
+            CHECK(!memcmp(deque_get(dq, i), ref + i * elem_size,
+                        elem_size));
+        }
+        CHECK(deque_size(dq) == n);
+        CHECK(deque_is_empty(dq) == !n);
+
+        if (op % CHECK_EVERY == 0) {
+            for (size_t i = 0; i < n; i++) {
+                CHECK(!memcmp(deque_get(dq, i), ref + i * elem_size,
+                            elem_size));
+            }
+        }
+    }
+
+    deque_clean(dq, NULL);
+    printf("test_containers: deque of %zu byte elements ok\n", elem_size);
+}
+
+/* BY VALUE QUEUE, STACK AND LIST */
+
+/*
+ * Function: test_vqueue_vstack
+ * --------------------
+ *  Runs a by value queue and stack against arrays.
+ *
+ *  returns: Nothing.
+ */
+static void test_vqueue_vstack(void) {
+    static uint64_t ref_queue[SEQ_MAX], ref_stack[SEQ_MAX];
+    size_t queue_head = 0, queue_n = 0, stack_n = 0;
+    vqueue_t* queue = vqueue_create(sizeof(uint64_t));
+    vstack_t* stack = vstack_create(sizeof(uint64_t));
+
+    for (size_t op = 1; op <= ops; op++) {
+        uint64_t v = next_random(), out;
+        size_t r = below(100);
+
+        if (r < 50 && queue_n < SEQ_MAX) {
+            vqueue_enqueue(queue, &v);
+            ref_queue[(queue_head + queue_n++) % SEQ_MAX] = v;
+            vstack_push(stack, &v);
+            ref_stack[stack_n++] = v;
+        } else {
+            CHECK(vqueue_dequeue(queue, &out) == (queue_n > 0));
+            if (queue_n) {
+                CHECK(out == ref_queue[queue_head]);
+                queue_head = (queue_head + 1) % SEQ_MAX;
+                queue_n--;
+            }
+            CHECK(vstack_pop(stack, &out) == (stack_n > 0));
+            if (stack_n) {
+                CHECK(out == ref_stack[--stack_n]);
+            }
+        }
+        uint64_t* peek = vqueue_peek(queue);
+        CHECK(queue_n ? *peek == ref_queue[queue_head] : !peek);
+        peek = vstack_peek(stack);
+        CHECK(stack_n ? *peek == ref_stack[stack_n - 1] : !peek);
+        CHECK(queue->n_elements == queue_n);
+        CHECK(stack->n_elements == stack_n);
+    }
+
+    vqueue_clean(queue);
+    vstack_clean(stack);
+    printf("test_containers: vqueue and vstack ok\n");
+}
+
+/*
+ * Function: test_vdll
+ * --------------------
+ *  Runs a by value list against an array of handles and values, removing
+ *  from both ends and the middle and walking both ways.
+ *
+ *  returns: Nothing.
+ */
+static void test_vdll(void) {
+    static uint32_t handles[SEQ_MAX];
+    static uint64_t values[SEQ_MAX];
+    size_t n = 0;
+    vDLL_t* dll = vDLL_create(sizeof(uint64_t));
+
+    for (size_t op = 1; op <= ops; op++) {
+        uint64_t v = next_random(), out;
+        size_t r = below(100);
+
+        if (r < 25 && n < SEQ_MAX) {
+            handles[n] = vDLL_insert_tail(dll, &v);
+            values[n++] = v;
+        } else if (r < 50 && n < SEQ_MAX) {
+            memmove(handles + 1, handles, n * sizeof(uint32_t));
+            memmove(values + 1, values, n * sizeof(uint64_t));
+            handles[0] = vDLL_insert_head(dll, &v);
+            values[0] = v;
+            n++;
+        } else if (r < 60) {
+            CHECK(vDLL_pop(dll, &out) == (n > 0));
+            if (n) {
+                CHECK(out == values[0]);
+                n--;
+                memmove(handles, handles + 1, n * sizeof(uint32_t));
+                memmove(values, values + 1, n * sizeof(uint64_t));
+            }
+        } else if (r < 70) {
+            CHECK(vDLL_dequeue(dll, &out) == (n > 0));
+            if (n) {
+                CHECK(out == values[--n]);
+            }
+        } else if (r < 85 && n) {
+            size_t i = below(n);
+            vDLL_remove(dll, handles[i], &out);
+            CHECK(out == values[i]);
+            n--;
+            memmove(handles + i, handles + i + 1,
+                        (n - i) * sizeof(uint32_t));
+            memmove(values + i, values + i + 1, (n - i) * sizeof(uint64_t));
+        } else if (n) {
+            size_t i = below(n);
+            CHECK(*(uint64_t*)vDLL_get(dll, handles[i]) == values[i]);
+        }
+        CHECK(dll->n_elements == n);
+        CHECK(vDLL_is_empty(dll) == !n);
+
+        if (op % CHECK_EVERY == 0) {
+            uint32_t h = dll->head;
+            for (size_t i = 0; i < n; i++, h = vDLL_next(dll, h)) {
+                CHECK(h == handles[i]);
+            }
+            CHECK(h == VDLL_NONE);
+            h = dll->tail;
+            for (size_t i = n; i > 0; i--, h = vDLL_prev(dll, h)) {
+                CHECK(h == handles[i - 1]);
+            }
+            CHECK(h == VDLL_NONE);
+        }
+    }
+
+    vDLL_clean(dll);
+    printf("test_containers: vDLL ok\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        ops = strtoull(argv[1], NULL, 10);
+    }
+    if (argc > 2) {
+        seed = strtoull(argv[2], NULL, 10);
+    }
+    rng = (seed + 1) * 0x9E3779B97F4A7C15ULL;
+
+    test_bptree(true);
+    test_bptree(false);
+    test_art();
+    test_roaring();
+    test_vector();
+    test_deque(sizeof(uint64_t));
+    test_deque(24);
+    test_vqueue_vstack();
+    test_vdll();
+    printf("test_containers: ok, %zu ops per container, seed %llu\n", ops,
+                (unsigned long long)seed);
+    return 0;
+}
@@ -0,0 +1,280 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file stress tests skiplist_t and the epoch reclamation under
+         it. THREADS threads run a random mix of insert, remove, search and
+         range scans at once. Keys i with i % THREADS == t are private to
+         thread t, so it knows exactly which of them are present, the rest
+         are shared and raced on by every thread. Values are malloc'd and
+         freed on removal through epoch.h, and readers check the value of
+         every key they see, so a node or value reclaimed too early shows up
+         under ASan. Scans check ordering and bounds, and that the private
+         keys in range are exactly the present ones. After the threads join
+         the list is checked against the expected contents and size.
+
+Build  : cc -O2 -I.. test_skiplist.c ../skiplist.c ../epoch.c \
+             ../allocator.c ../slab.c ../arena.c ../pool.c -lm -lpthread \
+             -o test_skiplist
+Usage  : ./test_skiplist [ops_per_thread] [seed]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include "skiplist.h"
+#include "epoch.h"
+
+#define THREADS 8
+#define N_KEYS 4096
+// Keys below this are shared, the rest are private to one thread each
+#define N_SHARED 512
+#define MAX_SCAN 64
+#define DEFAULT_OPS 200000
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s (seed %llu)\n", \
+                        __FILE__, __LINE__, #cond, \
+                        (unsigned long long)seed); \
+            exit(EXIT_FAILURE); \
+        } \
+    } while (0)
+
+typedef struct worker {
+    pthread_t thread;
+    size_t id;
+    uint64_t rng;
+    // Which of the thread's private keys are present
+    bool present[N_KEYS];
+    size_t inserts;
+    size_t removes;
+    size_t scans;
+} worker_t;
+
+static skiplist_t* sl;
+static uint64_t keys[N_KEYS];
+static uint64_t seed = 1;
+static size_t ops = DEFAULT_OPS;
+// Successful inserts minus successful removes of each shared key
+static long shared_net[N_SHARED];
+
+static int key_order(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t next_random(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+/*
+ * Function: pick_key
+ * --------------------
+ *  Picks a key to write, shared one time in four and otherwise one of
+ *  the worker's own.
+ *
+ *  returns: Index of the key.
+ */
+static size_t pick_key(worker_t* w) {
+    uint64_t r = next_random(&w->rng);
+    if ((r & 3) == 0) {
+        return (r >> 2) % N_SHARED;
+    }
+    size_t n_own = (N_KEYS - N_SHARED) / THREADS;
+    return N_SHARED + ((r >> 2) % n_own) * THREADS + w->id;
+}
+
+/*
+ * Function: owner
+ * --------------------
+ *  Gets the worker a key is private to.
+ *
+ *  returns: Worker index, THREADS for shared keys.
+ */
+static size_t owner(size_t index) {
+    return index < N_SHARED ? THREADS : (index - N_SHARED) % THREADS;
+}
+
+/*
+ * Function: check_value
+ * --------------------
+ *  Checks the value found for a key is the one made for it, reading it
+ *  inside the caller's critical section.
+ *
+ *  returns: Nothing.
+ */
+static void check_value(const void* key, const void* value) {
+    CHECK(value != NULL);
+    CHECK(*(const uint64_t*)value == *(const uint64_t*)key);
+}
+
+/*
+ * Function: scan
+ * --------------------
+ *  Scans a random range, checking keys come in order within bounds with
+ *  their own values, and that the worker's private keys in range are
+ *  exactly those it has present.
+ *
+ *  returns: Nothing.
+ */
+static void scan(worker_t* w) {
+    size_t low = next_random(&w->rng) % N_KEYS;
+    size_t high = low + 1 + next_random(&w->rng) % (MAX_SCAN * THREADS);
+    high = high > N_KEYS ? N_KEYS : high;
+    bool seen[MAX_SCAN * THREADS] = { false };
+    skiplist_iter_t iter;
+    void* key, * value;
+    uint64_t last = 0;
+    bool first = true;
+
+    if (high == N_KEYS) {
+        skiplist_iter_seek(sl, &keys[low], &iter);
+    } else {
+        skiplist_range(sl, &keys[low], &keys[high], &iter);
+    }
+    while (skiplist_iter_next(&iter, &key, &value)) {
+        uint64_t k = *(uint64_t*)key;
+        CHECK(k >= low && k < high);
+        CHECK(first || k > last);
+        check_value(key, value);
+        seen[k - low] = true;
+        last = k;
+        first = false;
+    }
+    for (size_t i = low; i < high; i++) {
+        if (owner(i) == w->id) {
+            CHECK(seen[i - low] == w->present[i]);
+        }
+    }
+    w->scans++;
+}
+
+/*
+ * Function: run_worker
+ * --------------------
+ *  Runs a worker's share of the random operations.
+ *
+ *  returns: NULL.
+ */
+static void* run_worker(void* arg) {
+    worker_t* w = arg;
+
+    for (size_t op = 0; op < ops; op++) {
+        uint64_t r = next_random(&w->rng) % 100;
+        size_t i = pick_key(w);
+
+        if (r < 30) {
+            uint64_t* value = malloc(sizeof(uint64_t));
+            CHECK(value != NULL);
+            *value = keys[i];
+            bool inserted = skiplist_insert(sl, &keys[i], value);
+            if (!inserted) {
+                free(value);
+            }
+            if (i < N_SHARED) {
+                __atomic_add_fetch(&shared_net[i], inserted,
+                            __ATOMIC_RELAXED);
+            } else {
+                CHECK(inserted == !w->present[i]);
+                w->present[i] = true;
+            }
+            w->inserts += inserted;
+        } else if (r < 55) {
+            bool removed = skiplist_remove(sl, &keys[i], NULL, free);
+            if (i < N_SHARED) {
+                __atomic_sub_fetch(&shared_net[i], removed,
+                            __ATOMIC_RELAXED);
+            } else {
+                CHECK(removed == w->present[i]);
+                w->present[i] = false;
+            }
+            w->removes += removed;
+        } else if (r < 95) {
+            epoch_enter();
+            void* value = skiplist_search(sl, &keys[i]);
+            if (i >= N_SHARED) {
+                CHECK((value != NULL) == w->present[i]);
+            }
+            if (value) {
+                check_value(&keys[i], value);
+            }
+            epoch_exit();
+        } else {
+            scan(w);
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    static worker_t workers[THREADS];
+
+    if (argc > 1) {
+        ops = strtoull(argv[1], NULL, 10);
+    }
+    if (argc > 2) {
+        seed = strtoull(argv[2], NULL, 10);
+    }
+    for (size_t i = 0; i < N_KEYS; i++) {
+        keys[i] = i;
+    }
+
+    sl = skiplist_create(key_order);
+    for (size_t t = 0; t < THREADS; t++) {
+        workers[t].id = t;
+        workers[t].rng = (seed + 1) * 0x9E3779B97F4A7C15ULL + t;
+        int err = pthread_create(&workers[t].thread, NULL, run_worker,
+                    &workers[t]);
+        CHECK(err == 0);
+    }
+    size_t inserts = 0, removes = 0, scans = 0;
+    for (size_t t = 0; t < THREADS; t++) {
+        pthread_join(workers[t].thread, NULL);
+        inserts += workers[t].inserts;
+        removes += workers[t].removes;
+        scans += workers[t].scans;
+    }
+
+    // Every key is where the return values say it is
+    size_t expected = 0;
+    for (size_t i = 0; i < N_KEYS; i++) {
+        bool present;
+        if (i < N_SHARED) {
+            CHECK(shared_net[i] == 0 || shared_net[i] == 1);
+            present = shared_net[i];
+        } else {
+            present = workers[owner(i)].present[i];
+        }
+        CHECK(skiplist_contains(sl, &keys[i]) == present);
+        expected += present;
+    }
+    CHECK(inserts - removes == expected);
+    CHECK(skiplist_size(sl) == expected);
+
+    // A full scan is strictly ascending and sees every key once
+    skiplist_iter_t iter;
+    void* key, * value;
+    size_t n = 0;
+    uint64_t last = 0;
+    skiplist_iter_first(sl, &iter);
+    while (skiplist_iter_next(&iter, &key, &value)) {
+        CHECK(n == 0 || *(uint64_t*)key > last);
+        check_value(key, value);
+        last = *(uint64_t*)key;
+        n++;
+    }
+    CHECK(n == expected);
+
+    skiplist_clean(sl, NULL, free);
+    epoch_drain();
+    printf("test_skiplist: ok, %d threads, %zu inserts, %zu removes, "
+                "%zu scans, %zu keys left\n", THREADS, inserts, removes,
+                scans, expected);
+    return 0;
+}
@@ -0,0 +1,282 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is the command line front end of the hash analyzer. It
+         checks a built in hash or a hash_t exported by a shared library
+         against keys read from a file, one string per line, or generated
+         integers, and prints one JSON report per hash. Exits with 2 if any
+         hash would give long chains or non-uniform buckets.
+
+Build  : cc -O2 -I.. hashcheck.c ../hashcheck.c ../hashtable.c \
+             ../allocator.c ../slab.c ../pool.c ../arena.c -ldl -lm \
+             -lpthread -o hashcheck
+Usage  : ./hashcheck [-H hash|all] [-l library.so -s symbol]
+             [-f keys_file | -g seq|random|stride:N] [-n keys] [-w 4|8]
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include "hashcheck.h"
+#include "hashtable.h"
+
+#define DEFAULT_KEYS 100000
+
+typedef struct named_hash {
+    const char* name;
+    hash_t hash;
+    // Hashes NUL terminated strings rather than integers
+    bool strings;
+} named_hash_t;
+
+// Integer key width in bytes, 4 or 8
+static size_t key_width = 8;
+
+static uint64_t read_int(const void* key) {
+    if (key_width == 4) {
+        return *(const uint32_t*)key;
+    }
+    return *(const uint64_t*)key;
+}
+
+static size_t hash_identity(const void* key) {
+    return (size_t)read_int(key);
+}
+
+static size_t hash_multiplicative(const void* key) {
+    return (size_t)(read_int(key) * 2654435761ULL);
+}
+
+static size_t hash_splitmix(const void* key) {
+    uint64_t z = read_int(key) + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return (size_t)(z ^ (z >> 31));
+}
+
+static size_t hash_sum(const void* key) {
+    size_t sum = 0;
+    for (const unsigned char* c = key; *c; c++) {
+        sum += *c;
+    }
+    return sum;
+}
+
+static size_t hash_djb2(const void* key) {
+    size_t hash = 5381;
+    for (const unsigned char* c = key; *c; c++) {
+        hash = hash * 33 + *c;
+    }
+    return hash;
+}
+
+static size_t hash_fnv1a(const void* key) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (const unsigned char* c = key; *c; c++) {
+        hash = (hash ^ *c) * 0x100000001B3ULL;
+    }
+    return (size_t)hash;
+}
+
+static int compare_strings(const void* a, const void* b) {
+    return strcmp(a, b);
+}
+
+static const named_hash_t HASHES[] = {
+    { "identity", hash_identity, false },
+    { "multiplicative", hash_multiplicative, false },
+    { "splitmix", hash_splitmix, false },
+    { "sum", hash_sum, true },
+    { "djb2", hash_djb2, true },
+    { "fnv1a", hash_fnv1a, true },
+};
+
+#define N_HASHES (sizeof(HASHES) / sizeof(HASHES[0]))
+
+/*
+ * Reads distinct non-empty lines of a file as string keys.
+ */
+static char** read_keys(const char* path, size_t* n_keys) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        exit(1);
+    }
+
+    hashtable_t* seen = ht_create(INITIAL_TABLE_SIZE, compare_strings,
+                hash_fnv1a);
+    size_t capacity = 1024, n = 0;
+    char** keys = malloc(sizeof(char*) * capacity);
+    char* line = NULL;
+    size_t line_size = 0;
+    ssize_t len;
+
+    while ((len = getline(&line, &line_size, file)) != -1) {
+        while (len && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+        if (!len || ht_contains(seen, line)) {
+            continue;
+        }
+
+        if (n == capacity) {
+            capacity *= 2;
+            keys = realloc(keys, sizeof(char*) * capacity);
+        }
+        keys[n] = strdup(line);
+        ht_insert(seen, keys[n], NULL);
+        n++;
+    }
+
+    free(line);
+    fclose(file);
+    ht_clean(seen, NULL, NULL);
+    *n_keys = n;
+    return keys;
+}
+
+/*
+ * Generates distinct integer keys, sequential, random or a fixed stride
+ * apart as with aligned pointers or ids sharing a factor.
+ */
+static uint64_t* generate_keys(const char* generator, size_t n_keys) {
+    uint64_t* values = malloc(sizeof(uint64_t) * n_keys);
+    uint64_t stride = 1, state = 42;
+    bool known = !strcmp(generator, "seq") || !strcmp(generator, "random");
+    char* end = NULL;
+
+    if (!strncmp(generator, "stride:", 7)) {
+        // A zero or unparsable stride would repeat keys
+        stride = strtoull(generator + 7, &end, 10);
+        known = generator[7] >= '0' && generator[7] <= '9' && !*end &&
+                    stride;
+    }
+    if (!known) {
+        fprintf(stderr, "hashcheck: unknown generator %s\n", generator);
+        exit(1);
+    }
+
+    for (size_t i = 0; i < n_keys; i++) {
+        if (!strcmp(generator, "random")) {
+            // Odd multiplier keeps the keys distinct
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            values[i] = state;
+        } else {
+            values[i] = (i + 1) * stride;
+        }
+
+        if (key_width == 4) {
+            uint32_t narrow = (uint32_t)values[i];
+            memcpy(&values[i], &narrow, sizeof(narrow));
+        }
+    }
+    return values;
+}
+
+int main(int argc, char** argv) {
+    const char* hash_name = "all", * library = NULL, * symbol = NULL;
+    const char* path = NULL, * generator = "seq";
+    size_t n_keys = DEFAULT_KEYS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "H:l:s:f:g:n:w:")) != -1) {
+        switch (opt) {
+            case 'H': hash_name = optarg; break;
+            case 'l': library = optarg; break;
+            case 's': symbol = optarg; break;
+            case 'f': path = optarg; break;
+            case 'g': generator = optarg; break;
+            case 'n': n_keys = strtoull(optarg, NULL, 10); break;
+            case 'w': key_width = strtoull(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr, "usage: %s [-H hash|all] [-l library.so -s "
+                            "symbol] [-f keys_file | -g seq|random|stride:N] "
+                            "[-n keys] [-w 4|8]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if ((key_width != 4 && key_width != 8) || !n_keys) {
+        fprintf(stderr, "hashcheck: keys must be positive, width 4 or 8\n");
+        return 1;
+    }
+
+    // Keys, strings from a file or integers from a generator
+    bool strings = path != NULL;
+    void** keys = NULL;
+    void* storage = NULL;
+    if (strings) {
+        keys = (void**)read_keys(path, &n_keys);
+        if (!n_keys) {
+            fprintf(stderr, "hashcheck: no keys in %s\n", path);
+            return 1;
+        }
+    } else {
+        uint64_t* values = generate_keys(generator, n_keys);
+        keys = malloc(sizeof(void*) * n_keys);
+        for (size_t i = 0; i < n_keys; i++) {
+            keys[i] = &values[i];
+        }
+        storage = values;
+    }
+    size_t key_size = strings ? 0 : key_width;
+
+    // Hashes to check, a library symbol or built ins for the key kind
+    named_hash_t checks[N_HASHES];
+    size_t n_checks = 0;
+    void* handle = NULL;
+    if (library) {
+        if (!symbol || !(handle = dlopen(library, RTLD_NOW))) {
+            fprintf(stderr, "hashcheck: %s\n", symbol ? dlerror() :
+                        "-l needs -s symbol");
+            return 1;
+        }
+
+        hash_t hash;
+        *(void**)&hash = dlsym(handle, symbol);
+        if (!hash) {
+            fprintf(stderr, "hashcheck: %s\n", dlerror());
+            return 1;
+        }
+        checks[n_checks++] = (named_hash_t){ symbol, hash, strings };
+    } else {
+        for (size_t i = 0; i < N_HASHES; i++) {
+            if (HASHES[i].strings == strings && (!strcmp(hash_name, "all") ||
+                        !strcmp(hash_name, HASHES[i].name))) {
+                checks[n_checks++] = HASHES[i];
+            }
+        }
+        if (!n_checks) {
+            fprintf(stderr, "hashcheck: no %s hash named %s\n",
+                        strings ? "string" : "integer", hash_name);
+            return 1;
+        }
+    }
+
+    int status = 0;
+    hashcheck_report_t report;
+    for (size_t i = 0; i < n_checks; i++) {
+        hashcheck_analyze(checks[i].hash, keys, n_keys, key_size, &report);
+        hashcheck_print(stdout, checks[i].name, &report);
+
+        if (report.long_chains || report.non_uniform) {
+            status = 2;
+        }
+    }
+
+    if (strings) {
+        for (size_t i = 0; i < n_keys; i++) {
+            free(keys[i]);
+        }
+    }
+    free(keys);
+    free(storage);
+    if (handle) {
+        dlclose(handle);
+    }
+    return status;
+}
@@ -0,0 +1,846 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a custom graph traversal library over CSR graphs, with
+         bitset visited and frontier sets, direction-optimizing BFS (serial
+         and multi-threaded), iterative DFS and a multi-source reachability
+         BFS over compressed bitmaps. RAGs are traversed by first converting
+         them to CSR form over their dense node ids.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "traversal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <pthread.h>
+#include "bitset.h"
+#include "roaring.h"
+#include "RAG.h"
+
+/* Shared state of one BFS, levels are advanced by a single thread */
+typedef struct _bfs_state {
+    const csr_graph_t* graph;
+    visit_t visit;
+    void* ctx;
+    vertex_t* parents;
+    bitset_t* visited;
+    // Bottom-up frontiers
+    bitset_t* front;
+    bitset_t* next;
+    // Top-down frontiers
+    vertex_t* queue;
+    vertex_t* next_queue;
+    size_t n_front;
+    size_t n_next;
+    // Out edges of the next frontier and of newly visited vertices
+    size_t front_edges;
+    size_t visited_edges;
+    size_t unexplored_edges;
+    size_t n_reached;
+    size_t depth;
+    size_t cursor;
+    bool top_down;
+    bool can_bottom_up;
+    bool concurrent;
+    bool stop;
+    bool done;
+    pthread_barrier_t barrier;
+} _bfs_state_t;
+
+typedef struct _bfs_worker {
+    _bfs_state_t* state;
+    size_t id;
+    pthread_t thread;
+} _bfs_worker_t;
+
+static size_t _bfs_run(const csr_graph_t* graph, vertex_t source,
+                size_t n_threads, visit_t visit, void* ctx, vertex_t* parents);
+static void _bfs_top_down(_bfs_state_t* s);
+static void _bfs_bottom_up(_bfs_state_t* s);
+static void _bfs_advance(_bfs_state_t* s);
+static void* _bfs_worker(void* arg);
+
+/**** PUBLIC ****/
+
+/* CSR GRAPH */
+/*
+ * Function: csr_create
+ * --------------------
+ *  Creates a new CSR graph from an edge list.
+ *
+ *  n_vertices: Number of vertices, ids are 0 .. n_vertices - 1.
+ *  n_edges: Number of edges in the edge list.
+ *  src: Source vertex of each edge.
+ *  dst: Destination vertex of each edge.
+ *  build_reverse: Whether to also build in edges for bottom-up BFS.
+ *
+ *  returns: Pointer to the new CSR graph.
+ */
+csr_graph_t* csr_create(size_t n_vertices, size_t n_edges,
+                const vertex_t* src, const vertex_t* dst, bool build_reverse) {
+    assert(n_vertices < TRAVERSAL_NO_VERTEX);
+    assert(n_edges == 0 || (src && dst));
+
+    csr_graph_t* graph = malloc(sizeof(csr_graph_t));
+    assert(graph);
+
+    graph->n_vertices = n_vertices;
+    graph->n_edges = n_edges;
+    graph->symmetric = false;
+    graph->offsets = _csr_build(n_vertices, n_edges, src, dst,
+                &graph->targets);
+
+    graph->in_offsets = NULL;
+    graph->in_sources = NULL;
+    if (build_reverse) {
+        graph->in_offsets = _csr_build(n_vertices, n_edges, dst, src,
+                    &graph->in_sources);
+    }
+
+    return graph;
+}
+
+/*
+ * Function: csr_create_from_RAG
+ * --------------------
+ *  Creates a CSR graph from the next edges of a RAG, vertices are the dense
+ *  node ids of the RAG.
+ *
+ *  rag: Pointer to the RAG.
+ *  undirected: Whether to add each edge in both directions, as
+ *              RAG_convert_to_undirected does.
+ *  nodes: Optional output, set to a malloced array mapping vertex to RAG
+ *         node, NULL where an id has no node.
+ *
+ *  returns: Pointer to the new CSR graph.
+ */
+csr_graph_t* csr_create_from_RAG(RAG_t* rag, bool undirected,
+                RAG_node_t*** nodes) {
+    assert(rag);
+    hashtable_t* ht = rag->ht;
+    RAG_node_t* node = NULL;
+    size_t n_edges = 0, edge = 0;
+
+    // Count next edges
+    for (size_t i = 0; i < ht->size; i++) {
+        for (ht_node_t* ht_node = ht->table[i]; ht_node;
+                    ht_node = ht_node->next) {
+            node = ht_node->value;
+            if (node->next) {
+                n_edges++;
+            }
+        }
+    }
+    if (undirected) {
+        n_edges *= 2;
+    }
+
+    vertex_t* src = malloc(sizeof(vertex_t) * (n_edges ? n_edges : 1));
+    vertex_t* dst = malloc(sizeof(vertex_t) * (n_edges ? n_edges : 1));
+    assert(src && dst);
+
+    if (nodes) {
+        *nodes = calloc(rag->n_nodes ? rag->n_nodes : 1, sizeof(RAG_node_t*));
+        assert(*nodes);
+    }
+
+    // Collect edges, and vertex to node mapping if requested
+    for (size_t i = 0; i < ht->size; i++) {
+        for (ht_node_t* ht_node = ht->table[i]; ht_node;
+                    ht_node = ht_node->next) {
+            node = ht_node->value;
+            if (nodes) {
+                (*nodes)[node->id] = node;
+            }
+            if (!node->next) {
+                continue;
+            }
+            src[edge] = (vertex_t)node->id;
+            dst[edge++] = (vertex_t)node->next->id;
+            if (undirected) {
+                src[edge] = (vertex_t)node->next->id;
+                dst[edge++] = (vertex_t)node->id;
+            }
+        }
+    }
+
+    csr_graph_t* graph = csr_create(rag->n_nodes, n_edges, src, dst,
+                !undirected);
+
+    // Undirected graphs are their own reverse
+    if (undirected) {
+        graph->in_offsets = graph->offsets;
+        graph->in_sources = graph->targets;
+        graph->symmetric = true;
+    }
+
+    free(src);
+    free(dst);
+
+    return graph;
+}
+
+/*
+ * Function: csr_clean
+ * --------------------
+ *  Frees the CSR graph.
+ *
+ *  graph: Pointer to the CSR graph.
+ *
+ *  returns: Nothing.
+ */
+void csr_clean(csr_graph_t* graph) {
+    assert(graph);
+
+    if (!graph->symmetric) {
+        free(graph->in_offsets);
+        free(graph->in_sources);
+    }
+    free(graph->offsets);
+    free(graph->targets);
+    free(graph);
+}
+
+/* TRAVERSALS */
+/*
+ * Function: traversal_bfs
+ * --------------------
+ *  Direction-optimizing breadth first search. Runs top-down steps from a
+ *  frontier queue and switches to bottom-up steps over a frontier bitset
+ *  when the frontier gets large, if the graph has in edges.
+ *
+ *  graph: Pointer to the CSR graph.
+ *  source: Vertex to start from.
+ *  visit: Optional function called once for each reached vertex.
+ *  ctx: User context passed to visit.
+ *  parents: Optional output array of n_vertices parents,
+ *           TRAVERSAL_NO_VERTEX for unreached vertices and the source.
+ *
+ *  returns: Number of vertices reached.
+ */
+size_t traversal_bfs(const csr_graph_t* graph, vertex_t source, visit_t visit,
+                void* ctx, vertex_t* parents) {
+    return _bfs_run(graph, source, 1, visit, ctx, parents);
+}
+
+/*
+ * Function: traversal_bfs_parallel
+ * --------------------
+ *  Multi-threaded direction-optimizing breadth first search. Top-down steps
+ *  claim vertices with atomic bitset updates, bottom-up steps partition the
+ *  bitsets by word so need no atomics. visit is called concurrently and
+ *  must be thread safe.
+ *
+ *  graph: Pointer to the CSR graph.
+ *  source: Vertex to start from.
+ *  n_threads: Number of threads to use, including the caller.
+ *  visit: Optional function called once for each reached vertex.
+ *  ctx: User context passed to visit.
+ *  parents: Optional output array of n_vertices parents.
+ *
+ *  returns: Number of vertices reached.
+ */
+size_t traversal_bfs_parallel(const csr_graph_t* graph, vertex_t source,
+                size_t n_threads, visit_t visit, void* ctx, vertex_t* parents) {
+    return _bfs_run(graph, source, n_threads ? n_threads : 1, visit, ctx,
+                parents);
+}
+
+/*
+ * Function: traversal_dfs
+ * --------------------
+ *  Iterative depth first search on an array stack, visit is called in
+ *  pre-order.
+ *
+ *  graph: Pointer to the CSR graph.
+ *  source: Vertex to start from.
+ *  visit: Optional function called once for each reached vertex.
+ *  ctx: User context passed to visit.
+ *  parents: Optional output array of n_vertices parents.
+ *
+ *  returns: Number of vertices reached.
+ */
+size_t traversal_dfs(const csr_graph_t* graph, vertex_t source, visit_t visit,
+                void* ctx, vertex_t* parents) {
+    assert(graph);
+    assert(source < graph->n_vertices);
+    traversal_action_t action = TRAVERSAL_CONTINUE;
+    size_t n_reached = 1, top = 0, capacity = 64;
+
+    if (parents) {
+        for (size_t i = 0; i < graph->n_vertices; i++) {
+            parents[i] = TRAVERSAL_NO_VERTEX;
+        }
+    }
+
+    bitset_t* visited = bitset_create(graph->n_vertices);
+    bitset_set(visited, source);
+
+    if (visit) {
+        action = visit(source, TRAVERSAL_NO_VERTEX, 0, ctx);
+    }
+    if (action != TRAVERSAL_CONTINUE) {
+        bitset_clean(visited);
+        return n_reached;
+    }
+
+    // Each stack frame holds a vertex and its next unexplored edge
+    vertex_t* vertices = malloc(sizeof(vertex_t) * capacity);
+    size_t* edges = malloc(sizeof(size_t) * capacity);
+    assert(vertices && edges);
+
+    vertices[top] = source;
+    edges[top++] = graph->offsets[source];
+
+    while (top > 0) {
+        vertex_t u = vertices[top - 1];
+        size_t edge = edges[top - 1];
+
+        // All edges explored, backtrack
+        if (edge == graph->offsets[u + 1]) {
+            top--;
+            continue;
+        }
+        edges[top - 1] = edge + 1;
+
+        vertex_t v = graph->targets[edge];
+        if (bitset_test(visited, v)) {
+            continue;
+        }
+        bitset_set(visited, v);
+        n_reached++;
+
+        if (parents) {
+            parents[v] = u;
+        }
+        if (visit) {
+            action = visit(v, u, top, ctx);
+        }
+        if (action == TRAVERSAL_STOP) {
+            break;
+        } else if (action == TRAVERSAL_SKIP) {
+            action = TRAVERSAL_CONTINUE;
+            continue;
+        }
+
+        // Grow stack if needed
+        if (top == capacity) {
+            capacity *= 2;
+            vertices = realloc(vertices, sizeof(vertex_t) * capacity);
+            edges = realloc(edges, sizeof(size_t) * capacity);
+            assert(vertices && edges);
+        }
+        vertices[top] = v;
+        edges[top++] = graph->offsets[v];
+    }
+
+    free(vertices);
+    free(edges);
+    bitset_clean(visited);
+
+    return n_reached;
+}
+
+/*
+ * Function: traversal_reach
+ * --------------------
+ *  Multi-source breadth first search with compressed bitmaps as the visited
+ *  set and frontiers, so memory follows the vertices reached rather than
+ *  the size of the graph. Frontiers are expanded in ascending vertex order.
+ *  Vertices already in reached count as visited, so a reach set can be
+ *  built up over several calls or kept from entering parts of the graph.
+ *
+ *  graph: Pointer to the CSR graph.
+ *  sources: Vertices to start from, at depth 0.
+ *  max_depth: Deepest level to expand to, SIZE_MAX for no limit.
+ *  visit: Optional function called once for each newly reached vertex,
+ *         sources have TRAVERSAL_NO_VERTEX as their parent.
+ *  ctx: User context passed to visit.
+ *  reached: Visited set, every vertex reached is added to it.
+ *
+ *  returns: Number of vertices newly reached.
+ */
+size_t traversal_reach(const csr_graph_t* graph, const roaring_t* sources,
+                size_t max_depth, visit_t visit, void* ctx,
+                roaring_t* reached) {
+    assert(graph);
+    assert(sources && reached);
+    traversal_action_t action = TRAVERSAL_CONTINUE;
+    roaring_iter_t iter;
+    vertex_t u;
+    size_t n_reached = 0, depth = 0;
+    bool stop = false;
+
+    roaring_t* front = roaring_create();
+    roaring_t* next = roaring_create();
+
+    roaring_iter_init(sources, &iter);
+    while (roaring_iter_next(&iter, &u)) {
+        assert(u < graph->n_vertices);
+        // Test and set, a vertex already reached is not a source again
+        if (!roaring_add(reached, u)) {
+            continue;
+        }
+        n_reached++;
+
+        if (visit) {
+            action = visit(u, TRAVERSAL_NO_VERTEX, 0, ctx);
+        }
+        if (action == TRAVERSAL_STOP) {
+            stop = true;
+            break;
+        } else if (action == TRAVERSAL_SKIP) {
+            action = TRAVERSAL_CONTINUE;
+            continue;
+        }
+        roaring_add(front, u);
+    }
+
+    while (!stop && roaring_cardinality(front) && depth < max_depth) {
+        depth++;
+
+        // Ascending order walks the offsets and edge arrays forwards
+        roaring_iter_init(front, &iter);
+        while (!stop && roaring_iter_next(&iter, &u)) {
+            for (size_t e = graph->offsets[u]; e < graph->offsets[u + 1];
+                        e++) {
+                vertex_t v = graph->targets[e];
+                if (!roaring_add(reached, v)) {
+                    continue;
+                }
+                n_reached++;
+
+                if (visit) {
+                    action = visit(v, u, depth, ctx);
+                }
+                if (action == TRAVERSAL_STOP) {
+                    stop = true;
+                    break;
+                } else if (action == TRAVERSAL_SKIP) {
+                    action = TRAVERSAL_CONTINUE;
+                    continue;
+                }
+                roaring_add(next, v);
+            }
+        }
+
+        roaring_swap(front, next);
+        roaring_clear(next);
+    }
+
+    roaring_clean(front);
+    roaring_clean(next);
+
+    return n_reached;
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _csr_build
+ * --------------------
+ *  Builds one direction of a CSR graph with a counting sort of the edges.
+ *
+ *  n_vertices: Number of vertices.
+ *  n_edges: Number of edges.
+ *  from: Vertex each edge is stored under.
+ *  to: Vertex each edge points to.
+ *  targets: Output, set to the malloced edge target array.
+ *
+ *  returns: Malloced offsets array of n_vertices + 1 entries.
+ */
+size_t* _csr_build(size_t n_vertices, size_t n_edges, const vertex_t* from,
+                const vertex_t* to, vertex_t** targets) {
+    size_t* offsets = calloc(n_vertices + 1, sizeof(size_t));
+    size_t* cursor = malloc(sizeof(size_t) * (n_vertices ? n_vertices : 1));
+    *targets = malloc(sizeof(vertex_t) * (n_edges ? n_edges : 1));
+    assert(offsets && cursor && *targets);
+
+    // Count degrees and prefix sum into offsets
+    for (size_t i = 0; i < n_edges; i++) {
+        assert(from[i] < n_vertices && to[i] < n_vertices);
+        offsets[from[i] + 1]++;
+    }
+    for (size_t v = 0; v < n_vertices; v++) {
+        offsets[v + 1] += offsets[v];
+    }
+
+    // Scatter edges into place
+    memcpy(cursor, offsets, sizeof(size_t) * n_vertices);
+    for (size_t i = 0; i < n_edges; i++) {
+        (*targets)[cursor[from[i]]++] = to[i];
+    }
+
+    free(cursor);
+    return offsets;
+}
+
+/*
+ * Function: _bfs_run
+ * --------------------
+ *  Sets up and runs a BFS level by level, on the calling thread plus
+ *  n_threads - 1 workers.
+ *
+ *  returns: Number of vertices reached.
+ */
+static size_t _bfs_run(const csr_graph_t* graph, vertex_t source,
+                size_t n_threads, visit_t visit, void* ctx, vertex_t* parents) {
+    assert(graph);
+    assert(source < graph->n_vertices);
+    traversal_action_t action = TRAVERSAL_CONTINUE;
+    _bfs_state_t s;
+    size_t n_vertices = graph->n_vertices;
+
+    memset(&s, 0, sizeof(s));
+    s.graph = graph;
+    s.visit = visit;
+    s.ctx = ctx;
+    s.parents = parents;
+    s.concurrent = n_threads > 1;
+    s.can_bottom_up = graph->in_offsets != NULL;
+    s.top_down = true;
+
+    if (parents) {
+        for (size_t i = 0; i < n_vertices; i++) {
+            parents[i] = TRAVERSAL_NO_VERTEX;
+        }
+    }
+
+    s.visited = bitset_create(n_vertices);
+    bitset_set(s.visited, source);
+    s.n_reached = 1;
+
+    if (visit) {
+        action = visit(source, TRAVERSAL_NO_VERTEX, 0, ctx);
+    }
+    if (action != TRAVERSAL_CONTINUE) {
+        bitset_clean(s.visited);
+        return s.n_reached;
+    }
+
+    s.queue = malloc(sizeof(vertex_t) * n_vertices);
+    s.next_queue = malloc(sizeof(vertex_t) * n_vertices);
+    assert(s.queue && s.next_queue);
+    if (s.can_bottom_up) {
+        s.front = bitset_create(n_vertices);
+        s.next = bitset_create(n_vertices);
+    }
+
+    s.queue[0] = source;
+    s.n_front = 1;
+    s.unexplored_edges = graph->n_edges -
+                (graph->offsets[source + 1] - graph->offsets[source]);
+
+    if (!s.concurrent) {
+        while (!s.done) {
+            if (s.top_down) {
+                _bfs_top_down(&s);
+            } else {
+                _bfs_bottom_up(&s);
+            }
+            _bfs_advance(&s);
+        }
+    } else {
+        _bfs_worker_t* workers = malloc(sizeof(_bfs_worker_t) * n_threads);
+        assert(workers);
+        pthread_barrier_init(&s.barrier, NULL, (unsigned)n_threads);
+
+        for (size_t i = 0; i < n_threads; i++) {
+            workers[i].state = &s;
+            workers[i].id = i;
+            if (i > 0) {
+                pthread_create(&workers[i].thread, NULL, _bfs_worker,
+                            &workers[i]);
+            }
+        }
+
+        // Caller acts as worker 0
+        _bfs_worker(&workers[0]);
+
+        for (size_t i = 1; i < n_threads; i++) {
+            pthread_join(workers[i].thread, NULL);
+        }
+        pthread_barrier_destroy(&s.barrier);
+        free(workers);
+    }
+
+    free(s.queue);
+    free(s.next_queue);
+    if (s.can_bottom_up) {
+        bitset_clean(s.front);
+        bitset_clean(s.next);
+    }
+    bitset_clean(s.visited);
+
+    return s.n_reached;
+}
+
+/*
+ * Function: _bfs_worker
+ * --------------------
+ *  Runs BFS levels in lock step with the other workers, worker 0 advances
+ *  the shared state between levels.
+ *
+ *  returns: NULL.
+ */
+static void* _bfs_worker(void* arg) {
+    _bfs_worker_t* worker = arg;
+    _bfs_state_t* s = worker->state;
+
+    while (true) {
+        pthread_barrier_wait(&s->barrier);
+        if (s->done) {
+            break;
+        }
+
+        if (s->top_down) {
+            _bfs_top_down(s);
+        } else {
+            _bfs_bottom_up(s);
+        }
+
+        pthread_barrier_wait(&s->barrier);
+        if (worker->id == 0) {
+            _bfs_advance(s);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Function: _bfs_top_down
+ * --------------------
+ *  Expands out edges of the frontier queue into the next frontier queue.
+ *  Chunks of the queue are claimed from a shared cursor.
+ *
+ *  returns: Nothing.
+ */
+static void _bfs_top_down(_bfs_state_t* s) {
+    const csr_graph_t* g = s->graph;
+    size_t depth = s->depth + 1;
+    size_t n_reached = 0, front_edges = 0, visited_edges = 0;
+    size_t n_local = 0, local_capacity = 0;
+    vertex_t* local = NULL;
+    bool stopped = false;
+
+    while (!stopped && !__atomic_load_n(&s->stop, __ATOMIC_RELAXED)) {
+        size_t begin = __atomic_fetch_add(&s->cursor, TRAVERSAL_CHUNK,
+                    __ATOMIC_RELAXED);
+        if (begin >= s->n_front) {
+            break;
+        }
+        size_t end = begin + TRAVERSAL_CHUNK < s->n_front ?
+                    begin + TRAVERSAL_CHUNK : s->n_front;
+
+        for (size_t i = begin; i < end && !stopped; i++) {
+            vertex_t u = s->queue[i];
+
+            for (size_t e = g->offsets[u]; e < g->offsets[u + 1]; e++) {
+                vertex_t v = g->targets[e];
+
+                // Claim vertex
+                if (s->concurrent) {
+                    if (bitset_test_and_set_atomic(s->visited, v)) {
+                        continue;
+                    }
+                } else {
+                    if (bitset_test(s->visited, v)) {
+                        continue;
+                    }
+                    bitset_set(s->visited, v);
+                }
+
+                size_t degree = g->offsets[v + 1] - g->offsets[v];
+                traversal_action_t action = TRAVERSAL_CONTINUE;
+                n_reached++;
+                visited_edges += degree;
+
+                if (s->parents) {
+                    s->parents[v] = u;
+                }
+                if (s->visit) {
+                    action = s->visit(v, u, depth, s->ctx);
+                }
+                if (action == TRAVERSAL_STOP) {
+                    __atomic_store_n(&s->stop, true, __ATOMIC_RELAXED);
+                    stopped = true;
+                    break;
+                } else if (action == TRAVERSAL_SKIP) {
+                    continue;
+                }
+
+                // Add to next frontier
+                front_edges += degree;
+                if (!s->concurrent) {
+                    s->next_queue[s->n_next++] = v;
+                } else {
+                    if (n_local == local_capacity) {
+                        local_capacity = local_capacity ?
+                                    local_capacity * 2 : TRAVERSAL_CHUNK;
+                        local = realloc(local,
+                                    sizeof(vertex_t) * local_capacity);
+                        assert(local);
+                    }
+                    local[n_local++] = v;
+                }
+            }
+        }
+    }
+
+    // Publish thread local frontier and counters
+    if (n_local) {
+        size_t position = __atomic_fetch_add(&s->n_next, n_local,
+                    __ATOMIC_RELAXED);
+        memcpy(s->next_queue + position, local, sizeof(vertex_t) * n_local);
+    }
+    free(local);
+
+    __atomic_fetch_add(&s->n_reached, n_reached, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->front_edges, front_edges, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->visited_edges, visited_edges, __ATOMIC_RELAXED);
+}
+
+/*
+ * Function: _bfs_bottom_up
+ * --------------------
+ *  Checks each unvisited vertex for a parent in the frontier bitset. Chunks
+ *  of whole words are claimed from a shared cursor, so every word of the
+ *  visited and next bitsets has a single writer.
+ *
+ *  returns: Nothing.
+ */
+static void _bfs_bottom_up(_bfs_state_t* s) {
+    const csr_graph_t* g = s->graph;
+    size_t depth = s->depth + 1;
+    size_t n_words = s->visited->n_words;
+    size_t n_reached = 0, n_next = 0, front_edges = 0, visited_edges = 0;
+    bool stopped = false;
+
+    while (!stopped && !__atomic_load_n(&s->stop, __ATOMIC_RELAXED)) {
+        size_t begin = __atomic_fetch_add(&s->cursor, TRAVERSAL_CHUNK,
+                    __ATOMIC_RELAXED);
+        if (begin >= n_words) {
+            break;
+        }
+        size_t end = begin + TRAVERSAL_CHUNK < n_words ?
+                    begin + TRAVERSAL_CHUNK : n_words;
+
+        for (size_t w = begin; w < end && !stopped; w++) {
+            uint64_t unvisited = ~s->visited->words[w];
+
+            // Skip over fully visited words without touching edges
+            while (unvisited) {
+                vertex_t v = (vertex_t)(w * BITSET_WORD_BITS +
+                            (size_t)__builtin_ctzll(unvisited));
+                unvisited &= unvisited - 1;
+                if (v >= g->n_vertices) {
+                    break;
+                }
+
+                for (size_t e = g->in_offsets[v]; e < g->in_offsets[v + 1];
+                            e++) {
+                    vertex_t u = g->in_sources[e];
+                    if (!bitset_test(s->front, u)) {
+                        continue;
+                    }
+
+                    size_t degree = g->offsets[v + 1] - g->offsets[v];
+                    traversal_action_t action = TRAVERSAL_CONTINUE;
+                    bitset_set(s->visited, v);
+                    n_reached++;
+                    visited_edges += degree;
+
+                    if (s->parents) {
+                        s->parents[v] = u;
+                    }
+                    if (s->visit) {
+                        action = s->visit(v, u, depth, s->ctx);
+                    }
+                    if (action == TRAVERSAL_STOP) {
+                        __atomic_store_n(&s->stop, true, __ATOMIC_RELAXED);
+                        stopped = true;
+                    } else if (action == TRAVERSAL_CONTINUE) {
+                        bitset_set(s->next, v);
+                        n_next++;
+                        front_edges += degree;
+                    }
+                    break;
+                }
+
+                if (stopped) {
+                    break;
+                }
+            }
+        }
+    }
+
+    __atomic_fetch_add(&s->n_next, n_next, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->n_reached, n_reached, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->front_edges, front_edges, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&s->visited_edges, visited_edges, __ATOMIC_RELAXED);
+}
+
+/*
+ * Function: _bfs_advance
+ * --------------------
+ *  Moves to the next level, choosing top-down or bottom-up for it and
+ *  converting the frontier representation when the direction changes.
+ *
+ *  returns: Nothing.
+ */
+static void _bfs_advance(_bfs_state_t* s) {
+    size_t n_vertices = s->graph->n_vertices;
+
+    s->depth++;
+    s->cursor = 0;
+    s->unexplored_edges -= s->visited_edges < s->unexplored_edges ?
+                s->visited_edges : s->unexplored_edges;
+    s->visited_edges = 0;
+
+    if (s->stop || s->n_next == 0) {
+        s->done = true;
+        return;
+    }
+
+    if (s->top_down) {
+        vertex_t* queue = s->queue;
+        s->queue = s->next_queue;
+        s->next_queue = queue;
+        s->n_front = s->n_next;
+
+        // Frontier touches many edges, scanning unvisited vertices is cheaper
+        if (s->can_bottom_up &&
+                    s->front_edges > s->unexplored_edges / TRAVERSAL_ALPHA) {
+            bitset_reset(s->front);
+            for (size_t i = 0; i < s->n_front; i++) {
+                bitset_set(s->front, s->queue[i]);
+            }
+            bitset_reset(s->next);
+            s->top_down = false;
+        }
+    } else {
+        bitset_swap(s->front, s->next);
+        bitset_reset(s->next);
+        s->n_front = s->n_next;
+
+        // Frontier is small again, go back to expanding it directly
+        if (s->n_front < n_vertices / TRAVERSAL_BETA) {
+            size_t n = 0;
+            for (size_t w = 0; w < s->front->n_words; w++) {
+                uint64_t word = s->front->words[w];
+                while (word) {
+                    s->queue[n++] = (vertex_t)(w * BITSET_WORD_BITS +
+                                (size_t)__builtin_ctzll(word));
+                    word &= word - 1;
+                }
+            }
+            s->top_down = true;
+        }
+    }
+
+    s->n_next = 0;
+    s->front_edges = 0;
+}
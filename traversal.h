@@ -0,0 +1,186 @@
+#ifndef TRAVERSAL_H
+#define TRAVERSAL_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "bitset.h"
+#include "roaring.h"
+#include "RAG.h"
+
+#define TRAVERSAL_NO_VERTEX UINT32_MAX
+// Direction switching thresholds from Beamer et al., top-down -> bottom-up
+// when frontier edges exceed unexplored edges / ALPHA, back again when the
+// frontier shrinks below vertices / BETA
+#define TRAVERSAL_ALPHA 15
+#define TRAVERSAL_BETA 18
+// Vertices (top-down) or bitset words (bottom-up) claimed per worker grab
+#define TRAVERSAL_CHUNK 256
+
+typedef uint32_t vertex_t;
+
+typedef enum traversal_action {
+    TRAVERSAL_CONTINUE,
+    TRAVERSAL_SKIP,
+    TRAVERSAL_STOP
+} traversal_action_t;
+
+typedef traversal_action_t (* visit_t)(vertex_t vertex, vertex_t parent,
+                size_t depth, void* ctx);
+
+typedef struct csr_graph {
+    size_t n_vertices;
+    size_t n_edges;
+    // Out edges of v are targets[offsets[v]] .. targets[offsets[v + 1] - 1]
+    size_t* offsets;
+    vertex_t* targets;
+    // In edges, needed for bottom-up steps, NULL if not built
+    size_t* in_offsets;
+    vertex_t* in_sources;
+    // In edges alias out edges for undirected graphs
+    bool symmetric;
+} csr_graph_t;
+
+/* CSR GRAPH */
+/*
+ * Function: csr_create
+ * --------------------
+ *  Creates a new CSR graph from an edge list.
+ *
+ *  n_vertices: Number of vertices, ids are 0 .. n_vertices - 1.
+ *  n_edges: Number of edges in the edge list.
+ *  src: Source vertex of each edge.
+ *  dst: Destination vertex of each edge.
+ *  build_reverse: Whether to also build in edges for bottom-up BFS.
+ *
+ *  returns: Pointer to the new CSR graph.
+ */
+csr_graph_t* csr_create(size_t n_vertices, size_t n_edges,
+                const vertex_t* src, const vertex_t* dst, bool build_reverse);
+
+/*
+ * Function: csr_create_from_RAG
+ * --------------------
+ *  Creates a CSR graph from the next edges of a RAG, vertices are the dense
+ *  node ids of the RAG.
+ *
+ *  rag: Pointer to the RAG.
+ *  undirected: Whether to add each edge in both directions, as
+ *              RAG_convert_to_undirected does.
+ *  nodes: Optional output, set to a malloced array mapping vertex to RAG
+ *         node, NULL where an id has no node.
+ *
+ *  returns: Pointer to the new CSR graph.
+ */
+csr_graph_t* csr_create_from_RAG(RAG_t* rag, bool undirected,
+                RAG_node_t*** nodes);
+
+/*
+ * Function: csr_clean
+ * --------------------
+ *  Frees the CSR graph.
+ *
+ *  graph: Pointer to the CSR graph.
+ *
+ *  returns: Nothing.
+ */
+void csr_clean(csr_graph_t* graph);
+
+/* TRAVERSALS */
+/*
+ * Function: traversal_bfs
+ * --------------------
+ *  Direction-optimizing breadth first search. Runs top-down steps from a
+ *  frontier queue and switches to bottom-up steps over a frontier bitset
+ *  when the frontier gets large, if the graph has in edges.
+ *
+ *  graph: Pointer to the CSR graph.
+ *  source: Vertex to start from.
+ *  visit: Optional function called once for each reached vertex.
+ *  ctx: User context passed to visit.
+ *  parents: Optional output array of n_vertices parents,
+ *           TRAVERSAL_NO_VERTEX for unreached vertices and the source.
+ *
+ *  returns: Number of vertices reached.
+ */
+size_t traversal_bfs(const csr_graph_t* graph, vertex_t source, visit_t visit,
+                void* ctx, vertex_t* parents);
+
+/*
+ * Function: traversal_bfs_parallel
+ * --------------------
+ *  Multi-threaded direction-optimizing breadth first search. Top-down steps
+ *  claim vertices with atomic bitset updates, bottom-up steps partition the
+ *  bitsets by word so need no atomics. visit is called concurrently and
+ *  must be thread safe.
+ *
+ *  graph: Pointer to the CSR graph.
+ *  source: Vertex to start from.
+ *  n_threads: Number of threads to use, including the caller.
+ *  visit: Optional function called once for each reached vertex.
+ *  ctx: User context passed to visit.
+ *  parents: Optional output array of n_vertices parents.
+ *
+ *  returns: Number of vertices reached.
+ */
+size_t traversal_bfs_parallel(const csr_graph_t* graph, vertex_t source,
+                size_t n_threads, visit_t visit, void* ctx, vertex_t* parents);
+
+/*
+ * Function: traversal_dfs
+ * --------------------
+ *  Iterative depth first search on an array stack, visit is called in
+ *  pre-order.
+ *
+ *  graph: Pointer to the CSR graph.
+ *  source: Vertex to start from.
+ *  visit: Optional function called once for each reached vertex.
+ *  ctx: User context passed to visit.
+ *  parents: Optional output array of n_vertices parents.
+ *
+ *  returns: Number of vertices reached.
+ */
+size_t traversal_dfs(const csr_graph_t* graph, vertex_t source, visit_t visit,
+                void* ctx, vertex_t* parents);
+
+/*
+ * Function: traversal_reach
+ * --------------------
+ *  Multi-source breadth first search with compressed bitmaps as the visited
+ *  set and frontiers, so memory follows the vertices reached rather than
+ *  the size of the graph. Frontiers are expanded in ascending vertex order.
+ *  Vertices already in reached count as visited, so a reach set can be
+ *  built up over several calls or kept from entering parts of the graph.
+ *
+ *  graph: Pointer to the CSR graph.
+ *  sources: Vertices to start from, at depth 0.
+ *  max_depth: Deepest level to expand to, SIZE_MAX for no limit.
+ *  visit: Optional function called once for each newly reached vertex,
+ *         sources have TRAVERSAL_NO_VERTEX as their parent.
+ *  ctx: User context passed to visit.
+ *  reached: Visited set, every vertex reached is added to it.
+ *
+ *  returns: Number of vertices newly reached.
+ */
+size_t traversal_reach(const csr_graph_t* graph, const roaring_t* sources,
+                size_t max_depth, visit_t visit, void* ctx,
+                roaring_t* reached);
+
+/**** PRIVATE ****/
+/*
+ * Function: _csr_build
+ * --------------------
+ *  Builds one direction of a CSR graph with a counting sort of the edges.
+ *
+ *  n_vertices: Number of vertices.
+ *  n_edges: Number of edges.
+ *  from: Vertex each edge is stored under.
+ *  to: Vertex each edge points to.
+ *  targets: Output, set to the malloced edge target array.
+ *
+ *  returns: Malloced offsets array of n_vertices + 1 entries.
+ */
+size_t* _csr_build(size_t n_vertices, size_t n_edges, const vertex_t* from,
+                const vertex_t* to, vertex_t** targets);
+
+#endif
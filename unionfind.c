@@ -0,0 +1,506 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a custom union-find (disjoint-set) library over dense
+         element ids, using path halving and union by size. It also has a
+         lock-free mode for bulk loads and can track the connected
+         components of a RAG as it is built.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "unionfind.h"
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include "RAG.h"
+
+/* Slice of pairs handled by one bulk union thread */
+typedef struct _uf_bulk_task {
+    union_find_t* uf;
+    const size_t* a;
+    const size_t* b;
+    size_t begin;
+    size_t end;
+    pthread_t thread;
+} _uf_bulk_task_t;
+
+static void* _uf_bulk_worker(void* arg);
+
+/**** PUBLIC ****/
+
+/*
+ * Function: uf_create
+ * --------------------
+ *  Creates a new union-find with every element in its own set.
+ *
+ *  n_elements: Initial number of elements, ids are 0 .. n_elements - 1.
+ *
+ *  returns: Pointer to the new union-find.
+ */
+union_find_t* uf_create(size_t n_elements) {
+    union_find_t* uf = malloc(sizeof(union_find_t));
+    assert(uf);
+
+    uf->capacity = n_elements > UF_INITIAL_CAPACITY ?
+                n_elements : UF_INITIAL_CAPACITY;
+    uf->parent = malloc(sizeof(size_t) * uf->capacity);
+    uf->size = malloc(sizeof(size_t) * uf->capacity);
+    assert(uf->parent && uf->size);
+
+    uf->n_elements = 0;
+    uf->n_sets = 0;
+    _uf_reserve(uf, n_elements);
+
+    return uf;
+}
+
+/*
+ * Function: uf_add
+ * --------------------
+ *  Adds a new element in its own set, growing the arrays if needed.
+ *
+ *  uf: Pointer to the union-find.
+ *
+ *  returns: Id of the new element.
+ */
+size_t uf_add(union_find_t* uf) {
+    assert(uf);
+
+    _uf_reserve(uf, uf->n_elements + 1);
+    return uf->n_elements - 1;
+}
+
+/*
+ * Function: uf_find
+ * --------------------
+ *  Finds the representative of the set containing x, halving the path on
+ *  the way up.
+ *
+ *  uf: Pointer to the union-find.
+ *  x: Element to find.
+ *
+ *  returns: Representative of the set of x.
+ */
+size_t uf_find(union_find_t* uf, size_t x) {
+    assert(uf);
+    assert(x < uf->n_elements);
+    size_t* parent = uf->parent;
+
+    // Point every other node on the path at its grandparent
+    while (parent[x] != x) {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+
+    return x;
+}
+
+/*
+ * Function: uf_union
+ * --------------------
+ *  Merges the sets of a and b, attaching the smaller set under the larger.
+ *
+ *  uf: Pointer to the union-find.
+ *  a: Element of the first set.
+ *  b: Element of the second set.
+ *
+ *  returns: True if the sets were merged, false if already the same set.
+ */
+bool uf_union(union_find_t* uf, size_t a, size_t b) {
+    assert(uf);
+    size_t tmp = 0;
+
+    a = uf_find(uf, a);
+    b = uf_find(uf, b);
+    if (a == b) {
+        return false;
+    }
+
+    // Keep a as the larger set
+    if (uf->size[a] < uf->size[b]) {
+        tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    uf->parent[b] = a;
+    uf->size[a] += uf->size[b];
+    uf->n_sets--;
+
+    return true;
+}
+
+/*
+ * Function: uf_connected
+ * --------------------
+ *  Checks if two elements are in the same set.
+ *
+ *  uf: Pointer to the union-find.
+ *  a: First element.
+ *  b: Second element.
+ *
+ *  returns: True if a and b are in the same set, false otherwise.
+ */
+bool uf_connected(union_find_t* uf, size_t a, size_t b) {
+    assert(uf);
+    return uf_find(uf, a) == uf_find(uf, b);
+}
+
+/*
+ * Function: uf_set_size
+ * --------------------
+ *  Gets the size of the set containing x.
+ *
+ *  uf: Pointer to the union-find.
+ *  x: Element of the set.
+ *
+ *  returns: Number of elements in the set.
+ */
+size_t uf_set_size(union_find_t* uf, size_t x) {
+    assert(uf);
+    return uf->size[uf_find(uf, x)];
+}
+
+/*
+ * Function: uf_clean
+ * --------------------
+ *  Frees the union-find.
+ *
+ *  uf: Pointer to the union-find.
+ *
+ *  returns: Nothing.
+ */
+void uf_clean(union_find_t* uf) {
+    assert(uf);
+    free(uf->parent);
+    free(uf->size);
+    free(uf);
+}
+
+/* CONCURRENT */
+/*
+ * Function: uf_find_concurrent
+ * --------------------
+ *  Lock-free find, path halving is done with compare and swap so it is
+ *  safe to run alongside uf_union_concurrent on other threads.
+ *
+ *  uf: Pointer to the union-find.
+ *  x: Element to find.
+ *
+ *  returns: Representative of the set of x at some point during the call.
+ */
+size_t uf_find_concurrent(union_find_t* uf, size_t x) {
+    assert(uf);
+    size_t* parent = uf->parent;
+
+    while (true) {
+        size_t p = __atomic_load_n(&parent[x], __ATOMIC_ACQUIRE);
+        if (p == x) {
+            return x;
+        }
+
+        // A failed swap only means someone else shortened the path first
+        size_t grandparent = __atomic_load_n(&parent[p], __ATOMIC_ACQUIRE);
+        if (p != grandparent) {
+            __atomic_compare_exchange_n(&parent[x], &p, grandparent, true,
+                        __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+        }
+        x = grandparent;
+    }
+}
+
+/*
+ * Function: uf_union_concurrent
+ * --------------------
+ *  Lock-free union, links the root with the larger id under the smaller one
+ *  with compare and swap. Set sizes and n_sets are not maintained, call
+ *  uf_recount once all threads are done.
+ *
+ *  uf: Pointer to the union-find.
+ *  a: Element of the first set.
+ *  b: Element of the second set.
+ *
+ *  returns: True if this call merged the sets, false otherwise.
+ */
+bool uf_union_concurrent(union_find_t* uf, size_t a, size_t b) {
+    assert(uf);
+    size_t tmp = 0;
+
+    while (true) {
+        a = uf_find_concurrent(uf, a);
+        b = uf_find_concurrent(uf, b);
+        if (a == b) {
+            return false;
+        }
+
+        // Ordering links by id means no two threads can form a cycle
+        if (a < b) {
+            tmp = a;
+            a = b;
+            b = tmp;
+        }
+
+        // Only succeeds if a is still a root, otherwise retry from new roots
+        size_t expected = a;
+        if (__atomic_compare_exchange_n(&uf->parent[a], &expected, b, false,
+                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return true;
+        }
+    }
+}
+
+/*
+ * Function: uf_bulk_union
+ * --------------------
+ *  Merges the sets of every pair (a[i], b[i]) using n_threads threads
+ *  running lock-free unions, then recounts set sizes.
+ *
+ *  uf: Pointer to the union-find.
+ *  a: First element of each pair.
+ *  b: Second element of each pair.
+ *  n_pairs: Number of pairs.
+ *  n_threads: Number of threads to use, including the caller.
+ *
+ *  returns: Nothing.
+ */
+void uf_bulk_union(union_find_t* uf, const size_t* a, const size_t* b,
+                size_t n_pairs, size_t n_threads) {
+    assert(uf);
+    assert(n_pairs == 0 || (a && b));
+
+    if (n_threads == 0) {
+        n_threads = 1;
+    }
+
+    _uf_bulk_task_t* tasks = malloc(sizeof(_uf_bulk_task_t) * n_threads);
+    assert(tasks);
+
+    // Split pairs evenly, the caller takes the first slice
+    for (size_t i = 0; i < n_threads; i++) {
+        tasks[i].uf = uf;
+        tasks[i].a = a;
+        tasks[i].b = b;
+        tasks[i].begin = n_pairs * i / n_threads;
+        tasks[i].end = n_pairs * (i + 1) / n_threads;
+        if (i > 0) {
+            pthread_create(&tasks[i].thread, NULL, _uf_bulk_worker, &tasks[i]);
+        }
+    }
+
+    _uf_bulk_worker(&tasks[0]);
+
+    for (size_t i = 1; i < n_threads; i++) {
+        pthread_join(tasks[i].thread, NULL);
+    }
+    free(tasks);
+
+    uf_recount(uf);
+}
+
+/*
+ * Function: uf_recount
+ * --------------------
+ *  Recomputes set sizes and the number of sets after concurrent unions.
+ *
+ *  uf: Pointer to the union-find.
+ *
+ *  returns: Nothing.
+ */
+void uf_recount(union_find_t* uf) {
+    assert(uf);
+
+    for (size_t x = 0; x < uf->n_elements; x++) {
+        uf->size[x] = 0;
+    }
+
+    uf->n_sets = 0;
+    for (size_t x = 0; x < uf->n_elements; x++) {
+        size_t root = uf_find(uf, x);
+        if (uf->size[root]++ == 0) {
+            uf->n_sets++;
+        }
+    }
+}
+
+/* RAG COMPONENTS */
+/*
+ * Function: uf_create_from_RAG
+ * --------------------
+ *  Creates a union-find of the connected components of the undirected view
+ *  of a RAG, indexed by RAG node id. Existing edges are bulk loaded.
+ *
+ *  rag: Pointer to the RAG.
+ *  n_threads: Number of threads to bulk load with.
+ *
+ *  returns: Pointer to the new union-find.
+ */
+union_find_t* uf_create_from_RAG(RAG_t* rag, size_t n_threads) {
+    assert(rag);
+    hashtable_t* ht = rag->ht;
+    RAG_node_t* node = NULL;
+    size_t n_pairs = 0;
+
+    size_t* a = malloc(sizeof(size_t) * (ht->n_values ? ht->n_values : 1));
+    size_t* b = malloc(sizeof(size_t) * (ht->n_values ? ht->n_values : 1));
+    assert(a && b);
+
+    // Every node has at most one next edge
+    for (size_t i = 0; i < ht->size; i++) {
+        for (ht_node_t* ht_node = ht->table[i]; ht_node;
+                    ht_node = ht_node->next) {
+            node = ht_node->value;
+            if (node->next) {
+                a[n_pairs] = node->id;
+                b[n_pairs++] = node->next->id;
+            }
+        }
+    }
+
+    union_find_t* uf = uf_create(rag->n_nodes);
+    uf_bulk_union(uf, a, b, n_pairs, n_threads);
+
+    free(a);
+    free(b);
+
+    return uf;
+}
+
+/*
+ * Function: uf_track_RAG
+ * --------------------
+ *  Keeps the union-find up to date as nodes and edges are inserted into the
+ *  RAG. Components only ever merge, an edge overwritten by RAG_hard_insert
+ *  keeps its endpoints connected.
+ *
+ *  uf: Pointer to the union-find.
+ *  rag: Pointer to the RAG.
+ *
+ *  returns: True if tracking started, false if the RAG has no free observer.
+ */
+bool uf_track_RAG(union_find_t* uf, RAG_t* rag) {
+    assert(uf);
+    assert(rag);
+
+    _uf_reserve(uf, rag->n_nodes);
+    return RAG_add_observer(rag, _uf_RAG_observer, uf);
+}
+
+/*
+ * Function: uf_untrack_RAG
+ * --------------------
+ *  Stops tracking a RAG, must be called before uf_clean if the RAG lives on.
+ *
+ *  uf: Pointer to the union-find.
+ *  rag: Pointer to the RAG.
+ *
+ *  returns: Nothing.
+ */
+void uf_untrack_RAG(union_find_t* uf, RAG_t* rag) {
+    assert(uf);
+    assert(rag);
+    RAG_remove_observer(rag, _uf_RAG_observer, uf);
+}
+
+/*
+ * Function: uf_memory_usage
+ * --------------------
+ *  Gets the memory uf uses. Parent and size entries of added elements
+ *  are nodes, spare capacity is slack.
+ *
+ *  uf: Pointer to the union-find.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t uf_memory_usage(union_find_t* uf, memory_usage_t* usage) {
+    assert(uf);
+    assert(usage);
+    memset(usage, 0, sizeof(memory_usage_t));
+
+    allocator_account(NULL, sizeof(union_find_t), 1, &usage->header, usage);
+    allocator_account(NULL, sizeof(size_t) * uf->capacity, 2, &usage->nodes,
+                usage);
+
+    size_t unused = 2 * sizeof(size_t) * (uf->capacity - uf->n_elements);
+    usage->nodes -= unused;
+    usage->slack += unused;
+
+    return usage->total;
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _uf_reserve
+ * --------------------
+ *  Adds singleton elements until the union-find holds n_elements.
+ *
+ *  uf: Pointer to the union-find.
+ *  n_elements: Minimum number of elements.
+ *
+ *  returns: Nothing.
+ */
+void _uf_reserve(union_find_t* uf, size_t n_elements) {
+    if (n_elements <= uf->n_elements) {
+        return;
+    }
+
+    // Grow geometrically
+    if (n_elements > uf->capacity) {
+        while (uf->capacity < n_elements) {
+            uf->capacity *= 2;
+        }
+        uf->parent = realloc(uf->parent, sizeof(size_t) * uf->capacity);
+        uf->size = realloc(uf->size, sizeof(size_t) * uf->capacity);
+        assert(uf->parent && uf->size);
+    }
+
+    for (size_t x = uf->n_elements; x < n_elements; x++) {
+        uf->parent[x] = x;
+        uf->size[x] = 1;
+    }
+    uf->n_sets += n_elements - uf->n_elements;
+    uf->n_elements = n_elements;
+}
+
+/*
+ * Function: _uf_RAG_observer
+ * --------------------
+ *  RAG observer that unions the endpoints of new edges.
+ *
+ *  returns: Nothing.
+ */
+void _uf_RAG_observer(void* ctx, RAG_node_t* node, RAG_node_t* old_next,
+                status_t status) {
+    union_find_t* uf = ctx;
+    (void)old_next;
+
+    // Ids are dense, so new nodes are always the next element
+    _uf_reserve(uf, node->id + 1);
+
+    if (status == UPDATED_DATA || !node->next) {
+        return;
+    }
+
+    _uf_reserve(uf, node->next->id + 1);
+    uf_union(uf, node->id, node->next->id);
+}
+
+/*
+ * Function: _uf_bulk_worker
+ * --------------------
+ *  Runs lock-free unions over one slice of pairs.
+ *
+ *  returns: NULL.
+ */
+static void* _uf_bulk_worker(void* arg) {
+    _uf_bulk_task_t* task = arg;
+
+    for (size_t i = task->begin; i < task->end; i++) {
+        uf_union_concurrent(task->uf, task->a[i], task->b[i]);
+    }
+
+    return NULL;
+}
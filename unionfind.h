@@ -0,0 +1,236 @@
+#ifndef UNIONFIND_H
+#define UNIONFIND_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include "RAG.h"
+
+#define UF_INITIAL_CAPACITY 64
+
+typedef struct union_find {
+    size_t n_elements;
+    size_t capacity;
+    size_t n_sets;
+    size_t* parent;
+    // Set size, only meaningful at roots
+    size_t* size;
+} union_find_t;
+
+/*
+ * Function: uf_create
+ * --------------------
+ *  Creates a new union-find with every element in its own set.
+ *
+ *  n_elements: Initial number of elements, ids are 0 .. n_elements - 1.
+ *
+ *  returns: Pointer to the new union-find.
+ */
+union_find_t* uf_create(size_t n_elements);
+
+/*
+ * Function: uf_add
+ * --------------------
+ *  Adds a new element in its own set, growing the arrays if needed.
+ *
+ *  uf: Pointer to the union-find.
+ *
+ *  returns: Id of the new element.
+ */
+size_t uf_add(union_find_t* uf);
+
+/*
+ * Function: uf_find
+ * --------------------
+ *  Finds the representative of the set containing x, halving the path on
+ *  the way up.
+ *
+ *  uf: Pointer to the union-find.
+ *  x: Element to find.
+ *
+ *  returns: Representative of the set of x.
+ */
+size_t uf_find(union_find_t* uf, size_t x);
+
+/*
+ * Function: uf_union
+ * --------------------
+ *  Merges the sets of a and b, attaching the smaller set under the larger.
+ *
+ *  uf: Pointer to the union-find.
+ *  a: Element of the first set.
+ *  b: Element of the second set.
+ *
+ *  returns: True if the sets were merged, false if already the same set.
+ */
+bool uf_union(union_find_t* uf, size_t a, size_t b);
+
+/*
+ * Function: uf_connected
+ * --------------------
+ *  Checks if two elements are in the same set.
+ *
+ *  uf: Pointer to the union-find.
+ *  a: First element.
+ *  b: Second element.
+ *
+ *  returns: True if a and b are in the same set, false otherwise.
+ */
+bool uf_connected(union_find_t* uf, size_t a, size_t b);
+
+/*
+ * Function: uf_set_size
+ * --------------------
+ *  Gets the size of the set containing x.
+ *
+ *  uf: Pointer to the union-find.
+ *  x: Element of the set.
+ *
+ *  returns: Number of elements in the set.
+ */
+size_t uf_set_size(union_find_t* uf, size_t x);
+
+/*
+ * Function: uf_clean
+ * --------------------
+ *  Frees the union-find.
+ *
+ *  uf: Pointer to the union-find.
+ *
+ *  returns: Nothing.
+ */
+void uf_clean(union_find_t* uf);
+
+/* CONCURRENT */
+/*
+ * Function: uf_find_concurrent
+ * --------------------
+ *  Lock-free find, path halving is done with compare and swap so it is
+ *  safe to run alongside uf_union_concurrent on other threads.
+ *
+ *  uf: Pointer to the union-find.
+ *  x: Element to find.
+ *
+ *  returns: Representative of the set of x at some point during the call.
+ */
+size_t uf_find_concurrent(union_find_t* uf, size_t x);
+
+/*
+ * Function: uf_union_concurrent
+ * --------------------
+ *  Lock-free union, links the root with the larger id under the smaller one
+ *  with compare and swap. Set sizes and n_sets are not maintained, call
+ *  uf_recount once all threads are done.
+ *
+ *  uf: Pointer to the union-find.
+ *  a: Element of the first set.
+ *  b: Element of the second set.
+ *
+ *  returns: True if this call merged the sets, false otherwise.
+ */
+bool uf_union_concurrent(union_find_t* uf, size_t a, size_t b);
+
+/*
+ * Function: uf_bulk_union
+ * --------------------
+ *  Merges the sets of every pair (a[i], b[i]) using n_threads threads
+ *  running lock-free unions, then recounts set sizes.
+ *
+ *  uf: Pointer to the union-find.
+ *  a: First element of each pair.
+ *  b: Second element of each pair.
+ *  n_pairs: Number of pairs.
+ *  n_threads: Number of threads to use, including the caller.
+ *
+ *  returns: Nothing.
+ */
+void uf_bulk_union(union_find_t* uf, const size_t* a, const size_t* b,
+                size_t n_pairs, size_t n_threads);
+
+/*
+ * Function: uf_recount
+ * --------------------
+ *  Recomputes set sizes and the number of sets after concurrent unions.
+ *
+ *  uf: Pointer to the union-find.
+ *
+ *  returns: Nothing.
+ */
+void uf_recount(union_find_t* uf);
+
+/* RAG COMPONENTS */
+/*
+ * Function: uf_create_from_RAG
+ * --------------------
+ *  Creates a union-find of the connected components of the undirected view
+ *  of a RAG, indexed by RAG node id. Existing edges are bulk loaded.
+ *
+ *  rag: Pointer to the RAG.
+ *  n_threads: Number of threads to bulk load with.
+ *
+ *  returns: Pointer to the new union-find.
+ */
+union_find_t* uf_create_from_RAG(RAG_t* rag, size_t n_threads);
+
+/*
+ * Function: uf_track_RAG
+ * --------------------
+ *  Keeps the union-find up to date as nodes and edges are inserted into the
+ *  RAG. Components only ever merge, an edge overwritten by RAG_hard_insert
+ *  keeps its endpoints connected.
+ *
+ *  uf: Pointer to the union-find.
+ *  rag: Pointer to the RAG.
+ *
+ *  returns: True if tracking started, false if the RAG has no free observer.
+ */
+bool uf_track_RAG(union_find_t* uf, RAG_t* rag);
+
+/*
+ * Function: uf_untrack_RAG
+ * --------------------
+ *  Stops tracking a RAG, must be called before uf_clean if the RAG lives on.
+ *
+ *  uf: Pointer to the union-find.
+ *  rag: Pointer to the RAG.
+ *
+ *  returns: Nothing.
+ */
+void uf_untrack_RAG(union_find_t* uf, RAG_t* rag);
+
+/*
+ * Function: uf_memory_usage
+ * --------------------
+ *  Gets the memory uf uses. Parent and size entries of added elements
+ *  are nodes, spare capacity is slack.
+ *
+ *  uf: Pointer to the union-find.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t uf_memory_usage(union_find_t* uf, memory_usage_t* usage);
+
+/**** PRIVATE ****/
+/*
+ * Function: _uf_reserve
+ * --------------------
+ *  Adds singleton elements until the union-find holds n_elements.
+ *
+ *  uf: Pointer to the union-find.
+ *  n_elements: Minimum number of elements.
+ *
+ *  returns: Nothing.
+ */
+void _uf_reserve(union_find_t* uf, size_t n_elements);
+
+/*
+ * Function: _uf_RAG_observer
+ * --------------------
+ *  RAG observer that unions the endpoints of new edges.
+ *
+ *  returns: Nothing.
+ */
+void _uf_RAG_observer(void* ctx, RAG_node_t* node, RAG_node_t* old_next,
+                status_t status);
+
+#endif
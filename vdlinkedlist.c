@@ -0,0 +1,373 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a custom by value doubly linked list library. Elements
+         live inline in one contiguous slot array linked by 32 bit indices,
+         so there is no allocation per element and neighbours usually share
+         cache lines.
+*/
+
+#include "vdlinkedlist.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "alloctrack.h"
+
+/**** PUBLIC ****/
+
+/*
+ * Function: vDLL_create
+ * --------------------
+ *  Creates a new by value doubly linked list.
+ *
+ *  elem_size: Size of each element.
+ *
+ *  returns: Pointer to the new doubly linked list.
+ */
+vDLL_t* vDLL_create(size_t elem_size) {
+    return vDLL_create_with_allocator(elem_size, NULL);
+}
+
+/*
+ * Function: vDLL_create_with_allocator
+ * --------------------
+ *  Creates a new by value doubly linked list whose memory comes from an
+ *  allocator.
+ *
+ *  elem_size: Size of each element.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new doubly linked list.
+ */
+vDLL_t* vDLL_create_with_allocator(size_t elem_size,
+                const allocator_t* allocator) {
+    assert(elem_size);
+    allocator_t alloc = allocator_resolve(allocator);
+
+    vDLL_t* dll = allocator_alloc(&alloc, sizeof(vDLL_t));
+    assert(dll);
+
+    dll->elem_size = elem_size;
+    dll->slot_size = (sizeof(vDLL_link_t) + elem_size + 7) & ~(size_t)7;
+    dll->capacity = 0;
+    dll->n_elements = 0;
+    dll->head = VDLL_NONE;
+    dll->tail = VDLL_NONE;
+    dll->free_head = VDLL_NONE;
+    dll->slots = NULL;
+    dll->allocator = alloc;
+
+    return dll;
+}
+
+/*
+ * Function: vDLL_insert_head
+ * --------------------
+ *  Copies an element to the head of the list.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *  elem: Pointer to the element, NULL to leave it uninitialised.
+ *
+ *  returns: Handle of the new element.
+ */
+uint32_t vDLL_insert_head(vDLL_t* dll, const void* elem) {
+    assert(dll);
+    uint32_t handle = _vDLL_take_slot(dll, elem);
+    vDLL_link_t* link = _vDLL_link(dll, handle);
+
+    link->prev = VDLL_NONE;
+    link->next = dll->head;
+
+    // Insert at head
+    if (dll->head != VDLL_NONE) {
+        _vDLL_link(dll, dll->head)->prev = handle;
+    }
+
+    if (dll->tail == VDLL_NONE) {
+        dll->tail = handle;
+    }
+
+    dll->head = handle;
+    return handle;
+}
+
+/*
+ * Function: vDLL_insert_tail
+ * --------------------
+ *  Copies an element to the tail of the list.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *  elem: Pointer to the element, NULL to leave it uninitialised.
+ *
+ *  returns: Handle of the new element.
+ */
+uint32_t vDLL_insert_tail(vDLL_t* dll, const void* elem) {
+    assert(dll);
+    uint32_t handle = _vDLL_take_slot(dll, elem);
+    vDLL_link_t* link = _vDLL_link(dll, handle);
+
+    link->prev = dll->tail;
+    link->next = VDLL_NONE;
+
+    // Insert at tail
+    if (dll->tail != VDLL_NONE) {
+        _vDLL_link(dll, dll->tail)->next = handle;
+    }
+
+    if (dll->head == VDLL_NONE) {
+        dll->head = handle;
+    }
+
+    dll->tail = handle;
+    return handle;
+}
+
+/*
+ * Function: vDLL_pop
+ * --------------------
+ *  Removes the head element of the list.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *  out: Where to copy the element, may be NULL.
+ *
+ *  returns: True if an element was removed, false if the list is empty.
+ */
+bool vDLL_pop(vDLL_t* dll, void* out) {
+    assert(dll);
+
+    if (dll->head == VDLL_NONE) {
+        return false;
+    }
+
+    vDLL_remove(dll, dll->head, out);
+    return true;
+}
+
+/*
+ * Function: vDLL_dequeue
+ * --------------------
+ *  Removes the tail element of the list.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *  out: Where to copy the element, may be NULL.
+ *
+ *  returns: True if an element was removed, false if the list is empty.
+ */
+bool vDLL_dequeue(vDLL_t* dll, void* out) {
+    assert(dll);
+
+    if (dll->tail == VDLL_NONE) {
+        return false;
+    }
+
+    vDLL_remove(dll, dll->tail, out);
+    return true;
+}
+
+/*
+ * Function: vDLL_remove
+ * --------------------
+ *  Removes an element in O(1).
+ *
+ *  dll: Pointer to the doubly linked list.
+ *  handle: Handle of the element.
+ *  out: Where to copy the element, may be NULL.
+ *
+ *  returns: Nothing.
+ */
+void vDLL_remove(vDLL_t* dll, uint32_t handle, void* out) {
+    assert(dll);
+    assert(handle < dll->capacity);
+    vDLL_link_t* link = _vDLL_link(dll, handle);
+
+    // Disconnect prev
+    if (link->prev != VDLL_NONE) {
+        _vDLL_link(dll, link->prev)->next = link->next;
+    } else {
+        dll->head = link->next;
+    }
+
+    // Disconnect next
+    if (link->next != VDLL_NONE) {
+        _vDLL_link(dll, link->next)->prev = link->prev;
+    } else {
+        dll->tail = link->prev;
+    }
+
+    if (out) {
+        memcpy(out, vDLL_get(dll, handle), dll->elem_size);
+    }
+
+    // Slot goes back on the free list
+    link->next = dll->free_head;
+    dll->free_head = handle;
+    dll->n_elements--;
+}
+
+/*
+ * Function: vDLL_get
+ * --------------------
+ *  Gets an element in place.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *  handle: Handle of the element.
+ *
+ *  returns: Pointer to the element, valid until the list grows.
+ */
+void* vDLL_get(vDLL_t* dll, uint32_t handle) {
+    assert(dll);
+    assert(handle < dll->capacity);
+    return dll->slots + handle * dll->slot_size + sizeof(vDLL_link_t);
+}
+
+/*
+ * Function: vDLL_next
+ * --------------------
+ *  Gets the element after another, iterate from dll->head.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *  handle: Handle of the element.
+ *
+ *  returns: Handle of the next element, VDLL_NONE at the tail.
+ */
+uint32_t vDLL_next(vDLL_t* dll, uint32_t handle) {
+    assert(dll);
+    return _vDLL_link(dll, handle)->next;
+}
+
+/*
+ * Function: vDLL_prev
+ * --------------------
+ *  Gets the element before another, iterate from dll->tail.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *  handle: Handle of the element.
+ *
+ *  returns: Handle of the previous element, VDLL_NONE at the head.
+ */
+uint32_t vDLL_prev(vDLL_t* dll, uint32_t handle) {
+    assert(dll);
+    return _vDLL_link(dll, handle)->prev;
+}
+
+/*
+ * Function: vDLL_is_empty
+ * --------------------
+ *  Checks if the list is empty.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *
+ *  returns: True if list is empty, false otherwise.
+ */
+bool vDLL_is_empty(vDLL_t* dll) {
+    assert(dll);
+    return dll->head == VDLL_NONE;
+}
+
+/*
+ * Function: vDLL_clean
+ * --------------------
+ *  Frees the list and its elements.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void vDLL_clean(vDLL_t* dll) {
+    assert(dll);
+    allocator_t allocator = dll->allocator;
+    const void* owner = &dll->allocator;
+
+    if (dll->slots) {
+        allocator_free(&allocator, dll->slots, dll->slot_size * dll->capacity);
+    }
+    allocator_free(&allocator, dll, sizeof(vDLL_t));
+    if (!allocator_is_bulk(&allocator)) {
+        ALLOCTRACK_CLEANED(owner);
+    }
+}
+
+/*
+ * Function: vDLL_memory_usage
+ * --------------------
+ *  Gets the memory dll uses. Live slots, links included, are nodes and
+ *  free slots are slack.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t vDLL_memory_usage(vDLL_t* dll, memory_usage_t* usage) {
+    assert(dll);
+    assert(usage);
+    memset(usage, 0, sizeof(memory_usage_t));
+
+    allocator_account(&dll->allocator, sizeof(vDLL_t), 1, &usage->header,
+                usage);
+    if (dll->slots) {
+        allocator_account(&dll->allocator, dll->slot_size * dll->capacity, 1,
+                    &usage->nodes, usage);
+    }
+
+    size_t unused = dll->slot_size * (dll->capacity - dll->n_elements);
+    usage->nodes -= unused;
+    usage->slack += unused;
+
+    return usage->total;
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _vDLL_link
+ * --------------------
+ *  Gets the links of a slot.
+ *
+ *  returns: Pointer to the links.
+ */
+vDLL_link_t* _vDLL_link(vDLL_t* dll, uint32_t handle) {
+    return (vDLL_link_t*)(dll->slots + handle * dll->slot_size);
+}
+
+/*
+ * Function: _vDLL_take_slot
+ * --------------------
+ *  Takes a free slot, growing the slot array if there is none.
+ *
+ *  returns: Handle of the slot.
+ */
+uint32_t _vDLL_take_slot(vDLL_t* dll, const void* elem) {
+    uint32_t handle = dll->free_head;
+
+    if (handle == VDLL_NONE) {
+        size_t new_capacity = dll->capacity ? dll->capacity * 2 :
+                    VDLL_INITIAL_CAPACITY;
+        assert(new_capacity < VDLL_NONE);
+
+        char* slots = allocator_alloc(&dll->allocator,
+                    dll->slot_size * new_capacity);
+        assert(slots);
+        if (dll->slots) {
+            memcpy(slots, dll->slots, dll->slot_size * dll->capacity);
+            allocator_free(&dll->allocator, dll->slots,
+                        dll->slot_size * dll->capacity);
+        }
+        dll->slots = slots;
+
+        // Thread the new slots onto the free list, lowest first
+        for (size_t i = new_capacity; i > dll->capacity; i--) {
+            _vDLL_link(dll, (uint32_t)(i - 1))->next = dll->free_head;
+            dll->free_head = (uint32_t)(i - 1);
+        }
+        dll->capacity = new_capacity;
+        handle = dll->free_head;
+    }
+
+    dll->free_head = _vDLL_link(dll, handle)->next;
+    dll->n_elements++;
+
+    if (elem) {
+        memcpy(vDLL_get(dll, handle), elem, dll->elem_size);
+    }
+    return handle;
+}
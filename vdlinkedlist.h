@@ -0,0 +1,241 @@
+#ifndef VDLINKEDLIST_H
+#define VDLINKEDLIST_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "allocator.h"
+#include "hints.h"
+
+#define VDLL_NONE UINT32_MAX
+#define VDLL_INITIAL_CAPACITY 16
+
+/*
+ * Links of a slot, as indices into the slot array so they stay valid when
+ * the array grows. Elements follow the links, aligned to 8 bytes.
+ */
+typedef struct vDLL_link {
+    uint32_t prev;
+    uint32_t next;
+} vDLL_link_t;
+
+/*
+ * Doubly linked list storing elements by value in one contiguous slot
+ * array. Elements are addressed by handles, which stay valid until the
+ * element is removed.
+ */
+typedef struct vDLL {
+    size_t elem_size;
+    size_t slot_size;
+    size_t capacity;
+    size_t n_elements;
+    uint32_t head;
+    uint32_t tail;
+    // Free slots, linked through next
+    uint32_t free_head;
+    char* slots;
+    // Source of the list and its slots
+    allocator_t allocator;
+} vDLL_t;
+
+/*
+ * Function: vDLL_create
+ * --------------------
+ *  Creates a new by value doubly linked list.
+ *
+ *  elem_size: Size of each element.
+ *
+ *  returns: Pointer to the new doubly linked list.
+ */
+vDLL_t* vDLL_create(size_t elem_size);
+
+/*
+ * Function: vDLL_create_with_allocator
+ * --------------------
+ *  Creates a new by value doubly linked list whose memory comes from an
+ *  allocator.
+ *
+ *  elem_size: Size of each element.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new doubly linked list.
+ */
+vDLL_t* vDLL_create_with_allocator(size_t elem_size,
+                const allocator_t* allocator);
+
+/*
+ * Function: vDLL_insert_head
+ * --------------------
+ *  Copies an element to the head of the list.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *  elem: Pointer to the element, NULL to leave it uninitialised.
+ *
+ *  returns: Handle of the new element.
+ */
+uint32_t vDLL_insert_head(vDLL_t* dll, const void* elem);
+
+/*
+ * Function: vDLL_insert_tail
+ * --------------------
+ *  Copies an element to the tail of the list.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *  elem: Pointer to the element, NULL to leave it uninitialised.
+ *
+ *  returns: Handle of the new element.
+ */
+uint32_t vDLL_insert_tail(vDLL_t* dll, const void* elem);
+
+/*
+ * Function: vDLL_pop
+ * --------------------
+ *  Removes the head element of the list.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *  out: Where to copy the element, may be NULL.
+ *
+ *  returns: True if an element was removed, false if the list is empty.
+ */
+bool vDLL_pop(vDLL_t* dll, void* out);
+
+/*
+ * Function: vDLL_dequeue
+ * --------------------
+ *  Removes the tail element of the list.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *  out: Where to copy the element, may be NULL.
+ *
+ *  returns: True if an element was removed, false if the list is empty.
+ */
+bool vDLL_dequeue(vDLL_t* dll, void* out);
+
+/*
+ * Function: vDLL_remove
+ * --------------------
+ *  Removes an element in O(1).
+ *
+ *  dll: Pointer to the doubly linked list.
+ *  handle: Handle of the element.
+ *  out: Where to copy the element, may be NULL.
+ *
+ *  returns: Nothing.
+ */
+void vDLL_remove(vDLL_t* dll, uint32_t handle, void* out);
+
+/*
+ * Function: vDLL_get
+ * --------------------
+ *  Gets an element in place.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *  handle: Handle of the element.
+ *
+ *  returns: Pointer to the element, valid until the list grows.
+ */
+void* vDLL_get(vDLL_t* dll, uint32_t handle);
+
+/*
+ * Function: vDLL_next
+ * --------------------
+ *  Gets the element after another, iterate from dll->head.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *  handle: Handle of the element.
+ *
+ *  returns: Handle of the next element, VDLL_NONE at the tail.
+ */
+uint32_t vDLL_next(vDLL_t* dll, uint32_t handle);
+
+/*
+ * Function: vDLL_prev
+ * --------------------
+ *  Gets the element before another, iterate from dll->tail.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *  handle: Handle of the element.
+ *
+ *  returns: Handle of the previous element, VDLL_NONE at the head.
+ */
+uint32_t vDLL_prev(vDLL_t* dll, uint32_t handle);
+
+/*
+ * Function: vDLL_is_empty
+ * --------------------
+ *  Checks if the list is empty.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *
+ *  returns: True if list is empty, false otherwise.
+ */
+bool vDLL_is_empty(vDLL_t* dll);
+
+/*
+ * Function: vDLL_clean
+ * --------------------
+ *  Frees the list and its elements.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void vDLL_clean(vDLL_t* dll);
+
+/*
+ * Macro: VDLL_DEFINE
+ * --------------------
+ *  Defines typed wrappers name_create, name_insert_head, name_insert_tail
+ *  and name_get over vDLL_t, copying by assignment rather than memcpy.
+ */
+#define VDLL_DEFINE(name, type) \
+    static inline vDLL_t* name##_create(void) { \
+        return vDLL_create(sizeof(type)); \
+    } \
+    static inline uint32_t name##_insert_head(vDLL_t* dll, type elem) { \
+        uint32_t handle = vDLL_insert_head(dll, NULL); \
+        *(type*)vDLL_get(dll, handle) = elem; \
+        return handle; \
+    } \
+    static inline uint32_t name##_insert_tail(vDLL_t* dll, type elem) { \
+        uint32_t handle = vDLL_insert_tail(dll, NULL); \
+        *(type*)vDLL_get(dll, handle) = elem; \
+        return handle; \
+    } \
+    static inline type* name##_get(vDLL_t* dll, uint32_t handle) { \
+        return vDLL_get(dll, handle); \
+    }
+
+/*
+ * Function: vDLL_memory_usage
+ * --------------------
+ *  Gets the memory dll uses. Live slots, links included, are nodes and
+ *  free slots are slack.
+ *
+ *  dll: Pointer to the doubly linked list.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t vDLL_memory_usage(vDLL_t* dll, memory_usage_t* usage);
+
+/**** PRIVATE ****/
+/*
+ * Function: _vDLL_link
+ * --------------------
+ *  Gets the links of a slot.
+ *
+ *  returns: Pointer to the links.
+ */
+vDLL_link_t* _vDLL_link(vDLL_t* dll, uint32_t handle);
+
+/*
+ * Function: _vDLL_take_slot
+ * --------------------
+ *  Takes a free slot, growing the slot array if there is none.
+ *
+ *  returns: Handle of the slot.
+ */
+uint32_t _vDLL_take_slot(vDLL_t* dll, const void* elem);
+
+#endif
@@ -0,0 +1,816 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a custom growable vector library. Elements are copied
+         into one contiguous array that doubles as it fills, so appends are
+         amortised O(1) and indexing is a multiply. Searches over primitive
+         elements use GCC vector extensions, compiled to SSE2, AVX2 or NEON
+         by the target flags, and fall back to scalar loops elsewhere or
+         with DSL_NO_SIMD.
+*/
+
+#include "vector.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "alloctrack.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(DSL_NO_SIMD)
+#define VECTOR_HAVE_SIMD
+// Bytes compared per step, one register, wider vectors than the target has
+// are split lane by lane
+#if defined(__AVX2__)
+#define VECTOR_SIMD_BYTES 32
+#else
+#define VECTOR_SIMD_BYTES 16
+#endif
+// Steps before 8 bit lane counters could wrap
+#define VECTOR_COUNT_FLUSH 255
+#endif
+
+#ifdef VECTOR_HAVE_SIMD
+#define VECTOR_LANES(type) (VECTOR_SIMD_BYTES / sizeof(type))
+
+typedef int8_t _v_i8 __attribute__((vector_size(VECTOR_SIMD_BYTES)));
+typedef uint8_t _v_u8 __attribute__((vector_size(VECTOR_SIMD_BYTES)));
+typedef int16_t _v_i16 __attribute__((vector_size(VECTOR_SIMD_BYTES)));
+typedef uint16_t _v_u16 __attribute__((vector_size(VECTOR_SIMD_BYTES)));
+typedef int32_t _v_i32 __attribute__((vector_size(VECTOR_SIMD_BYTES)));
+typedef uint32_t _v_u32 __attribute__((vector_size(VECTOR_SIMD_BYTES)));
+typedef int64_t _v_i64 __attribute__((vector_size(VECTOR_SIMD_BYTES)));
+typedef uint64_t _v_u64 __attribute__((vector_size(VECTOR_SIMD_BYTES)));
+typedef float _v_f32 __attribute__((vector_size(VECTOR_SIMD_BYTES)));
+typedef double _v_f64 __attribute__((vector_size(VECTOR_SIMD_BYTES)));
+
+/*
+ * Checks if any lane of a comparison mask is set.
+ */
+static inline bool _vector_any(const void* mask) {
+    uint64_t words[VECTOR_SIMD_BYTES / sizeof(uint64_t)];
+    memcpy(words, mask, sizeof(words));
+    uint64_t any = 0;
+    for (size_t w = 0; w < VECTOR_SIMD_BYTES / sizeof(uint64_t); w++) {
+        any |= words[w];
+    }
+    return any != 0;
+}
+#endif
+
+/*
+ * Find and count over unsigned lanes of a width. Lanes equal to the needle
+ * compare to all ones, so subtracting the mask counts them. A chunk with a
+ * match is rescanned by the scalar tail to get the first index.
+ */
+#ifdef VECTOR_HAVE_SIMD
+#define _VECTOR_SCAN(bits) \
+    static size_t _vector_find_u##bits(const char* data, size_t n, \
+                uint##bits##_t value) { \
+        _v_u##bits needle; \
+        size_t i = 0, lanes = VECTOR_LANES(uint##bits##_t); \
+        for (size_t l = 0; l < lanes; l++) { \
+            needle[l] = value; \
+        } \
+        for (; i + lanes <= n; i += lanes) { \
+            _v_u##bits chunk; \
+            memcpy(&chunk, data + i * sizeof(value), sizeof(chunk)); \
+            __typeof__(chunk == needle) eq = chunk == needle; \
+            if (_vector_any(&eq)) { \
+                break; \
+            } \
+        } \
+        for (; i < n; i++) { \
+            uint##bits##_t elem; \
+            memcpy(&elem, data + i * sizeof(value), sizeof(elem)); \
+            if (elem == value) { \
+                return i; \
+            } \
+        } \
+        return VECTOR_NPOS; \
+    } \
+    static size_t _vector_count_u##bits(const char* data, size_t n, \
+                uint##bits##_t value) { \
+        _v_u##bits needle, counts = { 0 }; \
+        size_t i = 0, total = 0, steps = 0; \
+        size_t lanes = VECTOR_LANES(uint##bits##_t); \
+        for (size_t l = 0; l < lanes; l++) { \
+            needle[l] = value; \
+        } \
+        for (; i + lanes <= n; i += lanes) { \
+            _v_u##bits chunk; \
+            memcpy(&chunk, data + i * sizeof(value), sizeof(chunk)); \
+            counts -= (_v_u##bits)(chunk == needle); \
+            if (++steps == VECTOR_COUNT_FLUSH) { \
+                for (size_t l = 0; l < lanes; l++) { \
+                    total += counts[l]; \
+                } \
+                counts = (_v_u##bits){ 0 }; \
+                steps = 0; \
+            } \
+        } \
+        for (size_t l = 0; l < lanes; l++) { \
+            total += counts[l]; \
+        } \
+        for (; i < n; i++) { \
+            uint##bits##_t elem; \
+            memcpy(&elem, data + i * sizeof(value), sizeof(elem)); \
+            total += elem == value; \
+        } \
+        return total; \
+    }
+#else
+#define _VECTOR_SCAN(bits) \
+    static size_t _vector_find_u##bits(const char* data, size_t n, \
+                uint##bits##_t value) { \
+        for (size_t i = 0; i < n; i++) { \
+            uint##bits##_t elem; \
+            memcpy(&elem, data + i * sizeof(value), sizeof(elem)); \
+            if (elem == value) { \
+                return i; \
+            } \
+        } \
+        return VECTOR_NPOS; \
+    } \
+    static size_t _vector_count_u##bits(const char* data, size_t n, \
+                uint##bits##_t value) { \
+        size_t total = 0; \
+        for (size_t i = 0; i < n; i++) { \
+            uint##bits##_t elem; \
+            memcpy(&elem, data + i * sizeof(value), sizeof(elem)); \
+            total += elem == value; \
+        } \
+        return total; \
+    }
+#endif
+
+_VECTOR_SCAN(8)
+_VECTOR_SCAN(16)
+_VECTOR_SCAN(32)
+_VECTOR_SCAN(64)
+
+/*
+ * Minimum or maximum of a primitive type, op is < or >. Lanes keep running
+ * bests, blended in with the comparison mask, and are reduced at the end.
+ */
+#define _VECTOR_REDUCE_SCALAR(name, suffix, type, op) \
+    static type _vector_##name##_##suffix(const type* data, size_t n) { \
+        type best = data[0]; \
+        for (size_t i = 1; i < n; i++) { \
+            best = data[i] op best ? data[i] : best; \
+        } \
+        return best; \
+    }
+
+#ifdef VECTOR_HAVE_SIMD
+#define _VECTOR_REDUCE(name, suffix, type, op) \
+    static type _vector_##name##_##suffix(const type* data, size_t n) { \
+        type best = data[0]; \
+        size_t i = 0, lanes = VECTOR_LANES(type); \
+        if (n >= lanes) { \
+            _v_##suffix acc; \
+            memcpy(&acc, data, sizeof(acc)); \
+            for (i = lanes; i + lanes <= n; i += lanes) { \
+                _v_##suffix chunk; \
+                memcpy(&chunk, data + i, sizeof(chunk)); \
+                __typeof__(chunk op acc) take = chunk op acc; \
+                acc = (_v_##suffix)(((__typeof__(take))chunk & take) | \
+                            ((__typeof__(take))acc & ~take)); \
+            } \
+            best = acc[0]; \
+            for (size_t l = 1; l < lanes; l++) { \
+                best = acc[l] op best ? acc[l] : best; \
+            } \
+        } \
+        for (; i < n; i++) { \
+            best = data[i] op best ? data[i] : best; \
+        } \
+        return best; \
+    }
+#else
+#define _VECTOR_REDUCE(name, suffix, type, op) \
+    _VECTOR_REDUCE_SCALAR(name, suffix, type, op)
+#endif
+
+// x86 before SSE4.2 has no 64 bit integer compare, emulating it is slower
+// than the scalar loop
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(__SSE4_2__)
+#define _VECTOR_REDUCE_INT64(name, suffix, type, op) \
+    _VECTOR_REDUCE_SCALAR(name, suffix, type, op)
+#else
+#define _VECTOR_REDUCE_INT64(name, suffix, type, op) \
+    _VECTOR_REDUCE(name, suffix, type, op)
+#endif
+
+#define _VECTOR_MIN_MAX(suffix, type) \
+    _VECTOR_REDUCE(min, suffix, type, <) \
+    _VECTOR_REDUCE(max, suffix, type, >)
+#define _VECTOR_MIN_MAX_INT64(suffix, type) \
+    _VECTOR_REDUCE_INT64(min, suffix, type, <) \
+    _VECTOR_REDUCE_INT64(max, suffix, type, >)
+
+_VECTOR_MIN_MAX(i8, int8_t)
+_VECTOR_MIN_MAX(u8, uint8_t)
+_VECTOR_MIN_MAX(i16, int16_t)
+_VECTOR_MIN_MAX(u16, uint16_t)
+_VECTOR_MIN_MAX(i32, int32_t)
+_VECTOR_MIN_MAX(u32, uint32_t)
+_VECTOR_MIN_MAX_INT64(i64, int64_t)
+_VECTOR_MIN_MAX_INT64(u64, uint64_t)
+_VECTOR_MIN_MAX(f32, float)
+_VECTOR_MIN_MAX(f64, double)
+
+// Dispatches on the element type, copying the result to out
+#define _VECTOR_REDUCE_TYPE(name, type_id, vec, out) \
+    switch (type_id) { \
+        case VECTOR_INT8: { \
+            int8_t best = _vector_##name##_i8((const int8_t*)(vec)->data, \
+                        (vec)->n_elements); \
+            memcpy(out, &best, sizeof(best)); \
+            break; \
+        } \
+        case VECTOR_UINT8: { \
+            uint8_t best = _vector_##name##_u8( \
+                        (const uint8_t*)(vec)->data, (vec)->n_elements); \
+            memcpy(out, &best, sizeof(best)); \
+            break; \
+        } \
+        case VECTOR_INT16: { \
+            int16_t best = _vector_##name##_i16( \
+                        (const int16_t*)(vec)->data, (vec)->n_elements); \
+            memcpy(out, &best, sizeof(best)); \
+            break; \
+        } \
+        case VECTOR_UINT16: { \
+            uint16_t best = _vector_##name##_u16( \
+                        (const uint16_t*)(vec)->data, (vec)->n_elements); \
+            memcpy(out, &best, sizeof(best)); \
+            break; \
+        } \
+        case VECTOR_INT32: { \
+            int32_t best = _vector_##name##_i32( \
+                        (const int32_t*)(vec)->data, (vec)->n_elements); \
+            memcpy(out, &best, sizeof(best)); \
+            break; \
+        } \
+        case VECTOR_UINT32: { \
+            uint32_t best = _vector_##name##_u32( \
+                        (const uint32_t*)(vec)->data, (vec)->n_elements); \
+            memcpy(out, &best, sizeof(best)); \
+            break; \
+        } \
+        case VECTOR_INT64: { \
+            int64_t best = _vector_##name##_i64( \
+                        (const int64_t*)(vec)->data, (vec)->n_elements); \
+            memcpy(out, &best, sizeof(best)); \
+            break; \
+        } \
+        case VECTOR_UINT64: { \
+            uint64_t best = _vector_##name##_u64( \
+                        (const uint64_t*)(vec)->data, (vec)->n_elements); \
+            memcpy(out, &best, sizeof(best)); \
+            break; \
+        } \
+        case VECTOR_FLOAT: { \
+            float best = _vector_##name##_f32((const float*)(vec)->data, \
+                        (vec)->n_elements); \
+            memcpy(out, &best, sizeof(best)); \
+            break; \
+        } \
+        case VECTOR_DOUBLE: { \
+            double best = _vector_##name##_f64( \
+                        (const double*)(vec)->data, (vec)->n_elements); \
+            memcpy(out, &best, sizeof(best)); \
+            break; \
+        } \
+    }
+
+/**** PUBLIC ****/
+
+/*
+ * Function: vector_create
+ * --------------------
+ *  Creates a new vector.
+ *
+ *  elem_size: Size of each element.
+ *
+ *  returns: Pointer to the new vector.
+ */
+vector_t* vector_create(size_t elem_size) {
+    return vector_create_with_allocator(elem_size, NULL);
+}
+
+/*
+ * Function: vector_create_with_allocator
+ * --------------------
+ *  Creates a new vector whose memory comes from an allocator.
+ *
+ *  elem_size: Size of each element.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new vector.
+ */
+vector_t* vector_create_with_allocator(size_t elem_size,
+                const allocator_t* allocator) {
+    assert(elem_size);
+    allocator_t alloc = allocator_resolve(allocator);
+
+    vector_t* vec = allocator_alloc(&alloc, sizeof(vector_t));
+    assert(vec);
+
+    vec->elem_size = elem_size;
+    vec->capacity = VECTOR_INITIAL_CAPACITY;
+    vec->n_elements = 0;
+    vec->allocator = alloc;
+    vec->data = allocator_alloc(&alloc, elem_size * vec->capacity);
+    assert(vec->data);
+
+    return vec;
+}
+
+/*
+ * Function: vector_adopt
+ * --------------------
+ *  Creates a vector over a caller's array without copying it. The vector
+ *  owns the array from then on, growing and freeing it through allocator.
+ *
+ *  data: Array of capacity elements, the first n_elements in use.
+ *  elem_size: Size of each element.
+ *  n_elements: Number of elements in use.
+ *  capacity: Number of elements the array holds.
+ *  allocator: Allocator the array came from, copied, NULL for malloc.
+ *
+ *  returns: Pointer to the new vector.
+ */
+vector_t* vector_adopt(void* data, size_t elem_size, size_t n_elements,
+                size_t capacity, const allocator_t* allocator) {
+    assert(data || !capacity);
+    assert(elem_size);
+    assert(n_elements <= capacity);
+
+    // Caller arrays are usually plain malloc'd, not from the thread's
+    // allocator
+    allocator_t alloc = allocator ? *allocator : allocator_malloc();
+
+    vector_t* vec = allocator_alloc(&alloc, sizeof(vector_t));
+    assert(vec);
+
+    vec->elem_size = elem_size;
+    vec->capacity = capacity;
+    vec->n_elements = n_elements;
+    vec->allocator = alloc;
+    vec->data = data;
+
+    return vec;
+}
+
+/*
+ * Function: vector_release
+ * --------------------
+ *  Frees the vector but hands its array to the caller without copying it.
+ *  The array came from the vector's allocator and holds capacity elements.
+ *
+ *  vec: Pointer to the vector.
+ *  n_elements: Output number of elements in use, may be NULL.
+ *
+ *  returns: The array, NULL if the vector never had one.
+ */
+void* vector_release(vector_t* vec, size_t* n_elements) {
+    assert(vec);
+    allocator_t allocator = vec->allocator;
+    void* data = vec->data;
+
+    if (n_elements) {
+        *n_elements = vec->n_elements;
+    }
+    allocator_free(&allocator, vec, sizeof(vector_t));
+    return data;
+}
+
+/*
+ * Function: vector_push
+ * --------------------
+ *  Copies an element to the end of the vector.
+ *
+ *  vec: Pointer to the vector.
+ *  elem: Pointer to the element, elem_size bytes are copied.
+ *
+ *  returns: Nothing.
+ */
+void vector_push(vector_t* vec, const void* elem) {
+    assert(elem);
+    memcpy(vector_push_slot(vec), elem, vec->elem_size);
+}
+
+/*
+ * Function: vector_push_slot
+ * --------------------
+ *  Adds an uninitialised element to the end of the vector, for the caller
+ *  to fill in place.
+ *
+ *  vec: Pointer to the vector.
+ *
+ *  returns: Pointer to the new element, valid until the vector changes.
+ */
+void* vector_push_slot(vector_t* vec) {
+    assert(vec);
+
+    if (DSL_UNLIKELY(vec->n_elements == vec->capacity)) {
+        _vector_resize(vec, vec->capacity ? vec->capacity *
+                    VECTOR_GROWTH_FACTOR : VECTOR_INITIAL_CAPACITY);
+    }
+    return vec->data + vec->n_elements++ * vec->elem_size;
+}
+
+/*
+ * Function: vector_pop
+ * --------------------
+ *  Removes the last element of the vector.
+ *
+ *  vec: Pointer to the vector.
+ *  out: Where to copy the element, may be NULL.
+ *
+ *  returns: True if an element was removed, false if the vector is empty.
+ */
+bool vector_pop(vector_t* vec, void* out) {
+    assert(vec);
+
+    if (!vec->n_elements) {
+        return false;
+    }
+
+    vec->n_elements--;
+    if (out) {
+        memcpy(out, vec->data + vec->n_elements * vec->elem_size,
+                    vec->elem_size);
+    }
+    return true;
+}
+
+/*
+ * Function: vector_insert
+ * --------------------
+ *  Copies an element to an index, shifting the elements after it up.
+ *
+ *  vec: Pointer to the vector.
+ *  index: Index to insert at, at most the number of elements.
+ *  elem: Pointer to the element.
+ *
+ *  returns: Nothing.
+ */
+void vector_insert(vector_t* vec, size_t index, const void* elem) {
+    assert(vec);
+    assert(elem);
+    assert(index <= vec->n_elements);
+
+    vector_push_slot(vec);
+    char* slot = vec->data + index * vec->elem_size;
+    memmove(slot + vec->elem_size, slot,
+                (vec->n_elements - 1 - index) * vec->elem_size);
+    memcpy(slot, elem, vec->elem_size);
+}
+
+/*
+ * Function: vector_erase
+ * --------------------
+ *  Removes the elements in [index, index + count), shifting the elements
+ *  after them down.
+ *
+ *  vec: Pointer to the vector.
+ *  index: First index to remove.
+ *  count: Number of elements to remove.
+ *
+ *  returns: Nothing.
+ */
+void vector_erase(vector_t* vec, size_t index, size_t count) {
+    assert(vec);
+    assert(index <= vec->n_elements && count <= vec->n_elements - index);
+
+    char* slot = vec->data + index * vec->elem_size;
+    memmove(slot, slot + count * vec->elem_size,
+                (vec->n_elements - index - count) * vec->elem_size);
+    vec->n_elements -= count;
+}
+
+/*
+ * Function: vector_set
+ * --------------------
+ *  Copies an element over the one at an index.
+ *
+ *  vec: Pointer to the vector.
+ *  index: Index of the element.
+ *  elem: Pointer to the element.
+ *
+ *  returns: Nothing.
+ */
+void vector_set(vector_t* vec, size_t index, const void* elem) {
+    assert(elem);
+    memcpy(vector_get(vec, index), elem, vec->elem_size);
+}
+
+/*
+ * Function: vector_reserve
+ * --------------------
+ *  Grows the vector to hold at least capacity elements without
+ *  reallocating.
+ *
+ *  vec: Pointer to the vector.
+ *  capacity: Number of elements.
+ *
+ *  returns: Nothing.
+ */
+void vector_reserve(vector_t* vec, size_t capacity) {
+    assert(vec);
+
+    if (capacity > vec->capacity) {
+        _vector_resize(vec, capacity);
+    }
+}
+
+/*
+ * Function: vector_shrink
+ * --------------------
+ *  Shrinks the vector's array to its number of elements.
+ *
+ *  vec: Pointer to the vector.
+ *
+ *  returns: Nothing.
+ */
+void vector_shrink(vector_t* vec) {
+    assert(vec);
+
+    if (vec->n_elements < vec->capacity) {
+        _vector_resize(vec, vec->n_elements);
+    }
+}
+
+/*
+ * Function: vector_clear
+ * --------------------
+ *  Removes every element, keeping the capacity.
+ *
+ *  vec: Pointer to the vector.
+ *
+ *  returns: Nothing.
+ */
+void vector_clear(vector_t* vec) {
+    assert(vec);
+    vec->n_elements = 0;
+}
+
+/*
+ * Function: vector_find
+ * --------------------
+ *  Finds the first element equal to elem, comparing bytes. Elements of 1,
+ *  2, 4 or 8 bytes are compared with SIMD.
+ *
+ *  vec: Pointer to the vector.
+ *  elem: Pointer to the element to find.
+ *
+ *  returns: Index of the element, VECTOR_NPOS if not found.
+ */
+size_t vector_find(vector_t* vec, const void* elem) {
+    assert(vec);
+    assert(elem);
+
+    switch (vec->elem_size) {
+        case 1: {
+            uint8_t value;
+            memcpy(&value, elem, sizeof(value));
+            return _vector_find_u8(vec->data, vec->n_elements, value);
+        }
+        case 2: {
+            uint16_t value;
+            memcpy(&value, elem, sizeof(value));
+            return _vector_find_u16(vec->data, vec->n_elements, value);
+        }
+        case 4: {
+            uint32_t value;
+            memcpy(&value, elem, sizeof(value));
+            return _vector_find_u32(vec->data, vec->n_elements, value);
+        }
+        case 8: {
+            uint64_t value;
+            memcpy(&value, elem, sizeof(value));
+            return _vector_find_u64(vec->data, vec->n_elements, value);
+        }
+        default:
+            return _vector_find_scalar(vec, elem, 0);
+    }
+}
+
+/*
+ * Function: vector_count
+ * --------------------
+ *  Counts the elements equal to elem, comparing bytes. Elements of 1, 2, 4
+ *  or 8 bytes are compared with SIMD.
+ *
+ *  vec: Pointer to the vector.
+ *  elem: Pointer to the element to count.
+ *
+ *  returns: Number of equal elements.
+ */
+size_t vector_count(vector_t* vec, const void* elem) {
+    assert(vec);
+    assert(elem);
+    size_t total = 0;
+
+    switch (vec->elem_size) {
+        case 1: {
+            uint8_t value;
+            memcpy(&value, elem, sizeof(value));
+            return _vector_count_u8(vec->data, vec->n_elements, value);
+        }
+        case 2: {
+            uint16_t value;
+            memcpy(&value, elem, sizeof(value));
+            return _vector_count_u16(vec->data, vec->n_elements, value);
+        }
+        case 4: {
+            uint32_t value;
+            memcpy(&value, elem, sizeof(value));
+            return _vector_count_u32(vec->data, vec->n_elements, value);
+        }
+        case 8: {
+            uint64_t value;
+            memcpy(&value, elem, sizeof(value));
+            return _vector_count_u64(vec->data, vec->n_elements, value);
+        }
+        default:
+            for (size_t i = _vector_find_scalar(vec, elem, 0);
+                        i != VECTOR_NPOS;
+                        i = _vector_find_scalar(vec, elem, i + 1)) {
+                total++;
+            }
+            return total;
+    }
+}
+
+/*
+ * Function: vector_min
+ * --------------------
+ *  Gets the smallest element of a vector of a primitive type, with SIMD.
+ *  The result is unspecified if a float vector holds NaN.
+ *
+ *  vec: Pointer to the vector.
+ *  type: Element type, its size must be elem_size.
+ *  out: Where to copy the smallest element.
+ *
+ *  returns: True if found, false if the vector is empty.
+ */
+bool vector_min(vector_t* vec, vector_type_t type, void* out) {
+    assert(vec);
+    assert(out);
+    assert(_vector_type_size(type) == vec->elem_size);
+
+    if (!vec->n_elements) {
+        return false;
+    }
+    _VECTOR_REDUCE_TYPE(min, type, vec, out);
+    return true;
+}
+
+/*
+ * Function: vector_max
+ * --------------------
+ *  Gets the largest element of a vector of a primitive type, with SIMD.
+ *  The result is unspecified if a float vector holds NaN.
+ *
+ *  vec: Pointer to the vector.
+ *  type: Element type, its size must be elem_size.
+ *  out: Where to copy the largest element.
+ *
+ *  returns: True if found, false if the vector is empty.
+ */
+bool vector_max(vector_t* vec, vector_type_t type, void* out) {
+    assert(vec);
+    assert(out);
+    assert(_vector_type_size(type) == vec->elem_size);
+
+    if (!vec->n_elements) {
+        return false;
+    }
+    _VECTOR_REDUCE_TYPE(max, type, vec, out);
+    return true;
+}
+
+/*
+ * Function: vector_clean
+ * --------------------
+ *  Frees the vector and its elements.
+ *
+ *  vec: Pointer to the vector.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void vector_clean(vector_t* vec) {
+    assert(vec);
+    allocator_t allocator = vec->allocator;
+    const void* owner = &vec->allocator;
+
+    if (vec->data) {
+        allocator_free(&allocator, vec->data,
+                    vec->elem_size * vec->capacity);
+    }
+    allocator_free(&allocator, vec, sizeof(vector_t));
+    if (!allocator_is_bulk(&allocator)) {
+        ALLOCTRACK_CLEANED(owner);
+    }
+}
+
+/*
+ * Function: vector_memory_usage
+ * --------------------
+ *  Gets the memory vec uses. Elements are stored inline, so unused
+ *  capacity is slack.
+ *
+ *  vec: Pointer to the vector.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t vector_memory_usage(vector_t* vec, memory_usage_t* usage) {
+    assert(vec);
+    assert(usage);
+    memset(usage, 0, sizeof(memory_usage_t));
+
+    allocator_account(&vec->allocator, sizeof(vector_t), 1, &usage->header,
+                usage);
+    if (vec->capacity) {
+        allocator_account(&vec->allocator, vec->elem_size * vec->capacity, 1,
+                    &usage->nodes, usage);
+    }
+
+    // Only live elements count as nodes
+    size_t unused = vec->elem_size * (vec->capacity - vec->n_elements);
+    usage->nodes -= unused;
+    usage->slack += unused;
+    return usage->total;
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _vector_resize
+ * --------------------
+ *  Moves the elements to a new array of capacity elements.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void _vector_resize(vector_t* vec, size_t capacity) {
+    assert(capacity >= vec->n_elements);
+    char* data = NULL;
+
+    // Allocators have no realloc, so copy into a fresh array
+    if (capacity) {
+        data = allocator_alloc(&vec->allocator, vec->elem_size * capacity);
+        assert(data);
+        if (vec->n_elements) {
+            memcpy(data, vec->data, vec->elem_size * vec->n_elements);
+        }
+    }
+    if (vec->data) {
+        allocator_free(&vec->allocator, vec->data,
+                    vec->elem_size * vec->capacity);
+    }
+
+    vec->data = data;
+    vec->capacity = capacity;
+}
+
+/*
+ * Function: _vector_find_scalar
+ * --------------------
+ *  Finds elem from index start one element at a time.
+ *
+ *  returns: Index of the element, VECTOR_NPOS if not found.
+ */
+size_t _vector_find_scalar(vector_t* vec, const void* elem, size_t start) {
+    for (size_t i = start; i < vec->n_elements; i++) {
+        if (!memcmp(vec->data + i * vec->elem_size, elem, vec->elem_size)) {
+            return i;
+        }
+    }
+    return VECTOR_NPOS;
+}
+
+/*
+ * Function: _vector_type_size
+ * --------------------
+ *  Gets the size of a primitive element type.
+ *
+ *  returns: Size in bytes.
+ */
+size_t _vector_type_size(vector_type_t type) {
+    switch (type) {
+        case VECTOR_INT8:
+        case VECTOR_UINT8:
+            return 1;
+        case VECTOR_INT16:
+        case VECTOR_UINT16:
+            return 2;
+        case VECTOR_INT32:
+        case VECTOR_UINT32:
+        case VECTOR_FLOAT:
+            return 4;
+        default:
+            return 8;
+    }
+}
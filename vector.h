@@ -0,0 +1,407 @@
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <assert.h>
+#include "allocator.h"
+#include "hints.h"
+
+#define VECTOR_INITIAL_CAPACITY 16
+#define VECTOR_GROWTH_FACTOR 2
+// Index returned by vector_find when nothing matches
+#define VECTOR_NPOS SIZE_MAX
+
+/*
+ * Growable array storing elements by value, contiguous so it can be
+ * indexed, handed to code expecting a plain array and scanned with SIMD.
+ */
+typedef struct vector {
+    size_t elem_size;
+    size_t capacity;
+    size_t n_elements;
+    char* data;
+    // Source of the vector and its buffer
+    allocator_t allocator;
+} vector_t;
+
+/*
+ * Primitive element types vector_min and vector_max understand.
+ */
+typedef enum vector_type {
+    VECTOR_INT8,
+    VECTOR_UINT8,
+    VECTOR_INT16,
+    VECTOR_UINT16,
+    VECTOR_INT32,
+    VECTOR_UINT32,
+    VECTOR_INT64,
+    VECTOR_UINT64,
+    VECTOR_FLOAT,
+    VECTOR_DOUBLE
+} vector_type_t;
+
+/**** PUBLIC ****/
+
+/*
+ * Function: vector_create
+ * --------------------
+ *  Creates a new vector.
+ *
+ *  elem_size: Size of each element.
+ *
+ *  returns: Pointer to the new vector.
+ */
+vector_t* vector_create(size_t elem_size);
+
+/*
+ * Function: vector_create_with_allocator
+ * --------------------
+ *  Creates a new vector whose memory comes from an allocator.
+ *
+ *  elem_size: Size of each element.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new vector.
+ */
+vector_t* vector_create_with_allocator(size_t elem_size,
+                const allocator_t* allocator);
+
+/*
+ * Function: vector_adopt
+ * --------------------
+ *  Creates a vector over a caller's array without copying it. The vector
+ *  owns the array from then on, growing and freeing it through allocator.
+ *
+ *  data: Array of capacity elements, the first n_elements in use.
+ *  elem_size: Size of each element.
+ *  n_elements: Number of elements in use.
+ *  capacity: Number of elements the array holds.
+ *  allocator: Allocator the array came from, copied, NULL for malloc.
+ *
+ *  returns: Pointer to the new vector.
+ */
+vector_t* vector_adopt(void* data, size_t elem_size, size_t n_elements,
+                size_t capacity, const allocator_t* allocator);
+
+/*
+ * Function: vector_release
+ * --------------------
+ *  Frees the vector but hands its array to the caller without copying it.
+ *  The array came from the vector's allocator and holds capacity elements.
+ *
+ *  vec: Pointer to the vector.
+ *  n_elements: Output number of elements in use, may be NULL.
+ *
+ *  returns: The array, NULL if the vector never had one.
+ */
+void* vector_release(vector_t* vec, size_t* n_elements);
+
+/*
+ * Function: vector_push
+ * --------------------
+ *  Copies an element to the end of the vector.
+ *
+ *  vec: Pointer to the vector.
+ *  elem: Pointer to the element, elem_size bytes are copied.
+ *
+ *  returns: Nothing.
+ */
+void vector_push(vector_t* vec, const void* elem);
+
+/*
+ * Function: vector_push_slot
+ * --------------------
+ *  Adds an uninitialised element to the end of the vector, for the caller
+ *  to fill in place.
+ *
+ *  vec: Pointer to the vector.
+ *
+ *  returns: Pointer to the new element, valid until the vector changes.
+ */
+void* vector_push_slot(vector_t* vec);
+
+/*
+ * Function: vector_pop
+ * --------------------
+ *  Removes the last element of the vector.
+ *
+ *  vec: Pointer to the vector.
+ *  out: Where to copy the element, may be NULL.
+ *
+ *  returns: True if an element was removed, false if the vector is empty.
+ */
+bool vector_pop(vector_t* vec, void* out);
+
+/*
+ * Function: vector_insert
+ * --------------------
+ *  Copies an element to an index, shifting the elements after it up.
+ *
+ *  vec: Pointer to the vector.
+ *  index: Index to insert at, at most the number of elements.
+ *  elem: Pointer to the element.
+ *
+ *  returns: Nothing.
+ */
+void vector_insert(vector_t* vec, size_t index, const void* elem);
+
+/*
+ * Function: vector_erase
+ * --------------------
+ *  Removes the elements in [index, index + count), shifting the elements
+ *  after them down.
+ *
+ *  vec: Pointer to the vector.
+ *  index: First index to remove.
+ *  count: Number of elements to remove.
+ *
+ *  returns: Nothing.
+ */
+void vector_erase(vector_t* vec, size_t index, size_t count);
+
+/*
+ * Function: vector_set
+ * --------------------
+ *  Copies an element over the one at an index.
+ *
+ *  vec: Pointer to the vector.
+ *  index: Index of the element.
+ *  elem: Pointer to the element.
+ *
+ *  returns: Nothing.
+ */
+void vector_set(vector_t* vec, size_t index, const void* elem);
+
+/*
+ * Function: vector_reserve
+ * --------------------
+ *  Grows the vector to hold at least capacity elements without
+ *  reallocating.
+ *
+ *  vec: Pointer to the vector.
+ *  capacity: Number of elements.
+ *
+ *  returns: Nothing.
+ */
+void vector_reserve(vector_t* vec, size_t capacity);
+
+/*
+ * Function: vector_shrink
+ * --------------------
+ *  Shrinks the vector's array to its number of elements.
+ *
+ *  vec: Pointer to the vector.
+ *
+ *  returns: Nothing.
+ */
+void vector_shrink(vector_t* vec);
+
+/*
+ * Function: vector_clear
+ * --------------------
+ *  Removes every element, keeping the capacity.
+ *
+ *  vec: Pointer to the vector.
+ *
+ *  returns: Nothing.
+ */
+void vector_clear(vector_t* vec);
+
+/*
+ * Function: vector_get
+ * --------------------
+ *  Gets an element in place.
+ *
+ *  vec: Pointer to the vector.
+ *  index: Index of the element.
+ *
+ *  returns: Pointer to the element, valid until the vector changes.
+ */
+DSL_INLINE void* vector_get(vector_t* vec, size_t index) {
+    assert(vec);
+    assert(index < vec->n_elements);
+    return vec->data + index * vec->elem_size;
+}
+
+/*
+ * Function: vector_size
+ * --------------------
+ *  Gets the number of elements.
+ *
+ *  vec: Pointer to the vector.
+ *
+ *  returns: Number of elements.
+ */
+DSL_INLINE size_t vector_size(vector_t* vec) {
+    assert(vec);
+    return vec->n_elements;
+}
+
+/*
+ * Function: vector_is_empty
+ * --------------------
+ *  Checks if the vector is empty.
+ *
+ *  vec: Pointer to the vector.
+ *
+ *  returns: True if vector is empty, false otherwise.
+ */
+DSL_INLINE bool vector_is_empty(vector_t* vec) {
+    assert(vec);
+    return !vec->n_elements;
+}
+
+/*
+ * Function: vector_data
+ * --------------------
+ *  Gets the vector's array.
+ *
+ *  vec: Pointer to the vector.
+ *
+ *  returns: Pointer to the first element, valid until the vector grows.
+ */
+DSL_INLINE void* vector_data(vector_t* vec) {
+    assert(vec);
+    return vec->data;
+}
+
+/*
+ * Function: vector_find
+ * --------------------
+ *  Finds the first element equal to elem, comparing bytes. Elements of 1,
+ *  2, 4 or 8 bytes are compared with SIMD.
+ *
+ *  vec: Pointer to the vector.
+ *  elem: Pointer to the element to find.
+ *
+ *  returns: Index of the element, VECTOR_NPOS if not found.
+ */
+size_t vector_find(vector_t* vec, const void* elem);
+
+/*
+ * Function: vector_count
+ * --------------------
+ *  Counts the elements equal to elem, comparing bytes. Elements of 1, 2, 4
+ *  or 8 bytes are compared with SIMD.
+ *
+ *  vec: Pointer to the vector.
+ *  elem: Pointer to the element to count.
+ *
+ *  returns: Number of equal elements.
+ */
+size_t vector_count(vector_t* vec, const void* elem);
+
+/*
+ * Function: vector_min
+ * --------------------
+ *  Gets the smallest element of a vector of a primitive type, with SIMD.
+ *  The result is unspecified if a float vector holds NaN.
+ *
+ *  vec: Pointer to the vector.
+ *  type: Element type, its size must be elem_size.
+ *  out: Where to copy the smallest element.
+ *
+ *  returns: True if found, false if the vector is empty.
+ */
+bool vector_min(vector_t* vec, vector_type_t type, void* out);
+
+/*
+ * Function: vector_max
+ * --------------------
+ *  Gets the largest element of a vector of a primitive type, with SIMD.
+ *  The result is unspecified if a float vector holds NaN.
+ *
+ *  vec: Pointer to the vector.
+ *  type: Element type, its size must be elem_size.
+ *  out: Where to copy the largest element.
+ *
+ *  returns: True if found, false if the vector is empty.
+ */
+bool vector_max(vector_t* vec, vector_type_t type, void* out);
+
+/*
+ * Function: vector_clean
+ * --------------------
+ *  Frees the vector and its elements.
+ *
+ *  vec: Pointer to the vector.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void vector_clean(vector_t* vec);
+
+/*
+ * Function: vector_memory_usage
+ * --------------------
+ *  Gets the memory vec uses. Elements are stored inline, so unused
+ *  capacity is slack.
+ *
+ *  vec: Pointer to the vector.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t vector_memory_usage(vector_t* vec, memory_usage_t* usage);
+
+/*
+ * Macro: VECTOR_DEFINE
+ * --------------------
+ *  Defines typed wrappers name_create, name_push, name_pop, name_get,
+ *  name_set and name_data over vector_t, copying by assignment rather than
+ *  memcpy.
+ */
+#define VECTOR_DEFINE(name, type) \
+    static inline vector_t* name##_create(void) { \
+        return vector_create(sizeof(type)); \
+    } \
+    static inline void name##_push(vector_t* vec, type elem) { \
+        *(type*)vector_push_slot(vec) = elem; \
+    } \
+    static inline bool name##_pop(vector_t* vec, type* out) { \
+        if (vector_is_empty(vec)) { \
+            return false; \
+        } \
+        *out = ((type*)vec->data)[vec->n_elements - 1]; \
+        return vector_pop(vec, NULL); \
+    } \
+    static inline type name##_get(vector_t* vec, size_t index) { \
+        return *(type*)vector_get(vec, index); \
+    } \
+    static inline void name##_set(vector_t* vec, size_t index, type elem) { \
+        *(type*)vector_get(vec, index) = elem; \
+    } \
+    static inline type* name##_data(vector_t* vec) { \
+        return vector_data(vec); \
+    }
+
+/**** PRIVATE ****/
+/*
+ * Function: _vector_resize
+ * --------------------
+ *  Moves the elements to a new array of capacity elements.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void _vector_resize(vector_t* vec, size_t capacity);
+
+/*
+ * Function: _vector_find_scalar
+ * --------------------
+ *  Finds elem from index start one element at a time.
+ *
+ *  returns: Index of the element, VECTOR_NPOS if not found.
+ */
+size_t _vector_find_scalar(vector_t* vec, const void* elem, size_t start);
+
+/*
+ * Function: _vector_type_size
+ * --------------------
+ *  Gets the size of a primitive element type.
+ *
+ *  returns: Size in bytes.
+ */
+size_t _vector_type_size(vector_type_t type);
+
+#endif
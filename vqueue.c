@@ -0,0 +1,235 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a custom by value queue library. Elements are copied
+         into a contiguous ring buffer, so there is no allocation or pointer
+         chase per element.
+*/
+
+#include "vqueue.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "alloctrack.h"
+
+/**** PUBLIC ****/
+
+/*
+ * Function: vqueue_create
+ * --------------------
+ *  Creates a new by value queue.
+ *
+ *  elem_size: Size of each element.
+ *
+ *  returns: Pointer to the new queue.
+ */
+vqueue_t* vqueue_create(size_t elem_size) {
+    return vqueue_create_with_allocator(elem_size, NULL);
+}
+
+/*
+ * Function: vqueue_create_with_allocator
+ * --------------------
+ *  Creates a new by value queue whose memory comes from an allocator.
+ *
+ *  elem_size: Size of each element.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new queue.
+ */
+vqueue_t* vqueue_create_with_allocator(size_t elem_size,
+                const allocator_t* allocator) {
+    assert(elem_size);
+    allocator_t alloc = allocator_resolve(allocator);
+
+    vqueue_t* queue = allocator_alloc(&alloc, sizeof(vqueue_t));
+    assert(queue);
+
+    queue->elem_size = elem_size;
+    queue->capacity = VQUEUE_INITIAL_CAPACITY;
+    queue->head = 0;
+    queue->n_elements = 0;
+    queue->allocator = alloc;
+    queue->data = allocator_alloc(&alloc, elem_size * queue->capacity);
+    assert(queue->data);
+
+    return queue;
+}
+
+/*
+ * Function: vqueue_enqueue
+ * --------------------
+ *  Copies an element to the back of the queue.
+ *
+ *  queue: Pointer to the queue.
+ *  elem: Pointer to the element, elem_size bytes are copied.
+ *
+ *  returns: Nothing.
+ */
+void vqueue_enqueue(vqueue_t* queue, const void* elem) {
+    assert(elem);
+    memcpy(vqueue_enqueue_slot(queue), elem, queue->elem_size);
+}
+
+/*
+ * Function: vqueue_enqueue_slot
+ * --------------------
+ *  Adds an uninitialised element to the back of the queue, for the caller
+ *  to fill in place.
+ *
+ *  queue: Pointer to the queue.
+ *
+ *  returns: Pointer to the new element, valid until the queue changes.
+ */
+void* vqueue_enqueue_slot(vqueue_t* queue) {
+    assert(queue);
+
+    if (queue->n_elements == queue->capacity) {
+        _vqueue_grow(queue);
+    }
+
+    // Capacity is a power of two, so wrap with a mask
+    size_t tail = (queue->head + queue->n_elements) & (queue->capacity - 1);
+    queue->n_elements++;
+    return queue->data + tail * queue->elem_size;
+}
+
+/*
+ * Function: vqueue_dequeue
+ * --------------------
+ *  Removes the front element of the queue.
+ *
+ *  queue: Pointer to the queue.
+ *  out: Where to copy the element, may be NULL.
+ *
+ *  returns: True if an element was removed, false if the queue is empty.
+ */
+bool vqueue_dequeue(vqueue_t* queue, void* out) {
+    assert(queue);
+
+    if (!queue->n_elements) {
+        return false;
+    }
+
+    if (out) {
+        memcpy(out, queue->data + queue->head * queue->elem_size,
+                    queue->elem_size);
+    }
+    queue->head = (queue->head + 1) & (queue->capacity - 1);
+    queue->n_elements--;
+    return true;
+}
+
+/*
+ * Function: vqueue_peek
+ * --------------------
+ *  Gets the front element of the queue in place.
+ *
+ *  queue: Pointer to the queue.
+ *
+ *  returns: Pointer to the element, NULL if the queue is empty.
+ */
+void* vqueue_peek(vqueue_t* queue) {
+    assert(queue);
+
+    if (!queue->n_elements) {
+        return NULL;
+    }
+    return queue->data + queue->head * queue->elem_size;
+}
+
+/*
+ * Function: vqueue_is_empty
+ * --------------------
+ *  Checks if the queue is empty.
+ *
+ *  queue: Pointer to the queue.
+ *
+ *  returns: True if queue is empty, false otherwise.
+ */
+bool vqueue_is_empty(vqueue_t* queue) {
+    assert(queue);
+    return !queue->n_elements;
+}
+
+/*
+ * Function: vqueue_clean
+ * --------------------
+ *  Frees the queue and its elements.
+ *
+ *  queue: Pointer to the queue.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void vqueue_clean(vqueue_t* queue) {
+    assert(queue);
+    allocator_t allocator = queue->allocator;
+    const void* owner = &queue->allocator;
+
+    allocator_free(&allocator, queue->data,
+                queue->elem_size * queue->capacity);
+    allocator_free(&allocator, queue, sizeof(vqueue_t));
+    if (!allocator_is_bulk(&allocator)) {
+        ALLOCTRACK_CLEANED(owner);
+    }
+}
+
+/*
+ * Function: vqueue_memory_usage
+ * --------------------
+ *  Gets the memory queue uses. Elements are stored inline, so unused
+ *  capacity is slack.
+ *
+ *  queue: Pointer to the queue.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t vqueue_memory_usage(vqueue_t* queue, memory_usage_t* usage) {
+    assert(queue);
+    assert(usage);
+    memset(usage, 0, sizeof(memory_usage_t));
+
+    allocator_account(&queue->allocator, sizeof(vqueue_t), 1, &usage->header,
+                usage);
+    allocator_account(&queue->allocator, queue->elem_size * queue->capacity, 1,
+                &usage->nodes, usage);
+
+    // Only live elements count as nodes
+    size_t unused = queue->elem_size * (queue->capacity - queue->n_elements);
+    usage->nodes -= unused;
+    usage->slack += unused;
+
+    return usage->total;
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _vqueue_grow
+ * --------------------
+ *  Doubles the ring buffer, unwrapping the elements to the front.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void _vqueue_grow(vqueue_t* queue) {
+    size_t new_capacity = queue->capacity * 2;
+    char* data = allocator_alloc(&queue->allocator,
+                queue->elem_size * new_capacity);
+    assert(data);
+
+    // Copy the run from head to the end, then the wrapped run
+    size_t first = queue->capacity - queue->head;
+    if (first > queue->n_elements) {
+        first = queue->n_elements;
+    }
+    memcpy(data, queue->data + queue->head * queue->elem_size,
+                first * queue->elem_size);
+    memcpy(data + first * queue->elem_size, queue->data,
+                (queue->n_elements - first) * queue->elem_size);
+
+    allocator_free(&queue->allocator, queue->data,
+                queue->elem_size * queue->capacity);
+    queue->data = data;
+    queue->capacity = new_capacity;
+    queue->head = 0;
+}
@@ -0,0 +1,165 @@
+#ifndef VQUEUE_H
+#define VQUEUE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include "allocator.h"
+#include "hints.h"
+
+#define VQUEUE_INITIAL_CAPACITY 16
+
+/*
+ * Queue storing elements by value in a growable ring buffer.
+ */
+typedef struct vqueue {
+    size_t elem_size;
+    size_t capacity;
+    size_t head;
+    size_t n_elements;
+    char* data;
+    // Source of the queue and its buffer
+    allocator_t allocator;
+} vqueue_t;
+
+/*
+ * Function: vqueue_create
+ * --------------------
+ *  Creates a new by value queue.
+ *
+ *  elem_size: Size of each element.
+ *
+ *  returns: Pointer to the new queue.
+ */
+vqueue_t* vqueue_create(size_t elem_size);
+
+/*
+ * Function: vqueue_create_with_allocator
+ * --------------------
+ *  Creates a new by value queue whose memory comes from an allocator.
+ *
+ *  elem_size: Size of each element.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new queue.
+ */
+vqueue_t* vqueue_create_with_allocator(size_t elem_size,
+                const allocator_t* allocator);
+
+/*
+ * Function: vqueue_enqueue
+ * --------------------
+ *  Copies an element to the back of the queue.
+ *
+ *  queue: Pointer to the queue.
+ *  elem: Pointer to the element, elem_size bytes are copied.
+ *
+ *  returns: Nothing.
+ */
+void vqueue_enqueue(vqueue_t* queue, const void* elem);
+
+/*
+ * Function: vqueue_enqueue_slot
+ * --------------------
+ *  Adds an uninitialised element to the back of the queue, for the caller
+ *  to fill in place.
+ *
+ *  queue: Pointer to the queue.
+ *
+ *  returns: Pointer to the new element, valid until the queue changes.
+ */
+void* vqueue_enqueue_slot(vqueue_t* queue);
+
+/*
+ * Function: vqueue_dequeue
+ * --------------------
+ *  Removes the front element of the queue.
+ *
+ *  queue: Pointer to the queue.
+ *  out: Where to copy the element, may be NULL.
+ *
+ *  returns: True if an element was removed, false if the queue is empty.
+ */
+bool vqueue_dequeue(vqueue_t* queue, void* out);
+
+/*
+ * Function: vqueue_peek
+ * --------------------
+ *  Gets the front element of the queue in place.
+ *
+ *  queue: Pointer to the queue.
+ *
+ *  returns: Pointer to the element, NULL if the queue is empty.
+ */
+void* vqueue_peek(vqueue_t* queue);
+
+/*
+ * Function: vqueue_is_empty
+ * --------------------
+ *  Checks if the queue is empty.
+ *
+ *  queue: Pointer to the queue.
+ *
+ *  returns: True if queue is empty, false otherwise.
+ */
+bool vqueue_is_empty(vqueue_t* queue);
+
+/*
+ * Function: vqueue_clean
+ * --------------------
+ *  Frees the queue and its elements.
+ *
+ *  queue: Pointer to the queue.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void vqueue_clean(vqueue_t* queue);
+
+/*
+ * Macro: VQUEUE_DEFINE
+ * --------------------
+ *  Defines typed wrappers name_create, name_enqueue, name_dequeue and
+ *  name_peek over vqueue_t, copying by assignment rather than memcpy.
+ */
+#define VQUEUE_DEFINE(name, type) \
+    static inline vqueue_t* name##_create(void) { \
+        return vqueue_create(sizeof(type)); \
+    } \
+    static inline void name##_enqueue(vqueue_t* queue, type elem) { \
+        *(type*)vqueue_enqueue_slot(queue) = elem; \
+    } \
+    static inline bool name##_dequeue(vqueue_t* queue, type* out) { \
+        type* front = vqueue_peek(queue); \
+        if (!front) { \
+            return false; \
+        } \
+        *out = *front; \
+        return vqueue_dequeue(queue, NULL); \
+    } \
+    static inline type* name##_peek(vqueue_t* queue) { \
+        return vqueue_peek(queue); \
+    }
+
+/*
+ * Function: vqueue_memory_usage
+ * --------------------
+ *  Gets the memory queue uses. Elements are stored inline, so unused
+ *  capacity is slack.
+ *
+ *  queue: Pointer to the queue.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t vqueue_memory_usage(vqueue_t* queue, memory_usage_t* usage);
+
+/**** PRIVATE ****/
+/*
+ * Function: _vqueue_grow
+ * --------------------
+ *  Doubles the ring buffer, unwrapping the elements to the front.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void _vqueue_grow(vqueue_t* queue);
+
+#endif
@@ -0,0 +1,220 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a custom by value stack library. Elements are copied
+         into a contiguous array, so there is no allocation or pointer chase
+         per element.
+*/
+
+#include "vstack.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "alloctrack.h"
+
+/**** PUBLIC ****/
+
+/*
+ * Function: vstack_create
+ * --------------------
+ *  Creates a new by value stack.
+ *
+ *  elem_size: Size of each element.
+ *
+ *  returns: Pointer to the new stack.
+ */
+vstack_t* vstack_create(size_t elem_size) {
+    return vstack_create_with_allocator(elem_size, NULL);
+}
+
+/*
+ * Function: vstack_create_with_allocator
+ * --------------------
+ *  Creates a new by value stack whose memory comes from an allocator.
+ *
+ *  elem_size: Size of each element.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new stack.
+ */
+vstack_t* vstack_create_with_allocator(size_t elem_size,
+                const allocator_t* allocator) {
+    assert(elem_size);
+    allocator_t alloc = allocator_resolve(allocator);
+
+    vstack_t* stack = allocator_alloc(&alloc, sizeof(vstack_t));
+    assert(stack);
+
+    stack->elem_size = elem_size;
+    stack->capacity = VSTACK_INITIAL_CAPACITY;
+    stack->n_elements = 0;
+    stack->allocator = alloc;
+    stack->data = allocator_alloc(&alloc, elem_size * stack->capacity);
+    assert(stack->data);
+
+    return stack;
+}
+
+/*
+ * Function: vstack_push
+ * --------------------
+ *  Copies an element onto the stack.
+ *
+ *  stack: Pointer to the stack.
+ *  elem: Pointer to the element, elem_size bytes are copied.
+ *
+ *  returns: Nothing.
+ */
+void vstack_push(vstack_t* stack, const void* elem) {
+    assert(elem);
+    memcpy(vstack_push_slot(stack), elem, stack->elem_size);
+}
+
+/*
+ * Function: vstack_push_slot
+ * --------------------
+ *  Pushes an uninitialised element, for the caller to fill in place.
+ *
+ *  stack: Pointer to the stack.
+ *
+ *  returns: Pointer to the new element, valid until the stack changes.
+ */
+void* vstack_push_slot(vstack_t* stack) {
+    assert(stack);
+
+    if (stack->n_elements == stack->capacity) {
+        _vstack_grow(stack);
+    }
+
+    return stack->data + stack->n_elements++ * stack->elem_size;
+}
+
+/*
+ * Function: vstack_pop
+ * --------------------
+ *  Removes the top element of the stack.
+ *
+ *  stack: Pointer to the stack.
+ *  out: Where to copy the element, may be NULL.
+ *
+ *  returns: True if an element was removed, false if the stack is empty.
+ */
+bool vstack_pop(vstack_t* stack, void* out) {
+    assert(stack);
+
+    if (!stack->n_elements) {
+        return false;
+    }
+
+    stack->n_elements--;
+    if (out) {
+        memcpy(out, stack->data + stack->n_elements * stack->elem_size,
+                    stack->elem_size);
+    }
+    return true;
+}
+
+/*
+ * Function: vstack_peek
+ * --------------------
+ *  Gets the top element of the stack in place.
+ *
+ *  stack: Pointer to the stack.
+ *
+ *  returns: Pointer to the element, NULL if the stack is empty.
+ */
+void* vstack_peek(vstack_t* stack) {
+    assert(stack);
+
+    if (!stack->n_elements) {
+        return NULL;
+    }
+    return stack->data + (stack->n_elements - 1) * stack->elem_size;
+}
+
+/*
+ * Function: vstack_is_empty
+ * --------------------
+ *  Checks if the stack is empty.
+ *
+ *  stack: Pointer to the stack.
+ *
+ *  returns: True if stack is empty, false otherwise.
+ */
+bool vstack_is_empty(vstack_t* stack) {
+    assert(stack);
+    return !stack->n_elements;
+}
+
+/*
+ * Function: vstack_clean
+ * --------------------
+ *  Frees the stack and its elements.
+ *
+ *  stack: Pointer to the stack.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void vstack_clean(vstack_t* stack) {
+    assert(stack);
+    allocator_t allocator = stack->allocator;
+    const void* owner = &stack->allocator;
+
+    allocator_free(&allocator, stack->data,
+                stack->elem_size * stack->capacity);
+    allocator_free(&allocator, stack, sizeof(vstack_t));
+    if (!allocator_is_bulk(&allocator)) {
+        ALLOCTRACK_CLEANED(owner);
+    }
+}
+
+/*
+ * Function: vstack_memory_usage
+ * --------------------
+ *  Gets the memory stack uses. Elements are stored inline, so unused
+ *  capacity is slack.
+ *
+ *  stack: Pointer to the stack.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t vstack_memory_usage(vstack_t* stack, memory_usage_t* usage) {
+    assert(stack);
+    assert(usage);
+    memset(usage, 0, sizeof(memory_usage_t));
+
+    allocator_account(&stack->allocator, sizeof(vstack_t), 1, &usage->header,
+                usage);
+    allocator_account(&stack->allocator, stack->elem_size * stack->capacity, 1,
+                &usage->nodes, usage);
+
+    // Only live elements count as nodes
+    size_t unused = stack->elem_size * (stack->capacity - stack->n_elements);
+    usage->nodes -= unused;
+    usage->slack += unused;
+
+    return usage->total;
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _vstack_grow
+ * --------------------
+ *  Doubles the array.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void _vstack_grow(vstack_t* stack) {
+    size_t new_capacity = stack->capacity * 2;
+    char* data = allocator_alloc(&stack->allocator,
+                stack->elem_size * new_capacity);
+    assert(data);
+
+    memcpy(data, stack->data, stack->n_elements * stack->elem_size);
+    allocator_free(&stack->allocator, stack->data,
+                stack->elem_size * stack->capacity);
+
+    stack->data = data;
+    stack->capacity = new_capacity;
+}
@@ -0,0 +1,162 @@
+#ifndef VSTACK_H
+#define VSTACK_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include "allocator.h"
+#include "hints.h"
+
+#define VSTACK_INITIAL_CAPACITY 16
+
+/*
+ * Stack storing elements by value in a growable array.
+ */
+typedef struct vstack {
+    size_t elem_size;
+    size_t capacity;
+    size_t n_elements;
+    char* data;
+    // Source of the stack and its array
+    allocator_t allocator;
+} vstack_t;
+
+/*
+ * Function: vstack_create
+ * --------------------
+ *  Creates a new by value stack.
+ *
+ *  elem_size: Size of each element.
+ *
+ *  returns: Pointer to the new stack.
+ */
+vstack_t* vstack_create(size_t elem_size);
+
+/*
+ * Function: vstack_create_with_allocator
+ * --------------------
+ *  Creates a new by value stack whose memory comes from an allocator.
+ *
+ *  elem_size: Size of each element.
+ *  allocator: Allocator to use, copied, NULL for the thread's allocator.
+ *
+ *  returns: Pointer to the new stack.
+ */
+vstack_t* vstack_create_with_allocator(size_t elem_size,
+                const allocator_t* allocator);
+
+/*
+ * Function: vstack_push
+ * --------------------
+ *  Copies an element onto the stack.
+ *
+ *  stack: Pointer to the stack.
+ *  elem: Pointer to the element, elem_size bytes are copied.
+ *
+ *  returns: Nothing.
+ */
+void vstack_push(vstack_t* stack, const void* elem);
+
+/*
+ * Function: vstack_push_slot
+ * --------------------
+ *  Pushes an uninitialised element, for the caller to fill in place.
+ *
+ *  stack: Pointer to the stack.
+ *
+ *  returns: Pointer to the new element, valid until the stack changes.
+ */
+void* vstack_push_slot(vstack_t* stack);
+
+/*
+ * Function: vstack_pop
+ * --------------------
+ *  Removes the top element of the stack.
+ *
+ *  stack: Pointer to the stack.
+ *  out: Where to copy the element, may be NULL.
+ *
+ *  returns: True if an element was removed, false if the stack is empty.
+ */
+bool vstack_pop(vstack_t* stack, void* out);
+
+/*
+ * Function: vstack_peek
+ * --------------------
+ *  Gets the top element of the stack in place.
+ *
+ *  stack: Pointer to the stack.
+ *
+ *  returns: Pointer to the element, NULL if the stack is empty.
+ */
+void* vstack_peek(vstack_t* stack);
+
+/*
+ * Function: vstack_is_empty
+ * --------------------
+ *  Checks if the stack is empty.
+ *
+ *  stack: Pointer to the stack.
+ *
+ *  returns: True if stack is empty, false otherwise.
+ */
+bool vstack_is_empty(vstack_t* stack);
+
+/*
+ * Function: vstack_clean
+ * --------------------
+ *  Frees the stack and its elements.
+ *
+ *  stack: Pointer to the stack.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void vstack_clean(vstack_t* stack);
+
+/*
+ * Macro: VSTACK_DEFINE
+ * --------------------
+ *  Defines typed wrappers name_create, name_push, name_pop and name_peek
+ *  over vstack_t, copying by assignment rather than memcpy.
+ */
+#define VSTACK_DEFINE(name, type) \
+    static inline vstack_t* name##_create(void) { \
+        return vstack_create(sizeof(type)); \
+    } \
+    static inline void name##_push(vstack_t* stack, type elem) { \
+        *(type*)vstack_push_slot(stack) = elem; \
+    } \
+    static inline bool name##_pop(vstack_t* stack, type* out) { \
+        if (!stack->n_elements) { \
+            return false; \
+        } \
+        *out = ((type*)stack->data)[--stack->n_elements]; \
+        return true; \
+    } \
+    static inline type* name##_peek(vstack_t* stack) { \
+        return vstack_peek(stack); \
+    }
+
+/*
+ * Function: vstack_memory_usage
+ * --------------------
+ *  Gets the memory stack uses. Elements are stored inline, so unused
+ *  capacity is slack.
+ *
+ *  stack: Pointer to the stack.
+ *  usage: Output breakdown.
+ *
+ *  returns: Total bytes.
+ */
+size_t vstack_memory_usage(vstack_t* stack, memory_usage_t* usage);
+
+/**** PRIVATE ****/
+/*
+ * Function: _vstack_grow
+ * --------------------
+ *  Doubles the array.
+ *
+ *  returns: Nothing.
+ */
+DSL_COLD void _vstack_grow(vstack_t* stack);
+
+#endif
@@ -0,0 +1,518 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a custom wait chain analytics library for RAGs. It
+         keeps, for every node, the depth of its wait chain and the root
+         blocker at the end of it. Results are memoized and invalidated along
+         reverse edges as the RAG changes, so repeated queries only redo work
+         for chains that actually changed.
+*/
+
+#include "waitchain.h"
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include "RAG.h"
+
+/**** PUBLIC ****/
+
+/*
+ * Function: wait_chain_create
+ * --------------------
+ *  Creates wait chain analytics for a RAG. Depth and root blocker of each
+ *  node are memoized and invalidated along reverse edges as the RAG
+ *  changes.
+ *
+ *  rag: Pointer to the RAG, must have a free observer slot.
+ *
+ *  returns: Pointer to the new wait chain analytics.
+ */
+wait_chain_t* wait_chain_create(RAG_t* rag) {
+    assert(rag);
+    hashtable_t* ht = rag->ht;
+    RAG_node_t* node = NULL;
+
+    wait_chain_t* wc = malloc(sizeof(wait_chain_t));
+    assert(wc);
+    memset(wc, 0, sizeof(wait_chain_t));
+    wc->rag = rag;
+
+    _wait_chain_reserve(wc, rag->n_nodes);
+
+    // Register existing nodes, then their reverse edges
+    for (size_t i = 0; i < ht->size; i++) {
+        for (ht_node_t* ht_node = ht->table[i]; ht_node;
+                    ht_node = ht_node->next) {
+            node = ht_node->value;
+            wc->nodes[node->id] = node;
+        }
+    }
+    for (size_t i = 0; i < ht->size; i++) {
+        for (ht_node_t* ht_node = ht->table[i]; ht_node;
+                    ht_node = ht_node->next) {
+            node = ht_node->value;
+            if (node->next) {
+                _wait_chain_link(wc, node->id, node->next->id);
+            }
+        }
+    }
+
+    bool registered = RAG_add_observer(rag, _wait_chain_observer, wc);
+    assert(registered);
+    (void)registered;
+
+    return wc;
+}
+
+/*
+ * Function: wait_chain_depth
+ * --------------------
+ *  Gets the number of next edges from a node to the end of its wait chain.
+ *  For chains running into a cycle, the cycle is counted once.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  node: Node of the RAG.
+ *
+ *  returns: Depth of the wait chain.
+ */
+size_t wait_chain_depth(wait_chain_t* wc, RAG_node_t* node) {
+    assert(wc);
+    assert(node && node->id < wc->n_nodes);
+
+    if (wc->state[node->id] == WAIT_CHAIN_INVALID) {
+        _wait_chain_compute(wc, node->id);
+    }
+    return wc->depth[node->id];
+}
+
+/*
+ * Function: wait_chain_root
+ * --------------------
+ *  Gets the root blocker of a node, the node at the end of its wait chain.
+ *  For chains running into a cycle, the cycle node with the lowest id.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  node: Node of the RAG.
+ *
+ *  returns: Root blocker node.
+ */
+RAG_node_t* wait_chain_root(wait_chain_t* wc, RAG_node_t* node) {
+    assert(wc);
+    assert(node && node->id < wc->n_nodes);
+
+    if (wc->state[node->id] == WAIT_CHAIN_INVALID) {
+        _wait_chain_compute(wc, node->id);
+    }
+    return wc->nodes[wc->root[node->id]];
+}
+
+/*
+ * Function: wait_chain_deadlocked
+ * --------------------
+ *  Checks if the wait chain of a node runs into a cycle.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  node: Node of the RAG.
+ *
+ *  returns: True if the node is deadlocked, false otherwise.
+ */
+bool wait_chain_deadlocked(wait_chain_t* wc, RAG_node_t* node) {
+    assert(wc);
+    assert(node && node->id < wc->n_nodes);
+
+    if (wc->state[node->id] == WAIT_CHAIN_INVALID) {
+        _wait_chain_compute(wc, node->id);
+    }
+    return wc->state[node->id] == WAIT_CHAIN_DEADLOCK;
+}
+
+/*
+ * Function: wait_chain_top_k
+ * --------------------
+ *  Finds the processes with the longest wait chains.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  k: Maximum number of chains to return.
+ *  entries: Output array of at least k entries, sorted longest first.
+ *
+ *  returns: Number of entries written.
+ */
+size_t wait_chain_top_k(wait_chain_t* wc, size_t k,
+                wait_chain_entry_t* entries) {
+    assert(wc);
+    assert(k == 0 || entries);
+    size_t n_entries = 0;
+
+    if (k == 0) {
+        return 0;
+    }
+
+    // Keep the k longest in a min-heap on depth
+    for (size_t id = 0; id < wc->n_nodes; id++) {
+        RAG_node_t* node = wc->nodes[id];
+        if (!node || node->key->type != PROCESS_T) {
+            continue;
+        }
+        if (wc->state[id] == WAIT_CHAIN_INVALID) {
+            _wait_chain_compute(wc, id);
+        }
+
+        size_t depth = wc->depth[id];
+        if (n_entries == k && depth <= entries[0].depth) {
+            continue;
+        }
+
+        wait_chain_entry_t entry;
+        entry.node = node;
+        entry.root = wc->nodes[wc->root[id]];
+        entry.depth = depth;
+        entry.deadlocked = wc->state[id] == WAIT_CHAIN_DEADLOCK;
+
+        if (n_entries < k) {
+            // Sift up
+            size_t i = n_entries++;
+            while (i > 0 && entries[(i - 1) / 2].depth > depth) {
+                entries[i] = entries[(i - 1) / 2];
+                i = (i - 1) / 2;
+            }
+            entries[i] = entry;
+        } else {
+            entries[0] = entry;
+            _wait_chain_sift_down(entries, n_entries, 0);
+        }
+    }
+
+    qsort(entries, n_entries, sizeof(wait_chain_entry_t),
+                _wait_chain_entry_compare);
+
+    return n_entries;
+}
+
+/*
+ * Function: wait_chain_clean
+ * --------------------
+ *  Stops observing the RAG and frees the wait chain analytics.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *
+ *  returns: Nothing.
+ */
+void wait_chain_clean(wait_chain_t* wc) {
+    assert(wc);
+
+    RAG_remove_observer(wc->rag, _wait_chain_observer, wc);
+
+    free(wc->nodes);
+    free(wc->depth);
+    free(wc->root);
+    free(wc->state);
+    free(wc->pred_head);
+    free(wc->pred_next);
+    free(wc->pred_prev);
+    free(wc->stack);
+    free(wc);
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _wait_chain_reserve
+ * --------------------
+ *  Grows the arrays to hold at least n_nodes ids.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  n_nodes: Minimum number of ids.
+ *
+ *  returns: Nothing.
+ */
+void _wait_chain_reserve(wait_chain_t* wc, size_t n_nodes) {
+    if (n_nodes <= wc->n_nodes) {
+        return;
+    }
+
+    if (n_nodes > wc->capacity) {
+        size_t capacity = wc->capacity ?
+                    wc->capacity : WAIT_CHAIN_INITIAL_CAPACITY;
+        while (capacity < n_nodes) {
+            capacity *= 2;
+        }
+
+        wc->nodes = realloc(wc->nodes, sizeof(RAG_node_t*) * capacity);
+        wc->depth = realloc(wc->depth, sizeof(size_t) * capacity);
+        wc->root = realloc(wc->root, sizeof(size_t) * capacity);
+        wc->state = realloc(wc->state, sizeof(uint8_t) * capacity);
+        wc->pred_head = realloc(wc->pred_head, sizeof(size_t) * capacity);
+        wc->pred_next = realloc(wc->pred_next, sizeof(size_t) * capacity);
+        wc->pred_prev = realloc(wc->pred_prev, sizeof(size_t) * capacity);
+        assert(wc->nodes && wc->depth && wc->root && wc->state);
+        assert(wc->pred_head && wc->pred_next && wc->pred_prev);
+        wc->capacity = capacity;
+    }
+
+    for (size_t id = wc->n_nodes; id < n_nodes; id++) {
+        wc->nodes[id] = NULL;
+        wc->depth[id] = 0;
+        wc->root[id] = id;
+        wc->state[id] = WAIT_CHAIN_INVALID;
+        wc->pred_head[id] = WAIT_CHAIN_NO_NODE;
+        wc->pred_next[id] = WAIT_CHAIN_NO_NODE;
+        wc->pred_prev[id] = WAIT_CHAIN_NO_NODE;
+    }
+    wc->n_nodes = n_nodes;
+}
+
+/*
+ * Function: _wait_chain_link
+ * --------------------
+ *  Adds id to the predecessor list of next.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  id: Node id.
+ *  next: Id of the next node.
+ *
+ *  returns: Nothing.
+ */
+void _wait_chain_link(wait_chain_t* wc, size_t id, size_t next) {
+    wc->pred_prev[id] = WAIT_CHAIN_NO_NODE;
+    wc->pred_next[id] = wc->pred_head[next];
+    if (wc->pred_head[next] != WAIT_CHAIN_NO_NODE) {
+        wc->pred_prev[wc->pred_head[next]] = id;
+    }
+    wc->pred_head[next] = id;
+}
+
+/*
+ * Function: _wait_chain_unlink
+ * --------------------
+ *  Removes id from the predecessor list of next.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  id: Node id.
+ *  next: Id of the old next node.
+ *
+ *  returns: Nothing.
+ */
+void _wait_chain_unlink(wait_chain_t* wc, size_t id, size_t next) {
+    if (wc->pred_prev[id] != WAIT_CHAIN_NO_NODE) {
+        wc->pred_next[wc->pred_prev[id]] = wc->pred_next[id];
+    } else {
+        wc->pred_head[next] = wc->pred_next[id];
+    }
+
+    if (wc->pred_next[id] != WAIT_CHAIN_NO_NODE) {
+        wc->pred_prev[wc->pred_next[id]] = wc->pred_prev[id];
+    }
+
+    wc->pred_next[id] = WAIT_CHAIN_NO_NODE;
+    wc->pred_prev[id] = WAIT_CHAIN_NO_NODE;
+}
+
+/*
+ * Function: _wait_chain_invalidate
+ * --------------------
+ *  Invalidates a node and everything waiting on it. Stops at nodes that are
+ *  already invalid, as everything behind them is invalid too.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  id: Node id.
+ *
+ *  returns: Nothing.
+ */
+void _wait_chain_invalidate(wait_chain_t* wc, size_t id) {
+    size_t top = 0;
+
+    if (wc->state[id] == WAIT_CHAIN_INVALID) {
+        return;
+    }
+
+    wc->state[id] = WAIT_CHAIN_INVALID;
+    top = _wait_chain_push(wc, top, id);
+
+    while (top > 0) {
+        size_t current = wc->stack[--top];
+        for (size_t pred = wc->pred_head[current]; pred != WAIT_CHAIN_NO_NODE;
+                    pred = wc->pred_next[pred]) {
+            if (wc->state[pred] != WAIT_CHAIN_INVALID) {
+                wc->state[pred] = WAIT_CHAIN_INVALID;
+                top = _wait_chain_push(wc, top, pred);
+            }
+        }
+    }
+}
+
+/*
+ * Function: _wait_chain_compute
+ * --------------------
+ *  Computes depth and root of a node by walking forward to the first valid
+ *  node, chain end or cycle, then filling in the walk in reverse.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  id: Node id.
+ *
+ *  returns: Nothing.
+ */
+void _wait_chain_compute(wait_chain_t* wc, size_t id) {
+    size_t top = 0, current = id;
+
+    // Walk forward, depth holds the stack position of nodes on the stack
+    while (true) {
+        uint8_t state = wc->state[current];
+
+        // Reached a memoized chain
+        if (state == WAIT_CHAIN_VALID || state == WAIT_CHAIN_DEADLOCK) {
+            break;
+        }
+
+        // Reached a cycle, every node on it shares depth and root
+        if (state == WAIT_CHAIN_ON_STACK) {
+            size_t position = wc->depth[current];
+            size_t root = current;
+
+            for (size_t i = position; i < top; i++) {
+                if (wc->stack[i] < root) {
+                    root = wc->stack[i];
+                }
+            }
+            for (size_t i = position; i < top; i++) {
+                wc->depth[wc->stack[i]] = top - position;
+                wc->root[wc->stack[i]] = root;
+                wc->state[wc->stack[i]] = WAIT_CHAIN_DEADLOCK;
+            }
+            top = position;
+            break;
+        }
+
+        wc->state[current] = WAIT_CHAIN_ON_STACK;
+        wc->depth[current] = top;
+        top = _wait_chain_push(wc, top, current);
+
+        // Reached the end of the chain, this is the root blocker
+        RAG_node_t* next = wc->nodes[current]->next;
+        if (!next) {
+            top--;
+            wc->depth[current] = 0;
+            wc->root[current] = current;
+            wc->state[current] = WAIT_CHAIN_VALID;
+            break;
+        }
+        current = next->id;
+    }
+
+    // Fill in the walk from the end, every next is now valid
+    while (top > 0) {
+        size_t node = wc->stack[--top];
+        size_t next = wc->nodes[node]->next->id;
+
+        wc->depth[node] = wc->depth[next] + 1;
+        wc->root[node] = wc->root[next];
+        wc->state[node] = wc->state[next] == WAIT_CHAIN_DEADLOCK ?
+                    WAIT_CHAIN_DEADLOCK : WAIT_CHAIN_VALID;
+    }
+}
+
+/*
+ * Function: _wait_chain_push
+ * --------------------
+ *  Pushes an id onto the scratch stack.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  top: Current stack size.
+ *  id: Id to push.
+ *
+ *  returns: New stack size.
+ */
+size_t _wait_chain_push(wait_chain_t* wc, size_t top, size_t id) {
+    if (top == wc->stack_capacity) {
+        wc->stack_capacity = wc->stack_capacity ?
+                    wc->stack_capacity * 2 : WAIT_CHAIN_INITIAL_CAPACITY;
+        wc->stack = realloc(wc->stack, sizeof(size_t) * wc->stack_capacity);
+        assert(wc->stack);
+    }
+
+    wc->stack[top] = id;
+    return top + 1;
+}
+
+/*
+ * Function: _wait_chain_sift_down
+ * --------------------
+ *  Restores the min-heap order on depth of a top-k heap from index i.
+ *
+ *  entries: Heap of entries.
+ *  n_entries: Number of entries in the heap.
+ *  i: Index to sift down from.
+ *
+ *  returns: Nothing.
+ */
+void _wait_chain_sift_down(wait_chain_entry_t* entries, size_t n_entries,
+                size_t i) {
+    wait_chain_entry_t entry = entries[i];
+
+    while (2 * i + 1 < n_entries) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < n_entries &&
+                    entries[child + 1].depth < entries[child].depth) {
+            child++;
+        }
+        if (entries[child].depth >= entry.depth) {
+            break;
+        }
+        entries[i] = entries[child];
+        i = child;
+    }
+
+    entries[i] = entry;
+}
+
+/*
+ * Function: _wait_chain_entry_compare
+ * --------------------
+ *  qsort comparator ordering entries longest chain first.
+ *
+ *  returns: Negative, zero or positive as for qsort.
+ */
+int _wait_chain_entry_compare(const void* a, const void* b) {
+    const wait_chain_entry_t* entry_a = a;
+    const wait_chain_entry_t* entry_b = b;
+
+    if (entry_a->depth > entry_b->depth) {
+        return -1;
+    } else if (entry_a->depth < entry_b->depth) {
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Function: _wait_chain_observer
+ * --------------------
+ *  RAG observer that keeps reverse edges and memoized chains up to date.
+ *
+ *  returns: Nothing.
+ */
+void _wait_chain_observer(void* ctx, RAG_node_t* node, RAG_node_t* old_next,
+                status_t status) {
+    wait_chain_t* wc = ctx;
+
+    if (status == ADDED_NODE) {
+        _wait_chain_reserve(wc, node->id + 1);
+        wc->nodes[node->id] = node;
+        if (node->next) {
+            _wait_chain_reserve(wc, node->next->id + 1);
+            _wait_chain_link(wc, node->id, node->next->id);
+        }
+        return;
+    }
+
+    // Only changes of next affect chains
+    if (status == UPDATED_DATA || old_next == node->next) {
+        return;
+    }
+
+    if (old_next) {
+        _wait_chain_unlink(wc, node->id, old_next->id);
+    }
+    _wait_chain_reserve(wc, node->next->id + 1);
+    _wait_chain_link(wc, node->id, node->next->id);
+    _wait_chain_invalidate(wc, node->id);
+}
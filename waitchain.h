@@ -0,0 +1,233 @@
+#ifndef WAITCHAIN_H
+#define WAITCHAIN_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "RAG.h"
+
+#define WAIT_CHAIN_NO_NODE SIZE_MAX
+#define WAIT_CHAIN_INITIAL_CAPACITY 64
+
+typedef enum wait_chain_state {
+    WAIT_CHAIN_INVALID,
+    WAIT_CHAIN_ON_STACK,
+    WAIT_CHAIN_VALID,
+    // Valid, but the chain runs into a cycle
+    WAIT_CHAIN_DEADLOCK
+} wait_chain_state_t;
+
+typedef struct wait_chain_entry {
+    RAG_node_t* node;
+    RAG_node_t* root;
+    size_t depth;
+    bool deadlocked;
+} wait_chain_entry_t;
+
+typedef struct wait_chain {
+    RAG_t* rag;
+    size_t n_nodes;
+    size_t capacity;
+    // All arrays are indexed by RAG node id
+    RAG_node_t** nodes;
+    size_t* depth;
+    size_t* root;
+    uint8_t* state;
+    // Reverse edges as intrusive lists, each node has at most one next so
+    // it is on at most one predecessor list
+    size_t* pred_head;
+    size_t* pred_next;
+    size_t* pred_prev;
+    // Scratch stack for chain walks and invalidation
+    size_t* stack;
+    size_t stack_capacity;
+} wait_chain_t;
+
+/*
+ * Function: wait_chain_create
+ * --------------------
+ *  Creates wait chain analytics for a RAG. Depth and root blocker of each
+ *  node are memoized and invalidated along reverse edges as the RAG
+ *  changes.
+ *
+ *  rag: Pointer to the RAG, must have a free observer slot.
+ *
+ *  returns: Pointer to the new wait chain analytics.
+ */
+wait_chain_t* wait_chain_create(RAG_t* rag);
+
+/*
+ * Function: wait_chain_depth
+ * --------------------
+ *  Gets the number of next edges from a node to the end of its wait chain.
+ *  For chains running into a cycle, the cycle is counted once.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  node: Node of the RAG.
+ *
+ *  returns: Depth of the wait chain.
+ */
+size_t wait_chain_depth(wait_chain_t* wc, RAG_node_t* node);
+
+/*
+ * Function: wait_chain_root
+ * --------------------
+ *  Gets the root blocker of a node, the node at the end of its wait chain.
+ *  For chains running into a cycle, the cycle node with the lowest id.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  node: Node of the RAG.
+ *
+ *  returns: Root blocker node.
+ */
+RAG_node_t* wait_chain_root(wait_chain_t* wc, RAG_node_t* node);
+
+/*
+ * Function: wait_chain_deadlocked
+ * --------------------
+ *  Checks if the wait chain of a node runs into a cycle.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  node: Node of the RAG.
+ *
+ *  returns: True if the node is deadlocked, false otherwise.
+ */
+bool wait_chain_deadlocked(wait_chain_t* wc, RAG_node_t* node);
+
+/*
+ * Function: wait_chain_top_k
+ * --------------------
+ *  Finds the processes with the longest wait chains.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  k: Maximum number of chains to return.
+ *  entries: Output array of at least k entries, sorted longest first.
+ *
+ *  returns: Number of entries written.
+ */
+size_t wait_chain_top_k(wait_chain_t* wc, size_t k,
+                wait_chain_entry_t* entries);
+
+/*
+ * Function: wait_chain_clean
+ * --------------------
+ *  Stops observing the RAG and frees the wait chain analytics.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *
+ *  returns: Nothing.
+ */
+void wait_chain_clean(wait_chain_t* wc);
+
+/**** PRIVATE ****/
+/*
+ * Function: _wait_chain_reserve
+ * --------------------
+ *  Grows the arrays to hold at least n_nodes ids.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  n_nodes: Minimum number of ids.
+ *
+ *  returns: Nothing.
+ */
+void _wait_chain_reserve(wait_chain_t* wc, size_t n_nodes);
+
+/*
+ * Function: _wait_chain_link
+ * --------------------
+ *  Adds id to the predecessor list of next.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  id: Node id.
+ *  next: Id of the next node.
+ *
+ *  returns: Nothing.
+ */
+void _wait_chain_link(wait_chain_t* wc, size_t id, size_t next);
+
+/*
+ * Function: _wait_chain_unlink
+ * --------------------
+ *  Removes id from the predecessor list of next.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  id: Node id.
+ *  next: Id of the old next node.
+ *
+ *  returns: Nothing.
+ */
+void _wait_chain_unlink(wait_chain_t* wc, size_t id, size_t next);
+
+/*
+ * Function: _wait_chain_invalidate
+ * --------------------
+ *  Invalidates a node and everything waiting on it. Stops at nodes that are
+ *  already invalid, as everything behind them is invalid too.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  id: Node id.
+ *
+ *  returns: Nothing.
+ */
+void _wait_chain_invalidate(wait_chain_t* wc, size_t id);
+
+/*
+ * Function: _wait_chain_compute
+ * --------------------
+ *  Computes depth and root of a node by walking forward to the first valid
+ *  node, chain end or cycle, then filling in the walk in reverse.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  id: Node id.
+ *
+ *  returns: Nothing.
+ */
+void _wait_chain_compute(wait_chain_t* wc, size_t id);
+
+/*
+ * Function: _wait_chain_push
+ * --------------------
+ *  Pushes an id onto the scratch stack.
+ *
+ *  wc: Pointer to the wait chain analytics.
+ *  top: Current stack size.
+ *  id: Id to push.
+ *
+ *  returns: New stack size.
+ */
+size_t _wait_chain_push(wait_chain_t* wc, size_t top, size_t id);
+
+/*
+ * Function: _wait_chain_sift_down
+ * --------------------
+ *  Restores the min-heap order on depth of a top-k heap from index i.
+ *
+ *  entries: Heap of entries.
+ *  n_entries: Number of entries in the heap.
+ *  i: Index to sift down from.
+ *
+ *  returns: Nothing.
+ */
+void _wait_chain_sift_down(wait_chain_entry_t* entries, size_t n_entries,
+                size_t i);
+
+/*
+ * Function: _wait_chain_entry_compare
+ * --------------------
+ *  qsort comparator ordering entries longest chain first.
+ *
+ *  returns: Negative, zero or positive as for qsort.
+ */
+int _wait_chain_entry_compare(const void* a, const void* b);
+
+/*
+ * Function: _wait_chain_observer
+ * --------------------
+ *  RAG observer that keeps reverse edges and memoized chains up to date.
+ *
+ *  returns: Nothing.
+ */
+void _wait_chain_observer(void* ctx, RAG_node_t* node, RAG_node_t* old_next,
+                status_t status);
+
+#endif
@@ -0,0 +1,535 @@
+/*
+Author : Surya Venkatesh
+Purpose: This file is a synthetic lock workload generator, used to benchmark
+         the RAG and its analytics. Processes acquire resources picked with
+         Zipfian popularity, as readers or writers, hold them for random
+         times and queue up behind current holders. Cycles that never
+         resolve can be injected at a fixed interval.
+*/
+
+#include "workload.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "queue.h"
+
+// Attempts at finding a process that is not blocked before fast forwarding
+#define WORKLOAD_PICK_TRIES 8
+
+/**** PUBLIC ****/
+
+/*
+ * Function: workload_default_config
+ * --------------------
+ *  Fills a config with a moderately skewed, mostly exclusive workload.
+ *
+ *  config: Pointer to the config.
+ *  n_processes: Number of processes.
+ *  n_resources: Number of resources.
+ *
+ *  returns: Nothing.
+ */
+void workload_default_config(workload_config_t* config, size_t n_processes,
+                size_t n_resources) {
+    assert(config);
+
+    config->n_processes = n_processes;
+    config->n_resources = n_resources;
+    config->zipf_theta = 0.99;
+    config->read_ratio = 0.2;
+    config->mean_hold = 8.0;
+    config->n_cycles = 0;
+    config->cycle_length = 4;
+    config->cycle_interval = 1000;
+    config->seed = 42;
+}
+
+/*
+ * Function: workload_create
+ * --------------------
+ *  Creates a synthetic lock workload. Injected cycles use process and
+ *  resource ids after n_processes and n_resources and never resolve.
+ *
+ *  config: Pointer to the config, copied.
+ *
+ *  returns: Pointer to the new workload.
+ */
+workload_t* workload_create(const workload_config_t* config) {
+    assert(config);
+    assert(config->n_processes > 0 && config->n_resources > 0);
+    assert(config->n_cycles == 0 || config->cycle_length > 0);
+    assert(config->n_cycles == 0 || config->cycle_interval > 0);
+
+    workload_t* wl = malloc(sizeof(workload_t));
+    assert(wl);
+    memset(wl, 0, sizeof(workload_t));
+
+    wl->config = *config;
+    wl->rng = config->seed;
+    zipf_init(&wl->zipf, config->n_resources, config->zipf_theta);
+
+    wl->writer = malloc(sizeof(uint32_t) * config->n_resources);
+    wl->n_readers = calloc(config->n_resources, sizeof(uint32_t));
+    wl->waiting = malloc(sizeof(uint32_t) * config->n_processes);
+    wl->waiters = calloc(config->n_resources, sizeof(queue_t*));
+    assert(wl->writer && wl->n_readers && wl->waiting && wl->waiters);
+
+    for (size_t i = 0; i < config->n_resources; i++) {
+        wl->writer[i] = WORKLOAD_NONE;
+    }
+    for (size_t i = 0; i < config->n_processes; i++) {
+        wl->waiting[i] = WORKLOAD_NONE;
+    }
+
+    return wl;
+}
+
+/*
+ * Function: workload_next
+ * --------------------
+ *  Generates the next event of the workload.
+ *
+ *  wl: Pointer to the workload.
+ *  event: Output event.
+ *
+ *  returns: Nothing.
+ */
+void workload_next(workload_t* wl, workload_event_t* event) {
+    assert(wl);
+    assert(event);
+    workload_config_t* config = &wl->config;
+
+    wl->n_events++;
+
+    // Inject a cycle every cycle_interval events
+    if (wl->n_cycles_injected < config->n_cycles &&
+                wl->n_events % config->cycle_interval == 0) {
+        _workload_inject_cycle(wl);
+    }
+
+    while (true) {
+        // Grants and cycle events go first
+        if (wl->pending_head < wl->n_pending) {
+            *event = wl->pending[wl->pending_head++];
+            if (wl->pending_head == wl->n_pending) {
+                wl->pending_head = 0;
+                wl->n_pending = 0;
+            }
+            return;
+        }
+
+        // Release due, hand the resource to whoever queued for it
+        if (wl->n_releases && wl->releases[0].time <= wl->time) {
+            workload_release_t release = _workload_pop_release(wl);
+            uint32_t resource = release.resource;
+
+            if (release.shared) {
+                wl->n_readers[resource]--;
+            } else {
+                wl->writer[resource] = WORKLOAD_NONE;
+            }
+
+            // Grant the first waiter, and any readers right behind a reader
+            queue_t* waiters = wl->waiters[resource];
+            if (waiters && !queue_is_empty(waiters) &&
+                        wl->writer[resource] == WORKLOAD_NONE &&
+                        wl->n_readers[resource] == 0) {
+                bool shared = false;
+                do {
+                    uintptr_t waiter = (uintptr_t)queue_dequeue(waiters) - 1;
+                    uint32_t process = (uint32_t)(waiter >> 1);
+                    shared = waiter & 1;
+
+                    wl->waiting[process] = WORKLOAD_NONE;
+                    _workload_grant(wl, process, resource, shared);
+                    _workload_schedule_release(wl, process, resource, shared);
+                    _workload_push_pending(wl, WORKLOAD_ACQUIRE, process,
+                                resource, shared, false);
+                } while (shared && !queue_is_empty(waiters) &&
+                            (((uintptr_t)queue_peek(waiters) - 1) & 1));
+            }
+
+            event->op = WORKLOAD_RELEASE;
+            event->process = release.process;
+            event->resource = resource;
+            event->shared = release.shared;
+            event->closes_cycle = false;
+            return;
+        }
+
+        wl->time++;
+
+        // Pick a process that is not blocked
+        uint32_t process = WORKLOAD_NONE;
+        for (size_t i = 0; i < WORKLOAD_PICK_TRIES; i++) {
+            uint32_t candidate = (uint32_t)(workload_rand(&wl->rng) %
+                        config->n_processes);
+            if (wl->waiting[candidate] == WORKLOAD_NONE) {
+                process = candidate;
+                break;
+            }
+        }
+
+        // Mostly blocked, skip ahead to the next release
+        if (process == WORKLOAD_NONE) {
+            if (wl->n_releases) {
+                wl->time = wl->releases[0].time;
+            }
+            continue;
+        }
+
+        uint32_t resource = (uint32_t)zipf_next(&wl->zipf, &wl->rng);
+        bool shared = workload_rand_double(&wl->rng) < config->read_ratio;
+
+        // Never wait on a resource the process already writes
+        if (wl->writer[resource] == process) {
+            continue;
+        }
+
+        event->process = process;
+        event->resource = resource;
+        event->shared = shared;
+        event->closes_cycle = false;
+
+        if (wl->writer[resource] == WORKLOAD_NONE &&
+                    (shared || wl->n_readers[resource] == 0) &&
+                    (!wl->waiters[resource] ||
+                    queue_is_empty(wl->waiters[resource]))) {
+            _workload_grant(wl, process, resource, shared);
+            _workload_schedule_release(wl, process, resource, shared);
+            event->op = WORKLOAD_ACQUIRE;
+        } else {
+            if (!wl->waiters[resource]) {
+                wl->waiters[resource] = queue_create();
+            }
+            wl->waiting[process] = resource;
+            queue_enqueue(wl->waiters[resource],
+                        (void*)((((uintptr_t)process << 1) | shared) + 1));
+            event->op = WORKLOAD_WAIT;
+        }
+        return;
+    }
+}
+
+/*
+ * Function: workload_generate
+ * --------------------
+ *  Generates a batch of events, so they can be replayed without the cost of
+ *  generating them.
+ *
+ *  wl: Pointer to the workload.
+ *  events: Output array of n_events events.
+ *  n_events: Number of events to generate.
+ *
+ *  returns: Nothing.
+ */
+void workload_generate(workload_t* wl, workload_event_t* events,
+                size_t n_events) {
+    assert(wl);
+    assert(n_events == 0 || events);
+
+    for (size_t i = 0; i < n_events; i++) {
+        workload_next(wl, &events[i]);
+    }
+}
+
+/*
+ * Function: workload_n_processes
+ * --------------------
+ *  Gets the number of process ids the workload can produce.
+ *
+ *  wl: Pointer to the workload.
+ *
+ *  returns: Number of process ids, including injected cycles.
+ */
+size_t workload_n_processes(workload_t* wl) {
+    assert(wl);
+    return wl->config.n_processes +
+                wl->config.n_cycles * wl->config.cycle_length;
+}
+
+/*
+ * Function: workload_n_resources
+ * --------------------
+ *  Gets the number of resource ids the workload can produce.
+ *
+ *  wl: Pointer to the workload.
+ *
+ *  returns: Number of resource ids, including injected cycles.
+ */
+size_t workload_n_resources(workload_t* wl) {
+    assert(wl);
+    return wl->config.n_resources +
+                wl->config.n_cycles * wl->config.cycle_length;
+}
+
+/*
+ * Function: workload_clean
+ * --------------------
+ *  Frees the workload.
+ *
+ *  wl: Pointer to the workload.
+ *
+ *  returns: Nothing.
+ */
+void workload_clean(workload_t* wl) {
+    assert(wl);
+
+    for (size_t i = 0; i < wl->config.n_resources; i++) {
+        if (wl->waiters[i]) {
+            queue_clean(wl->waiters[i], NULL);
+        }
+    }
+
+    free(wl->writer);
+    free(wl->n_readers);
+    free(wl->waiting);
+    free(wl->waiters);
+    free(wl->releases);
+    free(wl->pending);
+    free(wl);
+}
+
+/* RANDOM */
+/*
+ * Function: workload_rand
+ * --------------------
+ *  Generates a 64 bit pseudo random number (splitmix64).
+ *
+ *  state: Pointer to the generator state.
+ *
+ *  returns: Random number.
+ */
+uint64_t workload_rand(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/*
+ * Function: workload_rand_double
+ * --------------------
+ *  Generates a uniform random number in [0, 1).
+ *
+ *  state: Pointer to the generator state.
+ *
+ *  returns: Random number.
+ */
+double workload_rand_double(uint64_t* state) {
+    return (double)(workload_rand(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * Function: zipf_init
+ * --------------------
+ *  Initialises a Zipfian sampler over 0 .. n - 1, rank 0 is the most
+ *  popular. Setup is O(n), sampling is O(1) (Gray et al.).
+ *
+ *  zipf: Pointer to the sampler.
+ *  n: Number of items.
+ *  theta: Skew in [0, 1), 0 is uniform.
+ *
+ *  returns: Nothing.
+ */
+void zipf_init(zipf_t* zipf, size_t n, double theta) {
+    assert(zipf);
+    assert(n > 0);
+    assert(theta >= 0.0 && theta < 1.0);
+    double zeta_2 = 0.0;
+
+    zipf->n = n;
+    zipf->theta = theta;
+    zipf->zeta_n = 0.0;
+
+    if (theta == 0.0) {
+        return;
+    }
+
+    for (size_t i = 1; i <= n; i++) {
+        zipf->zeta_n += 1.0 / pow((double)i, theta);
+        if (i == 2) {
+            zeta_2 = zipf->zeta_n;
+        }
+    }
+    if (n < 2) {
+        zeta_2 = zipf->zeta_n;
+    }
+
+    zipf->alpha = 1.0 / (1.0 - theta);
+    zipf->eta = (1.0 - pow(2.0 / (double)n, 1.0 - theta)) /
+                (1.0 - zeta_2 / zipf->zeta_n);
+}
+
+/*
+ * Function: zipf_next
+ * --------------------
+ *  Samples an item.
+ *
+ *  zipf: Pointer to the sampler.
+ *  state: Pointer to the random generator state.
+ *
+ *  returns: Item rank.
+ */
+size_t zipf_next(zipf_t* zipf, uint64_t* state) {
+    assert(zipf);
+
+    if (zipf->theta == 0.0 || zipf->n < 2) {
+        return (size_t)(workload_rand(state) % zipf->n);
+    }
+
+    double u = workload_rand_double(state);
+    double uz = u * zipf->zeta_n;
+
+    if (uz < 1.0) {
+        return 0;
+    } else if (uz < 1.0 + pow(0.5, zipf->theta)) {
+        return 1;
+    }
+
+    size_t item = (size_t)((double)zipf->n *
+                pow(zipf->eta * u - zipf->eta + 1.0, zipf->alpha));
+    return item < zipf->n ? item : zipf->n - 1;
+}
+
+/**** PRIVATE ****/
+
+/*
+ * Function: _workload_push_pending
+ * --------------------
+ *  Appends an event to the pending events.
+ *
+ *  returns: Nothing.
+ */
+void _workload_push_pending(workload_t* wl, workload_op_t op, uint32_t process,
+                uint32_t resource, bool shared, bool closes_cycle) {
+    if (wl->n_pending == wl->pending_capacity) {
+        wl->pending_capacity = wl->pending_capacity ?
+                    wl->pending_capacity * 2 : 16;
+        wl->pending = realloc(wl->pending,
+                    sizeof(workload_event_t) * wl->pending_capacity);
+        assert(wl->pending);
+    }
+
+    workload_event_t* event = &wl->pending[wl->n_pending++];
+    event->op = op;
+    event->process = process;
+    event->resource = resource;
+    event->shared = shared;
+    event->closes_cycle = closes_cycle;
+}
+
+/*
+ * Function: _workload_inject_cycle
+ * --------------------
+ *  Queues the events of a new cycle, each process holds its own resource
+ *  and waits on the next process's resource.
+ *
+ *  returns: Nothing.
+ */
+void _workload_inject_cycle(workload_t* wl) {
+    size_t length = wl->config.cycle_length;
+    uint32_t first_process = (uint32_t)(wl->config.n_processes +
+                wl->n_cycles_injected * length);
+    uint32_t first_resource = (uint32_t)(wl->config.n_resources +
+                wl->n_cycles_injected * length);
+
+    for (size_t i = 0; i < length; i++) {
+        _workload_push_pending(wl, WORKLOAD_ACQUIRE,
+                    first_process + (uint32_t)i, first_resource + (uint32_t)i,
+                    false, false);
+    }
+    for (size_t i = 0; i < length; i++) {
+        _workload_push_pending(wl, WORKLOAD_WAIT, first_process + (uint32_t)i,
+                    first_resource + (uint32_t)((i + 1) % length), false,
+                    i == length - 1);
+    }
+
+    wl->n_cycles_injected++;
+}
+
+/*
+ * Function: _workload_schedule_release
+ * --------------------
+ *  Schedules the release of a granted resource after a random hold time.
+ *
+ *  returns: Nothing.
+ */
+void _workload_schedule_release(workload_t* wl, uint32_t process,
+                uint32_t resource, bool shared) {
+    // Exponentially distributed hold time, at least one event
+    double u = workload_rand_double(&wl->rng);
+    uint64_t hold = 1 + (uint64_t)(-log(1.0 - u) * wl->config.mean_hold);
+
+    if (wl->n_releases == wl->release_capacity) {
+        wl->release_capacity = wl->release_capacity ?
+                    wl->release_capacity * 2 : 64;
+        wl->releases = realloc(wl->releases,
+                    sizeof(workload_release_t) * wl->release_capacity);
+        assert(wl->releases);
+    }
+
+    workload_release_t release;
+    release.time = wl->time + hold;
+    release.process = process;
+    release.resource = resource;
+    release.shared = shared;
+
+    // Sift up
+    size_t i = wl->n_releases++;
+    while (i > 0 && wl->releases[(i - 1) / 2].time > release.time) {
+        wl->releases[i] = wl->releases[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    wl->releases[i] = release;
+}
+
+/*
+ * Function: _workload_pop_release
+ * --------------------
+ *  Removes the earliest scheduled release.
+ *
+ *  returns: The release.
+ */
+workload_release_t _workload_pop_release(workload_t* wl) {
+    workload_release_t top = wl->releases[0];
+    workload_release_t last = wl->releases[--wl->n_releases];
+    size_t i = 0;
+
+    // Sift down
+    while (2 * i + 1 < wl->n_releases) {
+        size_t child = 2 * i + 1;
+        if (child + 1 < wl->n_releases &&
+                    wl->releases[child + 1].time < wl->releases[child].time) {
+            child++;
+        }
+        if (wl->releases[child].time >= last.time) {
+            break;
+        }
+        wl->releases[i] = wl->releases[child];
+        i = child;
+    }
+    if (wl->n_releases) {
+        wl->releases[i] = last;
+    }
+
+    return top;
+}
+
+/*
+ * Function: _workload_grant
+ * --------------------
+ *  Grants access to a resource, updating its holders.
+ *
+ *  returns: Nothing.
+ */
+void _workload_grant(workload_t* wl, uint32_t process, uint32_t resource,
+                bool shared) {
+    if (shared) {
+        wl->n_readers[resource]++;
+    } else {
+        wl->writer[resource] = process;
+    }
+}
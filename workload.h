@@ -0,0 +1,272 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "queue.h"
+
+#define WORKLOAD_NONE UINT32_MAX
+
+typedef enum workload_op {
+    // Process is granted the resource
+    WORKLOAD_ACQUIRE,
+    // Process blocks waiting for the resource
+    WORKLOAD_WAIT,
+    // Process releases the resource
+    WORKLOAD_RELEASE
+} workload_op_t;
+
+typedef struct workload_event {
+    workload_op_t op;
+    uint32_t process;
+    uint32_t resource;
+    // Reader (shared) rather than writer (exclusive) access
+    bool shared;
+    // Event completes an injected cycle
+    bool closes_cycle;
+} workload_event_t;
+
+typedef struct workload_config {
+    size_t n_processes;
+    size_t n_resources;
+    // Zipfian skew of resource popularity in [0, 1), 0 is uniform
+    double zipf_theta;
+    // Share of acquisitions that are shared reads
+    double read_ratio;
+    // Mean hold time, in events
+    double mean_hold;
+    // Cycles to inject, each over its own cycle_length processes
+    size_t n_cycles;
+    size_t cycle_length;
+    // Events between injected cycles
+    size_t cycle_interval;
+    uint64_t seed;
+} workload_config_t;
+
+typedef struct zipf {
+    size_t n;
+    double theta;
+    double alpha;
+    double zeta_n;
+    double eta;
+} zipf_t;
+
+typedef struct workload_release {
+    uint64_t time;
+    uint32_t process;
+    uint32_t resource;
+    bool shared;
+} workload_release_t;
+
+typedef struct workload {
+    workload_config_t config;
+    zipf_t zipf;
+    uint64_t rng;
+    uint64_t time;
+    // Resource state, writer or WORKLOAD_NONE, and reader count
+    uint32_t* writer;
+    uint32_t* n_readers;
+    // Resource a process is blocked on, or WORKLOAD_NONE
+    uint32_t* waiting;
+    // FIFO of blocked processes per resource, created on first wait
+    queue_t** waiters;
+    // Min-heap of scheduled releases
+    workload_release_t* releases;
+    size_t n_releases;
+    size_t release_capacity;
+    // Events generated ahead of time, grants and injected cycles
+    workload_event_t* pending;
+    size_t n_pending;
+    size_t pending_head;
+    size_t pending_capacity;
+    size_t n_cycles_injected;
+    size_t n_events;
+} workload_t;
+
+/*
+ * Function: workload_default_config
+ * --------------------
+ *  Fills a config with a moderately skewed, mostly exclusive workload.
+ *
+ *  config: Pointer to the config.
+ *  n_processes: Number of processes.
+ *  n_resources: Number of resources.
+ *
+ *  returns: Nothing.
+ */
+void workload_default_config(workload_config_t* config, size_t n_processes,
+                size_t n_resources);
+
+/*
+ * Function: workload_create
+ * --------------------
+ *  Creates a synthetic lock workload. Injected cycles use process and
+ *  resource ids after n_processes and n_resources and never resolve.
+ *
+ *  config: Pointer to the config, copied.
+ *
+ *  returns: Pointer to the new workload.
+ */
+workload_t* workload_create(const workload_config_t* config);
+
+/*
+ * Function: workload_next
+ * --------------------
+ *  Generates the next event of the workload.
+ *
+ *  wl: Pointer to the workload.
+ *  event: Output event.
+ *
+ *  returns: Nothing.
+ */
+void workload_next(workload_t* wl, workload_event_t* event);
+
+/*
+ * Function: workload_generate
+ * --------------------
+ *  Generates a batch of events, so they can be replayed without the cost of
+ *  generating them.
+ *
+ *  wl: Pointer to the workload.
+ *  events: Output array of n_events events.
+ *  n_events: Number of events to generate.
+ *
+ *  returns: Nothing.
+ */
+void workload_generate(workload_t* wl, workload_event_t* events,
+                size_t n_events);
+
+/*
+ * Function: workload_n_processes
+ * --------------------
+ *  Gets the number of process ids the workload can produce.
+ *
+ *  wl: Pointer to the workload.
+ *
+ *  returns: Number of process ids, including injected cycles.
+ */
+size_t workload_n_processes(workload_t* wl);
+
+/*
+ * Function: workload_n_resources
+ * --------------------
+ *  Gets the number of resource ids the workload can produce.
+ *
+ *  wl: Pointer to the workload.
+ *
+ *  returns: Number of resource ids, including injected cycles.
+ */
+size_t workload_n_resources(workload_t* wl);
+
+/*
+ * Function: workload_clean
+ * --------------------
+ *  Frees the workload.
+ *
+ *  wl: Pointer to the workload.
+ *
+ *  returns: Nothing.
+ */
+void workload_clean(workload_t* wl);
+
+/* RANDOM */
+/*
+ * Function: workload_rand
+ * --------------------
+ *  Generates a 64 bit pseudo random number (splitmix64).
+ *
+ *  state: Pointer to the generator state.
+ *
+ *  returns: Random number.
+ */
+uint64_t workload_rand(uint64_t* state);
+
+/*
+ * Function: workload_rand_double
+ * --------------------
+ *  Generates a uniform random number in [0, 1).
+ *
+ *  state: Pointer to the generator state.
+ *
+ *  returns: Random number.
+ */
+double workload_rand_double(uint64_t* state);
+
+/*
+ * Function: zipf_init
+ * --------------------
+ *  Initialises a Zipfian sampler over 0 .. n - 1, rank 0 is the most
+ *  popular. Setup is O(n), sampling is O(1) (Gray et al.).
+ *
+ *  zipf: Pointer to the sampler.
+ *  n: Number of items.
+ *  theta: Skew in [0, 1), 0 is uniform.
+ *
+ *  returns: Nothing.
+ */
+void zipf_init(zipf_t* zipf, size_t n, double theta);
+
+/*
+ * Function: zipf_next
+ * --------------------
+ *  Samples an item.
+ *
+ *  zipf: Pointer to the sampler.
+ *  state: Pointer to the random generator state.
+ *
+ *  returns: Item rank.
+ */
+size_t zipf_next(zipf_t* zipf, uint64_t* state);
+
+/**** PRIVATE ****/
+/*
+ * Function: _workload_push_pending
+ * --------------------
+ *  Appends an event to the pending events.
+ *
+ *  returns: Nothing.
+ */
+void _workload_push_pending(workload_t* wl, workload_op_t op, uint32_t process,
+                uint32_t resource, bool shared, bool closes_cycle);
+
+/*
+ * Function: _workload_inject_cycle
+ * --------------------
+ *  Queues the events of a new cycle, each process holds its own resource
+ *  and waits on the next process's resource.
+ *
+ *  returns: Nothing.
+ */
+void _workload_inject_cycle(workload_t* wl);
+
+/*
+ * Function: _workload_schedule_release
+ * --------------------
+ *  Schedules the release of a granted resource after a random hold time.
+ *
+ *  returns: Nothing.
+ */
+void _workload_schedule_release(workload_t* wl, uint32_t process,
+                uint32_t resource, bool shared);
+
+/*
+ * Function: _workload_pop_release
+ * --------------------
+ *  Removes the earliest scheduled release.
+ *
+ *  returns: The release.
+ */
+workload_release_t _workload_pop_release(workload_t* wl);
+
+/*
+ * Function: _workload_grant
+ * --------------------
+ *  Grants access to a resource, updating its holders.
+ *
+ *  returns: Nothing.
+ */
+void _workload_grant(workload_t* wl, uint32_t process, uint32_t resource,
+                bool shared);
+
+#endif